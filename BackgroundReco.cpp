@@ -0,0 +1,1122 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      BackgroundReco.cpp
+//
+// Description:
+//      The file contains the definitions of the methods of the classes
+//      CRecoInk, CGestureTextRecognizer, CBackgroundRecognizer and
+//      CRecoWorkerPool. See the file BackgroundReco.h for the definitions
+//      of the classes.
+//--------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "BackgroundReco.h"
+#include "Trace.h"
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+// A thread
+struct RecoThread
+{
+#ifdef _WIN32
+    HANDLE              hThread;
+#else
+    pthread_t           thread;
+#endif
+};
+
+#ifdef _WIN32
+typedef LPTHREAD_START_ROUTINE PFNRECOTHREAD;
+#else
+typedef void* (*PFNRECOTHREAD)(void* pv);
+#endif
+
+static bool ThreadCreate(RecoThread* pThread, PFNRECOTHREAD pfnStart, void* pv)
+{
+#ifdef _WIN32
+    pThread->hThread = ::CreateThread(NULL, 0, pfnStart, pv, 0, NULL);
+    return (NULL != pThread->hThread);
+#else
+    return (0 == pthread_create(&pThread->thread, NULL, pfnStart, pv));
+#endif
+}
+
+static void ThreadJoin(RecoThread* pThread)
+{
+#ifdef _WIN32
+    ::WaitForSingleObject(pThread->hThread, INFINITE);
+    ::CloseHandle(pThread->hThread);
+#else
+    pthread_join(pThread->thread, NULL);
+#endif
+}
+
+// The thread, the lock and the condition of a CBackgroundRecognizer;
+// a CRecoWorkerPool uses the lock and the condition only
+struct RecoSync
+{
+    RecoThread          thread;
+#ifdef _WIN32
+    CRITICAL_SECTION    cs;
+    CONDITION_VARIABLE  cv;
+#else
+    pthread_mutex_t     mutex;
+    pthread_cond_t      cond;
+#endif
+};
+
+// A worker of a CRecoWorkerPool
+struct RecoPoolWorker
+{
+    CRecoWorkerPool*    pPool;
+    IStrokeRecognizer*  pRecognizer;
+    RecoThread          thread;
+};
+
+static void SyncInit(RecoSync* pSync)
+{
+#ifdef _WIN32
+    ::InitializeCriticalSection(&pSync->cs);
+    ::InitializeConditionVariable(&pSync->cv);
+#else
+    pthread_mutex_init(&pSync->mutex, NULL);
+    pthread_cond_init(&pSync->cond, NULL);
+#endif
+}
+
+static void SyncTerm(RecoSync* pSync)
+{
+#ifdef _WIN32
+    ::DeleteCriticalSection(&pSync->cs);
+#else
+    pthread_cond_destroy(&pSync->cond);
+    pthread_mutex_destroy(&pSync->mutex);
+#endif
+}
+
+static void SyncLock(RecoSync* pSync)
+{
+#ifdef _WIN32
+    ::EnterCriticalSection(&pSync->cs);
+#else
+    pthread_mutex_lock(&pSync->mutex);
+#endif
+}
+
+static void SyncUnlock(RecoSync* pSync)
+{
+#ifdef _WIN32
+    ::LeaveCriticalSection(&pSync->cs);
+#else
+    pthread_mutex_unlock(&pSync->mutex);
+#endif
+}
+
+static void SyncWakeAll(RecoSync* pSync)
+{
+#ifdef _WIN32
+    ::WakeAllConditionVariable(&pSync->cv);
+#else
+    pthread_cond_broadcast(&pSync->cond);
+#endif
+}
+
+/////////////////////////////////////////////////////////
+//
+// SyncWait
+//
+// Releases the lock, waits for a wake up or for the timeout
+// and takes the lock again. The wait may also end early, so
+// the callers check their condition again.
+//
+// Parameters:
+//     RecoSync* pSync    : [in] the lock, taken
+//     PERFTIME ptTimeout : [in] in nanoseconds, 0 to wait for a wake up
+//
+/////////////////////////////////////////////////////////
+static void SyncWait(RecoSync* pSync, PERFTIME ptTimeout)
+{
+#ifdef _WIN32
+    DWORD dwMs = (0 == ptTimeout) ? INFINITE : (DWORD)((ptTimeout + 999999) / 1000000);
+    ::SleepConditionVariableCS(&pSync->cv, &pSync->cs, dwMs);
+#else
+    if (0 == ptTimeout)
+    {
+        pthread_cond_wait(&pSync->cond, &pSync->mutex);
+    }
+    else
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        PERFTIME ptNs = (PERFTIME)ts.tv_nsec + ptTimeout;
+        ts.tv_sec += (time_t)(ptNs / 1000000000ULL);
+        ts.tv_nsec = (long)(ptNs % 1000000000ULL);
+        pthread_cond_timedwait(&pSync->cond, &pSync->mutex, &ts);
+    }
+#endif
+}
+
+/////////////////////////////////////////////////////////
+//
+// AppendText
+//
+// Appends a string to a text buffer, truncating it to the
+// buffer.
+//
+/////////////////////////////////////////////////////////
+static void AppendText(char* pszText, int cchText, const char* psz)
+{
+    size_t cch = strlen(pszText);
+    if (cch + 1 < (size_t)cchText)
+    {
+        snprintf(pszText + cch, cchText - cch, "%s", psz);
+    }
+}
+
+////////////////////////////////////////////////////////
+// CRecoInk methods
+////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////
+//
+// CRecoInk::CRecoInk
+//
+// Constructor.
+//
+/////////////////////////////////////////////////////////
+CRecoInk::CRecoInk()
+    : m_pPoints(NULL), m_cPoints(0), m_cMaxPoints(0), m_piStrokeEnds(NULL),
+      m_piStrokeCells(NULL), m_cStrokes(0), m_cMaxStrokes(0), m_cCellColumns(1),
+      m_pConstraint(NULL), m_bCoerce(false), m_pSnapshot(NULL)
+{
+}
+
+/////////////////////////////////////////////////////////
+//
+// CRecoInk::~CRecoInk
+//
+// Destructor.
+//
+/////////////////////////////////////////////////////////
+CRecoInk::~CRecoInk()
+{
+    free(m_pPoints);
+    free(m_piStrokeEnds);
+    free(m_piStrokeCells);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CRecoInk::AddStroke
+//
+// Appends a stroke.
+//
+// Parameters:
+//     const GesturePoint* ppt : [in] the points of the stroke
+//     int cPoints             : [in] the number of the points, > 0
+//     int iCell               : [in] the cell of the guide, 0 if none
+//
+// Return Values (bool):
+//      true if succeeded, false if out of memory
+//
+/////////////////////////////////////////////////////////
+bool CRecoInk::AddStroke(const GesturePoint* ppt, int cPoints, int iCell)
+{
+    if (m_cPoints + cPoints > m_cMaxPoints)
+    {
+        int cMaxPoints = (0 == m_cMaxPoints) ? 1024 : 2 * m_cMaxPoints;
+        while (cMaxPoints < m_cPoints + cPoints)
+            cMaxPoints *= 2;
+        GesturePoint* pPoints =
+            (GesturePoint*)realloc(m_pPoints, cMaxPoints * sizeof(GesturePoint));
+        if (NULL == pPoints)
+            return false;
+        m_pPoints = pPoints;
+        m_cMaxPoints = cMaxPoints;
+    }
+    if (m_cStrokes == m_cMaxStrokes)
+    {
+        int cMaxStrokes = (0 == m_cMaxStrokes) ? 16 : 2 * m_cMaxStrokes;
+        int* piStrokeEnds = (int*)realloc(m_piStrokeEnds, cMaxStrokes * sizeof(int));
+        if (NULL == piStrokeEnds)
+            return false;
+        m_piStrokeEnds = piStrokeEnds;
+        int* piStrokeCells = (int*)realloc(m_piStrokeCells, cMaxStrokes * sizeof(int));
+        if (NULL == piStrokeCells)
+            return false;
+        m_piStrokeCells = piStrokeCells;
+        m_cMaxStrokes = cMaxStrokes;
+    }
+
+    memcpy(m_pPoints + m_cPoints, ppt, cPoints * sizeof(GesturePoint));
+    m_cPoints += cPoints;
+    m_piStrokeEnds[m_cStrokes] = m_cPoints;
+    m_piStrokeCells[m_cStrokes] = iCell;
+    m_cStrokes++;
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CRecoInk::Copy
+//
+// Replaces the ink with a copy of another one. The buffers
+// are reused, so a copy of ink that isn't larger than the
+// ink before doesn't allocate.
+//
+// Return Values (bool):
+//      true if succeeded, false if out of memory (the ink is
+//      empty then)
+//
+/////////////////////////////////////////////////////////
+bool CRecoInk::Copy(const CRecoInk& ink)
+{
+    Clear();
+    m_cCellColumns = ink.m_cCellColumns;
+    m_pConstraint = ink.m_pConstraint;
+    m_bCoerce = ink.m_bCoerce;
+    for (int i = 0; i < ink.m_cStrokes; i++)
+    {
+        int cPoints;
+        const GesturePoint* ppt = ink.GetStroke(i, cPoints);
+        if (false == AddStroke(ppt, cPoints, ink.m_piStrokeCells[i]))
+        {
+            Clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CRecoInk::Swap
+//
+// Exchanges the contents and the buffers of two inks.
+//
+/////////////////////////////////////////////////////////
+void CRecoInk::Swap(CRecoInk& ink)
+{
+    GesturePoint* pPoints = m_pPoints;
+    int cPoints = m_cPoints, cMaxPoints = m_cMaxPoints;
+    int* piStrokeEnds = m_piStrokeEnds;
+    int* piStrokeCells = m_piStrokeCells;
+    int cStrokes = m_cStrokes, cMaxStrokes = m_cMaxStrokes;
+    int cCellColumns = m_cCellColumns;
+    const IRecoConstraint* pConstraint = m_pConstraint;
+    bool bCoerce = m_bCoerce;
+
+    m_pPoints = ink.m_pPoints;
+    m_cPoints = ink.m_cPoints;
+    m_cMaxPoints = ink.m_cMaxPoints;
+    m_piStrokeEnds = ink.m_piStrokeEnds;
+    m_piStrokeCells = ink.m_piStrokeCells;
+    m_cStrokes = ink.m_cStrokes;
+    m_cMaxStrokes = ink.m_cMaxStrokes;
+    m_cCellColumns = ink.m_cCellColumns;
+    m_pConstraint = ink.m_pConstraint;
+    m_bCoerce = ink.m_bCoerce;
+
+    ink.m_pPoints = pPoints;
+    ink.m_cPoints = cPoints;
+    ink.m_cMaxPoints = cMaxPoints;
+    ink.m_piStrokeEnds = piStrokeEnds;
+    ink.m_piStrokeCells = piStrokeCells;
+    ink.m_cStrokes = cStrokes;
+    ink.m_cMaxStrokes = cMaxStrokes;
+    ink.m_cCellColumns = cCellColumns;
+    ink.m_pConstraint = pConstraint;
+    ink.m_bCoerce = bCoerce;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CRecoInk::GetStroke
+//
+// Returns the points of a stroke.
+//
+// Parameters:
+//     int iStroke  : [in] 0..GetStrokeCount() - 1
+//     int& cPoints : [out] the number of the points
+//
+/////////////////////////////////////////////////////////
+const GesturePoint* CRecoInk::GetStroke(int iStroke, int& cPoints) const
+{
+    int iBegin = (0 == iStroke) ? 0 : m_piStrokeEnds[iStroke - 1];
+    cPoints = m_piStrokeEnds[iStroke] - iBegin;
+    return m_pPoints + iBegin;
+}
+
+////////////////////////////////////////////////////////
+// CGestureTextRecognizer methods
+////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////
+//
+// CGestureTextRecognizer::Recognize
+//
+// Recognizes with the engine, or with a snapshot of the
+// configuration: the one the ink's job pinned (the guided
+// recognition pins one for all its cells), or else the
+// current one, pinned until the job is done.
+//
+// Parameters:
+//     const CRecoInk& ink          : [in] the ink to recognize
+//     const RecoCancel& cancel     : [in] tells if the job is stale
+//     RecoAlternate* pAlternates   : [out] the alternates, best first
+//     int cMaxAlternates           : [in] the size of pAlternates
+//
+// Return Values (int):
+//      the number of alternates, -1 if cancelled or if no snapshot
+//      could be pinned (all the hazard slots were taken)
+//
+/////////////////////////////////////////////////////////
+int CGestureTextRecognizer::Recognize(
+        const CRecoInk& ink,
+        const RecoCancel& cancel,
+        RecoAlternate* pAlternates,
+        int cMaxAlternates
+        )
+{
+    if (NULL == m_pConfig)
+        return RecognizeWith(*m_pEngine, ink, cancel, pAlternates, cMaxAlternates);
+    if (NULL != ink.GetSnapshot())
+        return RecognizeWith(ink.GetSnapshot()->engine, ink, cancel, pAlternates, cMaxAlternates);
+
+    int iSlot = -1;
+    const GestureSnapshot* pSnapshot = m_pConfig->Acquire(iSlot);
+    if (NULL == pSnapshot)
+        return -1;
+    int cAlternates = RecognizeWith(pSnapshot->engine, ink, cancel, pAlternates, cMaxAlternates);
+    m_pConfig->Release(iSlot);
+    return cAlternates;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureTextRecognizer::RecognizeWith
+//
+// Reads every stroke as the name of its best gesture, the
+// names separated by commas; the alternates after the first
+// one take the next best gestures for the last stroke. The
+// score of an alternate is the mean score of its gestures.
+// The cancel is checked before every stroke.
+//
+// Parameters:
+//     const CGestureEngine& engine : [in] the templates
+//     const CRecoInk& ink          : [in] the ink to recognize
+//     const RecoCancel& cancel     : [in] tells if the job is stale
+//     RecoAlternate* pAlternates   : [out] the alternates, best first
+//     int cMaxAlternates           : [in] the size of pAlternates
+//
+// Return Values (int):
+//      the number of alternates, -1 if cancelled
+//
+/////////////////////////////////////////////////////////
+int CGestureTextRecognizer::RecognizeWith(
+        const CGestureEngine& engine,
+        const CRecoInk& ink,
+        const RecoCancel& cancel,
+        RecoAlternate* pAlternates,
+        int cMaxAlternates
+        )
+{
+    int cStrokes = ink.GetStrokeCount();
+    if (0 == cStrokes || cMaxAlternates <= 0)
+        return 0;
+    if (cMaxAlternates > BR_MAX_ALTERNATES)
+        cMaxAlternates = BR_MAX_ALTERNATES;
+
+    // The text of the strokes before the last one
+    char szPrefix[BR_MAX_TEXT] = "";
+    float fScoreSum = 0.0f;
+    GestureResult rgLast[BR_MAX_ALTERNATES];
+    int cLast = 0;
+    for (int i = 0; i < cStrokes; i++)
+    {
+        if (cancel.IsCancelled())
+            return -1;
+
+        int cPoints;
+        const GesturePoint* ppt = ink.GetStroke(i, cPoints);
+        if (i < cStrokes - 1)
+        {
+            GestureResult result;
+            if (engine.Recognize(ppt, cPoints, &result, 1) > 0)
+            {
+                AppendText(szPrefix, sizeof(szPrefix), CGestureEngine::GetGestureName(result.iGesture));
+                fScoreSum += result.fScore;
+            }
+            else
+            {
+                AppendText(szPrefix, sizeof(szPrefix), "?");
+            }
+            AppendText(szPrefix, sizeof(szPrefix), ", ");
+        }
+        else
+        {
+            cLast = engine.Recognize(ppt, cPoints, rgLast, cMaxAlternates);
+        }
+    }
+
+    if (0 == cLast)
+    {
+        snprintf(pAlternates[0].szText, BR_MAX_TEXT, "%s?", szPrefix);
+        pAlternates[0].fScore = fScoreSum / cStrokes;
+        return 1;
+    }
+
+    for (int i = 0; i < cLast; i++)
+    {
+        snprintf(pAlternates[i].szText, BR_MAX_TEXT, "%s%s", szPrefix,
+                 CGestureEngine::GetGestureName(rgLast[i].iGesture));
+        pAlternates[i].fScore = (fScoreSum + rgLast[i].fScore) / cStrokes;
+    }
+    return cLast;
+}
+
+////////////////////////////////////////////////////////
+// CBackgroundRecognizer methods
+////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////
+//
+// CBackgroundRecognizer::CBackgroundRecognizer
+//
+// Constructor.
+//
+/////////////////////////////////////////////////////////
+CBackgroundRecognizer::CBackgroundRecognizer()
+    : m_pSync(NULL), m_pRecognizer(NULL), m_pfnNotify(NULL), m_pvContext(NULL),
+      m_ptDebounce(0), m_lGeneration(0), m_bPending(false), m_lPendingGeneration(0),
+      m_ptDue(0), m_bStop(false), m_bThreadReady(false), m_bThreadFailed(false),
+      m_lResultGeneration(0), m_cResults(0)
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+/////////////////////////////////////////////////////////
+//
+// CBackgroundRecognizer::~CBackgroundRecognizer
+//
+// Destructor. Stops the worker thread.
+//
+/////////////////////////////////////////////////////////
+CBackgroundRecognizer::~CBackgroundRecognizer()
+{
+    Stop();
+}
+
+/////////////////////////////////////////////////////////
+//
+// CBackgroundRecognizer::Start
+//
+// Starts the worker thread and waits for the recognizer's
+// BeginThread.
+//
+// Parameters:
+//     IStrokeRecognizer* pRecognizer : [in] the recognizer, must outlive
+//                                      the worker thread
+//     PFNRECONOTIFY pfnNotify        : [in] called on the worker thread
+//                                      when the results are ready, must
+//                                      not wait for the application's thread
+//     void* pvContext                : [in] passed to pfnNotify
+//     int cDebounceMs                : [in] the time without new strokes
+//                                      before a submitted ink is recognized
+//
+// Return Values (bool):
+//      true if succeeded, false if the thread couldn't be created or
+//      the recognizer's BeginThread failed
+//
+/////////////////////////////////////////////////////////
+bool CBackgroundRecognizer::Start(
+        IStrokeRecognizer* pRecognizer,
+        PFNRECONOTIFY pfnNotify,
+        void* pvContext,
+        int cDebounceMs
+        )
+{
+    if (NULL != m_pSync || NULL == pRecognizer)
+        return false;
+
+    RecoSync* pSync = new RecoSync;
+    SyncInit(pSync);
+
+    m_pRecognizer = pRecognizer;
+    m_pfnNotify = pfnNotify;
+    m_pvContext = pvContext;
+    m_ptDebounce = (PERFTIME)cDebounceMs * 1000000;
+    m_bPending = false;
+    m_bStop = false;
+    m_bThreadReady = false;
+    m_bThreadFailed = false;
+    m_cResults = 0;
+
+    // The thread takes the lock as soon as it runs
+    m_pSync = pSync;
+    if (false == ThreadCreate(&pSync->thread, ThreadStart, this))
+    {
+        m_pSync = NULL;
+        SyncTerm(pSync);
+        delete pSync;
+        return false;
+    }
+
+    SyncLock(m_pSync);
+    while (false == m_bThreadReady)
+    {
+        SyncWait(m_pSync, 0);
+    }
+    bool bFailed = m_bThreadFailed;
+    SyncUnlock(m_pSync);
+
+    if (bFailed)
+    {
+        Stop();
+        return false;
+    }
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CBackgroundRecognizer::Stop
+//
+// Cancels the jobs, waits for the worker thread to end and
+// releases it. Nothing is delivered after it returns.
+//
+/////////////////////////////////////////////////////////
+void CBackgroundRecognizer::Stop()
+{
+    if (NULL == m_pSync)
+        return;
+
+    SyncLock(m_pSync);
+    m_bStop = true;
+    m_lGeneration++;
+    SyncWakeAll(m_pSync);
+    SyncUnlock(m_pSync);
+
+    ThreadJoin(&m_pSync->thread);
+
+    SyncTerm(m_pSync);
+    delete m_pSync;
+    m_pSync = NULL;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CBackgroundRecognizer::Submit
+//
+// Queues a copy of the ink for recognition, in place of the
+// job queued before, if it hasn't started, and cancels the
+// running job. The recognition starts when no other ink has
+// been submitted for the debounce time, or right away.
+//
+// Parameters:
+//     const CRecoInk& ink : [in] all the ink to recognize
+//     bool bImmediate     : [in] true not to wait for more strokes
+//
+// Return Values (long):
+//      the generation of the job, 0 if failed
+//
+/////////////////////////////////////////////////////////
+long CBackgroundRecognizer::Submit(const CRecoInk& ink, bool bImmediate)
+{
+    if (NULL == m_pSync)
+        return 0;
+
+    TRACE_SCOPE("Submit ink");
+
+    SyncLock(m_pSync);
+    m_stats.cSubmitted++;
+    if (m_bPending)
+        m_stats.cSuperseded++;
+    m_lGeneration++;
+    m_bPending = m_inkPending.Copy(ink);
+    m_lPendingGeneration = m_lGeneration;
+    m_ptDue = bImmediate ? 0 : PerfNow() + m_ptDebounce;
+    long lGeneration = m_bPending ? m_lGeneration : 0;
+    SyncWakeAll(m_pSync);
+    SyncUnlock(m_pSync);
+
+    return lGeneration;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CBackgroundRecognizer::Cancel
+//
+// Drops the queued job, cancels the running one and
+// forgets the results, as when the ink is cleared.
+//
+/////////////////////////////////////////////////////////
+void CBackgroundRecognizer::Cancel()
+{
+    if (NULL == m_pSync)
+        return;
+
+    SyncLock(m_pSync);
+    if (m_bPending)
+        m_stats.cSuperseded++;
+    m_lGeneration++;
+    m_bPending = false;
+    m_cResults = 0;
+    SyncUnlock(m_pSync);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CBackgroundRecognizer::GetResults
+//
+// Copies the results of a generation, if they're still the
+// latest.
+//
+// Parameters:
+//     long lGeneration           : [in] from the notification
+//     RecoAlternate* pAlternates : [out] the alternates, best first
+//     int cMaxAlternates         : [in] the size of pAlternates
+//
+// Return Values (int):
+//      the number of alternates, -1 if the generation is stale
+//
+/////////////////////////////////////////////////////////
+int CBackgroundRecognizer::GetResults(
+        long lGeneration,
+        RecoAlternate* pAlternates,
+        int cMaxAlternates
+        )
+{
+    if (NULL == m_pSync)
+        return -1;
+
+    int cResults = -1;
+    SyncLock(m_pSync);
+    if (lGeneration == m_lGeneration && lGeneration == m_lResultGeneration)
+    {
+        cResults = (m_cResults < cMaxAlternates) ? m_cResults : cMaxAlternates;
+        memcpy(pAlternates, m_rgResults, cResults * sizeof(RecoAlternate));
+    }
+    SyncUnlock(m_pSync);
+
+    return cResults;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CBackgroundRecognizer::GetStats
+//
+// Copies the job counts.
+//
+/////////////////////////////////////////////////////////
+void CBackgroundRecognizer::GetStats(RecoStats& stats)
+{
+    if (NULL == m_pSync)
+    {
+        stats = m_stats;
+        return;
+    }
+
+    SyncLock(m_pSync);
+    stats = m_stats;
+    SyncUnlock(m_pSync);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CBackgroundRecognizer::ThreadStart
+//
+// The entry point of the worker thread.
+//
+/////////////////////////////////////////////////////////
+#ifdef _WIN32
+DWORD WINAPI CBackgroundRecognizer::ThreadStart(void* pvThis)
+{
+    ((CBackgroundRecognizer*)pvThis)->ThreadProc();
+    return 0;
+}
+#else
+void* CBackgroundRecognizer::ThreadStart(void* pvThis)
+{
+    ((CBackgroundRecognizer*)pvThis)->ThreadProc();
+    return NULL;
+}
+#endif
+
+/////////////////////////////////////////////////////////
+//
+// CBackgroundRecognizer::ThreadProc
+//
+// The worker thread: waits for a job and for its debounce
+// time, recognizes the ink outside the lock and keeps the
+// results if the job is still the latest one.
+//
+/////////////////////////////////////////////////////////
+void CBackgroundRecognizer::ThreadProc()
+{
+    bool bReady = m_pRecognizer->BeginThread();
+
+    SyncLock(m_pSync);
+    m_bThreadReady = true;
+    m_bThreadFailed = !bReady;
+    SyncWakeAll(m_pSync);
+    if (false == bReady)
+    {
+        SyncUnlock(m_pSync);
+        return;
+    }
+
+    RecoAlternate rgAlternates[BR_MAX_ALTERNATES];
+    while (false == m_bStop)
+    {
+        if (false == m_bPending)
+        {
+            SyncWait(m_pSync, 0);
+            continue;
+        }
+
+        // Wait for the strokes to stop coming; a new submission
+        // moves the due time
+        PERFTIME ptNow = PerfNow();
+        if (ptNow < m_ptDue)
+        {
+            SyncWait(m_pSync, m_ptDue - ptNow);
+            continue;
+        }
+
+        // Take the job; the old ink's buffers will take the next one
+        m_inkWork.Swap(m_inkPending);
+        RecoCancel cancel = { &m_lGeneration, m_lPendingGeneration };
+        m_bPending = false;
+        SyncUnlock(m_pSync);
+
+        int cAlternates;
+        {
+            TRACE_SCOPE("Background recognition");
+            cAlternates = m_pRecognizer->Recognize(m_inkWork, cancel,
+                                                   rgAlternates, BR_MAX_ALTERNATES);
+        }
+
+        SyncLock(m_pSync);
+        bool bDeliver = false;
+        if (cancel.IsCancelled())
+        {
+            m_stats.cCancelled++;
+        }
+        else if (cAlternates < 0)
+        {
+            m_stats.cFailed++;
+        }
+        else
+        {
+            memcpy(m_rgResults, rgAlternates, cAlternates * sizeof(RecoAlternate));
+            m_cResults = cAlternates;
+            m_lResultGeneration = cancel.lGeneration;
+            m_stats.cDelivered++;
+            bDeliver = true;
+        }
+
+        if (bDeliver && NULL != m_pfnNotify)
+        {
+            SyncUnlock(m_pSync);
+            m_pfnNotify(m_pvContext, cancel.lGeneration);
+            SyncLock(m_pSync);
+        }
+    }
+    SyncUnlock(m_pSync);
+
+    m_pRecognizer->EndThread();
+}
+
+////////////////////////////////////////////////////////
+// CRecoWorkerPool methods
+////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////
+//
+// CRecoWorkerPool::CRecoWorkerPool
+//
+// Constructor.
+//
+/////////////////////////////////////////////////////////
+CRecoWorkerPool::CRecoWorkerPool()
+    : m_pSync(NULL), m_pWorkers(NULL), m_cWorkers(0), m_pTasks(NULL), m_cTasks(0),
+      m_iNextTask(0), m_cTasksDone(0), m_bStop(false), m_cStarted(0), m_cFailed(0)
+{
+    m_cancel.plGeneration = NULL;
+    m_cancel.lGeneration = 0;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CRecoWorkerPool::~CRecoWorkerPool
+//
+// Destructor. Stops the workers.
+//
+/////////////////////////////////////////////////////////
+CRecoWorkerPool::~CRecoWorkerPool()
+{
+    Stop();
+}
+
+/////////////////////////////////////////////////////////
+//
+// CRecoWorkerPool::Start
+//
+// Starts a worker thread per recognizer and waits for the
+// recognizers' BeginThread.
+//
+// Parameters:
+//     IStrokeRecognizer* const* ppRecognizers : [in] a recognizer per
+//                                  worker, they must outlive the workers
+//     int cWorkers                            : [in] 1..BR_MAX_WORKERS
+//
+// Return Values (bool):
+//      true if succeeded, false if a thread couldn't be created or a
+//      recognizer's BeginThread failed
+//
+/////////////////////////////////////////////////////////
+bool CRecoWorkerPool::Start(IStrokeRecognizer* const* ppRecognizers, int cWorkers)
+{
+    if (NULL != m_pSync || cWorkers < 1 || cWorkers > BR_MAX_WORKERS)
+        return false;
+
+    RecoPoolWorker* pWorkers = (RecoPoolWorker*)malloc(cWorkers * sizeof(RecoPoolWorker));
+    if (NULL == pWorkers)
+        return false;
+
+    RecoSync* pSync = new RecoSync;
+    SyncInit(pSync);
+
+    m_pSync = pSync;
+    m_pWorkers = pWorkers;
+    m_cWorkers = 0;
+    m_pTasks = NULL;
+    m_cTasks = m_iNextTask = m_cTasksDone = 0;
+    m_bStop = false;
+    m_cStarted = m_cFailed = 0;
+
+    // Stop joins the workers created so far if one fails
+    for (int i = 0; i < cWorkers; i++)
+    {
+        pWorkers[i].pPool = this;
+        pWorkers[i].pRecognizer = ppRecognizers[i];
+        if (false == ThreadCreate(&pWorkers[i].thread, ThreadStart, &pWorkers[i]))
+        {
+            Stop();
+            return false;
+        }
+        m_cWorkers++;
+    }
+
+    SyncLock(m_pSync);
+    while (m_cStarted < m_cWorkers)
+    {
+        SyncWait(m_pSync, 0);
+    }
+    bool bFailed = (0 != m_cFailed);
+    SyncUnlock(m_pSync);
+
+    if (bFailed)
+    {
+        Stop();
+        return false;
+    }
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CRecoWorkerPool::Stop
+//
+// Waits for the workers to end and releases them. It must
+// not be called while Run is running.
+//
+/////////////////////////////////////////////////////////
+void CRecoWorkerPool::Stop()
+{
+    if (NULL == m_pSync)
+        return;
+
+    SyncLock(m_pSync);
+    m_bStop = true;
+    SyncWakeAll(m_pSync);
+    SyncUnlock(m_pSync);
+
+    for (int i = 0; i < m_cWorkers; i++)
+    {
+        ThreadJoin(&m_pWorkers[i].thread);
+    }
+
+    SyncTerm(m_pSync);
+    delete m_pSync;
+    m_pSync = NULL;
+    free(m_pWorkers);
+    m_pWorkers = NULL;
+    m_cWorkers = 0;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CRecoWorkerPool::Run
+//
+// Runs the tasks on the workers and waits for all of them.
+// The workers skip the tasks they haven't started once the
+// job is cancelled.
+//
+// Parameters:
+//     RecoTask* pTasks         : [in/out] the inks in, the alternates out
+//     int cTasks               : [in] the number of the tasks
+//     const RecoCancel& cancel : [in] tells if the job is stale
+//
+// Return Values (bool):
+//      true if all the tasks succeeded, false if one failed or the job
+//      was cancelled
+//
+/////////////////////////////////////////////////////////
+bool CRecoWorkerPool::Run(RecoTask* pTasks, int cTasks, const RecoCancel& cancel)
+{
+    if (NULL == m_pSync)
+        return false;
+    if (0 == cTasks)
+        return true;
+
+    TRACE_SCOPE("Run recognition tasks");
+
+    SyncLock(m_pSync);
+    m_pTasks = pTasks;
+    m_cTasks = cTasks;
+    m_iNextTask = 0;
+    m_cTasksDone = 0;
+    m_cancel = cancel;
+    SyncWakeAll(m_pSync);
+    while (m_cTasksDone < m_cTasks)
+    {
+        SyncWait(m_pSync, 0);
+    }
+    m_pTasks = NULL;
+    m_cTasks = m_iNextTask = 0;
+    SyncUnlock(m_pSync);
+
+    if (cancel.IsCancelled())
+        return false;
+    for (int i = 0; i < cTasks; i++)
+    {
+        if (pTasks[i].cAlternates < 0)
+            return false;
+    }
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CRecoWorkerPool::GetProcessorCount
+//
+// Return Values (int):
+//      the number of the processors the threads can run on, at least 1
+//
+/////////////////////////////////////////////////////////
+int CRecoWorkerPool::GetProcessorCount()
+{
+#ifdef _WIN32
+    SYSTEM_INFO si;
+    ::GetSystemInfo(&si);
+    int cProcessors = (int)si.dwNumberOfProcessors;
+#else
+    int cProcessors = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return (cProcessors < 1) ? 1 : cProcessors;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CRecoWorkerPool::ThreadStart
+//
+// The entry point of a worker thread.
+//
+/////////////////////////////////////////////////////////
+#ifdef _WIN32
+DWORD WINAPI CRecoWorkerPool::ThreadStart(void* pvWorker)
+{
+    RecoPoolWorker* pWorker = (RecoPoolWorker*)pvWorker;
+    pWorker->pPool->WorkerProc(pWorker->pRecognizer);
+    return 0;
+}
+#else
+void* CRecoWorkerPool::ThreadStart(void* pvWorker)
+{
+    RecoPoolWorker* pWorker = (RecoPoolWorker*)pvWorker;
+    pWorker->pPool->WorkerProc(pWorker->pRecognizer);
+    return NULL;
+}
+#endif
+
+/////////////////////////////////////////////////////////
+//
+// CRecoWorkerPool::WorkerProc
+//
+// A worker thread: waits for a job, takes its tasks one at
+// a time and runs them outside the lock.
+//
+/////////////////////////////////////////////////////////
+void CRecoWorkerPool::WorkerProc(IStrokeRecognizer* pRecognizer)
+{
+    bool bReady = pRecognizer->BeginThread();
+
+    SyncLock(m_pSync);
+    m_cStarted++;
+    if (false == bReady)
+        m_cFailed++;
+    SyncWakeAll(m_pSync);
+    if (false == bReady)
+    {
+        SyncUnlock(m_pSync);
+        return;
+    }
+
+    while (false == m_bStop)
+    {
+        // No job, or all the tasks of the job are taken
+        if (m_iNextTask >= m_cTasks)
+        {
+            SyncWait(m_pSync, 0);
+            continue;
+        }
+
+        RecoTask* pTask = m_pTasks + m_iNextTask++;
+        RecoCancel cancel = m_cancel;
+        SyncUnlock(m_pSync);
+
+        if (cancel.IsCancelled())
+        {
+            pTask->cAlternates = -1;
+        }
+        else
+        {
+            TRACE_SCOPE("Recognition task");
+            pTask->cAlternates = pRecognizer->Recognize(*pTask->pInk, cancel,
+                                                        pTask->rgAlternates,
+                                                        BR_MAX_ALTERNATES);
+        }
+
+        SyncLock(m_pSync);
+        if (++m_cTasksDone == m_cTasks)
+            SyncWakeAll(m_pSync);
+    }
+    SyncUnlock(m_pSync);
+
+    pRecognizer->EndThread();
+}
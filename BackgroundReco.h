@@ -0,0 +1,338 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      BackgroundReco.h
+//
+// Description:
+//      Background handwriting recognition. The application hands a copy
+//      of its ink to CBackgroundRecognizer after every stroke and goes
+//      on collecting ink; a worker thread waits until the strokes stop
+//      coming for a debounce interval, recognizes the ink and tells the
+//      application that the results are ready.
+//
+//      Every submission and every cancellation bumps a generation
+//      counter. A job that's superseded while it waits is dropped, a job
+//      that's superseded while it runs sees its generation go stale and
+//      stops, and results are delivered only for the latest generation,
+//      so the results pane never shows the text of ink that's gone.
+//
+//      The recognizer is pluggable (IStrokeRecognizer). The application
+//      uses the Tablet PC recognizer (InkTextRecognizer.h);
+//      CGestureTextRecognizer is a deterministic stand-in on top of the
+//      native gesture engine that runs anywhere, for the console tools.
+//
+//      CRecoWorkerPool runs several recognitions at once, one per worker
+//      thread, each worker with its own recognizer; the guided
+//      recognition (GuidedReco.h) recognizes the cells of a guide on it.
+//
+//      The methods of the classes are defined in the BackgroundReco.cpp
+//      file.
+//--------------------------------------------------------------------------
+
+#pragma once
+
+#include "PerfTimer.h"
+#include "GestureEngine.h"
+#include "GestureConfig.h"
+
+enum {
+    BR_MAX_ALTERNATES = 5,      // CRecoOutputWnd::mc_iNumResults
+    BR_MAX_TEXT = 256,          // the size of an alternate's text, in bytes
+    BR_DEBOUNCE_MS = 300,       // the default quiet time before recognizing
+    BR_MAX_WORKERS = 16         // the most threads of a CRecoWorkerPool
+};
+
+class IRecoConstraint;      // RecoConstraint.h
+
+// A recognition alternate
+struct RecoAlternate
+{
+    char    szText[BR_MAX_TEXT];    // UTF-8
+    float   fScore;                 // 0..1, or -1 if the recognizer has none
+};
+
+/////////////////////////////////////////////////////////
+//
+// class CRecoInk
+//
+// The points of a few strokes, in ink units, in one
+// growing buffer. Every stroke is tagged with the cell of
+// the guide it's written in, row by row, with the number of
+// the cells in a row; without a guide all the strokes are
+// in cell 0. The ink also carries the input scope it's
+// recognized in, so a job never sees the scope of another,
+// and may carry the configuration snapshot its job pinned,
+// so all the parts of a job see the same one.
+//
+/////////////////////////////////////////////////////////
+
+class CRecoInk
+{
+    GesturePoint*   m_pPoints;
+    int             m_cPoints;
+    int             m_cMaxPoints;
+    int*            m_piStrokeEnds;     // the end of each stroke in m_pPoints
+    int*            m_piStrokeCells;    // the cell of each stroke
+    int             m_cStrokes;
+    int             m_cMaxStrokes;
+    int             m_cCellColumns;     // the cells in a row of the guide
+    const IRecoConstraint* m_pConstraint;   // the input scope, NULL if none
+    bool            m_bCoerce;          // only the text the scope accepts
+    const GestureSnapshot* m_pSnapshot; // pinned by the job, NULL if none;
+                                        // not copied, the job owns it
+
+public:
+
+    // Constructor and destructor
+    CRecoInk();
+    ~CRecoInk();
+
+    bool AddStroke(const GesturePoint* ppt, int cPoints, int iCell = 0);
+    bool Copy(const CRecoInk& ink);
+    void Swap(CRecoInk& ink);
+    void Clear() { m_cPoints = m_cStrokes = 0; }
+
+    // Data members access methods
+    int  GetStrokeCount() const { return m_cStrokes; }
+    int  GetPointCount() const { return m_cPoints; }
+    const GesturePoint* GetStroke(int iStroke, int& cPoints) const;
+    int  GetStrokeCell(int iStroke) const { return m_piStrokeCells[iStroke]; }
+    void SetStrokeCell(int iStroke, int iCell) { m_piStrokeCells[iStroke] = iCell; }
+    int  GetCellColumns() const { return m_cCellColumns; }
+    void SetCellColumns(int cColumns) { m_cCellColumns = cColumns; }
+    const IRecoConstraint* GetConstraint() const { return m_pConstraint; }
+    bool IsCoerced() const { return m_bCoerce; }
+    void SetConstraint(const IRecoConstraint* pConstraint, bool bCoerce)
+        { m_pConstraint = pConstraint; m_bCoerce = bCoerce; }
+    const GestureSnapshot* GetSnapshot() const { return m_pSnapshot; }
+    void SetSnapshot(const GestureSnapshot* pSnapshot) { m_pSnapshot = pSnapshot; }
+
+private:
+
+    // Not copyable, use Copy
+    CRecoInk(const CRecoInk&);
+    CRecoInk& operator=(const CRecoInk&);
+};
+
+// Tells a running recognition that its job has been superseded
+struct RecoCancel
+{
+    const volatile long*    plGeneration;   // the latest generation
+    long                    lGeneration;    // the job's generation
+
+    bool IsCancelled() const { return *plGeneration != lGeneration; }
+};
+
+/////////////////////////////////////////////////////////
+//
+// class IStrokeRecognizer
+//
+// A handwriting recognizer. All the methods are called on
+// the one thread that runs it, the worker thread of a
+// CBackgroundRecognizer or of a CRecoWorkerPool: BeginThread
+// when it starts, before any Recognize, and EndThread when
+// it ends.
+//
+/////////////////////////////////////////////////////////
+
+class IStrokeRecognizer
+{
+public:
+
+    virtual ~IStrokeRecognizer() {}
+
+    virtual bool BeginThread() { return true; }
+    virtual void EndThread() {}
+
+    // Returns the number of alternates, best first, or -1 if the
+    // recognition failed or was cancelled. Long recognitions should
+    // check the cancel every now and then.
+    virtual int  Recognize(const CRecoInk& ink, const RecoCancel& cancel,
+                           RecoAlternate* pAlternates, int cMaxAlternates) = 0;
+};
+
+/////////////////////////////////////////////////////////
+//
+// class CGestureTextRecognizer
+//
+// The stand-in recognizer: every stroke reads as the name
+// of the gesture it looks like. The best alternate has the
+// best gesture of every stroke, the next ones vary the last
+// stroke over its next best gestures. The results depend on
+// the ink and the templates only. The templates are either
+// an engine's, unchanged while recognizing, or the snapshot
+// of a configuration current when a job starts, the same
+// for all the strokes of the job.
+//
+/////////////////////////////////////////////////////////
+
+class CGestureTextRecognizer : public IStrokeRecognizer
+{
+    const CGestureEngine*   m_pEngine;      // NULL if m_pConfig is used
+    CGestureConfig*         m_pConfig;
+
+public:
+
+    CGestureTextRecognizer(const CGestureEngine& engine) :
+        m_pEngine(&engine), m_pConfig(NULL) {}
+    CGestureTextRecognizer(CGestureConfig& config) :
+        m_pEngine(NULL), m_pConfig(&config) {}
+
+    virtual int Recognize(const CRecoInk& ink, const RecoCancel& cancel,
+                          RecoAlternate* pAlternates, int cMaxAlternates);
+
+private:
+
+    int RecognizeWith(const CGestureEngine& engine, const CRecoInk& ink,
+                      const RecoCancel& cancel, RecoAlternate* pAlternates,
+                      int cMaxAlternates);
+};
+
+// Called on the worker thread when the results of a generation are ready
+typedef void (*PFNRECONOTIFY)(void* pvContext, long lGeneration);
+
+// The job counts of a CBackgroundRecognizer
+struct RecoStats
+{
+    unsigned int    cSubmitted;     // Submit calls
+    unsigned int    cSuperseded;    // dropped before they started
+    unsigned int    cCancelled;     // stopped or discarded after they started
+    unsigned int    cFailed;        // the recognizer failed
+    unsigned int    cDelivered;     // results delivered
+};
+
+/////////////////////////////////////////////////////////
+//
+// class CBackgroundRecognizer
+//
+// Runs an IStrokeRecognizer on a worker thread. Submit,
+// Cancel and GetResults are called on the application's
+// thread; none of them waits for a recognition.
+//
+/////////////////////////////////////////////////////////
+
+class CBackgroundRecognizer
+{
+    struct RecoSync*        m_pSync;        // the thread, lock and condition
+    IStrokeRecognizer*      m_pRecognizer;
+    PFNRECONOTIFY           m_pfnNotify;
+    void*                   m_pvContext;
+    PERFTIME                m_ptDebounce;
+
+    // The state below is guarded by the lock
+    volatile long           m_lGeneration;  // the latest generation
+    bool                    m_bPending;     // m_inkPending waits to be recognized
+    long                    m_lPendingGeneration;
+    PERFTIME                m_ptDue;        // when the pending job may start
+    bool                    m_bStop;
+    bool                    m_bThreadReady; // BeginThread has returned
+    bool                    m_bThreadFailed;
+    CRecoInk                m_inkPending;
+    long                    m_lResultGeneration;
+    int                     m_cResults;
+    RecoAlternate           m_rgResults[BR_MAX_ALTERNATES];
+    RecoStats               m_stats;
+
+    // The worker's own ink, swapped with m_inkPending
+    CRecoInk                m_inkWork;
+
+public:
+
+    // Constructor and destructor
+    CBackgroundRecognizer();
+    ~CBackgroundRecognizer();
+
+    bool Start(IStrokeRecognizer* pRecognizer, PFNRECONOTIFY pfnNotify,
+               void* pvContext, int cDebounceMs);
+    void Stop();
+    bool IsStarted() const { return (NULL != m_pSync); }
+
+    long Submit(const CRecoInk& ink, bool bImmediate);
+    void Cancel();
+    int  GetResults(long lGeneration, RecoAlternate* pAlternates, int cMaxAlternates);
+    void GetStats(RecoStats& stats);
+
+private:
+
+    void ThreadProc();
+#ifdef _WIN32
+    static DWORD WINAPI ThreadStart(void* pvThis);
+#else
+    static void* ThreadStart(void* pvThis);
+#endif
+
+    // Not copyable
+    CBackgroundRecognizer(const CBackgroundRecognizer&);
+    CBackgroundRecognizer& operator=(const CBackgroundRecognizer&);
+};
+
+// A recognition of its own ink on a CRecoWorkerPool
+struct RecoTask
+{
+    const CRecoInk*     pInk;
+    int                 cAlternates;    // -1 if failed or cancelled
+    RecoAlternate       rgAlternates[BR_MAX_ALTERNATES];
+};
+
+/////////////////////////////////////////////////////////
+//
+// class CRecoWorkerPool
+//
+// A fixed set of worker threads, each one with its own
+// recognizer, that run the tasks of a job in parallel: the
+// workers take the next task as they're done with one, so
+// the job takes about the time of its slowest task when
+// there are as many workers as tasks. Run is called by one
+// thread at a time.
+//
+/////////////////////////////////////////////////////////
+
+class CRecoWorkerPool
+{
+    struct RecoSync*        m_pSync;        // the lock and condition
+    struct RecoPoolWorker*  m_pWorkers;
+    int                     m_cWorkers;
+
+    // The state below is guarded by the lock
+    RecoTask*               m_pTasks;       // the job, NULL between the jobs
+    int                     m_cTasks;
+    int                     m_iNextTask;    // the next task to take
+    int                     m_cTasksDone;
+    RecoCancel              m_cancel;
+    bool                    m_bStop;
+    int                     m_cStarted;     // the workers past BeginThread
+    int                     m_cFailed;
+
+public:
+
+    // Constructor and destructor
+    CRecoWorkerPool();
+    ~CRecoWorkerPool();
+
+    bool Start(IStrokeRecognizer* const* ppRecognizers, int cWorkers);
+    void Stop();
+    bool IsStarted() const { return (NULL != m_pSync); }
+    int  GetWorkerCount() const { return m_cWorkers; }
+
+    bool Run(RecoTask* pTasks, int cTasks, const RecoCancel& cancel);
+
+    static int GetProcessorCount();
+
+private:
+
+    void WorkerProc(IStrokeRecognizer* pRecognizer);
+#ifdef _WIN32
+    static DWORD WINAPI ThreadStart(void* pvWorker);
+#else
+    static void* ThreadStart(void* pvWorker);
+#endif
+
+    // Not copyable
+    CRecoWorkerPool(const CRecoWorkerPool&);
+    CRecoWorkerPool& operator=(const CRecoWorkerPool&);
+};
@@ -31,6 +31,10 @@ extern CComModule _Module;
 
 // The application header files
 #include "resource.h"       // main symbols, including command ID's
+#include "Trace.h"          // defines the TRACE_SCOPE trace points
+#include "Metrics.h"        // defines CMetrics, which gets the paint times
+#include "BackgroundReco.h" // defines RecoAlternate
+#include "StrokePredictor.h" // defines SP_TAIL_POINTS
 #include "ChildWnds.h"      // contains the CInkInputWnd and CRecoOutputWnd definitions
 
 #define CLR_BLUE    RGB(0x00,0x00,0x80)
@@ -50,16 +54,341 @@ extern CComModule _Module;
 //     none
 //
 /////////////////////////////////////////////////////////
-CInkInputWnd::CInkInputWnd() : m_cRows(0), m_cColumns(0), m_iMidline(-1)
+CInkInputWnd::CInkInputWnd()
+        : m_cRows(0), m_cColumns(0), m_iMidline(-1), m_pMetrics(NULL),
+          m_hdcCommitted(NULL), m_hbmCommitted(NULL), m_hbmOld(NULL),
+          m_bCommittedValid(false)
 {
     m_szWritingBox.cx = m_szWritingBox.cy = 0;
+    m_szCommitted.cx = m_szCommitted.cy = 0;
     ::SetRectEmpty(&m_rcDrawnBox);
+    ::SetRectEmpty(&m_rcTail);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkInputWnd::~CInkInputWnd
+//
+// Destructor.
+//
+/////////////////////////////////////////////////////////
+CInkInputWnd::~CInkInputWnd()
+{
+    if (NULL != m_hdcCommitted)
+    {
+        ::SelectObject(m_hdcCommitted, m_hbmOld);
+        ::DeleteDC(m_hdcCommitted);
+    }
+    if (NULL != m_hbmCommitted)
+    {
+        ::DeleteObject(m_hbmCommitted);
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkInputWnd::SetInk
+//
+// Data members access method for setting the ink the
+// committed layer is drawn from, and the renderer that
+// draws it. The layer is redrawn by the next paint.
+//
+// Parameters:
+//     IInkRenderer* pIInkRenderer : [in] the InkCollector's renderer
+//     IInkDisp* pIInkDisp         : [in] the InkCollector's ink
+//
+// Return Values (void):
+//      none
+//
+/////////////////////////////////////////////////////////
+void CInkInputWnd::SetInk(IInkRenderer* pIInkRenderer, IInkDisp* pIInkDisp)
+{
+    m_spIInkRenderer = pIInkRenderer;
+    m_spIInkDisp = pIInkDisp;
+    ResetCommitted();
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkInputWnd::CommitStroke
+//
+// Draws a new stroke into the committed layer. The window
+// isn't invalidated: the InkCollector has already drawn
+// the stroke on it, with the same pixels.
+//
+// Parameters:
+//     IInkStrokeDisp* pIInkStroke : [in] the stroke, in the ink of SetInk
+//
+// Return Values (void):
+//      none
+//
+/////////////////////////////////////////////////////////
+void CInkInputWnd::CommitStroke(IInkStrokeDisp* pIInkStroke)
+{
+    // A layer that isn't valid is drawn whole, with the stroke,
+    // by the next paint
+    if (m_bCommittedValid && m_spIInkRenderer != NULL && NULL != pIInkStroke)
+    {
+        TRACE_SCOPE("Commit stroke");
+        m_spIInkRenderer->DrawStroke((LONG_PTR)m_hdcCommitted, pIInkStroke, NULL);
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkInputWnd::ResetCommitted
+//
+// Has the committed layer redrawn whole, from the ink, by
+// the next paint, for the changes that aren't new strokes:
+// a clear, an undo or a redo, a new guide.
+//
+// Parameters:
+//     none
+//
+// Return Values (void):
+//      none
+//
+/////////////////////////////////////////////////////////
+void CInkInputWnd::ResetCommitted()
+{
+    m_bCommittedValid = false;
+    ::SetRectEmpty(&m_rcTail);     // the paint erases it
+    if (IsWindow())
+    {
+        Invalidate();
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkInputWnd::DrawPrediction
+//
+// Replaces the predicted tail of the stroke being written:
+// erases the one drawn, and draws the new one with the
+// stroke's color and width. The tail isn't in the layer,
+// and the next paint of its pixels erases it too.
+//
+// Parameters:
+//     IInkStrokeDisp* pIInkStroke : [in] the stroke being written
+//     const GesturePoint* ppt     : [in] the tail in ink space, from the
+//                                   last packet of the stroke
+//     int cPoints                 : [in] the number of the points, 0 to
+//                                   erase the tail only
+//
+// Return Values (void):
+//      none
+//
+/////////////////////////////////////////////////////////
+void CInkInputWnd::DrawPrediction(
+        IInkStrokeDisp* pIInkStroke,
+        const GesturePoint* ppt,
+        int cPoints
+        )
+{
+    if (m_spIInkRenderer == NULL || NULL == pIInkStroke)
+        return;
+    HDC hdc = GetDC();
+    if (NULL == hdc)
+        return;
+
+    EraseTail(hdc, pIInkStroke);
+    if (cPoints >= 2)
+    {
+        TRACE_SCOPE("Draw prediction");
+
+        // The tail and the width of the stroke in pixels
+        POINT rgpt[SP_TAIL_POINTS + 1];
+        if (cPoints > SP_TAIL_POINTS + 1)
+            cPoints = SP_TAIL_POINTS + 1;
+        RECT rcTail;
+        for (int i = 0; i < cPoints; i++)
+        {
+            long x = (long)ppt[i].x;
+            long y = (long)ppt[i].y;
+            m_spIInkRenderer->InkSpaceToPixel((LONG_PTR)hdc, &x, &y);
+            rgpt[i].x = x;
+            rgpt[i].y = y;
+            if (0 == i)
+            {
+                ::SetRect(&rcTail, x, y, x, y);
+                continue;
+            }
+            rcTail.left = min(rcTail.left, x);
+            rcTail.top = min(rcTail.top, y);
+            rcTail.right = max(rcTail.right, x);
+            rcTail.bottom = max(rcTail.bottom, y);
+        }
+
+        long lColor = 0;
+        float fWidth = 53.0f;   // the InkCollector's default, in ink units
+        CComPtr<IInkDrawingAttributes> spIInkDrawAttr;
+        if (SUCCEEDED(pIInkStroke->get_DrawingAttributes(&spIInkDrawAttr)))
+        {
+            spIInkDrawAttr->get_Color(&lColor);
+            spIInkDrawAttr->get_Width(&fWidth);
+        }
+        long x0 = 0, y0 = 0, cxPen = (long)fWidth, cyPen = 0;
+        m_spIInkRenderer->InkSpaceToPixel((LONG_PTR)hdc, &x0, &y0);
+        m_spIInkRenderer->InkSpaceToPixel((LONG_PTR)hdc, &cxPen, &cyPen);
+        cxPen = max(cxPen - x0, 1);
+
+        LOGBRUSH lb = { BS_SOLID, (COLORREF)lColor, 0 };
+        HPEN hpen = ::ExtCreatePen(PS_GEOMETRIC | PS_SOLID | PS_ENDCAP_ROUND | PS_JOIN_ROUND,
+                                   cxPen, &lb, 0, NULL);
+        if (NULL != hpen)
+        {
+            HGDIOBJ hpenOld = ::SelectObject(hdc, hpen);
+            ::Polyline(hdc, rgpt, cPoints);
+            ::SelectObject(hdc, hpenOld);
+            ::DeleteObject(hpen);
+            ::InflateRect(&rcTail, cxPen / 2 + 1, cxPen / 2 + 1);
+            m_rcTail = rcTail;
+        }
+    }
+
+    ReleaseDC(hdc);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkInputWnd::ErasePrediction
+//
+// Erases the predicted tail, when the stroke ends.
+//
+// Parameters:
+//     IInkStrokeDisp* pIInkStroke : [in] the stroke, to draw again
+//                                   under the tail, may be NULL
+//
+// Return Values (void):
+//      none
+//
+/////////////////////////////////////////////////////////
+void CInkInputWnd::ErasePrediction(IInkStrokeDisp* pIInkStroke)
+{
+    if (::IsRectEmpty(&m_rcTail))
+        return;
+    HDC hdc = GetDC();
+    if (NULL == hdc)
+        return;
+    EraseTail(hdc, pIInkStroke);
+    ReleaseDC(hdc);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkInputWnd::EraseStrokes
+//
+// Has the pixels of the strokes repainted from the layer,
+// for the strokes the InkCollector drew as they were
+// written and then took out of the ink, a gesture's. With
+// the AutoRedraw off nothing else erases them.
+//
+// Parameters:
+//     IInkStrokes* pInkStrokes : [in] the strokes, may be NULL
+//
+// Return Values (void):
+//      none
+//
+/////////////////////////////////////////////////////////
+void CInkInputWnd::EraseStrokes(IInkStrokes* pInkStrokes)
+{
+    if (NULL == pInkStrokes || m_spIInkRenderer == NULL || !IsWindow())
+        return;
+
+    // The bounds take in the width of the pen
+    CComPtr<IInkRectangle> spIInkRect;
+    RECT rc;
+    if (FAILED(pInkStrokes->GetBoundingBox(IBBM_Default, &spIInkRect))
+        || FAILED(spIInkRect->GetRectangle(&rc.top, &rc.left, &rc.bottom, &rc.right)))
+    {
+        Invalidate();
+        return;
+    }
+
+    HDC hdc = GetDC();
+    if (NULL == hdc)
+    {
+        Invalidate();
+        return;
+    }
+    m_spIInkRenderer->InkSpaceToPixel((LONG_PTR)hdc, &rc.left, &rc.top);
+    m_spIInkRenderer->InkSpaceToPixel((LONG_PTR)hdc, &rc.right, &rc.bottom);
+    ReleaseDC(hdc);
+
+    // Two pixels more for the rounding and the antialiasing
+    ::InflateRect(&rc, 2, 2);
+    InvalidateRect(&rc, FALSE);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkInputWnd::EraseTail
+//
+// Copies the committed layer over the predicted tail and
+// draws the stroke being written again in its rectangle,
+// since the real ink may have come where the tail was.
+// Without a valid layer the rectangle is left to a paint.
+//
+/////////////////////////////////////////////////////////
+void CInkInputWnd::EraseTail(HDC hdc, IInkStrokeDisp* pIInkStroke)
+{
+    if (::IsRectEmpty(&m_rcTail))
+        return;
+
+    if (m_bCommittedValid)
+    {
+        const RECT& rc = m_rcTail;
+        ::BitBlt(hdc, rc.left, rc.top, rc.right - rc.left, rc.bottom - rc.top,
+                 m_hdcCommitted, rc.left, rc.top, SRCCOPY);
+        if (NULL != pIInkStroke && m_spIInkRenderer != NULL)
+        {
+            int iSaved = ::SaveDC(hdc);
+            ::IntersectClipRect(hdc, rc.left, rc.top, rc.right, rc.bottom);
+            m_spIInkRenderer->DrawStroke((LONG_PTR)hdc, pIInkStroke, NULL);
+            ::RestoreDC(hdc, iSaved);
+        }
+    }
+    else
+    {
+        InvalidateRect(&m_rcTail, FALSE);
+    }
+    ::SetRectEmpty(&m_rcTail);
 }
 
 /////////////////////////////////////////////////////////
 //
 // CInkInputWnd::SetGuide
 //
+// Data members access method for setting the guide the
+// window draws: the writing box, the drawn box inside it and
+// the number of the rows and columns. No rows means no
+// guide, no columns means a lined guide.
+//
+// Parameters:
+//     const _InkRecoGuide& irg : [in] the guide, in pixels
+//
+// Return Values (void):
+//      none
+//
+/////////////////////////////////////////////////////////
+void CInkInputWnd::SetGuide(const _InkRecoGuide& irg)
+{
+    m_szWritingBox.cx = irg.rectWritingBox.right - irg.rectWritingBox.left;
+    m_szWritingBox.cy = irg.rectWritingBox.bottom - irg.rectWritingBox.top;
+    ::SetRect(&m_rcDrawnBox,
+              irg.rectDrawnBox.left - irg.rectWritingBox.left,
+              irg.rectDrawnBox.top - irg.rectWritingBox.top,
+              irg.rectDrawnBox.right - irg.rectWritingBox.left,
+              irg.rectDrawnBox.bottom - irg.rectWritingBox.top);
+    m_iMidline = irg.midline;
+
+    SetRowsCols(irg.cRows, irg.cColumns);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkInputWnd::SetRowsCols
+//
 // Data members access method for setting the number
 // of the guide's rows and columns.
 //
@@ -76,11 +405,8 @@ void CInkInputWnd::SetRowsCols(int iRows, int iColumns)
     m_cRows = iRows;
     m_cColumns = iColumns;
 
-    // Update the window
-    if (IsWindow())
-    {
-        Invalidate();
-    }
+    // Update the window; the guide is in the committed layer
+    ResetCommitted();
 }
 
 /////////////////////////////////////////////////////////
@@ -90,8 +416,9 @@ void CInkInputWnd::SetRowsCols(int iRows, int iColumns)
 // The WM_PAINT message handler. The ATL calls this member
 // function when Windows or an application makes a request
 // to repaint a portion of the CInkInputWnd object's window.
-// The method paints the window's background and draws
-// the guide if necessary.
+// The method copies the portion from the committed layer,
+// which it redraws first if it's not valid or the window's
+// size has changed.
 //
 // Parameters:
 //     defined in the ATL's MESSAGE_HANDLER macro,
@@ -104,6 +431,9 @@ void CInkInputWnd::SetRowsCols(int iRows, int iColumns)
 LRESULT CInkInputWnd::OnPaint(UINT /*uMsg*/, WPARAM /*wParam*/,
                               LPARAM /*lParam*/, BOOL& /*bHandled*/)
 {
+    TRACE_SCOPE("Paint input");
+    PERFTIME ptStart = PerfNow();
+
     RECT rcClip;
     if (FALSE == GetUpdateRect(&rcClip))
         return 0;   // there's no update region, so no painting is needed
@@ -116,13 +446,134 @@ LRESULT CInkInputWnd::OnPaint(UINT /*uMsg*/, WPARAM /*wParam*/,
     // Get the rectangle to paint.
     GetClipBox(hdc, &rcClip);
 
-    // Paint the background.
-    ::FillRect(hdc, &rcClip, (HBRUSH)::GetStockObject(DC_BRUSH));
+    if (UpdateCommitted(hdc))
+    {
+        ::BitBlt(hdc, rcClip.left, rcClip.top,
+                 rcClip.right - rcClip.left, rcClip.bottom - rcClip.top,
+                 m_hdcCommitted, rcClip.left, rcClip.top, SRCCOPY);
+    }
+    else
+    {
+        // Out of memory for the layer: the background and the guide only
+        DrawBackground(hdc, rcClip);
+    }
 
     EndPaint(&ps);
+
+    if (NULL != m_pMetrics)
+    {
+        m_pMetrics->RecordPaint(PerfNow() - ptStart);
+    }
     return 0;
 }
 
+/////////////////////////////////////////////////////////
+//
+// CInkInputWnd::UpdateCommitted
+//
+// Makes the committed layer the size of the window and
+// redraws it whole, the background, the guide and all the
+// strokes, if it's not valid.
+//
+// Parameters:
+//     HDC hdc : [in] the window's device context
+//
+// Return Values (bool):
+//      true if the layer is valid, false if it couldn't be made
+//
+/////////////////////////////////////////////////////////
+bool CInkInputWnd::UpdateCommitted(HDC hdc)
+{
+    RECT rcClient;
+    GetClientRect(&rcClient);
+    if (NULL == m_hdcCommitted
+        || rcClient.right != m_szCommitted.cx || rcClient.bottom != m_szCommitted.cy)
+    {
+        if (NULL == m_hdcCommitted)
+        {
+            m_hdcCommitted = ::CreateCompatibleDC(hdc);
+            if (NULL == m_hdcCommitted)
+                return false;
+        }
+        HBITMAP hbm = ::CreateCompatibleBitmap(hdc, rcClient.right, rcClient.bottom);
+        if (NULL == hbm)
+            return false;
+        HGDIOBJ hbmPrev = ::SelectObject(m_hdcCommitted, hbm);
+        if (NULL == m_hbmCommitted)
+            m_hbmOld = hbmPrev;
+        else
+            ::DeleteObject(m_hbmCommitted);
+        m_hbmCommitted = hbm;
+        m_szCommitted.cx = rcClient.right;
+        m_szCommitted.cy = rcClient.bottom;
+        m_bCommittedValid = false;
+    }
+
+    if (false == m_bCommittedValid)
+    {
+        TRACE_SCOPE("Redraw committed ink");
+        DrawBackground(m_hdcCommitted, rcClient);
+
+        CComPtr<IInkStrokes> spIInkStrokes;
+        if (m_spIInkRenderer != NULL && m_spIInkDisp != NULL
+            && SUCCEEDED(m_spIInkDisp->get_Strokes(&spIInkStrokes)))
+        {
+            m_spIInkRenderer->Draw((LONG_PTR)m_hdcCommitted, spIInkStrokes);
+        }
+        m_bCommittedValid = true;
+    }
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkInputWnd::DrawBackground
+//
+// Paints the background and draws the guide, if there's
+// one, into a rectangle of a device context.
+//
+// Parameters:
+//     HDC hdc          : [in] the device context
+//     const RECT& rc   : [in] the rectangle
+//
+// Return Values (void):
+//      none
+//
+/////////////////////////////////////////////////////////
+void CInkInputWnd::DrawBackground(HDC hdc, const RECT& rc)
+{
+    // Paint the background.
+    ::FillRect(hdc, &rc, (HBRUSH)::GetStockObject(DC_BRUSH));
+
+    // Draw the guide: the baseline of every line, or the drawn
+    // box of every cell
+    if (0 != m_cRows)
+    {
+        HGDIOBJ hOldPen = ::SelectObject(hdc, ::GetStockObject(DC_PEN));
+        HGDIOBJ hOldBrush = ::SelectObject(hdc, ::GetStockObject(NULL_BRUSH));
+        COLORREF clrOld = ::SetDCPenColor(hdc, CLR_GRAY);
+        for (int iRow = 0; iRow < m_cRows; iRow++)
+        {
+            int y = iRow * m_szWritingBox.cy;
+            if (0 == m_cColumns)
+            {
+                ::MoveToEx(hdc, m_rcDrawnBox.left, y + m_rcDrawnBox.bottom, NULL);
+                ::LineTo(hdc, m_rcDrawnBox.right, y + m_rcDrawnBox.bottom);
+                continue;
+            }
+            for (int iColumn = 0; iColumn < m_cColumns; iColumn++)
+            {
+                int x = iColumn * m_szWritingBox.cx;
+                ::Rectangle(hdc, x + m_rcDrawnBox.left, y + m_rcDrawnBox.top,
+                            x + m_rcDrawnBox.right, y + m_rcDrawnBox.bottom);
+            }
+        }
+        ::SetDCPenColor(hdc, clrOld);
+        ::SelectObject(hdc, hOldBrush);
+        ::SelectObject(hdc, hOldPen);
+    }
+}
+
 
 ////////////////////////////////////////////////////////
 // CRecoOutputWnd methods
@@ -139,7 +590,8 @@ LRESULT CInkInputWnd::OnPaint(UINT /*uMsg*/, WPARAM /*wParam*/,
 //
 /////////////////////////////////////////////////////////
 CRecoOutputWnd::CRecoOutputWnd()
-        : m_hFont(NULL), m_iFontName(-1), m_nGesture(0), m_bNewGesture(false)
+        : m_hFont(NULL), m_iFontName(-1), m_nGesture(0), m_bNewGesture(false),
+          m_pMetrics(NULL)
 {
     UpdateFont(::GetUserDefaultLangID());
 }
@@ -180,6 +632,9 @@ CRecoOutputWnd::~CRecoOutputWnd()
 LRESULT CRecoOutputWnd::OnPaint(UINT /*uMsg*/, WPARAM /*wParam*/,
                                 LPARAM /*lParam*/, BOOL& /*bHandled*/)
 {
+    TRACE_SCOPE("Paint results");
+    PERFTIME ptStart = PerfNow();
+
     RECT rc;
     if (FALSE == GetUpdateRect(&rc))
         return 0;   // there's no update region, so no painting is needed
@@ -245,6 +700,11 @@ LRESULT CRecoOutputWnd::OnPaint(UINT /*uMsg*/, WPARAM /*wParam*/,
     }
 
     EndPaint(&ps);
+
+    if (NULL != m_pMetrics)
+    {
+        m_pMetrics->RecordPaint(PerfNow() - ptStart);
+    }
     return 0;
 }
 
@@ -379,3 +839,38 @@ void CRecoOutputWnd::SetGestureName(UINT nGesture)
     m_nGesture = nGesture;
     m_bNewGesture = true;
 }
+
+/////////////////////////////////////////////////////////
+//
+// CRecoOutputWnd::SetResults
+//
+//     The method is called by the application when the
+//     background recognition delivers its results. The
+//     alternates become the result strings and are drawn
+//     as the latest results.
+//
+// Parameters:
+//     const RecoAlternate* pAlternates : [in] the alternates, best first
+//     int cAlternates                  : [in] the number of the alternates
+//
+// Return Value (void):
+//     none
+//
+/////////////////////////////////////////////////////////
+void CRecoOutputWnd::SetResults(const RecoAlternate* pAlternates, int cAlternates)
+{
+    WCHAR szText[BR_MAX_TEXT];
+    for (int i = 0; i < mc_iNumResults; i++)
+    {
+        if (i < cAlternates && 0 != ::MultiByteToWideChar(CP_UTF8, 0, pAlternates[i].szText, -1,
+                                                          szText, sizeof(szText)/sizeof(szText[0])))
+        {
+            m_bstrResults[i] = szText;
+        }
+        else
+        {
+            m_bstrResults[i].Empty();
+        }
+    }
+    m_bNewGesture = false;
+}
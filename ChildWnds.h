@@ -25,6 +25,18 @@
 // may draw itself with lined or boxed guides or with no guides at all.
 //
 // An object of the class is used in the CAdvRecoApp for pen input.
+// The window paints from its committed layer, a memory bitmap of the
+// background, the guide and the committed strokes: a stroke is drawn
+// into it once, when it's committed, and a repaint copies the update
+// region from it. The InkCollector draws the stroke being written
+// over the window, and doesn't redraw the ink itself (AutoRedraw is
+// off). See InkLayers.h for the same layers over the software
+// rasterizer.
+//
+// Ahead of the stroke being written the window draws a short tail
+// to where the pen is predicted to be (see StrokePredictor.h), and
+// erases it as the packets come: the committed layer is copied over
+// it and the stroke being written drawn again where it was.
 //
 /////////////////////////////////////////////////////////
 
@@ -37,15 +49,42 @@ class CInkInputWnd :
     int     m_cRows;			// the number of rows in the guide
     int     m_cColumns;			// the number of columns in the guide
     int     m_iMidline;			// the position of the midline the writing box
+    CMetrics* m_pMetrics;       // receives the paint times, may be NULL
+
+    // The committed layer, redrawn whole by the next paint if not valid
+    HDC     m_hdcCommitted;
+    HBITMAP m_hbmCommitted;
+    HGDIOBJ m_hbmOld;           // the bitmap m_hdcCommitted was created with
+    SIZE    m_szCommitted;
+    bool    m_bCommittedValid;
+    CComPtr<IInkRenderer>   m_spIInkRenderer;   // draws the strokes into the layer
+    CComPtr<IInkDisp>       m_spIInkDisp;       // the committed strokes
+
+    // The predicted tail drawn, empty if none
+    RECT    m_rcTail;
 
 public:
 
-	// Constructor
+	// Constructor and destructor
     CInkInputWnd();
+    ~CInkInputWnd();
 
     // Data members access methods 
     void SetGuide(const _InkRecoGuide& irg);
     void SetRowsCols(int iRows, int iColumns);
+    void SetMetrics(CMetrics* pMetrics) { m_pMetrics = pMetrics; }
+    void SetInk(IInkRenderer* pIInkRenderer, IInkDisp* pIInkDisp);
+
+    // The committed layer
+    void CommitStroke(IInkStrokeDisp* pIInkStroke);
+    void ResetCommitted();
+
+    // The predicted tail of the stroke being written
+    void DrawPrediction(IInkStrokeDisp* pIInkStroke, const GesturePoint* ppt, int cPoints);
+    void ErasePrediction(IInkStrokeDisp* pIInkStroke);
+
+    // The strokes drawn live that aren't in the ink any more
+    void EraseStrokes(IInkStrokes* pInkStrokes);
 
 // Declare the objects' window class with NULL background (-1) to avoid flicking
 // that happens because of delays between WM_ERASEBKGND and WM_PAINT messages 
@@ -60,6 +99,12 @@ END_MSG_MAP()
     // WM_PAINT message handler
 	LRESULT OnPaint(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
 
+private:
+
+    bool UpdateCommitted(HDC hdc);
+    void EraseTail(HDC hdc, IInkStrokeDisp* pIInkStroke);
+    void DrawBackground(HDC hdc, const RECT& rc);
+
 };  // class CInkInputWnd
 
 
@@ -100,6 +145,9 @@ public:
     UINT    m_nGesture;
     bool    m_bNewGesture;
 
+    // Receives the paint times, may be NULL
+    CMetrics* m_pMetrics;
+
 // Constructor and destructor
     
 	CRecoOutputWnd();
@@ -111,6 +159,8 @@ public:
     int GetBestHeight();
     bool UpdateFont(LANGID wLangId);
     void SetGestureName(UINT nGesture);
+    void SetResults(const RecoAlternate* pAlternates, int cAlternates);
+    void SetMetrics(CMetrics* pMetrics) { m_pMetrics = pMetrics; }
 
 // Declare the class objects' window class with NULL background to avoid flicking.
 DECLARE_WND_CLASS_EX(NULL, 0, -1)
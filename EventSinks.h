@@ -23,6 +23,12 @@
 #ifndef DISPID_CEStroke
     #define DISPID_CEStroke                     0x00000001
 #endif
+#ifndef DISPID_CECursorDown
+    #define DISPID_CECursorDown                 0x00000002
+#endif
+#ifndef DISPID_CENewPackets
+    #define DISPID_CENewPackets                 0x00000003
+#endif
 #ifndef DISPID_CEGesture
     #define DISPID_CEGesture                    0x0000000a
 #endif
@@ -41,8 +47,10 @@
 // to implement a sink for the IInkCollectorEvents, fired by 
 // the InkCollector object
 // Since the IDispEventSimpleImpl doesn't require to supply 
-// implementation code for every event, this template has a handler
-// for the Gesture event only.
+// implementation code for every event, this template has handlers
+// for the Gesture event and for the events the input recorder needs:
+// CursorDown, NewPackets and Stroke. The application asks for the
+// latter (SetEventInterest) only while it's recording.
 //
 /////////////////////////////////////////////////////////
 
@@ -55,7 +63,7 @@ class ATL_NO_VTABLE IInkCollectorEventsImpl :
 public:
     // ATL structures with the type information for each event, 
     // handled in this template.(Initialized in the AdvReco.cpp)
-    static const _ATL_FUNC_INFO mc_AtlFuncInfo[1];
+    static const _ATL_FUNC_INFO mc_AtlFuncInfo[4];
 
 BEGIN_SINK_MAP(IInkCollectorEventsImpl)
     SINK_ENTRY_INFO(SINK_ID, 
@@ -63,13 +71,49 @@ BEGIN_SINK_MAP(IInkCollectorEventsImpl)
                     DISPID_CEGesture, 
                     Gesture, 
                     const_cast<_ATL_FUNC_INFO*>(&mc_AtlFuncInfo[0]))
+    SINK_ENTRY_INFO(SINK_ID, 
+                    DIID__IInkCollectorEvents, 
+                    DISPID_CEStroke, 
+                    Stroke, 
+                    const_cast<_ATL_FUNC_INFO*>(&mc_AtlFuncInfo[1]))
+    SINK_ENTRY_INFO(SINK_ID, 
+                    DIID__IInkCollectorEvents, 
+                    DISPID_CECursorDown, 
+                    CursorDown, 
+                    const_cast<_ATL_FUNC_INFO*>(&mc_AtlFuncInfo[2]))
+    SINK_ENTRY_INFO(SINK_ID, 
+                    DIID__IInkCollectorEvents, 
+                    DISPID_CENewPackets, 
+                    NewPackets, 
+                    const_cast<_ATL_FUNC_INFO*>(&mc_AtlFuncInfo[3]))
 END_SINK_MAP()
 
     HRESULT __stdcall Gesture(IInkCursor* pIInkCursor, IInkStrokes* pInkStrokes, 
                               VARIANT vGestures, VARIANT_BOOL* pbCancel)
     {
+        TRACE_SCOPE("Gesture event");
 		T* pT = static_cast<T*>(this);
         return pT->OnGesture(pIInkCursor, pInkStrokes, vGestures, pbCancel);
     }
+
+    HRESULT __stdcall Stroke(IInkCursor* pIInkCursor, IInkStrokeDisp* pInkStroke, 
+                             VARIANT_BOOL* pbCancel)
+    {
+        T* pT = static_cast<T*>(this);
+        return pT->OnStroke(pIInkCursor, pInkStroke, pbCancel);
+    }
+
+    HRESULT __stdcall CursorDown(IInkCursor* pIInkCursor, IInkStrokeDisp* pInkStroke)
+    {
+        T* pT = static_cast<T*>(this);
+        return pT->OnCursorDown(pIInkCursor, pInkStroke);
+    }
+
+    HRESULT __stdcall NewPackets(IInkCursor* pIInkCursor, IInkStrokeDisp* pInkStroke, 
+                                 long lPacketCount, VARIANT* pvPacketData)
+    {
+        T* pT = static_cast<T*>(this);
+        return pT->OnNewPackets(pIInkCursor, pInkStroke, lPacketCount, pvPacketData);
+    }
 };
 
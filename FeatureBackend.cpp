@@ -0,0 +1,185 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      FeatureBackend.cpp
+//
+// Description:
+//      A sample backend library for the gesture recognizer ensemble (see
+//      GestureEnsemble.h), built as a DLL (a shared object elsewhere). It
+//      recognizes a stroke by its coarse feature vector alone, the one
+//      the template index uses: the nearest built-in shape in the feature
+//      space wins. A backend of its own only needs to export
+//      GetGestureBackend and fill in a GestureBackendApi the same way.
+//
+//          GestureBench ensemble -plugin FeatureBackend.dll
+//--------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "GestureEnsemble.h"
+
+#ifdef _WIN32
+#define BACKEND_EXPORT  extern "C" __declspec(dllexport)
+#else
+#define BACKEND_EXPORT  extern "C" __attribute__((visibility("default")))
+#endif
+
+// The feature distance that scores 0
+#define FB_MAX_DISTANCE     2.0f
+
+// A built-in shape in the feature space
+struct FeatureTemplate
+{
+    int     iGesture;
+    float   rgfFeatures[GE_NUM_FEATURES];
+};
+
+// The backend: the features of every built-in shape but the tap
+struct FeatureBackend
+{
+    FeatureTemplate*    pTemplates;
+    int                 cTemplates;
+};
+
+/////////////////////////////////////////////////////////
+//
+// CreateBackend
+//
+// Computes the features of the built-in shapes.
+//
+// Return Values (void*):
+//      the backend, NULL if out of memory
+//
+/////////////////////////////////////////////////////////
+static void* CreateBackend()
+{
+    FeatureBackend* pBackend = (FeatureBackend*)malloc(sizeof(FeatureBackend));
+    int cShapes = CGestureEngine::GetBuiltinShapeCount();
+    FeatureTemplate* pTemplates = (FeatureTemplate*)malloc(cShapes * sizeof(FeatureTemplate));
+    if (NULL == pBackend || NULL == pTemplates)
+    {
+        free(pBackend);
+        free(pTemplates);
+        return NULL;
+    }
+
+    pBackend->pTemplates = pTemplates;
+    pBackend->cTemplates = 0;
+    GesturePoint rgpt[256];
+    GesturePoint rgptNorm[GE_NUM_POINTS];
+    for (int i = 0; i < cShapes; i++)
+    {
+        int iGesture;
+        int cPoints = CGestureEngine::GetBuiltinShape(i, iGesture, rgpt, 256);
+        if (GE_GESTURE_TAP == iGesture || cPoints < 2)
+            continue;
+        FeatureTemplate& t = pTemplates[pBackend->cTemplates++];
+        t.iGesture = iGesture;
+        CGestureEngine::NormalizeStroke(rgpt, cPoints, rgptNorm);
+        CGestureEngine::ComputeFeatures(rgptNorm, t.rgfFeatures);
+    }
+    return pBackend;
+}
+
+static void DestroyBackend(void* pvBackend)
+{
+    FeatureBackend* pBackend = (FeatureBackend*)pvBackend;
+    free(pBackend->pTemplates);
+    free(pBackend);
+}
+
+/////////////////////////////////////////////////////////
+//
+// Recognize
+//
+// Scores every gesture by the feature distance of its
+// nearest shape, best first. Taps are left to the template
+// matcher.
+//
+// Return Values (int):
+//      the number of results
+//
+/////////////////////////////////////////////////////////
+static int Recognize(
+        void* pvBackend,
+        const GesturePoint* ppt,
+        int cPoints,
+        GestureResult* pResults,
+        int cMaxResults
+        )
+{
+    const FeatureBackend* pBackend = (const FeatureBackend*)pvBackend;
+    if (cPoints < 2 || cMaxResults <= 0)
+        return 0;
+
+    float fMinX = ppt[0].x, fMaxX = ppt[0].x, fMinY = ppt[0].y, fMaxY = ppt[0].y;
+    for (int i = 1; i < cPoints; i++)
+    {
+        if (ppt[i].x < fMinX) fMinX = ppt[i].x;
+        if (ppt[i].x > fMaxX) fMaxX = ppt[i].x;
+        if (ppt[i].y < fMinY) fMinY = ppt[i].y;
+        if (ppt[i].y > fMaxY) fMaxY = ppt[i].y;
+    }
+    if (fMaxX - fMinX <= GE_DEFAULT_TAP_EXTENT && fMaxY - fMinY <= GE_DEFAULT_TAP_EXTENT)
+        return 0;
+
+    GesturePoint rgptNorm[GE_NUM_POINTS];
+    float rgfFeatures[GE_NUM_FEATURES];
+    CGestureEngine::NormalizeStroke(ppt, cPoints, rgptNorm);
+    CGestureEngine::ComputeFeatures(rgptNorm, rgfFeatures);
+
+    float rgfScores[GE_NUM_SSGESTURES] = { 0.0f };
+    for (int t = 0; t < pBackend->cTemplates; t++)
+    {
+        float fSum = 0.0f;
+        for (int f = 0; f < GE_NUM_FEATURES; f++)
+        {
+            float d = rgfFeatures[f] - pBackend->pTemplates[t].rgfFeatures[f];
+            fSum += d * d;
+        }
+        float fScore = 1.0f - sqrtf(fSum) / FB_MAX_DISTANCE;
+        int iGesture = pBackend->pTemplates[t].iGesture;
+        if (fScore > rgfScores[iGesture])
+            rgfScores[iGesture] = fScore;
+    }
+
+    // Insert every scored gesture in the sorted results
+    int cResults = 0;
+    for (int g = 0; g < GE_NUM_SSGESTURES; g++)
+    {
+        if (rgfScores[g] <= 0.0f)
+            continue;
+        int i = (cResults < cMaxResults) ? cResults++ : cMaxResults;
+        for (; i > 0 && pResults[i - 1].fScore < rgfScores[g]; i--)
+        {
+            if (i < cMaxResults)
+                pResults[i] = pResults[i - 1];
+        }
+        if (i < cMaxResults)
+        {
+            pResults[i].iGesture = g;
+            pResults[i].iTemplate = -1;
+            pResults[i].fScore = rgfScores[g];
+        }
+    }
+    return cResults;
+}
+
+static const GestureBackendApi gc_api = {
+    GE_BACKEND_API_VERSION,
+    "features",
+    CreateBackend,
+    DestroyBackend,
+    Recognize
+};
+
+BACKEND_EXPORT const GestureBackendApi* GetGestureBackend()
+{
+    return &gc_api;
+}
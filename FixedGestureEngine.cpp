@@ -0,0 +1,646 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      FixedGestureEngine.cpp
+//
+// Description:
+//      The file contains the definitions of the methods of the class
+//      CFixedGestureEngine.
+//      See the file FixedGestureEngine.h for the definition of the class.
+//
+//      The intermediate products are 64-bit. Negative values are scaled
+//      down with an arithmetic right shift, which is what all the
+//      supported compilers generate for signed operands.
+//--------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "FixedGestureEngine.h"
+
+// A useful macro to determine the number of elements in the array
+#ifndef countof
+#define countof(array)  (sizeof(array)/sizeof(array[0]))
+#endif
+
+// The fraction bits of the resampled points, of the trig table and of
+// the point distances. The points are within +-GE_SQUARE_SIZE and the
+// query is rotated by 45 degrees at most, so the coordinate differences
+// stay below 605 and the sum of their squares in Q6 fits in 32 bits.
+#define GE_FX_INK_SHIFT     8
+#define GE_FX_TRIG_SHIFT    15
+#define GE_FX_DIST_SHIFT    6
+
+// 0.70710678 * GE_SQUARE_SIZE in Q16, the same constant as the float
+// engine's GE_HALF_DIAGONAL
+#define GE_FX_HALF_DIAGONAL 11585238
+
+// 0.61803399 in Q16, the golden section ratio
+#define GE_FX_PHI           40503
+
+// The default tap extent and rotation search, the same as the float engine's
+#define GE_FX_DEFAULT_TAP_EXTENT    150
+#define GE_FX_DEFAULT_ANGLE_RANGE   (15 * GE_FX_ANGLE_STEP_DIV)
+#define GE_FX_DEFAULT_ANGLE_PREC    (2 * GE_FX_ANGLE_STEP_DIV)
+
+// sin and cos of 0..GE_FX_MAX_ANGLE angle steps (0..45 degrees) in Q15
+static const int gc_rgiSin[GE_FX_MAX_ANGLE + 1] = {
+        0,   143,   286,   429,   572,   715,   858,  1001,  1144,  1286,
+     1429,  1572,  1715,  1858,  2000,  2143,  2286,  2428,  2571,  2713,
+     2856,  2998,  3141,  3283,  3425,  3567,  3709,  3851,  3993,  4135,
+     4277,  4419,  4560,  4702,  4843,  4985,  5126,  5267,  5408,  5549,
+     5690,  5831,  5971,  6112,  6252,  6393,  6533,  6673,  6813,  6953,
+     7092,  7232,  7371,  7510,  7650,  7788,  7927,  8066,  8204,  8343,
+     8481,  8619,  8757,  8895,  9032,  9169,  9307,  9444,  9580,  9717,
+     9854,  9990, 10126, 10262, 10397, 10533, 10668, 10803, 10938, 11073,
+    11207, 11342, 11476, 11609, 11743, 11876, 12010, 12142, 12275, 12408,
+    12540, 12672, 12803, 12935, 13066, 13197, 13328, 13458, 13589, 13719,
+    13848, 13978, 14107, 14236, 14365, 14493, 14621, 14749, 14876, 15004,
+    15131, 15257, 15384, 15510, 15636, 15761, 15886, 16011, 16136, 16260,
+    16384, 16508, 16631, 16754, 16877, 16999, 17121, 17243, 17364, 17485,
+    17606, 17727, 17847, 17966, 18086, 18205, 18324, 18442, 18560, 18678,
+    18795, 18912, 19028, 19145, 19261, 19376, 19491, 19606, 19720, 19834,
+    19948, 20061, 20174, 20286, 20399, 20510, 20622, 20732, 20843, 20953,
+    21063, 21172, 21281, 21390, 21498, 21605, 21713, 21820, 21926, 22032,
+    22138, 22243, 22348, 22452, 22556, 22659, 22763, 22865, 22967, 23069,
+    23170
+};
+
+static const int gc_rgiCos[GE_FX_MAX_ANGLE + 1] = {
+    32768, 32768, 32767, 32765, 32763, 32760, 32757, 32753, 32748, 32743,
+    32737, 32730, 32723, 32715, 32707, 32698, 32688, 32678, 32667, 32655,
+    32643, 32631, 32617, 32603, 32588, 32573, 32557, 32541, 32524, 32506,
+    32488, 32469, 32449, 32429, 32408, 32387, 32365, 32342, 32319, 32295,
+    32270, 32245, 32219, 32193, 32166, 32138, 32110, 32081, 32052, 32022,
+    31991, 31960, 31928, 31896, 31863, 31829, 31795, 31760, 31724, 31688,
+    31651, 31614, 31576, 31538, 31499, 31459, 31419, 31378, 31336, 31294,
+    31251, 31208, 31164, 31120, 31075, 31029, 30983, 30936, 30888, 30840,
+    30792, 30743, 30693, 30643, 30592, 30540, 30488, 30435, 30382, 30328,
+    30274, 30219, 30163, 30107, 30050, 29993, 29935, 29877, 29818, 29758,
+    29698, 29637, 29576, 29514, 29452, 29389, 29325, 29261, 29197, 29131,
+    29066, 28999, 28932, 28865, 28797, 28729, 28660, 28590, 28520, 28449,
+    28378, 28306, 28234, 28161, 28088, 28014, 27939, 27864, 27789, 27713,
+    27636, 27559, 27482, 27403, 27325, 27246, 27166, 27086, 27005, 26924,
+    26842, 26760, 26677, 26594, 26510, 26426, 26341, 26255, 26170, 26083,
+    25997, 25909, 25822, 25733, 25645, 25555, 25466, 25375, 25285, 25193,
+    25102, 25010, 24917, 24824, 24730, 24636, 24542, 24447, 24351, 24255,
+    24159, 24062, 23965, 23867, 23769, 23670, 23571, 23472, 23372, 23271,
+    23170
+};
+
+/////////////////////////////////////////////////////////
+//
+// CFixedGestureEngine::CFixedGestureEngine
+//
+// Constructor.
+//
+// Parameters:
+//     none
+//
+/////////////////////////////////////////////////////////
+CFixedGestureEngine::CFixedGestureEngine()
+    : m_pTemplates(NULL), m_cTemplates(0), m_cMaxTemplates(0),
+      m_iTapExtent(GE_FX_DEFAULT_TAP_EXTENT),
+      m_iAngleRange(GE_FX_DEFAULT_ANGLE_RANGE), m_iAnglePrecision(GE_FX_DEFAULT_ANGLE_PREC)
+{
+}
+
+/////////////////////////////////////////////////////////
+//
+// CFixedGestureEngine::~CFixedGestureEngine
+//
+// Destructor.
+//
+/////////////////////////////////////////////////////////
+CFixedGestureEngine::~CFixedGestureEngine()
+{
+    RemoveAllTemplates();
+}
+
+/////////////////////////////////////////////////////////
+//
+// CFixedGestureEngine::RemoveAllTemplates
+//
+// Empties the template set.
+//
+// Parameters:
+//     none
+//
+// Return Values (void):
+//      none
+//
+/////////////////////////////////////////////////////////
+void CFixedGestureEngine::RemoveAllTemplates()
+{
+    free(m_pTemplates);
+    m_pTemplates = NULL;
+    m_cTemplates = m_cMaxTemplates = 0;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CFixedGestureEngine::AddTemplate
+//
+// Normalizes the stroke and appends it to the template set.
+//
+// Parameters:
+//     int iGesture              : [in] index into the single stroke gesture table
+//     const GesturePointFx* ppt : [in] the stroke points, in ink units
+//     int cPoints               : [in] the number of points
+//
+// Return Values (bool):
+//      true if succeeded, false if the parameters are invalid
+//      or out of memory
+//
+/////////////////////////////////////////////////////////
+bool CFixedGestureEngine::AddTemplate(
+        int iGesture,
+        const GesturePointFx* ppt,
+        int cPoints
+        )
+{
+    if (iGesture < 0 || iGesture >= GE_NUM_SSGESTURES || NULL == ppt || cPoints <= 0)
+        return false;
+
+    if (m_cTemplates == m_cMaxTemplates)
+    {
+        int cNewMax = m_cMaxTemplates ? m_cMaxTemplates * 2 : 64;
+        GestureTemplateFx* pTemplates = (GestureTemplateFx*)realloc(
+                                m_pTemplates, cNewMax * sizeof(GestureTemplateFx));
+        if (NULL == pTemplates)
+            return false;
+        m_pTemplates = pTemplates;
+        m_cMaxTemplates = cNewMax;
+    }
+
+    GestureTemplateFx& gt = m_pTemplates[m_cTemplates];
+    memset(&gt, 0, sizeof(gt));
+    gt.iGesture = iGesture;
+    NormalizeStroke(ppt, cPoints, gt.rgpt);
+    m_cTemplates++;
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CFixedGestureEngine::AddBuiltinTemplates
+//
+// Adds a template for each of the built-in gesture shapes,
+// rounded to whole ink units. Taps are recognized by their
+// extent and need no template.
+//
+// Parameters:
+//     none
+//
+// Return Values (int):
+//      the number of templates added
+//
+/////////////////////////////////////////////////////////
+int CFixedGestureEngine::AddBuiltinTemplates()
+{
+    GesturePoint rgpt[256];
+    GesturePointFx rgptFx[256];
+    int cAdded = 0;
+    for (int i = 0; i < CGestureEngine::GetBuiltinShapeCount(); i++)
+    {
+        int iGesture;
+        int cPoints = CGestureEngine::GetBuiltinShape(i, iGesture, rgpt, countof(rgpt));
+        if (GE_GESTURE_TAP == iGesture)
+            continue;
+
+        for (int j = 0; j < cPoints; j++)
+        {
+            rgptFx[j].x = (int)floorf(rgpt[j].x + 0.5f);
+            rgptFx[j].y = (int)floorf(rgpt[j].y + 0.5f);
+        }
+        if (AddTemplate(iGesture, rgptFx, cPoints))
+        {
+            cAdded++;
+        }
+    }
+    return cAdded;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CFixedGestureEngine::SetAngleSearch
+//
+// Sets the range and the precision of the rotation search,
+// both in angle steps (1/GE_FX_ANGLE_STEP_DIV of a degree).
+// The range is limited to GE_FX_MAX_ANGLE.
+//
+/////////////////////////////////////////////////////////
+void CFixedGestureEngine::SetAngleSearch(int iRange, int iPrecision)
+{
+    if (iRange < 0)
+        iRange = 0;
+    if (iRange > GE_FX_MAX_ANGLE)
+        iRange = GE_FX_MAX_ANGLE;
+    m_iAngleRange = iRange;
+    m_iAnglePrecision = (iPrecision > 0) ? iPrecision : 1;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CFixedGestureEngine::Recognize
+//
+// Recognizes a stroke against the template set.
+//
+// Parameters:
+//     const GesturePointFx* ppt : [in] the stroke points, in ink units
+//     int cPoints               : [in] the number of points
+//     GestureResultFx* pResults : [out] the alternates, one per gesture,
+//                                 ordered by the score, the best first
+//     int cMaxResults           : [in] the size of the pResults array
+//
+// Return Values (int):
+//      the number of alternates written to pResults
+//
+/////////////////////////////////////////////////////////
+int CFixedGestureEngine::Recognize(
+        const GesturePointFx* ppt,
+        int cPoints,
+        GestureResultFx* pResults,
+        int cMaxResults
+        ) const
+{
+    if (NULL == ppt || cPoints <= 0 || NULL == pResults || cMaxResults <= 0)
+        return 0;
+
+    // A stroke that doesn't leave a small box is a tap
+    int iMinX = ppt[0].x, iMaxX = ppt[0].x, iMinY = ppt[0].y, iMaxY = ppt[0].y;
+    for (int i = 1; i < cPoints; i++)
+    {
+        if (ppt[i].x < iMinX) iMinX = ppt[i].x;
+        if (ppt[i].x > iMaxX) iMaxX = ppt[i].x;
+        if (ppt[i].y < iMinY) iMinY = ppt[i].y;
+        if (ppt[i].y > iMaxY) iMaxY = ppt[i].y;
+    }
+    if (iMaxX - iMinX <= m_iTapExtent && iMaxY - iMinY <= m_iTapExtent)
+    {
+        pResults[0].iGesture = GE_GESTURE_TAP;
+        pResults[0].iTemplate = -1;
+        pResults[0].iScore = GE_FX_ONE;
+        return 1;
+    }
+
+    if (0 == m_cTemplates)
+        return 0;
+
+    GesturePointFx rgpt[GE_NUM_POINTS];
+    NormalizeStroke(ppt, cPoints, rgpt);
+
+    // The best distance and template for each gesture
+    int rgiBestDist[GE_NUM_SSGESTURES];
+    int rgiBest[GE_NUM_SSGESTURES];
+    for (int i = 0; i < GE_NUM_SSGESTURES; i++)
+    {
+        rgiBestDist[i] = 0x7FFFFFFF;
+        rgiBest[i] = -1;
+    }
+
+    for (int i = 0; i < m_cTemplates; i++)
+    {
+        const GestureTemplateFx& gt = m_pTemplates[i];
+        int iDist = DistanceAtBestAngle(rgpt, gt.rgpt, m_iAngleRange, m_iAnglePrecision);
+        if (iDist < rgiBestDist[gt.iGesture])
+        {
+            rgiBestDist[gt.iGesture] = iDist;
+            rgiBest[gt.iGesture] = i;
+        }
+    }
+
+    // Output the gestures by the ascending distance, as the float engine does
+    int cResults = 0;
+    for (int g = 0; g < GE_NUM_SSGESTURES; g++)
+    {
+        if (rgiBest[g] < 0)
+            continue;
+        int iScore = ScoreFromDistance(rgiBestDist[g]);
+        int j = (cResults < cMaxResults) ? cResults++ : cMaxResults;
+        while (j > 0 && pResults[j - 1].iScore < iScore)
+        {
+            if (j < cMaxResults)
+                pResults[j] = pResults[j - 1];
+            j--;
+        }
+        if (j < cMaxResults)
+        {
+            pResults[j].iGesture = g;
+            pResults[j].iTemplate = rgiBest[g];
+            pResults[j].iScore = iScore;
+        }
+    }
+
+    return cResults;
+}
+
+// Stroke processing helpers //////////////////////////
+
+/////////////////////////////////////////////////////////
+//
+// CFixedGestureEngine::SquareRoot32
+//
+// Returns the integer square root (rounded down), computed
+// digit by digit with no division. The digits are selected
+// with masks instead of branches: this is the inner loop of
+// the matching and its branches would be unpredictable.
+//
+/////////////////////////////////////////////////////////
+unsigned int CFixedGestureEngine::SquareRoot32(unsigned int u)
+{
+    unsigned int uRoot = 0;
+    for (unsigned int uBit = 1U << 30; 0 != uBit; uBit >>= 2)
+    {
+        unsigned int uTrial = uRoot + uBit;
+        unsigned int uMask = 0U - (unsigned int)(u >= uTrial);
+        u -= uTrial & uMask;
+        uRoot = (uRoot >> 1) + (uBit & uMask);
+    }
+    return uRoot;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CFixedGestureEngine::SquareRoot64
+//
+// The 64-bit version of SquareRoot32, used for the lengths
+// in ink space.
+//
+/////////////////////////////////////////////////////////
+unsigned int CFixedGestureEngine::SquareRoot64(unsigned long long ull)
+{
+    unsigned long long ullRoot = 0;
+    unsigned long long ullBit = 1ULL << 62;
+    while (ullBit > ull)
+        ullBit >>= 2;
+
+    while (0 != ullBit)
+    {
+        if (ull >= ullRoot + ullBit)
+        {
+            ull -= ullRoot + ullBit;
+            ullRoot = (ullRoot >> 1) + ullBit;
+        }
+        else
+        {
+            ullRoot >>= 1;
+        }
+        ullBit >>= 2;
+    }
+    return (unsigned int)ullRoot;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CFixedGestureEngine::ResampleStroke
+//
+// Resamples a stroke to cOut points evenly spaced along
+// its path, the same way as CGestureEngine::ResampleStroke.
+//
+// Parameters:
+//     const GesturePointFx* ppt : [in] the stroke points, in ink units
+//     int cPoints               : [in] the number of points, > 0
+//     GesturePointFx* pptOut    : [out] cOut resampled points, in Q8 ink units
+//     int cOut                  : [in] the number of points to produce, > 1
+//
+// Return Values (void):
+//      none
+//
+/////////////////////////////////////////////////////////
+void CFixedGestureEngine::ResampleStroke(
+        const GesturePointFx* ppt,
+        int cPoints,
+        GesturePointFx* pptOut,
+        int cOut
+        )
+{
+    const long long llOne = 1 << GE_FX_INK_SHIFT;
+
+    long long llLength = 0;
+    for (int i = 1; i < cPoints; i++)
+    {
+        long long dx = (ppt[i].x - (long long)ppt[i - 1].x) * llOne;
+        long long dy = (ppt[i].y - (long long)ppt[i - 1].y) * llOne;
+        llLength += SquareRoot64((unsigned long long)(dx * dx + dy * dy));
+    }
+
+    long long xPrev = ppt[0].x * llOne;
+    long long yPrev = ppt[0].y * llOne;
+    pptOut[0].x = (int)xPrev;
+    pptOut[0].y = (int)yPrev;
+    int k = 1;
+    if (llLength > 0)
+    {
+        long long llInterval = llLength / (cOut - 1);
+        long long llAccum = 0;
+        for (int i = 1; i < cPoints && k < cOut; i++)
+        {
+            long long xCur = ppt[i].x * llOne;
+            long long yCur = ppt[i].y * llOne;
+            long long dx = xCur - xPrev;
+            long long dy = yCur - yPrev;
+            long long d = SquareRoot64((unsigned long long)(dx * dx + dy * dy));
+            while (d > 0 && llAccum + d >= llInterval && k < cOut)
+            {
+                long long t = llInterval - llAccum;
+                xPrev += dx * t / d;
+                yPrev += dy * t / d;
+                pptOut[k].x = (int)xPrev;
+                pptOut[k].y = (int)yPrev;
+                k++;
+                dx = xCur - xPrev;
+                dy = yCur - yPrev;
+                d = SquareRoot64((unsigned long long)(dx * dx + dy * dy));
+                llAccum = 0;
+            }
+            llAccum += d;
+            xPrev = xCur;
+            yPrev = yCur;
+        }
+    }
+
+    // Rounding may leave the last point(s) unset
+    while (k < cOut)
+    {
+        pptOut[k].x = (int)(ppt[cPoints - 1].x * llOne);
+        pptOut[k].y = (int)(ppt[cPoints - 1].y * llOne);
+        k++;
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CFixedGestureEngine::NormalizeStroke
+//
+// Resamples a stroke to GE_NUM_POINTS points, scales it
+// uniformly so that the longer side of its bounding box
+// becomes GE_SQUARE_SIZE and moves its centroid to the
+// origin.
+//
+// Parameters:
+//     const GesturePointFx* ppt : [in] the stroke points, in ink units
+//     int cPoints               : [in] the number of points, > 0
+//     GesturePointFx* pptOut    : [out] GE_NUM_POINTS normalized points, Q16
+//
+// Return Values (void):
+//      none
+//
+/////////////////////////////////////////////////////////
+void CFixedGestureEngine::NormalizeStroke(
+        const GesturePointFx* ppt,
+        int cPoints,
+        GesturePointFx* pptOut
+        )
+{
+    ResampleStroke(ppt, cPoints, pptOut, GE_NUM_POINTS);
+
+    int iMinX = pptOut[0].x, iMaxX = pptOut[0].x;
+    int iMinY = pptOut[0].y, iMaxY = pptOut[0].y;
+    long long llSumX = 0, llSumY = 0;
+    for (int i = 0; i < GE_NUM_POINTS; i++)
+    {
+        if (pptOut[i].x < iMinX) iMinX = pptOut[i].x;
+        if (pptOut[i].x > iMaxX) iMaxX = pptOut[i].x;
+        if (pptOut[i].y < iMinY) iMinY = pptOut[i].y;
+        if (pptOut[i].y > iMaxY) iMaxY = pptOut[i].y;
+        llSumX += pptOut[i].x;
+        llSumY += pptOut[i].y;
+    }
+
+    // Scale from Q8 ink units to Q16 square units: multiply by
+    // llScaleNum / llScaleDen
+    long long llSize = (long long)iMaxX - iMinX;
+    if ((long long)iMaxY - iMinY > llSize)
+        llSize = (long long)iMaxY - iMinY;
+    long long llScaleNum = (long long)GE_SQUARE_SIZE << GE_FX_SHIFT;
+    long long llScaleDen = llSize;
+    if (llSize <= 0)
+    {
+        llScaleNum = 1 << (GE_FX_SHIFT - GE_FX_INK_SHIFT);
+        llScaleDen = 1;
+    }
+    long long llCx = llSumX / GE_NUM_POINTS;
+    long long llCy = llSumY / GE_NUM_POINTS;
+
+    for (int i = 0; i < GE_NUM_POINTS; i++)
+    {
+        pptOut[i].x = (int)((pptOut[i].x - llCx) * llScaleNum / llScaleDen);
+        pptOut[i].y = (int)((pptOut[i].y - llCy) * llScaleNum / llScaleDen);
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CFixedGestureEngine::DistanceAtAngle
+//
+// Returns the average distance (Q16) between the corresponding
+// points of the query rotated by iAngle angle steps and the
+// template. The rotation is done in 64 bits, the distances
+// in 32-bit Q6, which is plenty for the score and keeps the
+// square roots short on 32-bit targets.
+//
+/////////////////////////////////////////////////////////
+int CFixedGestureEngine::DistanceAtAngle(
+        const GesturePointFx* pptQuery,
+        const GesturePointFx* pptTemplate,
+        int iAngle
+        )
+{
+    int iAbs = (iAngle < 0) ? -iAngle : iAngle;
+    if (iAbs > GE_FX_MAX_ANGLE)
+        iAbs = GE_FX_MAX_ANGLE;
+    long long llCos = gc_rgiCos[iAbs];
+    long long llSin = (iAngle < 0) ? -gc_rgiSin[iAbs] : gc_rgiSin[iAbs];
+    const int iShift = GE_FX_SHIFT - GE_FX_DIST_SHIFT;
+    const long long llHalf = 1LL << (GE_FX_TRIG_SHIFT + iShift - 1);
+
+    unsigned int uSum = 0;
+    for (int i = 0; i < GE_NUM_POINTS; i++)
+    {
+        int x = (int)((pptQuery[i].x * llCos - pptQuery[i].y * llSin + llHalf)
+                        >> (GE_FX_TRIG_SHIFT + iShift));
+        int y = (int)((pptQuery[i].x * llSin + pptQuery[i].y * llCos + llHalf)
+                        >> (GE_FX_TRIG_SHIFT + iShift));
+        int dx = x - ((pptTemplate[i].x + (1 << (iShift - 1))) >> iShift);
+        int dy = y - ((pptTemplate[i].y + (1 << (iShift - 1))) >> iShift);
+        uSum += SquareRoot32((unsigned int)(dx * dx) + (unsigned int)(dy * dy));
+    }
+    return (int)(((unsigned long long)uSum << iShift) / GE_NUM_POINTS);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CFixedGestureEngine::DistanceAtBestAngle
+//
+// Golden section search over the whole angle steps within
+// [-iRange, iRange] for the rotation of the query that
+// minimizes its distance to the template.
+//
+// Return Values (int):
+//      the minimal distance found, Q16
+//
+/////////////////////////////////////////////////////////
+int CFixedGestureEngine::DistanceAtBestAngle(
+        const GesturePointFx* pptQuery,
+        const GesturePointFx* pptTemplate,
+        int iRange,
+        int iPrecision
+        )
+{
+    if (iRange <= 0)
+        return DistanceAtAngle(pptQuery, pptTemplate, 0);
+    if (iPrecision < 1)
+        iPrecision = 1;
+
+    int a = -iRange;
+    int b = iRange;
+    int iSection = (int)(((long long)(b - a) * GE_FX_PHI + GE_FX_ONE / 2) >> GE_FX_SHIFT);
+    int x1 = b - iSection;
+    int f1 = DistanceAtAngle(pptQuery, pptTemplate, x1);
+    int x2 = a + iSection;
+    int f2 = DistanceAtAngle(pptQuery, pptTemplate, x2);
+
+    // The interval shrinks by at least a step per iteration
+    while (b - a > iPrecision)
+    {
+        if (f1 < f2)
+        {
+            b = x2;
+            x2 = x1;
+            f2 = f1;
+            x1 = b - (int)(((long long)(b - a) * GE_FX_PHI + GE_FX_ONE / 2) >> GE_FX_SHIFT);
+            f1 = DistanceAtAngle(pptQuery, pptTemplate, x1);
+        }
+        else
+        {
+            a = x1;
+            x1 = x2;
+            f1 = f2;
+            x2 = a + (int)(((long long)(b - a) * GE_FX_PHI + GE_FX_ONE / 2) >> GE_FX_SHIFT);
+            f2 = DistanceAtAngle(pptQuery, pptTemplate, x2);
+        }
+    }
+
+    return (f1 < f2) ? f1 : f2;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CFixedGestureEngine::ScoreFromDistance
+//
+// Maps an average point distance (Q16) to a 0..GE_FX_ONE
+// score, the same mapping as CGestureEngine::ScoreFromDistance.
+//
+/////////////////////////////////////////////////////////
+int CFixedGestureEngine::ScoreFromDistance(int iDistance)
+{
+    int iScore = GE_FX_ONE - (int)(((long long)iDistance << GE_FX_SHIFT) / GE_FX_HALF_DIAGONAL);
+    return (iScore > 0) ? iScore : 0;
+}
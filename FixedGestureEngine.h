@@ -0,0 +1,133 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      FixedGestureEngine.h
+//
+// Description:
+//      This file contains the definition of the CFixedGestureEngine class,
+//      the integer-only counterpart of CGestureEngine for targets with
+//      weak floating point and for regression runs that must give the
+//      same results bit for bit on every machine. The pipeline is the
+//      same (resampling, uniform scaling, rotation search, average point
+//      distance), done in fixed point:
+//
+//          ink coordinates     whole ink units, as the digitizer reports them
+//          resampling          Q8 ink units
+//          normalized points   Q16, within +-GE_SQUARE_SIZE
+//          rotation            a Q15 sine/cosine table in GE_FX_ANGLE_STEP
+//                              steps, searched by golden section over the
+//                              whole steps
+//          scores              Q16, GE_FX_ONE is a perfect match
+//
+//      The scores agree with CGestureEngine (float32 templates) within
+//      GE_FX_SCORE_TOLERANCE for the same input, so the ranking differs
+//      only between alternates whose float scores are that close.
+//      "GestureBench fixed" checks it over all the gestures.
+//
+//      The methods of the class are defined in the FixedGestureEngine.cpp
+//      file.
+//--------------------------------------------------------------------------
+
+#pragma once
+
+#include "GestureEngine.h"
+
+enum {
+    GE_FX_SHIFT = 16,                   // the fraction bits of the normalized points
+    GE_FX_ONE = 1 << GE_FX_SHIFT,       // 1.0 in Q16, also the perfect score
+    GE_FX_ANGLE_STEP_DIV = 4,           // the angle steps per degree
+    GE_FX_MAX_ANGLE = 45 * GE_FX_ANGLE_STEP_DIV    // the largest rotation searched, in steps
+};
+
+// The largest difference between a fixed point score and the float score
+// of the same stroke against the same template, in Q16 (0.01)
+#define GE_FX_SCORE_TOLERANCE   655
+
+// A point in whole ink units or, after normalization, in Q16
+struct GesturePointFx
+{
+    int     x;
+    int     y;
+};
+
+// A normalized fixed point template, laid out like GestureTemplate
+struct GestureTemplateFx
+{
+    int             iGesture;       // index into the single stroke gesture table
+    int             rgiReserved[3];
+    GesturePointFx  rgpt[GE_NUM_POINTS];    // Q16
+};
+
+// A recognition alternate
+struct GestureResultFx
+{
+    int     iGesture;       // index into the single stroke gesture table
+    int     iTemplate;      // the best matching template, -1 for a tap
+    int     iScore;         // 0..GE_FX_ONE, where GE_FX_ONE is a perfect match
+};
+
+/////////////////////////////////////////////////////////
+//
+// class CFixedGestureEngine
+//
+// Holds the normalized fixed point templates and recognizes
+// strokes against all of them (there's no template index;
+// the fixed point targets keep small template sets). No
+// floating point is used except in AddBuiltinTemplates,
+// which rounds the generated shapes to whole ink units.
+//
+// Recognize is const and uses no shared scratch memory,
+// so one engine can serve several threads.
+//
+/////////////////////////////////////////////////////////
+
+class CFixedGestureEngine
+{
+    // Data members
+    GestureTemplateFx*  m_pTemplates;
+    int                 m_cTemplates;
+    int                 m_cMaxTemplates;    // allocated capacity
+    int                 m_iTapExtent;       // max bounding box size of a tap, in ink units
+    int                 m_iAngleRange;      // rotation search range, angle steps each way
+    int                 m_iAnglePrecision;  // rotation search stop criterion, angle steps
+
+public:
+
+    // Constructor and destructor
+    CFixedGestureEngine();
+    ~CFixedGestureEngine();
+
+    // Template set management
+    bool AddTemplate(int iGesture, const GesturePointFx* ppt, int cPoints);
+    int  AddBuiltinTemplates();
+    void RemoveAllTemplates();
+
+    // Data members access methods
+    int  GetTemplateCount() const { return m_cTemplates; }
+    const GestureTemplateFx* GetTemplate(int iTemplate) const { return m_pTemplates + iTemplate; }
+    void SetTapExtent(int iExtent) { m_iTapExtent = iExtent; }
+    void SetAngleSearch(int iRange, int iPrecision);
+
+    // Recognition
+    int  Recognize(const GesturePointFx* ppt, int cPoints,
+                   GestureResultFx* pResults, int cMaxResults) const;
+
+    // Stroke processing helpers, shared with the tools
+    static void ResampleStroke(const GesturePointFx* ppt, int cPoints,
+                               GesturePointFx* pptOut, int cOut);
+    static void NormalizeStroke(const GesturePointFx* ppt, int cPoints,
+                                GesturePointFx* pptOut);
+    static int  DistanceAtAngle(const GesturePointFx* pptQuery,
+                                const GesturePointFx* pptTemplate, int iAngle);
+    static int  DistanceAtBestAngle(const GesturePointFx* pptQuery,
+                                    const GesturePointFx* pptTemplate,
+                                    int iRange, int iPrecision);
+    static int  ScoreFromDistance(int iDistance);
+    static unsigned int SquareRoot32(unsigned int u);
+    static unsigned int SquareRoot64(unsigned long long ull);
+};
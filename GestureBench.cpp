@@ -0,0 +1,5291 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      GestureBench.cpp
+//
+// Description:
+//      A console tool that measures the native gesture engine on
+//      synthetic ink. It doesn't use the Tablet PC Automation API
+//      and builds on any platform with a C++ compiler:
+//
+//          GestureBench index      - recall and latency of the template
+//                                    index against the linear scan, for
+//                                    36 to 100k templates
+//          GestureBench startup    - engine startup from raw templates
+//                                    against mapping a template pack
+//          GestureBench quant      - memory, speed and accuracy of the
+//                                    float16 and int8 template formats
+//                                    against float32
+//          GestureBench fixed      - speed of the fixed point engine and
+//                                    a cross-check of its results against
+//                                    the float engine over all the gestures;
+//                                    exits with 1 if they disagree beyond
+//                                    GE_FX_SCORE_TOLERANCE
+//          GestureBench trace [file]
+//                                  - cost of the trace points, disabled
+//                                    and enabled, per trace point and per
+//                                    recognition; writes the trace of the
+//                                    run to a Chrome trace file if given
+//          GestureBench micro [-save file] [-baseline file] [-tolerance pct]
+//                                  - ns/op and allocations/op of each step
+//                                    of the recognition path, on a pinned
+//                                    processor; exits with 1 if a step got
+//                                    slower than a saved baseline by more
+//                                    than the tolerance or allocates more,
+//                                    for the release gate
+//          GestureBench e2e [-n count]
+//                                  - latency from the pen up to the gesture
+//                                    name in the results pane's pixels, per
+//                                    gesture, through the headless copy of
+//                                    the application's event path; exits
+//                                    with 1 if a result isn't drawn or a
+//                                    gesture bound to a command other than
+//                                    clear leaves its ink on the pane
+//          GestureBench reco [-n count] [-debounce ms]
+//                                  - the background recognition pipeline
+//                                    with the stand-in recognizer: every
+//                                    word of strokes is recognized once
+//                                    after its last stroke, a superseded
+//                                    job is never delivered; exits with 1
+//                                    if not
+//          GestureBench guide [-rows n] [-cols n] [-threads n] [-cost ms]
+//                                  - the segmentation of the ink by the
+//                                    cells of a guide, and the recognition
+//                                    of the cells on one worker against a
+//                                    pool; the cost of a cell's recognition
+//                                    is emulated with a sleep. Exits with 1
+//                                    if a stroke lands in the wrong cell or
+//                                    the pool's text differs
+//          GestureBench wordlist [-n count]
+//                                  - the size of a compiled word list, the
+//                                    time to map it and to look up a word,
+//                                    the factoids and the lattice search;
+//                                    exits with 1 if a word is missed or
+//                                    found wrongly or the search is wrong
+//          GestureBench decimate [-n count]
+//                                  - the decimation of dense strokes (a
+//                                    1 kHz pen) with a range of tolerances:
+//                                    the points kept, the cost, and the
+//                                    accuracy and time of the recognition;
+//                                    exits with 1 if a dropped point is
+//                                    beyond the tolerance
+//          GestureBench devices [-n count]
+//                                  - the input stage with pens of 60 Hz to
+//                                    1 kHz drawing at the same speed: the
+//                                    frames composed and the render cost
+//                                    per stroke with and without coalescing,
+//                                    and the points, cost and accuracy of
+//                                    the recognition of the packets and of
+//                                    the resampled strokes; exits with 1 if
+//                                    the resampled points depend on the pen
+//          GestureBench predict [-n count] [-noise units]
+//                                  - the error of the pen tip predicted a
+//                                    lookahead of 8 to 33 ms after every
+//                                    packet, with pens of 60 Hz to 1 kHz,
+//                                    against the lag of the ink and an
+//                                    extrapolation of the last two packets;
+//                                    exits with 1 if the prediction is
+//                                    farther from the pen than the ink, or
+//                                    overshoots the stroke ends more than
+//                                    the extrapolation
+//          GestureBench inkcodec [-n count]
+//                                  - the size of dense strokes with time and
+//                                    pressure in an ink archive block against
+//                                    the raw packets, delta varints and zlib
+//                                    -9, the encoding and decoding speeds, and
+//                                    the cost of reading one stroke; exits with
+//                                    1 if a stroke doesn't decode exactly, a
+//                                    damaged block isn't refused, the archive
+//                                    isn't smaller than zlib's output or the
+//                                    decoding is below 1 GB/s
+//          GestureBench history [-n count]
+//                                  - the undo history of the ink: the cost
+//                                    of an edit, a snapshot, an undo and a
+//                                    redo on a large canvas and the memory
+//                                    against copying the ink per edit, and
+//                                    a random session of strokes, clears,
+//                                    undos and redos checked against a
+//                                    model; exits with 1 if a version is
+//                                    wrong or nodes leak
+//          GestureBench canvas [-n count]
+//                                  - a tiled canvas with strokes spread over
+//                                    a large surface: the cost of adding a
+//                                    stroke, the frame times of a 1920x1080
+//                                    view panning and zooming over it, and
+//                                    the tiles drawn again when a stroke is
+//                                    removed; exits with 1 if a complete
+//                                    frame differs from drawing every stroke
+//                                    or a removal draws tiles it doesn't
+//                                    cross
+//          GestureBench layers [-n count]
+//                                  - the cost of painting a packet of a live
+//                                    stroke over 0 to count committed strokes,
+//                                    by repainting the pane and by composing
+//                                    the segment from the ink layers; exits
+//                                    with 1 if the layers differ from the
+//                                    repaint
+//          GestureBench batch [-n count]
+//                                  - RecognizeBatch against Recognize per
+//                                    stroke, in every storage format and for
+//                                    batches of 1 to GE_MAX_BATCH strokes;
+//                                    exits with 1 if a batch's results differ
+//                                    from Recognize's
+//          GestureBench config [-n count]
+//                                  - changes of the recognizer configuration
+//                                    while reader threads recognize with it:
+//                                    the cost of pinning a snapshot against a
+//                                    lock and of a change; exits with 1 if a
+//                                    reader sees a change half applied, a
+//                                    replaced snapshot isn't freed, a guided
+//                                    job's cells see two snapshots or a
+//                                    recognition with no slot free succeeds
+//          GestureBench ensemble [-n count] [-budget us] [-plugin path]
+//                                  - the accuracy and cost of every backend
+//                                    of the recognizer ensemble alone and of
+//                                    their fused votes, with a latency budget;
+//                                    exits with 1 if an answer waits for a
+//                                    backend past the budget, a stroke isn't
+//                                    answered or the p99 latency is past the
+//                                    budget and a jitter allowance
+//          GestureBench dispatch [-n count]
+//                                  - the gesture event running the bound
+//                                    command and the repaint against posting
+//                                    it to the command queue, bursts of
+//                                    gestures merged into one command, and
+//                                    random sessions checked against a model
+//                                    that runs every command; exits with 1 if
+//                                    a burst isn't merged or a session ends
+//                                    in a different state
+//
+//--------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <atomic>       // the allocation counter of the micro suite
+#ifdef __linux__
+#include <sched.h>      // sched_setaffinity, for the micro suite
+#endif
+#ifndef _WIN32
+#include <pthread.h>    // the reader threads of the config suite
+#include <sched.h>      // sched_yield, for the config suite
+#include <dlfcn.h>      // dlopen of zlib, for the inkcodec suite
+#endif
+
+#include "PerfTimer.h"
+#include "GestureEngine.h"
+#include "FixedGestureEngine.h"
+#include "SyntheticInk.h"
+#include "TemplatePack.h"
+#include "Trace.h"
+#include "Metrics.h"
+#include "HeadlessApp.h"
+#include "BackgroundReco.h"
+#include "GestureConfig.h"
+#include "GestureEnsemble.h"
+#include "GuidedReco.h"
+#include "WordList.h"
+#include "StrokeDecimator.h"
+#include "InkCodec.h"
+#include "InkHistory.h"
+#include "TiledCanvas.h"
+#include "InkLayers.h"
+#include "PacketInput.h"
+#include "StrokePredictor.h"
+#include "GestureCommands.h"
+
+// A useful macro to determine the number of elements in the array
+#ifndef countof
+#define countof(array)  (sizeof(array)/sizeof(array[0]))
+#endif
+
+// The size of the stroke buffers used by the benchmarks
+#define BENCH_MAX_POINTS    256
+
+// The micro suite: the least time of a timed batch and the batches per operation
+#define BENCH_MICRO_BATCH_NS    20000000
+#define BENCH_MICRO_RUNS        7
+
+// The time between the packets of the e2e suite's strokes, a 133 Hz pen
+#define BENCH_PACKET_TIME       7500000
+
+/////////////////////////////////////////////////////////
+//
+// FillEngine
+//
+// Loads the built-in templates into the engine and tops the
+// set up to cTemplates with synthetic user templates, the way
+// per-user templates would accumulate on a server.
+//
+/////////////////////////////////////////////////////////
+static void FillEngine(CGestureEngine& engine, int cTemplates, unsigned int uSeed)
+{
+    engine.RemoveAllTemplates();
+    engine.AddBuiltinTemplates();
+
+    CSyntheticInk ink(uSeed);
+    GesturePoint rgpt[BENCH_MAX_POINTS];
+    int cShapes = CGestureEngine::GetBuiltinShapeCount();
+    for (int i = 0; engine.GetTemplateCount() < cTemplates; i++)
+    {
+        int iGesture;
+        int cPoints = ink.MakeStroke(i % cShapes, iGesture, rgpt, countof(rgpt));
+        if (GE_GESTURE_TAP != iGesture)
+        {
+            engine.AddTemplate(iGesture, rgpt, cPoints);
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// BenchIndex
+//
+// For each template count, runs the same queries through the
+// linear scan and through the index and reports the latency
+// of both, the recall of the index (how often its top gesture
+// agrees with the linear scan) and the accuracy of both
+// against the ground truth.
+//
+/////////////////////////////////////////////////////////
+static int BenchIndex(int /*argc*/, char** /*argv*/)
+{
+    static const int rgcTemplates[] = { 36, 100, 1000, 10000, 100000 };
+    const int cCandidates = 64;
+
+    printf("%9s %6s %12s %12s %8s %8s %8s %8s\n",
+           "templates", "cand", "linear us/q", "index us/q",
+           "speedup", "recall", "acc lin", "acc idx");
+
+    CGestureEngine engine;
+    GesturePoint rgpt[BENCH_MAX_POINTS];
+    for (int t = 0; t < (int)countof(rgcTemplates); t++)
+    {
+        FillEngine(engine, rgcTemplates[t], 12345);
+        engine.BuildIndex();
+
+        // Fewer queries for the large sets, where the linear scan is slow
+        int cQueries = (rgcTemplates[t] > 10000) ? 100 : 500;
+        // The queries are twice as sloppy as the templates
+        CSyntheticInk ink(777, 2.0f);
+        int cShapes = CGestureEngine::GetBuiltinShapeCount();
+
+        PERFTIME ptLinear = 0, ptIndex = 0;
+        int cAgree = 0, cCorrectLinear = 0, cCorrectIndex = 0;
+        for (int q = 0; q < cQueries; q++)
+        {
+            int iGesture;
+            int cPoints = ink.MakeStroke(q % cShapes, iGesture, rgpt, countof(rgpt));
+
+            GestureResult resLinear, resIndex;
+            resLinear.iGesture = resIndex.iGesture = -1;
+
+            engine.SetCandidateCount(0);
+            PERFTIME ptStart = PerfNow();
+            engine.Recognize(rgpt, cPoints, &resLinear, 1);
+            ptLinear += PerfNow() - ptStart;
+
+            engine.SetCandidateCount(cCandidates);
+            ptStart = PerfNow();
+            engine.Recognize(rgpt, cPoints, &resIndex, 1);
+            ptIndex += PerfNow() - ptStart;
+
+            if (resLinear.iGesture == resIndex.iGesture)
+                cAgree++;
+            if (resLinear.iGesture == iGesture)
+                cCorrectLinear++;
+            if (resIndex.iGesture == iGesture)
+                cCorrectIndex++;
+        }
+
+        double dLinear = ptLinear / 1000.0 / cQueries;
+        double dIndex = ptIndex / 1000.0 / cQueries;
+        printf("%9d %6d %12.1f %12.1f %7.1fx %7.1f%% %7.1f%% %7.1f%%\n",
+               engine.GetTemplateCount(), cCandidates, dLinear, dIndex,
+               (dIndex > 0.0) ? dLinear / dIndex : 0.0,
+               100.0 * cAgree / cQueries,
+               100.0 * cCorrectLinear / cQueries,
+               100.0 * cCorrectIndex / cQueries);
+        fflush(stdout);
+    }
+
+    return 0;
+}
+
+/////////////////////////////////////////////////////////
+//
+// BenchStartup
+//
+// Compares the two ways to get an engine ready: normalizing
+// the raw templates and building the index at startup, and
+// mapping a pack baked offline. Also reports the first
+// recognition after the mapping, which pays for the page
+// faults on the touched pages.
+//
+/////////////////////////////////////////////////////////
+static int BenchStartup(int /*argc*/, char** /*argv*/)
+{
+    static const int rgcTemplates[] = { 36, 1000, 10000, 100000 };
+    static const char szPackName[] = "GestureBench.gpk";
+    const int cRepeats = 100;
+
+    printf("%9s %14s %14s %14s %12s\n",
+           "templates", "build us", "map us", "1st reco us", "pack KB");
+
+    for (int t = 0; t < (int)countof(rgcTemplates); t++)
+    {
+        // Generate the raw strokes up front, they're the input of the startup
+        int cTemplates = rgcTemplates[t];
+        GesturePoint* pptRaw = (GesturePoint*)malloc(
+                                (size_t)cTemplates * BENCH_MAX_POINTS * sizeof(GesturePoint));
+        int* pcPoints = (int*)malloc(cTemplates * sizeof(int));
+        int* piGestures = (int*)malloc(cTemplates * sizeof(int));
+        if (NULL == pptRaw || NULL == pcPoints || NULL == piGestures)
+        {
+            free(pptRaw);
+            free(pcPoints);
+            free(piGestures);
+            return 1;
+        }
+
+        CSyntheticInk ink(12345);
+        int cShapes = CGestureEngine::GetBuiltinShapeCount();
+        for (int i = 0; i < cTemplates; i++)
+        {
+            GesturePoint* ppt = pptRaw + (size_t)i * BENCH_MAX_POINTS;
+            do
+            {
+                pcPoints[i] = ink.MakeStroke(ink.NextUInt() % cShapes, piGestures[i],
+                                             ppt, BENCH_MAX_POINTS);
+            } while (GE_GESTURE_TAP == piGestures[i]);
+        }
+
+        PERFTIME ptStart = PerfNow();
+        CGestureEngine engineBuilt;
+        for (int i = 0; i < cTemplates; i++)
+        {
+            engineBuilt.AddTemplate(piGestures[i], pptRaw + (size_t)i * BENCH_MAX_POINTS,
+                                    pcPoints[i]);
+        }
+        engineBuilt.BuildIndex();
+        PERFTIME ptBuild = PerfNow() - ptStart;
+
+        if (false == CTemplatePack::Write(engineBuilt, szPackName))
+        {
+            fprintf(stderr, "%s: failed to write the pack\n", szPackName);
+            return 1;
+        }
+
+        PERFTIME ptMap = 0, ptFirst = 0;
+        for (int r = 0; r < cRepeats; r++)
+        {
+            CTemplatePack pack;
+            CGestureEngine engine;
+
+            ptStart = PerfNow();
+            pack.Open(szPackName);
+            engine.AttachTemplates(pack.GetTemplates(), pack.GetFormat(), pack.GetFeatures(),
+                                   pack.GetTemplateCount(), pack.GetNodes(),
+                                   pack.GetNodeCount());
+            ptMap += PerfNow() - ptStart;
+
+            engine.SetCandidateCount(64);
+            GestureResult res;
+            ptStart = PerfNow();
+            engine.Recognize(pptRaw, pcPoints[0], &res, 1);
+            ptFirst += PerfNow() - ptStart;
+        }
+
+        CTemplatePack pack;
+        pack.Open(szPackName);
+        printf("%9d %14.1f %14.1f %14.1f %12.1f\n", cTemplates,
+               ptBuild / 1000.0, ptMap / 1000.0 / cRepeats, ptFirst / 1000.0 / cRepeats,
+               pack.IsOpen() ? pack.GetHeader()->cbFile / 1024.0 : 0.0);
+        fflush(stdout);
+
+        free(pptRaw);
+        free(pcPoints);
+        free(piGestures);
+    }
+
+    remove(szPackName);
+    return 0;
+}
+
+/////////////////////////////////////////////////////////
+//
+// BenchQuant
+//
+// Recognizes the same queries with the same templates stored
+// in each format and reports the template memory, the speed,
+// the accuracy, and the difference from the float32 path:
+// how often the top gesture differs and the mean absolute
+// difference of the top score.
+//
+/////////////////////////////////////////////////////////
+static int BenchQuant(int /*argc*/, char** /*argv*/)
+{
+    static const char* const rgpszFormats[GE_NUM_FORMATS] = { "float32", "float16", "int8" };
+    const int cUserTemplates = 4 * CGestureEngine::GetBuiltinShapeCount();
+    const int cQueries = 2000;
+
+    CGestureEngine rgEngines[GE_NUM_FORMATS];
+    for (int f = 0; f < GE_NUM_FORMATS; f++)
+    {
+        rgEngines[f].SetStorageFormat(f);
+        FillEngine(rgEngines[f], cUserTemplates, 12345);
+    }
+
+    // Recognize all the queries with every format, keeping the top results
+    GestureResult* pResults = (GestureResult*)malloc(
+                                GE_NUM_FORMATS * cQueries * sizeof(GestureResult));
+    int* piTruth = (int*)malloc(cQueries * sizeof(int));
+    if (NULL == pResults || NULL == piTruth)
+    {
+        free(pResults);
+        free(piTruth);
+        return 1;
+    }
+
+    printf("%8s %10s %12s %12s %10s %10s %12s\n", "format", "templates", "bytes",
+           "us/query", "accuracy", "top1 diff", "score delta");
+
+    GesturePoint rgpt[BENCH_MAX_POINTS];
+    for (int f = 0; f < GE_NUM_FORMATS; f++)
+    {
+        CSyntheticInk ink(777, 2.0f);
+        int cShapes = CGestureEngine::GetBuiltinShapeCount();
+        PERFTIME ptTotal = 0;
+        int cCorrect = 0;
+        for (int q = 0; q < cQueries; q++)
+        {
+            int cPoints = ink.MakeStroke(q % cShapes, piTruth[q], rgpt, countof(rgpt));
+            GestureResult& res = pResults[f * cQueries + q];
+            res.iGesture = -1;
+            res.fScore = 0.0f;
+
+            PERFTIME ptStart = PerfNow();
+            rgEngines[f].Recognize(rgpt, cPoints, &res, 1);
+            ptTotal += PerfNow() - ptStart;
+
+            if (res.iGesture == piTruth[q])
+                cCorrect++;
+        }
+
+        int cDiffer = 0;
+        double dScoreDelta = 0.0;
+        for (int q = 0; q < cQueries; q++)
+        {
+            const GestureResult& res = pResults[f * cQueries + q];
+            const GestureResult& resFloat = pResults[q];
+            if (res.iGesture != resFloat.iGesture)
+                cDiffer++;
+            dScoreDelta += (res.fScore > resFloat.fScore) ? res.fScore - resFloat.fScore
+                                                          : resFloat.fScore - res.fScore;
+        }
+
+        const CGestureEngine& engine = rgEngines[f];
+        printf("%8s %10d %12d %12.1f %9.2f%% %9.2f%% %12.5f\n", rgpszFormats[f],
+               engine.GetTemplateCount(), engine.GetTemplateCount() * engine.GetTemplateSize(),
+               ptTotal / 1000.0 / cQueries, 100.0 * cCorrect / cQueries,
+               100.0 * cDiffer / cQueries, dScoreDelta / cQueries);
+        fflush(stdout);
+    }
+
+    free(pResults);
+    free(piTruth);
+    return 0;
+}
+
+/////////////////////////////////////////////////////////
+//
+// RoundStroke
+//
+// Rounds a stroke to whole ink units, as a digitizer would
+// report it, for both engines: the fixed point copy and the
+// float copy of the same integer coordinates.
+//
+/////////////////////////////////////////////////////////
+static void RoundStroke(GesturePoint* ppt, int cPoints, GesturePointFx* pptFx)
+{
+    for (int i = 0; i < cPoints; i++)
+    {
+        pptFx[i].x = (int)floorf(ppt[i].x + 0.5f);
+        pptFx[i].y = (int)floorf(ppt[i].y + 0.5f);
+        ppt[i].x = (float)pptFx[i].x;
+        ppt[i].y = (float)pptFx[i].y;
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// BenchFixed
+//
+// Feeds the same integer strokes of all the 36 gestures to
+// the float engine and to the fixed point engine, both with
+// the built-in templates plus a few user templates per shape,
+// and compares every alternate: each gesture's fixed point
+// score must be within GE_FX_SCORE_TOLERANCE of its float
+// score, so the two rankings can only differ between
+// alternates that close. Reports the latency and accuracy
+// of both engines.
+//
+// Return Values (int):
+//      0 if the engines agree within the tolerance, 1 otherwise
+//
+/////////////////////////////////////////////////////////
+static int BenchFixed(int /*argc*/, char** /*argv*/)
+{
+    const int cShapes = CGestureEngine::GetBuiltinShapeCount();
+    const int cQueries = 36 * cShapes;
+
+    CGestureEngine engine;
+    CFixedGestureEngine engineFx;
+    GesturePoint rgpt[BENCH_MAX_POINTS];
+    GesturePointFx rgptFx[BENCH_MAX_POINTS];
+
+    // The same integer templates in both engines
+    CSyntheticInk inkTemplates(12345);
+    for (int i = 0; i < 4 * cShapes; i++)
+    {
+        int iGesture;
+        int cPoints = (i < cShapes)
+                    ? CGestureEngine::GetBuiltinShape(i, iGesture, rgpt, countof(rgpt))
+                    : inkTemplates.MakeStroke(i % cShapes, iGesture, rgpt, countof(rgpt));
+        if (GE_GESTURE_TAP == iGesture)
+            continue;
+        RoundStroke(rgpt, cPoints, rgptFx);
+        engine.AddTemplate(iGesture, rgpt, cPoints);
+        engineFx.AddTemplate(iGesture, rgptFx, cPoints);
+    }
+
+    CSyntheticInk ink(777, 2.0f);
+    PERFTIME ptFloat = 0, ptFixed = 0;
+    int cCorrect = 0, cCorrectFx = 0, cTopDiffer = 0, cViolations = 0;
+    int iMaxDelta = 0;
+    for (int q = 0; q < cQueries; q++)
+    {
+        int iTruth;
+        int cPoints = ink.MakeStroke(q % cShapes, iTruth, rgpt, countof(rgpt));
+        RoundStroke(rgpt, cPoints, rgptFx);
+
+        GestureResult rgResults[GE_NUM_SSGESTURES];
+        GestureResultFx rgResultsFx[GE_NUM_SSGESTURES];
+
+        PERFTIME ptStart = PerfNow();
+        int cResults = engine.Recognize(rgpt, cPoints, rgResults, countof(rgResults));
+        ptFloat += PerfNow() - ptStart;
+
+        ptStart = PerfNow();
+        int cResultsFx = engineFx.Recognize(rgptFx, cPoints, rgResultsFx, countof(rgResultsFx));
+        ptFixed += PerfNow() - ptStart;
+
+        if (cResults > 0 && rgResults[0].iGesture == iTruth)
+            cCorrect++;
+        if (cResultsFx > 0 && rgResultsFx[0].iGesture == iTruth)
+            cCorrectFx++;
+
+        if (cResults != cResultsFx)
+        {
+            printf("query %d (%s): %d float alternates, %d fixed point\n", q,
+                   CGestureEngine::GetGestureName(iTruth), cResults, cResultsFx);
+            cViolations++;
+            continue;
+        }
+        if (cResults > 0 && rgResults[0].iGesture != rgResultsFx[0].iGesture)
+            cTopDiffer++;
+
+        // Compare the scores gesture by gesture
+        for (int i = 0; i < cResultsFx; i++)
+        {
+            int j = 0;
+            while (j < cResults && rgResults[j].iGesture != rgResultsFx[i].iGesture)
+                j++;
+            int iDelta = (j < cResults)
+                       ? rgResultsFx[i].iScore - (int)floorf(rgResults[j].fScore * GE_FX_ONE + 0.5f)
+                       : GE_FX_ONE;
+            if (iDelta < 0)
+                iDelta = -iDelta;
+            if (iDelta > iMaxDelta)
+                iMaxDelta = iDelta;
+            if (iDelta > GE_FX_SCORE_TOLERANCE)
+            {
+                printf("query %d (%s): %s scores %.4f float, %.4f fixed point\n", q,
+                       CGestureEngine::GetGestureName(iTruth),
+                       CGestureEngine::GetGestureName(rgResultsFx[i].iGesture),
+                       (j < cResults) ? rgResults[j].fScore : 0.0f,
+                       (float)rgResultsFx[i].iScore / GE_FX_ONE);
+                cViolations++;
+            }
+        }
+    }
+
+    printf("%8s %10s %12s %10s\n", "engine", "templates", "us/query", "accuracy");
+    printf("%8s %10d %12.1f %9.2f%%\n", "float", engine.GetTemplateCount(),
+           ptFloat / 1000.0 / cQueries, 100.0 * cCorrect / cQueries);
+    printf("%8s %10d %12.1f %9.2f%%\n", "fixed", engineFx.GetTemplateCount(),
+           ptFixed / 1000.0 / cQueries, 100.0 * cCorrectFx / cQueries);
+    printf("\n%d queries over %d gestures: top gesture differs in %d, "
+           "max score delta %.5f (tolerance %.5f), %d out of tolerance\n",
+           cQueries, GE_NUM_SSGESTURES, cTopDiffer, (float)iMaxDelta / GE_FX_ONE,
+           (float)GE_FX_SCORE_TOLERANCE / GE_FX_ONE, cViolations);
+
+    return (0 == cViolations) ? 0 : 1;
+}
+
+/////////////////////////////////////////////////////////
+//
+// BenchTrace
+//
+// Measures an empty trace point in a loop and the recognition
+// of synthetic strokes with the tracing disabled and enabled.
+// The first pass of each kind only warms up (and, enabled,
+// allocates the thread buffer).
+//
+// Parameters:
+//     argv[0] : [in] optional, the Chrome trace file to write
+//
+/////////////////////////////////////////////////////////
+static int BenchTrace(int argc, char** argv)
+{
+    const int cLoops = 1000000;
+    const int cShapes = CGestureEngine::GetBuiltinShapeCount();
+    const int cQueries = 36 * cShapes;
+
+    CGestureEngine engine;
+    FillEngine(engine, 1000, 4321);
+    GesturePoint rgpt[BENCH_MAX_POINTS];
+
+    printf("%10s %16s %16s\n", "tracing", "ns/trace point", "us/recognition");
+    PERFTIME rgptQuery[2] = { 0, 0 };
+    for (int iPass = 0; iPass < 4; iPass++)
+    {
+        bool bEnabled = (iPass & 1) != 0;
+        CTrace::Enable(bEnabled);
+
+        CSyntheticInk ink(777);
+        PERFTIME ptQuery = 0;
+        for (int q = 0; q < cQueries; q++)
+        {
+            int iTruth;
+            int cPoints = ink.MakeStroke(q % cShapes, iTruth, rgpt, countof(rgpt));
+            GestureResult rgResults[GE_NUM_SSGESTURES];
+            PERFTIME ptStart = PerfNow();
+            engine.Recognize(rgpt, cPoints, rgResults, countof(rgResults));
+            ptQuery += PerfNow() - ptStart;
+        }
+
+        // After the recognitions, so that the loop doesn't leave the cache
+        // full of trace buffer lines for them
+        PERFTIME ptStart = PerfNow();
+        for (int i = 0; i < cLoops; i++)
+        {
+            TRACE_SCOPE("Empty");
+        }
+        PERFTIME ptLoop = PerfNow() - ptStart;
+
+        if (iPass >= 2)
+        {
+            rgptQuery[bEnabled ? 1 : 0] = ptQuery;
+            printf("%10s %16.2f %16.1f\n", bEnabled ? "enabled" : "disabled",
+                   (double)ptLoop / cLoops, ptQuery / 1000.0 / cQueries);
+        }
+    }
+    CTrace::Enable(false);
+
+    printf("\nenabled tracing adds %.2f%% to a recognition\n",
+           100.0 * ((double)rgptQuery[1] - (double)rgptQuery[0]) / (double)rgptQuery[0]);
+
+    if (argc >= 1)
+    {
+        // Trace one more round of recognitions, so that they're in the
+        // export along with the trace points of the loop
+        CTrace::Enable(true);
+        CSyntheticInk ink(777);
+        for (int q = 0; q < cQueries; q++)
+        {
+            int iTruth;
+            int cPoints = ink.MakeStroke(q % cShapes, iTruth, rgpt, countof(rgpt));
+            GestureResult rgResults[GE_NUM_SSGESTURES];
+            engine.Recognize(rgpt, cPoints, rgResults, countof(rgResults));
+        }
+        CTrace::Enable(false);
+
+        if (false == CTrace::ExportChromeJson(argv[0]))
+        {
+            fprintf(stderr, "%s: can't write the trace\n", argv[0]);
+            return 1;
+        }
+        printf("%d trace events written to %s\n", CTrace::GetEventCount(), argv[0]);
+    }
+
+    return 0;
+}
+
+/////////////////////////////////////////////////////////
+//
+// GetPercentileUpTo
+//
+// Returns a percentile of a histogram, which is the end of
+// its bucket, but no more than the largest value recorded.
+//
+/////////////////////////////////////////////////////////
+static PERFTIME GetPercentileUpTo(const HistogramSnapshot& hist, double dPercentile, PERFTIME ptMax)
+{
+    PERFTIME pt = hist.GetPercentile(dPercentile);
+    return (pt < ptMax) ? pt : ptMax;
+}
+
+/////////////////////////////////////////////////////////
+//
+// BenchEndToEnd
+//
+// Draws synthetic strokes of every gesture into the headless
+// application, packet by packet, and measures the time from
+// the pen up to the gesture name in the results pane's
+// pixels: recognition, clearing the ink and repainting the
+// pane. The latencies go to a histogram per gesture. Then
+// binds the gestures to the commands that leave the ink
+// alone, and checks that a gesture still takes its own
+// strokes off the input pane.
+//
+// Parameters:
+//     -n count : [in] the strokes per gesture, 50 by default
+//
+// Return Values (int):
+//      0 if succeeded, 1 if a result wasn't drawn or a gesture's
+//      ink was left on the pane
+//
+/////////////////////////////////////////////////////////
+static int BenchEndToEnd(int argc, char** argv)
+{
+    int cStrokesPerGesture = 50;
+    for (int i = 0; i < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "-n") && i + 1 < argc)
+            cStrokesPerGesture = atoi(argv[++i]);
+    }
+    if (cStrokesPerGesture < 1)
+        cStrokesPerGesture = 1;
+
+    CGestureEngine engine;
+    engine.AddBuiltinTemplates();
+    CHeadlessApp app(engine);
+    if (false == app.Create())
+        return 1;
+
+    // The built-in shapes of each gesture
+    const int cShapes = CGestureEngine::GetBuiltinShapeCount();
+    int* piShapes = (int*)malloc(cShapes * sizeof(int));
+    if (NULL == piShapes)
+        return 1;
+    CLatencyHistogram* pHistograms = new CLatencyHistogram[GE_NUM_SSGESTURES];
+
+    CSyntheticInk ink(4242);
+    GesturePoint rgpt[BENCH_MAX_POINTS];
+    CLatencyHistogram histAll;
+    PERFTIME ptMaxAll = 0;
+    int cStrokesAll = 0, cCorrectAll = 0, cNotDrawn = 0;
+
+    printf("%-18s %8s %9s %10s %10s %10s %10s\n", "gesture", "strokes", "correct",
+           "p50 us", "p90 us", "p99 us", "max us");
+    for (int g = 0; g < GE_NUM_SSGESTURES; g++)
+    {
+        int cGestureShapes = 0;
+        for (int i = 0; i < cShapes; i++)
+        {
+            int iGesture;
+            CGestureEngine::GetBuiltinShape(i, iGesture, rgpt, countof(rgpt));
+            if (g == iGesture)
+                piShapes[cGestureShapes++] = i;
+        }
+        if (0 == cGestureShapes)
+            continue;
+
+        PERFTIME ptMax = 0;
+        int cCorrect = 0;
+        for (int s = 0; s < cStrokesPerGesture; s++)
+        {
+            int iTruth;
+            int cPoints = ink.MakeStroke(piShapes[s % cGestureShapes], iTruth, rgpt, countof(rgpt));
+
+            app.OnPenDown();
+            for (int i = 0; i < cPoints; i++)
+            {
+                app.OnPacket(rgpt[i].x, rgpt[i].y, (PERFTIME)i * BENCH_PACKET_TIME);
+            }
+            PERFTIME ptPenUp = PerfNow();
+            int iShown = app.OnPenUp();
+            PERFTIME ptLatency = PerfNow() - ptPenUp;
+
+            if (false == app.IsGestureNameDrawn())
+                cNotDrawn++;
+            if (iShown == iTruth)
+                cCorrect++;
+            pHistograms[g].Record(ptLatency);
+            histAll.Record(ptLatency);
+            if (ptLatency > ptMax)
+                ptMax = ptLatency;
+        }
+
+        HistogramSnapshot hist;
+        pHistograms[g].Snapshot(hist);
+        printf("%-18s %8d %8.1f%% %10.1f %10.1f %10.1f %10.1f\n",
+               CGestureEngine::GetGestureName(g), cStrokesPerGesture,
+               100.0 * cCorrect / cStrokesPerGesture,
+               GetPercentileUpTo(hist, 50, ptMax) / 1e3, GetPercentileUpTo(hist, 90, ptMax) / 1e3,
+               GetPercentileUpTo(hist, 99, ptMax) / 1e3, ptMax / 1e3);
+
+        cStrokesAll += cStrokesPerGesture;
+        cCorrectAll += cCorrect;
+        if (ptMax > ptMaxAll)
+            ptMaxAll = ptMax;
+    }
+
+    HistogramSnapshot hist;
+    histAll.Snapshot(hist);
+    printf("%-18s %8d %8.1f%% %10.1f %10.1f %10.1f %10.1f\n", "all", cStrokesAll,
+           100.0 * cCorrectAll / cStrokesAll,
+           GetPercentileUpTo(hist, 50, ptMaxAll) / 1e3, GetPercentileUpTo(hist, 90, ptMaxAll) / 1e3,
+           GetPercentileUpTo(hist, 99, ptMaxAll) / 1e3, ptMaxAll / 1e3);
+
+    // The gesture's ink is drawn as it's written, and must be gone after
+    // the pen up whatever the gesture is bound to
+    static const char* const rgpszKeepInk[] = { "none", "undo", "recognize", "guide boxes", "command 100" };
+    int cInkLeft = 0;
+    printf("\n");
+    for (int k = 0; k < (int)countof(rgpszKeepInk); k++)
+    {
+        GestureCommand command;
+        CGestureBindings::ParseCommand(rgpszKeepInk[k], command);
+        for (int g = 0; g < GE_NUM_SSGESTURES; g++)
+        {
+            app.GetBindings().Bind(g, command);
+        }
+
+        // The synthetic ink lands anywhere, the pane may be smaller: the
+        // stroke is moved to the pane's corner
+        int iTruth;
+        int cPoints = ink.MakeStroke(k % cShapes, iTruth, rgpt, countof(rgpt));
+        float xMin = rgpt[0].x, yMin = rgpt[0].y;
+        for (int i = 1; i < cPoints; i++)
+        {
+            if (rgpt[i].x < xMin) xMin = rgpt[i].x;
+            if (rgpt[i].y < yMin) yMin = rgpt[i].y;
+        }
+        for (int i = 0; i < cPoints; i++)
+        {
+            rgpt[i].x += 500 - xMin;
+            rgpt[i].y += 500 - yMin;
+        }
+        app.OnPenDown();
+        for (int i = 0; i < cPoints; i++)
+        {
+            app.OnPacket(rgpt[i].x, rgpt[i].y, (PERFTIME)i * BENCH_PACKET_TIME);
+        }
+        bool bDrawn = app.GetRaster().FindPixel(app.GetInputRect(), HA_CLR_INK);
+        app.OnPenUp();
+        bool bLeft = app.GetRaster().FindPixel(app.GetInputRect(), HA_CLR_INK);
+        printf("gesture bound to %-12s ink %s\n", rgpszKeepInk[k],
+               (false == bDrawn) ? "never drawn" : bLeft ? "left on the pane" : "erased");
+        if (false == bDrawn || bLeft)
+            cInkLeft++;
+    }
+
+    free(piShapes);
+    delete[] pHistograms;
+
+    if (cNotDrawn > 0 || cInkLeft > 0)
+    {
+        if (cNotDrawn > 0)
+            printf("%d results weren't drawn\n", cNotDrawn);
+        if (cInkLeft > 0)
+            printf("%d gestures' ink wasn't erased\n", cInkLeft);
+        return 1;
+    }
+    return 0;
+}
+
+// Allocation counting for the micro suite. The glibc allocator entry
+// points are interposed and the MSVC debug runtime has an allocation
+// hook; elsewhere (the MSVC release runtime) the allocations aren't
+// counted and the suite prints a dash. The interposed entry points
+// are left out of the sanitizer builds, whose runtimes interpose the
+// same ones, and count only between StartCountingAllocs and
+// StopCountingAllocs, while the micro suite measures.
+static std::atomic<long> gs_cAllocs(0);
+static std::atomic<bool> gs_bCountAllocs(false);
+
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+#define BENCH_SANITIZED 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(thread_sanitizer) || __has_feature(memory_sanitizer)
+#define BENCH_SANITIZED 1
+#endif
+#endif
+
+static inline void CountAlloc()
+{
+    if (gs_bCountAllocs.load(std::memory_order_relaxed))
+        gs_cAllocs.fetch_add(1, std::memory_order_relaxed);
+}
+
+#if defined(_WIN32) && defined(_DEBUG)
+#include <crtdbg.h>
+#define BENCH_COUNTS_ALLOCS 1
+
+static int __cdecl AllocHook(int nAllocType, void* /*pvData*/, size_t /*cb*/,
+                             int /*nBlockUse*/, long /*lRequest*/,
+                             const unsigned char* /*pszFile*/, int /*iLine*/)
+{
+    if (_HOOK_ALLOC == nAllocType || _HOOK_REALLOC == nAllocType)
+        CountAlloc();
+    return TRUE;
+}
+
+static void StartCountingAllocs()
+{
+    _CrtSetAllocHook(AllocHook);
+    gs_bCountAllocs = true;
+}
+
+static void StopCountingAllocs()
+{
+    gs_bCountAllocs = false;
+    _CrtSetAllocHook(NULL);
+}
+
+#elif defined(__GLIBC__) && !defined(BENCH_SANITIZED)
+#define BENCH_COUNTS_ALLOCS 1
+
+extern "C" void* __libc_malloc(size_t cb);
+extern "C" void* __libc_calloc(size_t c, size_t cb);
+extern "C" void* __libc_realloc(void* pv, size_t cb);
+extern "C" void* __libc_memalign(size_t cbAlign, size_t cb);
+extern "C" void  __libc_free(void* pv);
+
+extern "C" void* malloc(size_t cb) __THROW
+{
+    CountAlloc();
+    return __libc_malloc(cb);
+}
+
+extern "C" void* calloc(size_t c, size_t cb) __THROW
+{
+    CountAlloc();
+    return __libc_calloc(c, cb);
+}
+
+extern "C" void* realloc(void* pv, size_t cb) __THROW
+{
+    CountAlloc();
+    return __libc_realloc(pv, cb);
+}
+
+extern "C" int posix_memalign(void** ppv, size_t cbAlign, size_t cb) __THROW
+{
+    // The alignment must be a power of two multiple of sizeof(void*)
+    if (0 == cbAlign || 0 != (cbAlign & (cbAlign - 1)) || 0 != cbAlign % sizeof(void*))
+        return EINVAL;
+    CountAlloc();
+    void* pv = __libc_memalign(cbAlign, cb);
+    if (NULL == pv)
+        return ENOMEM;
+    *ppv = pv;
+    return 0;
+}
+
+extern "C" void* aligned_alloc(size_t cbAlign, size_t cb) __THROW
+{
+    CountAlloc();
+    return __libc_memalign(cbAlign, cb);
+}
+
+// The frees aren't counted, but go to the allocator the blocks came from
+extern "C" void free(void* pv) __THROW
+{
+    __libc_free(pv);
+}
+
+static void StartCountingAllocs() { gs_bCountAllocs = true; }
+static void StopCountingAllocs() { gs_bCountAllocs = false; }
+
+#else
+#define BENCH_COUNTS_ALLOCS 0
+static void StartCountingAllocs() {}
+static void StopCountingAllocs() {}
+#endif
+
+/////////////////////////////////////////////////////////
+//
+// PinThread
+//
+// Pins the calling thread to one processor and raises its
+// priority where the platform allows it, so that the timings
+// don't include migrations between processors.
+//
+// Return Values (int):
+//      the processor, -1 if the thread couldn't be pinned
+//
+/////////////////////////////////////////////////////////
+static int PinThread()
+{
+#if defined(_WIN32)
+    DWORD_PTR dwProcessMask, dwSystemMask;
+    if (FALSE == ::GetProcessAffinityMask(::GetCurrentProcess(), &dwProcessMask, &dwSystemMask))
+        return -1;
+    for (int i = 0; i < (int)(8 * sizeof(DWORD_PTR)); i++)
+    {
+        DWORD_PTR dwMask = (DWORD_PTR)1 << i;
+        if (0 != (dwProcessMask & dwMask))
+        {
+            if (0 == ::SetThreadAffinityMask(::GetCurrentThread(), dwMask))
+                return -1;
+            ::SetThreadPriority(::GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
+            return i;
+        }
+    }
+    return -1;
+#elif defined(__linux__)
+    cpu_set_t set;
+    if (0 != sched_getaffinity(0, sizeof(set), &set))
+        return -1;
+    for (int i = 0; i < CPU_SETSIZE; i++)
+    {
+        if (CPU_ISSET(i, &set))
+        {
+            CPU_ZERO(&set);
+            CPU_SET(i, &set);
+            return (0 == sched_setaffinity(0, sizeof(set), &set)) ? i : -1;
+        }
+    }
+    return -1;
+#else
+    return -1;
+#endif
+}
+
+// The state the micro benchmark operations work on
+struct MicroContext
+{
+    CGestureEngine  engine;
+    GesturePoint    rgrgptStroke[GE_NUM_SSGESTURES][BENCH_MAX_POINTS];  // one per gesture
+    int             rgcPoints[GE_NUM_SSGESTURES];
+    GesturePoint    rgrgptNorm[GE_NUM_SSGESTURES][GE_NUM_POINTS];
+    GesturePoint    rgptTemplate[GE_NUM_POINTS];
+    GestureResult   rgResults[GE_NUM_SSGESTURES];
+    int             cResults;
+    int             iGesture;       // the gesture of the recognize operation
+    char            szText[256];
+    volatile float  fSink;          // keeps the results alive
+};
+
+// A measured operation
+struct MicroResult
+{
+    char    szName[64];
+    double  dNsPerOp;
+    double  dAllocsPerOp;       // negative if not counted
+};
+
+static void MicroResample(MicroContext& ctx, int i)
+{
+    int g = i % GE_GESTURE_TAP;
+    GesturePoint rgpt[GE_NUM_POINTS];
+    CGestureEngine::ResampleStroke(ctx.rgrgptStroke[g], ctx.rgcPoints[g], rgpt, GE_NUM_POINTS);
+    ctx.fSink = rgpt[GE_NUM_POINTS / 2].x;
+}
+
+static void MicroNormalize(MicroContext& ctx, int i)
+{
+    int g = i % GE_GESTURE_TAP;
+    GesturePoint rgpt[GE_NUM_POINTS];
+    CGestureEngine::NormalizeStroke(ctx.rgrgptStroke[g], ctx.rgcPoints[g], rgpt);
+    ctx.fSink = rgpt[GE_NUM_POINTS / 2].x;
+}
+
+static void MicroScore(MicroContext& ctx, int i)
+{
+    // The engine's default search, +-15 degrees to 2 degrees
+    float fDistance = CGestureEngine::DistanceAtBestAngle(
+                        ctx.rgrgptNorm[i % GE_GESTURE_TAP], ctx.rgptTemplate,
+                        15.0f * 3.14159265f / 180.0f, 2.0f * 3.14159265f / 180.0f);
+    ctx.fSink = CGestureEngine::ScoreFromDistance(fDistance);
+}
+
+static void MicroRecognize(MicroContext& ctx, int /*i*/)
+{
+    int g = ctx.iGesture;
+    ctx.cResults = ctx.engine.Recognize(ctx.rgrgptStroke[g], ctx.rgcPoints[g],
+                                        ctx.rgResults, countof(ctx.rgResults));
+    ctx.fSink = ctx.rgResults[0].fScore;
+}
+
+static void MicroNameLookup(MicroContext& ctx, int i)
+{
+    ctx.fSink = CGestureEngine::GetGestureName(i % GE_NUM_SSGESTURES)[0];
+}
+
+// Formats the top alternates the way the results window lists them
+static void MicroFormat(MicroContext& ctx, int /*i*/)
+{
+    int cch = 0;
+    for (int r = 0; r < ctx.cResults && r < 5; r++)
+    {
+        cch += snprintf(ctx.szText + cch, sizeof(ctx.szText) - cch, "%s%s %.2f",
+                        (0 == r) ? "" : ", ",
+                        CGestureEngine::GetGestureName(ctx.rgResults[r].iGesture),
+                        ctx.rgResults[r].fScore);
+    }
+    ctx.fSink = (float)cch;
+}
+
+/////////////////////////////////////////////////////////
+//
+// MeasureMicro
+//
+// Times an operation: doubles the batch until it takes
+// BENCH_MICRO_BATCH_NS, then takes the median ns/op of
+// BENCH_MICRO_RUNS batches, and counts the allocations of
+// one more batch.
+//
+/////////////////////////////////////////////////////////
+static void MeasureMicro(
+        const char* pszName,
+        void (*pfnOp)(MicroContext& ctx, int i),
+        MicroContext& ctx,
+        MicroResult& result
+        )
+{
+    int c = 1;
+    for (;;)
+    {
+        PERFTIME ptStart = PerfNow();
+        for (int i = 0; i < c; i++)
+            pfnOp(ctx, i);
+        if (PerfNow() - ptStart >= BENCH_MICRO_BATCH_NS || c >= (1 << 24))
+            break;
+        c *= 2;
+    }
+
+    double rgdNs[BENCH_MICRO_RUNS];
+    for (int r = 0; r < BENCH_MICRO_RUNS; r++)
+    {
+        PERFTIME ptStart = PerfNow();
+        for (int i = 0; i < c; i++)
+            pfnOp(ctx, i);
+        rgdNs[r] = (double)(PerfNow() - ptStart) / c;
+    }
+
+    // Insertion sort for the median
+    for (int r = 1; r < BENCH_MICRO_RUNS; r++)
+    {
+        double d = rgdNs[r];
+        int j = r;
+        for (; j > 0 && rgdNs[j - 1] > d; j--)
+            rgdNs[j] = rgdNs[j - 1];
+        rgdNs[j] = d;
+    }
+
+    long cAllocsBefore = gs_cAllocs.load();
+    for (int i = 0; i < c; i++)
+        pfnOp(ctx, i);
+    long cAllocs = gs_cAllocs.load() - cAllocsBefore;
+
+    // The names go to the baseline files, which are split on white space
+    int cch = 0;
+    for (; '\0' != pszName[cch] && cch < (int)sizeof(result.szName) - 1; cch++)
+        result.szName[cch] = (' ' == pszName[cch]) ? '_' : pszName[cch];
+    result.szName[cch] = '\0';
+    result.dNsPerOp = rgdNs[BENCH_MICRO_RUNS / 2];
+    result.dAllocsPerOp = BENCH_COUNTS_ALLOCS ? (double)cAllocs / c : -1.0;
+}
+
+/////////////////////////////////////////////////////////
+//
+// BenchMicro
+//
+// Times the steps of the recognition path one by one:
+// resampling, normalization, scoring against one template,
+// the full recognition of each gesture against the built-in
+// templates, the gesture name lookup and the formatting of
+// the alternates. Reports ns/op and allocations/op.
+//
+// Parameters:
+//     -save file          : [in] writes the results as a baseline
+//     -baseline file      : [in] compares the results with a baseline
+//     -tolerance percent  : [in] the slowdown allowed against the
+//                           baseline, 10 by default
+//
+// Return Values (int):
+//      0 if no operation regressed against the baseline: none
+//      is slower by more than the tolerance and none allocates
+//      more; 1 otherwise
+//
+/////////////////////////////////////////////////////////
+static int BenchMicro(int argc, char** argv)
+{
+    const char* pszSave = NULL;
+    const char* pszBaseline = NULL;
+    double dTolerance = 10.0;
+    for (int i = 0; i < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "-save") && i + 1 < argc)
+            pszSave = argv[++i];
+        else if (0 == strcmp(argv[i], "-baseline") && i + 1 < argc)
+            pszBaseline = argv[++i];
+        else if (0 == strcmp(argv[i], "-tolerance") && i + 1 < argc)
+            dTolerance = atof(argv[++i]);
+    }
+
+    int iCpu = PinThread();
+    if (iCpu >= 0)
+        printf("pinned to processor %d\n", iCpu);
+    else
+        printf("not pinned, expect more variance\n");
+
+    MicroContext* pctx = new MicroContext;
+    MicroContext& ctx = *pctx;
+    ctx.engine.AddBuiltinTemplates();
+    ctx.cResults = 0;
+    ctx.iGesture = 0;
+
+    // One synthetic stroke per gesture
+    for (int g = 0; g < GE_NUM_SSGESTURES; g++)
+        ctx.rgcPoints[g] = 0;
+    CSyntheticInk ink(2024);
+    GesturePoint rgpt[BENCH_MAX_POINTS];
+    for (int i = 0; i < CGestureEngine::GetBuiltinShapeCount(); i++)
+    {
+        int iGesture;
+        int cPoints = ink.MakeStroke(i, iGesture, rgpt, countof(rgpt));
+        if (0 == ctx.rgcPoints[iGesture])
+        {
+            memcpy(ctx.rgrgptStroke[iGesture], rgpt, cPoints * sizeof(GesturePoint));
+            ctx.rgcPoints[iGesture] = cPoints;
+            CGestureEngine::NormalizeStroke(rgpt, cPoints, ctx.rgrgptNorm[iGesture]);
+        }
+    }
+    ctx.engine.GetTemplatePoints(0, ctx.rgptTemplate);
+
+    StartCountingAllocs();
+
+    MicroResult rgResults[5 + GE_NUM_SSGESTURES];
+    int cResults = 0;
+    MeasureMicro("resample", MicroResample, ctx, rgResults[cResults++]);
+    MeasureMicro("normalize", MicroNormalize, ctx, rgResults[cResults++]);
+    MeasureMicro("score", MicroScore, ctx, rgResults[cResults++]);
+    for (int g = 0; g < GE_NUM_SSGESTURES; g++)
+    {
+        char szName[64];
+        snprintf(szName, sizeof(szName), "recognize/%s", CGestureEngine::GetGestureName(g));
+        ctx.iGesture = g;
+        MeasureMicro(szName, MicroRecognize, ctx, rgResults[cResults++]);
+    }
+    MeasureMicro("name_lookup", MicroNameLookup, ctx, rgResults[cResults++]);
+    MeasureMicro("format_results", MicroFormat, ctx, rgResults[cResults++]);
+    StopCountingAllocs();
+    delete pctx;
+
+    printf("%-32s %12s %12s\n", "operation", "ns/op", "allocs/op");
+    for (int i = 0; i < cResults; i++)
+    {
+        if (rgResults[i].dAllocsPerOp >= 0.0)
+            printf("%-32s %12.1f %12.2f\n", rgResults[i].szName,
+                   rgResults[i].dNsPerOp, rgResults[i].dAllocsPerOp);
+        else
+            printf("%-32s %12.1f %12s\n", rgResults[i].szName, rgResults[i].dNsPerOp, "-");
+    }
+
+    if (NULL != pszSave)
+    {
+        FILE* pFile = fopen(pszSave, "w");
+        if (NULL == pFile)
+        {
+            fprintf(stderr, "%s: can't write the baseline\n", pszSave);
+            return 1;
+        }
+        for (int i = 0; i < cResults; i++)
+        {
+            fprintf(pFile, "%s %.1f %.2f\n", rgResults[i].szName,
+                    rgResults[i].dNsPerOp, rgResults[i].dAllocsPerOp);
+        }
+        fclose(pFile);
+    }
+
+    int cRegressions = 0;
+    if (NULL != pszBaseline)
+    {
+        FILE* pFile = fopen(pszBaseline, "r");
+        if (NULL == pFile)
+        {
+            fprintf(stderr, "%s: can't read the baseline\n", pszBaseline);
+            return 1;
+        }
+        char szName[64];
+        double dNs, dAllocs;
+        while (3 == fscanf(pFile, "%63s %lf %lf", szName, &dNs, &dAllocs))
+        {
+            for (int i = 0; i < cResults; i++)
+            {
+                if (0 != strcmp(szName, rgResults[i].szName))
+                    continue;
+                if (rgResults[i].dNsPerOp > dNs * (1.0 + dTolerance / 100.0))
+                {
+                    printf("REGRESSION %s: %.1f ns/op, baseline %.1f\n",
+                           szName, rgResults[i].dNsPerOp, dNs);
+                    cRegressions++;
+                }
+                if (dAllocs >= 0.0 && rgResults[i].dAllocsPerOp > dAllocs)
+                {
+                    printf("REGRESSION %s: %.2f allocs/op, baseline %.2f\n",
+                           szName, rgResults[i].dAllocsPerOp, dAllocs);
+                    cRegressions++;
+                }
+            }
+        }
+        fclose(pFile);
+        printf("%d regressions against %s (tolerance %.0f%%)\n",
+               cRegressions, pszBaseline, dTolerance);
+    }
+
+    return (0 == cRegressions) ? 0 : 1;
+}
+
+// The notifications of the background recognizer, for the reco suite
+struct RecoNotifications
+{
+    volatile long       cNotified;
+    volatile long       lGeneration;    // of the last notification
+    volatile PERFTIME   ptTime;
+};
+
+static void OnRecoResults(void* pvContext, long lGeneration)
+{
+    RecoNotifications* pNotifications = (RecoNotifications*)pvContext;
+    pNotifications->ptTime = PerfNow();
+    pNotifications->lGeneration = lGeneration;
+    MetricsIncrement(&pNotifications->cNotified);
+}
+
+/////////////////////////////////////////////////////////
+//
+// SleepMs
+//
+// Suspends the thread, as the pen does between strokes.
+//
+/////////////////////////////////////////////////////////
+static void SleepMs(int cMs)
+{
+#ifdef _WIN32
+    ::Sleep(cMs);
+#else
+    struct timespec ts;
+    ts.tv_sec = cMs / 1000;
+    ts.tv_nsec = (long)(cMs % 1000) * 1000000;
+    nanosleep(&ts, NULL);
+#endif
+}
+
+/////////////////////////////////////////////////////////
+//
+// WaitForNotification
+//
+// Waits up to a timeout for the notification count to
+// exceed a value.
+//
+// Return Values (bool):
+//      true if notified, false if timed out
+//
+/////////////////////////////////////////////////////////
+static bool WaitForNotification(const RecoNotifications& notifications, long cNotified, int cTimeoutMs)
+{
+    for (int i = 0; i < cTimeoutMs; i++)
+    {
+        if (notifications.cNotified > cNotified)
+            return true;
+        SleepMs(1);
+    }
+    return (notifications.cNotified > cNotified);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CompareAlternates
+//
+// Tells if the delivered alternates are the ones the
+// recognizer gives for the ink in the foreground.
+//
+/////////////////////////////////////////////////////////
+static bool CompareAlternates(
+        IStrokeRecognizer& recognizer,
+        const CRecoInk& ink,
+        const RecoAlternate* pAlternates,
+        int cAlternates
+        )
+{
+    long lGeneration = 1;
+    RecoCancel cancel = { &lGeneration, 1 };
+    RecoAlternate rgExpected[BR_MAX_ALTERNATES];
+    int cExpected = recognizer.Recognize(ink, cancel, rgExpected, BR_MAX_ALTERNATES);
+    if (cExpected != cAlternates)
+        return false;
+    for (int i = 0; i < cAlternates; i++)
+    {
+        if (0 != strcmp(rgExpected[i].szText, pAlternates[i].szText))
+            return false;
+    }
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// BenchBackgroundReco
+//
+// Drives the background recognition pipeline with the
+// stand-in recognizer the way the application does. Words of
+// a few synthetic strokes are written with a short pause
+// between the strokes; every stroke submits the ink so far.
+// Every word must be recognized once, after its last
+// stroke, with the results of its whole ink. Then a long
+// ink is submitted and at once replaced by a short one: the
+// long job must be dropped or cancelled, and only the short
+// one's results delivered.
+//
+// Parameters:
+//     -n count       : [in] the words, 20 by default
+//     -debounce ms   : [in] the debounce time, 50 ms by default, at
+//                      least 10 ms; the strokes come every fifth of it
+//
+// Return Values (int):
+//      0 if succeeded, 1 if a word wasn't delivered once with its
+//      own results, or the stale job was delivered
+//
+/////////////////////////////////////////////////////////
+static int BenchBackgroundReco(int argc, char** argv)
+{
+    int cWords = 20;
+    int cDebounceMs = 50;
+    for (int i = 0; i < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "-n") && i + 1 < argc)
+            cWords = atoi(argv[++i]);
+        else if (0 == strcmp(argv[i], "-debounce") && i + 1 < argc)
+            cDebounceMs = atoi(argv[++i]);
+    }
+    if (cWords < 1)
+        cWords = 1;
+    if (cDebounceMs < 10)
+        cDebounceMs = 10;   // the strokes of a word must come faster
+
+    // The pause between the strokes is well below the debounce time
+    const int cStrokesPerWord = 4;
+    const int cStrokePauseMs = cDebounceMs / 5;
+
+    CGestureEngine engine;
+    engine.AddBuiltinTemplates();
+    CGestureTextRecognizer recognizer(engine);
+
+    RecoNotifications notifications = { 0, 0, 0 };
+    CBackgroundRecognizer background;
+    if (false == background.Start(&recognizer, OnRecoResults, &notifications, cDebounceMs))
+    {
+        printf("can't start the background recognizer\n");
+        return 1;
+    }
+
+    CSyntheticInk synth(3535);
+    const int cShapes = CGestureEngine::GetBuiltinShapeCount();
+    GesturePoint rgpt[BENCH_MAX_POINTS];
+    CRecoInk ink;
+    CLatencyHistogram histSubmit, histResult;
+    PERFTIME ptMaxSubmit = 0, ptMaxResult = 0;
+    int cErrors = 0;
+
+    printf("%d words of %d strokes, %d ms between the strokes, %d ms debounce\n",
+           cWords, cStrokesPerWord, cStrokePauseMs, cDebounceMs);
+
+    for (int w = 0; w < cWords; w++)
+    {
+        ink.Clear();
+        long cNotified = notifications.cNotified;
+        long lGeneration = 0;
+        PERFTIME ptLastStroke = 0;
+        for (int s = 0; s < cStrokesPerWord; s++)
+        {
+            int iGesture;
+            int cPoints = synth.MakeStroke((w * cStrokesPerWord + s) % cShapes, iGesture,
+                                           rgpt, countof(rgpt));
+            ink.AddStroke(rgpt, cPoints);
+
+            // The cost of the submission is on the pen input's thread
+            ptLastStroke = PerfNow();
+            lGeneration = background.Submit(ink, false);
+            PERFTIME ptSubmit = PerfNow() - ptLastStroke;
+            histSubmit.Record(ptSubmit);
+            if (ptSubmit > ptMaxSubmit)
+                ptMaxSubmit = ptSubmit;
+
+            if (s < cStrokesPerWord - 1)
+                SleepMs(cStrokePauseMs);
+        }
+
+        if (false == WaitForNotification(notifications, cNotified, 2000 + cDebounceMs))
+        {
+            printf("word %d: no results\n", w);
+            cErrors++;
+            continue;
+        }
+        PERFTIME ptResult = notifications.ptTime - ptLastStroke;
+        histResult.Record(ptResult);
+        if (ptResult > ptMaxResult)
+            ptMaxResult = ptResult;
+
+        // No other delivery may follow for the word
+        SleepMs(cDebounceMs + cStrokePauseMs);
+        RecoAlternate rgAlternates[BR_MAX_ALTERNATES];
+        int cAlternates = background.GetResults(lGeneration, rgAlternates, countof(rgAlternates));
+        if (notifications.cNotified != cNotified + 1 || notifications.lGeneration != lGeneration)
+        {
+            printf("word %d: %ld deliveries, last generation %ld instead of %ld\n",
+                   w, notifications.cNotified - cNotified, notifications.lGeneration, lGeneration);
+            cErrors++;
+        }
+        else if (cAlternates < 0 || false == CompareAlternates(recognizer, ink, rgAlternates, cAlternates))
+        {
+            printf("word %d: the results aren't the ones of its ink\n", w);
+            cErrors++;
+        }
+        else if (0 == w)
+        {
+            printf("first word: \"%s\"\n", rgAlternates[0].szText);
+        }
+    }
+
+    HistogramSnapshot hist;
+    histSubmit.Snapshot(hist);
+    printf("submit                 p50 %8.1f us  p99 %8.1f us  max %8.1f us\n",
+           GetPercentileUpTo(hist, 50, ptMaxSubmit) / 1e3,
+           GetPercentileUpTo(hist, 99, ptMaxSubmit) / 1e3, ptMaxSubmit / 1e3);
+    histResult.Snapshot(hist);
+    printf("last stroke to results p50 %8.1f ms  p99 %8.1f ms  max %8.1f ms\n",
+           GetPercentileUpTo(hist, 50, ptMaxResult) / 1e6,
+           GetPercentileUpTo(hist, 99, ptMaxResult) / 1e6, ptMaxResult / 1e6);
+
+    // A long job replaced by a short one right after it starts
+    CRecoInk inkLong;
+    for (int i = 0; i < 2000; i++)
+    {
+        int iGesture;
+        int cPoints = synth.MakeStroke(i % cShapes, iGesture, rgpt, countof(rgpt));
+        inkLong.AddStroke(rgpt, cPoints);
+    }
+    long cNotified = notifications.cNotified;
+    long lLong = background.Submit(inkLong, true);
+    SleepMs(1);
+    long lShort = background.Submit(ink, true);
+    if (false == WaitForNotification(notifications, cNotified, 10000))
+    {
+        printf("stale job: no results\n");
+        cErrors++;
+    }
+    else
+    {
+        SleepMs(cStrokePauseMs);
+        RecoAlternate rgAlternates[BR_MAX_ALTERNATES];
+        if (notifications.lGeneration != lShort || notifications.cNotified != cNotified + 1)
+        {
+            printf("stale job: generation %ld delivered\n", lLong);
+            cErrors++;
+        }
+        else if (background.GetResults(lLong, rgAlternates, countof(rgAlternates)) >= 0
+                 || background.GetResults(lShort, rgAlternates, countof(rgAlternates)) < 0)
+        {
+            printf("stale job: the results of the wrong generation\n");
+            cErrors++;
+        }
+    }
+
+    background.Stop();
+
+    RecoStats stats;
+    background.GetStats(stats);
+    printf("jobs: %u submitted, %u superseded, %u cancelled, %u failed, %u delivered\n",
+           stats.cSubmitted, stats.cSuperseded, stats.cCancelled, stats.cFailed, stats.cDelivered);
+
+    if (cErrors > 0)
+    {
+        printf("%d errors\n", cErrors);
+        return 1;
+    }
+    return 0;
+}
+
+/////////////////////////////////////////////////////////
+//
+// class CCostlyRecognizer
+//
+// The stand-in recognizer with the cost of a real one: every
+// recognition sleeps for a while first. The worker pool's
+// gain comes from running the cells' recognitions side by
+// side, which sleeping shows even on a single processor.
+//
+/////////////////////////////////////////////////////////
+
+class CCostlyRecognizer : public IStrokeRecognizer
+{
+    CGestureTextRecognizer  m_recognizer;
+    int                     m_cCostMs;
+
+public:
+
+    CCostlyRecognizer(const CGestureEngine& engine, int cCostMs)
+        : m_recognizer(engine), m_cCostMs(cCostMs)
+    {
+    }
+
+    virtual int Recognize(const CRecoInk& ink, const RecoCancel& cancel,
+                          RecoAlternate* pAlternates, int cMaxAlternates)
+    {
+        if (m_cCostMs > 0)
+            SleepMs(m_cCostMs);
+        return m_recognizer.Recognize(ink, cancel, pAlternates, cMaxAlternates);
+    }
+};
+
+/////////////////////////////////////////////////////////
+//
+// PlaceStroke
+//
+// Scales a stroke to a part of a cell and moves it to the
+// middle of the cell.
+//
+/////////////////////////////////////////////////////////
+static void PlaceStroke(GesturePoint* ppt, int cPoints, float xCenter, float yCenter, float fSize)
+{
+    float xMin = ppt[0].x, xMax = ppt[0].x;
+    float yMin = ppt[0].y, yMax = ppt[0].y;
+    for (int i = 1; i < cPoints; i++)
+    {
+        if (ppt[i].x < xMin) xMin = ppt[i].x;
+        if (ppt[i].x > xMax) xMax = ppt[i].x;
+        if (ppt[i].y < yMin) yMin = ppt[i].y;
+        if (ppt[i].y > yMax) yMax = ppt[i].y;
+    }
+    float fExtent = (xMax - xMin > yMax - yMin) ? xMax - xMin : yMax - yMin;
+    float fScale = (fExtent > 0) ? fSize / fExtent : 1.0f;
+    for (int i = 0; i < cPoints; i++)
+    {
+        ppt[i].x = xCenter + (ppt[i].x - 0.5f * (xMin + xMax)) * fScale;
+        ppt[i].y = yCenter + (ppt[i].y - 0.5f * (yMin + yMax)) * fScale;
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// TimeGuidedRecognition
+//
+// Recognizes the ink a few times on a pool of workers and
+// keeps the fastest time and the results.
+//
+// Return Values (PERFTIME):
+//      the fastest recognition, 0 if it failed
+//
+/////////////////////////////////////////////////////////
+static PERFTIME TimeGuidedRecognition(
+        IStrokeRecognizer* pRecognizer,
+        int cWorkers,
+        const CRecoInk& ink,
+        RecoAlternate* pAlternates,
+        int& cAlternates
+        )
+{
+    IStrokeRecognizer* rgpRecognizers[BR_MAX_WORKERS];
+    for (int i = 0; i < cWorkers; i++)
+    {
+        // The stand-in is stateless, the workers share it
+        rgpRecognizers[i] = pRecognizer;
+    }
+    CRecoWorkerPool pool;
+    if (false == pool.Start(rgpRecognizers, cWorkers))
+        return 0;
+    CGuidedRecognizer guided(pool);
+
+    long lGeneration = 1;
+    RecoCancel cancel = { &lGeneration, 1 };
+    PERFTIME ptBest = 0;
+    for (int r = 0; r < 5; r++)
+    {
+        PERFTIME ptStart = PerfNow();
+        cAlternates = guided.Recognize(ink, cancel, pAlternates, BR_MAX_ALTERNATES);
+        PERFTIME pt = PerfNow() - ptStart;
+        if (cAlternates < 0)
+            return 0;
+        if (0 == ptBest || pt < ptBest)
+            ptBest = pt;
+    }
+    return ptBest;
+}
+
+/////////////////////////////////////////////////////////
+//
+// BenchGuidedReco
+//
+// Writes a stroke or two of synthetic ink in every cell of
+// a guide and measures the segmentation and the recognition
+// of the cells on one worker against a pool of workers. The
+// strokes must land in the cells they're written in, the
+// pool must give the same text as one worker, and that text
+// must be the cells' own texts in order. A cancelled job
+// must not give results.
+//
+// Parameters:
+//     -rows n      : [in] the rows of the guide, 3 by default
+//     -cols n      : [in] the boxes in a row, 8 by default, 0 for lines
+//     -threads n   : [in] the workers of the pool, by default the
+//                    processors but at least 4
+//     -cost ms     : [in] the time a recognition of a cell takes,
+//                    5 ms by default
+//
+// Return Values (int):
+//      0 if succeeded, 1 if a stroke went to the wrong cell or the
+//      results differ
+//
+/////////////////////////////////////////////////////////
+static int BenchGuidedReco(int argc, char** argv)
+{
+    int cRows = 3;
+    int cColumns = 8;
+    int cThreads = CRecoWorkerPool::GetProcessorCount();
+    if (cThreads < 4)
+        cThreads = 4;
+    int cCostMs = 5;
+    for (int i = 0; i < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "-rows") && i + 1 < argc)
+            cRows = atoi(argv[++i]);
+        else if (0 == strcmp(argv[i], "-cols") && i + 1 < argc)
+            cColumns = atoi(argv[++i]);
+        else if (0 == strcmp(argv[i], "-threads") && i + 1 < argc)
+            cThreads = atoi(argv[++i]);
+        else if (0 == strcmp(argv[i], "-cost") && i + 1 < argc)
+            cCostMs = atoi(argv[++i]);
+    }
+    if (cRows < 1)
+        cRows = 1;
+    if (cColumns < 0)
+        cColumns = 0;
+    if (cThreads < 1)
+        cThreads = 1;
+    else if (cThreads > BR_MAX_WORKERS)
+        cThreads = BR_MAX_WORKERS;
+    if (cCostMs < 0)
+        cCostMs = 0;
+
+    const float fCell = 1000.0f;
+    CRecoGuide guide;
+    guide.Set(0, 0, fCell, fCell, cRows, cColumns);
+    const int cCellColumns = guide.GetCellColumns();
+    const int cCells = cRows * cCellColumns;
+
+    CGestureEngine engine;
+    engine.AddBuiltinTemplates();
+    CGestureTextRecognizer recognizer(engine);
+    CCostlyRecognizer costly(engine, cCostMs);
+
+    // One or two strokes per cell, written row by row; the ink of
+    // every cell is also kept on its own
+    CSyntheticInk synth(3636);
+    const int cShapes = CGestureEngine::GetBuiltinShapeCount();
+    GesturePoint rgpt[BENCH_MAX_POINTS];
+    CRecoInk ink;
+    CRecoInk* pCellInks = new CRecoInk[cCells];
+    int cErrors = 0;
+    for (int c = 0; c < cCells; c++)
+    {
+        int cStrokes = 1 + (int)(synth.NextUInt() % 2);
+        for (int s = 0; s < cStrokes; s++)
+        {
+            int iGesture;
+            int cPoints = synth.MakeStroke((c * 2 + s) % cShapes, iGesture, rgpt, countof(rgpt));
+            PlaceStroke(rgpt, cPoints, (c % cCellColumns + 0.5f) * fCell,
+                        (c / cCellColumns + 0.5f) * fCell, 0.6f * fCell);
+            int iCell = guide.GetStrokeCell(rgpt, cPoints);
+            if (iCell != c)
+            {
+                printf("cell %d: a stroke went to cell %d\n", c, iCell);
+                cErrors++;
+            }
+            ink.AddStroke(rgpt, cPoints, iCell);
+            pCellInks[c].AddStroke(rgpt, cPoints, c);
+        }
+    }
+    ink.SetCellColumns(cCellColumns);
+
+    // The segmentation: a stroke's cell from its coordinates alone
+    const int cBinRuns = 200;
+    volatile int iSink = 0;
+    PERFTIME ptStart = PerfNow();
+    for (int r = 0; r < cBinRuns; r++)
+    {
+        for (int i = 0; i < ink.GetStrokeCount(); i++)
+        {
+            int cPoints;
+            const GesturePoint* ppt = ink.GetStroke(i, cPoints);
+            iSink += guide.GetStrokeCell(ppt, cPoints);
+        }
+    }
+    double dBinNs = (double)(PerfNow() - ptStart) / ((double)cBinRuns * ink.GetStrokeCount());
+
+    printf("%d x %d %s, %d strokes, %d ms per cell, %d workers\n",
+           cRows, cColumns, (0 == cColumns) ? "lines" : "boxes", ink.GetStrokeCount(),
+           cCostMs, cThreads);
+    printf("segmentation           %8.1f ns/stroke\n", dBinNs);
+
+    // The expected text: the cells' own texts, the rows apart
+    char szExpected[BR_MAX_TEXT] = "";
+    long lGeneration = 1;
+    RecoCancel cancel = { &lGeneration, 1 };
+    for (int c = 0; c < cCells; c++)
+    {
+        RecoAlternate rgCell[BR_MAX_ALTERNATES];
+        if (recognizer.Recognize(pCellInks[c], cancel, rgCell, BR_MAX_ALTERNATES) <= 0)
+            continue;
+        if (c > 0 && 0 == c % cCellColumns && szExpected[0] != '\0')
+        {
+            strncat(szExpected, " ", BR_MAX_TEXT - 1 - strlen(szExpected));
+        }
+        strncat(szExpected, rgCell[0].szText, BR_MAX_TEXT - 1 - strlen(szExpected));
+    }
+    delete [] pCellInks;
+
+    RecoAlternate rgSerial[BR_MAX_ALTERNATES], rgParallel[BR_MAX_ALTERNATES];
+    int cSerial = 0, cParallel = 0;
+    PERFTIME ptSerial = TimeGuidedRecognition(&costly, 1, ink, rgSerial, cSerial);
+    PERFTIME ptParallel = TimeGuidedRecognition(&costly, cThreads, ink, rgParallel, cParallel);
+    if (0 == ptSerial || 0 == ptParallel)
+    {
+        printf("can't start the workers or the recognition failed\n");
+        return 1;
+    }
+    printf("1 worker               %8.1f ms\n", ptSerial / 1e6);
+    printf("%2d workers             %8.1f ms  %.1fx\n", cThreads, ptParallel / 1e6,
+           (double)ptSerial / ptParallel);
+
+    if (cSerial != cParallel)
+    {
+        printf("%d alternates on 1 worker, %d on %d\n", cSerial, cParallel, cThreads);
+        cErrors++;
+    }
+    for (int i = 0; i < cSerial && i < cParallel; i++)
+    {
+        if (0 != strcmp(rgSerial[i].szText, rgParallel[i].szText))
+        {
+            printf("alternate %d: \"%s\" on 1 worker, \"%s\" on %d\n",
+                   i, rgSerial[i].szText, rgParallel[i].szText, cThreads);
+            cErrors++;
+        }
+    }
+    if (cParallel <= 0 || 0 != strcmp(rgParallel[0].szText, szExpected))
+    {
+        printf("the text isn't the cells' text in order:\n  \"%s\"\n  \"%s\"\n",
+               (cParallel > 0) ? rgParallel[0].szText : "", szExpected);
+        cErrors++;
+    }
+    else
+    {
+        printf("text: \"%.60s%s\"\n", szExpected, (strlen(szExpected) > 60) ? "..." : "");
+    }
+
+    // A stale job gives no results
+    {
+        IStrokeRecognizer* rgpRecognizers[BR_MAX_WORKERS];
+        for (int i = 0; i < cThreads; i++)
+        {
+            rgpRecognizers[i] = &costly;
+        }
+        CRecoWorkerPool pool;
+        CGuidedRecognizer guided(pool);
+        RecoCancel stale = { &lGeneration, 0 };
+        if (false == pool.Start(rgpRecognizers, cThreads)
+            || guided.Recognize(ink, stale, rgParallel, BR_MAX_ALTERNATES) >= 0)
+        {
+            printf("a cancelled job gave results\n");
+            cErrors++;
+        }
+    }
+
+    if (cErrors > 0)
+    {
+        printf("%d errors\n", cErrors);
+        return 1;
+    }
+    return 0;
+}
+
+// The syllables of the synthetic words; no 'q' in them, so a word
+// with a 'q' is never in the list
+static const char* const gc_rgpszSyllables[] = {
+    "ka", "ri", "to", "mo", "na", "shi", "re", "po", "lu", "ven", "dar", "ex",
+    "al", "be", "con", "di", "fu", "gra", "hel", "in", "jo", "mar", "ster", "wy",
+};
+
+static int CompareWords(const void* pv1, const void* pv2)
+{
+    return strcmp(*(const char* const*)pv1, *(const char* const*)pv2);
+}
+
+// A factoid sample and whether the factoid takes it
+struct FactoidSample
+{
+    int         iFactoid;
+    const char* pszText;
+    bool        bAccepted;
+};
+
+static const FactoidSample gc_rgFactoidSamples[] = {
+    { RC_FACTOID_DIGIT, "0123", true }, { RC_FACTOID_DIGIT, "12a", false },
+    { RC_FACTOID_NUMBER, "-3.25", true }, { RC_FACTOID_NUMBER, "1,000,000", true },
+    { RC_FACTOID_NUMBER, "1.", false },
+    { RC_FACTOID_DATE, "3/14/2026", true }, { RC_FACTOID_DATE, "14.03.26", true },
+    { RC_FACTOID_DATE, "14/3", false },
+    { RC_FACTOID_TIME, "9:05", true }, { RC_FACTOID_TIME, "12:30:15 PM", true },
+    { RC_FACTOID_TIME, "930", false },
+    { RC_FACTOID_EMAIL, "first.last@example.com", true }, { RC_FACTOID_EMAIL, "me@host", false },
+    { RC_FACTOID_WEB, "www.example.com", true },
+    { RC_FACTOID_WEB, "https://example.com/a?b=1", true }, { RC_FACTOID_WEB, "example", false },
+    { RC_FACTOID_TELEPHONE, "+1 (425) 555-0100", true },
+    { RC_FACTOID_TELEPHONE, "555-0100", true }, { RC_FACTOID_TELEPHONE, "555-", false },
+    { RC_FACTOID_POSTALCODE, "98052", true }, { RC_FACTOID_POSTALCODE, "98052-6399", true },
+    { RC_FACTOID_POSTALCODE, "9805", false },
+    { RC_FACTOID_CURRENCY, "$1,234.56", true }, { RC_FACTOID_CURRENCY, "$12.5", false },
+    { RC_FACTOID_UPPERCHAR, "Q", true }, { RC_FACTOID_UPPERCHAR, "q", false },
+};
+
+// Sets an alternate
+static void SetAlternate(RecoAlternate& alternate, const char* pszText, float fScore)
+{
+    snprintf(alternate.szText, BR_MAX_TEXT, "%s", pszText);
+    alternate.fScore = fScore;
+}
+
+/////////////////////////////////////////////////////////
+//
+// BenchWordList
+//
+// Compiles a list of synthetic words into a word list file,
+// maps it and measures the size, the time to map it and the
+// time to look up a word. Every word must be found and no
+// word that isn't in the list. Then checks the factoids
+// against samples and the lattice search: the best text of
+// the alternates the constraint accepts must come first.
+//
+// Parameters:
+//     -n count : [in] the words, 200000 by default
+//
+// Return Values (int):
+//      0 if succeeded, 1 if a lookup, a factoid or the search is wrong
+//
+/////////////////////////////////////////////////////////
+static int BenchWordList(int argc, char** argv)
+{
+    int cWords = 200000;
+    for (int i = 0; i < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "-n") && i + 1 < argc)
+            cWords = atoi(argv[++i]);
+    }
+    if (cWords < 16)
+        cWords = 16;
+
+    // 3 to 6 syllables a word
+    const int cchMaxWord = 6 * 4;
+    char* pszText = (char*)malloc((size_t)cWords * (cchMaxWord + 1));
+    char** ppszWords = (char**)malloc(cWords * sizeof(char*));
+    if (NULL == pszText || NULL == ppszWords)
+    {
+        free(pszText);
+        free(ppszWords);
+        printf("out of memory\n");
+        return 1;
+    }
+    CSyntheticInk synth(3737);
+    for (int i = 0; i < cWords; i++)
+    {
+        char* psz = pszText + (size_t)i * (cchMaxWord + 1);
+        psz[0] = '\0';
+        int cSyllables = 3 + (int)(synth.NextUInt() % 4);
+        for (int k = 0; k < cSyllables; k++)
+        {
+            strcat(psz, gc_rgpszSyllables[synth.NextUInt() % countof(gc_rgpszSyllables)]);
+        }
+        ppszWords[i] = psz;
+    }
+
+    const char* pszFileName = "GestureBench.wld";
+    PERFTIME ptStart = PerfNow();
+    qsort(ppszWords, cWords, sizeof(char*), CompareWords);
+    CWordListBuilder builder;
+    int cErrors = 0;
+    size_t cbWords = 0;     // the distinct words as text, a line each
+    for (int i = 0; i < cWords; i++)
+    {
+        if (false == builder.AddWord(ppszWords[i]))
+            cErrors++;
+        if (0 == i || 0 != strcmp(ppszWords[i], ppszWords[i - 1]))
+            cbWords += strlen(ppszWords[i]) + 1;
+    }
+    bool bWritten = builder.Write(pszFileName);
+    PERFTIME ptBuild = PerfNow() - ptStart;
+
+    CWordList wordList;
+    ptStart = PerfNow();
+    bool bOpen = bWritten && wordList.Open(pszFileName);
+    PERFTIME ptOpen = PerfNow() - ptStart;
+    if (cErrors > 0 || false == bOpen)
+    {
+        printf("can't build or map the word list\n");
+        free(pszText);
+        free(ppszWords);
+        remove(pszFileName);
+        return 1;
+    }
+
+    const WordListHeader* pHeader = wordList.GetHeader();
+    printf("%d words, %u distinct, %u nodes, %u edges\n",
+           cWords, pHeader->cWords, pHeader->cNodes, pHeader->cEdges);
+    printf("build                  %8.1f ms\n", ptBuild / 1e6);
+    printf("file                   %8.1f KB  %.2f bytes/word (as text: %.2f)\n",
+           pHeader->cbFile / 1024.0, (double)pHeader->cbFile / pHeader->cWords,
+           (double)cbWords / pHeader->cWords);
+    printf("map                    %8.1f us\n", ptOpen / 1000.0);
+
+    // Every word is found, and no word with a 'q' in it
+    ptStart = PerfNow();
+    int cFound = 0;
+    for (int i = 0; i < cWords; i++)
+    {
+        if (wordList.Accepts(ppszWords[i]))
+            cFound++;
+    }
+    double dLookupNs = (double)(PerfNow() - ptStart) / cWords;
+    printf("lookup                 %8.1f ns/word\n", dLookupNs);
+    if (cFound != cWords)
+    {
+        printf("%d words of the list not found\n", cWords - cFound);
+        cErrors++;
+    }
+
+    char szWord[64];
+    for (int i = 0; i < cWords; i += 97)
+    {
+        size_t cch = strlen(ppszWords[i]);
+        snprintf(szWord, sizeof(szWord), "%.*sq%s", (int)(cch / 2), ppszWords[i], ppszWords[i] + cch / 2);
+        if (wordList.Accepts(szWord))
+        {
+            printf("\"%s\" found, it isn't in the list\n", szWord);
+            cErrors++;
+        }
+    }
+    snprintf(szWord, sizeof(szWord), "%s %s", ppszWords[0], ppszWords[cWords - 1]);
+    if (false == wordList.Accepts(szWord))
+    {
+        printf("\"%s\" not found, both words are in the list\n", szWord);
+        cErrors++;
+    }
+
+    // The factoids
+    for (int i = 0; i < (int)countof(gc_rgFactoidSamples); i++)
+    {
+        const FactoidSample& sample = gc_rgFactoidSamples[i];
+        CFactoid factoid(sample.iFactoid);
+        if (factoid.Accepts(sample.pszText) != sample.bAccepted)
+        {
+            printf("%s: \"%s\" %s\n", CFactoid::GetFactoidName(sample.iFactoid), sample.pszText,
+                   sample.bAccepted ? "rejected" : "accepted");
+            cErrors++;
+        }
+    }
+
+    // The lattice of two lines of ink: the best alternates of the
+    // lines aren't words, the second ones are
+    RecoAlternate rgLine1[2], rgLine2[2];
+    SetAlternate(rgLine1[0], "qx", 0.9f);
+    SetAlternate(rgLine1[1], ppszWords[5], 0.5f);
+    SetAlternate(rgLine2[0], "zq", 0.8f);
+    SetAlternate(rgLine2[1], ppszWords[7], 0.6f);
+    LatticeSegment rgSegments[2] = { { rgLine1, 2, "" }, { rgLine2, 2, " " } };
+    RecoAlternate rgResults[BR_MAX_ALTERNATES];
+    CLatticeSearch search;
+    const int cSearchRuns = 10000;
+    int cResults = 0;
+    ptStart = PerfNow();
+    for (int r = 0; r < cSearchRuns; r++)
+    {
+        cResults = search.Search(wordList, rgSegments, 2, rgResults, BR_MAX_ALTERNATES);
+    }
+    double dSearchUs = (double)(PerfNow() - ptStart) / cSearchRuns / 1000.0;
+    printf("lattice search         %8.2f us/search\n", dSearchUs);
+    snprintf(szWord, sizeof(szWord), "%s %s", ppszWords[5], ppszWords[7]);
+    if (cResults < 1 || 0 != strcmp(rgResults[0].szText, szWord))
+    {
+        printf("search: \"%s\", expected \"%s\"\n", (cResults > 0) ? rgResults[0].szText : "", szWord);
+        cErrors++;
+    }
+
+    // And of two boxes of digits
+    RecoAlternate rgBox1[2], rgBox2[2];
+    SetAlternate(rgBox1[0], "l", 0.9f);
+    SetAlternate(rgBox1[1], "1", 0.6f);
+    SetAlternate(rgBox2[0], "O", 0.9f);
+    SetAlternate(rgBox2[1], "0", 0.5f);
+    LatticeSegment rgBoxes[2] = { { rgBox1, 2, "" }, { rgBox2, 2, "" } };
+    CFactoid digit(RC_FACTOID_DIGIT);
+    cResults = search.Search(digit, rgBoxes, 2, rgResults, BR_MAX_ALTERNATES);
+    if (1 != cResults || 0 != strcmp(rgResults[0].szText, "10"))
+    {
+        printf("search: %d results, \"%s\", expected \"10\"\n", cResults,
+               (cResults > 0) ? rgResults[0].szText : "");
+        cErrors++;
+    }
+
+    wordList.Close();
+    remove(pszFileName);
+    free(pszText);
+    free(ppszWords);
+
+    if (cErrors > 0)
+    {
+        printf("%d errors\n", cErrors);
+        return 1;
+    }
+    return 0;
+}
+
+// The decimate suite: the points of a stroke of a 1 kHz pen, the strokes,
+// and the noise of the digitizer, in ink units
+#define BENCH_DENSE_POINTS      (BENCH_MAX_POINTS * 8)
+#define BENCH_DENSE_STROKES     720
+#define BENCH_DENSE_NOISE       2.0f
+
+/////////////////////////////////////////////////////////
+//
+// MakeDenseStroke
+//
+// Makes a synthetic stroke as a 1 kHz pen would report it:
+// eight packets along every segment of a stroke of the usual
+// density, each off by the digitizer's noise.
+//
+// Return Values (int):
+//      the number of the points
+//
+/////////////////////////////////////////////////////////
+static int MakeDenseStroke(CSyntheticInk& synth, int iShape, int& iGesture, GesturePoint* ppt)
+{
+    GesturePoint rgpt[BENCH_MAX_POINTS];
+    int cPoints = synth.MakeStroke(iShape, iGesture, rgpt, countof(rgpt));
+    if (cPoints < 2)
+    {
+        memcpy(ppt, rgpt, cPoints * sizeof(GesturePoint));
+        return cPoints;
+    }
+
+    int cDense = 0;
+    for (int i = 0; i + 1 < cPoints; i++)
+    {
+        for (int k = 0; k < 8; k++)
+        {
+            float f = k / 8.0f;
+            ppt[cDense].x = rgpt[i].x + f * (rgpt[i + 1].x - rgpt[i].x)
+                            + synth.NextRange(-BENCH_DENSE_NOISE, BENCH_DENSE_NOISE);
+            ppt[cDense].y = rgpt[i].y + f * (rgpt[i + 1].y - rgpt[i].y)
+                            + synth.NextRange(-BENCH_DENSE_NOISE, BENCH_DENSE_NOISE);
+            cDense++;
+        }
+    }
+    ppt[cDense++] = rgpt[cPoints - 1];
+    return cDense;
+}
+
+/////////////////////////////////////////////////////////
+//
+// BenchDecimate
+//
+// Draws dense synthetic strokes, a 1 kHz digitizer's worth
+// of points (see MakeDenseStroke), and decimates them with a
+// range of tolerances.
+// Reports the compression, the cost of the decimation, and
+// the accuracy and the time of the recognition of the
+// decimated strokes against the dense ones. Every dropped
+// point must be within the tolerance of the kept polyline.
+//
+// Parameters:
+//     -n count : [in] the strokes, 720 by default (20 per gesture)
+//
+// Return Values (int):
+//      0 if succeeded, 1 if a dropped point is beyond the tolerance
+//
+/////////////////////////////////////////////////////////
+static int BenchDecimate(int argc, char** argv)
+{
+    int cStrokes = BENCH_DENSE_STROKES;
+    for (int i = 0; i < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "-n") && i + 1 < argc)
+            cStrokes = atoi(argv[++i]);
+    }
+    if (cStrokes < 1)
+        cStrokes = 1;
+
+    static const float s_rgfTolerances[] = { 0.0f, 2.0f, 5.0f, SD_DEFAULT_TOLERANCE, 20.0f, 40.0f, 80.0f };
+
+    GesturePoint* pptDense = (GesturePoint*)malloc((size_t)cStrokes * BENCH_DENSE_POINTS * sizeof(GesturePoint));
+    int* pcPoints = (int*)malloc(cStrokes * sizeof(int));
+    int* piGestures = (int*)malloc(cStrokes * 2 * sizeof(int));   // the truth, and the dense result
+    GesturePoint* pptKept = (GesturePoint*)malloc(BENCH_DENSE_POINTS * sizeof(GesturePoint));
+    if (NULL == pptDense || NULL == pcPoints || NULL == piGestures || NULL == pptKept)
+    {
+        free(pptDense);
+        free(pcPoints);
+        free(piGestures);
+        free(pptKept);
+        printf("out of memory\n");
+        return 1;
+    }
+
+    CGestureEngine engine;
+    engine.AddBuiltinTemplates();
+    CSyntheticInk synth(3838);
+    const int cShapes = CGestureEngine::GetBuiltinShapeCount();
+    long long cDensePoints = 0;
+    for (int i = 0; i < cStrokes; i++)
+    {
+        GesturePoint* ppt = pptDense + (size_t)i * BENCH_DENSE_POINTS;
+        pcPoints[i] = MakeDenseStroke(synth, i % cShapes, piGestures[2 * i], ppt);
+        cDensePoints += pcPoints[i];
+    }
+
+    printf("%d strokes, %.0f points per stroke\n", cStrokes, (double)cDensePoints / cStrokes);
+    printf("tolerance  kept  ratio  bytes/stroke  decimate ns/pt  recognize us  accuracy  changed\n");
+
+    int cErrors = 0;
+    GestureResult rgResults[GE_NUM_SSGESTURES];
+    for (int t = 0; t < (int)countof(s_rgfTolerances); t++)
+    {
+        CStrokeDecimator decimator(s_rgfTolerances[t]);
+        long long cKeptPoints = 0;
+        PERFTIME ptDecimate = 0, ptRecognize = 0;
+        int cCorrect = 0, cChanged = 0;
+        for (int i = 0; i < cStrokes; i++)
+        {
+            const GesturePoint* ppt = pptDense + (size_t)i * BENCH_DENSE_POINTS;
+            PERFTIME ptStart = PerfNow();
+            int cKept = decimator.Decimate(ppt, pcPoints[i], pptKept);
+            ptDecimate += PerfNow() - ptStart;
+            cKeptPoints += cKept;
+
+            ptStart = PerfNow();
+            int cResults = engine.Recognize(pptKept, cKept, rgResults, countof(rgResults));
+            ptRecognize += PerfNow() - ptStart;
+            int iGesture = (cResults > 0) ? rgResults[0].iGesture : -1;
+            if (0 == t)
+                piGestures[2 * i + 1] = iGesture;
+            if (iGesture == piGestures[2 * i])
+                cCorrect++;
+            if (iGesture != piGestures[2 * i + 1])
+                cChanged++;
+
+            // Every dropped point is within the tolerance of the segment
+            // between the kept points around it
+            int k = 0;
+            for (int j = 0; j < pcPoints[i] && k + 1 < cKept; j++)
+            {
+                if (ppt[j].x == pptKept[k + 1].x && ppt[j].y == pptKept[k + 1].y)
+                {
+                    k++;
+                    continue;
+                }
+                float fError = CStrokeDecimator::GetSegmentDistance(ppt[j], pptKept[k], pptKept[k + 1]);
+                if (fError > s_rgfTolerances[t] * 1.001f + 1e-3f)
+                {
+                    if (0 == cErrors)
+                        printf("stroke %d, point %d: %.2f from the kept polyline, the tolerance is %.1f\n",
+                               i, j, fError, s_rgfTolerances[t]);
+                    cErrors++;
+                }
+            }
+        }
+
+        double dKeptPerStroke = (double)cKeptPoints / cStrokes;
+        printf("%9.1f %5.0f %5.1fx %13.0f %15.2f %13.1f %8.1f%% %8d\n",
+               s_rgfTolerances[t], dKeptPerStroke, (double)cDensePoints / cKeptPoints,
+               dKeptPerStroke * sizeof(GesturePoint), (double)ptDecimate / cDensePoints,
+               ptRecognize / 1000.0 / cStrokes, 100.0 * cCorrect / cStrokes, cChanged);
+    }
+
+    free(pptDense);
+    free(pcPoints);
+    free(piGestures);
+    free(pptKept);
+
+    if (cErrors > 0)
+    {
+        printf("%d points beyond the tolerance\n", cErrors);
+        return 1;
+    }
+    return 0;
+}
+
+// The devices suite: the packet rates of the pens, the speed they're
+// drawn at, in ink units a second (15 cm/s), and the digitizer noise
+static const int gc_rgiPacketRates[] = { 60, 133, 240, 500, 1000 };
+#define BENCH_PEN_SPEED         15000.0f
+#define BENCH_DEVICE_STROKES    360
+#define BENCH_DEVICE_ROUNDS     5
+#define BENCH_DEVICE_TOLERANCE  0.10f   // the resampled points may differ by pen
+
+/////////////////////////////////////////////////////////
+//
+// MakeDeviceStroke
+//
+// Makes the packets of a synthetic stroke as a pen of a
+// packet rate would report them: walks the stroke at the
+// pen speed and takes a point, off by the digitizer's
+// noise, every packet time. The last packet is where the
+// stroke ends.
+//
+// Return Values (int):
+//      the number of the packets
+//
+/////////////////////////////////////////////////////////
+static int MakeDeviceStroke(
+        CSyntheticInk& synth,
+        const GesturePoint* pptStroke,
+        int cPoints,
+        int iPacketRate,
+        GesturePoint* ppt,
+        int cMaxPackets
+        )
+{
+    if (cPoints < 2)
+    {
+        memcpy(ppt, pptStroke, cPoints * sizeof(GesturePoint));
+        return cPoints;
+    }
+
+    float fStep = BENCH_PEN_SPEED / iPacketRate;
+    float fCarry = 0;       // the path walked since the last packet
+    int cPackets = 0;
+    ppt[cPackets++] = pptStroke[0];
+    for (int i = 0; i + 1 < cPoints && cPackets < cMaxPackets - 1; i++)
+    {
+        float dx = pptStroke[i + 1].x - pptStroke[i].x;
+        float dy = pptStroke[i + 1].y - pptStroke[i].y;
+        float fSegment = sqrtf(dx * dx + dy * dy);
+        float fAt = fStep - fCarry;
+        for (; fAt <= fSegment && cPackets < cMaxPackets - 1; fAt += fStep)
+        {
+            float t = fAt / fSegment;
+            ppt[cPackets].x = pptStroke[i].x + t * dx
+                              + synth.NextRange(-BENCH_DENSE_NOISE, BENCH_DENSE_NOISE);
+            ppt[cPackets].y = pptStroke[i].y + t * dy
+                              + synth.NextRange(-BENCH_DENSE_NOISE, BENCH_DENSE_NOISE);
+            cPackets++;
+        }
+        fCarry = fSegment - (fAt - fStep);
+    }
+    ppt[cPackets++] = pptStroke[cPoints - 1];
+    return cPackets;
+}
+
+// What the devices suite measured for a pen
+struct DeviceRun
+{
+    long long   cPackets;
+    long long   rgcFrames[2];       // drawing every packet, coalesced
+    PERFTIME    rgptRender[2];
+    long long   rgcPoints[2];       // the packets, resampled
+    long long   rgcKept[2];         // decimated
+    PERFTIME    rgptRecognize[2];   // with the resampling and the decimation
+    int         rgcCorrect[2];
+};
+
+/////////////////////////////////////////////////////////
+//
+// BenchDevices
+//
+// Draws the same synthetic strokes with pens of 60 Hz to
+// 1 kHz, at the same speed (see MakeDeviceStroke), through
+// the input stage (see PacketInput.h), and keeps the
+// best time of a few rounds of each path.
+// The render path goes through the headless application,
+// once composing every packet and once coalescing the
+// packets of a 60 Hz frame; the packets are timed as the
+// pen reports them. The recognition path is the one of the
+// application's strokes: the packets, or the resampled
+// points, are decimated and recognized.
+//
+// Parameters:
+//     -n count : [in] the strokes, 360 by default (10 per gesture)
+//
+// Return Values (int):
+//      0 if succeeded, 1 if the resampled points of a pen are
+//      more than BENCH_DEVICE_TOLERANCE off their average
+//
+/////////////////////////////////////////////////////////
+static int BenchDevices(int argc, char** argv)
+{
+    int cStrokes = BENCH_DEVICE_STROKES;
+    float fSpacing = PI_DEFAULT_SPACING;
+    for (int i = 0; i < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "-n") && i + 1 < argc)
+            cStrokes = atoi(argv[++i]);
+        else if (0 == strcmp(argv[i], "-spacing") && i + 1 < argc)
+            fSpacing = (float)atof(argv[++i]);
+    }
+    if (cStrokes < 1)
+        cStrokes = 1;
+
+    const int cRates = (int)countof(gc_rgiPacketRates);
+    GesturePoint* pptPackets = (GesturePoint*)malloc((size_t)cStrokes * BENCH_DENSE_POINTS * sizeof(GesturePoint));
+    int* pcPackets = (int*)malloc(cStrokes * sizeof(int));
+    int* piGestures = (int*)malloc(cStrokes * sizeof(int));
+    GesturePoint* pptKept = (GesturePoint*)malloc(BENCH_DENSE_POINTS * sizeof(GesturePoint));
+    DeviceRun* pRuns = (DeviceRun*)calloc(cRates, sizeof(DeviceRun));
+    CGestureEngine engine;
+    engine.AddBuiltinTemplates();
+    CHeadlessApp rawApp(engine), app(engine);
+    if (NULL == pptPackets || NULL == pcPackets || NULL == piGestures || NULL == pptKept
+        || NULL == pRuns || false == rawApp.Create() || false == app.Create())
+    {
+        free(pptPackets);
+        free(pcPackets);
+        free(piGestures);
+        free(pptKept);
+        free(pRuns);
+        printf("out of memory\n");
+        return 1;
+    }
+
+    // The raw application draws every packet at once and
+    // recognizes them all
+    rawApp.GetInput().SetFrameTime(0);
+    rawApp.GetInput().SetMinMove(0);
+    rawApp.GetInput().SetSpacing(0);
+    app.GetInput().SetSpacing(fSpacing);
+
+    CPacketInput input;
+    input.SetSpacing(fSpacing);
+    CStrokeDecimator decimator;
+    GestureResult rgResults[GE_NUM_SSGESTURES];
+    const int cShapes = CGestureEngine::GetBuiltinShapeCount();
+    for (int r = 0; r < cRates; r++)
+    {
+        DeviceRun& run = pRuns[r];
+        PERFTIME ptPacketTime = (1000000000ULL + gc_rgiPacketRates[r] - 1) / gc_rgiPacketRates[r];
+
+        // Every pen draws the same strokes
+        CSyntheticInk synth(3939), noise(4040);
+        for (int s = 0; s < cStrokes; s++)
+        {
+            GesturePoint rgpt[BENCH_MAX_POINTS];
+            int cPoints = synth.MakeStroke(s % cShapes, piGestures[s], rgpt, countof(rgpt));
+            pcPackets[s] = MakeDeviceStroke(noise, rgpt, cPoints, gc_rgiPacketRates[r],
+                                            pptPackets + (size_t)s * BENCH_DENSE_POINTS,
+                                            BENCH_DENSE_POINTS);
+            run.cPackets += pcPackets[s];
+        }
+
+        // The render path, the packets as they come; the
+        // best of a few rounds
+        for (int k = 0; k < 2; k++)
+        {
+            CHeadlessApp& a = (0 == k) ? rawApp : app;
+            for (int iRound = 0; iRound < BENCH_DEVICE_ROUNDS; iRound++)
+            {
+                int cFrames = a.GetFrameCount();
+                PERFTIME ptRender = 0;
+                for (int s = 0; s < cStrokes; s++)
+                {
+                    const GesturePoint* ppt = pptPackets + (size_t)s * BENCH_DENSE_POINTS;
+                    PERFTIME ptStart = PerfNow();
+                    a.OnPenDown();
+                    for (int i = 0; i < pcPackets[s]; i++)
+                    {
+                        a.OnPacket(ppt[i].x, ppt[i].y, (PERFTIME)i * ptPacketTime);
+                    }
+                    ptRender += PerfNow() - ptStart;
+                    a.OnPenUp();
+                }
+                run.rgcFrames[k] = a.GetFrameCount() - cFrames;
+                if (0 == iRound || ptRender < run.rgptRender[k])
+                    run.rgptRender[k] = ptRender;
+            }
+        }
+
+        // The recognition path
+        for (int k = 0; k < 2; k++)
+        {
+            for (int iRound = 0; iRound < BENCH_DEVICE_ROUNDS; iRound++)
+            {
+                run.rgcPoints[k] = run.rgcKept[k] = 0;
+                run.rgcCorrect[k] = 0;
+                PERFTIME ptStart = PerfNow();
+                for (int s = 0; s < cStrokes; s++)
+                {
+                    const GesturePoint* ppt = pptPackets + (size_t)s * BENCH_DENSE_POINTS;
+                    int cReco = pcPackets[s];
+                    if (1 == k)
+                    {
+                        input.BeginStroke();
+                        for (int i = 0; i < cReco; i++)
+                        {
+                            input.AddPacket(ppt[i].x, ppt[i].y);
+                        }
+                        input.EndStroke();
+                        ppt = input.GetPoints();
+                        cReco = input.GetPointCount();
+                    }
+                    int cKept = decimator.Decimate(ppt, cReco, pptKept);
+                    int cResults = engine.Recognize(pptKept, cKept, rgResults, countof(rgResults));
+                    run.rgcPoints[k] += cReco;
+                    run.rgcKept[k] += cKept;
+                    if (cResults > 0 && rgResults[0].iGesture == piGestures[s])
+                        run.rgcCorrect[k]++;
+                }
+                PERFTIME ptRecognize = PerfNow() - ptStart;
+                if (0 == iRound || ptRecognize < run.rgptRecognize[k])
+                    run.rgptRecognize[k] = ptRecognize;
+            }
+        }
+    }
+
+    printf("%d strokes at %.0f cm/s, frames of %.1f ms, points every %.0f ink units\n\n",
+           cStrokes, BENCH_PEN_SPEED / 1000.0f, PI_DEFAULT_FRAME_TIME / 1e6, fSpacing);
+    printf("render       packets/  frames/stroke       us/stroke\n");
+    printf("pen           stroke   every  coalesced   every  coalesced\n");
+    for (int r = 0; r < cRates; r++)
+    {
+        const DeviceRun& run = pRuns[r];
+        printf("%4d Hz %12.1f %7.1f %10.1f %7.1f %10.1f\n", gc_rgiPacketRates[r],
+               (double)run.cPackets / cStrokes,
+               (double)run.rgcFrames[0] / cStrokes, (double)run.rgcFrames[1] / cStrokes,
+               run.rgptRender[0] / 1000.0 / cStrokes, run.rgptRender[1] / 1000.0 / cStrokes);
+    }
+
+    printf("\nrecognition  points/stroke    kept/stroke       us/stroke        accuracy\n");
+    printf("pen         packets resampled packets resampled packets resampled packets resampled\n");
+    double dAverage = 0;
+    for (int r = 0; r < cRates; r++)
+    {
+        const DeviceRun& run = pRuns[r];
+        dAverage += (double)run.rgcPoints[1] / cStrokes / cRates;
+        printf("%4d Hz %11.1f %9.1f %7.1f %9.1f %7.1f %9.1f %6.1f%% %8.1f%%\n",
+               gc_rgiPacketRates[r],
+               (double)run.rgcPoints[0] / cStrokes, (double)run.rgcPoints[1] / cStrokes,
+               (double)run.rgcKept[0] / cStrokes, (double)run.rgcKept[1] / cStrokes,
+               run.rgptRecognize[0] / 1000.0 / cStrokes, run.rgptRecognize[1] / 1000.0 / cStrokes,
+               100.0 * run.rgcCorrect[0] / cStrokes, 100.0 * run.rgcCorrect[1] / cStrokes);
+    }
+
+    int iResult = 0;
+    for (int r = 0; r < cRates; r++)
+    {
+        double dPoints = (double)pRuns[r].rgcPoints[1] / cStrokes;
+        if (fabs(dPoints - dAverage) > BENCH_DEVICE_TOLERANCE * dAverage)
+        {
+            printf("the %d Hz pen's strokes resample to %.1f points, the average is %.1f\n",
+                   gc_rgiPacketRates[r], dPoints, dAverage);
+            iResult = 1;
+        }
+    }
+
+    free(pptPackets);
+    free(pcPackets);
+    free(piGestures);
+    free(pptKept);
+    free(pRuns);
+    return iResult;
+}
+
+// The predict suite: the packet rates, the lookaheads in ms, and the
+// strokes, drawn at 15 cm/s on average
+static const int gc_rgiPredictRates[] = { 60, 133, 240, 1000 };
+static const int gc_rgiLookaheads[] = { 8, 16, 25, 33 };
+#define BENCH_PREDICT_STROKES   360
+
+/////////////////////////////////////////////////////////
+//
+// GetPointAlong
+//
+// Finds the point of a polyline a length along it, the
+// lengths of its points from the first being given.
+//
+/////////////////////////////////////////////////////////
+static GesturePoint GetPointAlong(const GesturePoint* ppt, const float* pfLengths, int cPoints,
+                                  float fAt)
+{
+    if (fAt <= 0 || cPoints < 2)
+        return ppt[0];
+    if (fAt >= pfLengths[cPoints - 1])
+        return ppt[cPoints - 1];
+    int iLow = 0, iHigh = cPoints - 1;
+    while (iHigh - iLow > 1)
+    {
+        int iMid = (iLow + iHigh) / 2;
+        if (pfLengths[iMid] <= fAt)
+            iLow = iMid;
+        else
+            iHigh = iMid;
+    }
+    float fSegment = pfLengths[iHigh] - pfLengths[iLow];
+    float t = (fSegment > 0) ? (fAt - pfLengths[iLow]) / fSegment : 0;
+    GesturePoint pt;
+    pt.x = ppt[iLow].x + t * (ppt[iHigh].x - ppt[iLow].x);
+    pt.y = ppt[iLow].y + t * (ppt[iHigh].y - ppt[iLow].y);
+    return pt;
+}
+
+// The pen's progress along a stroke by the time, both from 0 to 1,
+// the minimum jerk profile of a hand's movement: it starts and stops
+// at rest and is fastest half way
+static float GetMinJerkProgress(float fTime)
+{
+    if (fTime >= 1.0f)
+        return 1.0f;
+    return fTime * fTime * fTime * (10.0f - 15.0f * fTime + 6.0f * fTime * fTime);
+}
+
+// qsort comparer for the prediction errors
+static int CompareFloats(const void* pv1, const void* pv2)
+{
+    float f1 = *(const float*)pv1;
+    float f2 = *(const float*)pv2;
+    return (f1 < f2) ? -1 : (f1 > f2) ? 1 : 0;
+}
+
+// The errors of a way to place the pen tip, in ink units
+struct PredictErrors
+{
+    float*      pfErrors;
+    int         cErrors;
+    double      dEnd;       // the sum of the errors as the pen lifts
+    int         cEnd;
+
+    void Add(float fError, bool bEnd)
+    {
+        pfErrors[cErrors++] = fError;
+        if (bEnd)
+        {
+            dEnd += fError;
+            cEnd++;
+        }
+    }
+};
+
+// Sorts the errors and gets their mean, 95th percentile and maximum
+static void GetErrorStats(PredictErrors& errors, double& dMean, double& dP95, double& dMax)
+{
+    double dSum = 0;
+    for (int i = 0; i < errors.cErrors; i++)
+    {
+        dSum += errors.pfErrors[i];
+    }
+    qsort(errors.pfErrors, errors.cErrors, sizeof(float), CompareFloats);
+    dMean = (errors.cErrors > 0) ? dSum / errors.cErrors : 0;
+    dP95 = (errors.cErrors > 0) ? errors.pfErrors[(errors.cErrors * 95) / 100] : 0;
+    dMax = (errors.cErrors > 0) ? errors.pfErrors[errors.cErrors - 1] : 0;
+}
+
+/////////////////////////////////////////////////////////
+//
+// BenchPredict
+//
+// Draws synthetic strokes with pens of 60 Hz to 1 kHz, the
+// pen moving along each with the minimum jerk profile of a
+// hand, and, at every packet, places the pen tip a lookahead
+// later three ways: at the packet, which is what the ink
+// shows without a prediction; by extrapolating the last two
+// packets; and with the stroke predictor (StrokePredictor.h).
+// Reports the errors against where the pen really is: their
+// mean, 95th percentile and maximum, the mean as the pen
+// lifts (the overshoot of a tail), the latency the predictor
+// hides and its cost per packet.
+//
+// Parameters:
+//     -n count       : [in] the strokes, 360 by default (10 per gesture)
+//     -noise units   : [in] the digitizer noise, 2 ink units by default
+//
+// Return Values (int):
+//      0 if succeeded, 1 if the predictor's mean error isn't
+//      under the ink's lag, or it overshoots the end of the
+//      strokes more than the extrapolation
+//
+/////////////////////////////////////////////////////////
+static int BenchPredict(int argc, char** argv)
+{
+    int cStrokes = BENCH_PREDICT_STROKES;
+    float fNoise = BENCH_DENSE_NOISE;
+    for (int i = 0; i < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "-n") && i + 1 < argc)
+            cStrokes = atoi(argv[++i]);
+        else if (0 == strcmp(argv[i], "-noise") && i + 1 < argc)
+            fNoise = (float)atof(argv[++i]);
+    }
+    if (cStrokes < 1)
+        cStrokes = 1;
+
+    // The strokes, their lengths along and their durations
+    GesturePoint* pptStrokes = (GesturePoint*)malloc((size_t)cStrokes * BENCH_MAX_POINTS * sizeof(GesturePoint));
+    float* pfLengths = (float*)malloc((size_t)cStrokes * BENCH_MAX_POINTS * sizeof(float));
+    int* pcPoints = (int*)malloc(cStrokes * sizeof(int));
+    float* pfDurations = (float*)malloc(cStrokes * sizeof(float));
+    if (NULL == pptStrokes || NULL == pfLengths || NULL == pcPoints || NULL == pfDurations)
+    {
+        free(pptStrokes);
+        free(pfLengths);
+        free(pcPoints);
+        free(pfDurations);
+        printf("out of memory\n");
+        return 1;
+    }
+
+    CSyntheticInk synth(4141);
+    const int cShapes = CGestureEngine::GetBuiltinShapeCount();
+    double dMaxDuration = 0;
+    for (int s = 0; s < cStrokes; s++)
+    {
+        GesturePoint* ppt = pptStrokes + (size_t)s * BENCH_MAX_POINTS;
+        float* pfLength = pfLengths + (size_t)s * BENCH_MAX_POINTS;
+        int iGesture;
+        pcPoints[s] = synth.MakeStroke(s % cShapes, iGesture, ppt, BENCH_MAX_POINTS);
+        pfLength[0] = 0;
+        for (int i = 1; i < pcPoints[s]; i++)
+        {
+            float dx = ppt[i].x - ppt[i - 1].x;
+            float dy = ppt[i].y - ppt[i - 1].y;
+            pfLength[i] = pfLength[i - 1] + sqrtf(dx * dx + dy * dy);
+        }
+        pfDurations[s] = pfLength[pcPoints[s] - 1] / BENCH_PEN_SPEED;
+        if (pfDurations[s] > dMaxDuration)
+            dMaxDuration = pfDurations[s];
+    }
+
+    // Room for the errors of every packet of the fastest pen
+    int cMaxErrors = (int)(cStrokes * (dMaxDuration * gc_rgiPredictRates[countof(gc_rgiPredictRates) - 1] + 2));
+    PredictErrors rgErrors[3];
+    bool bAllocated = true;
+    for (int k = 0; k < 3; k++)
+    {
+        rgErrors[k].pfErrors = (float*)malloc(cMaxErrors * sizeof(float));
+        bAllocated = bAllocated && NULL != rgErrors[k].pfErrors;
+    }
+    if (false == bAllocated)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            free(rgErrors[k].pfErrors);
+        }
+        free(pptStrokes);
+        free(pfLengths);
+        free(pcPoints);
+        free(pfDurations);
+        printf("out of memory\n");
+        return 1;
+    }
+
+    printf("%d strokes at %.0f cm/s on average, noise of %.1f ink units, errors in mm\n",
+           cStrokes, BENCH_PEN_SPEED / 1000.0f, fNoise);
+    printf("%7s %5s %13s %19s %19s %11s %7s %9s\n", "pen", "ahead", "lag", "extrapolated",
+           "predicted", "at the end", "hidden", "ns/packet");
+    printf("%7s %5s %6s %6s %6s %6s %6s %6s %6s %6s %5s %5s %7s\n", "", "ms", "mean", "p95",
+           "mean", "p95", "max", "mean", "p95", "max", "extr", "pred", "ms");
+
+    int iResult = 0;
+    CStrokePredictor predictor;
+    for (int r = 0; r < (int)countof(gc_rgiPredictRates); r++)
+    {
+        for (int a = 0; a < (int)countof(gc_rgiLookaheads); a++)
+        {
+            PERFTIME ptAhead = (PERFTIME)gc_rgiLookaheads[a] * 1000000;
+            float fAhead = gc_rgiLookaheads[a] / 1000.0f;
+            float fPacketTime = 1.0f / gc_rgiPredictRates[r];
+            for (int k = 0; k < 3; k++)
+            {
+                rgErrors[k].cErrors = rgErrors[k].cEnd = 0;
+                rgErrors[k].dEnd = 0;
+            }
+            PERFTIME ptPredict = 0;
+            long long cPackets = 0;
+
+            CSyntheticInk noise(4242);
+            for (int s = 0; s < cStrokes; s++)
+            {
+                const GesturePoint* ppt = pptStrokes + (size_t)s * BENCH_MAX_POINTS;
+                const float* pfLength = pfLengths + (size_t)s * BENCH_MAX_POINTS;
+                float fLength = pfLength[pcPoints[s] - 1];
+                float fDuration = pfDurations[s];
+                int cStrokePackets = (int)(fDuration / fPacketTime) + 1;
+
+                predictor.BeginStroke();
+                GesturePoint ptPrev = ppt[0];
+                for (int i = 0; i < cStrokePackets; i++)
+                {
+                    float t = (i + 1 == cStrokePackets) ? fDuration : i * fPacketTime;
+                    GesturePoint pt = GetPointAlong(ppt, pfLength, pcPoints[s],
+                                                    fLength * GetMinJerkProgress(t / fDuration));
+                    pt.x += noise.NextRange(-fNoise, fNoise);
+                    pt.y += noise.NextRange(-fNoise, fNoise);
+
+                    GesturePoint ptPredicted;
+                    PERFTIME ptStart = PerfNow();
+                    predictor.AddPacket(pt.x, pt.y, (PERFTIME)(t * 1e9));
+                    predictor.PredictAt(ptAhead, ptPredicted);
+                    ptPredict += PerfNow() - ptStart;
+                    cPackets++;
+
+                    // Where the pen is a lookahead later, if it's not up
+                    GesturePoint ptPen = GetPointAlong(ppt, pfLength, pcPoints[s],
+                                                       fLength * GetMinJerkProgress((t + fAhead) / fDuration));
+                    bool bEnd = t + fAhead >= fDuration;
+
+                    GesturePoint ptExtrapolated = pt;
+                    if (i > 0)
+                    {
+                        float fScale = fAhead / fPacketTime;
+                        ptExtrapolated.x += fScale * (pt.x - ptPrev.x);
+                        ptExtrapolated.y += fScale * (pt.y - ptPrev.y);
+                    }
+                    const GesturePoint* rgptTips[3] = { &pt, &ptExtrapolated, &ptPredicted };
+                    for (int k = 0; k < 3; k++)
+                    {
+                        float dx = rgptTips[k]->x - ptPen.x;
+                        float dy = rgptTips[k]->y - ptPen.y;
+                        rgErrors[k].Add(sqrtf(dx * dx + dy * dy), bEnd);
+                    }
+                    ptPrev = pt;
+                }
+            }
+
+            double rgdMean[3], rgdP95[3], rgdMax[3];
+            for (int k = 0; k < 3; k++)
+            {
+                GetErrorStats(rgErrors[k], rgdMean[k], rgdP95[k], rgdMax[k]);
+            }
+            double dHidden = gc_rgiLookaheads[a] * (1.0 - rgdMean[2] / rgdMean[0]);
+            printf("%4d Hz %5d %6.2f %6.2f %6.2f %6.2f %6.2f %6.2f %6.2f %6.2f %5.2f %5.2f %7.1f %9.0f\n",
+                   gc_rgiPredictRates[r], gc_rgiLookaheads[a],
+                   rgdMean[0] / 100, rgdP95[0] / 100,
+                   rgdMean[1] / 100, rgdP95[1] / 100, rgdMax[1] / 100,
+                   rgdMean[2] / 100, rgdP95[2] / 100, rgdMax[2] / 100,
+                   rgErrors[1].dEnd / 100 / rgErrors[1].cEnd, rgErrors[2].dEnd / 100 / rgErrors[2].cEnd,
+                   dHidden, (double)ptPredict / cPackets);
+
+            if (rgdMean[2] >= rgdMean[0])
+            {
+                printf("the predicted tip is farther from the pen than the ink\n");
+                iResult = 1;
+            }
+            if (rgErrors[2].dEnd * rgErrors[1].cEnd > rgErrors[1].dEnd * rgErrors[2].cEnd)
+            {
+                printf("the predicted tip overshoots the end of the strokes more than the extrapolation\n");
+                iResult = 1;
+            }
+        }
+    }
+
+    for (int k = 0; k < 3; k++)
+    {
+        free(rgErrors[k].pfErrors);
+    }
+    free(pptStrokes);
+    free(pfLengths);
+    free(pcPoints);
+    free(pfDurations);
+    return iResult;
+}
+
+/////////////////////////////////////////////////////////
+//
+// GetVarintSize
+//
+// Return Values (int):
+//      the bytes of a zigzag varint of a residual
+//
+/////////////////////////////////////////////////////////
+static int GetVarintSize(unsigned int uResidual)
+{
+    unsigned int z = (uResidual << 1) ^ (0u - (uResidual >> 31));
+    int cb = 1;
+    while (z >= 0x80)
+    {
+        z >>= 7;
+        cb++;
+    }
+    return cb;
+}
+
+// The slowest decoding of the ink archive the inkcodec suite passes,
+// in GB of packets per second on one core
+#define BENCH_INK_DECODE_GBS    1.0
+
+// zlib's compress2 and compressBound, loaded at run time so the bench
+// doesn't link zlib
+typedef int (*PFNZCOMPRESS2)(unsigned char* pbDest, unsigned long* pcbDest,
+                             const unsigned char* pbSource, unsigned long cbSource, int iLevel);
+typedef unsigned long (*PFNZCOMPRESSBOUND)(unsigned long cbSource);
+
+/////////////////////////////////////////////////////////
+//
+// GetZlibSize
+//
+// Compresses a buffer with zlib at level 9, as gzip -9, for
+// a baseline.
+//
+// Parameters:
+//     const void* pv   : [in] the bytes
+//     size_t cb        : [in] their number
+//
+// Return Values (size_t):
+//      the compressed size, 0 if zlib can't be loaded or fails
+//
+/////////////////////////////////////////////////////////
+static size_t GetZlibSize(const void* pv, size_t cb)
+{
+#ifdef _WIN32
+    HMODULE hModule = ::LoadLibraryA("zlib1.dll");
+    if (NULL == hModule)
+        return 0;
+    PFNZCOMPRESS2 pfnCompress2 = (PFNZCOMPRESS2)::GetProcAddress(hModule, "compress2");
+    PFNZCOMPRESSBOUND pfnCompressBound = (PFNZCOMPRESSBOUND)::GetProcAddress(hModule, "compressBound");
+#else
+    void* hModule = dlopen("libz.so.1", RTLD_NOW | RTLD_LOCAL);
+    if (NULL == hModule)
+        return 0;
+    PFNZCOMPRESS2 pfnCompress2 = (PFNZCOMPRESS2)dlsym(hModule, "compress2");
+    PFNZCOMPRESSBOUND pfnCompressBound = (PFNZCOMPRESSBOUND)dlsym(hModule, "compressBound");
+#endif
+
+    size_t cbZlib = 0;
+    if (NULL != pfnCompress2 && NULL != pfnCompressBound && cb == (unsigned long)cb)
+    {
+        unsigned long cbOut = pfnCompressBound((unsigned long)cb);
+        unsigned char* pbOut = (unsigned char*)malloc(cbOut);
+        if (NULL != pbOut && 0 == pfnCompress2(pbOut, &cbOut, (const unsigned char*)pv, (unsigned long)cb, 9))
+            cbZlib = cbOut;
+        free(pbOut);
+    }
+
+#ifdef _WIN32
+    ::FreeLibrary(hModule);
+#else
+    dlclose(hModule);
+#endif
+    return cbZlib;
+}
+
+/////////////////////////////////////////////////////////
+//
+// BenchInkCodec
+//
+// Draws dense synthetic strokes with the packets of a 1 kHz
+// pen: integer coordinates, a millisecond timer that now and
+// then skips a tick, and a pressure that rises, wanders and
+// falls. Codes them into ink archive blocks and reports the
+// size against the raw packets, against the same second
+// order residuals as zigzag varints and against the raw
+// packets through zlib at level 9, the encoding speed, the
+// decoding speed in bytes of packets per second, and the
+// time to read a random stroke, its block decoded up to the
+// stroke's end. Every stroke must decode to its packets
+// exactly, every block damaged by a flipped byte must be
+// refused, the archive must be smaller than zlib's output
+// and the decoding must reach BENCH_INK_DECODE_GBS.
+//
+// Parameters:
+//     -n count : [in] the strokes, 2880 by default
+//
+// Return Values (int):
+//      0 if succeeded, 1 if a stroke doesn't decode exactly, a
+//      damaged block decodes, the archive isn't smaller than
+//      zlib's output or the decoding is slower
+//
+/////////////////////////////////////////////////////////
+static int BenchInkCodec(int argc, char** argv)
+{
+    int cStrokes = 4 * BENCH_DENSE_STROKES;
+    for (int i = 0; i < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "-n") && i + 1 < argc)
+            cStrokes = atoi(argv[++i]);
+    }
+    if (cStrokes < 1)
+        cStrokes = 1;
+
+    InkPacket* pPackets = (InkPacket*)malloc((size_t)cStrokes * BENCH_DENSE_POINTS * sizeof(InkPacket));
+    InkPacket* pDecoded = (InkPacket*)malloc((size_t)cStrokes * BENCH_DENSE_POINTS * sizeof(InkPacket));
+    int* pcStrokePackets = (int*)malloc(cStrokes * sizeof(int));
+    int* pcDecodedPackets = (int*)malloc(cStrokes * sizeof(int));
+    GesturePoint* ppt = (GesturePoint*)malloc(BENCH_DENSE_POINTS * sizeof(GesturePoint));
+    unsigned char* pbArchive = NULL;
+    unsigned int* pcbBlocks = NULL;
+    if (NULL == pPackets || NULL == pDecoded || NULL == pcStrokePackets
+        || NULL == pcDecodedPackets || NULL == ppt)
+    {
+        free(pPackets);
+        free(pDecoded);
+        free(pcStrokePackets);
+        free(pcDecodedPackets);
+        free(ppt);
+        printf("out of memory\n");
+        return 1;
+    }
+
+    // The strokes, each starting 200 to 700 ms after the last one ended
+    CSyntheticInk synth(3939);
+    const int cShapes = CGestureEngine::GetBuiltinShapeCount();
+    unsigned int uTime = 0;
+    size_t cPackets = 0;
+    for (int s = 0; s < cStrokes; s++)
+    {
+        int iGesture;
+        int cPoints = MakeDenseStroke(synth, s % cShapes, iGesture, ppt);
+        uTime += 200 + (unsigned int)synth.NextRange(0, 500);
+        int iPressure = 0;
+        for (int i = 0; i < cPoints; i++)
+        {
+            InkPacket& packet = pPackets[cPackets + i];
+            packet.x = (int)floorf(ppt[i].x + 0.5f);
+            packet.y = (int)floorf(ppt[i].y + 0.5f);
+            uTime += (synth.NextRange(0, 1) < 0.02f) ? 2 : 1;
+            packet.uTime = uTime;
+            if (i < 16)
+                iPressure += 40;
+            else if (i >= cPoints - 16)
+                iPressure -= 40;
+            else
+                iPressure += (int)floorf(synth.NextRange(-4, 5));
+            iPressure = (iPressure < 0) ? 0 : (iPressure > 1023) ? 1023 : iPressure;
+            packet.iPressure = iPressure;
+        }
+        pcStrokePackets[s] = cPoints;
+        cPackets += cPoints;
+    }
+
+    // The residuals as zigzag varints, the step before the range coder
+    size_t cbVarints = 0;
+    {
+        size_t iPacket = 0;
+        for (int s = 0; s < cStrokes; s++)
+        {
+            for (int i = 0; i < pcStrokePackets[s]; i++, iPacket++)
+            {
+                const InkPacket& p0 = pPackets[iPacket];
+                const InkPacket& p1 = pPackets[(iPacket > 0) ? iPacket - 1 : 0];
+                const InkPacket& p2 = pPackets[(iPacket > 1) ? iPacket - 2 : 0];
+                unsigned int rgu[4][3] = {
+                    { (unsigned int)p0.x, (unsigned int)p1.x, (unsigned int)p2.x },
+                    { (unsigned int)p0.y, (unsigned int)p1.y, (unsigned int)p2.y },
+                    { p0.uTime, p1.uTime, p2.uTime },
+                    { (unsigned int)p0.iPressure, (unsigned int)p1.iPressure, (unsigned int)p2.iPressure } };
+                for (int c = 0; c < 4; c++)
+                {
+                    unsigned int uPredicted = (i >= 2) ? 2 * rgu[c][1] - rgu[c][2]
+                                            : (iPacket > 0) ? rgu[c][1] : 0;
+                    cbVarints += GetVarintSize(rgu[c][0] - uPredicted);
+                }
+            }
+        }
+    }
+
+    // Code the blocks as the archive writer does: whole strokes, closed
+    // past IC_BLOCK_PACKETS
+    CInkCodec codec;
+    const unsigned int uChannels = IC_HAS_TIME | IC_HAS_PRESSURE;
+    int cMaxBlocks = (int)(cPackets / IC_BLOCK_PACKETS) + cStrokes + 1;
+    int* piFirstStrokes = (int*)malloc((cMaxBlocks + 1) * sizeof(int));
+    pcbBlocks = (unsigned int*)malloc((cMaxBlocks + 1) * sizeof(unsigned int));
+    pbArchive = (unsigned char*)malloc(cPackets * sizeof(InkPacket) + 4096);
+    int cBlocks = 0;
+    size_t cbArchive = 0;
+    PERFTIME ptEncode = 0;
+    bool bOk = (NULL != piFirstStrokes && NULL != pcbBlocks && NULL != pbArchive);
+    for (int s = 0; bOk && s < cStrokes; )
+    {
+        int cBlockStrokes = 0;
+        int cBlockPackets = 0;
+        while (s + cBlockStrokes < cStrokes
+               && (0 == cBlockPackets || cBlockPackets + pcStrokePackets[s + cBlockStrokes] <= IC_BLOCK_PACKETS))
+        {
+            cBlockPackets += pcStrokePackets[s + cBlockStrokes];
+            cBlockStrokes++;
+        }
+
+        size_t iFirstPacket = 0;
+        for (int k = 0; k < s; k++)
+        {
+            iFirstPacket += pcStrokePackets[k];
+        }
+        unsigned int cbBlock;
+        PERFTIME ptStart = PerfNow();
+        const unsigned char* pbBlock = codec.EncodeBlock(pPackets + iFirstPacket, pcStrokePackets + s,
+                                                         cBlockStrokes, uChannels, &cbBlock);
+        ptEncode += PerfNow() - ptStart;
+        if (NULL == pbBlock)
+        {
+            bOk = false;
+            break;
+        }
+        memcpy(pbArchive + cbArchive, pbBlock, cbBlock);
+        piFirstStrokes[cBlocks] = s;
+        pcbBlocks[cBlocks++] = cbBlock;
+        cbArchive += cbBlock;
+        s += cBlockStrokes;
+    }
+
+    // Decode the archive a few times, the best run counts
+    PERFTIME ptDecode = 0;
+    for (int iRun = 0; bOk && iRun < 10; iRun++)
+    {
+        size_t iOffset = 0;
+        size_t iPacket = 0;
+        PERFTIME ptStart = PerfNow();
+        for (int b = 0; b < cBlocks; b++)
+        {
+            if (false == codec.DecodeBlock(pbArchive + iOffset, pcbBlocks[b], pDecoded + iPacket,
+                                           (unsigned int)(cPackets - iPacket),
+                                           pcDecodedPackets + piFirstStrokes[b],
+                                           (unsigned int)(cStrokes - piFirstStrokes[b])))
+            {
+                bOk = false;
+                break;
+            }
+            iOffset += pcbBlocks[b];
+            int iLastStroke = (b + 1 < cBlocks) ? piFirstStrokes[b + 1] : cStrokes;
+            for (int k = piFirstStrokes[b]; k < iLastStroke; k++)
+            {
+                iPacket += pcDecodedPackets[k];
+            }
+        }
+        PERFTIME ptRun = PerfNow() - ptStart;
+        if (0 == iRun || ptRun < ptDecode)
+            ptDecode = ptRun;
+    }
+
+    int cMismatches = 0;
+    if (bOk)
+    {
+        if (0 != memcmp(pcStrokePackets, pcDecodedPackets, cStrokes * sizeof(int)))
+            cMismatches++;
+        for (size_t i = 0; i < cPackets; i++)
+        {
+            if (0 != memcmp(&pPackets[i], &pDecoded[i], sizeof(InkPacket)))
+                cMismatches++;
+        }
+    }
+
+    // Read random strokes, each block decoded only up to the stroke
+    PERFTIME ptRandom = 0;
+    const int cRandom = 200;
+    for (int k = 0; bOk && k < cRandom; k++)
+    {
+        int iStroke = (int)synth.NextRange(0, (float)cStrokes) % cStrokes;
+        PERFTIME ptStart = PerfNow();
+        int b = cBlocks - 1;
+        while (piFirstStrokes[b] > iStroke)
+        {
+            b--;
+        }
+        size_t iOffset = 0;
+        for (int j = 0; j < b; j++)
+        {
+            iOffset += pcbBlocks[j];
+        }
+        bOk = codec.DecodeBlock(pbArchive + iOffset, pcbBlocks[b], pDecoded, (unsigned int)cPackets,
+                                pcDecodedPackets, (unsigned int)cStrokes,
+                                (unsigned int)(iStroke - piFirstStrokes[b] + 1));
+        ptRandom += PerfNow() - ptStart;
+
+        size_t iFirstPacket = 0;
+        for (int j = 0; j < iStroke; j++)
+        {
+            iFirstPacket += pcStrokePackets[j];
+        }
+        size_t iDecoded = 0;
+        for (int j = piFirstStrokes[b]; j < iStroke; j++)
+        {
+            iDecoded += pcDecodedPackets[j - piFirstStrokes[b]];
+        }
+        if (bOk && 0 != memcmp(pPackets + iFirstPacket, pDecoded + iDecoded,
+                               pcStrokePackets[iStroke] * sizeof(InkPacket)))
+            cMismatches++;
+    }
+
+    // Damage the archive: a flipped byte anywhere in a block, its header
+    // included, must be caught by the block's CRC
+    int cDetected = 0;
+    const int cDamaged = 200;
+    for (int k = 0; bOk && k < cDamaged; k++)
+    {
+        size_t iByte = (size_t)synth.NextRange(0, (float)pcbBlocks[0]) % pcbBlocks[0];
+        pbArchive[iByte] ^= 0x10;
+        if (false == codec.DecodeBlock(pbArchive, pcbBlocks[0], pDecoded, (unsigned int)cPackets,
+                                       pcDecodedPackets, (unsigned int)cStrokes))
+            cDetected++;
+        pbArchive[iByte] ^= 0x10;
+    }
+
+    size_t cbRaw = cPackets * sizeof(InkPacket);
+    size_t cbZlib = bOk ? GetZlibSize(pPackets, cbRaw) : 0;
+    double dDecodeGBs = (bOk && ptDecode > 0) ? cbRaw / (ptDecode / 1e9) / 1e9 : 0;
+    if (bOk)
+    {
+        printf("%d strokes, %.0f packets per stroke, %d blocks\n", cStrokes,
+               (double)cPackets / cStrokes, cBlocks);
+        printf("                      bytes  bytes/packet  ratio\n");
+        printf("raw packets     %12llu %13.2f %5.1fx\n", (unsigned long long)cbRaw,
+               (double)cbRaw / cPackets, 1.0);
+        printf("delta varints   %12llu %13.2f %5.1fx\n", (unsigned long long)cbVarints,
+               (double)cbVarints / cPackets, (double)cbRaw / cbVarints);
+        if (cbZlib > 0)
+            printf("zlib -9         %12llu %13.2f %5.1fx\n", (unsigned long long)cbZlib,
+                   (double)cbZlib / cPackets, (double)cbRaw / cbZlib);
+        else
+            printf("zlib -9         (zlib can't be loaded, no baseline)\n");
+        printf("ink archive     %12llu %13.2f %5.1fx\n", (unsigned long long)cbArchive,
+               (double)cbArchive / cPackets, (double)cbRaw / cbArchive);
+        printf("encode: %.1f MB/s of packets, %.1f ns/packet\n",
+               cbRaw / (ptEncode / 1e9) / 1e6, (double)ptEncode / cPackets);
+        printf("decode: %.2f GB/s of packets, %.2f ns/packet (at least %.2f GB/s)\n",
+               dDecodeGBs, (double)ptDecode / cPackets, BENCH_INK_DECODE_GBS);
+        printf("one stroke, its block decoded up to it: %.1f us\n", ptRandom / 1000.0 / cRandom);
+        printf("damaged blocks caught: %d of %d\n", cDetected, cDamaged);
+    }
+    else
+    {
+        printf("coding failed\n");
+    }
+
+    free(pPackets);
+    free(pDecoded);
+    free(pcStrokePackets);
+    free(pcDecodedPackets);
+    free(ppt);
+    free(piFirstStrokes);
+    free(pcbBlocks);
+    free(pbArchive);
+
+    bool bLarger = (cbZlib > 0 && cbArchive >= cbZlib);
+    bool bSlow = (dDecodeGBs < BENCH_INK_DECODE_GBS);
+    if (false == bOk || cMismatches > 0 || cDetected < cDamaged || bLarger || bSlow)
+    {
+        if (cMismatches > 0)
+            printf("%d packets differ after decoding\n", cMismatches);
+        if (bOk && cDetected < cDamaged)
+            printf("%d damaged blocks decoded\n", cDamaged - cDetected);
+        if (bOk && bLarger)
+            printf("the archive isn't smaller than zlib -9\n");
+        if (bOk && bSlow)
+            printf("decoding below %.2f GB/s\n", BENCH_INK_DECODE_GBS);
+        return 1;
+    }
+    return 0;
+}
+
+/////////////////////////////////////////////////////////
+//
+// BenchHistory
+//
+// Measures the undo history of the ink (see InkHistory.h).
+// First a large canvas: count strokes appended one edit at
+// a time, each a new version, with the cost of an append, a
+// snapshot, a lookup and of undoing and redoing every edit,
+// and the memory of the versions against copying the ink
+// (its stroke pointers) per edit. Then a session of count
+// random edits, the way the application makes them: strokes,
+// clears (a gesture clears the ink), undos and redos, with
+// every version checked against a plain model.
+//
+// Parameters:
+//     -n count : [in] the edits, 20000 by default
+//
+// Return Values (int):
+//      0 if succeeded, 1 if a version differs from the model or
+//      the nodes aren't all freed with the history
+//
+/////////////////////////////////////////////////////////
+static int BenchHistory(int argc, char** argv)
+{
+    int cEdits = 20000;
+    for (int i = 0; i < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "-n") && i + 1 < argc)
+            cEdits = atoi(argv[++i]);
+    }
+    if (cEdits < 1)
+        cEdits = 1;
+
+    // A pool of strokes, shared by the edits
+    const int cPool = 64;
+    const HistoryStroke* rgpPool[64];
+    CSyntheticInk synth(4040);
+    GesturePoint rgpt[BENCH_MAX_POINTS];
+    int rgiInk[2 * BENCH_MAX_POINTS];
+    for (int i = 0; i < cPool; i++)
+    {
+        int iGesture;
+        int cPoints = synth.MakeStroke(i % CGestureEngine::GetBuiltinShapeCount(), iGesture,
+                                       rgpt, countof(rgpt));
+        for (int j = 0; j < cPoints; j++)
+        {
+            rgiInk[2 * j] = (int)floorf(rgpt[j].x + 0.5f);
+            rgiInk[2 * j + 1] = (int)floorf(rgpt[j].y + 0.5f);
+        }
+        rgpPool[i] = HistoryStroke::Create(rgiInk, cPoints, rgpt, cPoints);
+        if (NULL == rgpPool[i])
+        {
+            printf("out of memory\n");
+            return 1;
+        }
+    }
+
+    // The model of the session: the strokes of every version, as pool
+    // indexes, and where the versions start in that array
+    int* piModel = (int*)malloc((size_t)cEdits * 64 * sizeof(int));
+    int* piVersionStart = (int*)malloc((cEdits + 1) * sizeof(int));
+    int* pcVersionStrokes = (int*)malloc((cEdits + 1) * sizeof(int));
+    if (NULL == piModel || NULL == piVersionStart || NULL == pcVersionStrokes)
+    {
+        free(piModel);
+        free(piVersionStart);
+        free(pcVersionStrokes);
+        for (int i = 0; i < cPool; i++)
+        {
+            HistoryStroke::Release(rgpPool[i]);
+        }
+        printf("out of memory\n");
+        return 1;
+    }
+
+    const long cNodesBefore = CStrokeVector::GetLiveNodeCount();
+    bool bOk = true;
+    int cWrong = 0;
+    {
+        // The large canvas
+        CInkHistory history;
+        PERFTIME ptStart = PerfNow();
+        for (int i = 0; bOk && i < cEdits; i++)
+        {
+            bOk = history.Append(rgpPool[i % cPool]);
+        }
+        PERFTIME ptAppend = PerfNow() - ptStart;
+        long cNodes = CStrokeVector::GetLiveNodeCount() - cNodesBefore;
+
+        const int cSnapshots = 1000000;
+        CStrokeVector snapshot;
+        ptStart = PerfNow();
+        for (int i = 0; i < cSnapshots; i++)
+        {
+            snapshot = history.GetCurrent();
+        }
+        PERFTIME ptSnapshot = PerfNow() - ptStart;
+
+        ptStart = PerfNow();
+        for (int i = 0; i < cEdits; i++)
+        {
+            if (snapshot.GetStroke(i) != rgpPool[i % cPool])
+                cWrong++;
+        }
+        PERFTIME ptLookup = PerfNow() - ptStart;
+
+        ptStart = PerfNow();
+        for (int i = cEdits; i > 0; i--)
+        {
+            if (history.GetCurrent().GetStrokeCount() != i || false == history.Undo())
+                cWrong++;
+        }
+        for (int i = 0; i < cEdits; i++)
+        {
+            if (history.GetCurrent().GetStrokeCount() != i || false == history.Redo())
+                cWrong++;
+        }
+        PERFTIME ptUndoRedo = PerfNow() - ptStart;
+        if (false == history.GetCurrent().IsSameAs(snapshot))
+            cWrong++;
+
+        // Copying the ink per edit copies 1 + 2 + ... + count pointers
+        double dbNodes = (double)cNodes * CStrokeVector::GetNodeSize();
+        double dbCopies = 0.5 * cEdits * (cEdits + 1.0) * sizeof(void*);
+        printf("%d strokes appended, one version each\n", cEdits);
+        printf("append %.0f ns, snapshot %.1f ns, lookup %.1f ns, undo + redo %.1f ns\n",
+               (double)ptAppend / cEdits, (double)ptSnapshot / cSnapshots,
+               (double)ptLookup / cEdits, (double)ptUndoRedo / (2.0 * cEdits));
+        printf("versions: %ld nodes, %.1f MB, %.0f bytes per version; copies of the ink: %.1f MB (%.0fx)\n",
+               cNodes, dbNodes / 1e6, dbNodes / cEdits, dbCopies / 1e6, dbCopies / dbNodes);
+    }
+
+    if (bOk)
+    {
+        // The session; the model's version v has pcVersionStrokes[v]
+        // strokes from piVersionStart[v]
+        CInkHistory history;
+        int cVersions = 1, iCurrent = 0, iModelEnd = 0;
+        piVersionStart[0] = 0;
+        pcVersionStrokes[0] = 0;
+        int cStrokes = 0, cClears = 0, cUndos = 0, cRedos = 0;
+        for (int e = 0; bOk && e < cEdits; e++)
+        {
+            float f = synth.NextFloat();
+            int cCurrent = pcVersionStrokes[iCurrent];
+            if (f < 0.15f)
+            {
+                if (history.Undo() != (iCurrent > 0))
+                    cWrong++;
+                if (iCurrent > 0)
+                    iCurrent--;
+                cUndos++;
+            }
+            else if (f < 0.25f)
+            {
+                if (history.Redo() != (iCurrent + 1 < cVersions))
+                    cWrong++;
+                if (iCurrent + 1 < cVersions)
+                    iCurrent++;
+                cRedos++;
+            }
+            else if (f < 0.30f || cCurrent == 63)
+            {
+                bOk = history.Clear();
+                if (cCurrent > 0)
+                {
+                    cVersions = ++iCurrent + 1;
+                    piVersionStart[iCurrent] = iModelEnd;
+                    pcVersionStrokes[iCurrent] = 0;
+                }
+                cClears++;
+            }
+            else
+            {
+                int iStroke = (int)(synth.NextUInt() % cPool);
+                bOk = history.Append(rgpPool[iStroke]);
+                int iStart = piVersionStart[iCurrent];
+                cVersions = ++iCurrent + 1;
+                piVersionStart[iCurrent] = iModelEnd;
+                pcVersionStrokes[iCurrent] = cCurrent + 1;
+                memmove(piModel + iModelEnd, piModel + iStart, cCurrent * sizeof(int));
+                piModel[iModelEnd + cCurrent] = iStroke;
+                iModelEnd += cCurrent + 1;
+                cStrokes++;
+            }
+
+            // The current version against the model
+            const CStrokeVector& current = history.GetCurrent();
+            if (current.GetStrokeCount() != pcVersionStrokes[iCurrent]
+                || history.GetVersionCount() != cVersions)
+            {
+                cWrong++;
+                continue;
+            }
+            for (int i = 0; i < current.GetStrokeCount(); i++)
+            {
+                if (current.GetStroke(i) != rgpPool[piModel[piVersionStart[iCurrent] + i]])
+                    cWrong++;
+            }
+        }
+        printf("session of %d edits: %d strokes, %d clears, %d undos, %d redos, %d versions\n",
+               cEdits, cStrokes, cClears, cUndos, cRedos, cVersions);
+    }
+
+    for (int i = 0; i < cPool; i++)
+    {
+        HistoryStroke::Release(rgpPool[i]);
+    }
+    free(piModel);
+    free(piVersionStart);
+    free(pcVersionStrokes);
+
+    long cLeaked = CStrokeVector::GetLiveNodeCount() - cNodesBefore;
+    if (false == bOk)
+        printf("out of memory\n");
+    if (cWrong > 0)
+        printf("%d versions differ from the model\n", cWrong);
+    if (0 != cLeaked)
+        printf("%ld nodes leaked\n", cLeaked);
+    return (bOk && 0 == cWrong && 0 == cLeaked) ? 0 : 1;
+}
+
+/////////////////////////////////////////////////////////
+//
+// DrawCanvasView
+//
+// Draws a view of the canvas the slow way, every stroke's
+// copy for the level straight into the frame, for the check
+// of the tiles.
+//
+/////////////////////////////////////////////////////////
+static void DrawCanvasView(const CTiledCanvas& canvas, const CanvasView& view, CSoftRaster& frame)
+{
+    RasterRect rc = { 0, 0, frame.GetWidth(), frame.GetHeight() };
+    frame.FillRect(rc, TC_BACKGROUND);
+    for (int s = 0; s < canvas.GetStrokeCount(); s++)
+    {
+        int cPoints;
+        const int* piPoints = canvas.GetStrokePoints(s, view.iLevel, cPoints);
+        if (NULL == piPoints)
+            continue;
+        int x0 = CTiledCanvas::ToPixel(piPoints[0], view.iLevel) - view.xPixel;
+        int y0 = CTiledCanvas::ToPixel(piPoints[1], view.iLevel) - view.yPixel;
+        if (1 == cPoints)
+            frame.DrawLine(x0, y0, x0, y0, TC_INK);
+        for (int i = 1; i < cPoints; i++)
+        {
+            int x1 = CTiledCanvas::ToPixel(piPoints[2 * i], view.iLevel) - view.xPixel;
+            int y1 = CTiledCanvas::ToPixel(piPoints[2 * i + 1], view.iLevel) - view.yPixel;
+            frame.DrawLine(x0, y0, x1, y1, TC_INK);
+            x0 = x1;
+            y0 = y1;
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CheckCanvasView
+//
+// Renders a view until it's complete and compares it with
+// the slow drawing.
+//
+// Return Values (int):
+//      the number of the pixels that differ
+//
+/////////////////////////////////////////////////////////
+static int CheckCanvasView(CTiledCanvas& canvas, const CanvasView& view,
+                           CSoftRaster& frame, CSoftRaster& reference)
+{
+    while (canvas.Render(view, frame, (PERFTIME)1000000000) > 0)
+    {
+    }
+    DrawCanvasView(canvas, view, reference);
+
+    int cDiffer = 0;
+    for (int y = 0; y < frame.GetHeight(); y++)
+    {
+        for (int x = 0; x < frame.GetWidth(); x++)
+        {
+            if (frame.GetPixel(x, y) != reference.GetPixel(x, y))
+                cDiffer++;
+        }
+    }
+    return cDiffer;
+}
+
+// qsort comparer for the frame times
+static int ComparePerfTimes(const void* pv1, const void* pv2)
+{
+    PERFTIME pt1 = *(const PERFTIME*)pv1;
+    PERFTIME pt2 = *(const PERFTIME*)pv2;
+    return (pt1 < pt2) ? -1 : (pt1 > pt2) ? 1 : 0;
+}
+
+/////////////////////////////////////////////////////////
+//
+// BenchCanvas
+//
+// Fills a tiled canvas with strokes spread over a large
+// surface, then pans and zooms a 1920x1080 view over it
+// with a budget per frame and reports the frame times.
+// Checks the complete frames pixel by pixel against the
+// slow drawing, and that removing a stroke draws again
+// only the tiles under it.
+//
+/////////////////////////////////////////////////////////
+static int BenchCanvas(int argc, char** argv)
+{
+    int cStrokes = 100000;
+    for (int i = 0; i < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "-n") && i + 1 < argc)
+            cStrokes = atoi(argv[++i]);
+    }
+    if (cStrokes < 1)
+        cStrokes = 1;
+
+    const int cxFrame = 1920, cyFrame = 1080;
+    const int cFrames = 720;
+    const PERFTIME ptBudget = 8000000;      // half a 60 Hz frame
+    const PERFTIME ptFrame = 16666667;
+
+    CTiledCanvas canvas;
+    CSoftRaster frame, reference;
+    PERFTIME* pptFrames = (PERFTIME*)malloc(cFrames * sizeof(PERFTIME));
+    if (NULL == pptFrames || false == frame.Create(cxFrame, cyFrame)
+        || false == reference.Create(cxFrame, cyFrame))
+    {
+        free(pptFrames);
+        printf("out of memory\n");
+        return 1;
+    }
+
+    // The strokes: the shapes of the gestures, 100 to 1000 pixels of
+    // level 0 in size, over a square of about 1000 strokes a side
+    CSyntheticInk synth(4141);
+    GesturePoint rgpt[BENCH_MAX_POINTS];
+    int rgiInk[2 * BENCH_MAX_POINTS];
+    const int cSide = (int)sqrt((double)cStrokes) + 1;
+    const float fSurface = cSide * 1600.0f;     // ink units
+    long long cPoints = 0;
+    PERFTIME ptAdd = 0;
+    for (int s = 0; s < cStrokes; s++)
+    {
+        int iGesture;
+        int cStrokePoints = synth.MakeStroke(s % CGestureEngine::GetBuiltinShapeCount(), iGesture,
+                                             rgpt, countof(rgpt));
+        PlaceStroke(rgpt, cStrokePoints, synth.NextRange(0, fSurface), synth.NextRange(0, fSurface),
+                    synth.NextRange(400, 4000));
+        for (int i = 0; i < cStrokePoints; i++)
+        {
+            rgiInk[2 * i] = (int)floorf(rgpt[i].x + 0.5f);
+            rgiInk[2 * i + 1] = (int)floorf(rgpt[i].y + 0.5f);
+        }
+        PERFTIME ptStart = PerfNow();
+        int iStroke = canvas.AddStroke(rgiInk, cStrokePoints);
+        ptAdd += PerfNow() - ptStart;
+        if (iStroke < 0)
+        {
+            free(pptFrames);
+            printf("out of memory\n");
+            return 1;
+        }
+        cPoints += cStrokePoints;
+    }
+
+    long long rgcLevelPoints[TC_NUM_LEVELS] = { 0 };
+    for (int s = 0; s < cStrokes; s++)
+    {
+        for (int iLevel = 0; iLevel < TC_NUM_LEVELS; iLevel++)
+        {
+            int cLevelPoints;
+            canvas.GetStrokePoints(s, iLevel, cLevelPoints);
+            rgcLevelPoints[iLevel] += cLevelPoints;
+        }
+    }
+    printf("%d strokes, %lld points, %.1f us per stroke added, %d tiles\n",
+           cStrokes, cPoints, ptAdd / 1e3 / cStrokes, canvas.GetTileCount());
+    printf("points per stroke by level:");
+    for (int iLevel = 0; iLevel < TC_NUM_LEVELS; iLevel++)
+    {
+        printf(" %.1f", (double)rgcLevelPoints[iLevel] / cStrokes);
+    }
+    printf("\n");
+
+    // The session: a pan across the middle of the surface at level 0,
+    // then a zoom out to the top level and back in, a level every 20
+    // frames, panning on the way
+    int cLate = 0, cIncomplete = 0;
+    RasterRect rcFrame = { 0, 0, cxFrame, cyFrame };
+    frame.FillRect(rcFrame, TC_BACKGROUND);    // pages the frame in
+    long long cRasterizedBefore = canvas.GetRasterizedCount();
+    for (int f = 0; f < cFrames; f++)
+    {
+        CanvasView view;
+        int xCenter, yCenter;
+        if (f < 240)
+        {
+            view.iLevel = 0;
+            xCenter = (int)(fSurface / 2) + (f - 120) * 160;
+            yCenter = (int)(fSurface / 2) + (f - 120) * 90;
+        }
+        else
+        {
+            int iStep = (f - 240) / 20;
+            view.iLevel = (iStep < TC_NUM_LEVELS) ? iStep : 2 * TC_NUM_LEVELS - 1 - iStep;
+            if (view.iLevel < 0)
+                view.iLevel = 0;
+            xCenter = (int)(fSurface / 2) + (f - 240) * 16;
+            yCenter = (int)(fSurface / 2);
+        }
+        view.xPixel = CTiledCanvas::ToPixel(xCenter, view.iLevel) - cxFrame / 2;
+        view.yPixel = CTiledCanvas::ToPixel(yCenter, view.iLevel) - cyFrame / 2;
+
+        PERFTIME ptStart = PerfNow();
+        int cLeft = canvas.Render(view, frame, ptBudget);
+        pptFrames[f] = PerfNow() - ptStart;
+        if (pptFrames[f] > ptFrame)
+            cLate++;
+        if (cLeft > 0)
+            cIncomplete++;
+    }
+    long long cRasterized = canvas.GetRasterizedCount() - cRasterizedBefore;
+    qsort(pptFrames, cFrames, sizeof(PERFTIME), ComparePerfTimes);
+    printf("%d frames of %dx%d, %.0f ms budget: p50 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+           cFrames, cxFrame, cyFrame, ptBudget / 1e6, pptFrames[cFrames / 2] / 1e6,
+           pptFrames[cFrames * 99 / 100] / 1e6, pptFrames[cFrames - 1] / 1e6);
+    printf("%d frames over 16.7 ms, %d incomplete, %lld tiles drawn, %d cached\n",
+           cLate, cIncomplete, cRasterized, canvas.GetCachedTileCount());
+
+    // The complete frames against the slow drawing, at a few levels
+    int cDiffer = 0;
+    const int rgiCheckLevels[] = { 0, 2, 5, TC_NUM_LEVELS - 1 };
+    for (int i = 0; i < (int)countof(rgiCheckLevels); i++)
+    {
+        CanvasView view;
+        view.iLevel = rgiCheckLevels[i];
+        view.xPixel = CTiledCanvas::ToPixel((int)(fSurface / 3), view.iLevel) - cxFrame / 2;
+        view.yPixel = CTiledCanvas::ToPixel((int)(fSurface / 3), view.iLevel) - cyFrame / 2;
+        cDiffer += CheckCanvasView(canvas, view, frame, reference);
+    }
+
+    // Removing a stroke draws again only the tiles of the view under
+    // its copy for the level, at most the tiles of its bounding box;
+    // a tile left with no strokes is blank and isn't drawn
+    int cRemoved = 0, cOverdrawn = 0;
+    long long cRedrawn = 0;
+    for (int s = 0; s < cStrokes && cRemoved < 100; s += cStrokes / 100 + 1)
+    {
+        int cStrokePoints;
+        const int* piPoints = canvas.GetStrokePoints(s, 0, cStrokePoints);
+        int xMin = piPoints[0], xMax = piPoints[0], yMin = piPoints[1], yMax = piPoints[1];
+        for (int i = 1; i < cStrokePoints; i++)
+        {
+            if (piPoints[2 * i] < xMin) xMin = piPoints[2 * i];
+            if (piPoints[2 * i] > xMax) xMax = piPoints[2 * i];
+            if (piPoints[2 * i + 1] < yMin) yMin = piPoints[2 * i + 1];
+            if (piPoints[2 * i + 1] > yMax) yMax = piPoints[2 * i + 1];
+        }
+        int cBoxTiles = 1;
+        for (int i = 0; i < 2; i++)
+        {
+            int iMin = (0 == i) ? xMin : yMin;
+            int iMax = (0 == i) ? xMax : yMax;
+            cBoxTiles *= (int)floor(CTiledCanvas::ToPixel(iMax, 0) / (double)TC_TILE_SIZE)
+                         - (int)floor(CTiledCanvas::ToPixel(iMin, 0) / (double)TC_TILE_SIZE) + 1;
+        }
+
+        CanvasView view;
+        view.iLevel = 0;
+        view.xPixel = CTiledCanvas::ToPixel((xMin + xMax) / 2, 0) - cxFrame / 2;
+        view.yPixel = CTiledCanvas::ToPixel((yMin + yMax) / 2, 0) - cyFrame / 2;
+        while (canvas.Render(view, frame, (PERFTIME)1000000000) > 0)
+        {
+        }
+
+        long long cBefore = canvas.GetRasterizedCount();
+        canvas.RemoveStroke(s);
+        while (canvas.Render(view, frame, (PERFTIME)1000000000) > 0)
+        {
+        }
+        long long cDrawn = canvas.GetRasterizedCount() - cBefore;
+        if (cDrawn > cBoxTiles)
+            cOverdrawn++;
+        cRedrawn += cDrawn;
+        cRemoved++;
+
+        if (0 == cRemoved % 25)
+            cDiffer += CheckCanvasView(canvas, view, frame, reference);
+    }
+    printf("%d strokes removed, %.1f tiles drawn again per stroke\n",
+           cRemoved, (double)cRedrawn / cRemoved);
+
+    free(pptFrames);
+    if (cDiffer > 0)
+        printf("%d pixels differ from the slow drawing\n", cDiffer);
+    if (cOverdrawn > 0)
+        printf("%d removals drew tiles they don't cross\n", cOverdrawn);
+    return (0 == cDiffer && 0 == cOverdrawn) ? 0 : 1;
+}
+
+/////////////////////////////////////////////////////////
+//
+// RedrawPane
+//
+// Paints a pane the way a full repaint does: the background
+// and every stroke, then the part of the live stroke drawn
+// so far. The strokes are x, y pairs, pcStrokePoints[s] of
+// them per stroke, one after the other.
+//
+/////////////////////////////////////////////////////////
+static void RedrawPane(CSoftRaster& frame, const int* piPoints, const int* pcStrokePoints,
+                       int cStrokes, const int* piLive, int cLive)
+{
+    RasterRect rc = { 0, 0, frame.GetWidth(), frame.GetHeight() };
+    frame.FillRect(rc, HA_CLR_INPUT_BACK);
+    for (int s = 0; s <= cStrokes; s++)
+    {
+        const int* pi = (s < cStrokes) ? piPoints : piLive;
+        int cPoints = (s < cStrokes) ? pcStrokePoints[s] : cLive;
+        if (1 == cPoints)
+            frame.DrawLine(pi[0], pi[1], pi[0], pi[1], HA_CLR_INK);
+        for (int i = 1; i < cPoints; i++)
+        {
+            frame.DrawLine(pi[2 * i - 2], pi[2 * i - 1], pi[2 * i], pi[2 * i + 1], HA_CLR_INK);
+        }
+        piPoints += (s < cStrokes) ? 2 * cPoints : 0;
+    }
+}
+
+// Counts the pixels that differ between two frames of a size
+static int CountDifferentPixels(const CSoftRaster& frame1, const CSoftRaster& frame2)
+{
+    int cDiffer = 0;
+    for (int y = 0; y < frame1.GetHeight(); y++)
+    {
+        for (int x = 0; x < frame1.GetWidth(); x++)
+        {
+            if (frame1.GetPixel(x, y) != frame2.GetPixel(x, y))
+                cDiffer++;
+        }
+    }
+    return cDiffer;
+}
+
+/////////////////////////////////////////////////////////
+//
+// BenchLayers
+//
+// Paints a live stroke over a 1920x1080 pane with more and
+// more committed ink, packet by packet, both by repainting
+// the pane, as an invalidation of the window does, and by
+// composing the segment from the ink layers. Checks the
+// layers against the repaint pixel by pixel while the
+// stroke is drawn, once it's committed and once it's
+// dropped as a gesture.
+//
+/////////////////////////////////////////////////////////
+static int BenchLayers(int argc, char** argv)
+{
+    int cMaxStrokes = 10000;
+    for (int i = 0; i < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "-n") && i + 1 < argc)
+            cMaxStrokes = atoi(argv[++i]);
+    }
+    if (cMaxStrokes < 1)
+        cMaxStrokes = 1;
+
+    const int cxPane = 1920, cyPane = 1080;
+    CInkLayers layers;
+    CSoftRaster frame, reference;
+    int* piPoints = (int*)malloc((size_t)2 * cMaxStrokes * BENCH_MAX_POINTS * sizeof(int));
+    int* pcStrokePoints = (int*)malloc((cMaxStrokes + 1) * sizeof(int));
+    if (NULL == piPoints || NULL == pcStrokePoints
+        || false == layers.Create(cxPane, cyPane, HA_CLR_INPUT_BACK, HA_CLR_INK)
+        || false == frame.Create(cxPane, cyPane) || false == reference.Create(cxPane, cyPane))
+    {
+        free(piPoints);
+        free(pcStrokePoints);
+        printf("out of memory\n");
+        return 1;
+    }
+
+    // The live stroke, a large gesture across the middle of the pane
+    CSyntheticInk synth(4242);
+    GesturePoint rgpt[BENCH_MAX_POINTS];
+    int rgiLive[2 * BENCH_MAX_POINTS];
+    int iGesture;
+    int cLive = synth.MakeStroke(0, iGesture, rgpt, countof(rgpt));
+    PlaceStroke(rgpt, cLive, cxPane / 2.0f, cyPane / 2.0f, 600);
+    for (int i = 0; i < cLive; i++)
+    {
+        rgiLive[2 * i] = (int)floorf(rgpt[i].x + 0.5f);
+        rgiLive[2 * i + 1] = (int)floorf(rgpt[i].y + 0.5f);
+    }
+
+    printf("%8s %14s %14s %10s %14s %12s\n", "strokes", "repaint us/pkt", "layers us/pkt",
+           "px/pkt", "commit us", "expose us");
+    int cStrokes = 0, cPoints = 0, cDiffer = 0;
+    RasterRect rcPane = { 0, 0, cxPane, cyPane };
+    for (int cTarget = 0; ; cTarget = (0 == cTarget) ? 10 : 10 * cTarget)
+    {
+        if (cTarget > cMaxStrokes)
+            cTarget = cMaxStrokes;
+
+        // Commit the ink up to the target
+        RasterRect rcDirty;
+        for (; cStrokes < cTarget; cStrokes++)
+        {
+            int cStrokePoints = synth.MakeStroke(cStrokes % CGestureEngine::GetBuiltinShapeCount(),
+                                                 iGesture, rgpt, countof(rgpt));
+            PlaceStroke(rgpt, cStrokePoints, synth.NextRange(0, (float)cxPane),
+                        synth.NextRange(0, (float)cyPane), synth.NextRange(20, 200));
+            int* pi = piPoints + 2 * cPoints;
+            for (int i = 0; i < cStrokePoints; i++)
+            {
+                pi[2 * i] = (int)floorf(rgpt[i].x + 0.5f);
+                pi[2 * i + 1] = (int)floorf(rgpt[i].y + 0.5f);
+            }
+            layers.CommitStroke(pi, cStrokePoints, rcDirty);
+            pcStrokePoints[cStrokes] = cStrokePoints;
+            cPoints += cStrokePoints;
+        }
+        layers.Compose(rcPane, frame, 0, 0);
+
+        // The repaint per packet, on the first packets only when
+        // there's a lot of ink
+        int cRepainted = (cStrokes > 100) ? 10 : cLive;
+        PERFTIME ptStart = PerfNow();
+        for (int i = 1; i <= cRepainted; i++)
+        {
+            RedrawPane(reference, piPoints, pcStrokePoints, cStrokes, rgiLive, i);
+        }
+        PERFTIME ptRepaint = PerfNow() - ptStart;
+
+        // The layers per packet, the whole stroke
+        long long cPixels = 0;
+        ptStart = PerfNow();
+        for (int i = 0; i < cLive; i++)
+        {
+            layers.AddPoint(rgiLive[2 * i], rgiLive[2 * i + 1], rcDirty);
+            layers.Compose(rcDirty, frame, 0, 0);
+            cPixels += (long long)(rcDirty.right - rcDirty.left) * (rcDirty.bottom - rcDirty.top);
+        }
+        PERFTIME ptLayers = PerfNow() - ptStart;
+        RedrawPane(reference, piPoints, pcStrokePoints, cStrokes, rgiLive, cLive);
+        cDiffer += CountDifferentPixels(frame, reference);
+
+        // An exposed pane is composed whole
+        ptStart = PerfNow();
+        layers.Compose(rcPane, frame, 0, 0);
+        PERFTIME ptExpose = PerfNow() - ptStart;
+
+        // Drop the stroke, as a gesture, then draw it again and commit it
+        layers.EndStroke(false, rcDirty);
+        layers.Compose(rcDirty, frame, 0, 0);
+        RedrawPane(reference, piPoints, pcStrokePoints, cStrokes, rgiLive, 0);
+        cDiffer += CountDifferentPixels(frame, reference);
+
+        for (int i = 0; i < cLive; i++)
+        {
+            layers.AddPoint(rgiLive[2 * i], rgiLive[2 * i + 1], rcDirty);
+            layers.Compose(rcDirty, frame, 0, 0);
+        }
+        ptStart = PerfNow();
+        layers.EndStroke(true, rcDirty);
+        layers.Compose(rcDirty, frame, 0, 0);
+        PERFTIME ptCommit = PerfNow() - ptStart;
+        memcpy(piPoints + 2 * cPoints, rgiLive, 2 * cLive * sizeof(int));
+        pcStrokePoints[cStrokes++] = cLive;
+        cPoints += cLive;
+        RedrawPane(reference, piPoints, pcStrokePoints, cStrokes, rgiLive, 0);
+        cDiffer += CountDifferentPixels(frame, reference);
+
+        printf("%8d %14.1f %14.2f %10.0f %14.1f %12.1f\n", cTarget,
+               ptRepaint / 1e3 / cRepainted, ptLayers / 1e3 / cLive, (double)cPixels / cLive,
+               ptCommit / 1e3, ptExpose / 1e3);
+        if (cTarget == cMaxStrokes)
+            break;
+    }
+
+    free(piPoints);
+    free(pcStrokePoints);
+    if (cDiffer > 0)
+        printf("%d pixels differ from the repaint\n", cDiffer);
+    return (0 == cDiffer) ? 0 : 1;
+}
+
+// The table of the benchmark suites
+struct BenchSuite
+{
+    const char*     pszName;
+    int             (*pfnRun)(int argc, char** argv);
+    const char*     pszDescription;
+};
+
+/////////////////////////////////////////////////////////
+//
+// BenchBatch
+//
+// Recognizes the same strokes one by one with Recognize
+// and in batches with RecognizeBatch, as the recognition
+// service does (see GestureService.h), in every storage
+// format with the built-in and a few user templates per
+// shape, and compares every alternate: the batches must
+// give the very same results.
+//
+// Parameters:
+//     -n count : [in] the strokes, 2048 by default
+//
+// Return Values (int):
+//      0 if the results are the same, 1 otherwise
+//
+/////////////////////////////////////////////////////////
+static int BenchBatch(int argc, char** argv)
+{
+    static const char* const rgpszFormats[GE_NUM_FORMATS] = { "float32", "float16", "int8" };
+    static const int rgcBatches[] = { 1, 4, 16, GE_MAX_BATCH };
+    int cStrokes = 2048;
+    for (int i = 0; i + 1 < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "-n"))
+            cStrokes = atoi(argv[++i]);
+    }
+    if (cStrokes <= 0)
+        return 1;
+
+    GesturePoint* pPoints = (GesturePoint*)malloc(cStrokes * BENCH_MAX_POINTS * sizeof(GesturePoint));
+    GestureStroke* pStrokes = (GestureStroke*)malloc(cStrokes * sizeof(GestureStroke));
+    GestureResult* pSingle = (GestureResult*)malloc(cStrokes * GE_NUM_SSGESTURES * sizeof(GestureResult));
+    GestureResult* pBatched = (GestureResult*)malloc(cStrokes * GE_NUM_SSGESTURES * sizeof(GestureResult));
+    int* pcSingle = (int*)malloc(cStrokes * sizeof(int));
+    int* pcBatched = (int*)malloc(cStrokes * sizeof(int));
+    if (NULL == pPoints || NULL == pStrokes || NULL == pSingle || NULL == pBatched ||
+        NULL == pcSingle || NULL == pcBatched)
+    {
+        free(pPoints);
+        free(pStrokes);
+        free(pSingle);
+        free(pBatched);
+        free(pcSingle);
+        free(pcBatched);
+        return 1;
+    }
+
+    // The strokes of all the shapes, the taps included
+    CSyntheticInk ink(4343, 1.5f);
+    int cShapes = CGestureEngine::GetBuiltinShapeCount();
+    for (int i = 0; i < cStrokes; i++)
+    {
+        int iGesture;
+        pStrokes[i].ppt = pPoints + (size_t)i * BENCH_MAX_POINTS;
+        pStrokes[i].cPoints = ink.MakeStroke(i % cShapes, iGesture,
+                                             pPoints + (size_t)i * BENCH_MAX_POINTS, BENCH_MAX_POINTS);
+    }
+
+    printf("%8s %10s %8s %12s %10s\n", "format", "templates", "batch", "us/stroke", "speedup");
+
+    int cDiffer = 0;
+    for (int f = 0; f < GE_NUM_FORMATS; f++)
+    {
+        CGestureEngine engine;
+        engine.SetStorageFormat(f);
+        FillEngine(engine, 4 * cShapes, 12345);
+
+        PERFTIME ptStart = PerfNow();
+        for (int i = 0; i < cStrokes; i++)
+        {
+            pcSingle[i] = engine.Recognize(pStrokes[i].ppt, pStrokes[i].cPoints,
+                                           pSingle + (size_t)i * GE_NUM_SSGESTURES, GE_NUM_SSGESTURES);
+        }
+        PERFTIME ptSingle = PerfNow() - ptStart;
+        printf("%8s %10d %8s %12.1f %10s\n", rgpszFormats[f], engine.GetTemplateCount(),
+               "none", ptSingle / 1e3 / cStrokes, "1.00x");
+
+        for (int b = 0; b < (int)countof(rgcBatches); b++)
+        {
+            int cBatch = rgcBatches[b];
+            ptStart = PerfNow();
+            for (int i = 0; i < cStrokes; i += cBatch)
+            {
+                int c = (cStrokes - i < cBatch) ? cStrokes - i : cBatch;
+                engine.RecognizeBatch(pStrokes + i, c, pBatched + (size_t)i * GE_NUM_SSGESTURES,
+                                      GE_NUM_SSGESTURES, pcBatched + i);
+            }
+            PERFTIME ptBatched = PerfNow() - ptStart;
+
+            for (int i = 0; i < cStrokes; i++)
+            {
+                bool bSame = (pcSingle[i] == pcBatched[i]);
+                for (int r = 0; r < pcSingle[i] && bSame; r++)
+                {
+                    const GestureResult& single = pSingle[(size_t)i * GE_NUM_SSGESTURES + r];
+                    const GestureResult& batched = pBatched[(size_t)i * GE_NUM_SSGESTURES + r];
+                    bSame = (single.iGesture == batched.iGesture &&
+                             single.iTemplate == batched.iTemplate &&
+                             single.fScore == batched.fScore);
+                }
+                if (false == bSame)
+                    cDiffer++;
+            }
+
+            printf("%8s %10d %8d %12.1f %9.2fx\n", rgpszFormats[f], engine.GetTemplateCount(),
+                   cBatch, ptBatched / 1e3 / cStrokes, (double)ptSingle / ptBatched);
+            fflush(stdout);
+        }
+    }
+
+    free(pPoints);
+    free(pStrokes);
+    free(pSingle);
+    free(pBatched);
+    free(pcSingle);
+    free(pcBatched);
+
+    if (cDiffer > 0)
+    {
+        printf("%d batched recognitions differ from Recognize\n", cDiffer);
+        return 1;
+    }
+    return 0;
+}
+
+/////////////////////////////////////////////////////////
+//
+// The config suite
+//
+/////////////////////////////////////////////////////////
+
+#define BENCH_CONFIG_READERS    3
+#define BENCH_CONFIG_ENABLED    (GE_NUM_SSGESTURES / 2)
+
+// A reader thread of the config suite, and what it found
+struct ConfigReader
+{
+    CGestureConfig*         pConfig;
+    const GestureStroke*    pStrokes;
+    int                     cStrokes;
+    volatile long*          pbStop;
+    volatile long           cRecognized;
+    long                    cSnapshots;     // the versions seen
+    long                    cErrors;
+};
+
+/////////////////////////////////////////////////////////
+//
+// CountBits
+//
+// Return Values (int):
+//      the number of bits set
+//
+/////////////////////////////////////////////////////////
+static int CountBits(unsigned long long ull)
+{
+    int c = 0;
+    for (; 0 != ull; ull &= ull - 1)
+        c++;
+    return c;
+}
+
+/////////////////////////////////////////////////////////
+//
+// YieldThread
+//
+// Lets the other threads run, so the writer and the readers
+// of the config suite interleave on a single processor too.
+//
+/////////////////////////////////////////////////////////
+static void YieldThread()
+{
+#ifdef _WIN32
+    ::SwitchToThread();
+#else
+    sched_yield();
+#endif
+}
+
+/////////////////////////////////////////////////////////
+//
+// ReadConfig
+//
+// Recognizes the strokes over and over, each with the
+// snapshot current when it starts, until stopped. A
+// snapshot must have BENCH_CONFIG_ENABLED gestures, as all
+// the changes keep, a version no older than the last one,
+// and give only gestures it enables.
+//
+// Parameters:
+//     ConfigReader& reader : [in/out] the reader
+//
+/////////////////////////////////////////////////////////
+static void ReadConfig(ConfigReader& reader)
+{
+    GestureResult rgResults[GE_NUM_SSGESTURES];
+    long lLastVersion = 0;
+    int iSlot = -1;
+    for (int i = 0; 0 == *reader.pbStop; i = (i + 1) % reader.cStrokes)
+    {
+        const GestureSnapshot* pSnapshot = reader.pConfig->Acquire(iSlot);
+        if (NULL == pSnapshot)
+        {
+            reader.cErrors++;
+            continue;
+        }
+        const CGestureEngine& engine = pSnapshot->engine;
+        if (BENCH_CONFIG_ENABLED != CountBits(engine.GetGestureMask()) ||
+            pSnapshot->lVersion < lLastVersion)
+        {
+            reader.cErrors++;
+        }
+        if (pSnapshot->lVersion != lLastVersion)
+            reader.cSnapshots++;
+        lLastVersion = pSnapshot->lVersion;
+
+        int cResults = engine.Recognize(reader.pStrokes[i].ppt, reader.pStrokes[i].cPoints,
+                                        rgResults, GE_NUM_SSGESTURES);
+        for (int r = 0; r < cResults; r++)
+        {
+            if (false == engine.IsGestureEnabled(rgResults[r].iGesture))
+                reader.cErrors++;
+        }
+        reader.pConfig->Release(iSlot);
+        reader.cRecognized++;
+        YieldThread();
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// WaitForReaders
+//
+// Lets the readers run until one of them has recognized a
+// stroke more, so the changes are spread over the reads.
+//
+/////////////////////////////////////////////////////////
+static void WaitForReaders(const ConfigReader* pReaders, int cReaders)
+{
+    long cBefore = 0;
+    for (int i = 0; i < cReaders; i++)
+        cBefore += pReaders[i].cRecognized;
+    for (long cAfter = cBefore; cReaders > 0 && cAfter == cBefore; )
+    {
+        YieldThread();
+        cAfter = 0;
+        for (int i = 0; i < cReaders; i++)
+            cAfter += pReaders[i].cRecognized;
+    }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI ConfigReaderProc(LPVOID pv)
+{
+    ReadConfig(*(ConfigReader*)pv);
+    return 0;
+}
+#else
+static void* ConfigReaderProc(void* pv)
+{
+    ReadConfig(*(ConfigReader*)pv);
+    return NULL;
+}
+#endif
+
+#define BENCH_PIN_CELLS         8
+
+/////////////////////////////////////////////////////////
+//
+// class CPinRecorder
+//
+// The recognizer of the workers of the pinning check: the
+// first cell it recognizes changes the configuration, as
+// if the user did halfway through a job, and every cell
+// notes the version of the templates it's recognized with.
+//
+/////////////////////////////////////////////////////////
+class CPinRecorder : public IStrokeRecognizer
+{
+    CGestureConfig&         m_config;
+    CGestureTextRecognizer  m_recognizer;
+    std::atomic<long>       m_cCalls;
+
+public:
+
+    long                    m_rglVersions[BENCH_PIN_CELLS];
+
+    CPinRecorder(CGestureConfig& config) :
+        m_config(config), m_recognizer(config), m_cCalls(0)
+    {
+        memset(m_rglVersions, 0, sizeof(m_rglVersions));
+    }
+
+    virtual int Recognize(const CRecoInk& ink, const RecoCancel& cancel,
+                          RecoAlternate* pAlternates, int cMaxAlternates)
+    {
+        if (0 == m_cCalls++)
+            m_config.SetGestureEnabled(0, false);
+        const GestureSnapshot* pSnapshot = ink.GetSnapshot();
+        int iCell = ink.GetStrokeCell(0);
+        if (iCell >= 0 && iCell < BENCH_PIN_CELLS)
+            m_rglVersions[iCell] = (NULL != pSnapshot) ? pSnapshot->lVersion : m_config.GetVersion();
+        return m_recognizer.Recognize(ink, cancel, pAlternates, cMaxAlternates);
+    }
+};
+
+/////////////////////////////////////////////////////////
+//
+// CheckConfigPins
+//
+// Checks the two ways a recognition gets its snapshot: a
+// guided job pins one for all its cells though the
+// configuration changes while they're recognized, and a
+// recognition with every slot taken fails, and is counted,
+// rather than going on without templates.
+//
+// Return Values (int):
+//      the number of the checks that failed
+//
+/////////////////////////////////////////////////////////
+static int CheckConfigPins(CGestureConfig& config, const GestureStroke* pStrokes)
+{
+    int cWrong = 0;
+    long lGeneration = 1;
+    RecoCancel cancel = { &lGeneration, 1 };
+    RecoAlternate rgAlternates[BR_MAX_ALTERNATES];
+
+    // A guided job, a stroke per cell, on two workers
+    CRecoInk ink;
+    ink.SetCellColumns(BENCH_PIN_CELLS);
+    for (int i = 0; i < BENCH_PIN_CELLS; i++)
+    {
+        ink.AddStroke(pStrokes[i].ppt, pStrokes[i].cPoints, i);
+    }
+    CPinRecorder recorder(config);
+    IStrokeRecognizer* rgpRecognizers[2] = { &recorder, &recorder };
+    CRecoWorkerPool pool;
+    long lBefore = config.GetVersion();
+    int cAlternates = -1;
+    if (pool.Start(rgpRecognizers, 2))
+    {
+        CGuidedRecognizer guided(pool, &config);
+        cAlternates = guided.Recognize(ink, cancel, rgAlternates, BR_MAX_ALTERNATES);
+        pool.Stop();
+    }
+    config.SetGestureEnabled(0, true);
+    int cMixed = 0;
+    for (int i = 0; i < BENCH_PIN_CELLS; i++)
+    {
+        if (recorder.m_rglVersions[i] != lBefore)
+            cMixed++;
+    }
+    printf("guided job: %d of %d cells off the job's snapshot\n", cMixed, BENCH_PIN_CELLS);
+    if (cAlternates <= 0 || cMixed > 0)
+        cWrong++;
+
+    // Every slot taken
+    int rgiSlots[GC_MAX_READERS];
+    int cPinned = 0;
+    for (; cPinned < GC_MAX_READERS; cPinned++)
+    {
+        if (NULL == config.Acquire(rgiSlots[cPinned]))
+            break;
+    }
+    long cFullBefore = config.GetFullFailureCount();
+    CRecoInk one;
+    one.AddStroke(pStrokes[0].ppt, pStrokes[0].cPoints);
+    CGestureTextRecognizer recognizer(config);
+    int cFull = recognizer.Recognize(one, cancel, rgAlternates, BR_MAX_ALTERNATES);
+    long cCounted = config.GetFullFailureCount() - cFullBefore;
+    for (int i = 0; i < cPinned; i++)
+    {
+        config.Release(rgiSlots[i]);
+    }
+    printf("no slot free: recognition returned %d, %ld failure(s) counted\n", cFull, cCounted);
+    if (cPinned < GC_MAX_READERS || -1 != cFull || cCounted < 1)
+        cWrong++;
+    return cWrong;
+}
+
+/////////////////////////////////////////////////////////
+//
+// BenchConfig
+//
+// Changes the configuration of the recognizer while reader
+// threads recognize with it: every change disables one
+// gesture and enables another, and every 64th adds a user
+// template, so a reader that saw a change half applied
+// would count the wrong number of gestures. Measures an
+// Acquire and Release against taking a lock, and the cost
+// of a change, then checks every retired snapshot is freed
+// once the readers are gone, and that a job pins one
+// snapshot (see CheckConfigPins).
+//
+// Parameters:
+//     -n count : [in] the changes, 4096 by default
+//
+// Return Values (int):
+//      0 if the readers saw only whole snapshots, none
+//      leaked and the pins held, 1 otherwise
+//
+/////////////////////////////////////////////////////////
+static int BenchConfig(int argc, char** argv)
+{
+    int cChanges = 4096;
+    for (int i = 0; i + 1 < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "-n"))
+            cChanges = atoi(argv[++i]);
+    }
+    if (cChanges <= 0)
+        return 1;
+
+    // The strokes of all the shapes
+    const int cStrokes = 256;
+    GesturePoint* pPoints = (GesturePoint*)malloc(cStrokes * BENCH_MAX_POINTS * sizeof(GesturePoint));
+    GestureStroke* pStrokes = (GestureStroke*)malloc(cStrokes * sizeof(GestureStroke));
+    if (NULL == pPoints || NULL == pStrokes)
+    {
+        free(pPoints);
+        free(pStrokes);
+        return 1;
+    }
+    CSyntheticInk ink(4545, 1.5f);
+    int cShapes = CGestureEngine::GetBuiltinShapeCount();
+    for (int i = 0; i < cStrokes; i++)
+    {
+        int iGesture;
+        pStrokes[i].ppt = pPoints + (size_t)i * BENCH_MAX_POINTS;
+        pStrokes[i].cPoints = ink.MakeStroke(i % cShapes, iGesture,
+                                             pPoints + (size_t)i * BENCH_MAX_POINTS, BENCH_MAX_POINTS);
+    }
+
+    // The first half of the gestures enabled
+    CGestureEngine engine;
+    engine.AddBuiltinTemplates();
+    engine.SetGestureMask((1ULL << BENCH_CONFIG_ENABLED) - 1);
+    CGestureConfig config;
+    if (false == config.Create(engine))
+    {
+        free(pPoints);
+        free(pStrokes);
+        return 1;
+    }
+
+    // An Acquire and a Release, uncontended, against a lock and an unlock
+    const int cPins = 1000000;
+    int iSlot = -1;
+    PERFTIME ptStart = PerfNow();
+    for (int i = 0; i < cPins; i++)
+    {
+        config.Acquire(iSlot);
+        config.Release(iSlot);
+    }
+    PERFTIME ptPin = PerfNow() - ptStart;
+#ifdef _WIN32
+    CRITICAL_SECTION cs;
+    ::InitializeCriticalSection(&cs);
+    ptStart = PerfNow();
+    for (int i = 0; i < cPins; i++)
+    {
+        ::EnterCriticalSection(&cs);
+        ::LeaveCriticalSection(&cs);
+    }
+    PERFTIME ptLock = PerfNow() - ptStart;
+    ::DeleteCriticalSection(&cs);
+#else
+    pthread_mutex_t mutex;
+    pthread_mutex_init(&mutex, NULL);
+    ptStart = PerfNow();
+    for (int i = 0; i < cPins; i++)
+    {
+        pthread_mutex_lock(&mutex);
+        pthread_mutex_unlock(&mutex);
+    }
+    PERFTIME ptLock = PerfNow() - ptStart;
+    pthread_mutex_destroy(&mutex);
+#endif
+    printf("acquire and release %8.1f ns\n", (double)ptPin / cPins);
+    printf("lock and unlock     %8.1f ns\n", (double)ptLock / cPins);
+
+    // The readers
+    volatile long bStop = 0;
+    ConfigReader rgReaders[BENCH_CONFIG_READERS];
+#ifdef _WIN32
+    HANDLE rghThreads[BENCH_CONFIG_READERS];
+#else
+    pthread_t rgThreads[BENCH_CONFIG_READERS];
+#endif
+    int cReaders = 0;
+    for (; cReaders < BENCH_CONFIG_READERS; cReaders++)
+    {
+        ConfigReader& reader = rgReaders[cReaders];
+        reader.pConfig = &config;
+        reader.pStrokes = pStrokes;
+        reader.cStrokes = cStrokes;
+        reader.pbStop = &bStop;
+        reader.cRecognized = 0;
+        reader.cSnapshots = 0;
+        reader.cErrors = 0;
+#ifdef _WIN32
+        rghThreads[cReaders] = ::CreateThread(NULL, 0, ConfigReaderProc, &reader, 0, NULL);
+        if (NULL == rghThreads[cReaders])
+            break;
+#else
+        if (0 != pthread_create(&rgThreads[cReaders], NULL, ConfigReaderProc, &reader))
+            break;
+#endif
+    }
+
+    // The changes, each swapping an enabled gesture for a disabled one
+    unsigned int uSeed = 777;
+    int cFailed = 0;
+    PERFTIME ptChanges = 0;
+    for (int i = 0; i < cChanges; i++)
+    {
+        PERFTIME ptBegin = PerfNow();
+        CGestureEngine* pEngine = config.BeginUpdate();
+        ptChanges += PerfNow() - ptBegin;
+        if (NULL == pEngine)
+        {
+            cFailed++;
+            continue;
+        }
+        unsigned long long ullMask = pEngine->GetGestureMask();
+        int iOn = -1, iOff = -1;
+        while (iOn < 0 || iOff < 0)
+        {
+            uSeed = uSeed * 1103515245 + 12345;
+            int iGesture = (int)((uSeed >> 16) % GE_NUM_SSGESTURES);
+            if (0 != (ullMask & (1ULL << iGesture)))
+                iOff = iGesture;
+            else
+                iOn = iGesture;
+        }
+        pEngine->SetGestureMask((ullMask | (1ULL << iOn)) & ~(1ULL << iOff));
+        if (0 == i % 64)
+        {
+            const GestureStroke& stroke = pStrokes[i % cStrokes];
+            pEngine->AddTemplate(iOn, stroke.ppt, stroke.cPoints);
+        }
+        PERFTIME ptCommit = PerfNow();
+        config.Commit();
+        ptChanges += PerfNow() - ptCommit;
+        WaitForReaders(rgReaders, cReaders);
+    }
+    int cPinnedRetired = config.GetRetiredCount();
+
+    bStop = 1;
+    for (int i = 0; i < cReaders; i++)
+    {
+#ifdef _WIN32
+        ::WaitForSingleObject(rghThreads[i], INFINITE);
+        ::CloseHandle(rghThreads[i]);
+#else
+        pthread_join(rgThreads[i], NULL);
+#endif
+    }
+
+    // With no reader left, the next change frees all the retired snapshots
+    if (NULL != config.BeginUpdate())
+        config.Commit();
+    int cLeaked = config.GetRetiredCount();
+    const GestureSnapshot* pSnapshot = config.Acquire(iSlot);
+    int cTemplates = (NULL != pSnapshot) ? pSnapshot->engine.GetTemplateCount() : 0;
+    config.Release(iSlot);
+
+    long cRecognized = 0, cErrors = 0;
+    printf("\n%8s %12s %12s %8s\n", "reader", "recognized", "snapshots", "errors");
+    for (int i = 0; i < cReaders; i++)
+    {
+        printf("%8d %12ld %12ld %8ld\n", i, rgReaders[i].cRecognized,
+               rgReaders[i].cSnapshots, rgReaders[i].cErrors);
+        cRecognized += rgReaders[i].cRecognized;
+        cErrors += rgReaders[i].cErrors;
+    }
+    printf("\nchanges %d, %.1f us each, %d templates, version %ld\n", cChanges,
+           ptChanges / 1e3 / cChanges, cTemplates, config.GetVersion());
+    printf("retired snapshots: %d at the last change, %d after the readers\n",
+           cPinnedRetired, cLeaked);
+
+    printf("\n");
+    int cPinsWrong = CheckConfigPins(config, pStrokes);
+
+    free(pPoints);
+    free(pStrokes);
+
+    if (cPinsWrong > 0)
+        return 1;
+    if (cReaders < BENCH_CONFIG_READERS || 0 == cRecognized)
+    {
+        printf("the readers didn't run\n");
+        return 1;
+    }
+    if (cErrors > 0 || cFailed > 0 || cLeaked > 0)
+    {
+        printf("%ld readers' errors, %d changes failed, %d snapshots leaked\n",
+               cErrors, cFailed, cLeaked);
+        return 1;
+    }
+    return 0;
+}
+
+/////////////////////////////////////////////////////////
+//
+// The ensemble suite
+//
+/////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////
+//
+// class CSlowBackend
+//
+// A backend that takes too long now and then: every
+// cPeriod-th stroke it sleeps before passing the stroke
+// on to another backend.
+//
+/////////////////////////////////////////////////////////
+
+class CSlowBackend : public IGestureBackend
+{
+    IGestureBackend&    m_backend;
+    int                 m_cPeriod;
+    int                 m_cDelayMs;
+    int                 m_iStroke;
+
+public:
+
+    CSlowBackend(IGestureBackend& backend, int cPeriod, int cDelayMs)
+        : m_backend(backend), m_cPeriod(cPeriod), m_cDelayMs(cDelayMs), m_iStroke(0) {}
+
+    virtual const char* GetName() const { return "slow"; }
+    virtual int Recognize(const GesturePoint* ppt, int cPoints,
+                          GestureResult* pResults, int cMaxResults)
+    {
+        if (0 == m_iStroke++ % m_cPeriod)
+            SleepMs(m_cDelayMs);
+        return m_backend.Recognize(ppt, cPoints, pResults, cMaxResults);
+    }
+};
+
+// The wake-up latency the ensemble suite allows past the budget, for
+// the timer and the scheduler, in microseconds
+#define BENCH_ENSEMBLE_JITTER_US    1000
+
+// The answers of an ensemble run
+struct EnsembleRun
+{
+    int         cCorrect;
+    int         cAnswered;
+    PERFTIME*   pptLatencies;   // per stroke, sorted
+};
+
+/////////////////////////////////////////////////////////
+//
+// RunEnsemble
+//
+// Recognizes the strokes with an ensemble, one at a time,
+// and times every answer.
+//
+/////////////////////////////////////////////////////////
+static void RunEnsemble(
+        CGestureEnsemble& ensemble,
+        const GestureStroke* pStrokes,
+        const int* piGestures,
+        int cStrokes,
+        int iBudgetUs,
+        EnsembleRun& run
+        )
+{
+    GestureResult rgResults[GE_NUM_SSGESTURES];
+    run.cCorrect = 0;
+    run.cAnswered = 0;
+    for (int i = 0; i < cStrokes; i++)
+    {
+        PERFTIME ptStart = PerfNow();
+        int cResults = ensemble.Recognize(pStrokes[i].ppt, pStrokes[i].cPoints, iBudgetUs,
+                                          rgResults, GE_NUM_SSGESTURES);
+        run.pptLatencies[i] = PerfNow() - ptStart;
+        if (cResults > 0)
+        {
+            run.cAnswered++;
+            if (rgResults[0].iGesture == piGestures[i])
+                run.cCorrect++;
+        }
+    }
+    qsort(run.pptLatencies, cStrokes, sizeof(PERFTIME), ComparePerfTimes);
+}
+
+/////////////////////////////////////////////////////////
+//
+// PrintEnsemble
+//
+// Prints the accuracy and the latencies of a run and the
+// votes of every backend.
+//
+/////////////////////////////////////////////////////////
+static void PrintEnsemble(const char* pszRun, const CGestureEnsemble& ensemble,
+                          IGestureBackend* const* ppBackends, const EnsembleRun& run, int cStrokes)
+{
+    printf("\n%s: %.1f%% correct, %d of %d answered, latency p50 %.0f us, p99 %.0f us, max %.0f us\n",
+           pszRun, 100.0 * run.cCorrect / cStrokes, run.cAnswered, cStrokes,
+           run.pptLatencies[cStrokes / 2] / 1e3, run.pptLatencies[cStrokes * 99 / 100] / 1e3,
+           run.pptLatencies[cStrokes - 1] / 1e3);
+    printf("%12s %8s %8s %8s %12s\n", "backend", "votes", "late", "busy", "us/stroke");
+    for (int i = 0; i < ensemble.GetBackendCount(); i++)
+    {
+        BackendStats stats;
+        ensemble.GetStats(i, stats);
+        long cRun = stats.cVotes + stats.cLate;
+        printf("%12s %8ld %8ld %8ld %12.1f\n", ppBackends[i]->GetName(), stats.cVotes,
+               stats.cLate, stats.cBusy, (cRun > 0) ? stats.ptBusy / 1e3 / cRun : 0.0);
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CheckEnsemble
+//
+// Return Values (bool):
+//      true if every stroke of a run was answered and its p99
+//      latency is within the budget and the jitter allowance,
+//      false after printing why not
+//
+/////////////////////////////////////////////////////////
+static bool CheckEnsemble(const char* pszRun, const EnsembleRun& run, int cStrokes, int iBudgetUs)
+{
+    bool bOk = true;
+    if (run.cAnswered < cStrokes)
+    {
+        printf("%s: %d strokes weren't answered\n", pszRun, cStrokes - run.cAnswered);
+        bOk = false;
+    }
+    PERFTIME ptP99 = run.pptLatencies[cStrokes * 99 / 100];
+    if (ptP99 > (PERFTIME)(iBudgetUs + BENCH_ENSEMBLE_JITTER_US) * 1000)
+    {
+        printf("%s: p99 latency %.0f us past the budget of %d us and %d us of jitter\n",
+               pszRun, ptP99 / 1e3, iBudgetUs, BENCH_ENSEMBLE_JITTER_US);
+        bOk = false;
+    }
+    return bOk;
+}
+
+/////////////////////////////////////////////////////////
+//
+// BenchEnsemble
+//
+// Recognizes noisy strokes with every backend alone, then
+// with the ensemble of all of them, then with one backend
+// made to miss the budget now and then: its late votes
+// must be dropped and no answer may wait for it. In both
+// ensemble runs every stroke must be answered, with a p99
+// latency within the budget and BENCH_ENSEMBLE_JITTER_US.
+//
+// Parameters:
+//     -n count       : [in] the strokes, 1000 by default
+//     -budget us     : [in] the latency budget, 5000 us by default
+//     -plugin path   : [in] a backend library to add, e.g.
+//                      FeatureBackend.dll
+//
+// Return Values (int):
+//      0 if the deadlines were kept and every stroke answered,
+//      1 otherwise
+//
+/////////////////////////////////////////////////////////
+static int BenchEnsemble(int argc, char** argv)
+{
+    int cStrokes = 1000;
+    int iBudgetUs = 5000;
+    const char* pszPlugin = NULL;
+    for (int i = 0; i + 1 < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "-n"))
+            cStrokes = atoi(argv[++i]);
+        else if (0 == strcmp(argv[i], "-budget"))
+            iBudgetUs = atoi(argv[++i]);
+        else if (0 == strcmp(argv[i], "-plugin"))
+            pszPlugin = argv[++i];
+    }
+    if (cStrokes <= 0 || iBudgetUs <= 0)
+        return 1;
+
+    // The backends
+    CGestureEngine engine;
+    engine.AddBuiltinTemplates();
+    CTemplateBackend templateBackend(engine);
+    CDtwBackend dtwBackend;
+    dtwBackend.AddBuiltinTemplates();
+    CChainCodeBackend chainCodeBackend;
+    chainCodeBackend.AddBuiltinTemplates();
+    CPluginBackend pluginBackend;
+    IGestureBackend* rgpBackends[GE_MAX_BACKENDS] = { &templateBackend, &dtwBackend, &chainCodeBackend };
+    int cBackends = 3;
+    if (NULL != pszPlugin)
+    {
+        if (false == pluginBackend.Load(pszPlugin))
+        {
+            printf("can't load the backend %s\n", pszPlugin);
+            return 1;
+        }
+        rgpBackends[cBackends++] = &pluginBackend;
+    }
+
+    // Noisy strokes of all the shapes
+    GesturePoint* pPoints = (GesturePoint*)malloc(cStrokes * BENCH_MAX_POINTS * sizeof(GesturePoint));
+    GestureStroke* pStrokes = (GestureStroke*)malloc(cStrokes * sizeof(GestureStroke));
+    int* piGestures = (int*)malloc(cStrokes * sizeof(int));
+    PERFTIME* pptLatencies = (PERFTIME*)malloc(cStrokes * sizeof(PERFTIME));
+    if (NULL == pPoints || NULL == pStrokes || NULL == piGestures || NULL == pptLatencies)
+    {
+        free(pPoints);
+        free(pStrokes);
+        free(piGestures);
+        free(pptLatencies);
+        return 1;
+    }
+    CSyntheticInk ink(5151, 2.5f);
+    int cShapes = CGestureEngine::GetBuiltinShapeCount();
+    for (int i = 0; i < cStrokes; i++)
+    {
+        pStrokes[i].ppt = pPoints + (size_t)i * BENCH_MAX_POINTS;
+        pStrokes[i].cPoints = ink.MakeStroke(i % cShapes, piGestures[i],
+                                             pPoints + (size_t)i * BENCH_MAX_POINTS, BENCH_MAX_POINTS);
+    }
+
+    // Every backend alone
+    printf("%12s %10s %12s\n", "backend", "correct", "us/stroke");
+    GestureResult rgResults[GE_NUM_SSGESTURES];
+    for (int b = 0; b < cBackends; b++)
+    {
+        int cCorrect = 0;
+        PERFTIME ptStart = PerfNow();
+        for (int i = 0; i < cStrokes; i++)
+        {
+            int cResults = rgpBackends[b]->Recognize(pStrokes[i].ppt, pStrokes[i].cPoints,
+                                                     rgResults, GE_NUM_SSGESTURES);
+            if (cResults > 0 && rgResults[0].iGesture == piGestures[i])
+                cCorrect++;
+        }
+        PERFTIME ptElapsed = PerfNow() - ptStart;
+        printf("%12s %9.1f%% %12.1f\n", rgpBackends[b]->GetName(), 100.0 * cCorrect / cStrokes,
+               ptElapsed / 1e3 / cStrokes);
+    }
+
+    EnsembleRun run;
+    run.pptLatencies = pptLatencies;
+    int iResult = 0;
+
+    // All of them together
+    CGestureEnsemble ensemble;
+    if (false == ensemble.Start(rgpBackends, NULL, cBackends))
+    {
+        iResult = 1;
+    }
+    else
+    {
+        RunEnsemble(ensemble, pStrokes, piGestures, cStrokes, iBudgetUs, run);
+        PrintEnsemble("ensemble", ensemble, rgpBackends, run, cStrokes);
+        ensemble.Stop();
+        if (false == CheckEnsemble("ensemble", run, cStrokes, iBudgetUs))
+            iResult = 1;
+    }
+
+    // With the template matcher missing the budget every 8th stroke, by
+    // far: the answers mustn't wait for it
+    int cDelayMs = 4 * iBudgetUs / 1000 + 10;
+    CSlowBackend slowBackend(templateBackend, 8, cDelayMs);
+    rgpBackends[0] = &slowBackend;
+    if (0 == iResult && false == ensemble.Start(rgpBackends, NULL, cBackends))
+        iResult = 1;
+    if (0 == iResult)
+    {
+        RunEnsemble(ensemble, pStrokes, piGestures, cStrokes, iBudgetUs, run);
+        PrintEnsemble("with a slow backend", ensemble, rgpBackends, run, cStrokes);
+        BackendStats stats;
+        ensemble.GetStats(0, stats);
+        ensemble.Stop();
+        if (run.pptLatencies[cStrokes - 1] >= (PERFTIME)cDelayMs * 1000000)
+        {
+            printf("an answer waited for the slow backend\n");
+            iResult = 1;
+        }
+        if (0 == stats.cLate)
+        {
+            printf("the slow backend's votes weren't dropped\n");
+            iResult = 1;
+        }
+        if (false == CheckEnsemble("with a slow backend", run, cStrokes, iBudgetUs))
+            iResult = 1;
+    }
+
+    free(pPoints);
+    free(pStrokes);
+    free(piGestures);
+    free(pptLatencies);
+    return iResult;
+}
+
+// The dispatch suite: the steps of a random session, and the bursts
+#define BENCH_DISPATCH_STEPS    200
+static const int gc_rgcBursts[] = { 1, 2, 4, 8, 16, 32 };
+
+/////////////////////////////////////////////////////////
+//
+// DrawGestureStroke
+//
+// Draws a synthetic stroke of a built-in shape into the
+// headless application, packet by packet, and recognizes
+// it; the gesture event is left to the caller.
+//
+// Return Values (int):
+//      the gesture recognized, -1 if unknown
+//
+/////////////////////////////////////////////////////////
+static int DrawGestureStroke(CHeadlessApp& app, CSyntheticInk& ink, int iShape)
+{
+    GesturePoint rgpt[BENCH_MAX_POINTS];
+    int iTruth;
+    int cPoints = ink.MakeStroke(iShape, iTruth, rgpt, countof(rgpt));
+    app.OnPenDown();
+    for (int i = 0; i < cPoints; i++)
+    {
+        app.OnPacket(rgpt[i].x, rgpt[i].y, (PERFTIME)i * BENCH_PACKET_TIME);
+    }
+    return app.RecognizeStroke();
+}
+
+// The state of the application the commands change, for the model of
+// the dispatch suite: the versions of the ink in the history, as ids
+// (0 is no ink), the guide, the ink and guide last sent to the
+// recognizer (-1 if cancelled), and a hash of the user commands run
+struct DispatchModel
+{
+    int         rgiVersions[BENCH_DISPATCH_STEPS + 1];
+    int         cVersions;
+    int         iCurrent;
+    int         iGuide;
+    int         iRecoInk;
+    int         iRecoGuide;
+    unsigned    uUserHash;
+};
+
+static void ModelReset(DispatchModel& model)
+{
+    model.rgiVersions[0] = 0;
+    model.cVersions = 1;
+    model.iCurrent = 0;
+    model.iGuide = GCMD_GUIDE_NONE;
+    model.iRecoInk = model.iRecoGuide = -1;
+    model.uUserHash = 0;
+}
+
+// Sends the ink to the recognizer, as Submit does, if there's any
+static void ModelSubmit(DispatchModel& model)
+{
+    if (0 != model.rgiVersions[model.iCurrent])
+    {
+        model.iRecoInk = model.rgiVersions[model.iCurrent];
+        model.iRecoGuide = model.iGuide;
+    }
+}
+
+// Makes a new version of the ink, as CInkHistory::Commit does
+static void ModelCommit(DispatchModel& model, int iInk)
+{
+    if (iInk == model.rgiVersions[model.iCurrent])
+        return;
+    model.cVersions = model.iCurrent + 1;
+    model.rgiVersions[model.cVersions++] = iInk;
+    model.iCurrent++;
+}
+
+/////////////////////////////////////////////////////////
+//
+// ModelRun
+//
+// Runs a command on the model as CAdvRecoApp's command
+// handlers do: OnClear, OnUndo (with ApplyHistory),
+// OnRecognize, OnGuide and any other command.
+//
+/////////////////////////////////////////////////////////
+static void ModelRun(DispatchModel& model, const GestureCommand& command)
+{
+    switch (command.iKind)
+    {
+        case GCMD_CLEAR:
+            ModelCommit(model, 0);
+            model.iRecoInk = model.iRecoGuide = -1;
+            break;
+
+        case GCMD_UNDO:
+        case GCMD_REDO:
+        {
+            int iCurrent = model.iCurrent + ((GCMD_UNDO == command.iKind) ? -1 : 1);
+            if (iCurrent < 0 || iCurrent >= model.cVersions)
+                break;
+            model.iCurrent = iCurrent;
+            if (0 != model.rgiVersions[iCurrent])
+                ModelSubmit(model);
+            else
+                model.iRecoInk = model.iRecoGuide = -1;
+            break;
+        }
+
+        case GCMD_RECOGNIZE:
+            ModelSubmit(model);
+            break;
+
+        case GCMD_GUIDE:
+            model.iGuide = command.iParam;
+            ModelSubmit(model);
+            break;
+
+        case GCMD_USER:
+            model.uUserHash = model.uUserHash * 31 + (unsigned)command.iParam;
+            break;
+    }
+}
+
+// Tells if two models are in the same state
+static bool ModelSame(const DispatchModel& model1, const DispatchModel& model2)
+{
+    return model1.cVersions == model2.cVersions
+        && model1.iCurrent == model2.iCurrent
+        && 0 == memcmp(model1.rgiVersions, model2.rgiVersions, model1.cVersions * sizeof(int))
+        && model1.iGuide == model2.iGuide
+        && model1.iRecoInk == model2.iRecoInk
+        && model1.iRecoGuide == model2.iRecoGuide
+        && model1.uUserHash == model2.uUserHash;
+}
+
+/////////////////////////////////////////////////////////
+//
+// BenchDispatch
+//
+// The commands of the gestures run through the command
+// queue against running them in the gesture event:
+//
+//  - the time the gesture event takes, with the default
+//    bindings (every gesture clears the ink), when it runs
+//    the clear and the repaint and when it posts them, and
+//    the time the posted commands take when they run;
+//  - bursts of gestures that come before the queue runs,
+//    as when the message loop is busy: the commands and
+//    the repaints that run, and the time of the burst;
+//  - random sessions of strokes and commands, posted and
+//    run now and then, against a model of the application
+//    that runs every command posted: the merged commands
+//    must leave the same ink, history, guide, recognition
+//    and user commands.
+//
+// Parameters:
+//     -n count : [in] the gestures of the first part and the
+//                sessions of the last, 500 by default
+//
+// Return Values (int):
+//      0 if succeeded, 1 if a result wasn't drawn, a burst wasn't
+//      merged or a session left a different state
+//
+/////////////////////////////////////////////////////////
+static int BenchDispatch(int argc, char** argv)
+{
+    int cGestures = 500;
+    for (int i = 0; i + 1 < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "-n"))
+            cGestures = atoi(argv[++i]);
+    }
+    if (cGestures <= 0)
+        return 1;
+
+    CGestureEngine engine;
+    engine.AddBuiltinTemplates();
+    CHeadlessApp app(engine);
+    if (false == app.Create())
+        return 1;
+    CSyntheticInk ink(6262);
+    int cShapes = CGestureEngine::GetBuiltinShapeCount();
+    int iResult = 0;
+
+    // The gesture event, running the commands or posting them
+    printf("%-24s %10s %10s %10s %12s\n", "gesture event", "p50 us", "p99 us", "max us",
+           "run us");
+    for (int iMode = 0; iMode < 2; iMode++)
+    {
+        bool bPosted = (1 == iMode);
+        CLatencyHistogram histEvent;
+        PERFTIME ptMax = 0, ptRun = 0;
+        int cNotDrawn = 0;
+        for (int i = 0; i < cGestures; i++)
+        {
+            int iGesture = DrawGestureStroke(app, ink, i % cShapes);
+            PERFTIME ptStart = PerfNow();
+            app.OnGesture(iGesture);
+            if (false == bPosted)
+                app.DispatchCommands();
+            PERFTIME ptEvent = PerfNow() - ptStart;
+            if (bPosted)
+            {
+                ptStart = PerfNow();
+                app.DispatchCommands();
+                ptRun += PerfNow() - ptStart;
+            }
+
+            if (false == app.IsGestureNameDrawn())
+                cNotDrawn++;
+            histEvent.Record(ptEvent);
+            if (ptEvent > ptMax)
+                ptMax = ptEvent;
+        }
+
+        HistogramSnapshot hist;
+        histEvent.Snapshot(hist);
+        printf("%-24s %10.2f %10.2f %10.2f ", bPosted ? "posting the command" : "running the command",
+               GetPercentileUpTo(hist, 50, ptMax) / 1e3, GetPercentileUpTo(hist, 99, ptMax) / 1e3,
+               ptMax / 1e3);
+        if (bPosted)
+            printf("%12.2f\n", ptRun / 1e3 / cGestures);
+        else
+            printf("%12s\n", "-");
+        if (cNotDrawn > 0)
+        {
+            printf("%d results weren't drawn\n", cNotDrawn);
+            iResult = 1;
+        }
+    }
+
+    // Bursts of gestures before the queue runs
+    printf("\n%8s %10s %10s %14s %14s\n", "burst", "commands", "paints", "in event us",
+           "posted us");
+    for (int b = 0; b < (int)countof(gc_rgcBursts); b++)
+    {
+        int cBurst = gc_rgcBursts[b];
+        PERFTIME rgptBurst[2] = { 0, 0 };
+        int rgcRun[2] = { 0, 0 };
+        int rgcPaints[2] = { 0, 0 };
+        for (int iMode = 0; iMode < 2; iMode++)
+        {
+            int cPaints = app.GetPaintCount();
+            for (int i = 0; i < cBurst; i++)
+            {
+                int iGesture = DrawGestureStroke(app, ink, (b + i) % cShapes);
+                PERFTIME ptStart = PerfNow();
+                app.OnGesture(iGesture);
+                if (0 == iMode)
+                    rgcRun[iMode] += app.DispatchCommands();
+                rgptBurst[iMode] += PerfNow() - ptStart;
+            }
+            if (1 == iMode)
+            {
+                PERFTIME ptStart = PerfNow();
+                rgcRun[iMode] += app.DispatchCommands();
+                rgptBurst[iMode] += PerfNow() - ptStart;
+            }
+            rgcPaints[iMode] = app.GetPaintCount() - cPaints;
+        }
+
+        printf("%8d %4d / %-3d %4d / %-3d %14.1f %14.1f\n", cBurst, rgcRun[1], rgcRun[0],
+               rgcPaints[1], rgcPaints[0], rgptBurst[0] / 1e3, rgptBurst[1] / 1e3);
+        if (1 != rgcRun[1] || 2 != rgcPaints[1] || false == app.IsGestureNameDrawn())
+        {
+            printf("a burst of %d clears wasn't merged into one clear and one paint\n", cBurst);
+            iResult = 1;
+        }
+    }
+
+    // Random sessions against the model that runs every command
+    DispatchModel* pMerged = (DispatchModel*)malloc(sizeof(DispatchModel));
+    DispatchModel* pModel = (DispatchModel*)malloc(sizeof(DispatchModel));
+    if (NULL == pMerged || NULL == pModel)
+    {
+        free(pMerged);
+        free(pModel);
+        return 1;
+    }
+    unsigned int uSeed = 4321;
+    long cPosted = 0, cMerged = 0;
+    int cWrong = 0;
+    for (int s = 0; s < cGestures; s++)
+    {
+        CCommandQueue queue;
+        GestureCommand rgPosted[BENCH_DISPATCH_STEPS];
+        GestureCommand rgTaken[GCMD_MAX_QUEUED];
+        int cInQueue = 0;
+        int iNextInk = 1;
+        bool bWrong = false;
+        ModelReset(*pMerged);
+        ModelReset(*pModel);
+        for (int step = 0; step <= BENCH_DISPATCH_STEPS && false == bWrong; step++)
+        {
+            uSeed = uSeed * 1103515245 + 12345;
+            int iRandom = (int)((uSeed >> 16) % 100);
+            GestureCommand command = { GCMD_NONE, 0 };
+            if (step < BENCH_DISPATCH_STEPS && iRandom < 70)
+            {
+                command.iKind = 1 + (int)((uSeed >> 8) % (GCMD_NUM_KINDS - 1));
+                command.iParam = (GCMD_GUIDE == command.iKind) ? (int)((uSeed >> 4) % 3)
+                               : (GCMD_USER == command.iKind) ? 1 + (int)((uSeed >> 4) % 3) : 0;
+            }
+            else if (step < BENCH_DISPATCH_STEPS && iRandom < 90)
+            {
+                // A stroke is written while the commands wait
+                for (int m = 0; m < 2; m++)
+                {
+                    DispatchModel& model = (0 == m) ? *pMerged : *pModel;
+                    ModelCommit(model, iNextInk);
+                    ModelSubmit(model);
+                }
+                iNextInk++;
+                continue;
+            }
+
+            // The queue runs: at the end of the session, now and then,
+            // and when it's full
+            bool bFull = (GCMD_NONE != command.iKind && false == queue.Post(command));
+            if (GCMD_NONE == command.iKind || bFull)
+            {
+                int cTaken = queue.Take(rgTaken, countof(rgTaken));
+                for (int i = 0; i < cTaken; i++)
+                    ModelRun(*pMerged, rgTaken[i]);
+                for (int i = 0; i < cInQueue; i++)
+                    ModelRun(*pModel, rgPosted[i]);
+                cInQueue = 0;
+                bWrong = (false == ModelSame(*pMerged, *pModel));
+            }
+            if (bFull)
+                queue.Post(command);
+            if (GCMD_NONE != command.iKind)
+                rgPosted[cInQueue++] = command;
+        }
+        if (bWrong)
+            cWrong++;
+        cPosted += queue.GetPostedCount();
+        cMerged += queue.GetMergedCount();
+    }
+    free(pMerged);
+    free(pModel);
+
+    printf("\n%d random sessions: %ld commands posted, %.1f%% merged, %d left a different state\n",
+           cGestures, cPosted, 100.0 * cMerged / cPosted, cWrong);
+    if (cWrong > 0)
+        iResult = 1;
+
+    return iResult;
+}
+
+static const BenchSuite gc_rgSuites[] = {
+    { "index", BenchIndex, "template index recall and latency, 36 to 100k templates" },
+    { "startup", BenchStartup, "engine startup from raw templates vs. a mapped pack" },
+    { "quant", BenchQuant, "float16 and int8 template storage against float32" },
+    { "fixed", BenchFixed, "fixed point engine speed and cross-check against float" },
+    { "trace", BenchTrace, "cost of the trace points, disabled and enabled" },
+    { "micro", BenchMicro, "ns/op and allocs/op of each recognition step, baseline gate" },
+    { "e2e", BenchEndToEnd, "pen up to result pixel latency per gesture, headless" },
+    { "reco", BenchBackgroundReco, "background recognition debounce, cancellation, delivery" },
+    { "guide", BenchGuidedReco, "guide segmentation and parallel recognition of the cells" },
+    { "wordlist", BenchWordList, "word list size, mapping and lookup, factoids, lattice search" },
+    { "decimate", BenchDecimate, "stroke decimation: compression, error bound, recognition impact" },
+    { "devices", BenchDevices, "input stage: frame coalescing and resampling by pen packet rate" },
+    { "predict", BenchPredict, "stroke prediction: error of the predicted pen tip by lookahead and pen" },
+    { "inkcodec", BenchInkCodec, "ink archive size against raw, varints and zlib, coding speed, random access" },
+    { "history", BenchHistory, "undo history: edit, snapshot and undo cost, memory, random session" },
+    { "canvas", BenchCanvas, "tiled canvas: frame times of pan and zoom over 100k strokes, exactness" },
+    { "layers", BenchLayers, "ink layers: paint cost per packet against a repaint, by committed ink" },
+    { "batch", BenchBatch, "batched recognition against one stroke at a time, exactness" },
+    { "config", BenchConfig, "configuration snapshots: changes under concurrent readers, reclamation" },
+    { "ensemble", BenchEnsemble, "recognizer ensemble: accuracy of the backends and fused, deadlines" },
+    { "dispatch", BenchDispatch, "gesture commands: event time, posted against run, merging, model check" },
+};
+
+int main(int argc, char** argv)
+{
+    if (argc >= 2)
+    {
+        for (int i = 0; i < (int)countof(gc_rgSuites); i++)
+        {
+            if (0 == strcmp(argv[1], gc_rgSuites[i].pszName))
+                return gc_rgSuites[i].pfnRun(argc - 2, argv + 2);
+        }
+    }
+
+    printf("usage: GestureBench <suite> [options]\n\nsuites:\n");
+    for (int i = 0; i < (int)countof(gc_rgSuites); i++)
+    {
+        printf("  %-12s %s\n", gc_rgSuites[i].pszName, gc_rgSuites[i].pszDescription);
+    }
+    return 1;
+}
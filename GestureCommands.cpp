@@ -0,0 +1,353 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      GestureCommands.cpp
+//
+// Description:
+//      The file contains the definitions of the methods of the classes
+//      CGestureBindings and CCommandQueue. See the file GestureCommands.h
+//      for the definitions of the classes.
+//--------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "GestureCommands.h"
+
+// A useful macro to determine the number of elements in the array
+#ifndef countof
+#define countof(array)  (sizeof(array)/sizeof(array[0]))
+#endif
+
+// The names of the commands, indexed by the GCMD_ kinds, and of the guides
+static const char* const gc_pszCommands[GCMD_NUM_KINDS] = {
+    "none", "clear", "undo", "redo", "recognize", "guide", "command"
+};
+static const char* const gc_pszGuides[] = { "none", "lines", "boxes" };
+
+// Bindings /////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////
+//
+// CGestureBindings::CGestureBindings
+//
+// Constructor. Every gesture clears the ink.
+//
+/////////////////////////////////////////////////////////
+CGestureBindings::CGestureBindings()
+{
+    for (int i = 0; i < GE_NUM_SSGESTURES; i++)
+    {
+        m_rgCommands[i].iKind = GCMD_CLEAR;
+        m_rgCommands[i].iParam = 0;
+    }
+}
+
+void CGestureBindings::Bind(int iGesture, const GestureCommand& command)
+{
+    if (iGesture >= 0 && iGesture < GE_NUM_SSGESTURES)
+        m_rgCommands[iGesture] = command;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureBindings::GetCommand
+//
+// Returns the command of a gesture; an unknown gesture
+// (-1) has none.
+//
+/////////////////////////////////////////////////////////
+GestureCommand CGestureBindings::GetCommand(int iGesture) const
+{
+    if (iGesture < 0 || iGesture >= GE_NUM_SSGESTURES)
+    {
+        GestureCommand none = { GCMD_NONE, 0 };
+        return none;
+    }
+    return m_rgCommands[iGesture];
+}
+
+// Trims the blanks and the line end off both ends of a string, in place
+static char* Trim(char* psz)
+{
+    while (' ' == *psz || '\t' == *psz)
+        psz++;
+    size_t cch = strlen(psz);
+    while (cch > 0 && (' ' == psz[cch - 1] || '\t' == psz[cch - 1]
+                       || '\n' == psz[cch - 1] || '\r' == psz[cch - 1]))
+    {
+        psz[--cch] = '\0';
+    }
+    return psz;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureBindings::Load
+//
+// Reads the bindings from a text file (see GestureCommands.h
+// for the format) over the current ones. The lines are
+// applied in order, so "* = none" and then a few bindings
+// leave the other gestures alone. Nothing is changed if
+// the file has a bad line.
+//
+// Parameters:
+//     const char* pszFileName : [in] the bindings file
+//     int* piBadLine          : [out] the number of the bad line, from
+//                               1, or 0 if the file can't be read;
+//                               may be NULL
+//
+// Return Values (bool):
+//      true if succeeded, false otherwise
+//
+/////////////////////////////////////////////////////////
+bool CGestureBindings::Load(const char* pszFileName, int* piBadLine)
+{
+    if (NULL != piBadLine)
+        *piBadLine = 0;
+
+    FILE* pFile = fopen(pszFileName, "r");
+    if (NULL == pFile)
+        return false;
+
+    GestureCommand rgCommands[GE_NUM_SSGESTURES];
+    memcpy(rgCommands, m_rgCommands, sizeof(rgCommands));
+
+    char szLine[256];
+    int iLine = 0;
+    bool bOk = true;
+    while (bOk && NULL != fgets(szLine, sizeof(szLine), pFile))
+    {
+        iLine++;
+        char* pszGesture = Trim(szLine);
+        if ('\0' == *pszGesture || '#' == *pszGesture)
+            continue;
+
+        char* pszEquals = strchr(pszGesture, '=');
+        GestureCommand command;
+        bOk = (NULL != pszEquals);
+        if (bOk)
+        {
+            *pszEquals = '\0';
+            pszGesture = Trim(pszGesture);
+            bOk = ParseCommand(Trim(pszEquals + 1), command);
+        }
+        if (bOk && 0 == strcmp(pszGesture, "*"))
+        {
+            for (int i = 0; i < GE_NUM_SSGESTURES; i++)
+                rgCommands[i] = command;
+        }
+        else if (bOk)
+        {
+            int iGesture = 0;
+            while (iGesture < GE_NUM_SSGESTURES
+                   && 0 != strcmp(pszGesture, CGestureEngine::GetGestureName(iGesture)))
+            {
+                iGesture++;
+            }
+            bOk = (iGesture < GE_NUM_SSGESTURES);
+            if (bOk)
+                rgCommands[iGesture] = command;
+        }
+    }
+    fclose(pFile);
+
+    if (false == bOk)
+    {
+        if (NULL != piBadLine)
+            *piBadLine = iLine;
+        return false;
+    }
+    memcpy(m_rgCommands, rgCommands, sizeof(m_rgCommands));
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureBindings::ParseCommand
+//
+// Reads a command from its text: one of the names of the
+// commands, the guide's name after guide, the id after
+// command.
+//
+// Parameters:
+//     const char* pszText     : [in] the text, without blanks around it
+//     GestureCommand& command : [out] the command
+//
+// Return Values (bool):
+//      true if succeeded, false if the text isn't a command
+//
+/////////////////////////////////////////////////////////
+bool CGestureBindings::ParseCommand(const char* pszText, GestureCommand& command)
+{
+    command.iParam = 0;
+    for (int iKind = 0; iKind < GCMD_NUM_KINDS; iKind++)
+    {
+        size_t cch = strlen(gc_pszCommands[iKind]);
+        if (0 != strncmp(pszText, gc_pszCommands[iKind], cch))
+            continue;
+        const char* pszParam = pszText + cch;
+        command.iKind = iKind;
+
+        if (GCMD_GUIDE == iKind)
+        {
+            while (' ' == *pszParam || '\t' == *pszParam)
+                pszParam++;
+            for (int i = 0; i < (int)countof(gc_pszGuides); i++)
+            {
+                if (0 == strcmp(pszParam, gc_pszGuides[i]))
+                {
+                    command.iParam = i;
+                    return true;
+                }
+            }
+            return false;
+        }
+        if (GCMD_USER == iKind)
+        {
+            char* pszEnd;
+            long lId = strtol(pszParam, &pszEnd, 10);
+            if (pszEnd == pszParam || '\0' != *pszEnd || lId <= 0 || lId > 0xFFFF)
+                return false;
+            command.iParam = (int)lId;
+            return true;
+        }
+        return '\0' == *pszParam;
+    }
+    return false;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureBindings::FormatCommand
+//
+// Writes the text of a command, as ParseCommand reads it.
+//
+/////////////////////////////////////////////////////////
+void CGestureBindings::FormatCommand(const GestureCommand& command, char* pszText, int cchText)
+{
+    if (command.iKind < 0 || command.iKind >= GCMD_NUM_KINDS)
+        snprintf(pszText, cchText, "?");
+    else if (GCMD_GUIDE == command.iKind && command.iParam >= 0
+             && command.iParam < (int)countof(gc_pszGuides))
+        snprintf(pszText, cchText, "guide %s", gc_pszGuides[command.iParam]);
+    else if (GCMD_USER == command.iKind)
+        snprintf(pszText, cchText, "command %d", command.iParam);
+    else
+        snprintf(pszText, cchText, "%s", gc_pszCommands[command.iKind]);
+}
+
+// Queue ////////////////////////////////////////////////
+
+void CCommandQueue::Remove(int iCommand)
+{
+    memmove(&m_rgQueue[iCommand], &m_rgQueue[iCommand + 1],
+            (m_cQueued - iCommand - 1) * sizeof(GestureCommand));
+    m_cQueued--;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CCommandQueue::Post
+//
+// Queues a command, merging it with the ones queued (see
+// GestureCommands.h): a clear drops the recognitions and
+// is merged into a clear at the end of the queue; a guide
+// switch drops the recognitions and replaces a guide
+// switch at the end; a recognition drops the ones before
+// it, and is merged into a clear or a guide switch at the
+// end. GCMD_NONE is ignored.
+//
+// Parameters:
+//     const GestureCommand& command : [in] the command
+//
+// Return Values (bool):
+//      true if succeeded, false if the queue is full: the command
+//      isn't posted, and the caller runs the queue first
+//
+/////////////////////////////////////////////////////////
+bool CCommandQueue::Post(const GestureCommand& command)
+{
+    if (GCMD_NONE == command.iKind)
+        return true;
+
+    // The recognitions the new command recognizes the ink again for
+    if (GCMD_CLEAR == command.iKind || GCMD_GUIDE == command.iKind
+        || GCMD_RECOGNIZE == command.iKind)
+    {
+        for (int i = m_cQueued - 1; i >= 0; i--)
+        {
+            if (GCMD_RECOGNIZE == m_rgQueue[i].iKind)
+            {
+                Remove(i);
+                m_cMerged++;
+            }
+        }
+    }
+
+    // The command at the end of the queue already does it
+    if (m_cQueued > 0)
+    {
+        GestureCommand& last = m_rgQueue[m_cQueued - 1];
+        bool bMerged = false;
+        switch (command.iKind)
+        {
+            case GCMD_CLEAR:
+                bMerged = (GCMD_CLEAR == last.iKind);
+                break;
+            case GCMD_GUIDE:
+                bMerged = (GCMD_GUIDE == last.iKind);
+                if (bMerged)
+                    last.iParam = command.iParam;
+                break;
+            case GCMD_RECOGNIZE:
+                bMerged = (GCMD_CLEAR == last.iKind || GCMD_GUIDE == last.iKind);
+                break;
+        }
+        if (bMerged)
+        {
+            m_cPosted++;
+            m_cMerged++;
+            return true;
+        }
+    }
+
+    if (GCMD_MAX_QUEUED == m_cQueued)
+        return false;
+    m_rgQueue[m_cQueued++] = command;
+    m_cPosted++;
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CCommandQueue::Take
+//
+// Takes the commands queued, in order, to run them; the
+// queue is empty after it. The commands posted while they
+// run are taken the next time.
+//
+// Parameters:
+//     GestureCommand* pCommands : [out] the commands
+//     int cMaxCommands          : [in] the size of pCommands, up to
+//                                 GCMD_MAX_QUEUED
+//
+// Return Values (int):
+//      the number of the commands
+//
+/////////////////////////////////////////////////////////
+int CCommandQueue::Take(GestureCommand* pCommands, int cMaxCommands)
+{
+    int cCommands = (m_cQueued < cMaxCommands) ? m_cQueued : cMaxCommands;
+    memcpy(pCommands, m_rgQueue, cCommands * sizeof(GestureCommand));
+    if (cCommands < m_cQueued)
+        memmove(m_rgQueue, m_rgQueue + cCommands, (m_cQueued - cCommands) * sizeof(GestureCommand));
+    m_cQueued -= cCommands;
+    return cCommands;
+}
@@ -0,0 +1,133 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      GestureCommands.h
+//
+// Description:
+//      This file contains the definitions of the CGestureBindings class,
+//      the table of the command each gesture runs, and of the
+//      CCommandQueue class, which takes the commands out of the gesture
+//      event: the event handler posts the command and returns, and the
+//      commands run a moment later, from the message loop, as the ink
+//      is then.
+//
+//      A command that would be undone or redone by a later one in the
+//      queue is dropped or merged as it's posted: a clear after a clear
+//      is one clear, and a recognition is dropped by a later clear,
+//      recognition or guide switch, which recognize the ink again or
+//      have nothing left to recognize. A guide switch replaces one just
+//      before it. Undo, redo and the user commands run one for one.
+//
+//      The bindings are read from a text file, a line per binding:
+//
+//          <gesture name> = <command>
+//
+//      where the gesture name is one of CGestureEngine::GetGestureName's,
+//      or * for all of them, and the command is one of none, clear,
+//      undo, redo, recognize, guide none, guide lines, guide boxes and
+//      command <id>, which sends the WM_COMMAND of that id. The lines
+//      that begin with # are comments. Every gesture runs clear until
+//      it's bound otherwise, as the application always did.
+//
+//      The methods of the classes are defined in the GestureCommands.cpp
+//      file.
+//--------------------------------------------------------------------------
+
+#pragma once
+
+#include "GestureEngine.h"
+
+enum {
+    // The kinds of the commands
+    GCMD_NONE = 0,
+    GCMD_CLEAR,
+    GCMD_UNDO,
+    GCMD_REDO,
+    GCMD_RECOGNIZE,
+    GCMD_GUIDE,                 // iParam is GCMD_GUIDE_NONE, _LINES or _BOXES
+    GCMD_USER,                  // iParam is the id of a WM_COMMAND
+    GCMD_NUM_KINDS,
+
+    // The guides of GCMD_GUIDE, in the order of ID_GUIDE_NONE to ID_GUIDE_BOXES
+    GCMD_GUIDE_NONE = 0,
+    GCMD_GUIDE_LINES = 1,
+    GCMD_GUIDE_BOXES = 2,
+
+    GCMD_MAX_QUEUED = 64        // the commands a queue holds
+};
+
+// A command: what it does, and what to
+struct GestureCommand
+{
+    int     iKind;
+    int     iParam;
+};
+
+/////////////////////////////////////////////////////////
+//
+// class CGestureBindings
+//
+// The command of every gesture, by the index of the
+// gesture (the order of gc_igtSingleStrokeGestures).
+//
+/////////////////////////////////////////////////////////
+
+class CGestureBindings
+{
+    GestureCommand  m_rgCommands[GE_NUM_SSGESTURES];
+
+public:
+
+    // Constructor, binds every gesture to clear
+    CGestureBindings();
+
+    void Bind(int iGesture, const GestureCommand& command);
+    GestureCommand GetCommand(int iGesture) const;
+
+    // The bindings file
+    bool Load(const char* pszFileName, int* piBadLine);
+
+    // The text of a command, and back
+    static bool ParseCommand(const char* pszText, GestureCommand& command);
+    static void FormatCommand(const GestureCommand& command, char* pszText, int cchText);
+};
+
+/////////////////////////////////////////////////////////
+//
+// class CCommandQueue
+//
+// The commands posted and not run yet, in order. Posted
+// to and taken from by one thread, the window's.
+//
+/////////////////////////////////////////////////////////
+
+class CCommandQueue
+{
+    GestureCommand  m_rgQueue[GCMD_MAX_QUEUED];
+    int             m_cQueued;
+    long            m_cPosted;          // all the commands posted
+    long            m_cMerged;          // the ones merged or dropped
+
+public:
+
+    // Constructor
+    CCommandQueue() : m_cQueued(0), m_cPosted(0), m_cMerged(0) {}
+
+    bool Post(const GestureCommand& command);
+    int  Take(GestureCommand* pCommands, int cMaxCommands);
+
+    // Data members access methods
+    bool IsEmpty() const { return 0 == m_cQueued; }
+    int  GetQueuedCount() const { return m_cQueued; }
+    long GetPostedCount() const { return m_cPosted; }
+    long GetMergedCount() const { return m_cMerged; }
+
+private:
+
+    void Remove(int iCommand);
+};
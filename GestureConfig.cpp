@@ -0,0 +1,511 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      GestureConfig.cpp
+//
+// Description:
+//      The file contains the definitions of the methods of the class
+//      CGestureConfig. See the file GestureConfig.h for the definition
+//      of the class.
+//--------------------------------------------------------------------------
+
+#include <stdlib.h>
+
+#include "GestureConfig.h"
+#include "Trace.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#define GC_CACHE_LINE   64
+
+// A hazard pointer: the snapshot a reader uses, NULL if the slot is
+// free. The slots are a cache line apart, so the readers
+// don't write to each other's lines
+struct ConfigSlot
+{
+    GestureSnapshot* volatile   pSnapshot;
+    unsigned char               rgbPad[GC_CACHE_LINE - sizeof(GestureSnapshot*)];
+};
+
+// The writers' lock
+struct ConfigLock
+{
+#ifdef _WIN32
+    CRITICAL_SECTION    cs;
+#else
+    pthread_mutex_t     mutex;
+#endif
+};
+
+static inline GestureSnapshot* LoadAcquire(GestureSnapshot* volatile* pp)
+{
+#ifdef _WIN32
+    return *pp;                 // volatile reads acquire with /volatile:ms
+#else
+    return __atomic_load_n(pp, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static inline void StoreRelease(GestureSnapshot* volatile* pp, GestureSnapshot* p)
+{
+#ifdef _WIN32
+    *pp = p;                    // volatile writes release with /volatile:ms
+#else
+    __atomic_store_n(pp, p, __ATOMIC_RELEASE);
+#endif
+}
+
+// Replaces a pointer, a full barrier
+static inline GestureSnapshot* Exchange(GestureSnapshot* volatile* pp, GestureSnapshot* p)
+{
+#ifdef _WIN32
+    return (GestureSnapshot*)::InterlockedExchangePointer((PVOID volatile*)pp, p);
+#else
+    return __atomic_exchange_n(pp, p, __ATOMIC_SEQ_CST);
+#endif
+}
+
+// Claims a free slot for a snapshot, a full barrier
+static inline bool ClaimSlot(ConfigSlot* pSlot, GestureSnapshot* p)
+{
+#ifdef _WIN32
+    return (NULL == ::InterlockedCompareExchangePointer(
+                        (PVOID volatile*)&pSlot->pSnapshot, p, NULL));
+#else
+    return __sync_bool_compare_and_swap(&pSlot->pSnapshot, (GestureSnapshot*)NULL, p);
+#endif
+}
+
+// Counts an event, from any thread
+static inline void Increment(volatile long* pl)
+{
+#ifdef _WIN32
+    ::InterlockedIncrement(pl);
+#else
+    __sync_add_and_fetch(pl, 1);
+#endif
+}
+
+static inline void FullBarrier()
+{
+#ifdef _WIN32
+    ::MemoryBarrier();
+#else
+    __sync_synchronize();
+#endif
+}
+
+static void LockInit(ConfigLock* pLock)
+{
+#ifdef _WIN32
+    ::InitializeCriticalSection(&pLock->cs);
+#else
+    pthread_mutex_init(&pLock->mutex, NULL);
+#endif
+}
+
+static void LockTerm(ConfigLock* pLock)
+{
+#ifdef _WIN32
+    ::DeleteCriticalSection(&pLock->cs);
+#else
+    pthread_mutex_destroy(&pLock->mutex);
+#endif
+}
+
+static void Lock(ConfigLock* pLock)
+{
+#ifdef _WIN32
+    ::EnterCriticalSection(&pLock->cs);
+#else
+    pthread_mutex_lock(&pLock->mutex);
+#endif
+}
+
+static void Unlock(ConfigLock* pLock)
+{
+#ifdef _WIN32
+    ::LeaveCriticalSection(&pLock->cs);
+#else
+    pthread_mutex_unlock(&pLock->mutex);
+#endif
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureConfig::CGestureConfig
+//
+// Constructor. The configuration is empty until Create.
+//
+/////////////////////////////////////////////////////////
+CGestureConfig::CGestureConfig()
+    : m_pCurrent(NULL), m_pSlots(NULL), m_pLock(NULL), m_pUpdate(NULL),
+      m_pRetired(NULL), m_cRetired(0), m_lVersion(0), m_cFullFailures(0)
+{
+    m_pSlots = (ConfigSlot*)calloc(GC_MAX_READERS, sizeof(ConfigSlot));
+    m_pLock = (ConfigLock*)malloc(sizeof(ConfigLock));
+    if (NULL != m_pLock)
+        LockInit(m_pLock);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureConfig::~CGestureConfig
+//
+// Destructor. No reader may hold a snapshot any more.
+//
+/////////////////////////////////////////////////////////
+CGestureConfig::~CGestureConfig()
+{
+    delete m_pUpdate;
+    delete m_pCurrent;
+    while (NULL != m_pRetired)
+    {
+        GestureSnapshot* pNext = m_pRetired->pNextRetired;
+        delete m_pRetired;
+        m_pRetired = pNext;
+    }
+    if (NULL != m_pLock)
+    {
+        LockTerm(m_pLock);
+        free(m_pLock);
+    }
+    free(m_pSlots);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureConfig::Create
+//
+// Publishes the first snapshot, a copy of an engine, or
+// replaces the current one with it.
+//
+// Parameters:
+//     const CGestureEngine& engine : [in] the templates and the
+//                                    settings to recognize with
+//
+// Return Values (bool):
+//      true if succeeded, false if out of memory
+//
+/////////////////////////////////////////////////////////
+bool CGestureConfig::Create(
+        const CGestureEngine& engine
+        )
+{
+    CGestureEngine* pEngine = BeginUpdate();
+    if (NULL == pEngine)
+        return false;
+    if (false == pEngine->Copy(engine))
+    {
+        Abort();
+        return false;
+    }
+    return Commit();
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureConfig::Acquire
+//
+// Pins the current snapshot: claims a hazard pointer with
+// the snapshot, one interlocked operation, and checks the
+// snapshot is still the current one, so a writer that
+// replaces it afterwards sees the pointer and keeps the
+// snapshot. Lock free; the retry happens only if a change
+// is published in between.
+//
+// Parameters:
+//     int& iSlot   : [in/out] the slot tried first, the slot of the
+//                    last Acquire on this thread works best, or -1;
+//                    the slot to give to Release
+//
+// Return Values (const GestureSnapshot*):
+//      the snapshot, unchanged until Release, or NULL if there's
+//      none or GC_MAX_READERS are pinned already; the latter is
+//      counted, see GetFullFailureCount
+//
+/////////////////////////////////////////////////////////
+const GestureSnapshot* CGestureConfig::Acquire(
+        int& iSlot
+        )
+{
+    GestureSnapshot* pSnapshot = LoadAcquire(&m_pCurrent);
+    if (NULL == m_pSlots || NULL == pSnapshot)
+    {
+        iSlot = -1;
+        return NULL;
+    }
+
+    int iStart = (iSlot >= 0 && iSlot < GC_MAX_READERS) ? iSlot : 0;
+    ConfigSlot* pSlot = NULL;
+    for (int i = 0; i < GC_MAX_READERS; i++)
+    {
+        int iTry = (iStart + i) % GC_MAX_READERS;
+        if (NULL == m_pSlots[iTry].pSnapshot && ClaimSlot(&m_pSlots[iTry], pSnapshot))
+        {
+            pSlot = &m_pSlots[iTry];
+            iSlot = iTry;
+            break;
+        }
+    }
+    if (NULL == pSlot)
+    {
+        Increment(&m_cFullFailures);
+        iSlot = -1;
+        return NULL;
+    }
+
+    for (;;)
+    {
+        GestureSnapshot* pCurrent = LoadAcquire(&m_pCurrent);
+        if (pCurrent == pSnapshot)
+            return pSnapshot;
+        pSnapshot = pCurrent;
+        Exchange(&pSlot->pSnapshot, pSnapshot);
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureConfig::Release
+//
+// Unpins the snapshot of Acquire and frees its slot. The
+// snapshot mustn't be used after.
+//
+// Parameters:
+//     int iSlot    : [in] the slot of Acquire
+//
+/////////////////////////////////////////////////////////
+void CGestureConfig::Release(
+        int iSlot
+        )
+{
+    if (iSlot >= 0 && iSlot < GC_MAX_READERS && NULL != m_pSlots)
+        StoreRelease(&m_pSlots[iSlot].pSnapshot, NULL);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureConfig::BeginUpdate
+//
+// Starts a change: takes the writers' lock and returns a
+// private copy of the current configuration to change. The
+// readers don't see the copy until Commit.
+//
+// Return Values (CGestureEngine*):
+//      the copy to change, or NULL if out of memory
+//
+/////////////////////////////////////////////////////////
+CGestureEngine* CGestureConfig::BeginUpdate()
+{
+    if (NULL == m_pLock)
+        return NULL;
+    Lock(m_pLock);
+
+    // Only the writers free the snapshots, so the current one stays
+    // while the lock is held
+    m_pUpdate = new GestureSnapshot;
+    m_pUpdate->lVersion = 0;
+    m_pUpdate->pNextRetired = NULL;
+    if (NULL != m_pCurrent && false == m_pUpdate->engine.Copy(m_pCurrent->engine))
+    {
+        delete m_pUpdate;
+        m_pUpdate = NULL;
+        Unlock(m_pLock);
+        return NULL;
+    }
+    return &m_pUpdate->engine;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureConfig::Commit
+//
+// Publishes the change of BeginUpdate, retires the snapshot
+// it replaces and frees the retired snapshots no reader
+// holds any more.
+//
+// Return Values (bool):
+//      true if published, false if no change was begun
+//
+/////////////////////////////////////////////////////////
+bool CGestureConfig::Commit()
+{
+    if (NULL == m_pUpdate)
+        return false;
+
+    TRACE_SCOPE("Commit configuration");
+    GestureSnapshot* pUpdate = m_pUpdate;
+    m_pUpdate = NULL;
+    pUpdate->lVersion = m_lVersion + 1;
+    GestureSnapshot* pOld = Exchange(&m_pCurrent, pUpdate);
+    m_lVersion = pUpdate->lVersion;
+    if (NULL != pOld)
+    {
+        pOld->pNextRetired = m_pRetired;
+        m_pRetired = pOld;
+        m_cRetired++;
+    }
+    Reclaim();
+    Unlock(m_pLock);
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureConfig::Abort
+//
+// Drops the change of BeginUpdate.
+//
+/////////////////////////////////////////////////////////
+void CGestureConfig::Abort()
+{
+    if (NULL == m_pUpdate)
+        return;
+    delete m_pUpdate;
+    m_pUpdate = NULL;
+    Unlock(m_pLock);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureConfig::SetGestureEnabled
+//
+// Enables or disables the recognition of a gesture.
+//
+// Parameters:
+//     int iGesture     : [in] index into the single stroke gesture table
+//     bool bEnabled    : [in] true to recognize the gesture
+//
+// Return Values (bool):
+//      true if succeeded, false if the gesture is invalid or
+//      out of memory
+//
+/////////////////////////////////////////////////////////
+bool CGestureConfig::SetGestureEnabled(
+        int iGesture,
+        bool bEnabled
+        )
+{
+    if (iGesture < 0 || iGesture >= GE_NUM_SSGESTURES)
+        return false;
+    CGestureEngine* pEngine = BeginUpdate();
+    if (NULL == pEngine)
+        return false;
+    unsigned long long ullBit = 1ULL << iGesture;
+    pEngine->SetGestureMask(bEnabled ? (pEngine->GetGestureMask() | ullBit)
+                                     : (pEngine->GetGestureMask() & ~ullBit));
+    return Commit();
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureConfig::SetGestureMask
+//
+// Sets the gestures recognized, all at once.
+//
+// Parameters:
+//     unsigned long long ullGestures : [in] a bit per gesture
+//
+// Return Values (bool):
+//      true if succeeded, false if out of memory
+//
+/////////////////////////////////////////////////////////
+bool CGestureConfig::SetGestureMask(
+        unsigned long long ullGestures
+        )
+{
+    CGestureEngine* pEngine = BeginUpdate();
+    if (NULL == pEngine)
+        return false;
+    pEngine->SetGestureMask(ullGestures);
+    return Commit();
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureConfig::AddTemplate
+//
+// Adds a template, a user's, and rebuilds the index if the
+// configuration has one.
+//
+// Parameters:
+//     int iGesture            : [in] index into the single stroke gesture table
+//     const GesturePoint* ppt : [in] the stroke points
+//     int cPoints             : [in] the number of points
+//
+// Return Values (bool):
+//      true if succeeded, false if the parameters are invalid,
+//      the templates are a read-only pack's, or out of memory
+//
+/////////////////////////////////////////////////////////
+bool CGestureConfig::AddTemplate(
+        int iGesture,
+        const GesturePoint* ppt,
+        int cPoints
+        )
+{
+    CGestureEngine* pEngine = BeginUpdate();
+    if (NULL == pEngine)
+        return false;
+    bool bIndexed = (false == pEngine->GetIndex().IsEmpty());
+    if (false == pEngine->AddTemplate(iGesture, ppt, cPoints) ||
+        (bIndexed && false == pEngine->BuildIndex()))
+    {
+        Abort();
+        return false;
+    }
+    return Commit();
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureConfig::Reclaim
+//
+// Frees the retired snapshots no hazard pointer holds. A
+// reader that pins one after the scan has seen it's no
+// longer current and tries again, so a snapshot missing
+// from the scan is never used again. Called with the lock.
+//
+/////////////////////////////////////////////////////////
+void CGestureConfig::Reclaim()
+{
+    GestureSnapshot* rgpPinned[GC_MAX_READERS];
+    int cPinned = 0;
+    FullBarrier();
+    for (int i = 0; i < GC_MAX_READERS; i++)
+    {
+        GestureSnapshot* p = LoadAcquire(&m_pSlots[i].pSnapshot);
+        if (NULL != p)
+            rgpPinned[cPinned++] = p;
+    }
+
+    GestureSnapshot** ppRetired = &m_pRetired;
+    while (NULL != *ppRetired)
+    {
+        GestureSnapshot* pRetired = *ppRetired;
+        bool bPinned = false;
+        for (int i = 0; i < cPinned && false == bPinned; i++)
+            bPinned = (rgpPinned[i] == pRetired);
+        if (bPinned)
+        {
+            ppRetired = &pRetired->pNextRetired;
+            continue;
+        }
+        *ppRetired = pRetired->pNextRetired;
+        delete pRetired;
+        m_cRetired--;
+    }
+}
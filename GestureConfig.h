@@ -0,0 +1,104 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      GestureConfig.h
+//
+// Description:
+//      This file contains the definition of the CGestureConfig class, the
+//      recognizer configuration the application changes while other
+//      threads recognize with it: the templates, the enabled gestures
+//      and the thresholds, all held by a CGestureEngine.
+//
+//      The configuration is a series of immutable snapshots. A change
+//      copies the current snapshot, changes the copy and publishes it
+//      with one atomic exchange, so a recognition sees a configuration
+//      entirely before or entirely after a change. A reader pins the
+//      current snapshot with a hazard pointer, a slot it claims and
+//      writes, and never takes a lock or waits for a writer. A snapshot
+//      that's replaced is retired, and freed by a later change once no
+//      hazard pointer holds it.
+//
+//      The methods of the class are defined in the GestureConfig.cpp
+//      file.
+//--------------------------------------------------------------------------
+
+#pragma once
+
+#include "GestureEngine.h"
+
+enum {
+    GC_MAX_READERS = 64         // the snapshots pinned at once, at most
+};
+
+// A configuration. Never changed once it's published
+struct GestureSnapshot
+{
+    CGestureEngine      engine;
+    long                lVersion;       // 1 for the first, then +1 per change
+    GestureSnapshot*    pNextRetired;   // in the retired list
+};
+
+struct ConfigSlot;
+struct ConfigLock;
+
+/////////////////////////////////////////////////////////
+//
+// class CGestureConfig
+//
+// The published configuration. Acquire and Release may be
+// called on any thread at any time and don't block; the
+// changes (BeginUpdate to Commit or Abort, and the helpers
+// built on them) may be called on any thread too, and are
+// serialized with a lock the readers never take.
+//
+/////////////////////////////////////////////////////////
+
+class CGestureConfig
+{
+    GestureSnapshot* volatile   m_pCurrent;
+    ConfigSlot*                 m_pSlots;       // GC_MAX_READERS hazard pointers
+    ConfigLock*                 m_pLock;        // the writers'
+    GestureSnapshot*            m_pUpdate;      // the change being made
+    GestureSnapshot*            m_pRetired;     // replaced, maybe still pinned
+    int                         m_cRetired;
+    volatile long               m_lVersion;     // the current snapshot's
+    volatile long               m_cFullFailures; // Acquires with no slot free
+
+public:
+
+    // Constructor and destructor
+    CGestureConfig();
+    ~CGestureConfig();
+
+    bool Create(const CGestureEngine& engine);
+
+    // The readers
+    const GestureSnapshot* Acquire(int& iSlot);
+    void Release(int iSlot);
+
+    // The writers
+    CGestureEngine* BeginUpdate();
+    bool Commit();
+    void Abort();
+    bool SetGestureEnabled(int iGesture, bool bEnabled);
+    bool SetGestureMask(unsigned long long ullGestures);
+    bool AddTemplate(int iGesture, const GesturePoint* ppt, int cPoints);
+
+    // Data members access methods
+    long GetVersion() const { return m_lVersion; }
+    long GetFullFailureCount() const { return m_cFullFailures; }
+    int  GetRetiredCount() const { return m_cRetired; }     // for the writers
+
+private:
+
+    void Reclaim();
+
+    // Not copyable
+    CGestureConfig(const CGestureConfig&);
+    CGestureConfig& operator=(const CGestureConfig&);
+};
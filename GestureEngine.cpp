@@ -0,0 +1,1841 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      GestureEngine.cpp
+//
+// Description:
+//      The file contains the definitions of the methods of the class
+//      CGestureEngine and the table of the built-in gesture shapes.
+//      See the file GestureEngine.h for the definition of the class.
+//--------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "GestureEngine.h"
+#include "Trace.h"
+
+// The batch kernel uses SSE2 where the compiler targets it
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define GE_BATCH_SSE2
+#include <emmintrin.h>
+#endif
+
+// A useful macro to determine the number of elements in the array
+#ifndef countof
+#define countof(array)  (sizeof(array)/sizeof(array[0]))
+#endif
+
+#define GE_PI           3.14159265358979f
+#define GE_DEG2RAD(d)   ((d) * GE_PI / 180.0f)
+
+// The half of the diagonal of the normalized bounding box. A distance
+// this large or larger scores 0.
+#define GE_HALF_DIAGONAL    (0.70710678f * GE_SQUARE_SIZE)
+
+// The names of the single stroke gestures, in the order of the
+// gc_igtSingleStrokeGestures table and the IDS_SSGESTURE_FIRST strings.
+// The window application loads the names from the resources, these
+// copies are for the console tools.
+static const char* const gc_pszGestureNames[GE_NUM_SSGESTURES] = {
+    "Scratchout", "Triangle", "Square", "Star", "Check",
+    "Circle", "Double Circle", "Curlicue", "Double Curlicue",
+    "Semicircle Left", "Semicircle Right",
+    "Chevron Up", "Chevron Down", "Chevron Left",
+    "Chevron Right", "Up", "Down", "Left", "Right", "Up-Down", "Down-Up",
+    "Left-Right", "Right-Left", "Up-Left Long", "Up-Right Long", "Down-Left Long",
+    "Down-Right Long", "Up-Left", "Up-Right", "Down-Left", "Down-Right", "Left-Up",
+    "Left-Down", "Right-Up", "Right-Down", "Tap"
+};
+
+// Built-in shapes. The coordinates are in a unit box with the y axis
+// pointing down, as in the ink space. The polyline shapes list their
+// vertices; the curves are generated from the parameters.
+enum {
+    SHAPE_POLYLINE,     // pfVerts, cVerts
+    SHAPE_ARC,          // fParam1 = start angle, fParam2 = sweep (both radians)
+    SHAPE_CURLICUE,     // fParam1 = the number of loops
+    SHAPE_TAP
+};
+
+struct BuiltinShape
+{
+    int             iGesture;
+    int             iKind;
+    const float*    pfVerts;    // x,y pairs
+    int             cVerts;
+    float           fParam1;
+    float           fParam2;
+};
+
+static const float gc_rgfScratchout[]   = { 0,0, 1,0.05f, 0.05f,0.12f, 1,0.17f, 0.05f,0.24f, 1,0.29f };
+static const float gc_rgfTriangle[]     = { 0.5f,0, 0,1, 1,1, 0.5f,0 };
+static const float gc_rgfSquare[]       = { 0,0, 0,1, 1,1, 1,0, 0,0 };
+static const float gc_rgfStar[]         = { 0.2f,1, 0.5f,0, 0.8f,1, 0,0.38f, 1,0.38f, 0.2f,1 };
+static const float gc_rgfCheck[]        = { 0,0.6f, 0.3f,1, 1,0 };
+static const float gc_rgfChevronUp[]    = { 0,1, 0.5f,0, 1,1 };
+static const float gc_rgfChevronDown[]  = { 0,0, 0.5f,1, 1,0 };
+static const float gc_rgfChevronLeft[]  = { 1,0, 0,0.5f, 1,1 };
+static const float gc_rgfChevronRight[] = { 0,0, 1,0.5f, 0,1 };
+static const float gc_rgfUp[]           = { 0,1, 0,0 };
+static const float gc_rgfDown[]         = { 0,0, 0,1 };
+static const float gc_rgfLeft[]         = { 1,0, 0,0 };
+static const float gc_rgfRight[]        = { 0,0, 1,0 };
+static const float gc_rgfUpDown[]       = { 0,1, 0,0, 0.02f,1 };
+static const float gc_rgfDownUp[]       = { 0,0, 0,1, 0.02f,0 };
+static const float gc_rgfLeftRight[]    = { 1,0, 0,0, 1,0.02f };
+static const float gc_rgfRightLeft[]    = { 0,0, 1,0, 0,0.02f };
+static const float gc_rgfUpLeftLong[]   = { 2,1, 2,0, 0,0 };
+static const float gc_rgfUpRightLong[]  = { 0,1, 0,0, 2,0 };
+static const float gc_rgfDownLeftLong[] = { 2,0, 2,1, 0,1 };
+static const float gc_rgfDownRightLong[]= { 0,0, 0,1, 2,1 };
+static const float gc_rgfUpLeft[]       = { 0.5f,1, 0.5f,0, 0,0 };
+static const float gc_rgfUpRight[]      = { 0,1, 0,0, 0.5f,0 };
+static const float gc_rgfDownLeft[]     = { 0.5f,0, 0.5f,1, 0,1 };
+static const float gc_rgfDownRight[]    = { 0,0, 0,1, 0.5f,1 };
+static const float gc_rgfLeftUp[]       = { 1,0.5f, 0,0.5f, 0,0 };
+static const float gc_rgfLeftDown[]     = { 1,0, 0,0, 0,0.5f };
+static const float gc_rgfRightUp[]      = { 0,0.5f, 1,0.5f, 1,0 };
+static const float gc_rgfRightDown[]    = { 0,0, 1,0, 1,0.5f };
+
+#define POLYLINE(g, v)  { g, SHAPE_POLYLINE, v, countof(v) / 2, 0, 0 }
+#define ARC(g, a, s)    { g, SHAPE_ARC, NULL, 0, a, s }
+
+static const BuiltinShape gc_rgShapes[] = {
+    POLYLINE(0, gc_rgfScratchout),
+    POLYLINE(1, gc_rgfTriangle),
+    POLYLINE(2, gc_rgfSquare),
+    POLYLINE(3, gc_rgfStar),
+    POLYLINE(4, gc_rgfCheck),
+    ARC(5, -GE_PI / 2, -2 * GE_PI),     // circle, counterclockwise
+    ARC(5, -GE_PI / 2, 2 * GE_PI),      // circle, clockwise
+    ARC(6, -GE_PI / 2, -4 * GE_PI),     // double circle, counterclockwise
+    ARC(6, -GE_PI / 2, 4 * GE_PI),      // double circle, clockwise
+    { 7, SHAPE_CURLICUE, NULL, 0, 1, 0 },
+    { 8, SHAPE_CURLICUE, NULL, 0, 2, 0 },
+    ARC(9, 0, -GE_PI),                  // from the right over the top to the left
+    ARC(10, GE_PI, GE_PI),              // from the left over the top to the right
+    POLYLINE(11, gc_rgfChevronUp),
+    POLYLINE(12, gc_rgfChevronDown),
+    POLYLINE(13, gc_rgfChevronLeft),
+    POLYLINE(14, gc_rgfChevronRight),
+    POLYLINE(15, gc_rgfUp),
+    POLYLINE(16, gc_rgfDown),
+    POLYLINE(17, gc_rgfLeft),
+    POLYLINE(18, gc_rgfRight),
+    POLYLINE(19, gc_rgfUpDown),
+    POLYLINE(20, gc_rgfDownUp),
+    POLYLINE(21, gc_rgfLeftRight),
+    POLYLINE(22, gc_rgfRightLeft),
+    POLYLINE(23, gc_rgfUpLeftLong),
+    POLYLINE(24, gc_rgfUpRightLong),
+    POLYLINE(25, gc_rgfDownLeftLong),
+    POLYLINE(26, gc_rgfDownRightLong),
+    POLYLINE(27, gc_rgfUpLeft),
+    POLYLINE(28, gc_rgfUpRight),
+    POLYLINE(29, gc_rgfDownLeft),
+    POLYLINE(30, gc_rgfDownRight),
+    POLYLINE(31, gc_rgfLeftUp),
+    POLYLINE(32, gc_rgfLeftDown),
+    POLYLINE(33, gc_rgfRightUp),
+    POLYLINE(34, gc_rgfRightDown),
+    { GE_GESTURE_TAP, SHAPE_TAP, NULL, 0, 0, 0 }
+};
+
+// The size of the built-in shapes in ink space units (HIMETRIC, 0.01mm)
+#define GE_BUILTIN_SIZE     2000.0f
+
+// The strokes a batch kernel matches at once, one per SSE2 lane
+#define GE_BATCH_LANES      4
+
+// Normalized strokes matched at once, the coordinates of a point of all
+// of them side by side
+struct BatchLanes
+{
+    float   rgfX[GE_NUM_POINTS][GE_BATCH_LANES];
+    float   rgfY[GE_NUM_POINTS][GE_BATCH_LANES];
+};
+
+// A template in the form the batch kernel compares with
+struct BatchTemplate
+{
+    float   rgfX[GE_NUM_POINTS];
+    float   rgfY[GE_NUM_POINTS];
+    float   fScale;     // the unit of the coordinates, in normalized units
+};
+
+static void BatchGoldenSectionSearch(const BatchLanes& lanes, const BatchTemplate& bt,
+                                     float fRange, float fPrecision, int iStep, float* pfDist);
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEngine::CGestureEngine
+//
+// Constructor.
+//
+// Parameters:
+//     none
+//
+/////////////////////////////////////////////////////////
+CGestureEngine::CGestureEngine()
+    : m_pbTemplates(NULL), m_iFormat(GE_FORMAT_FLOAT32), m_cbTemplate(sizeof(GestureTemplate)),
+      m_pfFeatures(NULL), m_cTemplates(0), m_cMaxTemplates(0),
+      m_bOwnsTemplates(true), m_cCandidates(0), m_fTapExtent(GE_DEFAULT_TAP_EXTENT),
+      m_fAngleRange(GE_DEG2RAD(15.0f)), m_fAnglePrecision(GE_DEG2RAD(2.0f)),
+      m_iPointStep(1), m_ullGestures(GE_ALL_GESTURES)
+{
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEngine::~CGestureEngine
+//
+// Destructor.
+//
+/////////////////////////////////////////////////////////
+CGestureEngine::~CGestureEngine()
+{
+    RemoveAllTemplates();
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEngine::RemoveAllTemplates
+//
+// Empties the template set and the index.
+//
+// Parameters:
+//     none
+//
+// Return Values (void):
+//      none
+//
+/////////////////////////////////////////////////////////
+void CGestureEngine::RemoveAllTemplates()
+{
+    m_index.Clear();
+    if (m_bOwnsTemplates)
+    {
+        free(m_pbTemplates);
+        free(m_pfFeatures);
+    }
+    m_pbTemplates = NULL;
+    m_pfFeatures = NULL;
+    m_cTemplates = m_cMaxTemplates = 0;
+    m_bOwnsTemplates = true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEngine::AttachTemplates
+//
+// Makes the engine use a template set prepared earlier,
+// typically the sections of a mapped template pack. The
+// arrays are used in place and must outlive the engine
+// (or the next call to RemoveAllTemplates). A template set
+// attached this way is read-only.
+//
+// Parameters:
+//     const void* pvTemplates           : [in] the normalized templates
+//     int iFormat                       : [in] their storage format
+//     const float* pfFeatures           : [in] their feature vectors
+//     int cTemplates                    : [in] the number of templates
+//     const VPNode* pNodes              : [in] the template index, may be NULL
+//     int cNodes                        : [in] the number of the index nodes
+//
+// Return Values (void):
+//      none
+//
+/////////////////////////////////////////////////////////
+void CGestureEngine::AttachTemplates(
+        const void* pvTemplates,
+        int iFormat,
+        const float* pfFeatures,
+        int cTemplates,
+        const VPNode* pNodes,
+        int cNodes
+        )
+{
+    RemoveAllTemplates();
+    m_iFormat = iFormat;
+    m_cbTemplate = GetFormatTemplateSize(iFormat);
+    m_pbTemplates = (unsigned char*)const_cast<void*>(pvTemplates);
+    m_pfFeatures = const_cast<float*>(pfFeatures);
+    m_cTemplates = m_cMaxTemplates = cTemplates;
+    m_bOwnsTemplates = false;
+    if (NULL != pNodes && cNodes == cTemplates)
+    {
+        m_index.Attach(pNodes, cNodes);
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEngine::AddTemplate
+//
+// Normalizes the stroke and appends it to the template set.
+// The index becomes stale and is dropped; call BuildIndex
+// after the last template has been added.
+//
+// Parameters:
+//     int iGesture            : [in] index into the single stroke gesture table
+//     const GesturePoint* ppt : [in] the stroke points
+//     int cPoints             : [in] the number of points
+//
+// Return Values (bool):
+//      true if succeeded, false if the parameters are invalid
+//      or out of memory
+//
+/////////////////////////////////////////////////////////
+bool CGestureEngine::AddTemplate(
+        int iGesture,
+        const GesturePoint* ppt,
+        int cPoints
+        )
+{
+    if (iGesture < 0 || iGesture >= GE_NUM_SSGESTURES || NULL == ppt || cPoints <= 0)
+        return false;
+    if (false == m_bOwnsTemplates)
+        return false;   // mapped template sets are read-only
+
+    if (m_cTemplates == m_cMaxTemplates)
+    {
+        int cNewMax = m_cMaxTemplates ? m_cMaxTemplates * 2 : 64;
+        unsigned char* pbTemplates = (unsigned char*)realloc(
+                                        m_pbTemplates, (size_t)cNewMax * m_cbTemplate);
+        if (NULL == pbTemplates)
+            return false;
+        m_pbTemplates = pbTemplates;
+
+        float* pfFeatures = (float*)realloc(
+                                m_pfFeatures, cNewMax * GE_NUM_FEATURES * sizeof(float));
+        if (NULL == pfFeatures)
+            return false;
+        m_pfFeatures = pfFeatures;
+
+        m_cMaxTemplates = cNewMax;
+    }
+
+    GesturePoint rgpt[GE_NUM_POINTS];
+    NormalizeStroke(ppt, cPoints, rgpt);
+    ComputeFeatures(rgpt, m_pfFeatures + m_cTemplates * GE_NUM_FEATURES);
+    StoreTemplate(m_cTemplates, iGesture, rgpt);
+    m_cTemplates++;
+
+    m_index.Clear();
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEngine::SetStorageFormat
+//
+// Selects the storage format of the templates. The format
+// can be changed only while the template set is empty.
+//
+// Parameters:
+//     int iFormat : [in] one of the GE_FORMAT_ constants
+//
+// Return Values (bool):
+//      true if succeeded, false if the format is unknown or
+//      the engine already has templates
+//
+/////////////////////////////////////////////////////////
+bool CGestureEngine::SetStorageFormat(int iFormat)
+{
+    if (iFormat < 0 || iFormat >= GE_NUM_FORMATS)
+        return false;
+    if (iFormat == m_iFormat)
+        return true;
+    if (0 != m_cTemplates)
+        return false;
+
+    RemoveAllTemplates();
+    m_iFormat = iFormat;
+    m_cbTemplate = GetFormatTemplateSize(iFormat);
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEngine::Copy
+//
+// Makes the engine recognize as another one: the same
+// templates, index and settings. Templates the other engine
+// owns are copied; attached ones are attached again, and
+// must outlive this engine too.
+//
+// Parameters:
+//     const CGestureEngine& engine : [in] the engine to copy
+//
+// Return Values (bool):
+//      true if succeeded, false if out of memory, which leaves
+//      the engine empty
+//
+/////////////////////////////////////////////////////////
+bool CGestureEngine::Copy(const CGestureEngine& engine)
+{
+    if (&engine == this)
+        return true;
+    RemoveAllTemplates();
+
+    m_iFormat = engine.m_iFormat;
+    m_cbTemplate = engine.m_cbTemplate;
+    m_cCandidates = engine.m_cCandidates;
+    m_fTapExtent = engine.m_fTapExtent;
+    m_fAngleRange = engine.m_fAngleRange;
+    m_fAnglePrecision = engine.m_fAnglePrecision;
+    m_iPointStep = engine.m_iPointStep;
+    m_ullGestures = engine.m_ullGestures;
+
+    if (false == engine.m_bOwnsTemplates)
+    {
+        m_pbTemplates = engine.m_pbTemplates;
+        m_pfFeatures = engine.m_pfFeatures;
+        m_cTemplates = m_cMaxTemplates = engine.m_cTemplates;
+        m_bOwnsTemplates = false;
+    }
+    else if (engine.m_cTemplates > 0)
+    {
+        m_pbTemplates = (unsigned char*)malloc((size_t)engine.m_cMaxTemplates * m_cbTemplate);
+        m_pfFeatures = (float*)malloc(engine.m_cMaxTemplates * GE_NUM_FEATURES * sizeof(float));
+        if (NULL == m_pbTemplates || NULL == m_pfFeatures)
+        {
+            RemoveAllTemplates();
+            return false;
+        }
+        memcpy(m_pbTemplates, engine.m_pbTemplates, (size_t)engine.m_cTemplates * m_cbTemplate);
+        memcpy(m_pfFeatures, engine.m_pfFeatures, engine.m_cTemplates * GE_NUM_FEATURES * sizeof(float));
+        m_cTemplates = engine.m_cTemplates;
+        m_cMaxTemplates = engine.m_cMaxTemplates;
+    }
+
+    if (false == m_index.Copy(engine.m_index))
+    {
+        RemoveAllTemplates();
+        return false;
+    }
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEngine::StoreTemplate
+//
+// Converts a normalized stroke to the storage format and
+// writes it to the given template slot.
+//
+/////////////////////////////////////////////////////////
+void CGestureEngine::StoreTemplate(
+        int iTemplate,
+        int iGesture,
+        const GesturePoint* pptNorm
+        )
+{
+    unsigned char* pb = m_pbTemplates + (size_t)iTemplate * m_cbTemplate;
+    memset(pb, 0, m_cbTemplate);
+
+    switch (m_iFormat)
+    {
+        case GE_FORMAT_FLOAT32:
+        {
+            GestureTemplate* pgt = (GestureTemplate*)pb;
+            pgt->iGesture = iGesture;
+            memcpy(pgt->rgpt, pptNorm, sizeof(pgt->rgpt));
+            break;
+        }
+
+        case GE_FORMAT_FLOAT16:
+        {
+            GestureTemplateF16* pgt = (GestureTemplateF16*)pb;
+            pgt->iGesture = iGesture;
+            for (int i = 0; i < GE_NUM_POINTS; i++)
+            {
+                pgt->rgh[2 * i] = FloatToHalf(pptNorm[i].x);
+                pgt->rgh[2 * i + 1] = FloatToHalf(pptNorm[i].y);
+            }
+            break;
+        }
+
+        case GE_FORMAT_INT8:
+        {
+            GestureTemplateQ8* pgt = (GestureTemplateQ8*)pb;
+            pgt->iGesture = iGesture;
+
+            float fMax = 0.0f;
+            for (int i = 0; i < GE_NUM_POINTS; i++)
+            {
+                if (fabsf(pptNorm[i].x) > fMax) fMax = fabsf(pptNorm[i].x);
+                if (fabsf(pptNorm[i].y) > fMax) fMax = fabsf(pptNorm[i].y);
+            }
+            pgt->fScale = (fMax > 0.0f) ? (fMax / 127.0f) : 1.0f;
+
+            float fInvScale = 1.0f / pgt->fScale;
+            for (int i = 0; i < GE_NUM_POINTS; i++)
+            {
+                pgt->rgc[2 * i] = (signed char)floorf(pptNorm[i].x * fInvScale + 0.5f);
+                pgt->rgc[2 * i + 1] = (signed char)floorf(pptNorm[i].y * fInvScale + 0.5f);
+            }
+            break;
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEngine::GetTemplatePoints
+//
+// Returns the points of a template converted back to
+// single precision.
+//
+// Parameters:
+//     int iTemplate     : [in] the template index
+//     GesturePoint* ppt : [out] GE_NUM_POINTS points
+//
+// Return Values (void):
+//      none
+//
+/////////////////////////////////////////////////////////
+void CGestureEngine::GetTemplatePoints(int iTemplate, GesturePoint* ppt) const
+{
+    const unsigned char* pb = m_pbTemplates + (size_t)iTemplate * m_cbTemplate;
+
+    switch (m_iFormat)
+    {
+        case GE_FORMAT_FLOAT32:
+            memcpy(ppt, ((const GestureTemplate*)pb)->rgpt, GE_NUM_POINTS * sizeof(GesturePoint));
+            break;
+
+        case GE_FORMAT_FLOAT16:
+        {
+            const GestureTemplateF16* pgt = (const GestureTemplateF16*)pb;
+            for (int i = 0; i < GE_NUM_POINTS; i++)
+            {
+                ppt[i].x = HalfToFloat(pgt->rgh[2 * i]);
+                ppt[i].y = HalfToFloat(pgt->rgh[2 * i + 1]);
+            }
+            break;
+        }
+
+        case GE_FORMAT_INT8:
+        {
+            const GestureTemplateQ8* pgt = (const GestureTemplateQ8*)pb;
+            for (int i = 0; i < GE_NUM_POINTS; i++)
+            {
+                ppt[i].x = pgt->rgc[2 * i] * pgt->fScale;
+                ppt[i].y = pgt->rgc[2 * i + 1] * pgt->fScale;
+            }
+            break;
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEngine::AddBuiltinTemplates
+//
+// Adds a template for each of the built-in gesture shapes.
+// Taps are recognized by their extent and need no template.
+//
+// Parameters:
+//     none
+//
+// Return Values (int):
+//      the number of templates added
+//
+/////////////////////////////////////////////////////////
+int CGestureEngine::AddBuiltinTemplates()
+{
+    GesturePoint rgpt[256];
+    int cAdded = 0;
+    for (int i = 0; i < GetBuiltinShapeCount(); i++)
+    {
+        int iGesture;
+        int cPoints = GetBuiltinShape(i, iGesture, rgpt, countof(rgpt));
+        if (GE_GESTURE_TAP != iGesture && AddTemplate(iGesture, rgpt, cPoints))
+        {
+            cAdded++;
+        }
+    }
+    return cAdded;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEngine::BuildIndex
+//
+// (Re)builds the template index over the current feature
+// vectors. Has no effect on recognition until a candidate
+// count is set with SetCandidateCount.
+//
+// Parameters:
+//     none
+//
+// Return Values (bool):
+//      true if succeeded, false if out of memory
+//
+/////////////////////////////////////////////////////////
+bool CGestureEngine::BuildIndex()
+{
+    if (false == m_bOwnsTemplates)
+        return true;    // mapped template sets come with their index
+    return m_index.Build(m_pfFeatures, m_cTemplates);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEngine::SetCandidateCount
+//
+// Sets the number of the candidate templates the index
+// should return per stroke. 0 turns the index off and
+// makes the engine match all the templates.
+//
+/////////////////////////////////////////////////////////
+void CGestureEngine::SetCandidateCount(int cCandidates)
+{
+    if (cCandidates < 0)
+        cCandidates = 0;
+    if (cCandidates > CTemplateIndex::mc_cMaxCandidates)
+        cCandidates = CTemplateIndex::mc_cMaxCandidates;
+    m_cCandidates = cCandidates;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEngine::SetAngleSearch
+//
+// Sets the range and the precision of the rotation search,
+// both in radians.
+//
+/////////////////////////////////////////////////////////
+void CGestureEngine::SetAngleSearch(float fRange, float fPrecision)
+{
+    m_fAngleRange = fRange;
+    m_fAnglePrecision = (fPrecision > 0.0f) ? fPrecision : GE_DEG2RAD(2.0f);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEngine::SetPointStep
+//
+// Sets the points the distances are taken over: every
+// one of the GE_NUM_POINTS resampled points with 1, every
+// other one with 2 and so on, which matches a stroke as if
+// it were resampled to GE_NUM_POINTS / iStep points, for a
+// fraction of the cost. The step is rounded down to a power
+// of two up to GE_MAX_POINT_STEP, so it divides the points.
+//
+/////////////////////////////////////////////////////////
+void CGestureEngine::SetPointStep(int iStep)
+{
+    int i = 1;
+    while (2 * i <= iStep && 2 * i <= GE_MAX_POINT_STEP)
+        i *= 2;
+    m_iPointStep = i;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEngine::Recognize
+//
+// Recognizes a stroke against the template set.
+//
+// Parameters:
+//     const GesturePoint* ppt : [in] the stroke points, in ink space
+//     int cPoints             : [in] the number of points
+//     GestureResult* pResults : [out] the alternates, one per gesture,
+//                               ordered by the score, the best first
+//     int cMaxResults         : [in] the size of the pResults array
+//
+// Return Values (int):
+//      the number of alternates written to pResults
+//
+/////////////////////////////////////////////////////////
+int CGestureEngine::Recognize(
+        const GesturePoint* ppt,
+        int cPoints,
+        GestureResult* pResults,
+        int cMaxResults
+        ) const
+{
+    TRACE_SCOPE("Recognize");
+
+    if (NULL == ppt || cPoints <= 0 || NULL == pResults || cMaxResults <= 0)
+        return 0;
+
+    // A stroke that doesn't leave a small box is a tap, or nothing
+    // if taps aren't recognized
+    if (IsTap(ppt, cPoints))
+    {
+        if (false == IsGestureEnabled(GE_GESTURE_TAP))
+            return 0;
+        pResults[0].iGesture = GE_GESTURE_TAP;
+        pResults[0].iTemplate = -1;
+        pResults[0].fScore = 1.0f;
+        return 1;
+    }
+
+    if (0 == m_cTemplates)
+        return 0;
+
+    GesturePoint rgpt[GE_NUM_POINTS];
+    {
+        TRACE_SCOPE("Normalize");
+        NormalizeStroke(ppt, cPoints, rgpt);
+    }
+
+    // The best distance and template for each gesture
+    float rgfBest[GE_NUM_SSGESTURES];
+    int rgiBest[GE_NUM_SSGESTURES];
+    for (int i = 0; i < GE_NUM_SSGESTURES; i++)
+    {
+        rgfBest[i] = 3.4e38f;
+        rgiBest[i] = -1;
+    }
+
+    // Select the templates to match: either the index candidates or all of them
+    int rgiCandidates[CTemplateIndex::mc_cMaxCandidates];
+    int cCandidates = 0;
+    bool bIndexed = (m_cCandidates > 0 && false == m_index.IsEmpty());
+    if (bIndexed)
+    {
+        TRACE_SCOPE("IndexQuery");
+        float rgfFeatures[GE_NUM_FEATURES];
+        ComputeFeatures(rgpt, rgfFeatures);
+        cCandidates = m_index.Query(m_pfFeatures, rgfFeatures, m_cCandidates, rgiCandidates);
+    }
+    int cToMatch = bIndexed ? cCandidates : m_cTemplates;
+
+    {
+        TRACE_SCOPE("Match");
+        for (int i = 0; i < cToMatch; i++)
+        {
+            int iTemplate = bIndexed ? rgiCandidates[i] : i;
+            int iGesture = GetTemplateGesture(iTemplate);
+            if (false == IsGestureEnabled(iGesture))
+                continue;
+            float fDist = DistanceToTemplate(rgpt, iTemplate);
+            if (fDist < rgfBest[iGesture])
+            {
+                rgfBest[iGesture] = fDist;
+                rgiBest[iGesture] = iTemplate;
+            }
+        }
+    }
+
+    return SortResults(rgfBest, rgiBest, pResults, cMaxResults);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEngine::RecognizeBatch
+//
+// Recognizes several strokes at once, with the results
+// Recognize would give for each. Without the index, the
+// pass is template major: every template is converted to
+// single precision once and matched against the strokes
+// of the batch GE_BATCH_LANES at a time, their rotation
+// searches in lockstep (see BatchGoldenSectionSearch), so
+// the kernel computes the distances of all of them in one
+// pass over the points. With the index, the candidates
+// differ per stroke and the strokes are matched one by
+// one, as is a stroke that's alone in its batch.
+//
+// Parameters:
+//     const GestureStroke* pStrokes : [in] the strokes
+//     int cStrokes                  : [in] the number of strokes
+//     GestureResult* pResults       : [out] cMaxResults alternates per
+//                                     stroke, stroke i's at
+//                                     pResults + i * cMaxResults
+//     int cMaxResults               : [in] the alternates per stroke
+//     int* pcResults                : [out] the number of alternates
+//                                     of each stroke
+//
+// Return Values (int):
+//      the number of strokes recognized, cStrokes unless the
+//      parameters are invalid
+//
+/////////////////////////////////////////////////////////
+int CGestureEngine::RecognizeBatch(
+        const GestureStroke* pStrokes,
+        int cStrokes,
+        GestureResult* pResults,
+        int cMaxResults,
+        int* pcResults
+        ) const
+{
+    TRACE_SCOPE("RecognizeBatch");
+
+    if (NULL == pStrokes || cStrokes <= 0 || NULL == pResults ||
+        cMaxResults <= 0 || NULL == pcResults)
+        return 0;
+
+    if (m_cCandidates > 0 && false == m_index.IsEmpty())
+    {
+        for (int i = 0; i < cStrokes; i++)
+        {
+            pcResults[i] = Recognize(pStrokes[i].ppt, pStrokes[i].cPoints,
+                                     pResults + (size_t)i * cMaxResults, cMaxResults);
+        }
+        return cStrokes;
+    }
+
+    for (int iFirst = 0; iFirst < cStrokes; iFirst += GE_MAX_BATCH)
+    {
+        int cBatch = cStrokes - iFirst;
+        if (cBatch > GE_MAX_BATCH)
+            cBatch = GE_MAX_BATCH;
+
+        // Normalize the strokes to match; the taps and the empty
+        // strokes are answered right away
+        BatchLanes rgLanes[GE_MAX_BATCH / GE_BATCH_LANES];
+        int rgiStroke[GE_MAX_BATCH];
+        int cToMatch = 0;
+        {
+            TRACE_SCOPE("Normalize");
+            for (int i = iFirst; i < iFirst + cBatch; i++)
+            {
+                const GestureStroke& stroke = pStrokes[i];
+                GestureResult* pOut = pResults + (size_t)i * cMaxResults;
+                pcResults[i] = 0;
+                if (NULL == stroke.ppt || stroke.cPoints <= 0)
+                    continue;
+                if (IsTap(stroke.ppt, stroke.cPoints))
+                {
+                    if (IsGestureEnabled(GE_GESTURE_TAP))
+                    {
+                        pOut[0].iGesture = GE_GESTURE_TAP;
+                        pOut[0].iTemplate = -1;
+                        pOut[0].fScore = 1.0f;
+                        pcResults[i] = 1;
+                    }
+                    continue;
+                }
+                if (0 == m_cTemplates)
+                    continue;
+                GesturePoint rgpt[GE_NUM_POINTS];
+                NormalizeStroke(stroke.ppt, stroke.cPoints, rgpt);
+                BatchLanes& lanes = rgLanes[cToMatch / GE_BATCH_LANES];
+                for (int p = 0; p < GE_NUM_POINTS; p++)
+                {
+                    lanes.rgfX[p][cToMatch % GE_BATCH_LANES] = rgpt[p].x;
+                    lanes.rgfY[p][cToMatch % GE_BATCH_LANES] = rgpt[p].y;
+                }
+                rgiStroke[cToMatch++] = i;
+            }
+        }
+        if (0 == cToMatch)
+            continue;
+        if (1 == cToMatch)
+        {
+            int i = rgiStroke[0];
+            pcResults[i] = Recognize(pStrokes[i].ppt, pStrokes[i].cPoints,
+                                     pResults + (size_t)i * cMaxResults, cMaxResults);
+            continue;
+        }
+
+        // The lanes of the last group past the strokes repeat its first
+        // stroke, their distances are ignored
+        int cGroups = (cToMatch + GE_BATCH_LANES - 1) / GE_BATCH_LANES;
+        for (int s = cToMatch; s < cGroups * GE_BATCH_LANES; s++)
+        {
+            BatchLanes& lanes = rgLanes[s / GE_BATCH_LANES];
+            for (int p = 0; p < GE_NUM_POINTS; p++)
+            {
+                lanes.rgfX[p][s % GE_BATCH_LANES] = lanes.rgfX[p][0];
+                lanes.rgfY[p][s % GE_BATCH_LANES] = lanes.rgfY[p][0];
+            }
+        }
+
+        float rgfBest[GE_MAX_BATCH][GE_NUM_SSGESTURES];
+        int rgiBest[GE_MAX_BATCH][GE_NUM_SSGESTURES];
+        for (int s = 0; s < cToMatch; s++)
+        {
+            for (int g = 0; g < GE_NUM_SSGESTURES; g++)
+            {
+                rgfBest[s][g] = 3.4e38f;
+                rgiBest[s][g] = -1;
+            }
+        }
+
+        {
+            TRACE_SCOPE("Match");
+            for (int iTemplate = 0; iTemplate < m_cTemplates; iTemplate++)
+            {
+                int iGesture = GetTemplateGesture(iTemplate);
+                if (false == IsGestureEnabled(iGesture))
+                    continue;
+                BatchTemplate bt;
+                LoadBatchTemplate(iTemplate, bt);
+                float rgfDist[GE_MAX_BATCH];
+                for (int g = 0; g < cGroups; g++)
+                {
+                    BatchGoldenSectionSearch(rgLanes[g], bt, m_fAngleRange, m_fAnglePrecision,
+                                             m_iPointStep, rgfDist + g * GE_BATCH_LANES);
+                }
+                for (int s = 0; s < cToMatch; s++)
+                {
+                    float fDist = rgfDist[s];
+                    if (fDist < rgfBest[s][iGesture])
+                    {
+                        rgfBest[s][iGesture] = fDist;
+                        rgiBest[s][iGesture] = iTemplate;
+                    }
+                }
+            }
+        }
+
+        for (int s = 0; s < cToMatch; s++)
+        {
+            int i = rgiStroke[s];
+            pcResults[i] = SortResults(rgfBest[s], rgiBest[s],
+                                       pResults + (size_t)i * cMaxResults, cMaxResults);
+        }
+    }
+
+    return cStrokes;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEngine::IsTap
+//
+// Tells whether a stroke stays within the tap extent.
+//
+/////////////////////////////////////////////////////////
+bool CGestureEngine::IsTap(const GesturePoint* ppt, int cPoints) const
+{
+    float fMinX = ppt[0].x, fMaxX = ppt[0].x, fMinY = ppt[0].y, fMaxY = ppt[0].y;
+    for (int i = 1; i < cPoints; i++)
+    {
+        if (ppt[i].x < fMinX) fMinX = ppt[i].x;
+        if (ppt[i].x > fMaxX) fMaxX = ppt[i].x;
+        if (ppt[i].y < fMinY) fMinY = ppt[i].y;
+        if (ppt[i].y > fMaxY) fMaxY = ppt[i].y;
+    }
+    return (fMaxX - fMinX <= m_fTapExtent && fMaxY - fMinY <= m_fTapExtent);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEngine::SortResults
+//
+// Outputs the gestures that have a best template by the
+// ascending distance (insertion sort, there are at most
+// GE_NUM_SSGESTURES of them).
+//
+// Return Values (int):
+//      the number of alternates written to pResults
+//
+/////////////////////////////////////////////////////////
+int CGestureEngine::SortResults(
+        const float* pfBest,
+        const int* piBest,
+        GestureResult* pResults,
+        int cMaxResults
+        )
+{
+    int cResults = 0;
+    for (int g = 0; g < GE_NUM_SSGESTURES; g++)
+    {
+        if (piBest[g] < 0)
+            continue;
+        float fScore = ScoreFromDistance(pfBest[g]);
+        int j = (cResults < cMaxResults) ? cResults++ : cMaxResults;
+        while (j > 0 && pResults[j - 1].fScore < fScore)
+        {
+            if (j < cMaxResults)
+                pResults[j] = pResults[j - 1];
+            j--;
+        }
+        if (j < cMaxResults)
+        {
+            pResults[j].iGesture = g;
+            pResults[j].iTemplate = piBest[g];
+            pResults[j].fScore = fScore;
+        }
+    }
+
+    return cResults;
+}
+
+// Stroke processing helpers //////////////////////////
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEngine::ResampleStroke
+//
+// Resamples a stroke to cOut points evenly spaced along
+// its path.
+//
+// Parameters:
+//     const GesturePoint* ppt : [in] the stroke points
+//     int cPoints             : [in] the number of points, > 0
+//     GesturePoint* pptOut    : [out] cOut resampled points
+//     int cOut                : [in] the number of points to produce, > 1
+//
+// Return Values (void):
+//      none
+//
+/////////////////////////////////////////////////////////
+void CGestureEngine::ResampleStroke(
+        const GesturePoint* ppt,
+        int cPoints,
+        GesturePoint* pptOut,
+        int cOut
+        )
+{
+    float fLength = 0.0f;
+    for (int i = 1; i < cPoints; i++)
+    {
+        float dx = ppt[i].x - ppt[i - 1].x;
+        float dy = ppt[i].y - ppt[i - 1].y;
+        fLength += sqrtf(dx * dx + dy * dy);
+    }
+
+    pptOut[0] = ppt[0];
+    int k = 1;
+    if (fLength > 0.0f)
+    {
+        float fInterval = fLength / (cOut - 1);
+        float fAccum = 0.0f;
+        GesturePoint ptPrev = ppt[0];
+        for (int i = 1; i < cPoints && k < cOut; i++)
+        {
+            GesturePoint ptCur = ppt[i];
+            float dx = ptCur.x - ptPrev.x;
+            float dy = ptCur.y - ptPrev.y;
+            float d = sqrtf(dx * dx + dy * dy);
+            while (d > 0.0f && fAccum + d >= fInterval && k < cOut)
+            {
+                float t = (fInterval - fAccum) / d;
+                ptPrev.x += t * dx;
+                ptPrev.y += t * dy;
+                pptOut[k++] = ptPrev;
+                dx = ptCur.x - ptPrev.x;
+                dy = ptCur.y - ptPrev.y;
+                d = sqrtf(dx * dx + dy * dy);
+                fAccum = 0.0f;
+            }
+            fAccum += d;
+            ptPrev = ptCur;
+        }
+    }
+
+    // Rounding may leave the last point(s) unset
+    while (k < cOut)
+    {
+        pptOut[k++] = ppt[cPoints - 1];
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEngine::NormalizeStroke
+//
+// Resamples a stroke to GE_NUM_POINTS points, scales it
+// uniformly so that the longer side of its bounding box
+// becomes GE_SQUARE_SIZE and moves its centroid to the
+// origin. The scaling is uniform to keep straight line
+// gestures (Up, Left, ...) from being blown up into noise.
+//
+// Parameters:
+//     const GesturePoint* ppt : [in] the stroke points
+//     int cPoints             : [in] the number of points, > 0
+//     GesturePoint* pptOut    : [out] GE_NUM_POINTS normalized points
+//
+// Return Values (void):
+//      none
+//
+/////////////////////////////////////////////////////////
+void CGestureEngine::NormalizeStroke(
+        const GesturePoint* ppt,
+        int cPoints,
+        GesturePoint* pptOut
+        )
+{
+    ResampleStroke(ppt, cPoints, pptOut, GE_NUM_POINTS);
+
+    float fMinX = pptOut[0].x, fMaxX = pptOut[0].x;
+    float fMinY = pptOut[0].y, fMaxY = pptOut[0].y;
+    float fSumX = 0.0f, fSumY = 0.0f;
+    for (int i = 0; i < GE_NUM_POINTS; i++)
+    {
+        if (pptOut[i].x < fMinX) fMinX = pptOut[i].x;
+        if (pptOut[i].x > fMaxX) fMaxX = pptOut[i].x;
+        if (pptOut[i].y < fMinY) fMinY = pptOut[i].y;
+        if (pptOut[i].y > fMaxY) fMaxY = pptOut[i].y;
+        fSumX += pptOut[i].x;
+        fSumY += pptOut[i].y;
+    }
+
+    float fSize = fMaxX - fMinX;
+    if (fMaxY - fMinY > fSize)
+        fSize = fMaxY - fMinY;
+    float fScale = (fSize > 0.0f) ? (GE_SQUARE_SIZE / fSize) : 1.0f;
+    float fCx = fSumX / GE_NUM_POINTS;
+    float fCy = fSumY / GE_NUM_POINTS;
+
+    for (int i = 0; i < GE_NUM_POINTS; i++)
+    {
+        pptOut[i].x = (pptOut[i].x - fCx) * fScale;
+        pptOut[i].y = (pptOut[i].y - fCy) * fScale;
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEngine::ComputeFeatures
+//
+// Computes the coarse feature vector of a normalized stroke,
+// used by the template index. See the FI_ constants in
+// TemplateIndex.h for the layout. All the features are
+// roughly in the -1..1 range so that none of them dominates
+// the Euclidean distance.
+//
+// Parameters:
+//     const GesturePoint* pptNorm : [in] GE_NUM_POINTS normalized points
+//     float* pfFeatures           : [out] GE_NUM_FEATURES floats
+//
+// Return Values (void):
+//      none
+//
+/////////////////////////////////////////////////////////
+void CGestureEngine::ComputeFeatures(
+        const GesturePoint* pptNorm,
+        float* pfFeatures
+        )
+{
+    memset(pfFeatures, 0, GE_NUM_FEATURES * sizeof(float));
+
+    float fMinX = pptNorm[0].x, fMaxX = pptNorm[0].x;
+    float fMinY = pptNorm[0].y, fMaxY = pptNorm[0].y;
+    float fLength = 0.0f;
+    float fPrevAngle = 0.0f;
+    float fTotalTurn = 0.0f;
+    const float fSegWeight = 1.0f / (GE_NUM_POINTS - 1);
+    const float fTurnWeight = 1.0f / (GE_NUM_POINTS - 2);
+
+    for (int i = 1; i < GE_NUM_POINTS; i++)
+    {
+        const GesturePoint& pt = pptNorm[i];
+        if (pt.x < fMinX) fMinX = pt.x;
+        if (pt.x > fMaxX) fMaxX = pt.x;
+        if (pt.y < fMinY) fMinY = pt.y;
+        if (pt.y > fMaxY) fMaxY = pt.y;
+
+        float dx = pt.x - pptNorm[i - 1].x;
+        float dy = pt.y - pptNorm[i - 1].y;
+        fLength += sqrtf(dx * dx + dy * dy);
+
+        // The segment direction histogram, the bins are centered
+        // on the 8 compass directions
+        float fAngle = atan2f(dy, dx);
+        int iDir = (int)floorf((fAngle + GE_PI + GE_PI / 8) / (GE_PI / 4)) & 7;
+        pfFeatures[FI_DIR_FIRST + iDir] += fSegWeight;
+
+        // The signed turning angle histogram
+        if (i > 1)
+        {
+            float fTurn = fAngle - fPrevAngle;
+            if (fTurn > GE_PI)
+                fTurn -= 2 * GE_PI;
+            else if (fTurn < -GE_PI)
+                fTurn += 2 * GE_PI;
+
+            int iTurn;
+            if (fTurn < -GE_PI / 2)
+                iTurn = 0;
+            else if (fTurn < -GE_PI / 8)
+                iTurn = 1;
+            else if (fTurn <= GE_PI / 8)
+                iTurn = 2;
+            else if (fTurn <= GE_PI / 2)
+                iTurn = 3;
+            else
+                iTurn = 4;
+            pfFeatures[FI_TURN_FIRST + iTurn] += fTurnWeight;
+            fTotalTurn += fabsf(fTurn);
+        }
+        fPrevAngle = fAngle;
+    }
+
+    float fWidth = fMaxX - fMinX;
+    float fHeight = fMaxY - fMinY;
+    if (fWidth + fHeight > 0.0f)
+        pfFeatures[FI_ASPECT] = (fWidth - fHeight) / (fWidth + fHeight);
+
+    const GesturePoint& ptFirst = pptNorm[0];
+    const GesturePoint& ptLast = pptNorm[GE_NUM_POINTS - 1];
+    if (fLength > 0.0f)
+    {
+        float dx = ptLast.x - ptFirst.x;
+        float dy = ptLast.y - ptFirst.y;
+        pfFeatures[FI_CLOSURE] = sqrtf(dx * dx + dy * dy) / fLength;
+    }
+
+    // The start and end directions over an eighth of the stroke
+    const int cEighth = GE_NUM_POINTS / 8;
+    float dx = pptNorm[cEighth].x - ptFirst.x;
+    float dy = pptNorm[cEighth].y - ptFirst.y;
+    float d = sqrtf(dx * dx + dy * dy);
+    if (d > 0.0f)
+    {
+        pfFeatures[FI_START_DX] = dx / d;
+        pfFeatures[FI_START_DY] = dy / d;
+    }
+    dx = ptLast.x - pptNorm[GE_NUM_POINTS - 1 - cEighth].x;
+    dy = ptLast.y - pptNorm[GE_NUM_POINTS - 1 - cEighth].y;
+    d = sqrtf(dx * dx + dy * dy);
+    if (d > 0.0f)
+    {
+        pfFeatures[FI_END_DX] = dx / d;
+        pfFeatures[FI_END_DY] = dy / d;
+    }
+
+    fTotalTurn /= 8 * GE_PI;
+    pfFeatures[FI_TOTAL_TURN] = (fTotalTurn < 1.0f) ? fTotalTurn : 1.0f;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEngine::DistanceAtAngle
+//
+// Returns the average distance between the corresponding
+// points of the query rotated by fAngle and the template,
+// over every iStep-th point (see SetPointStep).
+//
+/////////////////////////////////////////////////////////
+float CGestureEngine::DistanceAtAngle(
+        const GesturePoint* pptQuery,
+        const GesturePoint* pptTemplate,
+        float fAngle,
+        int iStep
+        )
+{
+    float fCos = cosf(fAngle);
+    float fSin = sinf(fAngle);
+    float fSum = 0.0f;
+    for (int i = 0; i < GE_NUM_POINTS; i += iStep)
+    {
+        float x = pptQuery[i].x * fCos - pptQuery[i].y * fSin;
+        float y = pptQuery[i].x * fSin + pptQuery[i].y * fCos;
+        float dx = x - pptTemplate[i].x;
+        float dy = y - pptTemplate[i].y;
+        fSum += sqrtf(dx * dx + dy * dy);
+    }
+    return fSum * iStep / GE_NUM_POINTS;
+}
+
+// The distance kernels of the storage formats. Each one returns the
+// average distance between the query rotated by an angle and a template
+// over every iStep-th point, converting the template coordinates on the
+// fly; the query stays in single precision since it's rotated anew for
+// every angle tried.
+
+struct KernelF32
+{
+    const GesturePoint*         pptQuery;
+    const GesturePoint*         pptTemplate;
+    int                         iStep;
+
+    float operator()(float fAngle) const
+    {
+        return CGestureEngine::DistanceAtAngle(pptQuery, pptTemplate, fAngle, iStep);
+    }
+};
+
+struct KernelF16
+{
+    const GesturePoint*         pptQuery;
+    const GestureTemplateF16*   pgt;
+    int                         iStep;
+
+    float operator()(float fAngle) const
+    {
+        float fCos = cosf(fAngle);
+        float fSin = sinf(fAngle);
+        float fSum = 0.0f;
+        for (int i = 0; i < GE_NUM_POINTS; i += iStep)
+        {
+            float x = pptQuery[i].x * fCos - pptQuery[i].y * fSin;
+            float y = pptQuery[i].x * fSin + pptQuery[i].y * fCos;
+            float dx = x - CGestureEngine::HalfToFloat(pgt->rgh[2 * i]);
+            float dy = y - CGestureEngine::HalfToFloat(pgt->rgh[2 * i + 1]);
+            fSum += sqrtf(dx * dx + dy * dy);
+        }
+        return fSum * iStep / GE_NUM_POINTS;
+    }
+};
+
+struct KernelQ8
+{
+    const GesturePoint*         pptQuery;
+    const GestureTemplateQ8*    pgt;
+    int                         iStep;
+
+    float operator()(float fAngle) const
+    {
+        // Rotate and scale the query into the template's 8-bit units once
+        // per point, then compare with the raw template bytes
+        float fInvScale = 1.0f / pgt->fScale;
+        float fCos = cosf(fAngle) * fInvScale;
+        float fSin = sinf(fAngle) * fInvScale;
+        float fSum = 0.0f;
+        for (int i = 0; i < GE_NUM_POINTS; i += iStep)
+        {
+            float x = pptQuery[i].x * fCos - pptQuery[i].y * fSin;
+            float y = pptQuery[i].x * fSin + pptQuery[i].y * fCos;
+            float dx = x - pgt->rgc[2 * i];
+            float dy = y - pgt->rgc[2 * i + 1];
+            fSum += sqrtf(dx * dx + dy * dy);
+        }
+        return fSum * pgt->fScale * iStep / GE_NUM_POINTS;
+    }
+};
+
+/////////////////////////////////////////////////////////
+//
+// GoldenSectionSearch
+//
+// Golden section search for the angle within [-fRange, fRange]
+// that minimizes the kernel's distance.
+//
+// Return Values (float):
+//      the minimal distance found
+//
+/////////////////////////////////////////////////////////
+template <class TKernel>
+static float GoldenSectionSearch(const TKernel& kernel, float fRange, float fPrecision)
+{
+    if (fRange <= 0.0f)
+        return kernel(0.0f);
+
+    const float fPhi = 0.61803399f;
+    float a = -fRange;
+    float b = fRange;
+    float x1 = fPhi * a + (1.0f - fPhi) * b;
+    float f1 = kernel(x1);
+    float x2 = (1.0f - fPhi) * a + fPhi * b;
+    float f2 = kernel(x2);
+
+    while (b - a > fPrecision)
+    {
+        if (f1 < f2)
+        {
+            b = x2;
+            x2 = x1;
+            f2 = f1;
+            x1 = fPhi * a + (1.0f - fPhi) * b;
+            f1 = kernel(x1);
+        }
+        else
+        {
+            a = x1;
+            x1 = x2;
+            f1 = f2;
+            x2 = (1.0f - fPhi) * a + fPhi * b;
+            f2 = kernel(x2);
+        }
+    }
+
+    return (f1 < f2) ? f1 : f2;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEngine::DistanceAtBestAngle
+//
+// Searches for the rotation of the query within
+// [-fRange, fRange] that minimizes its distance to the
+// (single precision) template.
+//
+// Return Values (float):
+//      the minimal distance found
+//
+/////////////////////////////////////////////////////////
+float CGestureEngine::DistanceAtBestAngle(
+        const GesturePoint* pptQuery,
+        const GesturePoint* pptTemplate,
+        float fRange,
+        float fPrecision
+        )
+{
+    KernelF32 kernel = { pptQuery, pptTemplate, 1 };
+    return GoldenSectionSearch(kernel, fRange, fPrecision);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEngine::DistanceToTemplate
+//
+// Runs the rotation search against a stored template with
+// the kernel of the storage format.
+//
+/////////////////////////////////////////////////////////
+float CGestureEngine::DistanceToTemplate(
+        const GesturePoint* pptQuery,
+        int iTemplate
+        ) const
+{
+    const unsigned char* pb = m_pbTemplates + (size_t)iTemplate * m_cbTemplate;
+
+    switch (m_iFormat)
+    {
+        case GE_FORMAT_FLOAT16:
+        {
+            KernelF16 kernel = { pptQuery, (const GestureTemplateF16*)pb, m_iPointStep };
+            return GoldenSectionSearch(kernel, m_fAngleRange, m_fAnglePrecision);
+        }
+
+        case GE_FORMAT_INT8:
+        {
+            KernelQ8 kernel = { pptQuery, (const GestureTemplateQ8*)pb, m_iPointStep };
+            return GoldenSectionSearch(kernel, m_fAngleRange, m_fAnglePrecision);
+        }
+
+        default:
+        {
+            KernelF32 kernel = { pptQuery, ((const GestureTemplate*)pb)->rgpt, m_iPointStep };
+            return GoldenSectionSearch(kernel, m_fAngleRange, m_fAnglePrecision);
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEngine::LoadBatchTemplate
+//
+// Converts a stored template to the single precision form
+// the batch kernel works on: the coordinates and the scale
+// they're in, the 8-bit units of a GE_FORMAT_INT8 template
+// (as KernelQ8 has them) and 1 otherwise.
+//
+/////////////////////////////////////////////////////////
+void CGestureEngine::LoadBatchTemplate(int iTemplate, BatchTemplate& bt) const
+{
+    const unsigned char* pb = m_pbTemplates + (size_t)iTemplate * m_cbTemplate;
+
+    bt.fScale = 1.0f;
+    switch (m_iFormat)
+    {
+        case GE_FORMAT_FLOAT16:
+        {
+            const GestureTemplateF16* pgt = (const GestureTemplateF16*)pb;
+            for (int i = 0; i < GE_NUM_POINTS; i++)
+            {
+                bt.rgfX[i] = HalfToFloat(pgt->rgh[2 * i]);
+                bt.rgfY[i] = HalfToFloat(pgt->rgh[2 * i + 1]);
+            }
+            break;
+        }
+
+        case GE_FORMAT_INT8:
+        {
+            const GestureTemplateQ8* pgt = (const GestureTemplateQ8*)pb;
+            bt.fScale = pgt->fScale;
+            for (int i = 0; i < GE_NUM_POINTS; i++)
+            {
+                bt.rgfX[i] = pgt->rgc[2 * i];
+                bt.rgfY[i] = pgt->rgc[2 * i + 1];
+            }
+            break;
+        }
+
+        default:
+        {
+            const GestureTemplate* pgt = (const GestureTemplate*)pb;
+            for (int i = 0; i < GE_NUM_POINTS; i++)
+            {
+                bt.rgfX[i] = pgt->rgpt[i].x;
+                bt.rgfY[i] = pgt->rgpt[i].y;
+            }
+            break;
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// BatchDistanceAtAngles
+//
+// The distance kernel over GE_BATCH_LANES strokes, each
+// rotated by an angle of its own, to one template, with
+// SSE2 where there is SSE2. Every stroke's sum runs over
+// the points in the same order and with the same operations
+// as in the single stroke kernels, and a scale of 1 changes
+// nothing, so a stroke gets the very distance the kernel of
+// the storage format gives it.
+//
+/////////////////////////////////////////////////////////
+static void BatchDistanceAtAngles(
+        const BatchLanes& lanes,
+        const BatchTemplate& bt,
+        const float* pfAngles,
+        int iStep,
+        float* pfDist
+        )
+{
+    float fInvScale = 1.0f / bt.fScale;
+    float rgfCos[GE_BATCH_LANES];
+    float rgfSin[GE_BATCH_LANES];
+    for (int s = 0; s < GE_BATCH_LANES; s++)
+    {
+        rgfCos[s] = cosf(pfAngles[s]) * fInvScale;
+        rgfSin[s] = sinf(pfAngles[s]) * fInvScale;
+    }
+
+#ifdef GE_BATCH_SSE2
+    __m128 vCos = _mm_loadu_ps(rgfCos);
+    __m128 vSin = _mm_loadu_ps(rgfSin);
+    __m128 vSum = _mm_setzero_ps();
+    for (int i = 0; i < GE_NUM_POINTS; i += iStep)
+    {
+        __m128 vX = _mm_loadu_ps(lanes.rgfX[i]);
+        __m128 vY = _mm_loadu_ps(lanes.rgfY[i]);
+        __m128 x = _mm_sub_ps(_mm_mul_ps(vX, vCos), _mm_mul_ps(vY, vSin));
+        __m128 y = _mm_add_ps(_mm_mul_ps(vX, vSin), _mm_mul_ps(vY, vCos));
+        __m128 dx = _mm_sub_ps(x, _mm_set1_ps(bt.rgfX[i]));
+        __m128 dy = _mm_sub_ps(y, _mm_set1_ps(bt.rgfY[i]));
+        vSum = _mm_add_ps(vSum, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy))));
+    }
+    float rgfSum[GE_BATCH_LANES];
+    _mm_storeu_ps(rgfSum, vSum);
+#else
+    float rgfSum[GE_BATCH_LANES] = { 0 };
+    for (int i = 0; i < GE_NUM_POINTS; i += iStep)
+    {
+        for (int s = 0; s < GE_BATCH_LANES; s++)
+        {
+            float x = lanes.rgfX[i][s] * rgfCos[s] - lanes.rgfY[i][s] * rgfSin[s];
+            float y = lanes.rgfX[i][s] * rgfSin[s] + lanes.rgfY[i][s] * rgfCos[s];
+            float dx = x - bt.rgfX[i];
+            float dy = y - bt.rgfY[i];
+            rgfSum[s] += sqrtf(dx * dx + dy * dy);
+        }
+    }
+#endif
+
+    for (int s = 0; s < GE_BATCH_LANES; s++)
+        pfDist[s] = rgfSum[s] * bt.fScale * iStep / GE_NUM_POINTS;
+}
+
+/////////////////////////////////////////////////////////
+//
+// BatchGoldenSectionSearch
+//
+// GoldenSectionSearch for GE_BATCH_LANES strokes at once.
+// The interval shrinks by the same ratio whatever the
+// distances, so the searches take the same number of
+// steps, but for a rounding difference at the very end: a
+// search that's done keeps its values while the others
+// take their last step.
+//
+/////////////////////////////////////////////////////////
+static void BatchGoldenSectionSearch(
+        const BatchLanes& lanes,
+        const BatchTemplate& bt,
+        float fRange,
+        float fPrecision,
+        int iStep,
+        float* pfDist
+        )
+{
+    if (fRange <= 0.0f)
+    {
+        float rgfZero[GE_BATCH_LANES] = { 0 };
+        BatchDistanceAtAngles(lanes, bt, rgfZero, iStep, pfDist);
+        return;
+    }
+
+    const float fPhi = 0.61803399f;
+    float a[GE_BATCH_LANES], b[GE_BATCH_LANES];
+    float x1[GE_BATCH_LANES], x2[GE_BATCH_LANES];
+    float f1[GE_BATCH_LANES], f2[GE_BATCH_LANES];
+    float xNew[GE_BATCH_LANES], fNew[GE_BATCH_LANES];
+    int rgiStep[GE_BATCH_LANES];    // 0 if done, 1 if x1 is new, 2 if x2 is
+    for (int s = 0; s < GE_BATCH_LANES; s++)
+    {
+        a[s] = -fRange;
+        b[s] = fRange;
+        x1[s] = fPhi * a[s] + (1.0f - fPhi) * b[s];
+        x2[s] = (1.0f - fPhi) * a[s] + fPhi * b[s];
+    }
+    BatchDistanceAtAngles(lanes, bt, x1, iStep, f1);
+    BatchDistanceAtAngles(lanes, bt, x2, iStep, f2);
+
+    for (;;)
+    {
+        bool bActive = false;
+        for (int s = 0; s < GE_BATCH_LANES; s++)
+        {
+            rgiStep[s] = 0;
+            xNew[s] = x1[s];    // a search that's done evaluates a point it ignores
+            if (false == (b[s] - a[s] > fPrecision))
+                continue;
+            bActive = true;
+            if (f1[s] < f2[s])
+            {
+                b[s] = x2[s];
+                x2[s] = x1[s];
+                f2[s] = f1[s];
+                x1[s] = fPhi * a[s] + (1.0f - fPhi) * b[s];
+                xNew[s] = x1[s];
+                rgiStep[s] = 1;
+            }
+            else
+            {
+                a[s] = x1[s];
+                x1[s] = x2[s];
+                f1[s] = f2[s];
+                x2[s] = (1.0f - fPhi) * a[s] + fPhi * b[s];
+                xNew[s] = x2[s];
+                rgiStep[s] = 2;
+            }
+        }
+        if (false == bActive)
+            break;
+
+        BatchDistanceAtAngles(lanes, bt, xNew, iStep, fNew);
+        for (int s = 0; s < GE_BATCH_LANES; s++)
+        {
+            if (1 == rgiStep[s])
+                f1[s] = fNew[s];
+            else if (2 == rgiStep[s])
+                f2[s] = fNew[s];
+        }
+    }
+
+    for (int s = 0; s < GE_BATCH_LANES; s++)
+        pfDist[s] = (f1[s] < f2[s]) ? f1[s] : f2[s];
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEngine::ScoreFromDistance
+//
+// Maps an average point distance to a 0..1 score.
+//
+/////////////////////////////////////////////////////////
+float CGestureEngine::ScoreFromDistance(float fDistance)
+{
+    float fScore = 1.0f - fDistance / GE_HALF_DIAGONAL;
+    return (fScore > 0.0f) ? fScore : 0.0f;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEngine::GetFormatTemplateSize
+//
+// Returns the size of a template in the given storage
+// format, or 0 if the format is unknown.
+//
+/////////////////////////////////////////////////////////
+int CGestureEngine::GetFormatTemplateSize(int iFormat)
+{
+    switch (iFormat)
+    {
+        case GE_FORMAT_FLOAT32:     return sizeof(GestureTemplate);
+        case GE_FORMAT_FLOAT16:     return sizeof(GestureTemplateF16);
+        case GE_FORMAT_INT8:        return sizeof(GestureTemplateQ8);
+    }
+    return 0;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEngine::FloatToHalf
+//
+// Converts a float to IEEE 754 half precision, rounding to
+// nearest. Values out of the half range become infinities,
+// NaNs are not expected here.
+//
+/////////////////////////////////////////////////////////
+unsigned short CGestureEngine::FloatToHalf(float f)
+{
+    unsigned int u;
+    memcpy(&u, &f, sizeof(u));
+
+    unsigned int uSign = (u >> 16) & 0x8000;
+    int iExp = (int)((u >> 23) & 0xFF) - 127 + 15;
+    unsigned int uMant = u & 0x7FFFFF;
+
+    if (iExp <= 0)
+    {
+        // Subnormal half or zero
+        if (iExp < -10)
+            return (unsigned short)uSign;
+        uMant |= 0x800000;
+        int iShift = 14 - iExp;
+        unsigned int h = uMant >> iShift;
+        if ((uMant >> (iShift - 1)) & 1)
+            h++;
+        return (unsigned short)(uSign | h);
+    }
+    if (iExp >= 31)
+        return (unsigned short)(uSign | 0x7C00);
+
+    unsigned int h = uSign | ((unsigned int)iExp << 10) | (uMant >> 13);
+    if (uMant & 0x1000)
+        h++;    // a carry into the exponent is still the right result
+    return (unsigned short)h;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEngine::HalfToFloat
+//
+// Converts an IEEE 754 half precision number to a float.
+// The exponent is rebiased by a multiplication, which also
+// takes care of the subnormals.
+//
+/////////////////////////////////////////////////////////
+float CGestureEngine::HalfToFloat(unsigned short h)
+{
+    unsigned int u = (unsigned int)(h & 0x7FFF) << 13;
+    if (u >= (0x1Fu << 23))
+        u |= 0xFFu << 23;           // infinity or NaN
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    if (u < (0xFFu << 23))
+        f *= 5.192296858534828e+33f;    // 2^112
+    return (h & 0x8000) ? -f : f;
+}
+
+// Built-in shapes //////////////////////////////////////
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEngine::GetBuiltinShapeCount
+//
+// Returns the number of the built-in shapes. Some gestures
+// (Circle, Double Circle) have a shape per drawing direction.
+//
+/////////////////////////////////////////////////////////
+int CGestureEngine::GetBuiltinShapeCount()
+{
+    return countof(gc_rgShapes);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEngine::GetBuiltinShape
+//
+// Generates the points of a built-in shape in ink space
+// units, as a pen would produce them.
+//
+// Parameters:
+//     int iShape         : [in] 0..GetBuiltinShapeCount()-1
+//     int& iGesture      : [out] the gesture the shape stands for
+//     GesturePoint* ppt  : [out] the points
+//     int cMaxPoints     : [in] the size of the ppt array
+//
+// Return Values (int):
+//      the number of points generated, 0 if iShape is invalid
+//
+/////////////////////////////////////////////////////////
+int CGestureEngine::GetBuiltinShape(
+        int iShape,
+        int& iGesture,
+        GesturePoint* ppt,
+        int cMaxPoints
+        )
+{
+    if (iShape < 0 || iShape >= (int)countof(gc_rgShapes) || cMaxPoints < 2)
+        return 0;
+
+    const BuiltinShape& shape = gc_rgShapes[iShape];
+    iGesture = shape.iGesture;
+
+    int cPoints = 0;
+    switch (shape.iKind)
+    {
+        case SHAPE_POLYLINE:
+        {
+            // Spread the points over the segments in proportion to their length
+            float fLength = 0.0f;
+            for (int i = 1; i < shape.cVerts; i++)
+            {
+                float dx = shape.pfVerts[2 * i] - shape.pfVerts[2 * i - 2];
+                float dy = shape.pfVerts[2 * i + 1] - shape.pfVerts[2 * i - 1];
+                fLength += sqrtf(dx * dx + dy * dy);
+            }
+            float fStep = fLength / (cMaxPoints - shape.cVerts);
+            for (int i = 1; i < shape.cVerts; i++)
+            {
+                float x0 = shape.pfVerts[2 * i - 2], y0 = shape.pfVerts[2 * i - 1];
+                float x1 = shape.pfVerts[2 * i], y1 = shape.pfVerts[2 * i + 1];
+                float d = sqrtf((x1 - x0) * (x1 - x0) + (y1 - y0) * (y1 - y0));
+                int cSteps = (int)(d / fStep);
+                if (cSteps < 1)
+                    cSteps = 1;
+                for (int j = 0; j < cSteps && cPoints < cMaxPoints - 1; j++)
+                {
+                    float t = (float)j / cSteps;
+                    ppt[cPoints].x = (x0 + t * (x1 - x0)) * GE_BUILTIN_SIZE;
+                    ppt[cPoints].y = (y0 + t * (y1 - y0)) * GE_BUILTIN_SIZE;
+                    cPoints++;
+                }
+            }
+            ppt[cPoints].x = shape.pfVerts[2 * shape.cVerts - 2] * GE_BUILTIN_SIZE;
+            ppt[cPoints].y = shape.pfVerts[2 * shape.cVerts - 1] * GE_BUILTIN_SIZE;
+            cPoints++;
+            break;
+        }
+
+        case SHAPE_ARC:
+        {
+            for (cPoints = 0; cPoints < cMaxPoints; cPoints++)
+            {
+                float t = shape.fParam1 + shape.fParam2 * cPoints / (cMaxPoints - 1);
+                ppt[cPoints].x = (0.5f + 0.5f * cosf(t)) * GE_BUILTIN_SIZE;
+                ppt[cPoints].y = (0.5f + 0.5f * sinf(t)) * GE_BUILTIN_SIZE;
+            }
+            break;
+        }
+
+        case SHAPE_CURLICUE:
+        {
+            // A prolate cycloid: moves to the right making a loop per turn
+            float fSweep = 2 * GE_PI * shape.fParam1;
+            for (cPoints = 0; cPoints < cMaxPoints; cPoints++)
+            {
+                float t = fSweep * cPoints / (cMaxPoints - 1);
+                ppt[cPoints].x = (0.3f * t - sinf(t)) * GE_BUILTIN_SIZE / 4;
+                ppt[cPoints].y = (1.0f + cosf(t)) * GE_BUILTIN_SIZE / 4;
+            }
+            break;
+        }
+
+        case SHAPE_TAP:
+        {
+            ppt[0].x = ppt[0].y = GE_BUILTIN_SIZE / 2;
+            ppt[1].x = ppt[1].y = GE_BUILTIN_SIZE / 2 + 10.0f;
+            cPoints = 2;
+            break;
+        }
+    }
+
+    return cPoints;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEngine::GetGestureName
+//
+// Returns the English name of a gesture for the console
+// tools, or "unknown".
+//
+/////////////////////////////////////////////////////////
+const char* CGestureEngine::GetGestureName(int iGesture)
+{
+    if (iGesture < 0 || iGesture >= GE_NUM_SSGESTURES)
+        return "unknown";
+    return gc_pszGestureNames[iGesture];
+}
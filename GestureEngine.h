@@ -0,0 +1,221 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      GestureEngine.h
+//
+// Description:
+//      This file contains the definition of the CGestureEngine class,
+//      a native template matcher for the single stroke gestures listed
+//      in gc_igtSingleStrokeGestures. It doesn't depend on the Tablet PC
+//      Automation API, so it can run headless and on other platforms.
+//
+//      A stroke is resampled to GE_NUM_POINTS equidistant points, scaled
+//      uniformly into a square and centered at the origin. The gestures
+//      are direction sensitive (Up vs Down), so the rotation search is
+//      limited to a small range around the drawn orientation.
+//
+//      The methods of the class are defined in the GestureEngine.cpp file.
+//--------------------------------------------------------------------------
+
+#pragma once
+
+#include <stddef.h>
+
+#include "TemplateIndex.h"
+
+enum {
+    GE_NUM_POINTS = 64,         // the number of points of a resampled stroke
+    GE_SQUARE_SIZE = 250,       // the size of the normalized bounding box
+    GE_NUM_SSGESTURES = 36,     // the same order as gc_igtSingleStrokeGestures
+    GE_GESTURE_TAP = 35,        // the index of IAG_Tap in that table
+    GE_MAX_BATCH = 64,          // the strokes RecognizeBatch matches in one pass
+    GE_MAX_POINT_STEP = 8       // see SetPointStep
+};
+
+// The mask of all the gestures, a bit per gesture
+#define GE_ALL_GESTURES     ((1ULL << GE_NUM_SSGESTURES) - 1)
+
+// The default maximum extent of a tap, in ink space units
+#define GE_DEFAULT_TAP_EXTENT   150.0f
+
+// Template storage formats
+enum {
+    GE_FORMAT_FLOAT32 = 0,      // GestureTemplate
+    GE_FORMAT_FLOAT16 = 1,      // GestureTemplateF16, half precision coordinates
+    GE_FORMAT_INT8 = 2,         // GestureTemplateQ8, 8-bit coordinates with a scale
+    GE_NUM_FORMATS = 3
+};
+
+// A point of a stroke in ink space coordinates
+struct GesturePoint
+{
+    float   x;
+    float   y;
+};
+
+// A normalized template. The header is padded to 16 bytes, so the
+// points stay 16-byte aligned in arrays and in template pack files.
+struct GestureTemplate
+{
+    int             iGesture;       // index into the single stroke gesture table
+    int             rgiReserved[3];
+    GesturePoint    rgpt[GE_NUM_POINTS];
+};
+
+// A template with half precision (IEEE 754 binary16) coordinates.
+// The normalized coordinates are within +-GE_SQUARE_SIZE, where half
+// precision keeps about 3 significant decimal digits.
+struct GestureTemplateF16
+{
+    int             iGesture;
+    int             iReserved;
+    unsigned short  rgh[GE_NUM_POINTS * 2];     // x,y pairs
+};
+
+// A template with 8-bit coordinates. A coordinate is rgc[i] * fScale;
+// the scale is chosen per template so that its largest coordinate
+// maps to 127. 36 such templates take less than 5KB.
+struct GestureTemplateQ8
+{
+    int             iGesture;
+    float           fScale;
+    signed char     rgc[GE_NUM_POINTS * 2];     // x,y pairs
+};
+
+// A stroke of a batch
+struct GestureStroke
+{
+    const GesturePoint* ppt;
+    int                 cPoints;
+};
+
+// A recognition alternate
+struct GestureResult
+{
+    int     iGesture;       // index into the single stroke gesture table
+    int     iTemplate;      // the best matching template, -1 for a tap
+    float   fScore;         // 0..1, where 1 is a perfect match
+};
+
+struct BatchTemplate;
+
+/////////////////////////////////////////////////////////
+//
+// class CGestureEngine
+//
+// Holds the normalized templates with their coarse feature
+// vectors and recognizes strokes against them. The templates
+// are stored in one of the GE_FORMAT_ formats, chosen before
+// the first template is added; the smaller formats keep a
+// whole template set cache resident on low memory devices.
+// The feature vectors are always single precision. With the
+// candidate count set, the templates are pre-filtered by
+// a CTemplateIndex and only the candidates are matched,
+// which keeps the cost nearly flat in the number of
+// templates. The gestures out of the gesture mask are
+// never returned and their templates aren't matched.
+//
+// Recognize and RecognizeBatch are const and use no shared
+// scratch memory, so one engine can serve several threads.
+//
+/////////////////////////////////////////////////////////
+
+class CGestureEngine
+{
+    // Data members
+    unsigned char*      m_pbTemplates;      // m_cbTemplate bytes per template
+    int                 m_iFormat;          // GE_FORMAT_ constant
+    int                 m_cbTemplate;
+    float*              m_pfFeatures;       // GE_NUM_FEATURES floats per template
+    int                 m_cTemplates;
+    int                 m_cMaxTemplates;    // allocated capacity
+    bool                m_bOwnsTemplates;   // false if the data lives in a mapped file
+    CTemplateIndex      m_index;
+    int                 m_cCandidates;      // 0 for a linear scan over all templates
+    float               m_fTapExtent;       // max bounding box size of a tap, in ink units
+    float               m_fAngleRange;      // rotation search range, radians each way
+    float               m_fAnglePrecision;  // rotation search stop criterion, radians
+    int                 m_iPointStep;       // the resampled points matched, 1 in m_iPointStep
+    unsigned long long  m_ullGestures;      // the gestures recognized, a bit each
+
+public:
+
+    // Constructor and destructor
+    CGestureEngine();
+    ~CGestureEngine();
+
+    // Template set management
+    bool AddTemplate(int iGesture, const GesturePoint* ppt, int cPoints);
+    int  AddBuiltinTemplates();
+    void RemoveAllTemplates();
+    bool BuildIndex();
+    void AttachTemplates(const void* pvTemplates, int iFormat, const float* pfFeatures,
+                         int cTemplates, const VPNode* pNodes, int cNodes);
+    bool SetStorageFormat(int iFormat);
+    bool Copy(const CGestureEngine& engine);
+
+    // Data members access methods
+    int  GetTemplateCount() const { return m_cTemplates; }
+    int  GetStorageFormat() const { return m_iFormat; }
+    const void* GetTemplateData() const { return m_pbTemplates; }
+    int  GetTemplateSize() const { return m_cbTemplate; }
+    int  GetTemplateGesture(int iTemplate) const
+        { return *(const int*)(m_pbTemplates + (size_t)iTemplate * m_cbTemplate); }
+    void GetTemplatePoints(int iTemplate, GesturePoint* ppt) const;
+    const float* GetFeatures() const { return m_pfFeatures; }
+    const CTemplateIndex& GetIndex() const { return m_index; }
+    void SetCandidateCount(int cCandidates);
+    int  GetCandidateCount() const { return m_cCandidates; }
+    void SetTapExtent(float fExtent) { m_fTapExtent = fExtent; }
+    void SetAngleSearch(float fRange, float fPrecision);
+    void SetPointStep(int iStep);
+    int  GetPointStep() const { return m_iPointStep; }
+    void SetGestureMask(unsigned long long ullGestures) { m_ullGestures = ullGestures & GE_ALL_GESTURES; }
+    unsigned long long GetGestureMask() const { return m_ullGestures; }
+    bool IsGestureEnabled(int iGesture) const { return 0 != (m_ullGestures & (1ULL << iGesture)); }
+
+    // Recognition
+    int  Recognize(const GesturePoint* ppt, int cPoints,
+                   GestureResult* pResults, int cMaxResults) const;
+    int  RecognizeBatch(const GestureStroke* pStrokes, int cStrokes,
+                        GestureResult* pResults, int cMaxResults, int* pcResults) const;
+
+    // Stroke processing helpers, shared with the tools
+    static void  ResampleStroke(const GesturePoint* ppt, int cPoints,
+                                GesturePoint* pptOut, int cOut);
+    static void  NormalizeStroke(const GesturePoint* ppt, int cPoints,
+                                 GesturePoint* pptOut);
+    static void  ComputeFeatures(const GesturePoint* pptNorm, float* pfFeatures);
+    static float DistanceAtAngle(const GesturePoint* pptQuery,
+                                 const GesturePoint* pptTemplate, float fAngle,
+                                 int iStep = 1);
+    static float DistanceAtBestAngle(const GesturePoint* pptQuery,
+                                     const GesturePoint* pptTemplate,
+                                     float fRange, float fPrecision);
+    static float ScoreFromDistance(float fDistance);
+    static int   GetFormatTemplateSize(int iFormat);
+
+    // Half precision conversions
+    static unsigned short FloatToHalf(float f);
+    static float HalfToFloat(unsigned short h);
+
+    // The built-in gesture shapes, in unnormalized ink space
+    static int   GetBuiltinShapeCount();
+    static int   GetBuiltinShape(int iShape, int& iGesture,
+                                 GesturePoint* ppt, int cMaxPoints);
+    static const char* GetGestureName(int iGesture);
+
+private:
+
+    bool  IsTap(const GesturePoint* ppt, int cPoints) const;
+    float DistanceToTemplate(const GesturePoint* pptQuery, int iTemplate) const;
+    void  LoadBatchTemplate(int iTemplate, BatchTemplate& bt) const;
+    static int SortResults(const float* pfBest, const int* piBest,
+                           GestureResult* pResults, int cMaxResults);
+    void  StoreTemplate(int iTemplate, int iGesture, const GesturePoint* pptNorm);
+};
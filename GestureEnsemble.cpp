@@ -0,0 +1,1110 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      GestureEnsemble.cpp
+//
+// Description:
+//      The file contains the definitions of the methods of the backends
+//      and of CGestureEnsemble. See the file GestureEnsemble.h for the
+//      definitions of the classes.
+//--------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "GestureEnsemble.h"
+#include "Trace.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#include <pthread.h>
+#include <time.h>
+#endif
+
+#define GE_PI               3.14159265f
+
+// The band of the time warping, in points each way
+#define GE_DTW_BAND         (GE_NUM_POINTS / 8)
+
+// A mean chain code difference that scores 0, a quarter turn
+#define GE_CHAIN_MAX_DIFF   2.0f
+
+// The lock and the condition of a CGestureEnsemble
+struct EnsembleSync
+{
+#ifdef _WIN32
+    CRITICAL_SECTION    cs;
+    CONDITION_VARIABLE  cv;
+#else
+    pthread_mutex_t     mutex;
+    pthread_cond_t      cond;
+#endif
+};
+
+// A stroke given to the backends. The late backends may still use it
+// after Recognize returns, so it's freed by the last one done with it.
+// Guarded by the lock
+struct EnsembleJob
+{
+    int             cRefs;
+    int             cPending;       // the backends not done
+    GesturePoint*   ppt;
+    int             cPoints;
+    int             rgcResults[GE_MAX_BACKENDS];    // -1 until done
+    GestureResult   rgResults[GE_MAX_BACKENDS][GE_NUM_SSGESTURES];
+};
+
+// A backend of a CGestureEnsemble and its thread
+struct EnsembleWorker
+{
+    CGestureEnsemble*   pEnsemble;
+    IGestureBackend*    pBackend;
+    int                 iBackend;
+    float               fWeight;
+    EnsembleJob*        pJob;       // NULL if idle, guarded by the lock
+    BackendStats        stats;      // guarded by the lock
+#ifdef _WIN32
+    HANDLE              hThread;
+#else
+    pthread_t           thread;
+    bool                bThread;
+#endif
+};
+
+static void SyncInit(EnsembleSync* pSync)
+{
+#ifdef _WIN32
+    ::InitializeCriticalSection(&pSync->cs);
+    ::InitializeConditionVariable(&pSync->cv);
+#else
+    pthread_mutex_init(&pSync->mutex, NULL);
+    pthread_cond_init(&pSync->cond, NULL);
+#endif
+}
+
+static void SyncTerm(EnsembleSync* pSync)
+{
+#ifdef _WIN32
+    ::DeleteCriticalSection(&pSync->cs);
+#else
+    pthread_cond_destroy(&pSync->cond);
+    pthread_mutex_destroy(&pSync->mutex);
+#endif
+}
+
+static void SyncLock(EnsembleSync* pSync)
+{
+#ifdef _WIN32
+    ::EnterCriticalSection(&pSync->cs);
+#else
+    pthread_mutex_lock(&pSync->mutex);
+#endif
+}
+
+static void SyncUnlock(EnsembleSync* pSync)
+{
+#ifdef _WIN32
+    ::LeaveCriticalSection(&pSync->cs);
+#else
+    pthread_mutex_unlock(&pSync->mutex);
+#endif
+}
+
+static void SyncWakeAll(EnsembleSync* pSync)
+{
+#ifdef _WIN32
+    ::WakeAllConditionVariable(&pSync->cv);
+#else
+    pthread_cond_broadcast(&pSync->cond);
+#endif
+}
+
+/////////////////////////////////////////////////////////
+//
+// SyncWait
+//
+// Releases the lock, waits for a wake up or for the timeout
+// and takes the lock again. The wait may also end early, so
+// the callers check their condition again.
+//
+// Parameters:
+//     EnsembleSync* pSync : [in] the lock, taken
+//     PERFTIME ptTimeout  : [in] in nanoseconds, 0 to wait for a wake up
+//
+/////////////////////////////////////////////////////////
+static void SyncWait(EnsembleSync* pSync, PERFTIME ptTimeout)
+{
+#ifdef _WIN32
+    DWORD dwMs = (0 == ptTimeout) ? INFINITE : (DWORD)((ptTimeout + 999999) / 1000000);
+    ::SleepConditionVariableCS(&pSync->cv, &pSync->cs, dwMs);
+#else
+    if (0 == ptTimeout)
+    {
+        pthread_cond_wait(&pSync->cond, &pSync->mutex);
+    }
+    else
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        PERFTIME ptNs = (PERFTIME)ts.tv_nsec + ptTimeout;
+        ts.tv_sec += (time_t)(ptNs / 1000000000ULL);
+        ts.tv_nsec = (long)(ptNs % 1000000000ULL);
+        pthread_cond_timedwait(&pSync->cond, &pSync->mutex, &ts);
+    }
+#endif
+}
+
+/////////////////////////////////////////////////////////
+//
+// SortScores
+//
+// Lists the gestures with a score, best first.
+//
+// Parameters:
+//     const float* pfScores    : [in] GE_NUM_SSGESTURES scores, 0 for none
+//     GestureResult* pResults  : [out] the results
+//     int cMaxResults          : [in] the size of pResults
+//
+// Return Values (int):
+//      the number of results
+//
+/////////////////////////////////////////////////////////
+static int SortScores(const float* pfScores, GestureResult* pResults, int cMaxResults)
+{
+    int cResults = 0;
+    for (int g = 0; g < GE_NUM_SSGESTURES; g++)
+    {
+        if (pfScores[g] <= 0.0f)
+            continue;
+        int i = (cResults < cMaxResults) ? cResults++ : cMaxResults;
+        while (i > 0 && pResults[i - 1].fScore < pfScores[g])
+        {
+            if (i < cMaxResults)
+                pResults[i] = pResults[i - 1];
+            i--;
+        }
+        if (i < cMaxResults)
+        {
+            pResults[i].iGesture = g;
+            pResults[i].iTemplate = -1;
+            pResults[i].fScore = pfScores[g];
+        }
+    }
+    return cResults;
+}
+
+/////////////////////////////////////////////////////////
+//
+// IsTapStroke
+//
+// Return Values (bool):
+//      true if the stroke doesn't leave the box of a tap
+//
+/////////////////////////////////////////////////////////
+static bool IsTapStroke(const GesturePoint* ppt, int cPoints)
+{
+    float fMinX = ppt[0].x, fMaxX = ppt[0].x;
+    float fMinY = ppt[0].y, fMaxY = ppt[0].y;
+    for (int i = 1; i < cPoints; i++)
+    {
+        if (ppt[i].x < fMinX) fMinX = ppt[i].x;
+        if (ppt[i].x > fMaxX) fMaxX = ppt[i].x;
+        if (ppt[i].y < fMinY) fMinY = ppt[i].y;
+        if (ppt[i].y > fMaxY) fMaxY = ppt[i].y;
+    }
+    return (fMaxX - fMinX <= GE_DEFAULT_TAP_EXTENT && fMaxY - fMinY <= GE_DEFAULT_TAP_EXTENT);
+}
+
+/////////////////////////////////////////////////////////
+//
+// GetTapResult
+//
+// Votes for a tap as the template engine does, so a tap is
+// answered when any backend votes in time.
+//
+// Return Values (int):
+//      1, the number of results
+//
+/////////////////////////////////////////////////////////
+static int GetTapResult(GestureResult* pResults)
+{
+    pResults[0].iGesture = GE_GESTURE_TAP;
+    pResults[0].iTemplate = -1;
+    pResults[0].fScore = 1.0f;
+    return 1;
+}
+
+////////////////////////////////////////////////////////
+// CDtwBackend methods
+////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////
+//
+// CDtwBackend::CDtwBackend
+//
+// Constructor.
+//
+/////////////////////////////////////////////////////////
+CDtwBackend::CDtwBackend()
+    : m_pTemplates(NULL), m_cTemplates(0), m_cMaxTemplates(0), m_cBand(GE_DTW_BAND)
+{
+}
+
+/////////////////////////////////////////////////////////
+//
+// CDtwBackend::~CDtwBackend
+//
+// Destructor.
+//
+/////////////////////////////////////////////////////////
+CDtwBackend::~CDtwBackend()
+{
+    free(m_pTemplates);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CDtwBackend::AddTemplate
+//
+// Normalizes a stroke and adds it as a template.
+//
+// Parameters:
+//     int iGesture            : [in] index into the single stroke gesture table
+//     const GesturePoint* ppt : [in] the stroke points
+//     int cPoints             : [in] the number of points
+//
+// Return Values (bool):
+//      true if succeeded, false if the parameters are invalid or
+//      out of memory
+//
+/////////////////////////////////////////////////////////
+bool CDtwBackend::AddTemplate(
+        int iGesture,
+        const GesturePoint* ppt,
+        int cPoints
+        )
+{
+    if (iGesture < 0 || iGesture >= GE_NUM_SSGESTURES || NULL == ppt || cPoints < 2)
+        return false;
+    if (m_cTemplates == m_cMaxTemplates)
+    {
+        int cMax = (0 == m_cMaxTemplates) ? 64 : 2 * m_cMaxTemplates;
+        DtwTemplate* pNew = (DtwTemplate*)realloc(m_pTemplates, cMax * sizeof(DtwTemplate));
+        if (NULL == pNew)
+            return false;
+        m_pTemplates = pNew;
+        m_cMaxTemplates = cMax;
+    }
+    DtwTemplate& t = m_pTemplates[m_cTemplates++];
+    t.iGesture = iGesture;
+    CGestureEngine::NormalizeStroke(ppt, cPoints, t.rgpt);
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CDtwBackend::AddBuiltinTemplates
+//
+// Adds a template for each of the built-in gesture shapes
+// but the tap.
+//
+// Return Values (int):
+//      the number of templates added
+//
+/////////////////////////////////////////////////////////
+int CDtwBackend::AddBuiltinTemplates()
+{
+    GesturePoint rgpt[256];
+    int cAdded = 0;
+    for (int i = 0; i < CGestureEngine::GetBuiltinShapeCount(); i++)
+    {
+        int iGesture;
+        int cPoints = CGestureEngine::GetBuiltinShape(i, iGesture, rgpt, 256);
+        if (GE_GESTURE_TAP != iGesture && AddTemplate(iGesture, rgpt, cPoints))
+            cAdded++;
+    }
+    return cAdded;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CDtwBackend::Warp
+//
+// The time warping distance of two normalized strokes: the
+// least sum of the distances between matched points, the
+// matches moving forward on both strokes and at most
+// m_cBand points off the diagonal, divided by the number of
+// the points.
+//
+/////////////////////////////////////////////////////////
+float CDtwBackend::Warp(
+        const GesturePoint* pptQuery,
+        const GesturePoint* pptTemplate
+        ) const
+{
+    const float fInfinite = 1e30f;
+    float rgfPrev[GE_NUM_POINTS];
+    float rgfRow[GE_NUM_POINTS];
+    for (int j = 0; j < GE_NUM_POINTS; j++)
+        rgfPrev[j] = fInfinite;
+
+    for (int i = 0; i < GE_NUM_POINTS; i++)
+    {
+        int jFirst = (i - m_cBand > 0) ? i - m_cBand : 0;
+        int jLast = (i + m_cBand < GE_NUM_POINTS - 1) ? i + m_cBand : GE_NUM_POINTS - 1;
+        for (int j = 0; j < GE_NUM_POINTS; j++)
+            rgfRow[j] = fInfinite;
+        for (int j = jFirst; j <= jLast; j++)
+        {
+            float dx = pptQuery[i].x - pptTemplate[j].x;
+            float dy = pptQuery[i].y - pptTemplate[j].y;
+            float fCost = sqrtf(dx * dx + dy * dy);
+            float fBest;
+            if (0 == i && 0 == j)
+            {
+                fBest = 0.0f;
+            }
+            else
+            {
+                fBest = rgfPrev[j];
+                if (j > 0 && rgfPrev[j - 1] < fBest)
+                    fBest = rgfPrev[j - 1];
+                if (j > 0 && rgfRow[j - 1] < fBest)
+                    fBest = rgfRow[j - 1];
+            }
+            rgfRow[j] = fCost + fBest;
+        }
+        memcpy(rgfPrev, rgfRow, sizeof(rgfPrev));
+    }
+    return rgfPrev[GE_NUM_POINTS - 1] / GE_NUM_POINTS;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CDtwBackend::Recognize
+//
+// Warps the stroke to every template; the score of a
+// gesture comes from its closest template.
+//
+// Parameters:
+//     const GesturePoint* ppt  : [in] the stroke points
+//     int cPoints              : [in] the number of points
+//     GestureResult* pResults  : [out] the results, best first
+//     int cMaxResults          : [in] the size of pResults
+//
+// Return Values (int):
+//      the number of results, a single tap for a tap
+//
+/////////////////////////////////////////////////////////
+int CDtwBackend::Recognize(
+        const GesturePoint* ppt,
+        int cPoints,
+        GestureResult* pResults,
+        int cMaxResults
+        )
+{
+    if (NULL == ppt || cPoints <= 0 || NULL == pResults || cMaxResults <= 0)
+        return 0;
+    if (IsTapStroke(ppt, cPoints))
+        return GetTapResult(pResults);
+
+    GesturePoint rgpt[GE_NUM_POINTS];
+    CGestureEngine::NormalizeStroke(ppt, cPoints, rgpt);
+
+    float rgfScores[GE_NUM_SSGESTURES] = { 0.0f };
+    for (int t = 0; t < m_cTemplates; t++)
+    {
+        float fScore = CGestureEngine::ScoreFromDistance(Warp(rgpt, m_pTemplates[t].rgpt));
+        int iGesture = m_pTemplates[t].iGesture;
+        if (fScore > rgfScores[iGesture])
+            rgfScores[iGesture] = fScore;
+    }
+    return SortScores(rgfScores, pResults, cMaxResults);
+}
+
+////////////////////////////////////////////////////////
+// CChainCodeBackend methods
+////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////
+//
+// CChainCodeBackend::CChainCodeBackend
+//
+// Constructor.
+//
+/////////////////////////////////////////////////////////
+CChainCodeBackend::CChainCodeBackend()
+    : m_pTemplates(NULL), m_cTemplates(0), m_cMaxTemplates(0)
+{
+}
+
+/////////////////////////////////////////////////////////
+//
+// CChainCodeBackend::~CChainCodeBackend
+//
+// Destructor.
+//
+/////////////////////////////////////////////////////////
+CChainCodeBackend::~CChainCodeBackend()
+{
+    free(m_pTemplates);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CChainCodeBackend::ComputeChainCode
+//
+// The direction of every segment of a normalized stroke,
+// rounded to an eighth of a turn: 0 is right, 2 up (the
+// ink's y grows down), 4 left and 6 down.
+//
+// Parameters:
+//     const GesturePoint* pptNorm : [in] GE_NUM_POINTS normalized points
+//     unsigned char* pbCode       : [out] GE_NUM_POINTS - 1 directions
+//
+/////////////////////////////////////////////////////////
+void CChainCodeBackend::ComputeChainCode(
+        const GesturePoint* pptNorm,
+        unsigned char* pbCode
+        )
+{
+    for (int i = 0; i < GE_NUM_POINTS - 1; i++)
+    {
+        float fAngle = atan2f(pptNorm[i].y - pptNorm[i + 1].y, pptNorm[i + 1].x - pptNorm[i].x);
+        int iDir = (int)floorf(fAngle / (GE_PI / 4.0f) + 0.5f);
+        pbCode[i] = (unsigned char)((iDir + 8) & 7);
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CChainCodeBackend::AddTemplate
+//
+// Adds the chain code of a stroke as a template.
+//
+// Parameters:
+//     int iGesture            : [in] index into the single stroke gesture table
+//     const GesturePoint* ppt : [in] the stroke points
+//     int cPoints             : [in] the number of points
+//
+// Return Values (bool):
+//      true if succeeded, false if the parameters are invalid or
+//      out of memory
+//
+/////////////////////////////////////////////////////////
+bool CChainCodeBackend::AddTemplate(
+        int iGesture,
+        const GesturePoint* ppt,
+        int cPoints
+        )
+{
+    if (iGesture < 0 || iGesture >= GE_NUM_SSGESTURES || NULL == ppt || cPoints < 2)
+        return false;
+    if (m_cTemplates == m_cMaxTemplates)
+    {
+        int cMax = (0 == m_cMaxTemplates) ? 64 : 2 * m_cMaxTemplates;
+        ChainCodeTemplate* pNew =
+            (ChainCodeTemplate*)realloc(m_pTemplates, cMax * sizeof(ChainCodeTemplate));
+        if (NULL == pNew)
+            return false;
+        m_pTemplates = pNew;
+        m_cMaxTemplates = cMax;
+    }
+    GesturePoint rgpt[GE_NUM_POINTS];
+    CGestureEngine::NormalizeStroke(ppt, cPoints, rgpt);
+    ChainCodeTemplate& t = m_pTemplates[m_cTemplates++];
+    t.iGesture = iGesture;
+    ComputeChainCode(rgpt, t.rgbCode);
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CChainCodeBackend::AddBuiltinTemplates
+//
+// Adds a template for each of the built-in gesture shapes
+// but the tap.
+//
+// Return Values (int):
+//      the number of templates added
+//
+/////////////////////////////////////////////////////////
+int CChainCodeBackend::AddBuiltinTemplates()
+{
+    GesturePoint rgpt[256];
+    int cAdded = 0;
+    for (int i = 0; i < CGestureEngine::GetBuiltinShapeCount(); i++)
+    {
+        int iGesture;
+        int cPoints = CGestureEngine::GetBuiltinShape(i, iGesture, rgpt, 256);
+        if (GE_GESTURE_TAP != iGesture && AddTemplate(iGesture, rgpt, cPoints))
+            cAdded++;
+    }
+    return cAdded;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CChainCodeBackend::Recognize
+//
+// Compares the chain code of the stroke with every
+// template's; the score of a gesture comes from its
+// closest template.
+//
+// Parameters:
+//     const GesturePoint* ppt  : [in] the stroke points
+//     int cPoints              : [in] the number of points
+//     GestureResult* pResults  : [out] the results, best first
+//     int cMaxResults          : [in] the size of pResults
+//
+// Return Values (int):
+//      the number of results, a single tap for a tap
+//
+/////////////////////////////////////////////////////////
+int CChainCodeBackend::Recognize(
+        const GesturePoint* ppt,
+        int cPoints,
+        GestureResult* pResults,
+        int cMaxResults
+        )
+{
+    if (NULL == ppt || cPoints <= 0 || NULL == pResults || cMaxResults <= 0)
+        return 0;
+    if (IsTapStroke(ppt, cPoints))
+        return GetTapResult(pResults);
+
+    GesturePoint rgpt[GE_NUM_POINTS];
+    unsigned char rgbCode[GE_NUM_POINTS - 1];
+    CGestureEngine::NormalizeStroke(ppt, cPoints, rgpt);
+    ComputeChainCode(rgpt, rgbCode);
+
+    float rgfScores[GE_NUM_SSGESTURES] = { 0.0f };
+    for (int t = 0; t < m_cTemplates; t++)
+    {
+        const unsigned char* pbTemplate = m_pTemplates[t].rgbCode;
+        int cDiff = 0;
+        for (int i = 0; i < GE_NUM_POINTS - 1; i++)
+        {
+            int iDiff = (rgbCode[i] - pbTemplate[i]) & 7;
+            cDiff += (iDiff > 4) ? 8 - iDiff : iDiff;
+        }
+        float fScore = 1.0f - (float)cDiff / (GE_NUM_POINTS - 1) / GE_CHAIN_MAX_DIFF;
+        int iGesture = m_pTemplates[t].iGesture;
+        if (fScore > rgfScores[iGesture])
+            rgfScores[iGesture] = fScore;
+    }
+    return SortScores(rgfScores, pResults, cMaxResults);
+}
+
+////////////////////////////////////////////////////////
+// CPluginBackend methods
+////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////
+//
+// CPluginBackend::CPluginBackend
+//
+// Constructor.
+//
+/////////////////////////////////////////////////////////
+CPluginBackend::CPluginBackend()
+    : m_hModule(NULL), m_pApi(NULL), m_pvBackend(NULL)
+{
+}
+
+/////////////////////////////////////////////////////////
+//
+// CPluginBackend::~CPluginBackend
+//
+// Destructor.
+//
+/////////////////////////////////////////////////////////
+CPluginBackend::~CPluginBackend()
+{
+    Unload();
+}
+
+/////////////////////////////////////////////////////////
+//
+// CPluginBackend::Load
+//
+// Loads a backend library and creates its backend.
+//
+// Parameters:
+//     const char* pszPath : [in] the path of the library
+//
+// Return Values (bool):
+//      true if succeeded, false if the library can't be loaded,
+//      doesn't export GE_BACKEND_ENTRY_POINT, is of another
+//      version of the interface or fails to create its backend
+//
+/////////////////////////////////////////////////////////
+bool CPluginBackend::Load(
+        const char* pszPath
+        )
+{
+    Unload();
+
+    PFNGETGESTUREBACKEND pfnGet;
+#ifdef _WIN32
+    HMODULE hModule = ::LoadLibraryA(pszPath);
+    if (NULL == hModule)
+        return false;
+    m_hModule = hModule;
+    pfnGet = (PFNGETGESTUREBACKEND)::GetProcAddress(hModule, GE_BACKEND_ENTRY_POINT);
+#else
+    m_hModule = dlopen(pszPath, RTLD_NOW | RTLD_LOCAL);
+    if (NULL == m_hModule)
+        return false;
+    pfnGet = (PFNGETGESTUREBACKEND)dlsym(m_hModule, GE_BACKEND_ENTRY_POINT);
+#endif
+
+    m_pApi = (NULL != pfnGet) ? pfnGet() : NULL;
+    if (NULL == m_pApi || GE_BACKEND_API_VERSION != m_pApi->nVersion ||
+        NULL == m_pApi->pfnCreate || NULL == m_pApi->pfnDestroy || NULL == m_pApi->pfnRecognize ||
+        NULL == (m_pvBackend = m_pApi->pfnCreate()))
+    {
+        Unload();
+        return false;
+    }
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CPluginBackend::Unload
+//
+// Destroys the backend and unloads its library.
+//
+/////////////////////////////////////////////////////////
+void CPluginBackend::Unload()
+{
+    if (NULL != m_pvBackend)
+    {
+        m_pApi->pfnDestroy(m_pvBackend);
+        m_pvBackend = NULL;
+    }
+    m_pApi = NULL;
+    if (NULL != m_hModule)
+    {
+#ifdef _WIN32
+        ::FreeLibrary((HMODULE)m_hModule);
+#else
+        dlclose(m_hModule);
+#endif
+        m_hModule = NULL;
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CPluginBackend::GetName
+//
+// Return Values (const char*):
+//      the name the library gives, "plugin" if it gives none
+//
+/////////////////////////////////////////////////////////
+const char* CPluginBackend::GetName() const
+{
+    return (NULL != m_pApi && NULL != m_pApi->pszName) ? m_pApi->pszName : "plugin";
+}
+
+/////////////////////////////////////////////////////////
+//
+// CPluginBackend::Recognize
+//
+// Recognizes with the library's backend. The results are
+// checked, so a library can't make the fusion read out of
+// its arrays.
+//
+// Parameters:
+//     const GesturePoint* ppt  : [in] the stroke points
+//     int cPoints              : [in] the number of points
+//     GestureResult* pResults  : [out] the results, best first
+//     int cMaxResults          : [in] the size of pResults
+//
+// Return Values (int):
+//      the number of results, 0 if not loaded
+//
+/////////////////////////////////////////////////////////
+int CPluginBackend::Recognize(
+        const GesturePoint* ppt,
+        int cPoints,
+        GestureResult* pResults,
+        int cMaxResults
+        )
+{
+    if (NULL == m_pvBackend)
+        return 0;
+    int cResults = m_pApi->pfnRecognize(m_pvBackend, ppt, cPoints, pResults, cMaxResults);
+    if (cResults < 0)
+        return 0;
+    if (cResults > cMaxResults)
+        cResults = cMaxResults;
+
+    int cValid = 0;
+    for (int i = 0; i < cResults; i++)
+    {
+        if (pResults[i].iGesture >= 0 && pResults[i].iGesture < GE_NUM_SSGESTURES &&
+            pResults[i].fScore >= 0.0f && pResults[i].fScore <= 1.0f)
+        {
+            pResults[cValid++] = pResults[i];
+        }
+    }
+    return cValid;
+}
+
+////////////////////////////////////////////////////////
+// CGestureEnsemble methods
+////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEnsemble::CGestureEnsemble
+//
+// Constructor.
+//
+/////////////////////////////////////////////////////////
+CGestureEnsemble::CGestureEnsemble()
+    : m_pSync(NULL), m_pWorkers(NULL), m_cWorkers(0), m_bStop(false)
+{
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEnsemble::~CGestureEnsemble
+//
+// Destructor.
+//
+/////////////////////////////////////////////////////////
+CGestureEnsemble::~CGestureEnsemble()
+{
+    Stop();
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEnsemble::Start
+//
+// Starts a thread per backend.
+//
+// Parameters:
+//     IGestureBackend* const* ppBackends : [in] the backends, must
+//                                          outlive the ensemble
+//     const float* pfWeights             : [in] the weight of each
+//                                          backend's votes, NULL for 1
+//     int cBackends                      : [in] 1 to GE_MAX_BACKENDS
+//
+// Return Values (bool):
+//      true if all the threads started, false otherwise
+//
+/////////////////////////////////////////////////////////
+bool CGestureEnsemble::Start(
+        IGestureBackend* const* ppBackends,
+        const float* pfWeights,
+        int cBackends
+        )
+{
+    if (NULL != m_pSync || cBackends <= 0 || cBackends > GE_MAX_BACKENDS)
+        return false;
+
+    m_pSync = (EnsembleSync*)malloc(sizeof(EnsembleSync));
+    m_pWorkers = (EnsembleWorker*)calloc(cBackends, sizeof(EnsembleWorker));
+    if (NULL == m_pSync || NULL == m_pWorkers)
+    {
+        free(m_pSync);
+        free(m_pWorkers);
+        m_pSync = NULL;
+        m_pWorkers = NULL;
+        return false;
+    }
+    SyncInit(m_pSync);
+    m_bStop = false;
+
+    for (m_cWorkers = 0; m_cWorkers < cBackends; m_cWorkers++)
+    {
+        EnsembleWorker* pWorker = &m_pWorkers[m_cWorkers];
+        pWorker->pEnsemble = this;
+        pWorker->pBackend = ppBackends[m_cWorkers];
+        pWorker->iBackend = m_cWorkers;
+        pWorker->fWeight = (NULL != pfWeights) ? pfWeights[m_cWorkers] : 1.0f;
+#ifdef _WIN32
+        pWorker->hThread = ::CreateThread(NULL, 0, ThreadStart, pWorker, 0, NULL);
+        if (NULL == pWorker->hThread)
+            break;
+#else
+        pWorker->bThread = (0 == pthread_create(&pWorker->thread, NULL, ThreadStart, pWorker));
+        if (false == pWorker->bThread)
+            break;
+#endif
+    }
+    if (m_cWorkers < cBackends)
+    {
+        Stop();
+        return false;
+    }
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEnsemble::Stop
+//
+// Stops the threads, after the backends are done with the
+// strokes they're on.
+//
+/////////////////////////////////////////////////////////
+void CGestureEnsemble::Stop()
+{
+    if (NULL == m_pSync)
+        return;
+
+    SyncLock(m_pSync);
+    m_bStop = true;
+    SyncWakeAll(m_pSync);
+    SyncUnlock(m_pSync);
+
+    for (int i = 0; i < m_cWorkers; i++)
+    {
+#ifdef _WIN32
+        ::WaitForSingleObject(m_pWorkers[i].hThread, INFINITE);
+        ::CloseHandle(m_pWorkers[i].hThread);
+#else
+        pthread_join(m_pWorkers[i].thread, NULL);
+#endif
+    }
+
+    SyncTerm(m_pSync);
+    free(m_pSync);
+    free(m_pWorkers);
+    m_pSync = NULL;
+    m_pWorkers = NULL;
+    m_cWorkers = 0;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEnsemble::Recognize
+//
+// Gives a stroke to every idle backend, waits for their
+// votes up to the budget and fuses the votes that came in.
+// A backend still on an earlier stroke doesn't vote; one
+// that misses the budget finishes the stroke on its own
+// and its vote is dropped.
+//
+// Parameters:
+//     const GesturePoint* ppt  : [in] the stroke points
+//     int cPoints              : [in] the number of points
+//     int iBudgetUs            : [in] the time to wait for the votes,
+//                                in microseconds; the platform's
+//                                timer may round it up
+//     GestureResult* pResults  : [out] the results, best first
+//     int cMaxResults          : [in] the size of pResults
+//     unsigned int* puVoters   : [out] if not NULL, a bit per backend
+//                                that voted in time
+//
+// Return Values (int):
+//      the number of results, 0 if no backend voted in time
+//
+/////////////////////////////////////////////////////////
+int CGestureEnsemble::Recognize(
+        const GesturePoint* ppt,
+        int cPoints,
+        int iBudgetUs,
+        GestureResult* pResults,
+        int cMaxResults,
+        unsigned int* puVoters
+        )
+{
+    if (NULL != puVoters)
+        *puVoters = 0;
+    if (NULL == m_pSync || NULL == ppt || cPoints <= 0 || NULL == pResults || cMaxResults <= 0)
+        return 0;
+
+    TRACE_SCOPE("Ensemble recognize");
+    PERFTIME ptDeadline = PerfNow() + (PERFTIME)iBudgetUs * 1000;
+
+    EnsembleJob* pJob = (EnsembleJob*)malloc(sizeof(EnsembleJob));
+    GesturePoint* pptCopy = (GesturePoint*)malloc(cPoints * sizeof(GesturePoint));
+    if (NULL == pJob || NULL == pptCopy)
+    {
+        free(pJob);
+        free(pptCopy);
+        return 0;
+    }
+    memcpy(pptCopy, ppt, cPoints * sizeof(GesturePoint));
+    pJob->cRefs = 1;
+    pJob->cPending = 0;
+    pJob->ppt = pptCopy;
+    pJob->cPoints = cPoints;
+
+    SyncLock(m_pSync);
+    for (int i = 0; i < m_cWorkers; i++)
+    {
+        pJob->rgcResults[i] = -1;
+        if (NULL == m_pWorkers[i].pJob)
+        {
+            m_pWorkers[i].pJob = pJob;
+            pJob->cRefs++;
+            pJob->cPending++;
+        }
+        else
+        {
+            m_pWorkers[i].stats.cBusy++;
+        }
+    }
+    SyncWakeAll(m_pSync);
+
+    while (pJob->cPending > 0)
+    {
+        PERFTIME ptNow = PerfNow();
+        if (ptNow >= ptDeadline)
+            break;
+        SyncWait(m_pSync, ptDeadline - ptNow);
+    }
+
+    // Fuse the votes in
+    float rgfScores[GE_NUM_SSGESTURES] = { 0.0f };
+    float fWeights = 0.0f;
+    unsigned int uVoters = 0;
+    for (int i = 0; i < m_cWorkers; i++)
+    {
+        if (pJob->rgcResults[i] < 0)
+        {
+            if (m_pWorkers[i].pJob == pJob)
+                m_pWorkers[i].stats.cLate++;
+            continue;
+        }
+        m_pWorkers[i].stats.cVotes++;
+        uVoters |= 1u << i;
+        fWeights += m_pWorkers[i].fWeight;
+        for (int r = 0; r < pJob->rgcResults[i]; r++)
+        {
+            const GestureResult& result = pJob->rgResults[i][r];
+            rgfScores[result.iGesture] += m_pWorkers[i].fWeight * result.fScore;
+        }
+    }
+    bool bFree = (0 == --pJob->cRefs);
+    SyncUnlock(m_pSync);
+
+    if (bFree)
+    {
+        free(pJob->ppt);
+        free(pJob);
+    }
+
+    if (NULL != puVoters)
+        *puVoters = uVoters;
+    if (fWeights <= 0.0f)
+        return 0;
+    for (int g = 0; g < GE_NUM_SSGESTURES; g++)
+        rgfScores[g] /= fWeights;
+    return SortScores(rgfScores, pResults, cMaxResults);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEnsemble::GetStats
+//
+// Parameters:
+//     int iBackend         : [in] the backend, in the order of Start
+//     BackendStats& stats  : [out] its counts
+//
+/////////////////////////////////////////////////////////
+void CGestureEnsemble::GetStats(
+        int iBackend,
+        BackendStats& stats
+        ) const
+{
+    memset(&stats, 0, sizeof(stats));
+    if (NULL == m_pSync || iBackend < 0 || iBackend >= m_cWorkers)
+        return;
+    SyncLock(m_pSync);
+    stats = m_pWorkers[iBackend].stats;
+    SyncUnlock(m_pSync);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEnsemble::ThreadStart
+//
+// The entry point of a backend's thread.
+//
+/////////////////////////////////////////////////////////
+#ifdef _WIN32
+DWORD WINAPI CGestureEnsemble::ThreadStart(void* pvWorker)
+{
+    EnsembleWorker* pWorker = (EnsembleWorker*)pvWorker;
+    pWorker->pEnsemble->WorkerProc(pWorker);
+    return 0;
+}
+#else
+void* CGestureEnsemble::ThreadStart(void* pvWorker)
+{
+    EnsembleWorker* pWorker = (EnsembleWorker*)pvWorker;
+    pWorker->pEnsemble->WorkerProc(pWorker);
+    return NULL;
+}
+#endif
+
+/////////////////////////////////////////////////////////
+//
+// CGestureEnsemble::WorkerProc
+//
+// The loop of a backend's thread: recognizes the strokes it
+// gets, one at a time, and puts the results in the job,
+// late or not. The last one done with a job frees it.
+//
+// Parameters:
+//     EnsembleWorker* pWorker : [in] the backend and its state
+//
+/////////////////////////////////////////////////////////
+void CGestureEnsemble::WorkerProc(
+        EnsembleWorker* pWorker
+        )
+{
+    GestureResult rgResults[GE_NUM_SSGESTURES];
+
+    SyncLock(m_pSync);
+    for (;;)
+    {
+        while (false == m_bStop && NULL == pWorker->pJob)
+            SyncWait(m_pSync, 0);
+        if (NULL == pWorker->pJob)
+            break;
+        EnsembleJob* pJob = pWorker->pJob;
+        SyncUnlock(m_pSync);
+
+        PERFTIME ptStart = PerfNow();
+        int cResults = pWorker->pBackend->Recognize(pJob->ppt, pJob->cPoints,
+                                                    rgResults, GE_NUM_SSGESTURES);
+        PERFTIME ptBusy = PerfNow() - ptStart;
+        if (cResults < 0)
+            cResults = 0;
+
+        SyncLock(m_pSync);
+        memcpy(pJob->rgResults[pWorker->iBackend], rgResults, cResults * sizeof(GestureResult));
+        pJob->rgcResults[pWorker->iBackend] = cResults;
+        pJob->cPending--;
+        pWorker->stats.ptBusy += ptBusy;
+        pWorker->pJob = NULL;
+        if (0 == --pJob->cRefs)
+        {
+            free(pJob->ppt);
+            free(pJob);
+        }
+        SyncWakeAll(m_pSync);
+    }
+    SyncUnlock(m_pSync);
+}
@@ -0,0 +1,302 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      GestureEnsemble.h
+//
+// Description:
+//      This file contains the definitions of the gesture recognizer
+//      ensemble: several recognizers, the backends, each recognize a
+//      stroke and their votes are fused into one list of gestures.
+//
+//      A backend is an IGestureBackend. The built-in ones are the
+//      template matcher of CGestureEngine (CTemplateBackend), dynamic
+//      time warping over the same shapes (CDtwBackend) and a match of
+//      Freeman chain codes (CChainCodeBackend). A backend can also live
+//      in a shared library (CPluginBackend): the library exports a C
+//      function, GetGestureBackend, that returns a GestureBackendApi,
+//      so it can be built with any compiler.
+//
+//      CGestureEnsemble runs every backend on a thread of its own and
+//      gives each stroke to all of them at once. The answer is due
+//      within a latency budget: the votes that are in when it expires
+//      are fused, the late ones are dropped, and a backend that's still
+//      on an earlier stroke sits the next ones out, so a slow backend
+//      never delays the answer.
+//
+//      The methods of the classes are defined in the GestureEnsemble.cpp
+//      file.
+//--------------------------------------------------------------------------
+
+#pragma once
+
+#include "PerfTimer.h"
+#include "GestureEngine.h"
+
+enum {
+    GE_MAX_BACKENDS = 8,
+    GE_BACKEND_API_VERSION = 1
+};
+
+// The name of the function a backend library exports
+#define GE_BACKEND_ENTRY_POINT  "GetGestureBackend"
+
+// The interface of a backend in a shared library. The scores are in
+// [0, 1], higher is better, with a result per gesture at most, best
+// first. Create and Destroy are called on any thread, Recognize on one
+// thread at a time.
+extern "C" {
+
+struct GestureBackendApi
+{
+    int             nVersion;       // GE_BACKEND_API_VERSION
+    const char*     pszName;
+    void*           (*pfnCreate)(void);
+    void            (*pfnDestroy)(void* pvBackend);
+    int             (*pfnRecognize)(void* pvBackend, const GesturePoint* ppt, int cPoints,
+                                    GestureResult* pResults, int cMaxResults);
+};
+
+typedef const GestureBackendApi* (*PFNGETGESTUREBACKEND)(void);
+
+}
+
+/////////////////////////////////////////////////////////
+//
+// class IGestureBackend
+//
+// A recognizer of the ensemble. Recognize gives at most a
+// result per gesture, best first, with scores in [0, 1]
+// so they can be added up; it's called on the backend's
+// own thread only.
+//
+/////////////////////////////////////////////////////////
+
+class IGestureBackend
+{
+public:
+
+    virtual ~IGestureBackend() {}
+
+    virtual const char* GetName() const = 0;
+    virtual int  Recognize(const GesturePoint* ppt, int cPoints,
+                           GestureResult* pResults, int cMaxResults) = 0;
+};
+
+/////////////////////////////////////////////////////////
+//
+// class CTemplateBackend
+//
+// The template matcher of an engine, as a backend.
+//
+/////////////////////////////////////////////////////////
+
+class CTemplateBackend : public IGestureBackend
+{
+    const CGestureEngine&   m_engine;
+
+public:
+
+    CTemplateBackend(const CGestureEngine& engine) : m_engine(engine) {}
+
+    virtual const char* GetName() const { return "template"; }
+    virtual int  Recognize(const GesturePoint* ppt, int cPoints,
+                           GestureResult* pResults, int cMaxResults)
+        { return m_engine.Recognize(ppt, cPoints, pResults, cMaxResults); }
+};
+
+// A template of a CDtwBackend
+struct DtwTemplate
+{
+    int             iGesture;
+    GesturePoint    rgpt[GE_NUM_POINTS];    // normalized as by CGestureEngine
+};
+
+/////////////////////////////////////////////////////////
+//
+// class CDtwBackend
+//
+// Matches the normalized points of a stroke with those of
+// the templates by dynamic time warping, in a band around
+// the diagonal, so a stroke drawn faster in places (fewer
+// points on a part of the shape) still lines up. Votes
+// for a tap as the template matcher does, so a tap has an
+// answer when the template matcher is late.
+//
+/////////////////////////////////////////////////////////
+
+class CDtwBackend : public IGestureBackend
+{
+    DtwTemplate*    m_pTemplates;
+    int             m_cTemplates;
+    int             m_cMaxTemplates;
+    int             m_cBand;            // the points a match may be off by
+
+public:
+
+    // Constructor and destructor
+    CDtwBackend();
+    ~CDtwBackend();
+
+    bool AddTemplate(int iGesture, const GesturePoint* ppt, int cPoints);
+    int  AddBuiltinTemplates();
+
+    virtual const char* GetName() const { return "dtw"; }
+    virtual int  Recognize(const GesturePoint* ppt, int cPoints,
+                           GestureResult* pResults, int cMaxResults);
+
+private:
+
+    float Warp(const GesturePoint* pptQuery, const GesturePoint* pptTemplate) const;
+
+    // Not copyable
+    CDtwBackend(const CDtwBackend&);
+    CDtwBackend& operator=(const CDtwBackend&);
+};
+
+// A template of a CChainCodeBackend: the direction of every segment
+// of the normalized points, 0 (right) to 7 counterclockwise
+struct ChainCodeTemplate
+{
+    int             iGesture;
+    unsigned char   rgbCode[GE_NUM_POINTS - 1];
+};
+
+/////////////////////////////////////////////////////////
+//
+// class CChainCodeBackend
+//
+// Matches the Freeman chain codes of the strokes: the
+// mean difference between the directions of the matching
+// segments, an eighth of a turn each. Cheap, blind to the
+// size and the position, and to the proportions more than
+// the other backends. Votes for a tap as the template
+// matcher does.
+//
+/////////////////////////////////////////////////////////
+
+class CChainCodeBackend : public IGestureBackend
+{
+    ChainCodeTemplate*  m_pTemplates;
+    int                 m_cTemplates;
+    int                 m_cMaxTemplates;
+
+public:
+
+    // Constructor and destructor
+    CChainCodeBackend();
+    ~CChainCodeBackend();
+
+    bool AddTemplate(int iGesture, const GesturePoint* ppt, int cPoints);
+    int  AddBuiltinTemplates();
+
+    virtual const char* GetName() const { return "chaincode"; }
+    virtual int  Recognize(const GesturePoint* ppt, int cPoints,
+                           GestureResult* pResults, int cMaxResults);
+
+    static void ComputeChainCode(const GesturePoint* pptNorm, unsigned char* pbCode);
+
+private:
+
+    // Not copyable
+    CChainCodeBackend(const CChainCodeBackend&);
+    CChainCodeBackend& operator=(const CChainCodeBackend&);
+};
+
+/////////////////////////////////////////////////////////
+//
+// class CPluginBackend
+//
+// A backend in a shared library, a DLL on Windows.
+//
+/////////////////////////////////////////////////////////
+
+class CPluginBackend : public IGestureBackend
+{
+    void*                       m_hModule;
+    const GestureBackendApi*    m_pApi;
+    void*                       m_pvBackend;
+
+public:
+
+    // Constructor and destructor
+    CPluginBackend();
+    ~CPluginBackend();
+
+    bool Load(const char* pszPath);
+    void Unload();
+    bool IsLoaded() const { return (NULL != m_pvBackend); }
+
+    virtual const char* GetName() const;
+    virtual int  Recognize(const GesturePoint* ppt, int cPoints,
+                           GestureResult* pResults, int cMaxResults);
+
+private:
+
+    // Not copyable
+    CPluginBackend(const CPluginBackend&);
+    CPluginBackend& operator=(const CPluginBackend&);
+};
+
+// The counts of a backend in a CGestureEnsemble
+struct BackendStats
+{
+    long            cVotes;         // in time
+    long            cLate;          // past the budget, dropped
+    long            cBusy;          // still on an earlier stroke, skipped
+    PERFTIME        ptBusy;         // the time spent recognizing
+};
+
+/////////////////////////////////////////////////////////
+//
+// class CGestureEnsemble
+//
+// Runs the backends, a thread each, on every stroke and
+// fuses their votes: the score of a gesture is the mean
+// of its scores in the backends that voted in time,
+// weighted, a backend that didn't list the gesture giving
+// it 0. Recognize is called by one thread at a time.
+//
+/////////////////////////////////////////////////////////
+
+class CGestureEnsemble
+{
+    struct EnsembleSync*    m_pSync;        // the lock and condition
+    struct EnsembleWorker*  m_pWorkers;
+    int                     m_cWorkers;
+    bool                    m_bStop;        // guarded by the lock
+
+public:
+
+    // Constructor and destructor
+    CGestureEnsemble();
+    ~CGestureEnsemble();
+
+    bool Start(IGestureBackend* const* ppBackends, const float* pfWeights, int cBackends);
+    void Stop();
+    bool IsStarted() const { return (NULL != m_pSync); }
+    int  GetBackendCount() const { return m_cWorkers; }
+
+    int  Recognize(const GesturePoint* ppt, int cPoints, int iBudgetUs,
+                   GestureResult* pResults, int cMaxResults,
+                   unsigned int* puVoters = NULL);
+
+    void GetStats(int iBackend, BackendStats& stats) const;
+
+private:
+
+    void WorkerProc(struct EnsembleWorker* pWorker);
+#ifdef _WIN32
+    static DWORD WINAPI ThreadStart(void* pvWorker);
+#else
+    static void* ThreadStart(void* pvWorker);
+#endif
+
+    // Not copyable
+    CGestureEnsemble(const CGestureEnsemble&);
+    CGestureEnsemble& operator=(const CGestureEnsemble&);
+};
@@ -0,0 +1,209 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      GesturePack.cpp
+//
+// Description:
+//      The offline tool that bakes gesture templates into a template
+//      pack (see TemplatePack.h). The recognizer processes map the
+//      pack at startup instead of normalizing every template and
+//      building the index on each launch.
+//
+//      Usage:
+//          GesturePack [-s strokes.txt] [-n count] [-f format] output.gpk
+//          GesturePack -i input.gpk
+//
+//          -s  adds user templates from a text file, one stroke per line:
+//              the gesture index (0..35, see gc_igtSingleStrokeGestures)
+//              followed by the x and y coordinates of the points
+//          -n  tops the template set up to count synthetic templates
+//              (for load testing)
+//          -f  the template storage format: float32 (the default),
+//              float16 or int8
+//          -i  prints the header of an existing pack and checks that it
+//              can be mapped
+//
+//--------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "PerfTimer.h"
+#include "GestureEngine.h"
+#include "TemplatePack.h"
+#include "SyntheticInk.h"
+
+// A useful macro to determine the number of elements in the array
+#ifndef countof
+#define countof(array)  (sizeof(array)/sizeof(array[0]))
+#endif
+
+// The names of the storage formats, indexed by the GE_FORMAT_ constants
+static const char* const gc_pszFormats[GE_NUM_FORMATS] = { "float32", "float16", "int8" };
+
+// The maximum number of points of a stroke read from a text file
+#define PACK_MAX_POINTS     4096
+
+/////////////////////////////////////////////////////////
+//
+// AddStrokesFromFile
+//
+// Reads the user templates from a text file into the engine.
+//
+// Return Values (int):
+//      the number of templates added, -1 if the file can't be read
+//
+/////////////////////////////////////////////////////////
+static int AddStrokesFromFile(CGestureEngine& engine, const char* pszFileName)
+{
+    FILE* pFile = fopen(pszFileName, "r");
+    if (NULL == pFile)
+        return -1;
+
+    static GesturePoint s_rgpt[PACK_MAX_POINTS];
+    static char s_szLine[PACK_MAX_POINTS * 24];
+    int cAdded = 0;
+    int iLine = 0;
+    while (NULL != fgets(s_szLine, sizeof(s_szLine), pFile))
+    {
+        iLine++;
+        char* psz = s_szLine;
+        char* pszEnd;
+        long iGesture = strtol(psz, &pszEnd, 10);
+        if (pszEnd == psz)
+            continue;   // an empty or a comment line
+
+        int cPoints = 0;
+        for (psz = pszEnd; cPoints < PACK_MAX_POINTS; psz = pszEnd)
+        {
+            float x = (float)strtod(psz, &pszEnd);
+            if (pszEnd == psz)
+                break;
+            psz = pszEnd;
+            float y = (float)strtod(psz, &pszEnd);
+            if (pszEnd == psz)
+                break;
+            s_rgpt[cPoints].x = x;
+            s_rgpt[cPoints].y = y;
+            cPoints++;
+        }
+
+        if (engine.AddTemplate((int)iGesture, s_rgpt, cPoints))
+        {
+            cAdded++;
+        }
+        else
+        {
+            fprintf(stderr, "%s(%d): invalid template, skipped\n", pszFileName, iLine);
+        }
+    }
+
+    fclose(pFile);
+    return cAdded;
+}
+
+/////////////////////////////////////////////////////////
+//
+// PrintPackInfo
+//
+// Maps an existing pack and prints its header.
+//
+/////////////////////////////////////////////////////////
+static int PrintPackInfo(const char* pszFileName)
+{
+    CTemplatePack pack;
+    PERFTIME ptStart = PerfNow();
+    if (false == pack.Open(pszFileName))
+    {
+        fprintf(stderr, "%s: not a valid template pack for this engine\n", pszFileName);
+        return 1;
+    }
+    PERFTIME ptOpen = PerfNow() - ptStart;
+
+    const TemplatePackHeader* pHeader = pack.GetHeader();
+    printf("%s: version %u, %u %s templates, %u index nodes, %llu bytes\n",
+           pszFileName, pHeader->uVersion, pHeader->cTemplates,
+           gc_pszFormats[pHeader->uFormat], pHeader->cNodes, pHeader->cbFile);
+    printf("  templates at %llu, features at %llu, nodes at %llu\n",
+           pHeader->ullTemplatesOffset, pHeader->ullFeaturesOffset, pHeader->ullNodesOffset);
+    printf("  mapped in %.1f us\n", ptOpen / 1000.0);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    const char* pszStrokes = NULL;
+    const char* pszOutput = NULL;
+    int cTemplates = 0;
+    int iFormat = GE_FORMAT_FLOAT32;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "-i") && i + 1 < argc)
+            return PrintPackInfo(argv[i + 1]);
+        else if (0 == strcmp(argv[i], "-s") && i + 1 < argc)
+            pszStrokes = argv[++i];
+        else if (0 == strcmp(argv[i], "-n") && i + 1 < argc)
+            cTemplates = atoi(argv[++i]);
+        else if (0 == strcmp(argv[i], "-f") && i + 1 < argc)
+        {
+            for (iFormat = GE_NUM_FORMATS - 1; iFormat > 0; iFormat--)
+            {
+                if (0 == strcmp(argv[i + 1], gc_pszFormats[iFormat]))
+                    break;
+            }
+            i++;
+        }
+        else if ('-' != argv[i][0])
+            pszOutput = argv[i];
+        else
+        {
+            pszOutput = NULL;   // unknown option, print the usage
+            break;
+        }
+    }
+
+    if (NULL == pszOutput)
+    {
+        printf("usage: GesturePack [-s strokes.txt] [-n count] [-f format] output.gpk\n"
+               "       GesturePack -i input.gpk\n");
+        return 1;
+    }
+
+    CGestureEngine engine;
+    engine.SetStorageFormat(iFormat);
+    engine.AddBuiltinTemplates();
+
+    if (NULL != pszStrokes && AddStrokesFromFile(engine, pszStrokes) < 0)
+    {
+        fprintf(stderr, "%s: can't read the file\n", pszStrokes);
+        return 1;
+    }
+
+    CSyntheticInk ink(12345);
+    GesturePoint rgpt[256];
+    for (int i = 0; engine.GetTemplateCount() < cTemplates; i++)
+    {
+        int iGesture;
+        int cPoints = ink.MakeStroke(i % CGestureEngine::GetBuiltinShapeCount(),
+                                     iGesture, rgpt, countof(rgpt));
+        if (GE_GESTURE_TAP != iGesture)
+        {
+            engine.AddTemplate(iGesture, rgpt, cPoints);
+        }
+    }
+
+    if (false == engine.BuildIndex() || false == CTemplatePack::Write(engine, pszOutput))
+    {
+        fprintf(stderr, "%s: failed to write the pack\n", pszOutput);
+        return 1;
+    }
+
+    return PrintPackInfo(pszOutput);
+}
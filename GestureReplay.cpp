@@ -0,0 +1,398 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      GestureReplay.cpp
+//
+// Description:
+//      A console tool that replays an input log (see InputLog.h) through
+//      the native gesture engine and reports the recognition latency and
+//      how often the replayed gestures agree with the recorded ones. The
+//      logs are recorded by the sample application ("gesture.exe -record
+//      input.log") or synthesized by this tool.
+//
+//      Usage:
+//          GestureReplay [-realtime] [-p pack.gpk] [-maxp99 us]
+//                        [-decimate tolerance] [-trace trace.json] input.log
+//          GestureReplay -g count output.log
+//          GestureReplay -archive output.ink input.log
+//
+//          -realtime   delivers the events at their recorded times; by
+//                      default they're delivered as fast as possible
+//          -p          recognizes with the templates of a template pack
+//                      instead of the built-in templates
+//          -maxp99     exits with 2 if the 99th percentile latency exceeds
+//                      the given number of microseconds (for regression runs)
+//          -decimate   decimates every stroke with the given tolerance, in
+//                      ink units, before it's recognized (see
+//                      StrokeDecimator.h), as the application does, and
+//                      reports how many points are kept
+//          -trace      writes the trace points of the replay (see Trace.h)
+//                      to a Chrome trace file
+//          -g          writes a log of count synthetic strokes, drawn at a
+//                      pen-like rate, each followed by its true gesture
+//          -archive    writes the strokes of the log, their packets with
+//                      the times in milliseconds, to an ink archive (see
+//                      InkCodec.h), reads it back and reports its size
+//
+//--------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "PerfTimer.h"
+#include "GestureEngine.h"
+#include "TemplatePack.h"
+#include "Trace.h"
+#include "SyntheticInk.h"
+#include "InputLog.h"
+#include "InkCodec.h"
+
+// A useful macro to determine the number of elements in the array
+#ifndef countof
+#define countof(array)  (sizeof(array)/sizeof(array[0]))
+#endif
+
+// The pace of the synthetic logs: a packet every 7.5 ms (133 Hz, a typical
+// digitizer), and a pause between the strokes
+#define REPLAY_PACKET_INTERVAL  7500000ULL
+#define REPLAY_STROKE_PAUSE     400000000ULL
+
+/////////////////////////////////////////////////////////
+//
+// WriteSyntheticLog
+//
+// Writes a log of cStrokes synthetic strokes over all the
+// built-in shapes, with the gesture events telling the true
+// gestures and a clear command after each of them, the way
+// the application logs a session.
+//
+/////////////////////////////////////////////////////////
+static int WriteSyntheticLog(int cStrokes, const char* pszFileName)
+{
+    CInputLog log;
+    CSyntheticInk ink(2024);
+    GesturePoint rgpt[256];
+    PERFTIME ptTime = 0;
+
+    for (int i = 0; i < GE_NUM_SSGESTURES; i++)
+    {
+        log.Append(ptTime, IE_GESTURE_STATUS, i, 1);
+    }
+
+    for (int i = 0; i < cStrokes; i++)
+    {
+        int iGesture;
+        int cPoints = ink.MakeStroke(i % CGestureEngine::GetBuiltinShapeCount(),
+                                     iGesture, rgpt, countof(rgpt));
+        ptTime += REPLAY_STROKE_PAUSE;
+        log.Append(ptTime, IE_STROKE_BEGIN);
+        for (int j = 0; j < cPoints; j++)
+        {
+            log.Append(ptTime, IE_PACKET, (int)floorf(rgpt[j].x + 0.5f),
+                       (int)floorf(rgpt[j].y + 0.5f));
+            ptTime += REPLAY_PACKET_INTERVAL;
+        }
+        log.Append(ptTime, IE_STROKE_END);
+        log.Append(ptTime, IE_GESTURE, iGesture);
+        log.Append(ptTime, IE_COMMAND, 40302);  // ID_CLEAR
+    }
+
+    if (false == log.Save(pszFileName))
+    {
+        fprintf(stderr, "%s: can't write the log\n", pszFileName);
+        return 1;
+    }
+    printf("%s: %d strokes, %d events, %.1f s\n", pszFileName, cStrokes,
+           log.GetEventCount(), ptTime / 1e9);
+    return 0;
+}
+
+/////////////////////////////////////////////////////////
+//
+// ArchiveLog
+//
+// Writes the strokes of a log to an ink archive, the time
+// of a packet in milliseconds since the start of the log,
+// then decodes the archive and compares it to the log.
+//
+/////////////////////////////////////////////////////////
+static int ArchiveLog(const CInputLog& log, const char* pszLog, const char* pszArchive)
+{
+    int cMaxPackets = 0;
+    for (int i = 0; i < log.GetEventCount(); i++)
+    {
+        if (IE_PACKET == log.GetEvent(i).iType)
+            cMaxPackets++;
+    }
+
+    // A block holds IC_BLOCK_PACKETS packets, or a single longer stroke
+    int cMaxDecoded = cMaxPackets + IC_BLOCK_PACKETS;
+    InkPacket* pPackets = (InkPacket*)malloc((cMaxPackets + 1) * sizeof(InkPacket));
+    InkPacket* pDecoded = (InkPacket*)malloc(cMaxDecoded * sizeof(InkPacket));
+    int* pcStrokePackets = (int*)malloc((cMaxPackets + 1) * sizeof(int));
+    if (NULL == pPackets || NULL == pDecoded || NULL == pcStrokePackets)
+    {
+        free(pPackets);
+        free(pDecoded);
+        free(pcStrokePackets);
+        return 1;
+    }
+
+    // The packets between a stroke begin and a stroke end make a stroke
+    CInkArchiveWriter writer;
+    bool bWritten = writer.Open(pszArchive, IC_HAS_TIME);
+    int cPackets = 0, cStrokes = 0, cStroke = 0;
+    bool bInStroke = false;
+    for (int i = 0; bWritten && i < log.GetEventCount(); i++)
+    {
+        const InputEvent& event = log.GetEvent(i);
+        if (IE_STROKE_BEGIN == event.iType)
+        {
+            bInStroke = true;
+            cStroke = 0;
+        }
+        else if (IE_PACKET == event.iType && bInStroke)
+        {
+            InkPacket& packet = pPackets[cPackets + cStroke++];
+            packet.x = event.rgiArgs[0];
+            packet.y = event.rgiArgs[1];
+            packet.uTime = (unsigned int)(event.ptTime / 1000000);
+            packet.iPressure = 0;
+        }
+        else if (IE_STROKE_END == event.iType && bInStroke && cStroke > 0)
+        {
+            bInStroke = false;
+            bWritten = writer.AddStroke(pPackets + cPackets, cStroke);
+            cPackets += cStroke;
+            cStrokes++;
+        }
+    }
+    if (false == writer.Close() || false == bWritten)
+    {
+        fprintf(stderr, "%s: can't write the archive\n", pszArchive);
+        free(pPackets);
+        free(pDecoded);
+        free(pcStrokePackets);
+        return 1;
+    }
+
+    // Read it back, a block at a time
+    CInkArchiveReader reader;
+    bool bSame = reader.Open(pszArchive) && (int)reader.GetStrokeCount() == cStrokes;
+    PERFTIME ptDecode = 0;
+    int iPacket = 0;
+    for (unsigned int b = 0; bSame && b < reader.GetBlockCount(); b++)
+    {
+        PERFTIME ptStart = PerfNow();
+        bSame = reader.DecodeBlock(b, pDecoded, cMaxDecoded, pcStrokePackets, cMaxPackets + 1);
+        ptDecode += PerfNow() - ptStart;
+
+        int cBlock = 0;
+        for (unsigned int s = 0; bSame && s < reader.GetBlock(b).cStrokes; s++)
+        {
+            cBlock += pcStrokePackets[s];
+        }
+        bSame = bSame && iPacket + cBlock <= cPackets
+                && 0 == memcmp(pDecoded, pPackets + iPacket, cBlock * sizeof(InkPacket));
+        iPacket += cBlock;
+    }
+    bSame = bSame && iPacket == cPackets;
+
+    if (bSame)
+    {
+        unsigned long long cbArchive = reader.GetHeader()->cbFile;
+        FILE* pFile = fopen(pszLog, "rb");
+        long cbLog = 0;
+        if (NULL != pFile && 0 == fseek(pFile, 0, SEEK_END))
+            cbLog = ftell(pFile);
+        if (NULL != pFile)
+            fclose(pFile);
+
+        printf("%s: %d strokes, %d packets in %u blocks, %llu bytes (%.2f bytes/packet)\n",
+               pszArchive, cStrokes, cPackets, reader.GetBlockCount(), cbArchive,
+               (cPackets > 0) ? (double)cbArchive / cPackets : 0.0);
+        printf("%.1fx smaller than the packets, %.1fx smaller than the log; decoded in %.3f ms\n",
+               (cbArchive > 0) ? (double)cPackets * sizeof(InkPacket) / cbArchive : 0.0,
+               (cbArchive > 0) ? (double)cbLog / cbArchive : 0.0, ptDecode / 1e6);
+    }
+    else
+    {
+        fprintf(stderr, "%s: the archive doesn't read back as the log\n", pszArchive);
+    }
+
+    free(pPackets);
+    free(pDecoded);
+    free(pcStrokePackets);
+    return bSame ? 0 : 1;
+}
+
+// qsort comparer for the latencies
+static int CompareTimes(const void* pv1, const void* pv2)
+{
+    PERFTIME pt1 = *(const PERFTIME*)pv1;
+    PERFTIME pt2 = *(const PERFTIME*)pv2;
+    return (pt1 < pt2) ? -1 : (pt1 > pt2) ? 1 : 0;
+}
+
+int main(int argc, char** argv)
+{
+    const char* pszLog = NULL;
+    const char* pszPack = NULL;
+    const char* pszTrace = NULL;
+    const char* pszArchive = NULL;
+    bool bRealTime = false;
+    double dMaxP99 = 0.0;
+    float fTolerance = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "-g") && i + 2 < argc)
+            return WriteSyntheticLog(atoi(argv[i + 1]), argv[i + 2]);
+        else if (0 == strcmp(argv[i], "-realtime"))
+            bRealTime = true;
+        else if (0 == strcmp(argv[i], "-p") && i + 1 < argc)
+            pszPack = argv[++i];
+        else if (0 == strcmp(argv[i], "-maxp99") && i + 1 < argc)
+            dMaxP99 = atof(argv[++i]);
+        else if (0 == strcmp(argv[i], "-decimate") && i + 1 < argc)
+            fTolerance = (float)atof(argv[++i]);
+        else if (0 == strcmp(argv[i], "-trace") && i + 1 < argc)
+            pszTrace = argv[++i];
+        else if (0 == strcmp(argv[i], "-archive") && i + 1 < argc)
+            pszArchive = argv[++i];
+        else if ('-' != argv[i][0])
+            pszLog = argv[i];
+        else
+        {
+            pszLog = NULL;      // unknown option, print the usage
+            break;
+        }
+    }
+
+    if (NULL == pszLog)
+    {
+        printf("usage: GestureReplay [-realtime] [-p pack.gpk] [-maxp99 us]\n"
+               "                     [-decimate tolerance] [-trace trace.json] input.log\n"
+               "       GestureReplay -g count output.log\n"
+               "       GestureReplay -archive output.ink input.log\n");
+        return 1;
+    }
+
+    CInputLog log;
+    if (false == log.Load(pszLog))
+    {
+        fprintf(stderr, "%s: not an input log\n", pszLog);
+        return 1;
+    }
+    if (NULL != pszArchive)
+        return ArchiveLog(log, pszLog, pszArchive);
+
+    CGestureEngine engine;
+    CTemplatePack pack;
+    if (NULL != pszPack)
+    {
+        if (false == pack.Open(pszPack))
+        {
+            fprintf(stderr, "%s: not a valid template pack for this engine\n", pszPack);
+            return 1;
+        }
+        engine.AttachTemplates(pack.GetTemplates(), pack.GetFormat(), pack.GetFeatures(),
+                               pack.GetTemplateCount(), pack.GetNodes(), pack.GetNodeCount());
+        engine.SetCandidateCount(64);
+    }
+    else
+    {
+        engine.AddBuiltinTemplates();
+    }
+
+    // There are at most as many strokes as the stroke begin events
+    int cMaxStrokes = 0;
+    for (int i = 0; i < log.GetEventCount(); i++)
+    {
+        if (IE_STROKE_BEGIN == log.GetEvent(i).iType)
+            cMaxStrokes++;
+    }
+    ReplayStroke* pStrokes = (ReplayStroke*)malloc((cMaxStrokes + 1) * sizeof(ReplayStroke));
+    PERFTIME* pptLatencies = (PERFTIME*)malloc((cMaxStrokes + 1) * sizeof(PERFTIME));
+    if (NULL == pStrokes || NULL == pptLatencies)
+    {
+        free(pStrokes);
+        free(pptLatencies);
+        return 1;
+    }
+
+    CInputReplayer replayer(engine);
+    replayer.SetDecimation(fTolerance);
+    CTrace::Enable(NULL != pszTrace);
+    PERFTIME ptStart = PerfNow();
+    int cStrokes = replayer.Replay(log, bRealTime, pStrokes, cMaxStrokes);
+    PERFTIME ptTotal = PerfNow() - ptStart;
+    CTrace::Enable(false);
+
+    int cCompared = 0, cAgree = 0;
+    long long cPoints = 0, cKept = 0;
+    for (int i = 0; i < cStrokes; i++)
+    {
+        pptLatencies[i] = pStrokes[i].ptLatency;
+        cPoints += pStrokes[i].cPoints;
+        cKept += pStrokes[i].cKept;
+        if (pStrokes[i].iRecorded >= 0)
+        {
+            cCompared++;
+            if (pStrokes[i].iRecorded == pStrokes[i].iReplayed)
+                cAgree++;
+        }
+    }
+    qsort(pptLatencies, cStrokes, sizeof(PERFTIME), CompareTimes);
+
+    printf("%s: %d events, %d strokes replayed %s in %.3f s\n", pszLog,
+           log.GetEventCount(), cStrokes, bRealTime ? "in real time" : "at full speed",
+           ptTotal / 1e9);
+    if (fTolerance > 0 && cKept > 0)
+    {
+        printf("decimated with a tolerance of %.1f: %lld of %lld points kept (%.1fx)\n",
+               fTolerance, cKept, cPoints, (double)cPoints / cKept);
+    }
+    if (cCompared > 0)
+    {
+        printf("agreement with the recorded gestures: %d of %d (%.2f%%)\n",
+               cAgree, cCompared, 100.0 * cAgree / cCompared);
+    }
+
+    double dP99 = 0.0;
+    if (cStrokes > 0)
+    {
+        dP99 = pptLatencies[(cStrokes - 1) * 99 / 100] / 1000.0;
+        printf("latency us: p50 %.1f  p90 %.1f  p99 %.1f  max %.1f\n",
+               pptLatencies[(cStrokes - 1) / 2] / 1000.0,
+               pptLatencies[(cStrokes - 1) * 9 / 10] / 1000.0,
+               dP99, pptLatencies[cStrokes - 1] / 1000.0);
+    }
+
+    free(pStrokes);
+    free(pptLatencies);
+
+    if (NULL != pszTrace)
+    {
+        if (false == CTrace::ExportChromeJson(pszTrace))
+        {
+            fprintf(stderr, "%s: can't write the trace\n", pszTrace);
+            return 1;
+        }
+        printf("%d trace events written to %s\n", CTrace::GetEventCount(), pszTrace);
+    }
+
+    if (dMaxP99 > 0.0 && dP99 > dMaxP99)
+    {
+        printf("p99 latency %.1f us exceeds the limit of %.1f us\n", dP99, dMaxP99);
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,1252 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      GestureServer.cpp
+//
+// Description:
+//      A console tool that runs the local recognition service (see
+//      GestureService.h), one per host, and a load generator for it.
+//
+//      Usage:
+//          GestureServer [-socket path] [-p pack.gpk] [-threads n] [-batch n]
+//                        [-budget us]
+//          GestureServer -load [-socket path] [-p pack.gpk] [-clients n]
+//                        [-seconds s]
+//          GestureServer -transport [-p pack.gpk] [-rate n] [-seconds s]
+//
+//          -socket     the path of the service's socket, GS_DEFAULT_PATH
+//                      by default
+//          -p          recognizes with the templates of a template pack
+//                      instead of the built-in templates
+//          -threads    the event loops of the service, 2 by default
+//          -batch      the most strokes recognized in one pass,
+//                      GE_MAX_BATCH by default; 1 recognizes them one by
+//                      one, for comparison
+//          -budget     the p99 latency, in microseconds, the service keeps
+//                      to under load by recognizing the batches that queue
+//                      up at a lower quality tier (see QualityScheduler.h);
+//                      without it every stroke gets the full quality
+//          -load       runs closed loop clients against a running
+//                      service, each sending a synthetic stroke as soon as
+//                      the one before is answered, and reports the
+//                      throughput, the latency percentiles, the mean
+//                      batch of the service and the share of the strokes
+//                      it recognized at each quality tier. Every response
+//                      is checked against a local engine with the same
+//                      templates, at the tier the response names
+//          -clients    the clients of the load, by default 1, 10, 100 and
+//                      1000 in turn
+//          -seconds    how long each load runs, 3 by default
+//          -transport  compares the ways a capture process can hand its
+//                      strokes to a recognition process: a connection to
+//                      the service, and a pair of shared memory rings
+//                      (see SharedRing.h) the recognizer reads the strokes
+//                      from in place. A capture process is forked, and
+//                      sends strokes at a fixed rate for each transport,
+//                      by default 2000, 5000, 10000 and 20000 strokes a
+//                      second, then as fast as it's answered. Linux only
+//          -rate       the rate of -transport, 0 as fast as it can
+//
+//      The service runs until it's interrupted (Ctrl+C).
+//
+//--------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+
+#include "PerfTimer.h"
+#include "GestureEngine.h"
+#include "GestureService.h"
+#include "QualityScheduler.h"
+#include "TemplatePack.h"
+#include "SyntheticInk.h"
+#include "Metrics.h"
+#include "SharedRing.h"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// A useful macro to determine the number of elements in the array
+#ifndef countof
+#define countof(array)  (sizeof(array)/sizeof(array[0]))
+#endif
+
+#ifdef _WIN32
+#define GS_DEFAULT_PATH     "gesture-reco.sock"
+#else
+#define GS_DEFAULT_PATH     "/tmp/gesture-reco.sock"
+#endif
+
+#define LOAD_STROKES        512     // the synthetic strokes the clients send
+#define LOAD_MAX_POINTS     256
+#define LOAD_RESULTS        3       // the alternates asked for
+#define LOAD_MAX_EVENTS     1024
+#define LOAD_DRAIN_TIMEOUT  5000000000ULL
+
+#define RING_STROKE_BYTES   (4 << 20)
+#define RING_RESULT_BYTES   (256 << 10)
+#define RING_MAX_IN_FLIGHT  4096    // the strokes a capture process has unanswered
+
+static volatile bool s_bInterrupted = false;
+
+static void OnInterrupt(int)
+{
+    s_bInterrupted = true;
+}
+
+static void SleepMs(int cMs)
+{
+#ifdef _WIN32
+    ::Sleep(cMs);
+#else
+    struct timespec ts;
+    ts.tv_sec = cMs / 1000;
+    ts.tv_nsec = (long)(cMs % 1000) * 1000000;
+    nanosleep(&ts, NULL);
+#endif
+}
+
+/////////////////////////////////////////////////////////
+//
+// SetUpEngine
+//
+// Gives an engine the templates of a pack, with the index
+// as GestureReplay uses it, or the built-in templates.
+//
+/////////////////////////////////////////////////////////
+static bool SetUpEngine(CGestureEngine& engine, CTemplatePack& pack, const char* pszPack)
+{
+    if (NULL == pszPack)
+    {
+        engine.AddBuiltinTemplates();
+        return true;
+    }
+    if (false == pack.Open(pszPack))
+    {
+        fprintf(stderr, "%s: not a valid template pack for this engine\n", pszPack);
+        return false;
+    }
+    engine.AttachTemplates(pack.GetTemplates(), pack.GetFormat(), pack.GetFeatures(),
+                           pack.GetTemplateCount(), pack.GetNodes(), pack.GetNodeCount());
+    engine.SetCandidateCount(64);
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// Serve
+//
+// Runs the service until it's interrupted.
+//
+/////////////////////////////////////////////////////////
+static int Serve(
+        const CGestureEngine& engine,
+        const char* pszPath,
+        int cThreads,
+        int cMaxBatch,
+        int iBudgetUs
+        )
+{
+    CQualityTiers tiers;
+    CGestureService service(engine);
+    service.SetMaxBatch(cMaxBatch);
+    if (iBudgetUs > 0)
+    {
+        if (false == tiers.Create(engine))
+            return 1;
+        service.SetQuality(&tiers, (PERFTIME)iBudgetUs * 1000);
+    }
+    if (false == service.Start(pszPath, cThreads))
+    {
+        fprintf(stderr, "%s: can't listen\n", pszPath);
+        return 1;
+    }
+    printf("serving %d templates at %s, %d threads, batches of %d\n",
+           engine.GetTemplateCount(), pszPath, cThreads, cMaxBatch);
+    if (iBudgetUs > 0)
+    {
+        printf("p99 budget %d us, tiers in us per stroke:", iBudgetUs);
+        for (int i = 0; i < QS_NUM_TIERS; i++)
+            printf("  %s %.1f", CQualityTiers::GetTierName(i), tiers.GetCost(i) / 1e3);
+        printf("\n");
+    }
+
+    signal(SIGINT, OnInterrupt);
+    signal(SIGTERM, OnInterrupt);
+    while (false == s_bInterrupted)
+        SleepMs(200);
+
+    ServiceStats stats;
+    service.GetStats(stats);
+    service.Stop();
+    printf("%llu connections, %llu requests in %llu batches, %llu errors\n",
+           stats.cConnections, stats.cRequests, stats.cBatches, stats.cErrors);
+    printf("tiers:");
+    for (int i = 0; i < QS_NUM_TIERS; i++)
+        printf("  %s %llu", CQualityTiers::GetTierName(i), stats.rgcTiers[i]);
+    printf("\n");
+    return 0;
+}
+
+// Returns a percentile of a histogram, which is the end of its bucket,
+// but no more than the largest value recorded
+static PERFTIME GetPercentileUpTo(const HistogramSnapshot& hist, double dPercentile, PERFTIME ptMax)
+{
+    PERFTIME pt = hist.GetPercentile(dPercentile);
+    return (pt < ptMax) ? pt : ptMax;
+}
+
+// A synthetic stroke of the load, and the alternates a local engine
+// gives it
+struct LoadStroke
+{
+    int             iPoint;         // in the load's points
+    int             cPoints;
+    int             cResults;
+    GestureResult   rgResults[LOAD_RESULTS];
+};
+
+/////////////////////////////////////////////////////////
+//
+// MakeLoadStrokes
+//
+// Makes the strokes of a load, in integer ink units, as the
+// application has them, and recognizes the same rounded
+// points with a local engine, for the expected results.
+//
+// Parameters:
+//     const CGestureEngine& engine : [in] the engine of the service
+//     LoadStroke* pStrokes         : [out] LOAD_STROKES strokes
+//     int* piPoints                : [out] their x, y pairs, room for
+//                                    LOAD_STROKES * LOAD_MAX_POINTS
+//
+/////////////////////////////////////////////////////////
+static void MakeLoadStrokes(const CGestureEngine& engine, LoadStroke* pStrokes, int* piPoints)
+{
+    CSyntheticInk ink(43);
+    int cShapes = CGestureEngine::GetBuiltinShapeCount();
+    int iPoint = 0;
+    for (int i = 0; i < LOAD_STROKES; i++)
+    {
+        GesturePoint rgpt[LOAD_MAX_POINTS];
+        int iGesture;
+        int cPoints = ink.MakeStroke(i % cShapes, iGesture, rgpt, countof(rgpt));
+        int* pi = piPoints + 2 * iPoint;
+        for (int j = 0; j < cPoints; j++)
+        {
+            pi[2 * j] = (int)(rgpt[j].x + (rgpt[j].x < 0 ? -0.5f : 0.5f));
+            pi[2 * j + 1] = (int)(rgpt[j].y + (rgpt[j].y < 0 ? -0.5f : 0.5f));
+            rgpt[j].x = (float)pi[2 * j];
+            rgpt[j].y = (float)pi[2 * j + 1];
+        }
+
+        LoadStroke& stroke = pStrokes[i];
+        stroke.iPoint = iPoint;
+        stroke.cPoints = cPoints;
+        stroke.cResults = engine.Recognize(rgpt, cPoints, stroke.rgResults, LOAD_RESULTS);
+        iPoint += cPoints;
+    }
+}
+
+// Encodes results as the service sends them
+static void EncodeResults(const GestureResult* pResults, int cResults, unsigned char* pb)
+{
+    for (int j = 0; j < cResults; j++)
+    {
+        pb[3 * j] = (unsigned char)pResults[j].iGesture;
+        unsigned short w = CGestureProtocol::ScoreToWord(pResults[j].fScore);
+        pb[3 * j + 1] = (unsigned char)w;
+        pb[3 * j + 2] = (unsigned char)(w >> 8);
+    }
+}
+
+// A request the load sends, encoded but for its id, and its response
+// at each quality tier
+struct LoadRequest
+{
+    int             ibRequest;      // in the load's request bytes
+    int             cbRequest;
+    int             rgcResults[QS_NUM_TIERS];
+    unsigned char   rgbResults[QS_NUM_TIERS][3 * LOAD_RESULTS];
+};
+
+// A client of the load
+struct LoadClient
+{
+    ServiceSocket   s;
+    unsigned int    uEvents;
+    CServiceBuffer  in;
+    CServiceBuffer  out;
+    unsigned int    uId;
+    int             iRequest;
+    PERFTIME        ptSent;
+    bool            bWaiting;
+};
+
+// The requests and the counters of a load
+struct LoadState
+{
+    CServicePoller      poller;
+    const LoadRequest*  pRequests;
+    const unsigned char* pbRequests;
+    CSyntheticInk       ink;
+    CLatencyHistogram   hist;
+    PERFTIME            ptMax;
+    long long           cAnswered;
+    long long           cMismatches;
+    long long           rgcTiers[QS_NUM_TIERS];     // the responses of each tier
+    int                 cWaiting;
+    bool                bFailed;
+};
+
+// Sends a client's next request
+static void SendRequest(LoadState& state, LoadClient& client)
+{
+    client.iRequest = (int)(state.ink.NextUInt() % LOAD_STROKES);
+    client.uId++;
+    const LoadRequest& request = state.pRequests[client.iRequest];
+    unsigned char* pb = client.out.Reserve(request.cbRequest);
+    if (NULL == pb)
+    {
+        state.bFailed = true;
+        return;
+    }
+    memcpy(pb, state.pbRequests + request.ibRequest, request.cbRequest);
+    pb[4] = (unsigned char)client.uId;
+    pb[5] = (unsigned char)(client.uId >> 8);
+    pb[6] = (unsigned char)(client.uId >> 16);
+    pb[7] = (unsigned char)(client.uId >> 24);
+    client.out.Commit(request.cbRequest);
+    client.ptSent = PerfNow();
+    client.bWaiting = true;
+    state.cWaiting++;
+}
+
+// Sends what a client's socket takes, and polls for the rest
+static void FlushClient(LoadState& state, LoadClient& client)
+{
+    while (client.out.GetSize() > 0)
+    {
+        int cb = ServiceSend(client.s, client.out.GetData(), client.out.GetSize());
+        if (cb < 0)
+        {
+            state.bFailed = true;
+            return;
+        }
+        if (0 == cb)
+            break;
+        client.out.Consume(cb);
+    }
+    unsigned int uEvents = GS_EVENT_READ | ((client.out.GetSize() > 0) ? GS_EVENT_WRITE : 0);
+    if (uEvents != client.uEvents)
+    {
+        client.uEvents = uEvents;
+        state.poller.Modify(client.s, uEvents, &client);
+    }
+}
+
+// Reads a client's response, checks it and sends the next request
+static void ReadClient(LoadState& state, LoadClient& client, bool bSending)
+{
+    for (;;)
+    {
+        unsigned char* pb = client.in.Reserve(4096);
+        int cb = (NULL != pb) ? ServiceRecv(client.s, pb, 4096) : -1;
+        if (cb < 0)
+        {
+            state.bFailed = true;
+            return;
+        }
+        if (0 == cb)
+            break;
+        client.in.Commit(cb);
+    }
+
+    while (client.in.GetSize() >= GS_HEADER_SIZE)
+    {
+        ServiceHeader header;
+        CGestureProtocol::DecodeHeader(client.in.GetData(), header);
+        if (client.in.GetSize() < GS_HEADER_SIZE + (int)header.cbBody)
+            break;
+
+        PERFTIME ptLatency = PerfNow() - client.ptSent;
+        const LoadRequest& request = state.pRequests[client.iRequest];
+        int iTier = header.uParam;
+        if (false == client.bWaiting || header.uId != client.uId ||
+            GS_RSP_RESULTS != header.uType || iTier >= QS_NUM_TIERS ||
+            header.cItems != request.rgcResults[iTier] ||
+            header.cbBody != 3u * request.rgcResults[iTier] ||
+            0 != memcmp(client.in.GetData() + GS_HEADER_SIZE, request.rgbResults[iTier],
+                        header.cbBody))
+        {
+            state.cMismatches++;
+        }
+        else
+        {
+            state.rgcTiers[iTier]++;
+        }
+        client.in.Consume(GS_HEADER_SIZE + header.cbBody);
+
+        state.hist.Record(ptLatency);
+        if (ptLatency > state.ptMax)
+            state.ptMax = ptLatency;
+        state.cAnswered++;
+        client.bWaiting = false;
+        state.cWaiting--;
+        if (bSending)
+        {
+            SendRequest(state, client);
+            FlushClient(state, client);
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// RunLoad
+//
+// Connects cClients clients and keeps each with a request
+// in flight for the given time, then waits for the last
+// responses. The clients share one thread and a poller,
+// so the latencies include the time the generator takes
+// to notice a response, as an application's would.
+//
+// Return Values (bool):
+//      true if succeeded, false if a client couldn't connect
+//      or the service stopped answering
+//
+/////////////////////////////////////////////////////////
+static bool RunLoad(
+        const char* pszPath,
+        int cClients,
+        PERFTIME ptDuration,
+        const LoadRequest* pRequests,
+        const unsigned char* pbRequests
+        )
+{
+    CGestureClient control;
+    ServiceStats statsBefore, statsAfter;
+    if (false == control.Connect(pszPath) || false == control.GetStats(statsBefore))
+    {
+        fprintf(stderr, "%s: no service\n", pszPath);
+        return false;
+    }
+
+    LoadState state;
+    state.pRequests = pRequests;
+    state.pbRequests = pbRequests;
+    state.ink = CSyntheticInk(cClients);
+    state.ptMax = 0;
+    state.cAnswered = state.cMismatches = 0;
+    memset(state.rgcTiers, 0, sizeof(state.rgcTiers));
+    state.cWaiting = 0;
+    state.bFailed = (false == state.poller.Create());
+
+    LoadClient* pClients = new LoadClient[cClients];
+    int cConnected = 0;
+    for (; cConnected < cClients && false == state.bFailed; cConnected++)
+    {
+        LoadClient& client = pClients[cConnected];
+        client.s = ServiceConnect(pszPath);
+        client.uEvents = GS_EVENT_READ;
+        client.uId = 0;
+        client.iRequest = 0;
+        client.ptSent = 0;
+        client.bWaiting = false;
+        if (GS_INVALID_SOCKET == client.s || false == state.poller.Add(client.s, GS_EVENT_READ, &client))
+        {
+            fprintf(stderr, "%s: can't connect client %d\n", pszPath, cConnected + 1);
+            if (GS_INVALID_SOCKET != client.s)
+                ServiceClose(client.s);
+            state.bFailed = true;
+            break;
+        }
+    }
+
+    PERFTIME ptStart = PerfNow();
+    PERFTIME ptEnd = ptStart + ptDuration;
+    for (int i = 0; i < cConnected && false == state.bFailed; i++)
+    {
+        SendRequest(state, pClients[i]);
+        FlushClient(state, pClients[i]);
+    }
+
+    ServiceEvent rgEvents[LOAD_MAX_EVENTS];
+    while (false == state.bFailed)
+    {
+        PERFTIME ptNow = PerfNow();
+        bool bSending = (ptNow < ptEnd);
+        if (false == bSending && 0 == state.cWaiting)
+            break;
+        if (ptNow > ptEnd + LOAD_DRAIN_TIMEOUT)
+        {
+            fprintf(stderr, "%s: %d requests not answered\n", pszPath, state.cWaiting);
+            state.bFailed = true;
+            break;
+        }
+
+        int cEvents = state.poller.Wait(rgEvents, LOAD_MAX_EVENTS, 100);
+        for (int i = 0; i < cEvents && false == state.bFailed; i++)
+        {
+            LoadClient& client = *(LoadClient*)rgEvents[i].pv;
+            if (rgEvents[i].uEvents & GS_EVENT_WRITE)
+                FlushClient(state, client);
+            if (rgEvents[i].uEvents & (GS_EVENT_READ | GS_EVENT_ERROR))
+                ReadClient(state, client, bSending);
+        }
+    }
+    PERFTIME ptElapsed = PerfNow() - ptStart;
+
+    for (int i = 0; i < cConnected; i++)
+        ServiceClose(pClients[i].s);
+    delete[] pClients;
+
+    if (state.bFailed)
+        return false;
+    if (false == control.GetStats(statsAfter))
+    {
+        fprintf(stderr, "%s: no service\n", pszPath);
+        return false;
+    }
+
+    HistogramSnapshot hist;
+    state.hist.Snapshot(hist);
+    unsigned long long cBatches = statsAfter.cBatches - statsBefore.cBatches;
+    unsigned long long cRequests = statsAfter.cRequests - statsBefore.cRequests;
+    printf("%5d clients: %9.0f req/s  latency us: p50 %7.1f  p99 %7.1f  p99.9 %7.1f"
+           "  max %7.1f  mean batch %5.1f\n",
+           cClients, state.cAnswered * 1e9 / ptElapsed,
+           GetPercentileUpTo(hist, 50, state.ptMax) / 1e3,
+           GetPercentileUpTo(hist, 99, state.ptMax) / 1e3,
+           GetPercentileUpTo(hist, 99.9, state.ptMax) / 1e3, state.ptMax / 1e3,
+           (cBatches > 0) ? (double)cRequests / cBatches : 0.0);
+    if (state.rgcTiers[0] < state.cAnswered)
+    {
+        // The distribution as the service counts it, which takes in
+        // any other clients too
+        unsigned long long rgcTiers[QS_NUM_TIERS];
+        unsigned long long cTiered = 0;
+        for (int i = 0; i < QS_NUM_TIERS; i++)
+        {
+            rgcTiers[i] = statsAfter.rgcTiers[i] - statsBefore.rgcTiers[i];
+            cTiered += rgcTiers[i];
+        }
+        printf("               tiers:");
+        for (int i = 0; i < QS_NUM_TIERS; i++)
+            printf("  %s %5.1f%%", CQualityTiers::GetTierName(i),
+                   (cTiered > 0) ? rgcTiers[i] * 100.0 / cTiered : 0.0);
+        printf("\n");
+    }
+    if (state.cMismatches > 0)
+    {
+        printf("%lld of %lld responses differ from the local engine\n",
+               state.cMismatches, state.cAnswered);
+        return false;
+    }
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// Load
+//
+// Checks the gesture names of the service, makes the
+// requests of the load and their expected responses with
+// a local engine, at every quality tier, and runs the
+// loads.
+//
+/////////////////////////////////////////////////////////
+static int Load(const CGestureEngine& engine, const char* pszPath, int cClients, double dSeconds)
+{
+    if (false == ServiceStartup())
+        return 1;
+
+    CGestureClient client;
+    if (false == client.Connect(pszPath))
+    {
+        fprintf(stderr, "%s: no service\n", pszPath);
+        return 1;
+    }
+    for (int g = 0; g < GE_NUM_SSGESTURES; g++)
+    {
+        char szName[64];
+        if (false == client.GetGestureName(g, szName, countof(szName)) ||
+            0 != strcmp(szName, CGestureEngine::GetGestureName(g)))
+        {
+            fprintf(stderr, "%s: the service doesn't name gesture %d\n", pszPath, g);
+            return 1;
+        }
+    }
+
+    LoadStroke* pStrokes = (LoadStroke*)malloc(LOAD_STROKES * sizeof(LoadStroke));
+    int* piPoints = (int*)malloc(2 * LOAD_STROKES * LOAD_MAX_POINTS * sizeof(int));
+    LoadRequest* pRequests = (LoadRequest*)malloc(LOAD_STROKES * sizeof(LoadRequest));
+    CServiceBuffer requests;
+    CQualityTiers tiers;
+    if (NULL == pStrokes || NULL == piPoints || NULL == pRequests || false == tiers.Create(engine))
+    {
+        free(pStrokes);
+        free(piPoints);
+        free(pRequests);
+        return 1;
+    }
+    MakeLoadStrokes(engine, pStrokes, piPoints);
+    for (int i = 0; i < LOAD_STROKES; i++)
+    {
+        const LoadStroke& stroke = pStrokes[i];
+        LoadRequest& request = pRequests[i];
+        request.ibRequest = requests.GetSize();
+        if (false == CGestureProtocol::WriteRecognize(requests, 0, piPoints + 2 * stroke.iPoint,
+                                                      stroke.cPoints, LOAD_RESULTS))
+        {
+            free(pStrokes);
+            free(piPoints);
+            free(pRequests);
+            return 1;
+        }
+        request.cbRequest = requests.GetSize() - request.ibRequest;
+        request.rgcResults[0] = stroke.cResults;
+        EncodeResults(stroke.rgResults, stroke.cResults, request.rgbResults[0]);
+
+        GesturePoint rgpt[LOAD_MAX_POINTS];
+        const int* pi = piPoints + 2 * stroke.iPoint;
+        for (int j = 0; j < stroke.cPoints; j++)
+        {
+            rgpt[j].x = (float)pi[2 * j];
+            rgpt[j].y = (float)pi[2 * j + 1];
+        }
+        for (int t = 1; t < QS_NUM_TIERS; t++)
+        {
+            GestureResult rgResults[LOAD_RESULTS];
+            request.rgcResults[t] = tiers.GetEngine(t).Recognize(rgpt, stroke.cPoints,
+                                                                 rgResults, LOAD_RESULTS);
+            EncodeResults(rgResults, request.rgcResults[t], request.rgbResults[t]);
+        }
+    }
+    printf("%d strokes of %d bytes on average, %d alternates each\n", LOAD_STROKES,
+           requests.GetSize() / LOAD_STROKES, LOAD_RESULTS);
+
+    static const int c_rgcClients[] = { 1, 10, 100, 1000 };
+    int cLoads = (cClients > 0) ? 1 : countof(c_rgcClients);
+    int iResult = 0;
+    for (int i = 0; i < cLoads && 0 == iResult; i++)
+    {
+        if (false == RunLoad(pszPath, (cClients > 0) ? cClients : c_rgcClients[i],
+                             (PERFTIME)(dSeconds * 1e9), pRequests, requests.GetData()))
+            iResult = 1;
+    }
+
+    free(pStrokes);
+    free(piPoints);
+    free(pRequests);
+    return iResult;
+}
+
+#ifdef __linux__
+
+// The transport of a stroke benchmark
+enum {
+    TRANSPORT_SOCKET,
+    TRANSPORT_RING
+};
+
+// What a capture process reports, in memory shared with the recognizer
+struct CaptureReport
+{
+    long long       cAnswered;
+    long long       cMismatches;
+    PERFTIME        ptElapsed;
+    PERFTIME        ptCpu;
+    PERFTIME        ptMax;
+    PERFTIME        rgptPercentiles[3];     // 50, 99, 99.9
+    bool            bFailed;
+};
+
+// The strokes of a capture process and its pace
+struct CaptureLoad
+{
+    const LoadStroke*   pStrokes;
+    const int*          piPoints;
+    int                 iRate;          // strokes per second, 0 as fast as it can
+    PERFTIME            ptDuration;
+};
+
+// A stroke in flight
+struct CaptureSent
+{
+    PERFTIME        ptSent;
+    int             iStroke;
+};
+
+// The bookkeeping of a capture process, the same for either transport
+class CCaptureState
+{
+public:
+    const CaptureLoad&  load;
+    CaptureSent         rgSent[RING_MAX_IN_FLIGHT];     // by id, modulo
+    CSyntheticInk       ink;
+    CLatencyHistogram   hist;
+    PERFTIME            ptStart;
+    PERFTIME            ptNext;         // when the next stroke is due
+    PERFTIME            ptMax;
+    unsigned int        uNextId;
+    int                 cInFlight;
+    long long           cAnswered;
+    long long           cMismatches;
+
+    CCaptureState(const CaptureLoad& loadIn)
+        : load(loadIn), ink(44), ptStart(PerfNow()), ptNext(ptStart), ptMax(0),
+          uNextId(1), cInFlight(0), cAnswered(0), cMismatches(0) {}
+
+    bool IsSending(PERFTIME ptNow) const { return ptNow < ptStart + load.ptDuration; }
+
+    // Whether a stroke is due now, and which
+    bool IsDue(PERFTIME ptNow, int& iStroke)
+    {
+        if (false == IsSending(ptNow) || cInFlight >= RING_MAX_IN_FLIGHT ||
+            (load.iRate > 0 && ptNext > ptNow))
+            return false;
+        iStroke = (int)(ink.NextUInt() % LOAD_STROKES);
+        return true;
+    }
+
+    // Records the stroke just sent
+    void Sent(int iStroke)
+    {
+        CaptureSent& sent = rgSent[uNextId % RING_MAX_IN_FLIGHT];
+        sent.ptSent = PerfNow();
+        sent.iStroke = iStroke;
+        uNextId++;
+        cInFlight++;
+        if (load.iRate > 0)
+            ptNext += 1000000000ULL / load.iRate;
+    }
+
+    // The milliseconds to wait for results before the next stroke is due
+    int GetWaitMs(PERFTIME ptNow) const
+    {
+        if (false == IsSending(ptNow) || cInFlight >= RING_MAX_IN_FLIGHT)
+            return 100;
+        if (0 == load.iRate)
+            return 0;
+        if (ptNext <= ptNow)
+            return 0;
+        return (int)((ptNext - ptNow + 999999) / 1000000);
+    }
+
+    // Checks an answer and records its latency
+    void Answered(unsigned int uId, bool bMatches)
+    {
+        const CaptureSent& sent = rgSent[uId % RING_MAX_IN_FLIGHT];
+        PERFTIME ptLatency = PerfNow() - sent.ptSent;
+        hist.Record(ptLatency);
+        if (ptLatency > ptMax)
+            ptMax = ptLatency;
+        if (false == bMatches)
+            cMismatches++;
+        cAnswered++;
+        cInFlight--;
+    }
+
+private:
+
+    CCaptureState& operator=(const CCaptureState&);
+};
+
+// The CPU time of this process
+static PERFTIME GetProcessCpuTime()
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return (PERFTIME)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000000ULL +
+           (PERFTIME)(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1000ULL;
+}
+
+// Fills a capture process's report
+static void ReportCapture(const CCaptureState& state, PERFTIME ptCpuStart, bool bFailed,
+                          CaptureReport& report)
+{
+    HistogramSnapshot hist;
+    state.hist.Snapshot(hist);
+    report.cAnswered = state.cAnswered;
+    report.cMismatches = state.cMismatches;
+    report.ptElapsed = PerfNow() - state.ptStart;
+    report.ptCpu = GetProcessCpuTime() - ptCpuStart;
+    report.ptMax = state.ptMax;
+    report.rgptPercentiles[0] = GetPercentileUpTo(hist, 50, state.ptMax);
+    report.rgptPercentiles[1] = GetPercentileUpTo(hist, 99, state.ptMax);
+    report.rgptPercentiles[2] = GetPercentileUpTo(hist, 99.9, state.ptMax);
+    report.bFailed = bFailed;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CaptureToRing
+//
+// The capture process of the ring: writes the points of
+// each stroke straight into the stroke ring, as floats,
+// and reads the alternates where they are in the result
+// ring.
+//
+/////////////////////////////////////////////////////////
+static void CaptureToRing(const CaptureLoad& load, const char* pszStrokes,
+                          const char* pszResults, CaptureReport& report)
+{
+    PERFTIME ptCpuStart = GetProcessCpuTime();
+    CSharedRing strokes, results;
+    if (false == strokes.Open(pszStrokes) || false == results.Open(pszResults))
+    {
+        report.bFailed = true;
+        return;
+    }
+
+    CCaptureState state(load);
+    bool bFailed = false;
+    for (;;)
+    {
+        PERFTIME ptNow = PerfNow();
+        if (false == state.IsSending(ptNow) && 0 == state.cInFlight)
+            break;
+        if (ptNow > state.ptStart + load.ptDuration + LOAD_DRAIN_TIMEOUT)
+        {
+            bFailed = true;
+            break;
+        }
+
+        int iStroke;
+        while (state.IsDue(ptNow, iStroke))
+        {
+            const LoadStroke& stroke = load.pStrokes[iStroke];
+            GesturePoint* ppt = (GesturePoint*)strokes.BeginWrite(
+                    state.uNextId, stroke.cPoints * (int)sizeof(GesturePoint), 0);
+            if (NULL == ppt)
+                break;
+            const int* pi = load.piPoints + 2 * stroke.iPoint;
+            for (int j = 0; j < stroke.cPoints; j++)
+            {
+                ppt[j].x = (float)pi[2 * j];
+                ppt[j].y = (float)pi[2 * j + 1];
+            }
+            strokes.EndWrite();
+            state.Sent(iStroke);
+        }
+        strokes.Publish();
+
+        RingMessage rgMessages[GE_MAX_BATCH];
+        int cMessages = results.Peek(rgMessages, countof(rgMessages), state.GetWaitMs(PerfNow()));
+        if (cMessages < 0)
+        {
+            bFailed = true;
+            break;
+        }
+        for (int i = 0; i < cMessages; i++)
+        {
+            const RingMessage& message = rgMessages[i];
+            const LoadStroke& stroke = load.pStrokes[state.rgSent[message.uId % RING_MAX_IN_FLIGHT].iStroke];
+            bool bMatches = (message.cb == stroke.cResults * (int)sizeof(GestureResult) &&
+                             0 == memcmp(message.pv, stroke.rgResults, message.cb));
+            state.Answered(message.uId, bMatches);
+        }
+        results.Release();
+    }
+
+    // An empty message ends the recognizer
+    if (NULL != strokes.BeginWrite(0, 0, (int)(LOAD_DRAIN_TIMEOUT / 1000000)))
+    {
+        strokes.EndWrite();
+        strokes.Publish();
+    }
+    ReportCapture(state, ptCpuStart, bFailed, report);
+}
+
+/////////////////////////////////////////////////////////
+//
+// RecognizeFromRing
+//
+// The recognizer of the ring: recognizes the strokes in
+// the ring, in place, in batches, and writes their
+// alternates into the result ring, until the empty
+// message of the capture process.
+//
+/////////////////////////////////////////////////////////
+static bool RecognizeFromRing(const CGestureEngine& engine, CSharedRing& strokes, CSharedRing& results)
+{
+    RingMessage rgMessages[GE_MAX_BATCH];
+    GestureStroke rgStrokes[GE_MAX_BATCH];
+    GestureResult rgResults[GE_MAX_BATCH * LOAD_RESULTS];
+    int rgcResults[GE_MAX_BATCH];
+    PERFTIME ptLast = PerfNow();
+
+    for (;;)
+    {
+        int cMessages = strokes.Peek(rgMessages, countof(rgMessages), 100);
+        if (cMessages < 0)
+            return false;
+        if (0 == cMessages)
+        {
+            if (PerfNow() - ptLast > LOAD_DRAIN_TIMEOUT)
+                return false;
+            continue;
+        }
+        ptLast = PerfNow();
+
+        bool bDone = false;
+        int cStrokes = 0;
+        for (int i = 0; i < cMessages; i++)
+        {
+            if (0 == rgMessages[i].cb)
+            {
+                bDone = true;
+                break;
+            }
+            rgStrokes[cStrokes].ppt = (const GesturePoint*)rgMessages[i].pv;
+            rgStrokes[cStrokes].cPoints = rgMessages[i].cb / (int)sizeof(GesturePoint);
+            cStrokes++;
+        }
+        if (cStrokes > 0)
+            engine.RecognizeBatch(rgStrokes, cStrokes, rgResults, LOAD_RESULTS, rgcResults);
+
+        for (int i = 0; i < cStrokes; i++)
+        {
+            int cb = rgcResults[i] * (int)sizeof(GestureResult);
+            void* pv = results.BeginWrite(rgMessages[i].uId, cb, (int)(LOAD_DRAIN_TIMEOUT / 1000000));
+            if (NULL == pv)
+                return false;
+            memcpy(pv, rgResults + i * LOAD_RESULTS, cb);
+            results.EndWrite();
+        }
+        results.Publish();
+        strokes.Release();
+        if (bDone)
+            return true;
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CaptureToSocket
+//
+// The capture process of the socket: encodes each stroke
+// into a request to the service, on one connection, many
+// in flight, and decodes the responses.
+//
+/////////////////////////////////////////////////////////
+static void CaptureToSocket(const CaptureLoad& load, const char* pszPath, CaptureReport& report)
+{
+    PERFTIME ptCpuStart = GetProcessCpuTime();
+    CServicePoller poller;
+    ServiceSocket s = ServiceConnect(pszPath);
+    if (GS_INVALID_SOCKET == s || false == poller.Create() || false == poller.Add(s, GS_EVENT_READ, NULL))
+    {
+        report.bFailed = true;
+        return;
+    }
+
+    CCaptureState state(load);
+    CServiceBuffer in, out;
+    unsigned int uEvents = GS_EVENT_READ;
+    bool bFailed = false;
+    while (false == bFailed)
+    {
+        PERFTIME ptNow = PerfNow();
+        if (false == state.IsSending(ptNow) && 0 == state.cInFlight)
+            break;
+        if (ptNow > state.ptStart + load.ptDuration + LOAD_DRAIN_TIMEOUT)
+        {
+            bFailed = true;
+            break;
+        }
+
+        int iStroke;
+        while (state.IsDue(ptNow, iStroke) && out.GetSize() < GS_MAX_BODY)
+        {
+            const LoadStroke& stroke = load.pStrokes[iStroke];
+            if (false == CGestureProtocol::WriteRecognize(out, state.uNextId, load.piPoints + 2 * stroke.iPoint,
+                                                          stroke.cPoints, LOAD_RESULTS))
+            {
+                bFailed = true;
+                break;
+            }
+            state.Sent(iStroke);
+        }
+        while (out.GetSize() > 0 && false == bFailed)
+        {
+            int cb = ServiceSend(s, out.GetData(), out.GetSize());
+            if (cb < 0)
+                bFailed = true;
+            if (cb <= 0)
+                break;
+            out.Consume(cb);
+        }
+        unsigned int uWanted = GS_EVENT_READ | ((out.GetSize() > 0) ? GS_EVENT_WRITE : 0);
+        if (uWanted != uEvents)
+        {
+            uEvents = uWanted;
+            poller.Modify(s, uEvents, NULL);
+        }
+
+        ServiceEvent rgEvents[1];
+        if (poller.Wait(rgEvents, 1, state.GetWaitMs(PerfNow())) <= 0 ||
+            0 == (rgEvents[0].uEvents & (GS_EVENT_READ | GS_EVENT_ERROR)))
+            continue;
+        for (;;)
+        {
+            unsigned char* pb = in.Reserve(16384);
+            int cb = (NULL != pb) ? ServiceRecv(s, pb, 16384) : -1;
+            if (cb < 0)
+                bFailed = true;
+            if (cb <= 0)
+                break;
+            in.Commit(cb);
+        }
+        while (in.GetSize() >= GS_HEADER_SIZE)
+        {
+            ServiceHeader header;
+            CGestureProtocol::DecodeHeader(in.GetData(), header);
+            if (in.GetSize() < GS_HEADER_SIZE + (int)header.cbBody)
+                break;
+
+            const LoadStroke& stroke = load.pStrokes[state.rgSent[header.uId % RING_MAX_IN_FLIGHT].iStroke];
+            GestureResult rgResults[LOAD_RESULTS];
+            int cResults = 0;
+            bool bMatches = CGestureProtocol::DecodeResults(header, in.GetData() + GS_HEADER_SIZE,
+                                                            rgResults, LOAD_RESULTS, cResults) &&
+                            cResults == stroke.cResults;
+            for (int j = 0; j < cResults && bMatches; j++)
+            {
+                bMatches = (rgResults[j].iGesture == stroke.rgResults[j].iGesture &&
+                            CGestureProtocol::ScoreToWord(rgResults[j].fScore) ==
+                            CGestureProtocol::ScoreToWord(stroke.rgResults[j].fScore));
+            }
+            in.Consume(GS_HEADER_SIZE + header.cbBody);
+            state.Answered(header.uId, bMatches);
+        }
+    }
+
+    ServiceClose(s);
+    ReportCapture(state, ptCpuStart, bFailed, report);
+}
+
+/////////////////////////////////////////////////////////
+//
+// RunTransport
+//
+// Runs a capture process against a recognizer, this one,
+// over a transport, and prints the throughput, the
+// latencies and the CPU time of each side per stroke.
+//
+// Return Values (bool):
+//      true if succeeded, false if a side failed or an
+//      answer differs from the local engine
+//
+/////////////////////////////////////////////////////////
+static bool RunTransport(
+        const CGestureEngine& engine,
+        int iTransport,
+        const CaptureLoad& load
+        )
+{
+    CaptureReport* pReport = (CaptureReport*)mmap(NULL, sizeof(CaptureReport), PROT_READ | PROT_WRITE,
+                                                  MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == pReport)
+        return false;
+    memset(pReport, 0, sizeof(CaptureReport));
+
+    char szPath[64];
+    snprintf(szPath, sizeof(szPath), "/tmp/gesture-transport-%d.sock", (int)getpid());
+    CGestureService service(engine);
+    CSharedRing strokes, results;
+    bool bStarted = (TRANSPORT_RING == iTransport)
+                        ? (strokes.Create(RING_STROKE_BYTES) && results.Create(RING_RESULT_BYTES))
+                        : service.Start(szPath, 1);
+    if (false == bStarted)
+    {
+        fprintf(stderr, "can't set up the %s\n", (TRANSPORT_RING == iTransport) ? "rings" : "service");
+        munmap(pReport, sizeof(CaptureReport));
+        return false;
+    }
+
+    PERFTIME ptCpuStart = GetProcessCpuTime();
+    fflush(stdout);
+    pid_t pid = fork();
+    if (0 == pid)
+    {
+        if (TRANSPORT_RING == iTransport)
+            CaptureToRing(load, strokes.GetName(), results.GetName(), *pReport);
+        else
+            CaptureToSocket(load, szPath, *pReport);
+        _exit(0);
+    }
+
+    bool bSucceeded = (pid > 0);
+    if (bSucceeded && TRANSPORT_RING == iTransport)
+        bSucceeded = RecognizeFromRing(engine, strokes, results);
+    if (pid > 0)
+    {
+        if (false == bSucceeded)
+            kill(pid, SIGKILL);
+        int iStatus;
+        waitpid(pid, &iStatus, 0);
+    }
+    PERFTIME ptCpu = GetProcessCpuTime() - ptCpuStart;
+    service.Stop();
+
+    const CaptureReport& report = *pReport;
+    bSucceeded = bSucceeded && false == report.bFailed && report.cAnswered > 0;
+    if (bSucceeded)
+    {
+        char szRate[16];
+        snprintf(szRate, sizeof(szRate), (load.iRate > 0) ? "%d" : "max", load.iRate);
+        printf("%-6s  %6s  %9.0f  %8.1f  %8.1f  %8.1f  %8.2f  %8.2f\n",
+               (TRANSPORT_RING == iTransport) ? "ring" : "socket", szRate,
+               report.cAnswered * 1e9 / report.ptElapsed,
+               report.rgptPercentiles[0] / 1e3, report.rgptPercentiles[1] / 1e3,
+               report.rgptPercentiles[2] / 1e3,
+               report.ptCpu / 1e3 / report.cAnswered, ptCpu / 1e3 / report.cAnswered);
+    }
+    else
+    {
+        fprintf(stderr, "the %s transport failed\n", (TRANSPORT_RING == iTransport) ? "ring" : "socket");
+    }
+    if (report.cMismatches > 0)
+    {
+        printf("%lld of %lld answers differ from the local engine\n", report.cMismatches, report.cAnswered);
+        bSucceeded = false;
+    }
+    munmap(pReport, sizeof(CaptureReport));
+    return bSucceeded;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CompareTransports
+//
+// Hands the strokes of a capture process to the recognizer
+// over the socket of the service and over a pair of shared
+// rings, at a few rates.
+//
+/////////////////////////////////////////////////////////
+static int CompareTransports(const CGestureEngine& engine, int iRate, double dSeconds)
+{
+    if (false == ServiceStartup())
+        return 1;
+
+    LoadStroke* pStrokes = (LoadStroke*)malloc(LOAD_STROKES * sizeof(LoadStroke));
+    int* piPoints = (int*)malloc(2 * LOAD_STROKES * LOAD_MAX_POINTS * sizeof(int));
+    if (NULL == pStrokes || NULL == piPoints)
+    {
+        free(pStrokes);
+        free(piPoints);
+        return 1;
+    }
+    MakeLoadStrokes(engine, pStrokes, piPoints);
+    int cPoints = 0;
+    for (int i = 0; i < LOAD_STROKES; i++)
+        cPoints += pStrokes[i].cPoints;
+    printf("%d strokes of %d points on average, %d alternates each\n",
+           LOAD_STROKES, cPoints / LOAD_STROKES, LOAD_RESULTS);
+    printf("                          latency us                  cpu us per stroke\n"
+           "          rate  strokes/s       p50       p99     p99.9   capture  recognizer\n");
+
+    static const int c_rgiRates[] = { 2000, 5000, 10000, 20000, 0 };
+    int cRates = (iRate >= 0) ? 1 : countof(c_rgiRates);
+    int iResult = 0;
+    for (int i = 0; i < cRates && 0 == iResult; i++)
+    {
+        CaptureLoad load;
+        load.pStrokes = pStrokes;
+        load.piPoints = piPoints;
+        load.iRate = (iRate >= 0) ? iRate : c_rgiRates[i];
+        load.ptDuration = (PERFTIME)(dSeconds * 1e9);
+        if (false == RunTransport(engine, TRANSPORT_SOCKET, load) ||
+            false == RunTransport(engine, TRANSPORT_RING, load))
+            iResult = 1;
+    }
+
+    free(pStrokes);
+    free(piPoints);
+    return iResult;
+}
+
+#endif // __linux__
+
+int main(int argc, char** argv)
+{
+    const char* pszPath = GS_DEFAULT_PATH;
+    const char* pszPack = NULL;
+    bool bLoad = false;
+    bool bTransport = false;
+    int iRate = -1;
+    bool bUsage = false;
+    int cThreads = 2;
+    int cMaxBatch = GE_MAX_BATCH;
+    int iBudgetUs = 0;
+    int cClients = 0;
+    double dSeconds = 3.0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "-socket") && i + 1 < argc)
+            pszPath = argv[++i];
+        else if (0 == strcmp(argv[i], "-p") && i + 1 < argc)
+            pszPack = argv[++i];
+        else if (0 == strcmp(argv[i], "-threads") && i + 1 < argc)
+            cThreads = atoi(argv[++i]);
+        else if (0 == strcmp(argv[i], "-batch") && i + 1 < argc)
+            cMaxBatch = atoi(argv[++i]);
+        else if (0 == strcmp(argv[i], "-budget") && i + 1 < argc)
+            iBudgetUs = atoi(argv[++i]);
+        else if (0 == strcmp(argv[i], "-load"))
+            bLoad = true;
+        else if (0 == strcmp(argv[i], "-transport"))
+            bTransport = true;
+        else if (0 == strcmp(argv[i], "-rate") && i + 1 < argc)
+            iRate = atoi(argv[++i]);
+        else if (0 == strcmp(argv[i], "-clients") && i + 1 < argc)
+            cClients = atoi(argv[++i]);
+        else if (0 == strcmp(argv[i], "-seconds") && i + 1 < argc)
+            dSeconds = atof(argv[++i]);
+        else
+            bUsage = true;
+    }
+
+    if (bUsage || (bLoad && bTransport) || cThreads < 1 || cMaxBatch < 1 || cMaxBatch > GE_MAX_BATCH || dSeconds <= 0 ||
+        iBudgetUs < 0)
+    {
+        printf("usage: GestureServer [-socket path] [-p pack.gpk] [-threads n] [-batch n]\n"
+               "                     [-budget us]\n"
+               "       GestureServer -load [-socket path] [-p pack.gpk] [-clients n]\n"
+               "                     [-seconds s]\n"
+               "       GestureServer -transport [-p pack.gpk] [-rate n] [-seconds s]\n");
+        return 1;
+    }
+
+    CGestureEngine engine;
+    CTemplatePack pack;
+    if (false == SetUpEngine(engine, pack, pszPack))
+        return 1;
+
+    if (bTransport)
+    {
+#ifdef __linux__
+        return CompareTransports(engine, iRate, dSeconds);
+#else
+        fprintf(stderr, "-transport runs on Linux only\n");
+        return 1;
+#endif
+    }
+    if (bLoad)
+        return Load(engine, pszPath, cClients, dSeconds);
+    return Serve(engine, pszPath, cThreads, cMaxBatch, iBudgetUs);
+}
@@ -0,0 +1,1702 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      GestureService.cpp
+//
+// Description:
+//      The file contains the definitions of the methods of the classes
+//      CServiceBuffer, CGestureProtocol, CServicePoller, CGestureService
+//      and CGestureClient, and of the socket helpers. See the file
+//      GestureService.h for the definitions of the classes.
+//--------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <afunix.h>
+#pragma comment(lib, "ws2_32.lib")
+#endif
+
+#include "GestureService.h"
+#include "Trace.h"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#ifdef GS_USE_EPOLL
+#include <sys/epoll.h>
+#endif
+#endif
+
+#ifdef _WIN32
+typedef WSAPOLLFD ServicePollFd;
+#define ServicePoll     ::WSAPoll
+#else
+typedef struct pollfd ServicePollFd;
+#define ServicePoll     poll
+#endif
+
+// The bytes a connection reads in a call, and the output it may have
+// queued before it's read no more until the client takes some
+#define GS_READ_SIZE            16384
+#define GS_MAX_OUTPUT           (1 << 20)
+#define GS_MAX_EVENTS           256
+#define GS_WAIT_MS              50      // how often a loop checks for Stop
+#define GS_CLIENT_TIMEOUT_MS    5000
+
+// A thread
+struct ServiceThread
+{
+#ifdef _WIN32
+    HANDLE              hThread;
+#else
+    pthread_t           thread;
+#endif
+};
+
+#ifdef _WIN32
+typedef LPTHREAD_START_ROUTINE PFNSERVICETHREAD;
+#else
+typedef void* (*PFNSERVICETHREAD)(void* pv);
+#endif
+
+static bool ThreadCreate(ServiceThread* pThread, PFNSERVICETHREAD pfnStart, void* pv)
+{
+#ifdef _WIN32
+    pThread->hThread = ::CreateThread(NULL, 0, pfnStart, pv, 0, NULL);
+    return (NULL != pThread->hThread);
+#else
+    return (0 == pthread_create(&pThread->thread, NULL, pfnStart, pv));
+#endif
+}
+
+static void ThreadJoin(ServiceThread* pThread)
+{
+#ifdef _WIN32
+    ::WaitForSingleObject(pThread->hThread, INFINITE);
+    ::CloseHandle(pThread->hThread);
+#else
+    pthread_join(pThread->thread, NULL);
+#endif
+}
+
+// Makes room for cNeeded items in a malloc'ed array
+static bool GrowArray(void** ppv, int* pcMax, int cNeeded, size_t cbItem)
+{
+    if (cNeeded <= *pcMax)
+        return true;
+    int cMax = (*pcMax > 0) ? 2 * *pcMax : 16;
+    if (cMax < cNeeded)
+        cMax = cNeeded;
+    void* pv = realloc(*ppv, (size_t)cMax * cbItem);
+    if (NULL == pv)
+        return false;
+    *ppv = pv;
+    *pcMax = cMax;
+    return true;
+}
+
+// A client connection
+struct ServiceConnection
+{
+    ServiceSocket       s;
+    int                 iSlot;          // in the loop's ppConns
+    unsigned int        uEvents;        // the events polled for
+    bool                bDirty;         // has output to flush
+    bool                bClosed;
+    CServiceBuffer      in;
+    CServiceBuffer      out;
+};
+
+// A stroke waiting for the batch
+struct ServicePending
+{
+    ServiceConnection*  pConn;
+    unsigned int        uId;
+    int                 cMaxResults;
+    int                 iPoint;         // in the loop's pPoints
+    int                 cPoints;
+    PERFTIME            ptRead;         // when the request was parsed
+};
+
+// An event loop, run by a thread of its own
+struct ServiceLoop
+{
+    CGestureService*    pService;
+    ServiceThread       thread;
+    CServicePoller      poller;
+
+    ServiceConnection** ppConns;
+    int                 cConns;
+    int                 cMaxConns;
+    ServiceConnection** ppClosed;       // freed at the end of the iteration
+    int                 cClosed;
+    ServiceConnection** ppDirty;        // to flush at the end of the iteration
+    int                 cDirty;
+
+    ServicePending*     pPending;
+    int                 cPending;
+    int                 cMaxPending;
+    GesturePoint*       pPoints;
+    int                 cPoints;
+    int                 cMaxPoints;
+
+    // One batch
+    GestureStroke*      pStrokes;
+    GestureResult*      pResults;       // GE_NUM_SSGESTURES per stroke
+    int*                pcResults;
+
+    CQualityScheduler   scheduler;
+    ServiceStats        stats;          // written by the loop's thread only
+};
+
+// Buffer ///////////////////////////////////////////////
+
+CServiceBuffer::~CServiceBuffer()
+{
+    free(m_pb);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CServiceBuffer::Reserve
+//
+// Makes room for cb bytes at the end of the buffer. The
+// bytes are added by Commit.
+//
+// Return Values (unsigned char*):
+//      where to write the bytes, NULL if out of memory
+//
+/////////////////////////////////////////////////////////
+unsigned char* CServiceBuffer::Reserve(int cb)
+{
+    if (m_cb + cb > m_cbMax)
+    {
+        if (m_iStart > 0)
+        {
+            memmove(m_pb, m_pb + m_iStart, m_cb - m_iStart);
+            m_cb -= m_iStart;
+            m_iStart = 0;
+        }
+        if (m_cb + cb > m_cbMax)
+        {
+            int cbMax = (m_cbMax > 0) ? 2 * m_cbMax : 4096;
+            if (cbMax < m_cb + cb)
+                cbMax = m_cb + cb;
+            unsigned char* pb = (unsigned char*)realloc(m_pb, cbMax);
+            if (NULL == pb)
+                return NULL;
+            m_pb = pb;
+            m_cbMax = cbMax;
+        }
+    }
+    return m_pb + m_cb;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CServiceBuffer::Consume
+//
+// Drops cb bytes from the front of the buffer.
+//
+/////////////////////////////////////////////////////////
+void CServiceBuffer::Consume(int cb)
+{
+    m_iStart += cb;
+    if (m_iStart >= m_cb)
+        m_iStart = m_cb = 0;
+}
+
+// Protocol /////////////////////////////////////////////
+
+static void PutUInt16(unsigned char* pb, unsigned int u)
+{
+    pb[0] = (unsigned char)u;
+    pb[1] = (unsigned char)(u >> 8);
+}
+
+static void PutUInt32(unsigned char* pb, unsigned int u)
+{
+    PutUInt16(pb, u & 0xFFFF);
+    PutUInt16(pb + 2, u >> 16);
+}
+
+static unsigned int GetUInt16(const unsigned char* pb)
+{
+    return pb[0] | ((unsigned int)pb[1] << 8);
+}
+
+static unsigned int GetUInt32(const unsigned char* pb)
+{
+    return GetUInt16(pb) | (GetUInt16(pb + 2) << 16);
+}
+
+void CGestureProtocol::EncodeHeader(const ServiceHeader& header, unsigned char* pb)
+{
+    PutUInt32(pb, header.cbBody);
+    PutUInt32(pb + 4, header.uId);
+    pb[8] = header.uType;
+    pb[9] = header.uParam;
+    PutUInt16(pb + 10, header.cItems);
+}
+
+void CGestureProtocol::DecodeHeader(const unsigned char* pb, ServiceHeader& header)
+{
+    header.cbBody = GetUInt32(pb);
+    header.uId = GetUInt32(pb + 4);
+    header.uType = pb[8];
+    header.uParam = pb[9];
+    header.cItems = (unsigned short)GetUInt16(pb + 10);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureProtocol::EncodePoints
+//
+// Encodes the points of a stroke: the first one as is, the
+// others as the deltas from the point before, each number
+// zigzag mapped and written as a varint. A pen's points are
+// a few units apart, so most take 2 bytes a point.
+//
+// Parameters:
+//     const int* piPoints  : [in] the x, y pairs
+//     int cPoints          : [in] the number of the points
+//     unsigned char* pb    : [out] 10 bytes per point at most
+//
+// Return Values (int):
+//      the number of bytes written
+//
+/////////////////////////////////////////////////////////
+int CGestureProtocol::EncodePoints(
+        const int* piPoints,
+        int cPoints,
+        unsigned char* pb
+        )
+{
+    int cb = 0;
+    unsigned int uPrev[2] = { 0, 0 };
+    for (int i = 0; i < 2 * cPoints; i++)
+    {
+        // The delta wraps around, the decoder wraps it back
+        unsigned int uDelta = (unsigned int)piPoints[i] - uPrev[i & 1];
+        uPrev[i & 1] = (unsigned int)piPoints[i];
+        unsigned int u = (uDelta << 1) ^ (0 - (uDelta >> 31));
+        while (u >= 0x80)
+        {
+            pb[cb++] = (unsigned char)(u | 0x80);
+            u >>= 7;
+        }
+        pb[cb++] = (unsigned char)u;
+    }
+    return cb;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureProtocol::DecodePoints
+//
+// Decodes the points EncodePoints wrote.
+//
+// Parameters:
+//     const unsigned char* pb  : [in] the encoded points
+//     int cb                   : [in] their size, all of it is the points
+//     GesturePoint* ppt        : [out] the points
+//     int cPoints              : [in] the number of the points
+//
+// Return Values (bool):
+//      true if succeeded, false if the bytes aren't cPoints
+//      points
+//
+/////////////////////////////////////////////////////////
+bool CGestureProtocol::DecodePoints(
+        const unsigned char* pb,
+        int cb,
+        GesturePoint* ppt,
+        int cPoints
+        )
+{
+    int ib = 0;
+    unsigned int uPrev[2] = { 0, 0 };
+    for (int i = 0; i < 2 * cPoints; i++)
+    {
+        unsigned int u = 0;
+        for (int iShift = 0; ; iShift += 7)
+        {
+            if (ib >= cb || iShift > 28)
+                return false;
+            unsigned int b = pb[ib++];
+            u |= (b & 0x7F) << iShift;
+            if (b < 0x80)
+                break;
+        }
+        unsigned int uDelta = (u >> 1) ^ (0 - (u & 1));
+        uPrev[i & 1] += uDelta;
+        float f = (float)(int)uPrev[i & 1];
+        if (i & 1)
+            ppt[i >> 1].y = f;
+        else
+            ppt[i >> 1].x = f;
+    }
+    return (ib == cb);
+}
+
+// Maps a 0..1 score to 16 bits
+unsigned short CGestureProtocol::ScoreToWord(float fScore)
+{
+    if (fScore <= 0.0f)
+        return 0;
+    if (fScore >= 1.0f)
+        return 0xFFFF;
+    return (unsigned short)(fScore * 65535.0f + 0.5f);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureProtocol::WriteMessage
+//
+// Appends a message to a buffer.
+//
+// Return Values (bool):
+//      true if succeeded, false if out of memory
+//
+/////////////////////////////////////////////////////////
+bool CGestureProtocol::WriteMessage(
+        CServiceBuffer& buf,
+        unsigned int uId,
+        int iType,
+        int iParam,
+        int cItems,
+        const void* pvBody,
+        int cbBody
+        )
+{
+    unsigned char* pb = buf.Reserve(GS_HEADER_SIZE + cbBody);
+    if (NULL == pb)
+        return false;
+
+    ServiceHeader header;
+    header.cbBody = cbBody;
+    header.uId = uId;
+    header.uType = (unsigned char)iType;
+    header.uParam = (unsigned char)iParam;
+    header.cItems = (unsigned short)cItems;
+    EncodeHeader(header, pb);
+    if (cbBody > 0)
+        memcpy(pb + GS_HEADER_SIZE, pvBody, cbBody);
+    buf.Commit(GS_HEADER_SIZE + cbBody);
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureProtocol::WriteRecognize
+//
+// Appends a recognition request to a buffer.
+//
+// Return Values (bool):
+//      true if succeeded, false if out of memory or the
+//      stroke has no points or too many
+//
+/////////////////////////////////////////////////////////
+bool CGestureProtocol::WriteRecognize(
+        CServiceBuffer& buf,
+        unsigned int uId,
+        const int* piPoints,
+        int cPoints,
+        int cMaxResults
+        )
+{
+    if (cPoints <= 0 || cPoints > GS_MAX_POINTS)
+        return false;
+    if (cMaxResults > GE_NUM_SSGESTURES)
+        cMaxResults = GE_NUM_SSGESTURES;
+
+    unsigned char* pb = buf.Reserve(GS_HEADER_SIZE + 10 * cPoints);
+    if (NULL == pb)
+        return false;
+
+    ServiceHeader header;
+    header.cbBody = EncodePoints(piPoints, cPoints, pb + GS_HEADER_SIZE);
+    header.uId = uId;
+    header.uType = GS_REQ_RECOGNIZE;
+    header.uParam = (unsigned char)cMaxResults;
+    header.cItems = (unsigned short)cPoints;
+    EncodeHeader(header, pb);
+    buf.Commit(GS_HEADER_SIZE + header.cbBody);
+    return true;
+}
+
+bool CGestureProtocol::WriteResults(
+        CServiceBuffer& buf,
+        unsigned int uId,
+        const GestureResult* pResults,
+        int cResults,
+        int iTier
+        )
+{
+    unsigned char rgb[3 * GE_NUM_SSGESTURES];
+    if (cResults > GE_NUM_SSGESTURES)
+        cResults = GE_NUM_SSGESTURES;
+    for (int i = 0; i < cResults; i++)
+    {
+        rgb[3 * i] = (unsigned char)pResults[i].iGesture;
+        PutUInt16(rgb + 3 * i + 1, ScoreToWord(pResults[i].fScore));
+    }
+    return WriteMessage(buf, uId, GS_RSP_RESULTS, iTier, cResults, rgb, 3 * cResults);
+}
+
+bool CGestureProtocol::WriteName(
+        CServiceBuffer& buf,
+        unsigned int uId,
+        const char* pszName
+        )
+{
+    return WriteMessage(buf, uId, GS_RSP_NAME, 0, 0, pszName, (int)strlen(pszName));
+}
+
+bool CGestureProtocol::WriteStats(
+        CServiceBuffer& buf,
+        unsigned int uId,
+        const ServiceStats& stats
+        )
+{
+    unsigned long long rgull[GS_STATS_FIELDS] = { stats.cConnections, stats.cRequests,
+                                                  stats.cBatches, stats.cErrors };
+    for (int i = 0; i < QS_NUM_TIERS; i++)
+        rgull[4 + i] = stats.rgcTiers[i];
+    unsigned char rgb[sizeof(rgull)];
+    for (int i = 0; i < GS_STATS_FIELDS; i++)
+    {
+        PutUInt32(rgb + 8 * i, (unsigned int)rgull[i]);
+        PutUInt32(rgb + 8 * i + 4, (unsigned int)(rgull[i] >> 32));
+    }
+    return WriteMessage(buf, uId, GS_RSP_STATS, 0, 0, rgb, sizeof(rgb));
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureProtocol::DecodeResults
+//
+// Decodes the body of a GS_RSP_RESULTS message. The
+// template of an alternate isn't sent; it's -1.
+//
+// Return Values (bool):
+//      true if succeeded, false if the message is malformed
+//
+/////////////////////////////////////////////////////////
+bool CGestureProtocol::DecodeResults(
+        const ServiceHeader& header,
+        const unsigned char* pb,
+        GestureResult* pResults,
+        int cMaxResults,
+        int& cResults
+        )
+{
+    cResults = 0;
+    if (GS_RSP_RESULTS != header.uType || header.cbBody != 3u * header.cItems ||
+        header.uParam >= QS_NUM_TIERS)
+        return false;
+    for (int i = 0; i < header.cItems; i++)
+    {
+        if (pb[3 * i] >= GE_NUM_SSGESTURES)
+            return false;
+        if (cResults < cMaxResults)
+        {
+            pResults[cResults].iGesture = pb[3 * i];
+            pResults[cResults].iTemplate = -1;
+            pResults[cResults].fScore = GetUInt16(pb + 3 * i + 1) / 65535.0f;
+            cResults++;
+        }
+    }
+    return true;
+}
+
+bool CGestureProtocol::DecodeStats(
+        const ServiceHeader& header,
+        const unsigned char* pb,
+        ServiceStats& stats
+        )
+{
+    if (GS_RSP_STATS != header.uType || header.cbBody != 8 * GS_STATS_FIELDS)
+        return false;
+    unsigned long long rgull[GS_STATS_FIELDS];
+    for (int i = 0; i < GS_STATS_FIELDS; i++)
+        rgull[i] = GetUInt32(pb + 8 * i) | ((unsigned long long)GetUInt32(pb + 8 * i + 4) << 32);
+    stats.cConnections = rgull[0];
+    stats.cRequests = rgull[1];
+    stats.cBatches = rgull[2];
+    stats.cErrors = rgull[3];
+    for (int i = 0; i < QS_NUM_TIERS; i++)
+        stats.rgcTiers[i] = rgull[4 + i];
+    return true;
+}
+
+// Sockets //////////////////////////////////////////////
+
+static bool SetNonBlocking(ServiceSocket s)
+{
+#ifdef _WIN32
+    u_long ulOn = 1;
+    return (0 == ::ioctlsocket(s, FIONBIO, &ulOn));
+#else
+    int iFlags = fcntl(s, F_GETFL, 0);
+    return (iFlags >= 0 && 0 == fcntl(s, F_SETFL, iFlags | O_NONBLOCK));
+#endif
+}
+
+static bool MakeAddress(const char* pszPath, sockaddr_un& addr)
+{
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(pszPath) >= sizeof(addr.sun_path))
+        return false;
+    strcpy(addr.sun_path, pszPath);
+    return true;
+}
+
+static bool WouldBlock()
+{
+#ifdef _WIN32
+    return (WSAEWOULDBLOCK == ::WSAGetLastError());
+#else
+    return (EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno);
+#endif
+}
+
+// Starts the socket library of the process
+bool ServiceStartup()
+{
+#ifdef _WIN32
+    WSADATA wsad;
+    return (0 == ::WSAStartup(MAKEWORD(2, 2), &wsad));
+#else
+    return true;
+#endif
+}
+
+/////////////////////////////////////////////////////////
+//
+// ServiceListen
+//
+// Creates the listening socket of the service at a path,
+// replacing a socket file a service left behind.
+//
+// Return Values (ServiceSocket):
+//      the socket, which doesn't block, or GS_INVALID_SOCKET
+//
+/////////////////////////////////////////////////////////
+ServiceSocket ServiceListen(const char* pszPath)
+{
+    sockaddr_un addr;
+    if (false == MakeAddress(pszPath, addr))
+        return GS_INVALID_SOCKET;
+
+    ServiceSocket s = (ServiceSocket)socket(AF_UNIX, SOCK_STREAM, 0);
+    if (GS_INVALID_SOCKET == s)
+        return GS_INVALID_SOCKET;
+
+#ifdef _WIN32
+    ::DeleteFileA(pszPath);
+#else
+    unlink(pszPath);
+#endif
+    if (0 != bind(s, (const sockaddr*)&addr, sizeof(addr)) ||
+        0 != listen(s, SOMAXCONN) || false == SetNonBlocking(s))
+    {
+        ServiceClose(s);
+        return GS_INVALID_SOCKET;
+    }
+    return s;
+}
+
+/////////////////////////////////////////////////////////
+//
+// ServiceConnect
+//
+// Connects to the service at a path.
+//
+// Return Values (ServiceSocket):
+//      the socket, which doesn't block, or GS_INVALID_SOCKET
+//
+/////////////////////////////////////////////////////////
+ServiceSocket ServiceConnect(const char* pszPath)
+{
+    sockaddr_un addr;
+    if (false == MakeAddress(pszPath, addr))
+        return GS_INVALID_SOCKET;
+
+    ServiceSocket s = (ServiceSocket)socket(AF_UNIX, SOCK_STREAM, 0);
+    if (GS_INVALID_SOCKET == s)
+        return GS_INVALID_SOCKET;
+    if (0 != connect(s, (const sockaddr*)&addr, sizeof(addr)) || false == SetNonBlocking(s))
+    {
+        ServiceClose(s);
+        return GS_INVALID_SOCKET;
+    }
+    return s;
+}
+
+ServiceSocket ServiceAccept(ServiceSocket sListen)
+{
+    ServiceSocket s = (ServiceSocket)accept(sListen, NULL, NULL);
+    if (GS_INVALID_SOCKET != s && false == SetNonBlocking(s))
+    {
+        ServiceClose(s);
+        s = GS_INVALID_SOCKET;
+    }
+    return s;
+}
+
+int ServiceSend(ServiceSocket s, const void* pv, int cb)
+{
+#if defined(_WIN32)
+    int cbSent = ::send(s, (const char*)pv, cb, 0);
+#elif defined(MSG_NOSIGNAL)
+    int cbSent = (int)send(s, pv, cb, MSG_NOSIGNAL);
+#else
+    int cbSent = (int)send(s, pv, cb, 0);
+#endif
+    if (cbSent < 0)
+        return WouldBlock() ? 0 : -1;
+    return cbSent;
+}
+
+int ServiceRecv(ServiceSocket s, void* pv, int cb)
+{
+    int cbRecv = (int)recv(s, (char*)pv, cb, 0);
+    if (0 == cbRecv)
+        return -1;
+    if (cbRecv < 0)
+        return WouldBlock() ? 0 : -1;
+    return cbRecv;
+}
+
+void ServiceClose(ServiceSocket s)
+{
+#ifdef _WIN32
+    ::closesocket(s);
+#else
+    close(s);
+#endif
+}
+
+// Waits for a socket to be ready, for the blocking client
+static bool WaitSocket(ServiceSocket s, bool bWrite, int iTimeoutMs)
+{
+    ServicePollFd pfd;
+    pfd.fd = s;
+    pfd.events = bWrite ? POLLOUT : POLLIN;
+    pfd.revents = 0;
+    return (ServicePoll(&pfd, 1, iTimeoutMs) > 0);
+}
+
+// Poller ///////////////////////////////////////////////
+
+CServicePoller::CServicePoller()
+{
+#ifdef GS_USE_EPOLL
+    m_fdEpoll = -1;
+    m_pEvents = NULL;
+    m_cMaxEvents = 0;
+#else
+    m_pFds = NULL;
+    m_ppv = NULL;
+    m_cFds = 0;
+    m_cMaxFds = 0;
+    m_iNextFd = 0;
+#endif
+}
+
+CServicePoller::~CServicePoller()
+{
+#ifdef GS_USE_EPOLL
+    if (m_fdEpoll >= 0)
+        close(m_fdEpoll);
+    free(m_pEvents);
+#else
+    free(m_pFds);
+    free(m_ppv);
+#endif
+}
+
+bool CServicePoller::Create()
+{
+#ifdef GS_USE_EPOLL
+    m_fdEpoll = epoll_create1(EPOLL_CLOEXEC);
+    return (m_fdEpoll >= 0);
+#else
+    return true;
+#endif
+}
+
+#ifdef GS_USE_EPOLL
+static unsigned int ToEpollEvents(unsigned int uEvents)
+{
+    return ((uEvents & GS_EVENT_READ) ? (unsigned int)EPOLLIN : 0) |
+           ((uEvents & GS_EVENT_WRITE) ? (unsigned int)EPOLLOUT : 0);
+}
+#else
+static short ToPollEvents(unsigned int uEvents)
+{
+    return (short)(((uEvents & GS_EVENT_READ) ? POLLIN : 0) |
+                   ((uEvents & GS_EVENT_WRITE) ? POLLOUT : 0));
+}
+#endif
+
+/////////////////////////////////////////////////////////
+//
+// CServicePoller::Add
+//
+// Starts polling a socket.
+//
+// Parameters:
+//     ServiceSocket s       : [in] the socket
+//     unsigned int uEvents  : [in] GS_EVENT_READ and/or GS_EVENT_WRITE;
+//                             the errors are always reported
+//     void* pv              : [in] returned with the socket's events
+//
+// Return Values (bool):
+//      true if succeeded, false if out of memory
+//
+/////////////////////////////////////////////////////////
+bool CServicePoller::Add(
+        ServiceSocket s,
+        unsigned int uEvents,
+        void* pv
+        )
+{
+#ifdef GS_USE_EPOLL
+    epoll_event ev;
+    ev.events = ToEpollEvents(uEvents);
+    ev.data.ptr = pv;
+    return (0 == epoll_ctl(m_fdEpoll, EPOLL_CTL_ADD, s, &ev));
+#else
+    int cMaxFds = m_cMaxFds;
+    if (false == GrowArray(&m_pFds, &cMaxFds, m_cFds + 1, sizeof(ServicePollFd)))
+        return false;
+    if (false == GrowArray((void**)&m_ppv, &m_cMaxFds, m_cFds + 1, sizeof(void*)))
+        return false;
+    ServicePollFd* pFds = (ServicePollFd*)m_pFds;
+    pFds[m_cFds].fd = s;
+    pFds[m_cFds].events = ToPollEvents(uEvents);
+    pFds[m_cFds].revents = 0;
+    m_ppv[m_cFds] = pv;
+    m_cFds++;
+    return true;
+#endif
+}
+
+bool CServicePoller::Modify(
+        ServiceSocket s,
+        unsigned int uEvents,
+        void* pv
+        )
+{
+#ifdef GS_USE_EPOLL
+    epoll_event ev;
+    ev.events = ToEpollEvents(uEvents);
+    ev.data.ptr = pv;
+    return (0 == epoll_ctl(m_fdEpoll, EPOLL_CTL_MOD, s, &ev));
+#else
+    ServicePollFd* pFds = (ServicePollFd*)m_pFds;
+    for (int i = 0; i < m_cFds; i++)
+    {
+        if (pFds[i].fd == s)
+        {
+            pFds[i].events = ToPollEvents(uEvents);
+            m_ppv[i] = pv;
+            return true;
+        }
+    }
+    return false;
+#endif
+}
+
+void CServicePoller::Remove(ServiceSocket s)
+{
+#ifdef GS_USE_EPOLL
+    epoll_event ev;
+    epoll_ctl(m_fdEpoll, EPOLL_CTL_DEL, s, &ev);
+#else
+    ServicePollFd* pFds = (ServicePollFd*)m_pFds;
+    for (int i = 0; i < m_cFds; i++)
+    {
+        if (pFds[i].fd == s)
+        {
+            m_cFds--;
+            pFds[i] = pFds[m_cFds];
+            m_ppv[i] = m_ppv[m_cFds];
+            return;
+        }
+    }
+#endif
+}
+
+/////////////////////////////////////////////////////////
+//
+// CServicePoller::Wait
+//
+// Waits for some of the sockets to be ready.
+//
+// Parameters:
+//     ServiceEvent* pEvents : [out] the sockets that are ready
+//     int cMaxEvents        : [in] the size of the pEvents array
+//     int iTimeoutMs        : [in] the longest wait, -1 for no limit
+//
+// Return Values (int):
+//      the number of events, 0 if timed out, -1 on an error
+//
+/////////////////////////////////////////////////////////
+int CServicePoller::Wait(
+        ServiceEvent* pEvents,
+        int cMaxEvents,
+        int iTimeoutMs
+        )
+{
+#ifdef GS_USE_EPOLL
+    if (cMaxEvents > m_cMaxEvents)
+    {
+        void* pv = realloc(m_pEvents, cMaxEvents * sizeof(epoll_event));
+        if (NULL == pv)
+            return -1;
+        m_pEvents = pv;
+        m_cMaxEvents = cMaxEvents;
+    }
+    epoll_event* pev = (epoll_event*)m_pEvents;
+    int cReady = epoll_wait(m_fdEpoll, pev, cMaxEvents, iTimeoutMs);
+    if (cReady < 0)
+        return (EINTR == errno) ? 0 : -1;
+    for (int i = 0; i < cReady; i++)
+    {
+        pEvents[i].pv = pev[i].data.ptr;
+        pEvents[i].uEvents = ((pev[i].events & EPOLLIN) ? GS_EVENT_READ : 0) |
+                             ((pev[i].events & EPOLLOUT) ? GS_EVENT_WRITE : 0) |
+                             ((pev[i].events & (EPOLLERR | EPOLLHUP)) ? GS_EVENT_ERROR : 0);
+    }
+    return cReady;
+#else
+    ServicePollFd* pFds = (ServicePollFd*)m_pFds;
+    int cReady = ServicePoll(pFds, m_cFds, iTimeoutMs);
+    if (cReady < 0)
+        return -1;
+    // The sockets are looked at from where the last call stopped, so
+    // the ones at the end get their turn when more are ready than
+    // pEvents holds
+    int cEvents = 0;
+    for (int j = 0; j < m_cFds && cEvents < cReady && cEvents < cMaxEvents; j++)
+    {
+        int i = (m_iNextFd + j) % m_cFds;
+        short sRevents = pFds[i].revents;
+        if (0 == sRevents)
+            continue;
+        m_iNextFd = i + 1;
+        pEvents[cEvents].pv = m_ppv[i];
+        pEvents[cEvents].uEvents = ((sRevents & POLLIN) ? GS_EVENT_READ : 0) |
+                                   ((sRevents & POLLOUT) ? GS_EVENT_WRITE : 0) |
+                                   ((sRevents & (POLLERR | POLLHUP | POLLNVAL)) ? GS_EVENT_ERROR : 0);
+        cEvents++;
+    }
+    return cEvents;
+#endif
+}
+
+// Service //////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////
+//
+// CGestureService::CGestureService
+//
+// Constructor.
+//
+/////////////////////////////////////////////////////////
+CGestureService::CGestureService(const CGestureEngine& engine)
+    : m_engine(engine), m_pTiers(NULL), m_ptBudget(0),
+      m_sListen(GS_INVALID_SOCKET), m_pszPath(NULL),
+      m_cLoops(0), m_cMaxBatch(GE_MAX_BATCH), m_bStop(false)
+{
+    memset(m_rgpLoops, 0, sizeof(m_rgpLoops));
+}
+
+CGestureService::~CGestureService()
+{
+    Stop();
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureService::SetMaxBatch
+//
+// Sets the most strokes a loop recognizes in a call of
+// RecognizeBatch; 1 recognizes them one by one. Called
+// before Start.
+//
+/////////////////////////////////////////////////////////
+void CGestureService::SetMaxBatch(int cMaxBatch)
+{
+    m_cMaxBatch = (cMaxBatch < 1) ? 1 : (cMaxBatch > GE_MAX_BATCH) ? GE_MAX_BATCH : cMaxBatch;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureService::SetQuality
+//
+// Recognizes with the engines of quality tiers, the tier
+// of every batch picked to keep the p99 latency within a
+// budget, instead of with the service's engine. The tiers
+// aren't owned and must outlive the service. Called before
+// Start.
+//
+// Parameters:
+//     const CQualityTiers* pTiers : [in] the tiers, NULL for the engine
+//     PERFTIME ptBudget           : [in] the p99 latency aimed at, from
+//                                   the time a request is read to the time
+//                                   its response is queued
+//
+/////////////////////////////////////////////////////////
+void CGestureService::SetQuality(const CQualityTiers* pTiers, PERFTIME ptBudget)
+{
+    m_pTiers = pTiers;
+    m_ptBudget = ptBudget;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureService::Start
+//
+// Starts listening at a path and runs the event loops,
+// every one of which accepts connections.
+//
+// Parameters:
+//     const char* pszPath  : [in] the path of the socket
+//     int cLoops           : [in] the number of the loops, a thread each
+//
+// Return Values (bool):
+//      true if succeeded, false if the socket or the threads
+//      couldn't be made
+//
+/////////////////////////////////////////////////////////
+bool CGestureService::Start(
+        const char* pszPath,
+        int cLoops
+        )
+{
+    if (GS_INVALID_SOCKET != m_sListen || false == ServiceStartup())
+        return false;
+    if (cLoops < 1)
+        cLoops = 1;
+    if (cLoops > GS_MAX_LOOPS)
+        cLoops = GS_MAX_LOOPS;
+
+    m_sListen = ServiceListen(pszPath);
+    if (GS_INVALID_SOCKET == m_sListen)
+        return false;
+    m_pszPath = (char*)malloc(strlen(pszPath) + 1);
+    if (NULL != m_pszPath)
+        strcpy(m_pszPath, pszPath);
+
+    m_bStop = false;
+    for (int i = 0; i < cLoops; i++)
+    {
+        ServiceLoop* pLoop = new ServiceLoop;
+        memset(&pLoop->thread, 0, sizeof(pLoop->thread));
+        pLoop->pService = this;
+        pLoop->ppConns = pLoop->ppClosed = pLoop->ppDirty = NULL;
+        pLoop->cConns = pLoop->cMaxConns = 0;
+        pLoop->cClosed = 0;
+        pLoop->cDirty = 0;
+        pLoop->pPending = NULL;
+        pLoop->cPending = pLoop->cMaxPending = 0;
+        pLoop->pPoints = NULL;
+        pLoop->cPoints = pLoop->cMaxPoints = 0;
+        pLoop->pStrokes = (GestureStroke*)malloc(m_cMaxBatch * sizeof(GestureStroke));
+        pLoop->pResults = (GestureResult*)malloc(
+                                m_cMaxBatch * GE_NUM_SSGESTURES * sizeof(GestureResult));
+        pLoop->pcResults = (int*)malloc(m_cMaxBatch * sizeof(int));
+        pLoop->scheduler.Create(m_pTiers, m_ptBudget);
+        memset(&pLoop->stats, 0, sizeof(pLoop->stats));
+
+        m_rgpLoops[i] = pLoop;
+        if (NULL == pLoop->pStrokes || NULL == pLoop->pResults || NULL == pLoop->pcResults ||
+            false == pLoop->poller.Create() ||
+            false == pLoop->poller.Add(m_sListen, GS_EVENT_READ, NULL))
+        {
+            Stop();
+            return false;
+        }
+    }
+
+    // The loops are all set up before the first one runs; m_cLoops
+    // counts the threads started, the ones Stop joins
+    for (int i = 0; i < cLoops; i++)
+    {
+        if (false == ThreadCreate(&m_rgpLoops[i]->thread, ThreadStart, m_rgpLoops[i]))
+        {
+            Stop();
+            return false;
+        }
+        m_cLoops++;
+    }
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureService::Stop
+//
+// Stops the loops, closes the connections and removes the
+// socket file.
+//
+/////////////////////////////////////////////////////////
+void CGestureService::Stop()
+{
+    m_bStop = true;
+    for (int i = 0; i < GS_MAX_LOOPS; i++)
+    {
+        ServiceLoop* pLoop = m_rgpLoops[i];
+        if (NULL == pLoop)
+            continue;
+        if (i < m_cLoops)
+            ThreadJoin(&pLoop->thread);
+        for (int j = 0; j < pLoop->cConns; j++)
+        {
+            ServiceClose(pLoop->ppConns[j]->s);
+            delete pLoop->ppConns[j];
+        }
+        free(pLoop->ppConns);
+        free(pLoop->ppClosed);
+        free(pLoop->ppDirty);
+        free(pLoop->pPending);
+        free(pLoop->pPoints);
+        free(pLoop->pStrokes);
+        free(pLoop->pResults);
+        free(pLoop->pcResults);
+        delete pLoop;
+        m_rgpLoops[i] = NULL;
+    }
+    m_cLoops = 0;
+
+    if (GS_INVALID_SOCKET != m_sListen)
+    {
+        ServiceClose(m_sListen);
+        m_sListen = GS_INVALID_SOCKET;
+    }
+    if (NULL != m_pszPath)
+    {
+#ifdef _WIN32
+        ::DeleteFileA(m_pszPath);
+#else
+        unlink(m_pszPath);
+#endif
+        free(m_pszPath);
+        m_pszPath = NULL;
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureService::GetStats
+//
+// Adds up the counters of the loops. A counter may be a
+// request or two behind while the service runs.
+//
+/////////////////////////////////////////////////////////
+void CGestureService::GetStats(ServiceStats& stats) const
+{
+    memset(&stats, 0, sizeof(stats));
+    for (int i = 0; i < m_cLoops; i++)
+    {
+        const ServiceStats& loop = m_rgpLoops[i]->stats;
+        stats.cConnections += loop.cConnections;
+        stats.cRequests += loop.cRequests;
+        stats.cBatches += loop.cBatches;
+        stats.cErrors += loop.cErrors;
+        for (int j = 0; j < QS_NUM_TIERS; j++)
+            stats.rgcTiers[j] += loop.rgcTiers[j];
+    }
+}
+
+#ifdef _WIN32
+DWORD WINAPI CGestureService::ThreadStart(void* pvLoop)
+{
+    ServiceLoop* pLoop = (ServiceLoop*)pvLoop;
+    pLoop->pService->LoopProc(pLoop);
+    return 0;
+}
+#else
+void* CGestureService::ThreadStart(void* pvLoop)
+{
+    ServiceLoop* pLoop = (ServiceLoop*)pvLoop;
+    pLoop->pService->LoopProc(pLoop);
+    return NULL;
+}
+#endif
+
+/////////////////////////////////////////////////////////
+//
+// CGestureService::LoopProc
+//
+// An event loop. An iteration reads all the connections
+// that are ready, answers the name and the stats requests
+// at once, recognizes the strokes of all the connections
+// together and then writes the responses. The connections
+// closed on the way are freed last, when no request refers
+// to them any more.
+//
+/////////////////////////////////////////////////////////
+void CGestureService::LoopProc(ServiceLoop* pLoop)
+{
+    ServiceEvent rgEvents[GS_MAX_EVENTS];
+
+    while (false == m_bStop)
+    {
+        int cEvents = pLoop->poller.Wait(rgEvents, GS_MAX_EVENTS, GS_WAIT_MS);
+        if (cEvents <= 0)
+            continue;
+
+        TRACE_SCOPE("Service iteration");
+        for (int i = 0; i < cEvents; i++)
+        {
+            ServiceConnection* pConn = (ServiceConnection*)rgEvents[i].pv;
+            if (NULL == pConn)
+            {
+                AcceptConnections(pLoop);
+                continue;
+            }
+            if (pConn->bClosed)
+                continue;
+            if (rgEvents[i].uEvents & GS_EVENT_WRITE)
+                FlushConnection(pLoop, pConn);
+            if (false == pConn->bClosed && (rgEvents[i].uEvents & (GS_EVENT_READ | GS_EVENT_ERROR)))
+                ReadConnection(pLoop, pConn);
+        }
+
+        RecognizePending(pLoop);
+
+        for (int i = 0; i < pLoop->cDirty; i++)
+        {
+            ServiceConnection* pConn = pLoop->ppDirty[i];
+            pConn->bDirty = false;
+            if (false == pConn->bClosed)
+                FlushConnection(pLoop, pConn);
+        }
+        pLoop->cDirty = 0;
+
+        for (int i = 0; i < pLoop->cClosed; i++)
+        {
+            ServiceConnection* pConn = pLoop->ppClosed[i];
+            ServiceConnection* pLast = pLoop->ppConns[--pLoop->cConns];
+            pLoop->ppConns[pConn->iSlot] = pLast;
+            pLast->iSlot = pConn->iSlot;
+            delete pConn;
+        }
+        pLoop->cClosed = 0;
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureService::AcceptConnections
+//
+// Accepts the connections waiting; the other loops may
+// take some of them first.
+//
+/////////////////////////////////////////////////////////
+void CGestureService::AcceptConnections(ServiceLoop* pLoop)
+{
+    for (;;)
+    {
+        ServiceSocket s = ServiceAccept(m_sListen);
+        if (GS_INVALID_SOCKET == s)
+            return;
+
+        ServiceConnection* pConn = new ServiceConnection;
+        pConn->s = s;
+        pConn->iSlot = pLoop->cConns;
+        pConn->uEvents = GS_EVENT_READ;
+        pConn->bDirty = false;
+        pConn->bClosed = false;
+        // The closed and the dirty lists can hold every connection, so
+        // adding to them doesn't fail
+        int cMaxClosed = pLoop->cMaxConns;
+        int cMaxDirty = pLoop->cMaxConns;
+        if (false == GrowArray((void**)&pLoop->ppClosed, &cMaxClosed,
+                               pLoop->cConns + 1, sizeof(ServiceConnection*)) ||
+            false == GrowArray((void**)&pLoop->ppDirty, &cMaxDirty,
+                               pLoop->cConns + 1, sizeof(ServiceConnection*)) ||
+            false == GrowArray((void**)&pLoop->ppConns, &pLoop->cMaxConns,
+                               pLoop->cConns + 1, sizeof(ServiceConnection*)) ||
+            false == pLoop->poller.Add(s, GS_EVENT_READ, pConn))
+        {
+            ServiceClose(s);
+            delete pConn;
+            return;
+        }
+        pLoop->ppConns[pLoop->cConns++] = pConn;
+        pLoop->stats.cConnections++;
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureService::ReadConnection
+//
+// Reads what a connection has sent and parses the whole
+// requests. A connection whose output piles up, a client
+// that doesn't read its responses, isn't read until it
+// takes some.
+//
+/////////////////////////////////////////////////////////
+void CGestureService::ReadConnection(ServiceLoop* pLoop, ServiceConnection* pConn)
+{
+    while (pConn->out.GetSize() < GS_MAX_OUTPUT)
+    {
+        unsigned char* pb = pConn->in.Reserve(GS_READ_SIZE);
+        if (NULL == pb)
+        {
+            CloseConnection(pLoop, pConn);
+            return;
+        }
+        int cb = ServiceRecv(pConn->s, pb, GS_READ_SIZE);
+        if (cb < 0)
+        {
+            CloseConnection(pLoop, pConn);
+            return;
+        }
+        if (0 == cb)
+            break;
+        pConn->in.Commit(cb);
+        ParseRequests(pLoop, pConn);
+        if (pConn->bClosed || cb < GS_READ_SIZE)
+            break;
+    }
+}
+
+// Queues the output of a connection to be flushed
+static void MarkDirty(ServiceLoop* pLoop, ServiceConnection* pConn)
+{
+    if (false == pConn->bDirty)
+    {
+        pConn->bDirty = true;
+        pLoop->ppDirty[pLoop->cDirty++] = pConn;
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureService::ParseRequests
+//
+// Takes the whole requests out of a connection's input:
+// queues the strokes to recognize, and answers the other
+// requests. A malformed request gets an error response;
+// a header that can't be a request closes the connection,
+// since the stream can't be followed any further.
+//
+/////////////////////////////////////////////////////////
+void CGestureService::ParseRequests(ServiceLoop* pLoop, ServiceConnection* pConn)
+{
+    while (pConn->in.GetSize() >= GS_HEADER_SIZE)
+    {
+        const unsigned char* pb = pConn->in.GetData();
+        ServiceHeader header;
+        CGestureProtocol::DecodeHeader(pb, header);
+        if (header.cbBody > GS_MAX_BODY)
+        {
+            CloseConnection(pLoop, pConn);
+            return;
+        }
+        if (pConn->in.GetSize() < GS_HEADER_SIZE + (int)header.cbBody)
+            return;
+        const unsigned char* pbBody = pb + GS_HEADER_SIZE;
+
+        bool bValid = false;
+        bool bWritten = true;       // false if out of memory
+        bool bAnswered = false;     // a response was queued
+        switch (header.uType)
+        {
+            case GS_REQ_RECOGNIZE:
+            {
+                int cPoints = header.cItems;
+                if (0 == cPoints || 0 == header.uParam)
+                    break;
+                if (false == GrowArray((void**)&pLoop->pPoints, &pLoop->cMaxPoints,
+                                       pLoop->cPoints + cPoints, sizeof(GesturePoint)) ||
+                    false == GrowArray((void**)&pLoop->pPending, &pLoop->cMaxPending,
+                                       pLoop->cPending + 1, sizeof(ServicePending)))
+                {
+                    CloseConnection(pLoop, pConn);
+                    return;
+                }
+                if (false == CGestureProtocol::DecodePoints(pbBody, header.cbBody,
+                                                            pLoop->pPoints + pLoop->cPoints,
+                                                            cPoints))
+                    break;
+
+                ServicePending& pending = pLoop->pPending[pLoop->cPending++];
+                pending.pConn = pConn;
+                pending.uId = header.uId;
+                pending.cMaxResults = (header.uParam < (int)GE_NUM_SSGESTURES) ?
+                                      (int)header.uParam : (int)GE_NUM_SSGESTURES;
+                pending.iPoint = pLoop->cPoints;
+                pending.cPoints = cPoints;
+                pending.ptRead = PerfNow();
+                pLoop->cPoints += cPoints;
+                bValid = true;      // answered with its batch
+                break;
+            }
+
+            case GS_REQ_NAME:
+                if (header.cbBody > 0 || header.uParam >= GE_NUM_SSGESTURES)
+                    break;
+                bValid = bAnswered = true;
+                bWritten = CGestureProtocol::WriteName(pConn->out, header.uId,
+                                CGestureEngine::GetGestureName(header.uParam));
+                break;
+
+            case GS_REQ_STATS:
+            {
+                if (header.cbBody > 0)
+                    break;
+                ServiceStats stats;
+                GetStats(stats);
+                bValid = bAnswered = true;
+                bWritten = CGestureProtocol::WriteStats(pConn->out, header.uId, stats);
+                break;
+            }
+        }
+
+        if (false == bValid)
+        {
+            pLoop->stats.cErrors++;
+            bAnswered = true;
+            bWritten = CGestureProtocol::WriteMessage(pConn->out, header.uId,
+                                                      GS_RSP_ERROR, 0, 0, NULL, 0);
+        }
+        if (false == bWritten)
+        {
+            CloseConnection(pLoop, pConn);
+            return;
+        }
+        pConn->in.Consume(GS_HEADER_SIZE + header.cbBody);
+        if (bAnswered)
+            MarkDirty(pLoop, pConn);
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureService::RecognizePending
+//
+// Recognizes the strokes the iteration has read, from all
+// the connections, in batches of m_cMaxBatch, and queues
+// the responses. With quality tiers, each batch gets the
+// tier the loop's scheduler picks for the strokes still
+// queued, and the scheduler is told what it cost.
+//
+/////////////////////////////////////////////////////////
+void CGestureService::RecognizePending(ServiceLoop* pLoop)
+{
+    for (int iFirst = 0; iFirst < pLoop->cPending; iFirst += m_cMaxBatch)
+    {
+        int cBatch = pLoop->cPending - iFirst;
+        if (cBatch > m_cMaxBatch)
+            cBatch = m_cMaxBatch;
+
+        PERFTIME ptStart = PerfNow();
+        int iTier = 0;
+        const CGestureEngine* pEngine = &m_engine;
+        if (NULL != m_pTiers)
+        {
+            iTier = pLoop->scheduler.ChooseTier(pLoop->cPending - iFirst,
+                                                ptStart - pLoop->pPending[iFirst].ptRead);
+            pEngine = &m_pTiers->GetEngine(iTier);
+        }
+
+        for (int i = 0; i < cBatch; i++)
+        {
+            const ServicePending& pending = pLoop->pPending[iFirst + i];
+            pLoop->pStrokes[i].ppt = pLoop->pPoints + pending.iPoint;
+            pLoop->pStrokes[i].cPoints = pending.cPoints;
+        }
+        pEngine->RecognizeBatch(pLoop->pStrokes, cBatch, pLoop->pResults,
+                                GE_NUM_SSGESTURES, pLoop->pcResults);
+        PERFTIME ptDone = PerfNow();
+        pLoop->scheduler.RecordBatch(iTier, cBatch, ptDone - ptStart);
+        pLoop->stats.cBatches++;
+        pLoop->stats.cRequests += cBatch;
+        pLoop->stats.rgcTiers[iTier] += cBatch;
+
+        for (int i = 0; i < cBatch; i++)
+        {
+            const ServicePending& pending = pLoop->pPending[iFirst + i];
+            ServiceConnection* pConn = pending.pConn;
+            pLoop->scheduler.RecordLatency(ptDone - pending.ptRead);
+            if (pConn->bClosed)
+                continue;
+            int cResults = pLoop->pcResults[i];
+            if (cResults > pending.cMaxResults)
+                cResults = pending.cMaxResults;
+            if (false == CGestureProtocol::WriteResults(pConn->out, pending.uId,
+                            pLoop->pResults + (size_t)i * GE_NUM_SSGESTURES, cResults, iTier))
+            {
+                CloseConnection(pLoop, pConn);
+                continue;
+            }
+            MarkDirty(pLoop, pConn);
+        }
+    }
+
+    pLoop->cPending = 0;
+    pLoop->cPoints = 0;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureService::FlushConnection
+//
+// Sends what the socket takes of a connection's output,
+// and polls for it to be writable if some is left. The
+// connection is read again once the output is below
+// GS_MAX_OUTPUT; the requests it sent meanwhile wait in
+// the socket.
+//
+/////////////////////////////////////////////////////////
+void CGestureService::FlushConnection(ServiceLoop* pLoop, ServiceConnection* pConn)
+{
+    while (pConn->out.GetSize() > 0)
+    {
+        int cb = ServiceSend(pConn->s, pConn->out.GetData(), pConn->out.GetSize());
+        if (cb < 0)
+        {
+            CloseConnection(pLoop, pConn);
+            return;
+        }
+        if (0 == cb)
+            break;
+        pConn->out.Consume(cb);
+    }
+
+    unsigned int uEvents = ((pConn->out.GetSize() < GS_MAX_OUTPUT) ? GS_EVENT_READ : 0) |
+                           ((pConn->out.GetSize() > 0) ? GS_EVENT_WRITE : 0);
+    if (uEvents != pConn->uEvents)
+    {
+        pConn->uEvents = uEvents;
+        pLoop->poller.Modify(pConn->s, uEvents, pConn);
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureService::CloseConnection
+//
+// Closes a connection. It's freed at the end of the
+// iteration, its pending requests are dropped.
+//
+/////////////////////////////////////////////////////////
+void CGestureService::CloseConnection(ServiceLoop* pLoop, ServiceConnection* pConn)
+{
+    if (pConn->bClosed)
+        return;
+    pConn->bClosed = true;
+    pLoop->poller.Remove(pConn->s);
+    ServiceClose(pConn->s);
+    pLoop->ppClosed[pLoop->cClosed++] = pConn;
+}
+
+// Client ///////////////////////////////////////////////
+
+bool CGestureClient::Connect(const char* pszPath)
+{
+    Close();
+    if (false == ServiceStartup())
+        return false;
+    m_s = ServiceConnect(pszPath);
+    return (GS_INVALID_SOCKET != m_s);
+}
+
+void CGestureClient::Close()
+{
+    if (GS_INVALID_SOCKET != m_s)
+    {
+        ServiceClose(m_s);
+        m_s = GS_INVALID_SOCKET;
+    }
+    m_in.Clear();
+    m_out.Clear();
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureClient::Transact
+//
+// Sends the request in m_out and waits for its response.
+// The body stays valid until the next request.
+//
+// Parameters:
+//     ServiceHeader& header        : [out] the header of the response
+//     const unsigned char*& pbBody : [out] its body
+//
+// Return Values (bool):
+//      true if succeeded, false if the connection is lost or
+//      the service doesn't answer in GS_CLIENT_TIMEOUT_MS; the
+//      connection is closed then
+//
+/////////////////////////////////////////////////////////
+bool CGestureClient::Transact(ServiceHeader& header, const unsigned char*& pbBody)
+{
+    if (GS_INVALID_SOCKET == m_s)
+        return false;
+
+    ServiceHeader request;
+    CGestureProtocol::DecodeHeader(m_out.GetData(), request);
+    while (m_out.GetSize() > 0)
+    {
+        int cb = ServiceSend(m_s, m_out.GetData(), m_out.GetSize());
+        if (cb < 0 || (0 == cb && false == WaitSocket(m_s, true, GS_CLIENT_TIMEOUT_MS)))
+        {
+            Close();
+            return false;
+        }
+        m_out.Consume(cb);
+    }
+
+    for (;;)
+    {
+        if (m_in.GetSize() >= GS_HEADER_SIZE)
+        {
+            CGestureProtocol::DecodeHeader(m_in.GetData(), header);
+            if (header.cbBody > GS_MAX_BODY)
+                break;
+            if (m_in.GetSize() >= GS_HEADER_SIZE + (int)header.cbBody)
+            {
+                if (header.uId != request.uId)
+                    break;
+                pbBody = m_in.GetData() + GS_HEADER_SIZE;
+                return true;
+            }
+        }
+
+        unsigned char* pb = m_in.Reserve(GS_READ_SIZE);
+        if (NULL == pb)
+            break;
+        int cb = ServiceRecv(m_s, pb, GS_READ_SIZE);
+        if (cb < 0 || (0 == cb && false == WaitSocket(m_s, false, GS_CLIENT_TIMEOUT_MS)))
+            break;
+        m_in.Commit(cb);
+    }
+
+    Close();
+    return false;
+}
+
+// Drops the response of the last request
+static void ConsumeResponse(CServiceBuffer& in, const ServiceHeader& header)
+{
+    in.Consume(GS_HEADER_SIZE + header.cbBody);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureClient::Recognize
+//
+// Recognizes a stroke with the service, the way
+// CGestureEngine::Recognize does; the alternates have no
+// template and the scores are rounded to 16 bits.
+//
+// Parameters:
+//     const int* piPoints      : [in] the x, y pairs, in ink space
+//     int cPoints              : [in] the number of the points
+//     GestureResult* pResults  : [out] the alternates, the best first
+//     int cMaxResults          : [in] the size of the pResults array
+//     int* piTier              : [out] the quality tier the service
+//                                recognized at, 0 the full quality; may
+//                                be NULL
+//
+// Return Values (int):
+//      the number of alternates, -1 if the service failed
+//
+/////////////////////////////////////////////////////////
+int CGestureClient::Recognize(
+        const int* piPoints,
+        int cPoints,
+        GestureResult* pResults,
+        int cMaxResults,
+        int* piTier
+        )
+{
+    if (cMaxResults <= 0 ||
+        false == CGestureProtocol::WriteRecognize(m_out, m_uNextId++, piPoints, cPoints, cMaxResults))
+        return -1;
+
+    ServiceHeader header;
+    const unsigned char* pbBody;
+    if (false == Transact(header, pbBody))
+        return -1;
+    int cResults = -1;
+    if (false == CGestureProtocol::DecodeResults(header, pbBody, pResults, cMaxResults, cResults))
+        cResults = -1;
+    if (NULL != piTier)
+        *piTier = header.uParam;
+    ConsumeResponse(m_in, header);
+    return cResults;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGestureClient::GetGestureName
+//
+// Gets the name of a gesture from the service.
+//
+// Return Values (bool):
+//      true if succeeded, false if the service failed or
+//      doesn't know the gesture
+//
+/////////////////////////////////////////////////////////
+bool CGestureClient::GetGestureName(
+        int iGesture,
+        char* pszName,
+        int cchName
+        )
+{
+    if (iGesture < 0 || iGesture > 0xFF || cchName <= 0 ||
+        false == CGestureProtocol::WriteMessage(m_out, m_uNextId++, GS_REQ_NAME, iGesture, 0, NULL, 0))
+        return false;
+
+    ServiceHeader header;
+    const unsigned char* pbBody;
+    if (false == Transact(header, pbBody))
+        return false;
+    bool bNamed = (GS_RSP_NAME == header.uType && (int)header.cbBody < cchName);
+    if (bNamed)
+    {
+        memcpy(pszName, pbBody, header.cbBody);
+        pszName[header.cbBody] = '\0';
+    }
+    ConsumeResponse(m_in, header);
+    return bNamed;
+}
+
+bool CGestureClient::GetStats(ServiceStats& stats)
+{
+    if (false == CGestureProtocol::WriteMessage(m_out, m_uNextId++, GS_REQ_STATS, 0, 0, NULL, 0))
+        return false;
+
+    ServiceHeader header;
+    const unsigned char* pbBody;
+    if (false == Transact(header, pbBody))
+        return false;
+    bool bDecoded = CGestureProtocol::DecodeStats(header, pbBody, stats);
+    ConsumeResponse(m_in, header);
+    return bDecoded;
+}
@@ -0,0 +1,349 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      GestureService.h
+//
+// Description:
+//      This file contains the definitions of a local recognition service:
+//      one process per host runs the gesture engine and answers the
+//      recognition and gesture name requests of many client processes
+//      over a Unix domain socket.
+//
+//      The protocol is binary and little endian. Every message is a 12
+//      byte header followed by a body of cbBody bytes:
+//
+//          uint32 cbBody   the size of the body
+//          uint32 uId      chosen by the client, echoed by the response
+//          uint8  uType    GS_REQ_ or GS_RSP_ constant
+//          uint8  uParam   per type, see below
+//          uint16 cItems   per type, see below
+//
+//      GS_REQ_RECOGNIZE    uParam the alternates wanted, cItems the
+//                          points; the body is the points, x then y, the
+//                          first one as is and the others as deltas from
+//                          the point before, every number a zigzag varint
+//      GS_RSP_RESULTS      uParam the quality tier recognized at, cItems
+//                          the alternates; the body is 3 bytes each, the
+//                          gesture and the score * 65535 as a uint16
+//      GS_REQ_NAME         uParam the gesture; no body
+//      GS_RSP_NAME         the body is the name, not terminated
+//      GS_REQ_STATS        no body
+//      GS_RSP_STATS        the body is a ServiceStats, 8 bytes a field
+//      GS_RSP_ERROR        the request was malformed; no body
+//
+//      A client may send several requests before reading the responses,
+//      which come back in any order. The server runs a few event loops
+//      (epoll on Linux, poll elsewhere); a loop reads every connection
+//      that's ready, then recognizes all the strokes that came in, from
+//      whatever connection, in batches (see CGestureEngine::RecognizeBatch),
+//      then writes the responses. The busier the service, the larger the
+//      batches and the fewer the system calls per request.
+//
+//      With a latency budget set (see SetQuality), a loop also picks the
+//      quality tier of every batch (see QualityScheduler.h), to keep the
+//      p99 latency within the budget when the batches queue up; every
+//      response names its tier, and the stats count the strokes of each.
+//
+//      The methods of the classes are defined in the GestureService.cpp
+//      file.
+//--------------------------------------------------------------------------
+
+#pragma once
+
+#include "PerfTimer.h"
+#include "GestureEngine.h"
+#include "QualityScheduler.h"
+
+enum {
+    GS_HEADER_SIZE = 12,
+    GS_MAX_POINTS = 0xFFFF,                 // cItems is 16 bits
+    GS_MAX_BODY = GS_MAX_POINTS * 2 * 5,    // a varint takes 5 bytes at most
+    GS_MAX_LOOPS = 16,
+    GS_STATS_FIELDS = 4 + QS_NUM_TIERS      // in a GS_RSP_STATS body
+};
+
+// Message types
+enum {
+    GS_REQ_RECOGNIZE = 1,
+    GS_REQ_NAME = 2,
+    GS_REQ_STATS = 3,
+    GS_RSP_RESULTS = 0x81,
+    GS_RSP_NAME = 0x82,
+    GS_RSP_STATS = 0x83,
+    GS_RSP_ERROR = 0xFF
+};
+
+// Poller event flags
+enum {
+    GS_EVENT_READ = 1,
+    GS_EVENT_WRITE = 2,
+    GS_EVENT_ERROR = 4      // an error or a hang up
+};
+
+#if defined(__linux__) && !defined(GS_NO_EPOLL)
+#define GS_USE_EPOLL
+#endif
+
+#ifdef _WIN32
+typedef UINT_PTR ServiceSocket;
+#define GS_INVALID_SOCKET   ((ServiceSocket)~(UINT_PTR)0)
+#else
+typedef int ServiceSocket;
+#define GS_INVALID_SOCKET   (-1)
+#endif
+
+// A message header
+struct ServiceHeader
+{
+    unsigned int    cbBody;
+    unsigned int    uId;
+    unsigned char   uType;
+    unsigned char   uParam;
+    unsigned short  cItems;
+};
+
+// The counters of a service
+struct ServiceStats
+{
+    unsigned long long  cConnections;   // accepted since the start
+    unsigned long long  cRequests;      // recognition requests answered
+    unsigned long long  cBatches;       // the RecognizeBatch calls they took
+    unsigned long long  cErrors;        // malformed requests
+    unsigned long long  rgcTiers[QS_NUM_TIERS];     // the strokes recognized at each tier
+};
+
+// A readiness event
+struct ServiceEvent
+{
+    void*           pv;         // as given to Add or Modify
+    unsigned int    uEvents;    // GS_EVENT_ flags
+};
+
+/////////////////////////////////////////////////////////
+//
+// class CServiceBuffer
+//
+// A growable byte queue: the bytes are appended at the
+// end and consumed from the front.
+//
+/////////////////////////////////////////////////////////
+
+class CServiceBuffer
+{
+    unsigned char*  m_pb;
+    int             m_iStart;   // the first byte not consumed
+    int             m_cb;       // the end of the bytes
+    int             m_cbMax;
+
+public:
+
+    CServiceBuffer() : m_pb(NULL), m_iStart(0), m_cb(0), m_cbMax(0) {}
+    ~CServiceBuffer();
+
+    unsigned char* Reserve(int cb);
+    void Commit(int cb) { m_cb += cb; }
+    void Consume(int cb);
+    void Clear() { m_iStart = m_cb = 0; }
+
+    const unsigned char* GetData() const { return m_pb + m_iStart; }
+    int  GetSize() const { return m_cb - m_iStart; }
+
+private:
+
+    // Not copyable
+    CServiceBuffer(const CServiceBuffer&);
+    CServiceBuffer& operator=(const CServiceBuffer&);
+};
+
+/////////////////////////////////////////////////////////
+//
+// class CGestureProtocol
+//
+// The encoding of the messages. The Decode methods check
+// their input, which comes from another process.
+//
+/////////////////////////////////////////////////////////
+
+class CGestureProtocol
+{
+public:
+
+    static void EncodeHeader(const ServiceHeader& header, unsigned char* pb);
+    static void DecodeHeader(const unsigned char* pb, ServiceHeader& header);
+
+    static int  EncodePoints(const int* piPoints, int cPoints, unsigned char* pb);
+    static bool DecodePoints(const unsigned char* pb, int cb, GesturePoint* ppt, int cPoints);
+
+    static bool WriteRecognize(CServiceBuffer& buf, unsigned int uId, const int* piPoints,
+                               int cPoints, int cMaxResults);
+    static bool WriteResults(CServiceBuffer& buf, unsigned int uId,
+                             const GestureResult* pResults, int cResults, int iTier);
+    static bool WriteName(CServiceBuffer& buf, unsigned int uId, const char* pszName);
+    static bool WriteStats(CServiceBuffer& buf, unsigned int uId, const ServiceStats& stats);
+    static bool WriteMessage(CServiceBuffer& buf, unsigned int uId, int iType,
+                             int iParam, int cItems, const void* pvBody, int cbBody);
+
+    static bool DecodeResults(const ServiceHeader& header, const unsigned char* pb,
+                              GestureResult* pResults, int cMaxResults, int& cResults);
+    static bool DecodeStats(const ServiceHeader& header, const unsigned char* pb,
+                            ServiceStats& stats);
+
+    static unsigned short ScoreToWord(float fScore);
+};
+
+/////////////////////////////////////////////////////////
+//
+// class CServicePoller
+//
+// Waits for the sockets to be ready: an epoll instance on
+// Linux, poll (WSAPoll on Windows) elsewhere. Not shared
+// between threads.
+//
+/////////////////////////////////////////////////////////
+
+class CServicePoller
+{
+#ifdef GS_USE_EPOLL
+    int             m_fdEpoll;
+    void*           m_pEvents;      // epoll_event array
+    int             m_cMaxEvents;
+#else
+    void*           m_pFds;         // pollfd array
+    void**          m_ppv;          // the pointer of each pollfd
+    int             m_cFds;
+    int             m_cMaxFds;
+    int             m_iNextFd;      // where Wait starts looking, in turn
+#endif
+
+public:
+
+    // Constructor and destructor
+    CServicePoller();
+    ~CServicePoller();
+
+    bool Create();
+    bool Add(ServiceSocket s, unsigned int uEvents, void* pv);
+    bool Modify(ServiceSocket s, unsigned int uEvents, void* pv);
+    void Remove(ServiceSocket s);
+    int  Wait(ServiceEvent* pEvents, int cMaxEvents, int iTimeoutMs);
+
+private:
+
+    // Not copyable
+    CServicePoller(const CServicePoller&);
+    CServicePoller& operator=(const CServicePoller&);
+};
+
+// Socket helpers. Send and Recv don't block: they return the bytes
+// moved, 0 if none can be now, -1 if the connection is lost (Recv
+// also if it's closed)
+bool ServiceStartup();
+ServiceSocket ServiceListen(const char* pszPath);
+ServiceSocket ServiceConnect(const char* pszPath);
+ServiceSocket ServiceAccept(ServiceSocket sListen);
+int  ServiceSend(ServiceSocket s, const void* pv, int cb);
+int  ServiceRecv(ServiceSocket s, void* pv, int cb);
+void ServiceClose(ServiceSocket s);
+
+struct ServiceLoop;
+struct ServiceConnection;
+
+/////////////////////////////////////////////////////////
+//
+// class CGestureService
+//
+// The server. It recognizes with an engine it doesn't own,
+// which must stay unchanged while the service runs, or
+// with the tiers of one.
+//
+/////////////////////////////////////////////////////////
+
+class CGestureService
+{
+    const CGestureEngine&   m_engine;
+    const CQualityTiers*    m_pTiers;           // NULL for m_engine alone
+    PERFTIME                m_ptBudget;
+    ServiceSocket           m_sListen;
+    char*                   m_pszPath;
+    ServiceLoop*            m_rgpLoops[GS_MAX_LOOPS];
+    int                     m_cLoops;
+    int                     m_cMaxBatch;        // strokes per RecognizeBatch call
+    volatile bool           m_bStop;
+
+public:
+
+    // Constructor and destructor
+    CGestureService(const CGestureEngine& engine);
+    ~CGestureService();
+
+    bool Start(const char* pszPath, int cLoops);
+    void Stop();
+
+    void SetMaxBatch(int cMaxBatch);
+    void SetQuality(const CQualityTiers* pTiers, PERFTIME ptBudget);
+    void GetStats(ServiceStats& stats) const;
+
+private:
+
+    void LoopProc(ServiceLoop* pLoop);
+#ifdef _WIN32
+    static DWORD WINAPI ThreadStart(void* pvLoop);
+#else
+    static void* ThreadStart(void* pvLoop);
+#endif
+    void AcceptConnections(ServiceLoop* pLoop);
+    void ReadConnection(ServiceLoop* pLoop, ServiceConnection* pConn);
+    void ParseRequests(ServiceLoop* pLoop, ServiceConnection* pConn);
+    void RecognizePending(ServiceLoop* pLoop);
+    void FlushConnection(ServiceLoop* pLoop, ServiceConnection* pConn);
+    void CloseConnection(ServiceLoop* pLoop, ServiceConnection* pConn);
+
+    // Not copyable
+    CGestureService(const CGestureService&);
+    CGestureService& operator=(const CGestureService&);
+};
+
+/////////////////////////////////////////////////////////
+//
+// class CGestureClient
+//
+// A blocking client of the service, one request at a time,
+// for an application that recognizes its gestures with
+// the service instead of an engine of its own.
+//
+/////////////////////////////////////////////////////////
+
+class CGestureClient
+{
+    ServiceSocket   m_s;
+    CServiceBuffer  m_in;
+    CServiceBuffer  m_out;
+    unsigned int    m_uNextId;
+
+public:
+
+    // Constructor and destructor
+    CGestureClient() : m_s(GS_INVALID_SOCKET), m_uNextId(1) {}
+    ~CGestureClient() { Close(); }
+
+    bool Connect(const char* pszPath);
+    void Close();
+
+    int  Recognize(const int* piPoints, int cPoints, GestureResult* pResults, int cMaxResults,
+                   int* piTier = NULL);
+    bool GetGestureName(int iGesture, char* pszName, int cchName);
+    bool GetStats(ServiceStats& stats);
+
+private:
+
+    bool Transact(ServiceHeader& header, const unsigned char*& pbBody);
+
+    // Not copyable
+    CGestureClient(const CGestureClient&);
+    CGestureClient& operator=(const CGestureClient&);
+};
@@ -0,0 +1,422 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      GuidedReco.cpp
+//
+// Description:
+//      The file contains the definitions of the methods of the classes
+//      CRecoGuide and CGuidedRecognizer. See the file GuidedReco.h for
+//      the definitions of the classes.
+//--------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "GuidedReco.h"
+#include "Trace.h"
+
+// A stroke and its cell, for sorting the strokes by cell
+struct StrokeCell
+{
+    int     iCell;
+    int     iStroke;
+};
+
+static int CompareStrokeCells(const void* pv1, const void* pv2)
+{
+    const StrokeCell* p1 = (const StrokeCell*)pv1;
+    const StrokeCell* p2 = (const StrokeCell*)pv2;
+    if (p1->iCell != p2->iCell)
+        return (p1->iCell < p2->iCell) ? -1 : 1;
+    return p1->iStroke - p2->iStroke;
+}
+
+/////////////////////////////////////////////////////////
+//
+// AppendText
+//
+// Appends a string to a text buffer, truncating it to the
+// buffer.
+//
+/////////////////////////////////////////////////////////
+static void AppendText(char* pszText, int cchText, const char* psz)
+{
+    size_t cch = strlen(pszText);
+    if (cch + 1 < (size_t)cchText)
+    {
+        snprintf(pszText + cch, cchText - cch, "%s", psz);
+    }
+}
+
+////////////////////////////////////////////////////////
+// CRecoGuide methods
+////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////
+//
+// CRecoGuide::Set
+//
+// Sets the geometry of the guide.
+//
+// Parameters:
+//     float x0, y0   : [in] the top left corner of the first cell
+//     float cxCell   : [in] the width of a cell, > 0
+//     float cyCell   : [in] the height of a cell (a line), > 0
+//     int cRows      : [in] the number of the rows, > 0
+//     int cColumns   : [in] the number of the boxes in a row, 0 for lines
+//
+// Return Values (bool):
+//      true if succeeded, false if the geometry is invalid
+//
+/////////////////////////////////////////////////////////
+bool CRecoGuide::Set(float x0, float y0, float cxCell, float cyCell, int cRows, int cColumns)
+{
+    if (cxCell <= 0 || cyCell <= 0 || cRows <= 0 || cColumns < 0)
+        return false;
+
+    m_x0 = x0;
+    m_y0 = y0;
+    m_fCellsPerX = 1.0f / cxCell;
+    m_fCellsPerY = 1.0f / cyCell;
+    m_cRows = cRows;
+    m_cColumns = cColumns;
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CRecoGuide::GetCell
+//
+// Finds the cell of a point. The points out of the guide
+// go to the nearest cell, so the ink beyond the last row or
+// column is kept with it.
+//
+// Return Values (int):
+//      the cell, row by row; 0 if there's no guide
+//
+/////////////////////////////////////////////////////////
+int CRecoGuide::GetCell(float x, float y) const
+{
+    if (0 == m_cRows)
+        return 0;
+
+    int iRow = (int)floorf((y - m_y0) * m_fCellsPerY);
+    if (iRow < 0)
+        iRow = 0;
+    else if (iRow >= m_cRows)
+        iRow = m_cRows - 1;
+
+    if (0 == m_cColumns)
+        return iRow;
+
+    int iColumn = (int)floorf((x - m_x0) * m_fCellsPerX);
+    if (iColumn < 0)
+        iColumn = 0;
+    else if (iColumn >= m_cColumns)
+        iColumn = m_cColumns - 1;
+
+    return iRow * m_cColumns + iColumn;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CRecoGuide::GetStrokeCell
+//
+// Finds the cell of a stroke: the cell of the center of its
+// bounding box, so the parts of a character that stray into
+// the next box stay with it.
+//
+// Parameters:
+//     const GesturePoint* ppt : [in] the points of the stroke
+//     int cPoints             : [in] the number of the points, > 0
+//
+// Return Values (int):
+//      the cell, row by row; 0 if there's no guide
+//
+/////////////////////////////////////////////////////////
+int CRecoGuide::GetStrokeCell(const GesturePoint* ppt, int cPoints) const
+{
+    if (0 == m_cRows || cPoints <= 0)
+        return 0;
+
+    float xMin = ppt[0].x, xMax = ppt[0].x;
+    float yMin = ppt[0].y, yMax = ppt[0].y;
+    for (int i = 1; i < cPoints; i++)
+    {
+        if (ppt[i].x < xMin) xMin = ppt[i].x;
+        if (ppt[i].x > xMax) xMax = ppt[i].x;
+        if (ppt[i].y < yMin) yMin = ppt[i].y;
+        if (ppt[i].y > yMax) yMax = ppt[i].y;
+    }
+    return GetCell(0.5f * (xMin + xMax), 0.5f * (yMin + yMax));
+}
+
+////////////////////////////////////////////////////////
+// CGuidedRecognizer methods
+////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////
+//
+// CGuidedRecognizer::CGuidedRecognizer
+//
+// Constructor.
+//
+// Parameters:
+//     CRecoWorkerPool& pool     : [in] the started workers, must outlive the
+//                                 recognizer
+//     CGestureConfig* pConfig   : [in] the configuration the workers'
+//                                 recognizers use, pinned once per job,
+//                                 or NULL; must outlive the recognizer
+//
+/////////////////////////////////////////////////////////
+CGuidedRecognizer::CGuidedRecognizer(CRecoWorkerPool& pool, CGestureConfig* pConfig)
+    : m_pool(pool), m_pConfig(pConfig), m_pCellInks(NULL), m_piCells(NULL), m_pTasks(NULL), m_pSegments(NULL),
+      m_cMaxCells(0), m_pOrder(NULL), m_cMaxStrokes(0)
+{
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGuidedRecognizer::~CGuidedRecognizer
+//
+// Destructor.
+//
+/////////////////////////////////////////////////////////
+CGuidedRecognizer::~CGuidedRecognizer()
+{
+    delete [] m_pCellInks;
+    free(m_piCells);
+    free(m_pTasks);
+    free(m_pSegments);
+    free(m_pOrder);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGuidedRecognizer::Recognize
+//
+// Recognizes the cells in parallel and puts their text
+// together, in the order of the cells. The cells all see
+// the snapshot of the configuration pinned for the job,
+// until they're done. If the ink has an
+// input scope, the search of the lattice of the cells'
+// alternates puts the texts the scope accepts first.
+//
+// Parameters:
+//     const CRecoInk& ink          : [in] the ink, its strokes tagged with
+//                                    their cells
+//     const RecoCancel& cancel     : [in] tells if the job is stale
+//     RecoAlternate* pAlternates   : [out] the alternates, best first
+//     int cMaxAlternates           : [in] the size of pAlternates
+//
+// Return Values (int):
+//      the number of alternates, -1 if a cell failed, the job was
+//      cancelled or no snapshot could be pinned
+//
+/////////////////////////////////////////////////////////
+int CGuidedRecognizer::Recognize(
+        const CRecoInk& ink,
+        const RecoCancel& cancel,
+        RecoAlternate* pAlternates,
+        int cMaxAlternates
+        )
+{
+    if (0 == ink.GetStrokeCount() || cMaxAlternates <= 0)
+        return 0;
+
+    int cCells;
+    {
+        TRACE_SCOPE("Split cells");
+        cCells = SplitCells(ink);
+    }
+    if (cCells < 0)
+        return -1;
+
+    int iSlot = -1;
+    const GestureSnapshot* pSnapshot = NULL;
+    if (NULL != m_pConfig)
+    {
+        pSnapshot = m_pConfig->Acquire(iSlot);
+        if (NULL == pSnapshot)
+            return -1;
+    }
+    for (int c = 0; c < cCells; c++)
+    {
+        m_pCellInks[c].SetSnapshot(pSnapshot);
+    }
+    bool bRun = m_pool.Run(m_pTasks, cCells, cancel);
+    for (int c = 0; c < cCells; c++)
+    {
+        m_pCellInks[c].SetSnapshot(NULL);
+    }
+    if (NULL != pSnapshot)
+        m_pConfig->Release(iSlot);
+    if (false == bRun)
+        return -1;
+
+    // With an input scope the texts it accepts come first; coerced to
+    // the scope, they're the only ones
+    const int cCellColumns = ink.GetCellColumns();
+    int cResults = 0;
+    const IRecoConstraint* pConstraint = ink.GetConstraint();
+    if (NULL != pConstraint)
+    {
+        TRACE_SCOPE("Search lattice");
+        int cSegments = 0;
+        int iRow = -1;
+        for (int c = 0; c < cCells; c++)
+        {
+            if (0 == m_pTasks[c].cAlternates)
+                continue;
+            int iCellRow = m_piCells[c] / cCellColumns;
+            LatticeSegment& segment = m_pSegments[cSegments++];
+            segment.pAlternates = m_pTasks[c].rgAlternates;
+            segment.cAlternates = m_pTasks[c].cAlternates;
+            segment.pszSeparator = (iRow >= 0 && iCellRow != iRow) ? " " : "";
+            iRow = iCellRow;
+        }
+        cResults = m_search.Search(*pConstraint, m_pSegments, cSegments, pAlternates, cMaxAlternates);
+        if (cResults < 0 || ink.IsCoerced())
+            return cResults;
+    }
+
+    // As many alternates as the cell that has the most
+    int cAlternates = 0;
+    for (int c = 0; c < cCells; c++)
+    {
+        if (m_pTasks[c].cAlternates > cAlternates)
+            cAlternates = m_pTasks[c].cAlternates;
+    }
+
+    for (int k = 0; k < cAlternates && cResults < cMaxAlternates; k++)
+    {
+        RecoAlternate& alternate = pAlternates[cResults];
+        alternate.szText[0] = '\0';
+        float fScoreSum = 0;
+        bool bScored = true;
+        int cUsed = 0;
+        int iRow = -1;
+        for (int c = 0; c < cCells; c++)
+        {
+            const RecoTask& task = m_pTasks[c];
+            if (0 == task.cAlternates)
+                continue;
+
+            // The cells short of alternates keep their best one
+            const RecoAlternate& cell = task.rgAlternates[(k < task.cAlternates) ? k : 0];
+            int iCellRow = m_piCells[c] / cCellColumns;
+            if (iRow >= 0 && iCellRow != iRow)
+            {
+                AppendText(alternate.szText, BR_MAX_TEXT, " ");
+            }
+            iRow = iCellRow;
+            AppendText(alternate.szText, BR_MAX_TEXT, cell.szText);
+
+            if (cell.fScore < 0)
+                bScored = false;
+            fScoreSum += cell.fScore;
+            cUsed++;
+        }
+        alternate.fScore = (bScored && cUsed > 0) ? fScoreSum / cUsed : -1.0f;
+
+        // A text the search has already found is taken once
+        bool bDuplicate = false;
+        for (int i = 0; i < cResults && false == bDuplicate; i++)
+        {
+            bDuplicate = (0 == strcmp(pAlternates[i].szText, alternate.szText));
+        }
+        if (false == bDuplicate)
+            cResults++;
+    }
+    return cResults;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CGuidedRecognizer::SplitCells
+//
+// Copies the strokes of every non-empty cell into an ink of
+// its own, in the order they were written, and sets up a
+// task for it.
+//
+// Return Values (int):
+//      the number of the non-empty cells, -1 if out of memory
+//
+/////////////////////////////////////////////////////////
+int CGuidedRecognizer::SplitCells(const CRecoInk& ink)
+{
+    const int cStrokes = ink.GetStrokeCount();
+    if (cStrokes > m_cMaxStrokes)
+    {
+        StrokeCell* pOrder = (StrokeCell*)realloc(m_pOrder, cStrokes * sizeof(StrokeCell));
+        if (NULL == pOrder)
+            return -1;
+        m_pOrder = pOrder;
+        m_cMaxStrokes = cStrokes;
+    }
+
+    int cCells = 0;
+    for (int i = 0; i < cStrokes; i++)
+    {
+        m_pOrder[i].iCell = ink.GetStrokeCell(i);
+        m_pOrder[i].iStroke = i;
+    }
+    qsort(m_pOrder, cStrokes, sizeof(StrokeCell), CompareStrokeCells);
+    for (int i = 0; i < cStrokes; i++)
+    {
+        if (0 == i || m_pOrder[i].iCell != m_pOrder[i - 1].iCell)
+            cCells++;
+    }
+
+    if (cCells > m_cMaxCells)
+    {
+        // The inks of the cells aren't copyable, they're made anew
+        CRecoInk* pCellInks = new CRecoInk[cCells];
+        int* piCells = (int*)realloc(m_piCells, cCells * sizeof(int));
+        if (NULL != piCells)
+            m_piCells = piCells;
+        RecoTask* pTasks = (RecoTask*)realloc(m_pTasks, cCells * sizeof(RecoTask));
+        if (NULL != pTasks)
+            m_pTasks = pTasks;
+        LatticeSegment* pSegments =
+            (LatticeSegment*)realloc(m_pSegments, cCells * sizeof(LatticeSegment));
+        if (NULL != pSegments)
+            m_pSegments = pSegments;
+        if (NULL == piCells || NULL == pTasks || NULL == pSegments)
+        {
+            delete [] pCellInks;
+            return -1;
+        }
+        delete [] m_pCellInks;
+        m_pCellInks = pCellInks;
+        m_cMaxCells = cCells;
+    }
+
+    int c = -1;
+    for (int i = 0; i < cStrokes; i++)
+    {
+        const StrokeCell& sc = m_pOrder[i];
+        if (0 == i || sc.iCell != m_pOrder[i - 1].iCell)
+        {
+            c++;
+            m_pCellInks[c].Clear();
+            m_pCellInks[c].SetCellColumns(ink.GetCellColumns());
+            m_piCells[c] = sc.iCell;
+            m_pTasks[c].pInk = m_pCellInks + c;
+            m_pTasks[c].cAlternates = 0;
+        }
+
+        int cPoints;
+        const GesturePoint* ppt = ink.GetStroke(sc.iStroke, cPoints);
+        if (false == m_pCellInks[c].AddStroke(ppt, cPoints, sc.iCell))
+            return -1;
+    }
+    return cCells;
+}
@@ -0,0 +1,125 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      GuidedReco.h
+//
+// Description:
+//      Guided handwriting recognition. With a lined or a boxed guide the
+//      writer puts a line of text on every line, or a character in every
+//      box, so the ink comes already segmented: CRecoGuide finds the cell
+//      of a stroke from its coordinates, without looking at the other
+//      strokes, and CGuidedRecognizer recognizes the ink of every cell on
+//      its own, the cells in parallel on a CRecoWorkerPool, and puts the
+//      text of the cells together.
+//
+//      The methods of the classes are defined in the GuidedReco.cpp file.
+//--------------------------------------------------------------------------
+
+#pragma once
+
+#include "BackgroundReco.h"
+#include "RecoConstraint.h"
+
+/////////////////////////////////////////////////////////
+//
+// class CRecoGuide
+//
+// The geometry of a guide, in ink units: the top left corner
+// of the first cell, the size of a cell and the number of
+// the rows and columns. A lined guide has no columns, a row
+// is one cell. The cells are numbered row by row.
+//
+/////////////////////////////////////////////////////////
+
+class CRecoGuide
+{
+    float   m_x0;
+    float   m_y0;
+    float   m_fCellsPerX;   // 1 / the width of a cell
+    float   m_fCellsPerY;   // 1 / the height of a cell
+    int     m_cRows;        // 0 if there's no guide
+    int     m_cColumns;     // 0 if the guide is lined
+
+public:
+
+    CRecoGuide() : m_x0(0), m_y0(0), m_fCellsPerX(0), m_fCellsPerY(0),
+                   m_cRows(0), m_cColumns(0)
+    {
+    }
+
+    bool Set(float x0, float y0, float cxCell, float cyCell, int cRows, int cColumns);
+    void Reset() { m_cRows = m_cColumns = 0; }
+
+    int  GetCell(float x, float y) const;
+    int  GetStrokeCell(const GesturePoint* ppt, int cPoints) const;
+
+    // Data members access methods
+    bool IsSet() const { return (m_cRows > 0); }
+    int  GetRows() const { return m_cRows; }
+    int  GetColumns() const { return m_cColumns; }
+    int  GetCellColumns() const { return (m_cColumns > 0) ? m_cColumns : 1; }
+};
+
+/////////////////////////////////////////////////////////
+//
+// class CGuidedRecognizer
+//
+// Splits the ink by the cells of its strokes (see
+// CRecoInk::GetStrokeCell) and runs a recognition task per
+// non-empty cell on the worker pool. The text of the cells of
+// a row is put together as is, the rows are separated with a
+// space. The best alternate has the best text of every cell;
+// the next ones take the next alternate of every cell that
+// has one. With an input scope (CRecoInk::GetConstraint) the
+// best texts of the lattice of the cells' alternates that the
+// scope accepts go before them, or replace them if the ink is
+// coerced to the scope.
+//
+// It's an IStrokeRecognizer, so CBackgroundRecognizer runs it
+// as any other: the debounce and the cancellation apply to
+// the whole ink, and a stale job stops the cells that haven't
+// started yet.
+//
+// With a configuration, a job pins its current snapshot once
+// and hands it to all its cells with their ink, so the cells
+// of a job are never recognized with different templates.
+//
+/////////////////////////////////////////////////////////
+
+class CGuidedRecognizer : public IStrokeRecognizer
+{
+    CRecoWorkerPool&    m_pool;
+    CGestureConfig*     m_pConfig;      // NULL if the cells don't use one
+
+    // The buffers of the job, reused by the next one
+    CRecoInk*           m_pCellInks;    // the ink of every non-empty cell
+    int*                m_piCells;      // and its cell
+    RecoTask*           m_pTasks;
+    LatticeSegment*     m_pSegments;    // the non-empty cells, for the search
+    int                 m_cMaxCells;
+    struct StrokeCell*  m_pOrder;       // the strokes, sorted by cell
+    int                 m_cMaxStrokes;
+    CLatticeSearch      m_search;
+
+public:
+
+    // Constructor and destructor
+    CGuidedRecognizer(CRecoWorkerPool& pool, CGestureConfig* pConfig = NULL);
+    ~CGuidedRecognizer();
+
+    virtual int Recognize(const CRecoInk& ink, const RecoCancel& cancel,
+                          RecoAlternate* pAlternates, int cMaxAlternates);
+
+private:
+
+    int  SplitCells(const CRecoInk& ink);
+
+    // Not copyable
+    CGuidedRecognizer(const CGuidedRecognizer&);
+    CGuidedRecognizer& operator=(const CGuidedRecognizer&);
+};
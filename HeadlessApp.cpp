@@ -0,0 +1,381 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      HeadlessApp.cpp
+//
+// Description:
+//      The file contains the definitions of the methods of the class
+//      CHeadlessApp. See the file HeadlessApp.h for the definition of
+//      the class.
+//--------------------------------------------------------------------------
+
+#include <stdlib.h>
+
+#include "HeadlessApp.h"
+#include "Trace.h"
+
+// A useful macro to determine the number of elements in the array
+#ifndef countof
+#define countof(array)  (sizeof(array)/sizeof(array[0]))
+#endif
+
+// The ink space is in HIMETRIC units (0.01 mm); the panes are at 96 dpi
+#define HA_PIXELS_PER_INK   (96.0f / 2540.0f)
+
+/////////////////////////////////////////////////////////
+//
+// CHeadlessApp::CHeadlessApp
+//
+// Constructor.
+//
+// Parameters:
+//     const CGestureEngine& engine : [in] the engine to recognize with,
+//                                    must outlive the object
+//
+/////////////////////////////////////////////////////////
+CHeadlessApp::CHeadlessApp(const CGestureEngine& engine)
+    : m_engine(engine), m_fPixelsPerInk(HA_PIXELS_PER_INK), m_iGesture(-1),
+      m_cFrames(0), m_bResultsDirty(false), m_cPaints(0)
+{
+    RasterRect rcEmpty = { 0, 0, 0, 0 };
+    m_rcInput = m_rcResults = m_rcInputDirty = rcEmpty;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CHeadlessApp::~CHeadlessApp
+//
+// Destructor.
+//
+/////////////////////////////////////////////////////////
+CHeadlessApp::~CHeadlessApp()
+{
+}
+
+// Grows a rectangle to cover another; an empty one covers nothing
+static void UnionRect(RasterRect& rc, const RasterRect& rcOther)
+{
+    if (rcOther.left >= rcOther.right || rcOther.top >= rcOther.bottom)
+        return;
+    if (rc.left >= rc.right || rc.top >= rc.bottom)
+    {
+        rc = rcOther;
+        return;
+    }
+    if (rcOther.left < rc.left) rc.left = rcOther.left;
+    if (rcOther.top < rc.top) rc.top = rcOther.top;
+    if (rcOther.right > rc.right) rc.right = rcOther.right;
+    if (rcOther.bottom > rc.bottom) rc.bottom = rcOther.bottom;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CHeadlessApp::Create
+//
+// Creates the frame buffer, lays out the panes as
+// CAdvRecoApp::UpdateLayout does (the gesture list on the
+// right, the results pane at the bottom, the input pane in
+// the rest) and paints them.
+//
+// Return Values (bool):
+//      true if succeeded, false otherwise
+//
+/////////////////////////////////////////////////////////
+bool CHeadlessApp::Create()
+{
+    if (false == m_raster.Create(HA_WINDOW_WIDTH, HA_WINDOW_HEIGHT))
+        return false;
+
+    int cxPanes = HA_WINDOW_WIDTH - HA_LIST_WIDTH;
+    int cyResults = HA_MARGIN_Y * 2 + HA_LINE_HEIGHT * (HA_NUM_RESULTS + 1);
+
+    RasterRect rcResults = { 0, HA_WINDOW_HEIGHT - cyResults, cxPanes, HA_WINDOW_HEIGHT };
+    RasterRect rcInput = { 0, 0, cxPanes, HA_WINDOW_HEIGHT - cyResults };
+    m_rcResults = rcResults;
+    m_rcInput = rcInput;
+    if (false == m_layers.Create(rcInput.right - rcInput.left, rcInput.bottom - rcInput.top,
+                                 HA_CLR_INPUT_BACK, HA_CLR_INK))
+        return false;
+
+    // A packet is drawn once it's a pixel away from the last one
+    m_input.SetFrameTime(PI_DEFAULT_FRAME_TIME);
+    m_input.SetMinMove(1.0f / m_fPixelsPerInk);
+    m_input.SetSpacing(PI_DEFAULT_SPACING);
+
+    m_iGesture = -1;
+    m_layers.Clear(m_rcInputDirty);
+    PaintInput();
+    PaintResults();
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CHeadlessApp::OnPenDown
+//
+// A new stroke begins.
+//
+/////////////////////////////////////////////////////////
+void CHeadlessApp::OnPenDown()
+{
+    m_input.BeginStroke();
+}
+
+/////////////////////////////////////////////////////////
+//
+// CHeadlessApp::OnPacket
+//
+// Gives a packet to the input stage, and draws the ink
+// of the frame when it's due, as the InkCollector does
+// while the pen moves: into the live layer, composing the
+// pixels of the frame's segments once.
+//
+// Parameters:
+//     float x, float y : [in] the packet position, in ink units
+//     PERFTIME ptTime  : [in] when the packet came
+//
+// Return Values (bool):
+//      true if succeeded, false if out of memory
+//
+/////////////////////////////////////////////////////////
+bool CHeadlessApp::OnPacket(float x, float y, PERFTIME ptTime)
+{
+    if (false == m_input.AddPacket(x, y))
+        return false;
+    if (m_input.IsFrameDue(ptTime))
+        return DrawFrame(ptTime);
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CHeadlessApp::DrawFrame
+//
+// Draws the points the input stage coalesced into the
+// live layer and composes the rectangle they cover.
+//
+// Return Values (bool):
+//      true if succeeded, false if out of memory
+//
+/////////////////////////////////////////////////////////
+bool CHeadlessApp::DrawFrame(PERFTIME ptNow)
+{
+    const GesturePoint* ppt = m_input.GetFramePoints();
+    int cPoints = m_input.GetFramePointCount();
+    RasterRect rcFrame = { 0, 0, 0, 0 };
+    bool bDrawn = true;
+    for (int i = 0; i < cPoints && bDrawn; i++)
+    {
+        int xPixel, yPixel;
+        InkToPixel(ppt[i], xPixel, yPixel);
+        RasterRect rcDirty;
+        bDrawn = m_layers.AddPoint(xPixel, yPixel, rcDirty);
+        UnionRect(rcFrame, rcDirty);
+    }
+    m_input.TakeFrame(ptNow);
+    m_cFrames++;
+    if (rcFrame.left < rcFrame.right)
+        m_layers.Compose(rcFrame, m_raster, m_rcInput.left, m_rcInput.top);
+    return bDrawn;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CHeadlessApp::OnPenUp
+//
+// The stroke ends: recognizes it, takes the best alternate
+// as the gesture (all the gestures are enabled), and runs
+// the command it's bound to, clearing the ink by default,
+// with the repaint of the panes, as OnGesture and the
+// message loop after it do.
+//
+// Return Values (int):
+//      the gesture shown, -1 if it's shown as unknown
+//
+/////////////////////////////////////////////////////////
+int CHeadlessApp::OnPenUp()
+{
+    TRACE_SCOPE("Pen up to result");
+
+    OnGesture(RecognizeStroke());
+    DispatchCommands();
+    return m_iGesture;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CHeadlessApp::RecognizeStroke
+//
+// Recognizes the stroke and drops its ink, as the
+// InkCollector does with a gesture before the event; the
+// pane is painted by the next DispatchCommands.
+//
+// Return Values (int):
+//      the gesture, -1 if unknown
+//
+/////////////////////////////////////////////////////////
+int CHeadlessApp::RecognizeStroke()
+{
+    // The last packet isn't drawn: the ink of a gesture goes at once
+    GestureResult rgResults[GE_NUM_SSGESTURES];
+    int cResults = 0;
+    if (m_input.EndStroke() && m_input.GetPointCount() > 0)
+    {
+        cResults = m_engine.Recognize(m_input.GetPoints(), m_input.GetPointCount(),
+                                      rgResults, countof(rgResults));
+    }
+
+    RasterRect rcDirty;
+    m_input.BeginStroke();
+    m_layers.EndStroke(false, rcDirty);
+    UnionRect(m_rcInputDirty, rcDirty);
+
+    return (cResults > 0) ? rgResults[0].iGesture : -1;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CHeadlessApp::OnGesture
+//
+// The gesture event: shows the gesture's name and posts
+// the command of the gesture, to run with the next
+// DispatchCommands; nothing is painted. If the queue is
+// full, it's run first.
+//
+// Parameters:
+//     int iGesture : [in] the gesture, -1 if unknown
+//
+/////////////////////////////////////////////////////////
+void CHeadlessApp::OnGesture(int iGesture)
+{
+    m_iGesture = iGesture;
+    m_bResultsDirty = true;
+
+    GestureCommand command = m_bindings.GetCommand(iGesture);
+    if (false == m_commands.Post(command))
+    {
+        DispatchCommands();
+        m_commands.Post(command);
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CHeadlessApp::DispatchCommands
+//
+// Runs the commands posted, in order, then paints the
+// parts of the panes they changed, once.
+//
+// Return Values (int):
+//      the number of the commands run
+//
+/////////////////////////////////////////////////////////
+int CHeadlessApp::DispatchCommands()
+{
+    GestureCommand rgCommands[GCMD_MAX_QUEUED];
+    int cCommands = m_commands.Take(rgCommands, countof(rgCommands));
+    for (int i = 0; i < cCommands; i++)
+    {
+        RunCommand(rgCommands[i]);
+    }
+
+    if (m_rcInputDirty.left < m_rcInputDirty.right)
+    {
+        TRACE_SCOPE("Paint input");
+        PaintInput();
+    }
+    if (m_bResultsDirty)
+    {
+        TRACE_SCOPE("Paint results");
+        PaintResults();
+    }
+    return cCommands;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CHeadlessApp::RunCommand
+//
+// Runs a command. There's no history, recognizer or guide
+// here: only the clear changes the panes, the others are
+// run as nothing.
+//
+/////////////////////////////////////////////////////////
+void CHeadlessApp::RunCommand(const GestureCommand& command)
+{
+    if (GCMD_CLEAR == command.iKind)
+    {
+        TRACE_SCOPE("Clear");
+        RasterRect rcDirty;
+        m_layers.Clear(rcDirty);
+        UnionRect(m_rcInputDirty, rcDirty);
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CHeadlessApp::IsGestureNameDrawn
+//
+// Tells if the name of the gesture shown is in the frame
+// buffer, by looking for its color where it's drawn.
+//
+/////////////////////////////////////////////////////////
+bool CHeadlessApp::IsGestureNameDrawn() const
+{
+    const char* pszName = CGestureEngine::GetGestureName(m_iGesture);
+    RasterRect rc = { m_rcResults.left + HA_MARGIN_X, m_rcResults.top + HA_MARGIN_Y,
+                      m_rcResults.left + HA_MARGIN_X + CSoftRaster::GetTextWidth(pszName, HA_FONT_SCALE),
+                      m_rcResults.top + HA_MARGIN_Y + SR_GLYPH_HEIGHT * HA_FONT_SCALE };
+    return m_raster.FindPixel(rc, HA_CLR_BLUE);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CHeadlessApp::InkToPixel
+//
+// Maps a point in ink units to the input pane's pixels.
+//
+/////////////////////////////////////////////////////////
+void CHeadlessApp::InkToPixel(const GesturePoint& pt, int& x, int& y) const
+{
+    x = (int)(pt.x * m_fPixelsPerInk);
+    y = (int)(pt.y * m_fPixelsPerInk);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CHeadlessApp::PaintInput
+//
+// Paints the changed part of the input pane from its ink
+// layers, as CInkInputWnd::OnPaint does.
+//
+/////////////////////////////////////////////////////////
+void CHeadlessApp::PaintInput()
+{
+    RasterRect rcEmpty = { 0, 0, 0, 0 };
+    m_layers.Compose(m_rcInputDirty, m_raster, m_rcInput.left, m_rcInput.top);
+    m_rcInputDirty = rcEmpty;
+    m_cPaints++;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CHeadlessApp::PaintResults
+//
+// Paints the results pane with the name of the gesture in
+// blue, as CRecoOutputWnd::OnPaint does for a new gesture.
+//
+/////////////////////////////////////////////////////////
+void CHeadlessApp::PaintResults()
+{
+    m_bResultsDirty = false;
+    m_cPaints++;
+    m_raster.FillRect(m_rcResults, HA_CLR_RESULTS_BACK);
+    m_raster.DrawText(m_rcResults.left + HA_MARGIN_X, m_rcResults.top + HA_MARGIN_Y,
+                      CGestureEngine::GetGestureName(m_iGesture), HA_CLR_BLUE, HA_FONT_SCALE);
+}
@@ -0,0 +1,120 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      HeadlessApp.h
+//
+// Description:
+//      This file contains the definition of the CHeadlessApp class, the
+//      event path of the sample application without a window system:
+//      the pen packets are drawn as ink into the input pane as they come,
+//      the pen up runs the recognition, clears the ink and repaints the
+//      results pane with the name of the gesture, the way CAdvRecoApp's
+//      OnGesture, OnClear and CRecoOutputWnd::OnPaint do. The panes are
+//      laid out as in the application's default window and drawn by the
+//      software rasterizer (SoftRaster.h), so the end-to-end benchmark
+//      can measure the time from the pen up to the result's pixels. The
+//      input pane is painted from its ink layers (InkLayers.h), and the
+//      packets go through the input stage (PacketInput.h): the ink of a
+//      frame's packets is composed once, and the stroke is recognized
+//      from points at a fixed spacing, whatever the rate of the pen.
+//      The gesture's command goes through the command queue
+//      (GestureCommands.h), and the panes are painted once for all the
+//      commands run together, as the application's windows are.
+//
+//      The methods of the class are defined in the HeadlessApp.cpp file.
+//--------------------------------------------------------------------------
+
+#pragma once
+
+#include "GestureEngine.h"
+#include "SoftRaster.h"
+#include "InkLayers.h"
+#include "PacketInput.h"
+#include "GestureCommands.h"
+
+enum {
+    HA_WINDOW_WIDTH = 640,      // the client area of the application window
+    HA_WINDOW_HEIGHT = 480,
+    HA_LIST_WIDTH = 160,        // CAdvRecoApp::mc_cxGestLVWidth
+    HA_MARGIN_X = 10,           // CRecoOutputWnd::mc_iMarginX
+    HA_MARGIN_Y = 10,           // CRecoOutputWnd::mc_iMarginY
+    HA_LINE_HEIGHT = 20,        // CRecoOutputWnd::mc_iFontHeight
+    HA_NUM_RESULTS = 5,         // CRecoOutputWnd::mc_iNumResults
+    HA_FONT_SCALE = 2           // the font pixels per screen pixel
+};
+
+// The colors of the panes, as in ChildWnds.cpp
+#define HA_CLR_INK          SR_RGB(0x00, 0x00, 0x00)
+#define HA_CLR_INPUT_BACK   SR_RGB(0xFF, 0xFF, 0xFF)
+#define HA_CLR_RESULTS_BACK SR_RGB(0xFF, 0xFF, 0xFF)
+#define HA_CLR_BLUE         SR_RGB(0x00, 0x00, 0x80)
+
+/////////////////////////////////////////////////////////
+//
+// class CHeadlessApp
+//
+// The application's event path over a frame buffer. The
+// gestures are all enabled, as the application starts.
+//
+/////////////////////////////////////////////////////////
+
+class CHeadlessApp
+{
+    const CGestureEngine&   m_engine;
+    CSoftRaster             m_raster;
+    RasterRect              m_rcInput;
+    RasterRect              m_rcResults;
+    CInkLayers              m_layers;       // the input pane's ink
+    CPacketInput            m_input;        // the stroke being drawn
+    float                   m_fPixelsPerInk;
+    int                     m_iGesture;     // the gesture shown, -1 for unknown
+    int                     m_cFrames;      // the frames of ink composed
+    CGestureBindings        m_bindings;
+    CCommandQueue           m_commands;
+    RasterRect              m_rcInputDirty; // the input pane's rect to paint
+    bool                    m_bResultsDirty;
+    int                     m_cPaints;      // the times a pane was painted
+
+public:
+
+    // Constructor and destructor
+    CHeadlessApp(const CGestureEngine& engine);
+    ~CHeadlessApp();
+
+    bool Create();
+
+    // Pen events
+    void OnPenDown();
+    bool OnPacket(float x, float y, PERFTIME ptTime);
+    int  OnPenUp();
+
+    // The pen up, a step at a time: the stroke's recognition, the
+    // gesture event, and the commands it posted run with the repaint
+    int  RecognizeStroke();
+    void OnGesture(int iGesture);
+    int  DispatchCommands();
+
+    // Data members access methods
+    const CSoftRaster& GetRaster() const { return m_raster; }
+    const RasterRect& GetInputRect() const { return m_rcInput; }
+    CPacketInput& GetInput() { return m_input; }
+    int  GetGestureShown() const { return m_iGesture; }
+    int  GetFrameCount() const { return m_cFrames; }
+    int  GetPaintCount() const { return m_cPaints; }
+    CGestureBindings& GetBindings() { return m_bindings; }
+    const CCommandQueue& GetCommands() const { return m_commands; }
+    bool IsGestureNameDrawn() const;
+
+private:
+
+    void InkToPixel(const GesturePoint& pt, int& x, int& y) const;
+    bool DrawFrame(PERFTIME ptNow);
+    void RunCommand(const GestureCommand& command);
+    void PaintInput();
+    void PaintResults();
+};
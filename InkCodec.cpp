@@ -0,0 +1,1744 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      InkCodec.cpp
+//
+// Description:
+//      The file contains the definitions of the methods of the classes
+//      CInkCodec, CInkArchiveWriter and CInkArchiveReader.
+//      See the file InkCodec.h for the definitions of the classes.
+//--------------------------------------------------------------------------
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The four channels of a packet are decoded at once with SSE4.1, when
+// the processor has it; the functions that use it are compiled for it
+// alone, so the rest of the file runs anywhere
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define IC_VECTOR
+#include <smmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define IC_VECTOR_CODE
+#define IC_VECTOR_INLINE    __forceinline
+#else
+#include <cpuid.h>
+#define IC_VECTOR_CODE      __attribute__((target("sse4.1")))
+#define IC_VECTOR_INLINE    inline __attribute__((always_inline, target("sse4.1")))
+#endif
+#endif
+
+#include "InkCodec.h"
+#include "Trace.h"
+
+#define IC_SCALE        (1u << IC_SCALE_BITS)
+#define IC_FREQ_BITS    (IC_SCALE_BITS + 1)     // a slot: the frequency, the offset, 8 unused bits and
+#define IC_FREQ_MASK    ((1u << IC_FREQ_BITS) - 1)  // the top byte, so IC_SCALE_BITS is 11 at most
+#define IC_RANS_LOW     (1u << 16)      // the states stay in [IC_RANS_LOW, 2^32)
+#define IC_WORDS_SLACK  (8 * IC_NUM_STATES) // zeros after the words, read ahead by a set of states
+#define IC_NUM_MODELS   4               // the prior, then a model per rebuild up to IC_LAST_REBUILD
+#define IC_LONG_TOKEN   0x40            // the top byte of the slots of a long token, with its bit length
+
+// The value of a channel of a packet, as an unsigned number, so the
+// predictions wrap around instead of overflowing
+static inline unsigned int GetChannel(const InkPacket& packet, int iChannel)
+{
+    switch (iChannel)
+    {
+        case IC_CHANNEL_X:      return (unsigned int)packet.x;
+        case IC_CHANNEL_Y:      return (unsigned int)packet.y;
+        case IC_CHANNEL_TIME:   return packet.uTime;
+        default:                return (unsigned int)packet.iPressure;
+    }
+}
+
+// The channels of a set of IC_HAS_ flags, in the coding order
+static int GetChannels(unsigned int uChannels, int* piChannels)
+{
+    int cChannels = 0;
+    piChannels[cChannels++] = IC_CHANNEL_X;
+    piChannels[cChannels++] = IC_CHANNEL_Y;
+    if (uChannels & IC_HAS_TIME)
+        piChannels[cChannels++] = IC_CHANNEL_TIME;
+    if (uChannels & IC_HAS_PRESSURE)
+        piChannels[cChannels++] = IC_CHANNEL_PRESSURE;
+    return cChannels;
+}
+
+// Writes an unsigned varint, 7 bits per byte, low bits first
+static unsigned char* PutVarint(unsigned char* pb, unsigned int u)
+{
+    while (u >= 0x80)
+    {
+        *pb++ = (unsigned char)(u | 0x80);
+        u >>= 7;
+    }
+    *pb++ = (unsigned char)u;
+    return pb;
+}
+
+// Reads an unsigned varint; false if it runs past the end
+static bool GetVarint(const unsigned char*& pb, const unsigned char* pbEnd, unsigned int& u)
+{
+    u = 0;
+    for (int iShift = 0; iShift < 35; iShift += 7)
+    {
+        if (pb >= pbEnd)
+            return false;
+        unsigned int b = *pb++;
+        u |= (b & 0x7F) << iShift;
+        if (0 == (b & 0x80))
+            return true;
+    }
+    return false;
+}
+
+// The bit length of a value, 0 for 0
+static inline int GetBitLength(unsigned int u)
+{
+    int cBits = 0;
+    while (u)
+    {
+        cBits++;
+        u >>= 1;
+    }
+    return cBits;
+}
+
+// The packet after which the models are rebuilt next, past the one
+// they've just been rebuilt after; 0xFFFFFFFF once they're final
+static inline unsigned int GetNextRebuild(unsigned int iRebuild)
+{
+    return (iRebuild < IC_LAST_REBUILD) ? 4 * iRebuild : 0xFFFFFFFFu;
+}
+
+// The top byte of the slots of a token: the residual of a direct
+// token, as a signed byte, or IC_LONG_TOKEN and the number of the
+// raw bits of a long one, whose top bit is implied
+static inline unsigned int GetTokenByte(unsigned int uToken)
+{
+    if (uToken < IC_DIRECT_TOKENS)
+        return ((uToken >> 1) ^ (0u - (uToken & 1))) & 0xFF;
+    return IC_LONG_TOKEN | (uToken - IC_DIRECT_TOKENS + 5);
+}
+
+// Scales the counts of the tokens of a channel to frequencies that add
+// up to IC_SCALE, none of them down to 0, so every token can be coded
+static void GetFrequencies(const unsigned int* pcTokens, unsigned short* pusFreqs)
+{
+    unsigned long long cTotal = 0;
+    for (unsigned int t = 0; t < IC_NUM_TOKENS; t++)
+    {
+        cTotal += pcTokens[GetTokenByte(t)];
+    }
+
+    // By a 32.32 fixed point scale rather than a division per token
+    unsigned long long ullScale = ((unsigned long long)(IC_SCALE - IC_NUM_TOKENS) << 32) / cTotal;
+    unsigned int uSum = 0;
+    unsigned int iMax = 0;
+    for (unsigned int t = 0; t < IC_NUM_TOKENS; t++)
+    {
+        unsigned long long c = pcTokens[GetTokenByte(t)];
+        pusFreqs[t] = (unsigned short)(1 + ((c * ullScale) >> 32));
+        uSum += pusFreqs[t];
+        if (pusFreqs[t] > pusFreqs[iMax])
+            iMax = t;
+    }
+    pusFreqs[iMax] = (unsigned short)(pusFreqs[iMax] + IC_SCALE - uSum);
+}
+
+// Reads the raw bits of the long residuals, low bits first
+struct InkBitReader
+{
+    const unsigned char*    pb;
+    const unsigned char*    pbEnd;
+    unsigned long long      ullBits;
+    int                     cBits;
+
+    bool Get(int cGet, unsigned int& u)
+    {
+        while (cBits < cGet)
+        {
+            if (pb >= pbEnd)
+                return false;
+            ullBits |= (unsigned long long)*pb++ << cBits;
+            cBits += 8;
+        }
+        u = (unsigned int)(ullBits & ((1ull << cGet) - 1));
+        ullBits >>= cGet;
+        cBits -= cGet;
+        return true;
+    }
+};
+
+// The decoder between two rebuilds of the models: the states, each
+// packet taking the next set in turn, the words and the raw bits
+struct InkDecoder
+{
+    unsigned int            rgx[IC_NUM_STATES][IC_NUM_CHANNELS];
+    const unsigned char*    pbWords;
+    const unsigned char*    pbWordsEnd;
+    InkBitReader            bits;
+};
+
+// Reads the raw bits of a long token, by the top byte of its slot, and
+// makes its residual
+static inline bool GetLongResidual(InkBitReader& bits, unsigned int uTokenByte, unsigned int& uResidual)
+{
+    int cExtra = (int)(uTokenByte & (IC_LONG_TOKEN - 1));
+    unsigned int uExtra;
+    if (false == bits.Get(cExtra, uExtra))
+        return false;
+    unsigned int z = (1u << cExtra) | uExtra;
+    uResidual = (z >> 1) ^ (0u - (z & 1));
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// DecodeResiduals
+//
+// Decodes the residuals of a run of the packets of a block,
+// a channel at a time, and counts their tokens. The packets
+// take the sets of states in turn. The channels
+// that aren't coded are zeroed.
+//
+// Parameters:
+//     puSlots     : [in] the decoding tables, by channel
+//     pcTokens    : [in, out] the counts of the tokens, by channel
+//     piChannels  : [in] the coded channels
+//     cChannels   : [in] the number of the coded channels
+//     dec         : [in, out] the states, the words and the raw bits
+//     pPackets    : [out] the residuals of the packets of the block
+//     iFirst      : [in] the first packet of the run, of the first states
+//     iEnd        : [in] the packet after the last one of the run
+//
+// The counts are kept only while a rebuild is ahead (bCount).
+//
+// Return Values (bool):
+//      true if the run has been decoded, false if the block is damaged
+//
+/////////////////////////////////////////////////////////
+template <bool bCount>
+static bool DecodeResiduals(
+        const unsigned int (*puSlots)[IC_SCALE],
+        unsigned int (*pcTokens)[256],
+        const int* piChannels,
+        int cChannels,
+        InkDecoder& dec,
+        InkPacket* pPackets,
+        unsigned int iFirst,
+        unsigned int iEnd
+        )
+{
+    // The words pointer and the residuals in locals, which the stores
+    // to the packets can't alias
+    const unsigned char* pbWords = dec.pbWords;
+    for (unsigned int i = iFirst; i < iEnd; i++)
+    {
+        // A packet reads at most a word per channel
+        if (pbWords > dec.pbWordsEnd)
+            return false;
+
+        unsigned int* rgx = dec.rgx[i % IC_NUM_STATES];
+        unsigned int rgu[IC_NUM_CHANNELS] = { 0, 0, 0, 0 };
+        for (int k = 0; k < cChannels; k++)
+        {
+            int c = piChannels[k];
+            unsigned int x = rgx[c];
+            unsigned int uSlot = puSlots[c][x & (IC_SCALE - 1)];
+            if (bCount)
+                pcTokens[c][uSlot >> 24]++;
+            x = (uSlot & IC_FREQ_MASK) * (x >> IC_SCALE_BITS) + ((uSlot >> IC_FREQ_BITS) & (IC_SCALE - 1));
+            // Branchless, the renormalizations are too random to predict
+            unsigned int uRenorm = (x < IC_RANS_LOW) ? 16 : 0;
+            x = (x << uRenorm) | ((pbWords[0] | ((unsigned int)pbWords[1] << 8)) & (0u - (uRenorm >> 4)));
+            pbWords += uRenorm >> 3;
+            rgx[c] = x;
+
+            unsigned int uResidual = (unsigned int)(int)(signed char)(uSlot >> 24);
+            if ((int)uResidual >= IC_DIRECT_TOKENS / 2
+                && false == GetLongResidual(dec.bits, uSlot >> 24, uResidual))
+                return false;
+            rgu[c] = uResidual;
+        }
+        memcpy(&pPackets[i], rgu, sizeof(rgu));
+    }
+    dec.pbWords = pbWords;
+    return true;
+}
+
+#ifdef IC_VECTOR
+
+// Whether the processor has SSSE3 and SSE4.1
+static bool HasVectorCode()
+{
+    unsigned int uFeatures;
+#ifdef _MSC_VER
+    int rgiInfo[4];
+    __cpuid(rgiInfo, 1);
+    uFeatures = (unsigned int)rgiInfo[2];
+#else
+    unsigned int uEax, uEbx, uEdx;
+    if (0 == __get_cpuid(1, &uEax, &uEbx, &uFeatures, &uEdx))
+        return false;
+#endif
+    return (0 != (uFeatures & (1u << 9)) && 0 != (uFeatures & (1u << 19)));
+}
+
+// Decodes the next packet of a set of states, its four channels at
+// once: a table lookup per channel gives the frequency, the offset and
+// the residual or the raw bit count, the states that fall below
+// IC_RANS_LOW take their words with a shuffle, and only a packet with
+// a long token leaves the straight path
+template <bool bCount>
+static IC_VECTOR_INLINE __m128i DecodePacket(
+        const unsigned int (*puSlots)[IC_SCALE],
+        unsigned int (*pcTokens)[256],
+        const unsigned char (*pbRenorm)[16],
+        const unsigned char* pcbRenorm,
+        __m128i x,
+        const unsigned char*& pbWords,
+        InkBitReader& bits,
+        unsigned int* pu,
+        bool& bDecoded
+        )
+{
+    __m128i uIndexes = _mm_and_si128(x, _mm_set1_epi32(IC_SCALE - 1));
+    unsigned int uSlot0 = puSlots[0][(unsigned int)_mm_cvtsi128_si32(uIndexes)];
+    unsigned int uSlot1 = puSlots[1][(unsigned int)_mm_extract_epi32(uIndexes, 1)];
+    unsigned int uSlot2 = puSlots[2][(unsigned int)_mm_extract_epi32(uIndexes, 2)];
+    unsigned int uSlot3 = puSlots[3][(unsigned int)_mm_extract_epi32(uIndexes, 3)];
+    if (bCount)
+    {
+        pcTokens[0][uSlot0 >> 24]++;
+        pcTokens[1][uSlot1 >> 24]++;
+        pcTokens[2][uSlot2 >> 24]++;
+        pcTokens[3][uSlot3 >> 24]++;
+    }
+    __m128i uSlots = _mm_cvtsi32_si128((int)uSlot0);
+    uSlots = _mm_insert_epi32(uSlots, (int)uSlot1, 1);
+    uSlots = _mm_insert_epi32(uSlots, (int)uSlot2, 2);
+    uSlots = _mm_insert_epi32(uSlots, (int)uSlot3, 3);
+
+    __m128i uFreqs = _mm_and_si128(uSlots, _mm_set1_epi32(IC_FREQ_MASK));
+    __m128i uOffsets = _mm_and_si128(_mm_srli_epi32(uSlots, IC_FREQ_BITS), _mm_set1_epi32(IC_SCALE - 1));
+    x = _mm_add_epi32(_mm_mullo_epi32(uFreqs, _mm_srli_epi32(x, IC_SCALE_BITS)), uOffsets);
+
+    __m128i bRenorm = _mm_cmpeq_epi32(_mm_srli_epi32(x, 16), _mm_setzero_si128());
+    int iRenorm = _mm_movemask_ps(_mm_castsi128_ps(bRenorm));
+    __m128i uWords = _mm_shuffle_epi8(_mm_loadl_epi64((const __m128i*)pbWords),
+                                      _mm_loadu_si128((const __m128i*)pbRenorm[iRenorm]));
+    x = _mm_or_si128(_mm_blendv_epi8(x, _mm_slli_epi32(x, 16), bRenorm), uWords);
+    pbWords += pcbRenorm[iRenorm];
+
+    __m128i iResiduals = _mm_srai_epi32(uSlots, 24);
+    _mm_storeu_si128((__m128i*)pu, iResiduals);
+    int iLong = _mm_movemask_ps(_mm_castsi128_ps(
+        _mm_cmpgt_epi32(iResiduals, _mm_set1_epi32(IC_DIRECT_TOKENS / 2 - 1))));
+    if (0 != iLong)
+    {
+        for (int c = 0; c < IC_NUM_CHANNELS; c++)
+        {
+            if ((iLong & (1 << c)) && false == GetLongResidual(bits, pu[c] & 0xFF, pu[c]))
+                bDecoded = false;
+        }
+    }
+    return x;
+}
+
+/////////////////////////////////////////////////////////
+//
+// DecodeResidualsVector
+//
+// DecodeResiduals with the four channels of a packet at
+// once, and a packet of each set of states in flight. A channel that isn't coded has a table that
+// leaves its state as it is and decodes to 0.
+//
+/////////////////////////////////////////////////////////
+template <bool bCount>
+IC_VECTOR_CODE
+static bool DecodeResidualsVector(
+        const unsigned int (*puSlots)[IC_SCALE],
+        unsigned int (*pcTokens)[256],
+        const int* piChannels,
+        int cChannels,
+        const unsigned char (*pbRenorm)[16],
+        const unsigned char* pcbRenorm,
+        InkDecoder& dec,
+        InkPacket* pPackets,
+        unsigned int iFirst,
+        unsigned int iEnd
+        )
+{
+    __m128i rgx[IC_NUM_STATES];
+    for (int k = 0; k < IC_NUM_STATES; k++)
+    {
+        rgx[k] = _mm_loadu_si128((const __m128i*)dec.rgx[k]);
+    }
+    const unsigned char* pbWords = dec.pbWords;
+    bool bDecoded = true;
+
+    unsigned int i = iFirst;
+    for (; bDecoded && i + IC_NUM_STATES <= iEnd; i += IC_NUM_STATES)
+    {
+        // A set of states reads at most 8 bytes a packet
+        if (pbWords > dec.pbWordsEnd)
+        {
+            bDecoded = false;
+            break;
+        }
+        for (int k = 0; k < IC_NUM_STATES; k++)
+        {
+            rgx[k] = DecodePacket<bCount>(puSlots, pcTokens, pbRenorm, pcbRenorm, rgx[k], pbWords, dec.bits,
+                                          (unsigned int*)&pPackets[i + k], bDecoded);
+        }
+    }
+    for (int k = 0; k < IC_NUM_STATES; k++)
+    {
+        _mm_storeu_si128((__m128i*)dec.rgx[k], rgx[k]);
+    }
+    dec.pbWords = pbWords;
+
+    // The last packets of the block, fewer than a set of states
+    return bDecoded && DecodeResiduals<bCount>(puSlots, pcTokens, piChannels, cChannels, dec, pPackets, i, iEnd);
+}
+
+/////////////////////////////////////////////////////////
+//
+// BuildTableVector
+//
+// CInkCodec::BuildTable, four slots at a time.
+//
+/////////////////////////////////////////////////////////
+IC_VECTOR_CODE
+static void BuildTableVector(unsigned int* puSlots, const unsigned short* pusFreqs)
+{
+    const __m128i uStep = _mm_set1_epi32(4 << IC_FREQ_BITS);
+    const __m128i uOffsets = _mm_setr_epi32(0, 1 << IC_FREQ_BITS, 2 << IC_FREQ_BITS, 3 << IC_FREQ_BITS);
+    unsigned int* puSlot = puSlots;
+    for (unsigned int t = 0; t < IC_NUM_TOKENS; t++)
+    {
+        unsigned int uFreq = pusFreqs[t];
+        unsigned int uSlot = (GetTokenByte(t) << 24) | uFreq;
+        __m128i u = _mm_add_epi32(_mm_set1_epi32((int)uSlot), uOffsets);
+        unsigned int k = 0;
+        for (; k + 4 <= uFreq; k += 4)
+        {
+            _mm_storeu_si128((__m128i*)(puSlot + k), u);
+            u = _mm_add_epi32(u, uStep);
+        }
+        for (; k < uFreq; k++)
+        {
+            puSlot[k] = uSlot | (k << IC_FREQ_BITS);
+        }
+        puSlot += uFreq;
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// AddPredictionsVector
+//
+// Adds the predictions to the residuals of the packets of
+// the strokes, in place, the four channels at once.
+//
+/////////////////////////////////////////////////////////
+IC_VECTOR_CODE
+static void AddPredictionsVector(InkPacket* pPackets, const int* pcStrokePackets, unsigned int cStrokes)
+{
+    __m128i* pu = (__m128i*)pPackets;
+    __m128i uLast = _mm_setzero_si128();
+    for (unsigned int s = 0; s < cStrokes; s++)
+    {
+        __m128i* puStrokeEnd = pu + pcStrokePackets[s];
+
+        // The first two packets are predicted by the packet before
+        __m128i uBefore = uLast;
+        uLast = _mm_add_epi32(_mm_loadu_si128(pu), uLast);
+        _mm_storeu_si128(pu++, uLast);
+        if (pu < puStrokeEnd)
+        {
+            uBefore = uLast;
+            uLast = _mm_add_epi32(_mm_loadu_si128(pu), uLast);
+            _mm_storeu_si128(pu++, uLast);
+        }
+        for (; pu < puStrokeEnd; pu++)
+        {
+            __m128i uStep = _mm_sub_epi32(uLast, uBefore);
+            uBefore = uLast;
+            uLast = _mm_add_epi32(_mm_add_epi32(_mm_loadu_si128(pu), uStep), uLast);
+            _mm_storeu_si128(pu, uLast);
+        }
+    }
+}
+
+#endif // IC_VECTOR
+
+// Adds the predictions to the residuals of the packets of the strokes,
+// in place
+static void AddPredictions(InkPacket* pPackets, const int* pcStrokePackets, unsigned int cStrokes)
+{
+    unsigned int rgu[4] = { 0, 0, 0, 0 };
+    unsigned int* pu = (unsigned int*)pPackets;
+    for (unsigned int s = 0; s < cStrokes; s++)
+    {
+        unsigned int* puStrokeEnd = pu + 4 * pcStrokePackets[s];
+        for (int i = 0; i < 2 && pu < puStrokeEnd; i++, pu += 4)
+        {
+            for (int c = 0; c < 4; c++)
+            {
+                rgu[c] = pu[c] += rgu[c];
+            }
+        }
+        for (; pu < puStrokeEnd; pu += 4)
+        {
+            for (int c = 0; c < 4; c++)
+            {
+                pu[c] += 2 * pu[c - 4] - pu[c - 8];
+            }
+        }
+        for (int c = 0; c < 4; c++)
+        {
+            rgu[c] = pu[c - 4];
+        }
+    }
+}
+
+////////////////////////////////////////////////////////
+// CInkCodec methods
+////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////
+//
+// CInkCodec::CInkCodec
+//
+// Constructor. Fills the CRC tables, of the reflected
+// polynomial 0xEDB88320, as zlib's, and the shuffles of
+// the words of the states that take one.
+//
+// Parameters:
+//     none
+//
+/////////////////////////////////////////////////////////
+CInkCodec::CInkCodec()
+    : m_pbTokens(NULL), m_pbBits(NULL), m_pbWords(NULL), m_pbBlock(NULL),
+      m_cMaxTokens(0), m_cMaxStrokes(0), m_bVector(false)
+{
+    for (unsigned int u = 0; u < 256; u++)
+    {
+        unsigned int uCrc = u;
+        for (int k = 0; k < 8; k++)
+        {
+            uCrc = (uCrc >> 1) ^ ((uCrc & 1) ? 0xEDB88320u : 0);
+        }
+        m_rguCrc[0][u] = uCrc;
+    }
+    for (unsigned int u = 0; u < 256; u++)
+    {
+        for (int t = 1; t < 8; t++)
+        {
+            m_rguCrc[t][u] = (m_rguCrc[t - 1][u] >> 8) ^ m_rguCrc[0][m_rguCrc[t - 1][u] & 0xFF];
+        }
+    }
+
+    // The words are taken in the channel order; a state that doesn't
+    // take one gets zeros (0x80 clears a byte of the shuffle)
+    for (int iRenorm = 0; iRenorm < 16; iRenorm++)
+    {
+        unsigned char cbWords = 0;
+        for (int c = 0; c < IC_NUM_CHANNELS; c++)
+        {
+            unsigned char* pb = &m_rgbRenorm[iRenorm][4 * c];
+            pb[0] = pb[1] = pb[2] = pb[3] = 0x80;
+            if (iRenorm & (1 << c))
+            {
+                pb[0] = cbWords;
+                pb[1] = (unsigned char)(cbWords + 1);
+                cbWords += 2;
+            }
+        }
+        m_rgcbRenorm[iRenorm] = cbWords;
+    }
+
+    // The prior favors the residuals near zero
+    memset(m_rgcPrior, 0, sizeof(m_rgcPrior));
+    for (unsigned int t = 0; t < IC_NUM_TOKENS; t++)
+    {
+        m_rgcPrior[GetTokenByte(t)] = (t < 16) ? 16u >> (t / 4) : 1;
+    }
+    unsigned short rgusFreqs[IC_NUM_TOKENS];
+    GetFrequencies(m_rgcPrior, rgusFreqs);
+    BuildTable(m_rguPriorSlots, rgusFreqs);
+
+#ifdef IC_VECTOR
+    m_bVector = HasVectorCode();
+#endif
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkCodec::~CInkCodec
+//
+// Destructor.
+//
+/////////////////////////////////////////////////////////
+CInkCodec::~CInkCodec()
+{
+    free(m_pbTokens);
+    free(m_pbBits);
+    free(m_pbWords);
+    free(m_pbBlock);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkCodec::Reserve
+//
+// Grows the encoder's buffers to their worst case sizes for
+// a block: a 16-bit word and 31 raw bits per token, and a
+// varint per stroke.
+//
+/////////////////////////////////////////////////////////
+bool CInkCodec::Reserve(unsigned int cTokens, unsigned int cStrokes)
+{
+    if (cTokens <= m_cMaxTokens && cStrokes <= m_cMaxStrokes)
+        return true;
+
+    if (cTokens < m_cMaxTokens)
+        cTokens = m_cMaxTokens;
+    if (cStrokes < m_cMaxStrokes)
+        cStrokes = m_cMaxStrokes;
+
+    size_t cbBits = (size_t)cTokens * 4 + 8;
+    size_t cbWords = (size_t)cTokens * 2 + 4 * IC_NUM_STATES * IC_NUM_CHANNELS + IC_WORDS_SLACK;
+    size_t cbBlock = sizeof(InkBlockHeader) + (size_t)cStrokes * 5 + cbWords + cbBits + 8;
+
+    unsigned char* pbTokens = (unsigned char*)realloc(m_pbTokens, cTokens);
+    if (NULL != pbTokens)
+        m_pbTokens = pbTokens;
+    unsigned char* pbBits = (unsigned char*)realloc(m_pbBits, cbBits);
+    if (NULL != pbBits)
+        m_pbBits = pbBits;
+    unsigned char* pbWords = (unsigned char*)realloc(m_pbWords, cbWords);
+    if (NULL != pbWords)
+        m_pbWords = pbWords;
+    unsigned char* pbBlock = (unsigned char*)realloc(m_pbBlock, cbBlock);
+    if (NULL != pbBlock)
+        m_pbBlock = pbBlock;
+    if (NULL == pbTokens || NULL == pbBits || NULL == pbWords || NULL == pbBlock)
+        return false;
+
+    m_cMaxTokens = cTokens;
+    m_cMaxStrokes = cStrokes;
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkCodec::EncodeBlock
+//
+// Codes a block of strokes. The residuals are tokenized in
+// the packet order, channel by channel, and counted, with
+// the models taken from the counts at the packets where the
+// decoder rebuilds them; then the tokens are range coded
+// backwards, as rANS requires, so the decoder reads
+// everything forward.
+//
+// Parameters:
+//     const InkPacket* pPackets   : [in] the packets of the strokes, in order
+//     const int* pcStrokePackets  : [in] the number of the packets of each
+//                                   stroke, at least 1
+//     int cStrokes                : [in] the number of the strokes
+//     unsigned int uChannels      : [in] IC_HAS_ flags, the channels to keep
+//     unsigned int* pcbBlock      : [out] the size of the coded block
+//
+// Return Values (const unsigned char*):
+//      the coded block, valid until the next call; NULL if out of memory
+//      or a stroke is empty
+//
+/////////////////////////////////////////////////////////
+const unsigned char* CInkCodec::EncodeBlock(
+        const InkPacket* pPackets,
+        const int* pcStrokePackets,
+        int cStrokes,
+        unsigned int uChannels,
+        unsigned int* pcbBlock
+        )
+{
+    TRACE_SCOPE("Encode ink block");
+    *pcbBlock = 0;
+
+    unsigned int cPackets = 0;
+    for (int s = 0; s < cStrokes; s++)
+    {
+        if (pcStrokePackets[s] <= 0)
+            return NULL;
+        cPackets += (unsigned int)pcStrokePackets[s];
+    }
+    if (0 == cStrokes)
+        return NULL;
+
+    int rgiChannels[IC_NUM_CHANNELS];
+    int cChannels = GetChannels(uChannels, rgiChannels);
+    unsigned int cTokens = cPackets * cChannels;
+    if (false == Reserve(cTokens, (unsigned int)cStrokes))
+        return NULL;
+
+    // The models start from the prior
+    unsigned short rgusFreqs[IC_NUM_MODELS][IC_NUM_CHANNELS][IC_NUM_TOKENS];
+    unsigned int rgiModelFirst[IC_NUM_MODELS];
+    int cModels = 1;
+    rgiModelFirst[0] = 0;
+    unsigned char rgbTokenBytes[IC_NUM_TOKENS];
+    for (unsigned int t = 0; t < IC_NUM_TOKENS; t++)
+    {
+        rgbTokenBytes[t] = (unsigned char)GetTokenByte(t);
+    }
+    for (int c = 0; c < cChannels; c++)
+    {
+        memcpy(m_rgcTokens[c], m_rgcPrior, sizeof(m_rgcPrior));
+        GetFrequencies(m_rgcTokens[c], rgusFreqs[0][c]);
+    }
+
+    // Tokenize the residuals and write the raw bits
+    unsigned int rguLast[IC_NUM_CHANNELS] = { 0 };
+    unsigned int rguBefore[IC_NUM_CHANNELS] = { 0 };
+    unsigned long long ullBits = 0;
+    int cBits = 0;
+    unsigned char* pbBits = m_pbBits;
+    unsigned int iToken = 0;
+    unsigned int iPacket = 0;
+    unsigned int iRebuild = IC_FIRST_REBUILD;
+    for (int s = 0; s < cStrokes; s++)
+    {
+        for (int i = 0; i < pcStrokePackets[s]; i++, iPacket++)
+        {
+            if (iPacket == iRebuild)
+            {
+                for (int c = 0; c < cChannels; c++)
+                {
+                    GetFrequencies(m_rgcTokens[c], rgusFreqs[cModels][c]);
+                }
+                rgiModelFirst[cModels++] = iPacket;
+                iRebuild = GetNextRebuild(iRebuild);
+            }
+
+            for (int c = 0; c < cChannels; c++)
+            {
+                // The first two packets of a stroke are predicted by the
+                // packet before, the others by the line through the two
+                unsigned int u = GetChannel(pPackets[iPacket], rgiChannels[c]);
+                unsigned int uPredicted = (i >= 2) ? 2 * rguLast[c] - rguBefore[c] : rguLast[c];
+                unsigned int r = u - uPredicted;
+                unsigned int z = (r << 1) ^ (0u - (r >> 31));
+                rguBefore[c] = rguLast[c];
+                rguLast[c] = u;
+
+                unsigned int uToken = z;
+                if (z >= IC_DIRECT_TOKENS)
+                {
+                    int cLength = GetBitLength(z);
+                    uToken = IC_DIRECT_TOKENS + cLength - 6;
+                    ullBits |= (unsigned long long)(z & ((1u << (cLength - 1)) - 1)) << cBits;
+                    cBits += cLength - 1;
+                    while (cBits >= 8)
+                    {
+                        *pbBits++ = (unsigned char)ullBits;
+                        ullBits >>= 8;
+                        cBits -= 8;
+                    }
+                }
+                m_pbTokens[iToken++] = (unsigned char)uToken;
+                m_rgcTokens[c][rgbTokenBytes[uToken]]++;
+            }
+        }
+    }
+    if (cBits > 0)
+        *pbBits++ = (unsigned char)ullBits;
+    unsigned int cbBits = (unsigned int)(pbBits - m_pbBits);
+
+    unsigned char* pb = m_pbBlock + sizeof(InkBlockHeader);
+    for (int s = 0; s < cStrokes; s++)
+    {
+        pb = PutVarint(pb, (unsigned int)pcStrokePackets[s]);
+    }
+    unsigned int cbStrokes = (unsigned int)(pb - m_pbBlock - sizeof(InkBlockHeader));
+
+    // The start of every token in the models
+    unsigned short rgusStarts[IC_NUM_MODELS][IC_NUM_CHANNELS][IC_NUM_TOKENS];
+    for (int m = 0; m < cModels; m++)
+    {
+        for (int c = 0; c < cChannels; c++)
+        {
+            unsigned int uStart = 0;
+            for (int t = 0; t < IC_NUM_TOKENS; t++)
+            {
+                rgusStarts[m][c][t] = (unsigned short)uStart;
+                uStart += rgusFreqs[m][c][t];
+            }
+        }
+    }
+
+    // Range code the tokens from the last one, each channel with
+    // IC_NUM_STATES states that the packets take in turn, into 16-bit
+    // words written backwards
+    unsigned int rgx[IC_NUM_STATES][IC_NUM_CHANNELS];
+    for (int k = 0; k < IC_NUM_STATES; k++)
+    {
+        for (int c = 0; c < IC_NUM_CHANNELS; c++)
+        {
+            rgx[k][c] = IC_RANS_LOW;
+        }
+    }
+    unsigned char* pbWordsEnd = m_pbWords + 2 * (size_t)m_cMaxTokens + 4 * IC_NUM_STATES * IC_NUM_CHANNELS;
+    unsigned char* pbWords = pbWordsEnd;
+    int iModel = cModels - 1;
+    iToken = cTokens;
+    for (unsigned int i = cPackets; i-- > 0; )
+    {
+        while (i < rgiModelFirst[iModel])
+        {
+            iModel--;
+        }
+        for (int c = cChannels - 1; c >= 0; c--)
+        {
+            iToken--;
+            unsigned int uToken = m_pbTokens[iToken];
+            unsigned int uFreq = rgusFreqs[iModel][c][uToken];
+            unsigned int& x = rgx[i % IC_NUM_STATES][c];
+            if ((unsigned long long)x >= ((unsigned long long)uFreq << (32 - IC_SCALE_BITS)))
+            {
+                *--pbWords = (unsigned char)(x >> 8);
+                *--pbWords = (unsigned char)x;
+                x >>= 16;
+            }
+            x = ((x / uFreq) << IC_SCALE_BITS) + (x % uFreq) + rgusStarts[iModel][c][uToken];
+        }
+    }
+    for (int k = IC_NUM_STATES - 1; k >= 0; k--)
+    {
+        for (int c = cChannels - 1; c >= 0; c--)
+        {
+            *--pbWords = (unsigned char)(rgx[k][c] >> 24);
+            *--pbWords = (unsigned char)(rgx[k][c] >> 16);
+            *--pbWords = (unsigned char)(rgx[k][c] >> 8);
+            *--pbWords = (unsigned char)rgx[k][c];
+        }
+    }
+    memset(pbWordsEnd, 0, IC_WORDS_SLACK);
+    unsigned int cbTokens = (unsigned int)(pbWordsEnd - pbWords) + IC_WORDS_SLACK;
+
+    memcpy(pb, pbWords, cbTokens);
+    pb += cbTokens;
+    memcpy(pb, m_pbBits, cbBits);
+    pb += cbBits;
+    while (0 != ((pb - m_pbBlock) & 7))
+    {
+        *pb++ = 0;
+    }
+
+    InkBlockHeader header;
+    header.cbBlock = (unsigned int)(pb - m_pbBlock);
+    header.cStrokes = (unsigned int)cStrokes;
+    header.cPackets = cPackets;
+    header.cbStrokes = cbStrokes;
+    header.cbTokens = cbTokens;
+    header.cbBits = cbBits;
+    header.uChannels = uChannels & (IC_HAS_TIME | IC_HAS_PRESSURE);
+    header.uCrc = 0;
+    memcpy(m_pbBlock, &header, sizeof(header));
+    header.uCrc = GetBlockCrc(m_pbBlock, header.cbBlock);
+    memcpy(m_pbBlock + offsetof(InkBlockHeader, uCrc), &header.uCrc, sizeof(header.uCrc));
+
+    *pcbBlock = header.cbBlock;
+    return m_pbBlock;
+}
+
+// Adds bytes to a CRC-32, 8 at a time with the sliced tables
+static unsigned int UpdateCrc(
+        const unsigned int (*puTables)[256],
+        unsigned int uCrc,
+        const unsigned char* pb,
+        const unsigned char* pbEnd
+        )
+{
+    for (; pbEnd - pb >= 8; pb += 8)
+    {
+        unsigned int uLow = uCrc ^ (pb[0] | (pb[1] << 8) | (pb[2] << 16) | ((unsigned int)pb[3] << 24));
+        uCrc = puTables[7][uLow & 0xFF] ^ puTables[6][(uLow >> 8) & 0xFF]
+             ^ puTables[5][(uLow >> 16) & 0xFF] ^ puTables[4][uLow >> 24]
+             ^ puTables[3][pb[4]] ^ puTables[2][pb[5]]
+             ^ puTables[1][pb[6]] ^ puTables[0][pb[7]];
+    }
+    for (; pb < pbEnd; pb++)
+    {
+        uCrc = puTables[0][(uCrc ^ *pb) & 0xFF] ^ (uCrc >> 8);
+    }
+    return uCrc;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkCodec::GetBlockCrc
+//
+// Computes the CRC-32 of a block: the header up to its
+// uCrc, then the sections and the padding after it.
+//
+/////////////////////////////////////////////////////////
+unsigned int CInkCodec::GetBlockCrc(const unsigned char* pbBlock, unsigned int cbBlock) const
+{
+    unsigned int uCrc = UpdateCrc(m_rguCrc, 0xFFFFFFFFu, pbBlock,
+                                  pbBlock + offsetof(InkBlockHeader, uCrc));
+    uCrc = UpdateCrc(m_rguCrc, uCrc, pbBlock + sizeof(InkBlockHeader), pbBlock + cbBlock);
+    return uCrc ^ 0xFFFFFFFFu;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkCodec::GetBlockHeader
+//
+// Reads the header of a block and checks that the sections
+// add up to the block and the block fits in the buffer.
+//
+// Parameters:
+//     const unsigned char* pbBlock : [in] the block
+//     unsigned int cbBlock         : [in] the bytes available from pbBlock
+//     InkBlockHeader* pHeader      : [out] the header
+//
+// Return Values (bool):
+//      true if the header is consistent, false otherwise
+//
+/////////////////////////////////////////////////////////
+bool CInkCodec::GetBlockHeader(
+        const unsigned char* pbBlock,
+        unsigned int cbBlock,
+        InkBlockHeader* pHeader
+        )
+{
+    if (cbBlock < sizeof(InkBlockHeader))
+        return false;
+    memcpy(pHeader, pbBlock, sizeof(InkBlockHeader));
+
+    unsigned long long cbSections = (unsigned long long)sizeof(InkBlockHeader)
+        + pHeader->cbStrokes + pHeader->cbTokens + pHeader->cbBits;
+    return pHeader->cbBlock <= cbBlock
+        && 0 == (pHeader->cbBlock & 7)
+        && cbSections <= pHeader->cbBlock
+        && pHeader->cbBlock - cbSections < 8
+        && pHeader->cStrokes > 0
+        && pHeader->cPackets >= pHeader->cStrokes
+        && 0 == (pHeader->uChannels & ~(unsigned int)(IC_HAS_TIME | IC_HAS_PRESSURE));
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkCodec::BuildTable
+//
+// Fills the decoding table of a channel from the frequencies
+// of its tokens: a slot per 1/IC_SCALE of probability, with
+// the frequency of the token it belongs to, the offset of
+// the slot into the token's range, and the top byte of the
+// token.
+//
+/////////////////////////////////////////////////////////
+void CInkCodec::BuildTable(unsigned int* puSlots, const unsigned short* pusFreqs)
+{
+#ifdef IC_VECTOR
+    if (m_bVector)
+    {
+        BuildTableVector(puSlots, pusFreqs);
+        return;
+    }
+#endif
+
+    // Two slots at a time, as a 64-bit pair
+    const unsigned long long ullStep = (2ull << IC_FREQ_BITS) | ((2ull << IC_FREQ_BITS) << 32);
+    unsigned int* puSlot = puSlots;
+    for (unsigned int t = 0; t < IC_NUM_TOKENS; t++)
+    {
+        unsigned int uFreq = pusFreqs[t];
+        unsigned int uSlot = (GetTokenByte(t) << 24) | uFreq;
+        unsigned long long ullPair = uSlot | ((unsigned long long)(uSlot | (1u << IC_FREQ_BITS)) << 32);
+        unsigned int k = 0;
+        for (; k + 1 < uFreq; k += 2)
+        {
+            memcpy(puSlot + k, &ullPair, sizeof(ullPair));
+            ullPair += ullStep;
+        }
+        if (k < uFreq)
+            puSlot[k] = (unsigned int)ullPair;
+        puSlot += uFreq;
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkCodec::DecodeBlock
+//
+// Decodes a block of strokes, or only its first strokes,
+// which stops the decoder after the last of them. The CRC
+// of the block is checked first, which catches any damage
+// to a few bytes, a flipped raw bit included; then the input
+// is checked as it's read, and when the whole block is
+// decoded the range coder must end in its initial states
+// with every word and bit read.
+//
+// Parameters:
+//     const unsigned char* pbBlock  : [in] the block
+//     unsigned int cbBlock          : [in] the bytes available from pbBlock
+//     InkPacket* pPackets           : [out] the packets of the strokes
+//     unsigned int cMaxPackets      : [in] the size of the pPackets array
+//     int* pcStrokePackets          : [out] the packet count of each stroke
+//                                     of the block, decoded or not
+//     unsigned int cMaxStrokes      : [in] the size of the pcStrokePackets array
+//     unsigned int cDecodeStrokes   : [in] the strokes to decode from the
+//                                     first, IC_ALL_STROKES for the block
+//
+// Return Values (bool):
+//      true if the strokes have been decoded, false if the block is
+//      damaged or the arrays are too small
+//
+/////////////////////////////////////////////////////////
+bool CInkCodec::DecodeBlock(
+        const unsigned char* pbBlock,
+        unsigned int cbBlock,
+        InkPacket* pPackets,
+        unsigned int cMaxPackets,
+        int* pcStrokePackets,
+        unsigned int cMaxStrokes,
+        unsigned int cDecodeStrokes
+        )
+{
+    TRACE_SCOPE("Decode ink block");
+
+    InkBlockHeader header;
+    if (false == GetBlockHeader(pbBlock, cbBlock, &header)
+        || header.cStrokes > cMaxStrokes
+        || header.uCrc != GetBlockCrc(pbBlock, header.cbBlock))
+        return false;
+
+    int rgiChannels[IC_NUM_CHANNELS];
+    int cChannels = GetChannels(header.uChannels, rgiChannels);
+    const unsigned char* pb = pbBlock + sizeof(InkBlockHeader);
+
+    const unsigned char* pbStrokesEnd = pb + header.cbStrokes;
+    unsigned int cPackets = 0;
+    unsigned int cDecodePackets = 0;
+    if (cDecodeStrokes > header.cStrokes)
+        cDecodeStrokes = header.cStrokes;
+    for (unsigned int s = 0; s < header.cStrokes; s++)
+    {
+        unsigned int u;
+        if (false == GetVarint(pb, pbStrokesEnd, u) || 0 == u || u > header.cPackets - cPackets)
+            return false;
+        pcStrokePackets[s] = (int)u;
+        cPackets += u;
+        if (s < cDecodeStrokes)
+            cDecodePackets = cPackets;
+    }
+    if (pb != pbStrokesEnd || cPackets != header.cPackets || cDecodePackets > cMaxPackets)
+        return false;
+
+    // The initial states, a set at a time, then the words
+    InkDecoder dec;
+    dec.pbWords = pb;
+    dec.pbWordsEnd = pb + header.cbTokens - IC_WORDS_SLACK;
+    if (header.cbTokens < 4u * IC_NUM_STATES * cChannels + IC_WORDS_SLACK || 0 != (header.cbTokens & 1))
+        return false;
+    for (int k = 0; k < IC_NUM_STATES; k++)
+    {
+        for (int c = 0; c < IC_NUM_CHANNELS; c++)
+        {
+            dec.rgx[k][c] = IC_RANS_LOW;
+        }
+        for (int c = 0; c < cChannels; c++, dec.pbWords += 4)
+        {
+            unsigned int& x = dec.rgx[k][rgiChannels[c]];
+            x = dec.pbWords[0] | (dec.pbWords[1] << 8) | (dec.pbWords[2] << 16)
+              | ((unsigned int)dec.pbWords[3] << 24);
+            if (x < IC_RANS_LOW)
+                return false;
+        }
+    }
+
+    dec.bits.pb = dec.pbWordsEnd + IC_WORDS_SLACK;
+    dec.bits.pbEnd = dec.bits.pb + header.cbBits;
+    dec.bits.ullBits = 0;
+    dec.bits.cBits = 0;
+
+    // The models start from the prior; a channel that isn't coded gets
+    // a table of a single token, the residual 0, that never changes the
+    // state
+    unsigned short rgusFreqs[IC_NUM_TOKENS];
+    memset(rgusFreqs, 0, sizeof(rgusFreqs));
+    rgusFreqs[0] = IC_SCALE;
+    for (int c = 0; c < IC_NUM_CHANNELS; c++)
+    {
+        memcpy(m_rgcTokens[c], m_rgcPrior, sizeof(m_rgcPrior));
+        if (c >= IC_CHANNEL_TIME && 0 == (header.uChannels & (1 << c)))
+            BuildTable(m_rguSlots[c], rgusFreqs);
+        else
+            memcpy(m_rguSlots[c], m_rguPriorSlots, sizeof(m_rguPriorSlots));
+    }
+
+    // Decode the residuals into the packets first, between the rebuilds
+    // of the models; the tokens are counted only up to the last one
+    unsigned int iFirst = 0;
+    unsigned int iRebuild = IC_FIRST_REBUILD;
+    while (iFirst < cDecodePackets)
+    {
+        unsigned int iEnd = (iRebuild < cDecodePackets) ? iRebuild : cDecodePackets;
+        bool bDecoded;
+#ifdef IC_VECTOR
+        if (m_bVector && iEnd < cDecodePackets)
+            bDecoded = DecodeResidualsVector<true>(m_rguSlots, m_rgcTokens, rgiChannels, cChannels,
+                                                   m_rgbRenorm, m_rgcbRenorm, dec, pPackets, iFirst, iEnd);
+        else if (m_bVector)
+            bDecoded = DecodeResidualsVector<false>(m_rguSlots, m_rgcTokens, rgiChannels, cChannels,
+                                                    m_rgbRenorm, m_rgcbRenorm, dec, pPackets, iFirst, iEnd);
+        else
+#endif
+        if (iEnd < cDecodePackets)
+            bDecoded = DecodeResiduals<true>(m_rguSlots, m_rgcTokens, rgiChannels, cChannels,
+                                             dec, pPackets, iFirst, iEnd);
+        else
+            bDecoded = DecodeResiduals<false>(m_rguSlots, m_rgcTokens, rgiChannels, cChannels,
+                                              dec, pPackets, iFirst, iEnd);
+        if (false == bDecoded)
+            return false;
+
+        iFirst = iEnd;
+        if (iFirst < cDecodePackets)
+        {
+            for (int c = 0; c < cChannels; c++)
+            {
+                GetFrequencies(m_rgcTokens[rgiChannels[c]], rgusFreqs);
+                BuildTable(m_rguSlots[rgiChannels[c]], rgusFreqs);
+            }
+            iRebuild = GetNextRebuild(iRebuild);
+        }
+    }
+    if (cDecodePackets == header.cPackets)
+    {
+        if (dec.pbWords != dec.pbWordsEnd || dec.bits.pb != dec.bits.pbEnd)
+            return false;
+        for (int k = 0; k < IC_NUM_STATES; k++)
+        {
+            for (int c = 0; c < IC_NUM_CHANNELS; c++)
+            {
+                if (IC_RANS_LOW != dec.rgx[k][c])
+                    return false;
+            }
+        }
+    }
+
+    // Then add the predictions to the residuals
+#ifdef IC_VECTOR
+    if (m_bVector)
+        AddPredictionsVector(pPackets, pcStrokePackets, cDecodeStrokes);
+    else
+#endif
+        AddPredictions(pPackets, pcStrokePackets, cDecodeStrokes);
+    return true;
+}
+
+////////////////////////////////////////////////////////
+// CInkArchiveWriter methods
+////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////
+//
+// CInkArchiveWriter::CInkArchiveWriter
+//
+// Constructor.
+//
+// Parameters:
+//     none
+//
+/////////////////////////////////////////////////////////
+CInkArchiveWriter::CInkArchiveWriter()
+    : m_pFile(NULL), m_pPackets(NULL), m_cPackets(0), m_cMaxPackets(0),
+      m_pcStrokePackets(NULL), m_cStrokes(0), m_cMaxStrokes(0),
+      m_pBlocks(NULL), m_cMaxBlocks(0)
+{
+    memset(&m_header, 0, sizeof(m_header));
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkArchiveWriter::~CInkArchiveWriter
+//
+// Destructor. Closes the archive if it's still open.
+//
+/////////////////////////////////////////////////////////
+CInkArchiveWriter::~CInkArchiveWriter()
+{
+    Close();
+    free(m_pPackets);
+    free(m_pcStrokePackets);
+    free(m_pBlocks);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkArchiveWriter::Open
+//
+// Creates an archive file and writes a header without an
+// index. Until the archive is closed, a reader finds the
+// blocks written so far by walking them.
+//
+// Parameters:
+//     const char* pszFileName : [in] the archive file name
+//     unsigned int uChannels  : [in] IC_HAS_ flags, the channels besides
+//                               x and y to keep
+//
+// Return Values (bool):
+//      true if succeeded, false otherwise
+//
+/////////////////////////////////////////////////////////
+bool CInkArchiveWriter::Open(const char* pszFileName, unsigned int uChannels)
+{
+    Close();
+
+    memset(&m_header, 0, sizeof(m_header));
+    memcpy(m_header.szMagic, IC_MAGIC, sizeof(m_header.szMagic));
+    m_header.uVersion = IC_VERSION;
+    m_header.uByteOrder = IC_BYTE_ORDER;
+    m_header.cbHeader = sizeof(InkArchiveHeader);
+    m_header.uChannels = uChannels & (IC_HAS_TIME | IC_HAS_PRESSURE);
+    m_header.cbFile = sizeof(InkArchiveHeader);
+
+    m_pFile = fopen(pszFileName, "wb");
+    if (NULL == m_pFile)
+        return false;
+    if (1 != fwrite(&m_header, sizeof(m_header), 1, m_pFile))
+    {
+        fclose(m_pFile);
+        m_pFile = NULL;
+        return false;
+    }
+
+    m_cPackets = 0;
+    m_cStrokes = 0;
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkArchiveWriter::AddStroke
+//
+// Adds a stroke to the open block, and writes the block
+// first if the stroke would overflow it. A stroke never
+// spans two blocks.
+//
+// Parameters:
+//     const InkPacket* pPackets : [in] the packets of the stroke
+//     int cPackets              : [in] the number of the packets, at least 1
+//
+// Return Values (bool):
+//      true if succeeded, false otherwise
+//
+/////////////////////////////////////////////////////////
+bool CInkArchiveWriter::AddStroke(const InkPacket* pPackets, int cPackets)
+{
+    if (NULL == m_pFile || cPackets <= 0)
+        return false;
+
+    if (m_cPackets > 0 && m_cPackets + cPackets > IC_BLOCK_PACKETS)
+    {
+        if (false == FlushBlock())
+            return false;
+    }
+
+    if (m_cPackets + cPackets > m_cMaxPackets)
+    {
+        int cNewMax = (m_cPackets + cPackets > IC_BLOCK_PACKETS) ? m_cPackets + cPackets : IC_BLOCK_PACKETS;
+        InkPacket* pNew = (InkPacket*)realloc(m_pPackets, cNewMax * sizeof(InkPacket));
+        if (NULL == pNew)
+            return false;
+        m_pPackets = pNew;
+        m_cMaxPackets = cNewMax;
+    }
+    if (m_cStrokes == m_cMaxStrokes)
+    {
+        int cNewMax = m_cMaxStrokes ? 2 * m_cMaxStrokes : 256;
+        int* pNew = (int*)realloc(m_pcStrokePackets, cNewMax * sizeof(int));
+        if (NULL == pNew)
+            return false;
+        m_pcStrokePackets = pNew;
+        m_cMaxStrokes = cNewMax;
+    }
+
+    memcpy(m_pPackets + m_cPackets, pPackets, cPackets * sizeof(InkPacket));
+    m_cPackets += cPackets;
+    m_pcStrokePackets[m_cStrokes++] = cPackets;
+
+    if (m_cPackets >= IC_BLOCK_PACKETS)
+        return FlushBlock();
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkArchiveWriter::FlushBlock
+//
+// Codes the open block, appends it to the file and to the
+// index.
+//
+/////////////////////////////////////////////////////////
+bool CInkArchiveWriter::FlushBlock()
+{
+    if (0 == m_cStrokes)
+        return true;
+
+    if (m_header.cBlocks == m_cMaxBlocks)
+    {
+        unsigned int cNewMax = m_cMaxBlocks ? 2 * m_cMaxBlocks : 64;
+        InkBlockEntry* pNew = (InkBlockEntry*)realloc(m_pBlocks, cNewMax * sizeof(InkBlockEntry));
+        if (NULL == pNew)
+            return false;
+        m_pBlocks = pNew;
+        m_cMaxBlocks = cNewMax;
+    }
+
+    unsigned int cbBlock;
+    const unsigned char* pbBlock = m_codec.EncodeBlock(m_pPackets, m_pcStrokePackets, m_cStrokes,
+                                                       m_header.uChannels, &cbBlock);
+    if (NULL == pbBlock || 1 != fwrite(pbBlock, cbBlock, 1, m_pFile))
+        return false;
+
+    InkBlockEntry& entry = m_pBlocks[m_header.cBlocks++];
+    entry.ullOffset = m_header.cbFile;
+    entry.iFirstStroke = m_header.cStrokes;
+    entry.cStrokes = (unsigned int)m_cStrokes;
+
+    m_header.cbFile += cbBlock;
+    m_header.cStrokes += (unsigned int)m_cStrokes;
+    m_header.cPackets += (unsigned int)m_cPackets;
+    m_cStrokes = 0;
+    m_cPackets = 0;
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkArchiveWriter::Close
+//
+// Writes the open block, the index and the final header,
+// and closes the file.
+//
+// Parameters:
+//     none
+//
+// Return Values (bool):
+//      true if the archive is complete, false otherwise
+//
+/////////////////////////////////////////////////////////
+bool CInkArchiveWriter::Close()
+{
+    if (NULL == m_pFile)
+        return false;
+
+    bool bOk = FlushBlock();
+    if (bOk)
+    {
+        size_t cbIndex = m_header.cBlocks * sizeof(InkBlockEntry);
+        m_header.ullIndexOffset = m_header.cbFile;
+        bOk = (0 == cbIndex || 1 == fwrite(m_pBlocks, cbIndex, 1, m_pFile));
+        m_header.cbFile += cbIndex;
+    }
+    if (bOk)
+    {
+        bOk = (0 == fseek(m_pFile, 0, SEEK_SET))
+            && (1 == fwrite(&m_header, sizeof(m_header), 1, m_pFile));
+    }
+    if (0 != fclose(m_pFile))
+        bOk = false;
+
+    m_pFile = NULL;
+    m_cStrokes = 0;
+    m_cPackets = 0;
+    return bOk;
+}
+
+////////////////////////////////////////////////////////
+// CInkArchiveReader methods
+////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////
+//
+// CInkArchiveReader::CInkArchiveReader
+//
+// Constructor.
+//
+// Parameters:
+//     none
+//
+/////////////////////////////////////////////////////////
+CInkArchiveReader::CInkArchiveReader() : m_pbView(NULL), m_cbView(0)
+#ifdef _WIN32
+    , m_hFile(INVALID_HANDLE_VALUE), m_hMapping(NULL)
+#else
+    , m_fd(-1)
+#endif
+    , m_pBlocks(NULL), m_pRecovered(NULL), m_cBlocks(0), m_cStrokes(0)
+{
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkArchiveReader::~CInkArchiveReader
+//
+// Destructor.
+//
+/////////////////////////////////////////////////////////
+CInkArchiveReader::~CInkArchiveReader()
+{
+    Close();
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkArchiveReader::Open
+//
+// Maps an archive file into memory read-only and validates
+// its header and index. An archive without an index, one
+// whose writer didn't close it, is indexed by walking its
+// blocks up to the first damaged one.
+//
+// Parameters:
+//     const char* pszFileName : [in] the archive file name
+//
+// Return Values (bool):
+//      true if the archive has been mapped, false otherwise
+//
+/////////////////////////////////////////////////////////
+bool CInkArchiveReader::Open(const char* pszFileName)
+{
+    Close();
+
+#ifdef _WIN32
+    m_hFile = ::CreateFileA(pszFileName, GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (INVALID_HANDLE_VALUE == m_hFile)
+        return false;
+
+    LARGE_INTEGER liSize;
+    if (FALSE == ::GetFileSizeEx(m_hFile, &liSize) || liSize.QuadPart < (LONGLONG)sizeof(InkArchiveHeader))
+    {
+        Close();
+        return false;
+    }
+    m_cbView = (unsigned long long)liSize.QuadPart;
+
+    m_hMapping = ::CreateFileMappingA(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (NULL == m_hMapping)
+    {
+        Close();
+        return false;
+    }
+    m_pbView = (const unsigned char*)::MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+#else
+    m_fd = open(pszFileName, O_RDONLY);
+    if (m_fd < 0)
+        return false;
+
+    struct stat st;
+    if (0 != fstat(m_fd, &st) || st.st_size < (off_t)sizeof(InkArchiveHeader))
+    {
+        Close();
+        return false;
+    }
+    m_cbView = (unsigned long long)st.st_size;
+
+    void* pv = mmap(NULL, (size_t)m_cbView, PROT_READ, MAP_SHARED, m_fd, 0);
+    m_pbView = (MAP_FAILED == pv) ? NULL : (const unsigned char*)pv;
+#endif
+
+    if (NULL == m_pbView || false == Validate())
+    {
+        Close();
+        return false;
+    }
+
+    const InkArchiveHeader* pHeader = GetHeader();
+    if (0 == pHeader->ullIndexOffset)
+    {
+        if (false == RecoverIndex())
+        {
+            Close();
+            return false;
+        }
+    }
+    else
+    {
+        m_pBlocks = (const InkBlockEntry*)(m_pbView + pHeader->ullIndexOffset);
+        m_cBlocks = pHeader->cBlocks;
+        m_cStrokes = pHeader->cStrokes;
+    }
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkArchiveReader::Close
+//
+// Unmaps the archive file.
+//
+// Parameters:
+//     none
+//
+// Return Values (void):
+//      none
+//
+/////////////////////////////////////////////////////////
+void CInkArchiveReader::Close()
+{
+#ifdef _WIN32
+    if (NULL != m_pbView)
+        ::UnmapViewOfFile(m_pbView);
+    if (NULL != m_hMapping)
+        ::CloseHandle(m_hMapping);
+    if (INVALID_HANDLE_VALUE != m_hFile)
+        ::CloseHandle(m_hFile);
+    m_hMapping = NULL;
+    m_hFile = INVALID_HANDLE_VALUE;
+#else
+    if (NULL != m_pbView)
+        munmap((void*)m_pbView, (size_t)m_cbView);
+    if (m_fd >= 0)
+        close(m_fd);
+    m_fd = -1;
+#endif
+    m_pbView = NULL;
+    m_cbView = 0;
+    free(m_pRecovered);
+    m_pRecovered = NULL;
+    m_pBlocks = NULL;
+    m_cBlocks = 0;
+    m_cStrokes = 0;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkArchiveReader::Validate
+//
+// Checks that the mapped file is an archive of a known
+// version, and that its index lies within the file and
+// covers the strokes in order. The blocks themselves are
+// checked as they're decoded.
+//
+/////////////////////////////////////////////////////////
+bool CInkArchiveReader::Validate() const
+{
+    const InkArchiveHeader* pHeader = GetHeader();
+
+    if (0 != memcmp(pHeader->szMagic, IC_MAGIC, sizeof(pHeader->szMagic))
+        || IC_VERSION != pHeader->uVersion
+        || IC_BYTE_ORDER != pHeader->uByteOrder
+        || sizeof(InkArchiveHeader) != pHeader->cbHeader
+        || 0 != (pHeader->uChannels & ~(unsigned int)(IC_HAS_TIME | IC_HAS_PRESSURE)))
+    {
+        return false;
+    }
+    if (0 == pHeader->ullIndexOffset)
+        return true;
+
+    if (m_cbView != pHeader->cbFile
+        || 0 != (pHeader->ullIndexOffset & 7)
+        || pHeader->ullIndexOffset < sizeof(InkArchiveHeader)
+        || pHeader->ullIndexOffset > m_cbView
+        || (unsigned long long)pHeader->cBlocks * sizeof(InkBlockEntry) != m_cbView - pHeader->ullIndexOffset)
+    {
+        return false;
+    }
+
+    const InkBlockEntry* pBlocks = (const InkBlockEntry*)(m_pbView + pHeader->ullIndexOffset);
+    unsigned int iStroke = 0;
+    for (unsigned int i = 0; i < pHeader->cBlocks; i++)
+    {
+        if (pBlocks[i].iFirstStroke != iStroke
+            || 0 == pBlocks[i].cStrokes
+            || 0 != (pBlocks[i].ullOffset & 7)
+            || pBlocks[i].ullOffset < sizeof(InkArchiveHeader)
+            || pBlocks[i].ullOffset >= pHeader->ullIndexOffset)
+        {
+            return false;
+        }
+        iStroke += pBlocks[i].cStrokes;
+    }
+    return (iStroke == pHeader->cStrokes);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkArchiveReader::RecoverIndex
+//
+// Builds the index of an archive that wasn't closed from the
+// headers of its blocks, which follow each other from the
+// end of the file header. The walk stops at the end of the
+// file or at the first block that's cut short or damaged.
+//
+/////////////////////////////////////////////////////////
+bool CInkArchiveReader::RecoverIndex()
+{
+    unsigned int cMaxBlocks = 0;
+    unsigned long long ullOffset = sizeof(InkArchiveHeader);
+    for (;;)
+    {
+        unsigned long long cbLeft = m_cbView - ullOffset;
+        InkBlockHeader header;
+        if (false == CInkCodec::GetBlockHeader(m_pbView + ullOffset,
+                                               (cbLeft > 0xFFFFFFFFull) ? 0xFFFFFFFFu : (unsigned int)cbLeft,
+                                               &header)
+            || header.uChannels != GetHeader()->uChannels)
+            break;
+
+        if (m_cBlocks == cMaxBlocks)
+        {
+            cMaxBlocks = cMaxBlocks ? 2 * cMaxBlocks : 64;
+            InkBlockEntry* pNew = (InkBlockEntry*)realloc(m_pRecovered, cMaxBlocks * sizeof(InkBlockEntry));
+            if (NULL == pNew)
+                return false;
+            m_pRecovered = pNew;
+        }
+        InkBlockEntry& entry = m_pRecovered[m_cBlocks++];
+        entry.ullOffset = ullOffset;
+        entry.iFirstStroke = m_cStrokes;
+        entry.cStrokes = header.cStrokes;
+        m_cStrokes += header.cStrokes;
+        ullOffset += header.cbBlock;
+    }
+
+    m_pBlocks = m_pRecovered;
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkArchiveReader::FindBlock
+//
+// Return Values (unsigned int):
+//      the block of a stroke, by a binary search of the index;
+//      the block count if the stroke isn't in the archive
+//
+/////////////////////////////////////////////////////////
+unsigned int CInkArchiveReader::FindBlock(unsigned int iStroke) const
+{
+    if (iStroke >= m_cStrokes)
+        return m_cBlocks;
+
+    unsigned int iLow = 0;
+    unsigned int iHigh = m_cBlocks;
+    while (iHigh - iLow > 1)
+    {
+        unsigned int iMid = iLow + (iHigh - iLow) / 2;
+        if (m_pBlocks[iMid].iFirstStroke <= iStroke)
+            iLow = iMid;
+        else
+            iHigh = iMid;
+    }
+    return iLow;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkArchiveReader::GetBlockSize
+//
+// Reads the packet count of a block from its header, so the
+// caller can size the buffers for DecodeBlock.
+//
+// Parameters:
+//     unsigned int iBlock       : [in] the block
+//     unsigned int* pcPackets   : [out] the number of its packets
+//
+// Return Values (bool):
+//      true if succeeded, false if the block is damaged
+//
+/////////////////////////////////////////////////////////
+bool CInkArchiveReader::GetBlockSize(unsigned int iBlock, unsigned int* pcPackets) const
+{
+    if (iBlock >= m_cBlocks || m_pBlocks[iBlock].ullOffset >= m_cbView)
+        return false;
+
+    unsigned long long cbLeft = m_cbView - m_pBlocks[iBlock].ullOffset;
+    InkBlockHeader header;
+    if (false == CInkCodec::GetBlockHeader(m_pbView + m_pBlocks[iBlock].ullOffset,
+                                           (cbLeft > 0xFFFFFFFFull) ? 0xFFFFFFFFu : (unsigned int)cbLeft,
+                                           &header)
+        || header.cStrokes != m_pBlocks[iBlock].cStrokes)
+        return false;
+
+    *pcPackets = header.cPackets;
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkArchiveReader::DecodeBlock
+//
+// Decodes a block of the archive, or its strokes up to one,
+// so reading a stroke stops at its end.
+//
+// Parameters:
+//     unsigned int iBlock           : [in] the block
+//     InkPacket* pPackets           : [out] the packets of its strokes
+//     unsigned int cMaxPackets      : [in] the size of the pPackets array
+//     int* pcStrokePackets          : [out] the packet count of each stroke
+//     unsigned int cMaxStrokes      : [in] the size of the pcStrokePackets array
+//     unsigned int cDecodeStrokes   : [in] the strokes to decode from the
+//                                     first of the block, IC_ALL_STROKES
+//                                     for the block
+//
+// Return Values (bool):
+//      true if succeeded, false if the block is damaged or the arrays
+//      are too small
+//
+/////////////////////////////////////////////////////////
+bool CInkArchiveReader::DecodeBlock(
+        unsigned int iBlock,
+        InkPacket* pPackets,
+        unsigned int cMaxPackets,
+        int* pcStrokePackets,
+        unsigned int cMaxStrokes,
+        unsigned int cDecodeStrokes
+        )
+{
+    if (iBlock >= m_cBlocks || m_pBlocks[iBlock].ullOffset >= m_cbView)
+        return false;
+
+    const InkArchiveHeader* pHeader = GetHeader();
+    unsigned long long cbLeft = m_cbView - m_pBlocks[iBlock].ullOffset;
+    const unsigned char* pbBlock = m_pbView + m_pBlocks[iBlock].ullOffset;
+    InkBlockHeader header;
+    if (false == CInkCodec::GetBlockHeader(pbBlock,
+                                           (cbLeft > 0xFFFFFFFFull) ? 0xFFFFFFFFu : (unsigned int)cbLeft,
+                                           &header)
+        || header.cStrokes != m_pBlocks[iBlock].cStrokes
+        || header.uChannels != pHeader->uChannels)
+        return false;
+
+    return m_codec.DecodeBlock(pbBlock, header.cbBlock, pPackets, cMaxPackets,
+                               pcStrokePackets, cMaxStrokes, cDecodeStrokes);
+}
@@ -0,0 +1,307 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      InkCodec.h
+//
+// Description:
+//      This file contains the layout of the ink archive file and the
+//      definitions of the CInkCodec, CInkArchiveWriter and
+//      CInkArchiveReader classes. An archive keeps the packets of the
+//      strokes, losslessly, in a few bits per packet:
+//
+//      - every channel of a packet (x, y, time, pressure) is predicted
+//        from the two packets before it, a second order delta, so a pen
+//        moving at a steady pace leaves residuals around zero;
+//      - a residual is zigzag mapped to an unsigned value and split into
+//        a token, the value itself below IC_DIRECT_TOKENS and its bit
+//        length above, and the raw low bits of the long ones;
+//      - the tokens are entropy coded with a range coder (rANS) whose
+//        model of each channel adapts: it starts from a fixed prior and
+//        is rebuilt from the counts of the tokens decoded so far after
+//        IC_FIRST_REBUILD packets, then after four times as many, up to
+//        the last rebuild, so no model is stored;
+//      - every channel has IC_NUM_STATES states, that the packets take
+//        in turn, interleaved in one stream, so the decoder works on the
+//        four channels of a packet at once and on a packet of each set
+//        of states in flight;
+//      - the strokes are framed into blocks of about IC_BLOCK_PACKETS
+//        packets that are coded independently, so a stroke is decoded
+//        from its block alone, and only up to its end, damage to a
+//        block loses only its strokes, and the blocks are decoded as
+//        they're read, in one pass;
+//      - every block carries a CRC-32 of its bytes, checked before it's
+//        decoded, so a damaged block is refused rather than decoded into
+//        wrong packets.
+//
+//      The methods of the classes are defined in the InkCodec.cpp file.
+//--------------------------------------------------------------------------
+
+#pragma once
+
+#include <stdio.h>
+
+#define IC_MAGIC            "INKCODEC"
+#define IC_VERSION          3           // 2 added the CRC of the blocks, 3 the adaptive models
+#define IC_BYTE_ORDER       0x01020304  // reads differently on a foreign byte order
+#define IC_BLOCK_PACKETS    4096        // a block is closed past this many packets
+#define IC_DIRECT_TOKENS    32          // the residuals below are their own tokens
+#define IC_NUM_TOKENS       (IC_DIRECT_TOKENS + 27)  // and a token per bit length up to 32
+#define IC_SCALE_BITS       10          // the model frequencies add up to 1 << IC_SCALE_BITS
+#define IC_FIRST_REBUILD    128         // the models are rebuilt after this many packets,
+#define IC_LAST_REBUILD     512         // then after 4 times as many, up to this many
+#define IC_NUM_CHANNELS     4
+#define IC_NUM_STATES       8           // the states of a channel, a packet takes the next in turn
+#define IC_ALL_STROKES      0xFFFFFFFFu // decodes every stroke of a block
+
+// The channels of a packet; x and y are always there
+enum {
+    IC_CHANNEL_X = 0,
+    IC_CHANNEL_Y,
+    IC_CHANNEL_TIME,
+    IC_CHANNEL_PRESSURE
+};
+#define IC_HAS_TIME         (1 << IC_CHANNEL_TIME)
+#define IC_HAS_PRESSURE     (1 << IC_CHANNEL_PRESSURE)
+
+// A packet. The channels an archive doesn't have decode as 0. The
+// fields are in the channel order, and all 32-bit: the decoder works
+// on a packet as four unsigned ints.
+struct InkPacket
+{
+    int             x;              // in ink units
+    int             y;
+    unsigned int    uTime;          // in milliseconds, wraps around
+    int             iPressure;
+};
+
+// The file header. All the offsets are from the beginning of the file.
+// The blocks follow the header back to back, and the block index
+// follows the last block. An archive that hasn't been closed has no
+// index (ullIndexOffset is 0); its blocks are found by walking them.
+struct InkArchiveHeader
+{
+    char                szMagic[8];     // IC_MAGIC, not zero terminated
+    unsigned int        uVersion;       // IC_VERSION
+    unsigned int        uByteOrder;     // IC_BYTE_ORDER
+    unsigned int        cbHeader;       // sizeof(InkArchiveHeader)
+    unsigned int        uChannels;      // IC_HAS_ flags
+    unsigned int        cBlocks;
+    unsigned int        cStrokes;
+    unsigned long long  cPackets;
+    unsigned long long  ullIndexOffset; // InkBlockEntry[cBlocks]
+    unsigned long long  cbFile;         // the total size of the file
+};
+
+// The header of a block. The packet counts of the strokes, the range
+// coded tokens and the raw bits follow it, in that order, and the block
+// is padded to 8 bytes.
+struct InkBlockHeader
+{
+    unsigned int        cbBlock;        // including this header
+    unsigned int        cStrokes;
+    unsigned int        cPackets;
+    unsigned int        cbStrokes;      // a varint per stroke
+    unsigned int        cbTokens;       // the initial states, then 16-bit words
+    unsigned int        cbBits;
+    unsigned int        uChannels;      // IC_HAS_ flags, as in the archive header
+    unsigned int        uCrc;           // CRC-32 of the block, all but this field
+};
+
+// An entry of the block index
+struct InkBlockEntry
+{
+    unsigned long long  ullOffset;      // of the block header
+    unsigned int        iFirstStroke;
+    unsigned int        cStrokes;
+};
+
+/////////////////////////////////////////////////////////
+//
+// class CInkCodec
+//
+// Encodes and decodes a block of strokes in memory. The
+// scratch buffers and the decoding tables are kept, so a
+// codec isn't shared between threads.
+//
+/////////////////////////////////////////////////////////
+
+class CInkCodec
+{
+    // The encoder's tokens, its raw bits and range coded words, and
+    // the coded block
+    unsigned char*      m_pbTokens;
+    unsigned char*      m_pbBits;
+    unsigned char*      m_pbWords;
+    unsigned char*      m_pbBlock;
+    unsigned int        m_cMaxTokens;
+    unsigned int        m_cMaxStrokes;
+
+    // The decoding table of each channel, per slot: the frequency
+    // of its token, the offset of the slot into the token's range,
+    // and in the top byte the residual of a direct token or the
+    // bit length of a long one
+    unsigned int        m_rguSlots[IC_NUM_CHANNELS][1 << IC_SCALE_BITS];
+
+    // The counts of the tokens of each channel, by the top byte of
+    // their slots, that the models are rebuilt from; and the prior
+    // they start from, with its decoding table
+    unsigned int        m_rgcTokens[IC_NUM_CHANNELS][256];
+    unsigned int        m_rgcPrior[256];
+    unsigned int        m_rguPriorSlots[1 << IC_SCALE_BITS];
+
+    // The CRC-32 tables, sliced by 8: the CRC of every byte
+    // value, then of it followed by 1 to 7 zero bytes
+    unsigned int        m_rguCrc[8][256];
+
+    // For each set of the states that take a word, the shuffle that
+    // moves the words to their states, then the bytes the words take
+    unsigned char       m_rgbRenorm[16][16];
+    unsigned char       m_rgcbRenorm[16];
+
+    // Whether the four channels of a packet are decoded at once
+    bool                m_bVector;
+
+public:
+
+    // Constructor and destructor
+    CInkCodec();
+    ~CInkCodec();
+
+    const unsigned char* EncodeBlock(const InkPacket* pPackets, const int* pcStrokePackets,
+                                     int cStrokes, unsigned int uChannels, unsigned int* pcbBlock);
+    bool DecodeBlock(const unsigned char* pbBlock, unsigned int cbBlock,
+                     InkPacket* pPackets, unsigned int cMaxPackets,
+                     int* pcStrokePackets, unsigned int cMaxStrokes,
+                     unsigned int cDecodeStrokes = IC_ALL_STROKES);
+
+    static bool GetBlockHeader(const unsigned char* pbBlock, unsigned int cbBlock,
+                               InkBlockHeader* pHeader);
+
+private:
+
+    bool Reserve(unsigned int cTokens, unsigned int cStrokes);
+    void BuildTable(unsigned int* puSlots, const unsigned short* pusFreqs);
+    unsigned int GetBlockCrc(const unsigned char* pbBlock, unsigned int cbBlock) const;
+
+    // Not copyable
+    CInkCodec(const CInkCodec&);
+    CInkCodec& operator=(const CInkCodec&);
+};
+
+/////////////////////////////////////////////////////////
+//
+// class CInkArchiveWriter
+//
+// Appends the strokes to an archive file. The strokes are
+// held until a block is full, then the block is coded and
+// written; Close writes the last block, the index and the
+// final header.
+//
+/////////////////////////////////////////////////////////
+
+class CInkArchiveWriter
+{
+    FILE*               m_pFile;
+    InkArchiveHeader    m_header;
+    CInkCodec           m_codec;
+
+    // The strokes of the open block
+    InkPacket*          m_pPackets;
+    int                 m_cPackets;
+    int                 m_cMaxPackets;
+    int*                m_pcStrokePackets;
+    int                 m_cStrokes;
+    int                 m_cMaxStrokes;
+
+    // The index of the written blocks
+    InkBlockEntry*      m_pBlocks;
+    unsigned int        m_cMaxBlocks;
+
+public:
+
+    // Constructor and destructor
+    CInkArchiveWriter();
+    ~CInkArchiveWriter();
+
+    bool Open(const char* pszFileName, unsigned int uChannels);
+    bool AddStroke(const InkPacket* pPackets, int cPackets);
+    bool Close();
+    bool IsOpen() const { return (NULL != m_pFile); }
+
+    // Data members access methods
+    unsigned int GetChannels() const { return m_header.uChannels; }
+    const InkArchiveHeader& GetHeader() const { return m_header; }
+
+private:
+
+    bool FlushBlock();
+
+    // Not copyable
+    CInkArchiveWriter(const CInkArchiveWriter&);
+    CInkArchiveWriter& operator=(const CInkArchiveWriter&);
+};
+
+/////////////////////////////////////////////////////////
+//
+// class CInkArchiveReader
+//
+// A read-only mapping of an archive file. The blocks are
+// decoded on demand, from the index, so reading a stroke
+// pages in only its block.
+//
+/////////////////////////////////////////////////////////
+
+class CInkArchiveReader
+{
+    const unsigned char*    m_pbView;   // the mapped file
+    unsigned long long      m_cbView;
+#ifdef _WIN32
+    void*                   m_hFile;
+    void*                   m_hMapping;
+#else
+    int                     m_fd;
+#endif
+
+    const InkBlockEntry*    m_pBlocks;
+    InkBlockEntry*          m_pRecovered;   // the index of an archive that wasn't closed
+    unsigned int            m_cBlocks;
+    unsigned int            m_cStrokes;
+    CInkCodec               m_codec;
+
+public:
+
+    // Constructor and destructor
+    CInkArchiveReader();
+    ~CInkArchiveReader();
+
+    bool Open(const char* pszFileName);
+    void Close();
+    bool IsOpen() const { return (NULL != m_pbView); }
+
+    const InkArchiveHeader* GetHeader() const
+        { return (const InkArchiveHeader*)m_pbView; }
+    unsigned int GetBlockCount() const { return m_cBlocks; }
+    unsigned int GetStrokeCount() const { return m_cStrokes; }
+    const InkBlockEntry& GetBlock(unsigned int iBlock) const { return m_pBlocks[iBlock]; }
+    bool IsRecovered() const { return (0 == GetHeader()->ullIndexOffset); }
+
+    unsigned int FindBlock(unsigned int iStroke) const;
+    bool GetBlockSize(unsigned int iBlock, unsigned int* pcPackets) const;
+    bool DecodeBlock(unsigned int iBlock, InkPacket* pPackets, unsigned int cMaxPackets,
+                     int* pcStrokePackets, unsigned int cMaxStrokes,
+                     unsigned int cDecodeStrokes = IC_ALL_STROKES);
+
+private:
+
+    bool Validate() const;
+    bool RecoverIndex();
+
+    // Not copyable
+    CInkArchiveReader(const CInkArchiveReader&);
+    CInkArchiveReader& operator=(const CInkArchiveReader&);
+};
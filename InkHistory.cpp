@@ -0,0 +1,532 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      InkHistory.cpp
+//
+// Description:
+//      The file contains the definitions of the methods of the classes
+//      CStrokeVector and CInkHistory, and of the HistoryStroke structure.
+//      See the file InkHistory.h for the definitions of the classes.
+//--------------------------------------------------------------------------
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "InkHistory.h"
+
+#define IH_MASK             (IH_BRANCH - 1)
+#define IH_INITIAL_VERSIONS 64
+
+// A node of the trie. Above the leaves the children are nodes, at the
+// leaves they're strokes; the used children are the first cChildren.
+struct HistoryNode
+{
+    volatile long   lRefs;
+    int             cChildren;
+    void*           rgpChildren[IH_BRANCH];
+};
+
+// The nodes of all the vectors
+static volatile long gs_cLiveNodes = 0;
+
+// Atomically increments or decrements a reference count, returns the
+// new value
+static inline long HistoryIncrement(volatile long* pl)
+{
+#ifdef _WIN32
+    return ::InterlockedIncrement(pl);
+#else
+    return __sync_add_and_fetch(pl, 1);
+#endif
+}
+
+static inline long HistoryDecrement(volatile long* pl)
+{
+#ifdef _WIN32
+    return ::InterlockedDecrement(pl);
+#else
+    return __sync_sub_and_fetch(pl, 1);
+#endif
+}
+
+////////////////////////////////////////////////////////
+// HistoryStroke methods
+////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////
+//
+// HistoryStroke::Create
+//
+// Makes a stroke with one reference, the caller's.
+//
+// Parameters:
+//     const int* piInkPoints  : [in] the x, y pairs of the ink points
+//     int cInkPoints          : [in] the number of the pairs
+//     const GesturePoint* ppt : [in] the decimated points
+//     int cPoints             : [in] the number of the decimated points
+//
+// Return Values (HistoryStroke*):
+//      the stroke, NULL if out of memory
+//
+/////////////////////////////////////////////////////////
+HistoryStroke* HistoryStroke::Create(
+        const int* piInkPoints,
+        int cInkPoints,
+        const GesturePoint* ppt,
+        int cPoints
+        )
+{
+    HistoryStroke* pStroke = (HistoryStroke*)malloc(sizeof(HistoryStroke)
+                                                    + 2 * cInkPoints * sizeof(int)
+                                                    + cPoints * sizeof(GesturePoint));
+    if (NULL == pStroke)
+        return NULL;
+
+    pStroke->lRefs = 1;
+    pStroke->cInkPoints = cInkPoints;
+    pStroke->cPoints = cPoints;
+    memcpy((int*)pStroke->GetInkPoints(), piInkPoints, 2 * cInkPoints * sizeof(int));
+    memcpy((GesturePoint*)pStroke->GetPoints(), ppt, cPoints * sizeof(GesturePoint));
+    return pStroke;
+}
+
+void HistoryStroke::AddRef(const HistoryStroke* pStroke)
+{
+    HistoryIncrement(&((HistoryStroke*)pStroke)->lRefs);
+}
+
+void HistoryStroke::Release(const HistoryStroke* pStroke)
+{
+    if (NULL != pStroke && 0 == HistoryDecrement(&((HistoryStroke*)pStroke)->lRefs))
+        free((HistoryStroke*)pStroke);
+}
+
+////////////////////////////////////////////////////////
+// The nodes
+////////////////////////////////////////////////////////
+
+static HistoryNode* NewNode()
+{
+    HistoryNode* pNode = (HistoryNode*)malloc(sizeof(HistoryNode));
+    if (NULL != pNode)
+    {
+        pNode->lRefs = 1;
+        pNode->cChildren = 0;
+        HistoryIncrement(&gs_cLiveNodes);
+    }
+    return pNode;
+}
+
+/////////////////////////////////////////////////////////
+//
+// ReleaseNode
+//
+// Drops a reference to a node, and frees it and drops its
+// references to its children if it was the last one.
+//
+// Parameters:
+//     HistoryNode* pNode : [in] the node, may be NULL
+//     int nShift         : [in] IH_BITS times the levels below the node
+//
+/////////////////////////////////////////////////////////
+static void ReleaseNode(HistoryNode* pNode, int nShift)
+{
+    if (NULL == pNode || 0 != HistoryDecrement(&pNode->lRefs))
+        return;
+
+    for (int i = 0; i < pNode->cChildren; i++)
+    {
+        if (0 == nShift)
+            HistoryStroke::Release((const HistoryStroke*)pNode->rgpChildren[i]);
+        else
+            ReleaseNode((HistoryNode*)pNode->rgpChildren[i], nShift - IH_BITS);
+    }
+    free(pNode);
+    HistoryDecrement(&gs_cLiveNodes);
+}
+
+// Copies a node, with a reference to every child
+static HistoryNode* CopyNode(const HistoryNode* pNode, int nShift)
+{
+    HistoryNode* pCopy = NewNode();
+    if (NULL == pCopy)
+        return NULL;
+
+    pCopy->cChildren = pNode->cChildren;
+    memcpy(pCopy->rgpChildren, pNode->rgpChildren, pNode->cChildren * sizeof(void*));
+    for (int i = 0; i < pNode->cChildren; i++)
+    {
+        if (0 == nShift)
+            HistoryStroke::AddRef((const HistoryStroke*)pNode->rgpChildren[i]);
+        else
+            HistoryIncrement(&((HistoryNode*)pNode->rgpChildren[i])->lRefs);
+    }
+    return pCopy;
+}
+
+// Makes a path of nodes with one child each, down to the stroke
+static HistoryNode* NewPath(int nShift, const HistoryStroke* pStroke)
+{
+    HistoryNode* pNode = NewNode();
+    if (NULL == pNode)
+        return NULL;
+
+    void* pChild;
+    if (0 == nShift)
+    {
+        HistoryStroke::AddRef(pStroke);
+        pChild = (void*)pStroke;
+    }
+    else
+    {
+        pChild = NewPath(nShift - IH_BITS, pStroke);
+        if (NULL == pChild)
+        {
+            ReleaseNode(pNode, nShift);
+            return NULL;
+        }
+    }
+    pNode->rgpChildren[0] = pChild;
+    pNode->cChildren = 1;
+    return pNode;
+}
+
+/////////////////////////////////////////////////////////
+//
+// AppendToNode
+//
+// Copies the path from a node to the place of a new last
+// stroke, and puts the stroke there. The nodes off the
+// path are shared with the original.
+//
+// Parameters:
+//     const HistoryNode* pNode      : [in] the node, not full
+//     int nShift                    : [in] IH_BITS times the levels below it
+//     int iStroke                   : [in] the index of the new stroke
+//     const HistoryStroke* pStroke  : [in] the stroke
+//
+// Return Values (HistoryNode*):
+//      the copy of the node, NULL if out of memory
+//
+/////////////////////////////////////////////////////////
+static HistoryNode* AppendToNode(
+        const HistoryNode* pNode,
+        int nShift,
+        int iStroke,
+        const HistoryStroke* pStroke
+        )
+{
+    int iChild = (iStroke >> nShift) & IH_MASK;
+    void* pChild;
+    if (0 == nShift)
+    {
+        HistoryStroke::AddRef(pStroke);
+        pChild = (void*)pStroke;
+    }
+    else if (iChild < pNode->cChildren)
+    {
+        pChild = AppendToNode((const HistoryNode*)pNode->rgpChildren[iChild],
+                              nShift - IH_BITS, iStroke, pStroke);
+    }
+    else
+    {
+        pChild = NewPath(nShift - IH_BITS, pStroke);
+    }
+    if (NULL == pChild)
+        return NULL;
+
+    HistoryNode* pCopy = CopyNode(pNode, nShift);
+    if (NULL == pCopy)
+    {
+        if (0 == nShift)
+            HistoryStroke::Release(pStroke);
+        else
+            ReleaseNode((HistoryNode*)pChild, nShift - IH_BITS);
+        return NULL;
+    }
+
+    // The copy took a reference to the child that's replaced
+    if (iChild < pCopy->cChildren)
+        ReleaseNode((HistoryNode*)pCopy->rgpChildren[iChild], nShift - IH_BITS);
+    else
+        pCopy->cChildren = iChild + 1;
+    pCopy->rgpChildren[iChild] = pChild;
+    return pCopy;
+}
+
+////////////////////////////////////////////////////////
+// CStrokeVector methods
+////////////////////////////////////////////////////////
+
+CStrokeVector::CStrokeVector(const CStrokeVector& vector)
+    : m_pRoot(vector.m_pRoot), m_cStrokes(vector.m_cStrokes), m_nShift(vector.m_nShift)
+{
+    if (NULL != m_pRoot)
+        HistoryIncrement(&m_pRoot->lRefs);
+}
+
+CStrokeVector::~CStrokeVector()
+{
+    ReleaseNode(m_pRoot, m_nShift);
+}
+
+CStrokeVector& CStrokeVector::operator=(const CStrokeVector& vector)
+{
+    // Take the reference first, the vector may be this one
+    if (NULL != vector.m_pRoot)
+        HistoryIncrement(&vector.m_pRoot->lRefs);
+    ReleaseNode(m_pRoot, m_nShift);
+    m_pRoot = vector.m_pRoot;
+    m_cStrokes = vector.m_cStrokes;
+    m_nShift = vector.m_nShift;
+    return *this;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CStrokeVector::Append
+//
+// Makes the vector with a stroke more. Only the path to
+// the new stroke is copied; when the trie is full, the new
+// root has the old one as its first child.
+//
+// Parameters:
+//     const HistoryStroke* pStroke : [in] the stroke, the new vector takes
+//                                    a reference to it
+//     CStrokeVector& result        : [out] the new vector, may be this one
+//
+// Return Values (bool):
+//      true if succeeded, false if out of memory
+//
+/////////////////////////////////////////////////////////
+bool CStrokeVector::Append(
+        const HistoryStroke* pStroke,
+        CStrokeVector& result
+        ) const
+{
+    HistoryNode* pRoot;
+    int nShift = m_nShift;
+    if (NULL == m_pRoot)
+    {
+        pRoot = NewPath(0, pStroke);
+    }
+    else if (m_cStrokes == (1 << (m_nShift + IH_BITS)))
+    {
+        pRoot = NewNode();
+        HistoryNode* pPath = (NULL != pRoot) ? NewPath(m_nShift, pStroke) : NULL;
+        if (NULL == pPath)
+        {
+            ReleaseNode(pRoot, m_nShift + IH_BITS);
+            return false;
+        }
+        HistoryIncrement(&m_pRoot->lRefs);
+        pRoot->rgpChildren[0] = m_pRoot;
+        pRoot->rgpChildren[1] = pPath;
+        pRoot->cChildren = 2;
+        nShift += IH_BITS;
+    }
+    else
+    {
+        pRoot = AppendToNode(m_pRoot, m_nShift, m_cStrokes, pStroke);
+    }
+    if (NULL == pRoot)
+        return false;
+
+    int cStrokes = m_cStrokes + 1;
+    ReleaseNode(result.m_pRoot, result.m_nShift);
+    result.m_pRoot = pRoot;
+    result.m_cStrokes = cStrokes;
+    result.m_nShift = nShift;
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CStrokeVector::GetStroke
+//
+// Return Values (const HistoryStroke*):
+//      the stroke, valid for as long as a vector that has it
+//
+/////////////////////////////////////////////////////////
+const HistoryStroke* CStrokeVector::GetStroke(
+        int iStroke
+        ) const
+{
+    const HistoryNode* pNode = m_pRoot;
+    for (int nShift = m_nShift; nShift > 0; nShift -= IH_BITS)
+    {
+        pNode = (const HistoryNode*)pNode->rgpChildren[(iStroke >> nShift) & IH_MASK];
+    }
+    return (const HistoryStroke*)pNode->rgpChildren[iStroke & IH_MASK];
+}
+
+long CStrokeVector::GetLiveNodeCount()
+{
+    return gs_cLiveNodes;
+}
+
+unsigned int CStrokeVector::GetNodeSize()
+{
+    return sizeof(HistoryNode);
+}
+
+////////////////////////////////////////////////////////
+// CInkHistory methods
+////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////
+//
+// CInkHistory::CInkHistory
+//
+// Constructor. The history starts with the empty ink.
+//
+// Parameters:
+//     none
+//
+/////////////////////////////////////////////////////////
+CInkHistory::CInkHistory()
+    : m_pVersions(new CStrokeVector[IH_INITIAL_VERSIONS]), m_cVersions(1),
+      m_cMaxVersions(IH_INITIAL_VERSIONS), m_iCurrent(0)
+{
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkHistory::~CInkHistory
+//
+// Destructor.
+//
+/////////////////////////////////////////////////////////
+CInkHistory::~CInkHistory()
+{
+    delete [] m_pVersions;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkHistory::Commit
+//
+// Makes a vector the current version of the ink, after the
+// current one. The versions that could be redone are
+// dropped. Committing the current version again does
+// nothing.
+//
+// Parameters:
+//     const CStrokeVector& vector : [in] the new version
+//
+// Return Values (bool):
+//      true if succeeded, false if out of memory
+//
+/////////////////////////////////////////////////////////
+bool CInkHistory::Commit(
+        const CStrokeVector& vector
+        )
+{
+    if (vector.IsSameAs(GetCurrent()))
+        return true;
+
+    // The vector may be one of the versions that are dropped
+    CStrokeVector version(vector);
+    for (int i = m_iCurrent + 1; i < m_cVersions; i++)
+    {
+        m_pVersions[i] = CStrokeVector();
+    }
+    m_cVersions = m_iCurrent + 1;
+
+    if (m_cVersions == m_cMaxVersions)
+    {
+        // The copies share the vectors, so growing is cheap
+        CStrokeVector* pVersions = new CStrokeVector[2 * m_cMaxVersions];
+        if (NULL == pVersions)
+            return false;
+        for (int i = 0; i < m_cVersions; i++)
+        {
+            pVersions[i] = m_pVersions[i];
+        }
+        delete [] m_pVersions;
+        m_pVersions = pVersions;
+        m_cMaxVersions *= 2;
+    }
+
+    m_pVersions[m_cVersions++] = version;
+    m_iCurrent++;
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkHistory::Append
+//
+// Adds a stroke to the ink, as a new version.
+//
+// Parameters:
+//     const HistoryStroke* pStroke : [in] the stroke, the history takes a
+//                                    reference to it
+//
+// Return Values (bool):
+//      true if succeeded, false if out of memory
+//
+/////////////////////////////////////////////////////////
+bool CInkHistory::Append(
+        const HistoryStroke* pStroke
+        )
+{
+    CStrokeVector vector;
+    return GetCurrent().Append(pStroke, vector) && Commit(vector);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkHistory::Clear
+//
+// Makes the empty ink a new version, unless the ink is
+// already empty; the strokes stay in the older versions.
+//
+// Return Values (bool):
+//      true if succeeded, false if out of memory
+//
+/////////////////////////////////////////////////////////
+bool CInkHistory::Clear()
+{
+    return Commit(CStrokeVector());
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkHistory::Undo, CInkHistory::Redo
+//
+// Make the version before or after the current one
+// current.
+//
+// Return Values (bool):
+//      true if the current version has changed, false if there's
+//      nothing to undo or redo
+//
+/////////////////////////////////////////////////////////
+bool CInkHistory::Undo()
+{
+    if (false == CanUndo())
+        return false;
+    m_iCurrent--;
+    return true;
+}
+
+bool CInkHistory::Redo()
+{
+    if (false == CanRedo())
+        return false;
+    m_iCurrent++;
+    return true;
+}
@@ -0,0 +1,135 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      InkHistory.h
+//
+// Description:
+//      This file contains the definitions of the undo history of the ink:
+//      the HistoryStroke structure, the CStrokeVector class, a persistent
+//      (immutable) vector of strokes, and the CInkHistory class, the
+//      versions of the ink that can be undone and redone.
+//
+//      A vector is a trie of nodes with IH_BRANCH children; the strokes
+//      are at the leaves. An edit copies only the nodes on the path to
+//      the stroke it changes, O(log n), and shares all the others with
+//      the vector it was made from; a snapshot is a copy of the root
+//      pointer, O(1). The nodes and the strokes are never changed after
+//      they're made and are freed by reference counting, so a snapshot
+//      can be handed to another thread and read there without a lock.
+//
+//      The methods of the classes are defined in the InkHistory.cpp file.
+//--------------------------------------------------------------------------
+
+#pragma once
+
+#include "GestureEngine.h"
+
+#define IH_BITS     5                   // log2 of the branching factor
+#define IH_BRANCH   (1 << IH_BITS)
+
+// A stroke of the history: the points the digitizer reported, which
+// the ink object is rebuilt from, and the decimated points of the
+// recognition. Both arrays follow the structure in one allocation.
+struct HistoryStroke
+{
+    volatile long   lRefs;
+    int             cInkPoints;         // the x, y pairs, in ink units
+    int             cPoints;            // the decimated points
+
+    const int* GetInkPoints() const { return (const int*)(this + 1); }
+    const GesturePoint* GetPoints() const
+        { return (const GesturePoint*)(GetInkPoints() + 2 * cInkPoints); }
+
+    static HistoryStroke* Create(const int* piInkPoints, int cInkPoints,
+                                 const GesturePoint* ppt, int cPoints);
+    static void AddRef(const HistoryStroke* pStroke);
+    static void Release(const HistoryStroke* pStroke);
+};
+
+struct HistoryNode;
+
+/////////////////////////////////////////////////////////
+//
+// class CStrokeVector
+//
+// A persistent vector of strokes. Append leaves the
+// vector alone and returns the longer one; a copy of a
+// vector shares everything with it.
+//
+/////////////////////////////////////////////////////////
+
+class CStrokeVector
+{
+    HistoryNode*    m_pRoot;        // NULL if empty
+    int             m_cStrokes;
+    int             m_nShift;       // IH_BITS times the levels above the leaves
+
+public:
+
+    // Constructors and destructor
+    CStrokeVector() : m_pRoot(NULL), m_cStrokes(0), m_nShift(0) {}
+    CStrokeVector(const CStrokeVector& vector);
+    ~CStrokeVector();
+    CStrokeVector& operator=(const CStrokeVector& vector);
+
+    // Returns false, and leaves the result alone, if out of memory
+    bool Append(const HistoryStroke* pStroke, CStrokeVector& result) const;
+
+    int  GetStrokeCount() const { return m_cStrokes; }
+    const HistoryStroke* GetStroke(int iStroke) const;
+    bool IsSameAs(const CStrokeVector& vector) const { return m_pRoot == vector.m_pRoot; }
+
+    // The nodes of all the vectors, for the measurement of the sharing
+    static long GetLiveNodeCount();
+    static unsigned int GetNodeSize();
+};
+
+/////////////////////////////////////////////////////////
+//
+// class CInkHistory
+//
+// The versions of the ink, oldest first, and the current
+// one. An edit drops the versions after the current one
+// (the redo) and makes the edited ink the current version;
+// undo and redo move between the versions. The first
+// version is the empty ink. The history has no limit: a
+// version costs the nodes of one path of its vector.
+//
+/////////////////////////////////////////////////////////
+
+class CInkHistory
+{
+    CStrokeVector*  m_pVersions;
+    int             m_cVersions;
+    int             m_cMaxVersions;
+    int             m_iCurrent;
+
+public:
+
+    // Constructor and destructor
+    CInkHistory();
+    ~CInkHistory();
+
+    bool Commit(const CStrokeVector& vector);
+    bool Append(const HistoryStroke* pStroke);
+    bool Clear();
+    bool Undo();
+    bool Redo();
+
+    // Data members access methods
+    const CStrokeVector& GetCurrent() const { return m_pVersions[m_iCurrent]; }
+    bool CanUndo() const { return m_iCurrent > 0; }
+    bool CanRedo() const { return m_iCurrent + 1 < m_cVersions; }
+    int  GetVersionCount() const { return m_cVersions; }
+
+private:
+
+    // Not copyable
+    CInkHistory(const CInkHistory&);
+    CInkHistory& operator=(const CInkHistory&);
+};
@@ -0,0 +1,294 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      InkLayers.cpp
+//
+// Description:
+//      The file contains the definitions of the methods of the class
+//      CInkLayers. See the file InkLayers.h for the definition of the
+//      class.
+//--------------------------------------------------------------------------
+
+#include <stdlib.h>
+
+#include "InkLayers.h"
+#include "Trace.h"
+
+// Draws a stroke, a dot if it has one point
+static void DrawStroke(CSoftRaster& raster, const int* piPoints, int cPoints, unsigned int clr)
+{
+    if (1 == cPoints)
+        raster.DrawLine(piPoints[0], piPoints[1], piPoints[0], piPoints[1], clr);
+    for (int i = 1; i < cPoints; i++)
+    {
+        raster.DrawLine(piPoints[2 * i - 2], piPoints[2 * i - 1],
+                        piPoints[2 * i], piPoints[2 * i + 1], clr);
+    }
+}
+
+// Grows a rectangle to a pixel; an empty rectangle becomes the pixel
+static void AddToRect(RasterRect& rc, int x, int y)
+{
+    if (rc.left >= rc.right)
+    {
+        rc.left = x;
+        rc.top = y;
+        rc.right = x + 1;
+        rc.bottom = y + 1;
+        return;
+    }
+    if (x < rc.left) rc.left = x;
+    if (x >= rc.right) rc.right = x + 1;
+    if (y < rc.top) rc.top = y;
+    if (y >= rc.bottom) rc.bottom = y + 1;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkLayers::CInkLayers
+//
+// Constructor.
+//
+/////////////////////////////////////////////////////////
+CInkLayers::CInkLayers()
+    : m_clrBackground(SR_RGB(0xFF, 0xFF, 0xFF)), m_clrInk(SR_RGB(0, 0, 0)),
+      m_piPoints(NULL), m_cPoints(0), m_cMaxPoints(0)
+{
+    RasterRect rcEmpty = { 0, 0, 0, 0 };
+    m_rcLive = rcEmpty;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkLayers::~CInkLayers
+//
+// Destructor.
+//
+/////////////////////////////////////////////////////////
+CInkLayers::~CInkLayers()
+{
+    free(m_piPoints);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkLayers::Create
+//
+// Creates the layers, with no ink.
+//
+// Parameters:
+//     int cx, int cy             : [in] the size of the pane, in pixels
+//     unsigned int clrBackground : [in] the color of the pane
+//     unsigned int clrInk        : [in] the color of the ink
+//
+// Return Values (bool):
+//      true if succeeded, false if out of memory
+//
+/////////////////////////////////////////////////////////
+bool CInkLayers::Create(
+        int cx,
+        int cy,
+        unsigned int clrBackground,
+        unsigned int clrInk
+        )
+{
+    if (false == m_committed.Create(cx, cy) || false == m_live.Create(cx, cy))
+        return false;
+
+    m_clrBackground = clrBackground;
+    m_clrInk = clrInk;
+    m_cPoints = 0;
+    RasterRect rcAll = { 0, 0, cx, cy };
+    m_committed.FillRect(rcAll, m_clrBackground);
+    m_live.FillRect(rcAll, SR_TRANSPARENT);
+    RasterRect rcEmpty = { 0, 0, 0, 0 };
+    m_rcLive = rcEmpty;
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkLayers::AddPoint
+//
+// Adds a point to the stroke being drawn, which begins
+// with the first point after EndStroke, and draws its
+// segment into the live layer.
+//
+// Parameters:
+//     int x, int y         : [in] the point, in the pane's pixels
+//     RasterRect& rcDirty  : [out] the bounds of the segment
+//
+// Return Values (bool):
+//      true if succeeded, false if out of memory
+//
+/////////////////////////////////////////////////////////
+bool CInkLayers::AddPoint(
+        int x,
+        int y,
+        RasterRect& rcDirty
+        )
+{
+    RasterRect rcEmpty = { 0, 0, 0, 0 };
+    rcDirty = rcEmpty;
+    if (m_cPoints == m_cMaxPoints)
+    {
+        int cMaxPoints = (0 == m_cMaxPoints) ? 256 : 2 * m_cMaxPoints;
+        int* piPoints = (int*)realloc(m_piPoints, 2 * cMaxPoints * sizeof(int));
+        if (NULL == piPoints)
+            return false;
+        m_piPoints = piPoints;
+        m_cMaxPoints = cMaxPoints;
+    }
+
+    m_piPoints[2 * m_cPoints] = x;
+    m_piPoints[2 * m_cPoints + 1] = y;
+    m_cPoints++;
+
+    int x0 = (m_cPoints > 1) ? m_piPoints[2 * m_cPoints - 4] : x;
+    int y0 = (m_cPoints > 1) ? m_piPoints[2 * m_cPoints - 3] : y;
+    m_live.DrawLine(x0, y0, x, y, m_clrInk);
+
+    AddToRect(rcDirty, x0, y0);
+    AddToRect(rcDirty, x, y);
+    AddToRect(m_rcLive, x0, y0);
+    AddToRect(m_rcLive, x, y);
+    ClipRect(rcDirty);
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkLayers::EndStroke
+//
+// Ends the stroke being drawn: draws it into the committed
+// layer if it's kept, and erases it from the live layer,
+// both along its segments. A kept stroke has the same
+// pixels in either layer, so the pane doesn't change; a
+// stroke that's dropped, a gesture, leaves the committed
+// layer alone and its bounds are composed again.
+//
+// Parameters:
+//     bool bCommit         : [in] true to keep the stroke
+//     RasterRect& rcDirty  : [out] the bounds of the stroke if it's
+//                            dropped, empty if it's kept
+//
+/////////////////////////////////////////////////////////
+void CInkLayers::EndStroke(
+        bool bCommit,
+        RasterRect& rcDirty
+        )
+{
+    TRACE_SCOPE("End live stroke");
+    RasterRect rcEmpty = { 0, 0, 0, 0 };
+    rcDirty = rcEmpty;
+    if (bCommit)
+    {
+        DrawStroke(m_committed, m_piPoints, m_cPoints, m_clrInk);
+    }
+    else
+    {
+        rcDirty = m_rcLive;
+        ClipRect(rcDirty);
+    }
+    DrawStroke(m_live, m_piPoints, m_cPoints, SR_TRANSPARENT);
+
+    m_cPoints = 0;
+    m_rcLive = rcEmpty;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkLayers::CommitStroke
+//
+// Draws a finished stroke into the committed layer, for
+// the ink that wasn't drawn live: the ink an undo brings
+// back, or a file's.
+//
+// Parameters:
+//     const int* piPoints  : [in] the x, y pairs, in the pane's pixels
+//     int cPoints          : [in] the number of the points
+//     RasterRect& rcDirty  : [out] the bounds of the stroke
+//
+/////////////////////////////////////////////////////////
+void CInkLayers::CommitStroke(
+        const int* piPoints,
+        int cPoints,
+        RasterRect& rcDirty
+        )
+{
+    RasterRect rcEmpty = { 0, 0, 0, 0 };
+    rcDirty = rcEmpty;
+    for (int i = 0; i < cPoints; i++)
+    {
+        AddToRect(rcDirty, piPoints[2 * i], piPoints[2 * i + 1]);
+    }
+    ClipRect(rcDirty);
+    DrawStroke(m_committed, piPoints, cPoints, m_clrInk);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkLayers::Clear
+//
+// Erases the committed ink; the stroke being drawn stays.
+//
+// Parameters:
+//     RasterRect& rcDirty  : [out] the whole pane
+//
+/////////////////////////////////////////////////////////
+void CInkLayers::Clear(
+        RasterRect& rcDirty
+        )
+{
+    RasterRect rcAll = { 0, 0, GetWidth(), GetHeight() };
+    m_committed.FillRect(rcAll, m_clrBackground);
+    rcDirty = rcAll;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkLayers::Compose
+//
+// Composes a rectangle of the pane into a frame: the
+// committed layer, and the live layer over it.
+//
+// Parameters:
+//     const RasterRect& rc : [in] the rectangle, in the pane's pixels
+//     CSoftRaster& frame   : [in/out] the frame
+//     int x, int y         : [in] the pane's top left corner in the frame
+//
+/////////////////////////////////////////////////////////
+void CInkLayers::Compose(
+        const RasterRect& rc,
+        CSoftRaster& frame,
+        int x,
+        int y
+        ) const
+{
+    RasterRect rcPane = rc;
+    ClipRect(rcPane);
+    if (rcPane.left >= rcPane.right || rcPane.top >= rcPane.bottom)
+        return;
+
+    frame.BlitRect(m_committed, rcPane, x + rcPane.left, y + rcPane.top);
+    if (m_cPoints > 0)
+    {
+        frame.BlitTransparent(m_live, rcPane, x + rcPane.left, y + rcPane.top);
+    }
+}
+
+// Clips a rectangle to the pane
+void CInkLayers::ClipRect(RasterRect& rc) const
+{
+    if (rc.left < 0) rc.left = 0;
+    if (rc.top < 0) rc.top = 0;
+    if (rc.right > GetWidth()) rc.right = GetWidth();
+    if (rc.bottom > GetHeight()) rc.bottom = GetHeight();
+    if (rc.left > rc.right) rc.right = rc.left;
+    if (rc.top > rc.bottom) rc.bottom = rc.top;
+}
@@ -0,0 +1,88 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      InkLayers.h
+//
+// Description:
+//      This file contains the definition of the CInkLayers class, the
+//      two layers an ink pane is painted from:
+//
+//      - the committed layer, the background and every finished stroke,
+//        drawn once, when the stroke is committed;
+//      - the live layer, the stroke being drawn, on a transparent
+//        background.
+//
+//      A new packet draws its segment into the live layer and composes
+//      the segment's rectangle only, so its cost doesn't depend on the
+//      ink on the pane. A repaint composes the rectangle asked for from
+//      the two layers, a copy of its pixels, and never draws the ink
+//      again. The pixels of every rectangle are those of drawing all the
+//      strokes, in order, over the background.
+//
+//      The methods of the class are defined in the InkLayers.cpp file.
+//--------------------------------------------------------------------------
+
+#pragma once
+
+#include "SoftRaster.h"
+
+/////////////////////////////////////////////////////////
+//
+// class CInkLayers
+//
+// The committed and the live layers of an ink pane. The
+// points are in the pane's pixels. Every method that
+// changes the layers returns the rectangle that has to
+// be composed again, which is empty if none.
+//
+/////////////////////////////////////////////////////////
+
+class CInkLayers
+{
+    CSoftRaster     m_committed;    // the background and the committed strokes
+    CSoftRaster     m_live;         // the stroke being drawn, on SR_TRANSPARENT
+    unsigned int    m_clrBackground;
+    unsigned int    m_clrInk;
+
+    // The stroke being drawn
+    int*            m_piPoints;     // x, y pairs
+    int             m_cPoints;
+    int             m_cMaxPoints;
+    RasterRect      m_rcLive;       // its bounds, empty if no stroke
+
+public:
+
+    // Constructor and destructor
+    CInkLayers();
+    ~CInkLayers();
+
+    bool Create(int cx, int cy, unsigned int clrBackground, unsigned int clrInk);
+
+    // The stroke being drawn
+    bool AddPoint(int x, int y, RasterRect& rcDirty);
+    void EndStroke(bool bCommit, RasterRect& rcDirty);
+
+    // The committed ink
+    void CommitStroke(const int* piPoints, int cPoints, RasterRect& rcDirty);
+    void Clear(RasterRect& rcDirty);
+
+    void Compose(const RasterRect& rc, CSoftRaster& frame, int x, int y) const;
+
+    // Data members access methods
+    int  GetWidth() const { return m_committed.GetWidth(); }
+    int  GetHeight() const { return m_committed.GetHeight(); }
+    int  GetLivePointCount() const { return m_cPoints; }
+
+private:
+
+    void ClipRect(RasterRect& rc) const;
+
+    // Not copyable
+    CInkLayers(const CInkLayers&);
+    CInkLayers& operator=(const CInkLayers&);
+};
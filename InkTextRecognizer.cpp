@@ -0,0 +1,223 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      InkTextRecognizer.cpp
+//
+// Description:
+//      The file contains the definitions of the methods of the class
+//      CInkTextRecognizer. See the file InkTextRecognizer.h for the
+//      definition of the class.
+//--------------------------------------------------------------------------
+
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT 0x0500
+#endif
+
+// Windows header file
+#include <windows.h>
+
+// ATL header files:
+#include <atlbase.h>        // defines CComPtr, CComBSTR
+
+// Tablet PC Automation interfaces header file
+#include <msinkaut.h>
+
+// The application header files
+#include "InkTextRecognizer.h"
+
+/////////////////////////////////////////////////////////
+//
+// CInkTextRecognizer::BeginThread
+//
+// Joins the worker thread to the multithreaded apartment and
+// creates the Ink object that holds the strokes and the
+// recognizer context of the default recognizer.
+//
+// Return Values (bool):
+//      true if succeeded, false if COM or the Tablet PC Automation
+//      objects are not available, or there's no recognizer
+//
+/////////////////////////////////////////////////////////
+bool CInkTextRecognizer::BeginThread()
+{
+    if (FAILED(::CoInitializeEx(NULL, COINIT_MULTITHREADED)))
+        return false;
+    m_bComInitialized = true;
+
+    if (FAILED(m_spIInkDisp.CoCreateInstance(CLSID_InkDisp))
+        || FAILED(m_spIInkRecoContext.CoCreateInstance(CLSID_InkRecognizerContext)))
+    {
+        EndThread();
+        return false;
+    }
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkTextRecognizer::EndThread
+//
+// Releases the Automation objects and COM.
+//
+/////////////////////////////////////////////////////////
+void CInkTextRecognizer::EndThread()
+{
+    m_spIInkRecoContext.Release();
+    m_spIInkDisp.Release();
+    if (m_bComInitialized)
+    {
+        ::CoUninitialize();
+        m_bComInitialized = false;
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkTextRecognizer::Recognize
+//
+// Copies the ink into the Ink object, recognizes it and
+// takes the top alternates of the whole result. The cancel
+// is checked between the strokes and before the recognition.
+//
+// Parameters:
+//     const CRecoInk& ink          : [in] the ink to recognize
+//     const RecoCancel& cancel     : [in] tells if the job is stale
+//     RecoAlternate* pAlternates   : [out] the alternates, best first
+//     int cMaxAlternates           : [in] the size of pAlternates
+//
+// Return Values (int):
+//      the number of alternates, -1 if failed or cancelled
+//
+/////////////////////////////////////////////////////////
+int CInkTextRecognizer::Recognize(
+        const CRecoInk& ink,
+        const RecoCancel& cancel,
+        RecoAlternate* pAlternates,
+        int cMaxAlternates
+        )
+{
+    if (0 == ink.GetStrokeCount() || cMaxAlternates <= 0)
+        return 0;
+
+    HRESULT hr = S_OK;
+    for (int i = 0; i < ink.GetStrokeCount() && SUCCEEDED(hr); i++)
+    {
+        if (cancel.IsCancelled())
+        {
+            hr = E_ABORT;
+            break;
+        }
+        int cPoints;
+        const GesturePoint* ppt = ink.GetStroke(i, cPoints);
+        hr = AddStroke(ppt, cPoints);
+    }
+
+    CComPtr<IInkStrokes> spIInkStrokes;
+    if (SUCCEEDED(hr))
+    {
+        hr = m_spIInkDisp->get_Strokes(&spIInkStrokes);
+    }
+    if (SUCCEEDED(hr))
+    {
+        hr = m_spIInkRecoContext->putref_Strokes(spIInkStrokes);
+    }
+
+    CComPtr<IInkRecognitionResult> spIInkRecoResult;
+    if (SUCCEEDED(hr))
+    {
+        InkRecognitionStatus RecognitionStatus;
+        hr = cancel.IsCancelled() ? E_ABORT
+                                  : m_spIInkRecoContext->Recognize(&RecognitionStatus,
+                                                                   &spIInkRecoResult);
+        if (SUCCEEDED(hr) && spIInkRecoResult == NULL)
+            hr = E_FAIL;
+    }
+
+    CComPtr<IInkRecognitionAlternates> spIInkRecoAlternates;
+    if (SUCCEEDED(hr))
+    {
+        hr = spIInkRecoResult->AlternatesFromSelection(0, -1, cMaxAlternates,
+                                                       &spIInkRecoAlternates);
+    }
+
+    long cAlternates = 0;
+    if (SUCCEEDED(hr))
+    {
+        hr = spIInkRecoAlternates->get_Count(&cAlternates);
+    }
+    if (cAlternates > cMaxAlternates)
+        cAlternates = cMaxAlternates;
+
+    for (long i = 0; i < cAlternates && SUCCEEDED(hr); i++)
+    {
+        CComPtr<IInkRecognitionAlternate> spIInkRecoAlternate;
+        hr = spIInkRecoAlternates->Item(i, &spIInkRecoAlternate);
+        if (FAILED(hr))
+            break;
+
+        CComBSTR bstr;
+        spIInkRecoAlternate->get_String(&bstr);
+        int cch = ::WideCharToMultiByte(CP_UTF8, 0, bstr, bstr.Length(),
+                                        pAlternates[i].szText, BR_MAX_TEXT - 1, NULL, NULL);
+        pAlternates[i].szText[cch] = '\0';
+
+        // Not all the recognizers tell the confidence
+        InkRecognitionConfidence irc;
+        if (SUCCEEDED(spIInkRecoAlternate->get_Confidence(&irc)))
+            pAlternates[i].fScore = (IRC_Strong == irc) ? 1.0f : (IRC_Intermediate == irc) ? 0.5f : 0.0f;
+        else
+            pAlternates[i].fScore = -1.0f;
+    }
+
+    // Leave the Ink object empty for the next job
+    m_spIInkRecoContext->putref_Strokes(NULL);
+    m_spIInkDisp->DeleteStrokes(NULL);
+
+    return SUCCEEDED(hr) ? (int)cAlternates : -1;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInkTextRecognizer::AddStroke
+//
+// Creates a stroke of the Ink object from the points, as
+// packets of the X and Y properties.
+//
+// Return Values (HRESULT):
+//      S_OK if succeeded, an error code otherwise
+//
+/////////////////////////////////////////////////////////
+HRESULT CInkTextRecognizer::AddStroke(const GesturePoint* ppt, int cPoints)
+{
+    SAFEARRAY* psaPackets = ::SafeArrayCreateVector(VT_I4, 0, 2 * cPoints);
+    if (NULL == psaPackets)
+        return E_OUTOFMEMORY;
+
+    long* plData;
+    HRESULT hr = ::SafeArrayAccessData(psaPackets, (void HUGEP**)&plData);
+    if (FAILED(hr))
+    {
+        ::SafeArrayDestroy(psaPackets);
+        return hr;
+    }
+    for (int i = 0; i < cPoints; i++)
+    {
+        plData[2 * i] = (long)ppt[i].x;
+        plData[2 * i + 1] = (long)ppt[i].y;
+    }
+    ::SafeArrayUnaccessData(psaPackets);
+
+    // An empty packet description means X and Y only
+    CComVariant vPackets;
+    vPackets.vt = VT_ARRAY | VT_I4;
+    vPackets.parray = psaPackets;
+    CComVariant vDescription;
+
+    CComPtr<IInkStrokeDisp> spIInkStroke;
+    return m_spIInkDisp->CreateStroke(vPackets, vDescription, &spIInkStroke);
+}
@@ -0,0 +1,55 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      InkTextRecognizer.h
+//
+// Description:
+//      This file contains the definition of the CInkTextRecognizer class,
+//      the IStrokeRecognizer (BackgroundReco.h) of the application on top
+//      of the default handwriting recognizer of the Tablet PC Automation
+//      API. Its own Ink object and recognizer context live on the worker
+//      thread, so the recognition never touches the InkCollector's ink.
+//
+//      The methods of the class are defined in the InkTextRecognizer.cpp
+//      file.
+//--------------------------------------------------------------------------
+
+#pragma once
+
+#include "BackgroundReco.h"
+
+/////////////////////////////////////////////////////////
+//
+// class CInkTextRecognizer
+//
+// Recognizes the ink with the default recognizer. It needs
+// COM and the msinkaut.h interfaces, and one or more
+// handwriting recognizers installed; BeginThread fails
+// without them.
+//
+/////////////////////////////////////////////////////////
+
+class CInkTextRecognizer : public IStrokeRecognizer
+{
+    CComPtr<IInkDisp>               m_spIInkDisp;
+    CComPtr<IInkRecognizerContext>  m_spIInkRecoContext;
+    bool                            m_bComInitialized;
+
+public:
+
+    CInkTextRecognizer() : m_bComInitialized(false) {}
+
+    virtual bool BeginThread();
+    virtual void EndThread();
+    virtual int  Recognize(const CRecoInk& ink, const RecoCancel& cancel,
+                           RecoAlternate* pAlternates, int cMaxAlternates);
+
+private:
+
+    HRESULT AddStroke(const GesturePoint* ppt, int cPoints);
+};
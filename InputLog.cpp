@@ -0,0 +1,484 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      InputLog.cpp
+//
+// Description:
+//      The file contains the definitions of the methods of the classes
+//      CInputRecorder, CInputLog and CInputReplayer.
+//      See the file InputLog.h for the definitions of the classes.
+//--------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "InputLog.h"
+#include "Trace.h"
+
+#ifndef _WIN32
+#include <time.h>
+#endif
+
+// A useful macro to determine the number of elements in the array
+#ifndef countof
+#define countof(array)  (sizeof(array)/sizeof(array[0]))
+#endif
+
+// The command id of the Clear command, the same as in resource.h
+#define INPUTLOG_ID_CLEAR   40302
+
+/////////////////////////////////////////////////////////
+//
+// WaitUntil
+//
+// Waits for the clock to reach the given time: sleeps while
+// the time is more than a couple of milliseconds away (the
+// sleep granularity), then spins.
+//
+/////////////////////////////////////////////////////////
+static void WaitUntil(PERFTIME ptDeadline)
+{
+    const PERFTIME ptSpin = 2000000;    // 2 ms
+    for (PERFTIME ptNow = PerfNow(); ptNow < ptDeadline; ptNow = PerfNow())
+    {
+        PERFTIME ptLeft = ptDeadline - ptNow;
+        if (ptLeft > ptSpin)
+        {
+#ifdef _WIN32
+            ::Sleep((DWORD)((ptLeft - ptSpin) / 1000000));
+#else
+            struct timespec ts;
+            ts.tv_sec = (time_t)((ptLeft - ptSpin) / 1000000000ULL);
+            ts.tv_nsec = (long)((ptLeft - ptSpin) % 1000000000ULL);
+            nanosleep(&ts, NULL);
+#endif
+        }
+    }
+}
+
+// CInputRecorder ///////////////////////////////////////
+
+/////////////////////////////////////////////////////////
+//
+// CInputRecorder::Open
+//
+// Creates the log file and starts the clock of the
+// recording.
+//
+// Parameters:
+//     const char* pszFileName : [in] the log file name
+//
+// Return Values (bool):
+//      true if succeeded, false otherwise
+//
+/////////////////////////////////////////////////////////
+bool CInputRecorder::Open(const char* pszFileName)
+{
+    Close();
+
+    m_pFile = fopen(pszFileName, "w");
+    if (NULL == m_pFile)
+        return false;
+
+    fprintf(m_pFile, "%s\n", INPUTLOG_HEADER);
+    m_ptStart = PerfNow();
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInputRecorder::Close
+//
+// Flushes and closes the log file.
+//
+/////////////////////////////////////////////////////////
+void CInputRecorder::Close()
+{
+    if (NULL != m_pFile)
+    {
+        fclose(m_pFile);
+        m_pFile = NULL;
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInputRecorder::Record
+//
+// Appends an event, stamped with the current time, to the
+// log. Does nothing if the recorder isn't open.
+//
+// Parameters:
+//     int iType  : [in] IE_ constant
+//     int iArg0  : [in] the first argument, if the event has one
+//     int iArg1  : [in] the second argument, if the event has one
+//
+// Return Values (void):
+//      none
+//
+/////////////////////////////////////////////////////////
+void CInputRecorder::Record(int iType, int iArg0, int iArg1)
+{
+    if (NULL == m_pFile)
+        return;
+
+    unsigned long long ullTime = PerfNow() - m_ptStart;
+    switch (iType)
+    {
+        case IE_PACKET:
+        case IE_GESTURE_STATUS:
+            fprintf(m_pFile, "%llu %c %d %d\n", ullTime, iType, iArg0, iArg1);
+            break;
+
+        case IE_GESTURE:
+        case IE_COMMAND:
+            fprintf(m_pFile, "%llu %c %d\n", ullTime, iType, iArg0);
+            break;
+
+        default:
+            fprintf(m_pFile, "%llu %c\n", ullTime, iType);
+            break;
+    }
+}
+
+// CInputLog ////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////
+//
+// CInputLog::Clear
+//
+// Removes all the events.
+//
+/////////////////////////////////////////////////////////
+void CInputLog::Clear()
+{
+    free(m_pEvents);
+    m_pEvents = NULL;
+    m_cEvents = m_cMaxEvents = 0;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInputLog::Append
+//
+// Appends an event to the log in memory.
+//
+// Return Values (bool):
+//      true if succeeded, false if out of memory
+//
+/////////////////////////////////////////////////////////
+bool CInputLog::Append(PERFTIME ptTime, int iType, int iArg0, int iArg1)
+{
+    if (m_cEvents == m_cMaxEvents)
+    {
+        int cNewMax = m_cMaxEvents ? m_cMaxEvents * 2 : 1024;
+        InputEvent* pEvents = (InputEvent*)realloc(m_pEvents, cNewMax * sizeof(InputEvent));
+        if (NULL == pEvents)
+            return false;
+        m_pEvents = pEvents;
+        m_cMaxEvents = cNewMax;
+    }
+
+    InputEvent& ev = m_pEvents[m_cEvents++];
+    ev.ptTime = ptTime;
+    ev.iType = iType;
+    ev.rgiArgs[0] = iArg0;
+    ev.rgiArgs[1] = iArg1;
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInputLog::Load
+//
+// Reads a log file written by CInputRecorder (or by Save).
+// The comment lines and the lines of unknown events are
+// skipped, so newer logs can be replayed by older tools.
+//
+// Parameters:
+//     const char* pszFileName : [in] the log file name
+//
+// Return Values (bool):
+//      true if succeeded, false if the file can't be read or
+//      isn't an input log
+//
+/////////////////////////////////////////////////////////
+bool CInputLog::Load(const char* pszFileName)
+{
+    Clear();
+
+    FILE* pFile = fopen(pszFileName, "r");
+    if (NULL == pFile)
+        return false;
+
+    char szLine[256];
+    bool bOk = (NULL != fgets(szLine, sizeof(szLine), pFile))
+            && (0 == strncmp(szLine, INPUTLOG_HEADER, strlen(INPUTLOG_HEADER)));
+
+    while (bOk && NULL != fgets(szLine, sizeof(szLine), pFile))
+    {
+        unsigned long long ullTime;
+        char chType;
+        int rgiArgs[2] = { 0, 0 };
+        if ('#' == szLine[0]
+            || sscanf(szLine, "%llu %c %d %d", &ullTime, &chType, &rgiArgs[0], &rgiArgs[1]) < 2)
+        {
+            continue;
+        }
+
+        switch (chType)
+        {
+            case IE_STROKE_BEGIN:
+            case IE_PACKET:
+            case IE_STROKE_END:
+            case IE_GESTURE:
+            case IE_COMMAND:
+            case IE_GESTURE_STATUS:
+                bOk = Append(ullTime, chType, rgiArgs[0], rgiArgs[1]);
+                break;
+        }
+    }
+
+    fclose(pFile);
+    if (false == bOk)
+        Clear();
+    return bOk;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInputLog::Save
+//
+// Writes the log to a file in the format CInputRecorder
+// produces.
+//
+// Parameters:
+//     const char* pszFileName : [in] the log file name
+//
+// Return Values (bool):
+//      true if succeeded, false otherwise
+//
+/////////////////////////////////////////////////////////
+bool CInputLog::Save(const char* pszFileName) const
+{
+    FILE* pFile = fopen(pszFileName, "w");
+    if (NULL == pFile)
+        return false;
+
+    fprintf(pFile, "%s\n", INPUTLOG_HEADER);
+    for (int i = 0; i < m_cEvents; i++)
+    {
+        const InputEvent& ev = m_pEvents[i];
+        switch (ev.iType)
+        {
+            case IE_PACKET:
+            case IE_GESTURE_STATUS:
+                fprintf(pFile, "%llu %c %d %d\n", ev.ptTime, ev.iType, ev.rgiArgs[0], ev.rgiArgs[1]);
+                break;
+
+            case IE_GESTURE:
+            case IE_COMMAND:
+                fprintf(pFile, "%llu %c %d\n", ev.ptTime, ev.iType, ev.rgiArgs[0]);
+                break;
+
+            default:
+                fprintf(pFile, "%llu %c\n", ev.ptTime, ev.iType);
+                break;
+        }
+    }
+
+    return (0 == fclose(pFile));
+}
+
+// CInputReplayer ///////////////////////////////////////
+
+/////////////////////////////////////////////////////////
+//
+// CInputReplayer::CInputReplayer
+//
+// Constructor. All the gestures start enabled, as in the
+// application.
+//
+// Parameters:
+//     const CGestureEngine& engine : [in] the engine to drive,
+//                                    must outlive the replayer
+//
+/////////////////////////////////////////////////////////
+CInputReplayer::CInputReplayer(const CGestureEngine& engine)
+    : m_engine(engine), m_pPoints(NULL), m_cPoints(0), m_cMaxPoints(0), m_decimator(0)
+{
+    for (int i = 0; i < GE_NUM_SSGESTURES; i++)
+    {
+        m_rgbEnabled[i] = true;
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInputReplayer::~CInputReplayer
+//
+// Destructor.
+//
+/////////////////////////////////////////////////////////
+CInputReplayer::~CInputReplayer()
+{
+    free(m_pPoints);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInputReplayer::AddPoint
+//
+// Appends a packet to the stroke being collected.
+//
+/////////////////////////////////////////////////////////
+bool CInputReplayer::AddPoint(int x, int y)
+{
+    if (m_cPoints == m_cMaxPoints)
+    {
+        int cNewMax = m_cMaxPoints ? m_cMaxPoints * 2 : 256;
+        GesturePoint* pPoints = (GesturePoint*)realloc(m_pPoints, cNewMax * sizeof(GesturePoint));
+        if (NULL == pPoints)
+            return false;
+        m_pPoints = pPoints;
+        m_cMaxPoints = cNewMax;
+    }
+
+    m_pPoints[m_cPoints].x = (float)x;
+    m_pPoints[m_cPoints].y = (float)y;
+    m_cPoints++;
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInputReplayer::RecognizeStroke
+//
+// Recognizes the collected stroke and returns the best
+// enabled gesture, or -1 if none is enabled or the engine
+// has no result.
+//
+/////////////////////////////////////////////////////////
+int CInputReplayer::RecognizeStroke() const
+{
+    GestureResult rgResults[GE_NUM_SSGESTURES];
+    int cResults = m_engine.Recognize(m_pPoints, m_cPoints, rgResults, countof(rgResults));
+    for (int i = 0; i < cResults; i++)
+    {
+        if (m_rgbEnabled[rgResults[i].iGesture])
+            return rgResults[i].iGesture;
+    }
+    return -1;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CInputReplayer::Replay
+//
+// Delivers the events of the log to the pipeline, in real
+// time or back to back, and reports the outcome of every
+// stroke.
+//
+// Parameters:
+//     const CInputLog& log      : [in] the log to replay
+//     bool bRealTime            : [in] true to keep the recorded pace
+//     ReplayStroke* pStrokes    : [out] the outcomes, in the stroke order
+//     int cMaxStrokes           : [in] the size of the pStrokes array
+//
+// Return Values (int):
+//      the number of the strokes replayed, which may exceed
+//      cMaxStrokes (only the first cMaxStrokes are reported)
+//
+/////////////////////////////////////////////////////////
+int CInputReplayer::Replay(
+        const CInputLog& log,
+        bool bRealTime,
+        ReplayStroke* pStrokes,
+        int cMaxStrokes
+        )
+{
+    int cStrokes = 0;
+    bool bInStroke = false;
+    m_cPoints = 0;
+
+    PERFTIME ptStart = PerfNow();
+    for (int i = 0; i < log.GetEventCount(); i++)
+    {
+        const InputEvent& ev = log.GetEvent(i);
+        if (bRealTime)
+        {
+            WaitUntil(ptStart + ev.ptTime);
+        }
+
+        switch (ev.iType)
+        {
+            case IE_STROKE_BEGIN:
+                TRACE_INSTANT("Pen down");
+                bInStroke = true;
+                m_cPoints = 0;
+                break;
+
+            case IE_PACKET:
+                if (bInStroke)
+                {
+                    AddPoint(ev.rgiArgs[0], ev.rgiArgs[1]);
+                }
+                break;
+
+            case IE_STROKE_END:
+                if (bInStroke && m_cPoints > 0)
+                {
+                    TRACE_SCOPE("Pen up to result");
+                    PERFTIME ptEnd = PerfNow();
+                    int cPoints = m_cPoints;
+                    m_cPoints = m_decimator.Decimate(m_pPoints, m_cPoints, m_pPoints);
+                    int iGesture = RecognizeStroke();
+                    PERFTIME ptLatency = PerfNow() - ptEnd;
+                    if (cStrokes < cMaxStrokes)
+                    {
+                        ReplayStroke& rs = pStrokes[cStrokes];
+                        rs.iRecorded = -1;
+                        rs.iReplayed = iGesture;
+                        rs.cPoints = cPoints;
+                        rs.cKept = m_cPoints;
+                        rs.ptLatency = ptLatency;
+                    }
+                    cStrokes++;
+                }
+                bInStroke = false;
+                m_cPoints = 0;
+                break;
+
+            case IE_GESTURE:
+                // The gesture event of the stroke that has just ended
+                if (cStrokes > 0 && cStrokes <= cMaxStrokes)
+                {
+                    pStrokes[cStrokes - 1].iRecorded = ev.rgiArgs[0];
+                }
+                break;
+
+            case IE_COMMAND:
+                if (INPUTLOG_ID_CLEAR == ev.rgiArgs[0])
+                {
+                    // The ink is deleted, including a stroke in progress
+                    bInStroke = false;
+                    m_cPoints = 0;
+                }
+                break;
+
+            case IE_GESTURE_STATUS:
+                if (ev.rgiArgs[0] >= 0 && ev.rgiArgs[0] < GE_NUM_SSGESTURES)
+                {
+                    m_rgbEnabled[ev.rgiArgs[0]] = (0 != ev.rgiArgs[1]);
+                }
+                break;
+        }
+    }
+
+    return cStrokes;
+}
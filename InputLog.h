@@ -0,0 +1,173 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      InputLog.h
+//
+// Description:
+//      This file contains the definitions of the input log classes:
+//      CInputRecorder writes the input events of a session (pen packets,
+//      stroke boundaries, gesture events, commands and gesture status
+//      changes) to a log file with nanosecond timestamps, CInputLog reads
+//      a log back, and CInputReplayer drives a CGestureEngine with it,
+//      either at the recorded pace or as fast as possible.
+//
+//      A log is a text file with one event per line:
+//
+//          # gesture input log 1
+//          <time> B                    stroke begins
+//          <time> P <x> <y>            pen packet, in ink units
+//          <time> E                    stroke ends
+//          <time> G <gesture>          gesture event, the index into
+//                                      gc_igtSingleStrokeGestures, -1 if
+//                                      the gesture was rejected
+//          <time> C <command>          menu command (ID_CLEAR, ...)
+//          <time> S <gesture> <0|1>    gesture status change
+//
+//      The time is in nanoseconds since the start of the recording.
+//      The methods of the classes are defined in the InputLog.cpp file.
+//--------------------------------------------------------------------------
+
+#pragma once
+
+#include <stdio.h>
+
+#include "PerfTimer.h"
+#include "GestureEngine.h"
+#include "StrokeDecimator.h"
+
+#define INPUTLOG_HEADER     "# gesture input log 1"
+
+// The event types, also the tags used in the log file
+enum {
+    IE_STROKE_BEGIN = 'B',
+    IE_PACKET = 'P',
+    IE_STROKE_END = 'E',
+    IE_GESTURE = 'G',
+    IE_COMMAND = 'C',
+    IE_GESTURE_STATUS = 'S'
+};
+
+// An input event
+struct InputEvent
+{
+    PERFTIME    ptTime;         // nanoseconds since the start of the recording
+    int         iType;          // IE_ constant
+    int         rgiArgs[2];     // the arguments, see the log format above
+};
+
+/////////////////////////////////////////////////////////
+//
+// class CInputRecorder
+//
+// Appends the input events to a log file as they happen.
+// The events are buffered by the C runtime and flushed
+// on Close, so recording doesn't add a disk write to
+// every pen packet.
+//
+/////////////////////////////////////////////////////////
+
+class CInputRecorder
+{
+    FILE*       m_pFile;
+    PERFTIME    m_ptStart;
+
+public:
+
+    // Constructor and destructor
+    CInputRecorder() : m_pFile(NULL), m_ptStart(0) {}
+    ~CInputRecorder() { Close(); }
+
+    bool Open(const char* pszFileName);
+    void Close();
+    bool IsOpen() const { return (NULL != m_pFile); }
+
+    void Record(int iType, int iArg0 = 0, int iArg1 = 0);
+};
+
+/////////////////////////////////////////////////////////
+//
+// class CInputLog
+//
+// An input log loaded into memory.
+//
+/////////////////////////////////////////////////////////
+
+class CInputLog
+{
+    InputEvent* m_pEvents;
+    int         m_cEvents;
+    int         m_cMaxEvents;   // allocated capacity
+
+public:
+
+    // Constructor and destructor
+    CInputLog() : m_pEvents(NULL), m_cEvents(0), m_cMaxEvents(0) {}
+    ~CInputLog() { Clear(); }
+
+    bool Load(const char* pszFileName);
+    bool Save(const char* pszFileName) const;
+    bool Append(PERFTIME ptTime, int iType, int iArg0 = 0, int iArg1 = 0);
+    void Clear();
+
+    // Data members access methods
+    int  GetEventCount() const { return m_cEvents; }
+    const InputEvent& GetEvent(int iEvent) const { return m_pEvents[iEvent]; }
+};
+
+// The outcome of a replayed stroke
+struct ReplayStroke
+{
+    int         iRecorded;      // the gesture recorded for the stroke, -1 if none
+    int         iReplayed;      // the gesture recognized on replay, -1 if none
+    int         cPoints;
+    int         cKept;          // the points left after the decimation
+    PERFTIME    ptLatency;      // from the end of the stroke to the result
+};
+
+/////////////////////////////////////////////////////////
+//
+// class CInputReplayer
+//
+// Replays a log through the headless pipeline: collects the
+// packets of each stroke, recognizes the stroke with the
+// engine when it ends, picks the best alternate among the
+// enabled gestures and applies the clear commands and the
+// gesture status changes on the way. A stroke is decimated
+// before it's recognized, as in the application, if the
+// replayer is given a tolerance. In the real time mode
+// every event is delivered at its recorded time, so the
+// latencies include the effects of the real input rate;
+// otherwise the events are delivered back to back.
+//
+/////////////////////////////////////////////////////////
+
+class CInputReplayer
+{
+    const CGestureEngine&   m_engine;
+    bool                    m_rgbEnabled[GE_NUM_SSGESTURES];
+    GesturePoint*           m_pPoints;      // the stroke being collected
+    int                     m_cPoints;
+    int                     m_cMaxPoints;
+    CStrokeDecimator        m_decimator;    // no decimation by default
+
+public:
+
+    // Constructor and destructor
+    CInputReplayer(const CGestureEngine& engine);
+    ~CInputReplayer();
+
+    int  Replay(const CInputLog& log, bool bRealTime,
+                ReplayStroke* pStrokes, int cMaxStrokes);
+    bool IsGestureEnabled(int iGesture) const { return m_rgbEnabled[iGesture]; }
+    void SetDecimation(float fTolerance) { m_decimator.SetTolerance(fTolerance); }
+
+private:
+
+    bool AddPoint(int x, int y);
+    int  RecognizeStroke() const;
+};
@@ -0,0 +1,323 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      Metrics.cpp
+//
+// Description:
+//      The file contains the definitions of the methods of the classes
+//      CLatencyHistogram and CMetrics. See the file Metrics.h for the
+//      definitions of the classes.
+//--------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <string.h>
+
+#include "Metrics.h"
+
+////////////////////////////////////////////////////////
+// CLatencyHistogram methods
+////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////
+//
+// CLatencyHistogram::GetBucket
+//
+// Returns the bucket of a value: the values below
+// MH_SUB_BUCKETS have a bucket each, the larger ones
+// share MH_SUB_BUCKETS buckets per power of two.
+//
+/////////////////////////////////////////////////////////
+int CLatencyHistogram::GetBucket(PERFTIME ptValue)
+{
+    if (ptValue < MH_SUB_BUCKETS)
+        return (int)ptValue;
+    if (ptValue > MH_MAX_VALUE)
+        return MH_BUCKETS - 1;
+
+    // The position of the highest set bit
+    int iExponent = 0;
+    PERFTIME pt = ptValue;
+    if (pt >= (1ULL << 32)) { pt >>= 32; iExponent += 32; }
+    if (pt >= (1ULL << 16)) { pt >>= 16; iExponent += 16; }
+    if (pt >= (1ULL << 8))  { pt >>= 8;  iExponent += 8; }
+    if (pt >= (1ULL << 4))  { pt >>= 4;  iExponent += 4; }
+    if (pt >= (1ULL << 2))  { pt >>= 2;  iExponent += 2; }
+    if (pt >= (1ULL << 1))  { iExponent += 1; }
+
+    int iShift = iExponent - MH_SUB_BUCKET_BITS;
+    return (iShift + 1) * MH_SUB_BUCKETS
+         + (int)(ptValue >> iShift) - MH_SUB_BUCKETS;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CLatencyHistogram::GetBucketValue
+//
+// Returns the largest value that falls into a bucket, so
+// that the percentiles never understate the latency.
+//
+/////////////////////////////////////////////////////////
+PERFTIME CLatencyHistogram::GetBucketValue(int iBucket)
+{
+    if (iBucket < MH_SUB_BUCKETS)
+        return (PERFTIME)iBucket;
+
+    int iShift = iBucket / MH_SUB_BUCKETS - 1;
+    PERFTIME ptLow = (PERFTIME)(MH_SUB_BUCKETS + iBucket % MH_SUB_BUCKETS) << iShift;
+    return ptLow + ((PERFTIME)1 << iShift) - 1;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CLatencyHistogram::Record
+//
+// Counts a value. Safe to call from several threads.
+//
+// Parameters:
+//     PERFTIME ptValue : [in] the duration, in nanoseconds
+//
+/////////////////////////////////////////////////////////
+void CLatencyHistogram::Record(PERFTIME ptValue)
+{
+    MetricsIncrement(&m_rglBuckets[GetBucket(ptValue)]);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CLatencyHistogram::Reset
+//
+// Clears the counts. Not atomic against Record; use it
+// while no thread records.
+//
+/////////////////////////////////////////////////////////
+void CLatencyHistogram::Reset()
+{
+    for (int i = 0; i < MH_BUCKETS; i++)
+    {
+        m_rglBuckets[i] = 0;
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CLatencyHistogram::Snapshot
+//
+// Copies the counts. A value recorded during the copy may
+// or may not be in it, but every bucket is read whole.
+//
+/////////////////////////////////////////////////////////
+void CLatencyHistogram::Snapshot(HistogramSnapshot& snapshot) const
+{
+    snapshot.cValues = 0;
+    for (int i = 0; i < MH_BUCKETS; i++)
+    {
+        snapshot.rgcBuckets[i] = (unsigned int)m_rglBuckets[i];
+        snapshot.cValues += snapshot.rgcBuckets[i];
+    }
+}
+
+////////////////////////////////////////////////////////
+// HistogramSnapshot methods
+////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////
+//
+// HistogramSnapshot::Subtract
+//
+// Leaves the values recorded after an older snapshot of
+// the same histogram.
+//
+/////////////////////////////////////////////////////////
+void HistogramSnapshot::Subtract(const HistogramSnapshot& older)
+{
+    for (int i = 0; i < MH_BUCKETS; i++)
+    {
+        rgcBuckets[i] -= older.rgcBuckets[i];
+    }
+    cValues -= older.cValues;
+}
+
+/////////////////////////////////////////////////////////
+//
+// HistogramSnapshot::GetPercentile
+//
+// Returns the value below which the given percentage of
+// the values fall, rounded up to the end of its bucket.
+//
+// Parameters:
+//     double dPercentile : [in] 0..100
+//
+// Return Values (PERFTIME):
+//      the value in nanoseconds, 0 if there are no values
+//
+/////////////////////////////////////////////////////////
+PERFTIME HistogramSnapshot::GetPercentile(double dPercentile) const
+{
+    if (0 == cValues)
+        return 0;
+
+    // The rank of the value, 1-based
+    unsigned int uRank = (unsigned int)(dPercentile / 100.0 * cValues + 0.5);
+    if (uRank < 1)
+        uRank = 1;
+    if (uRank > cValues)
+        uRank = cValues;
+
+    unsigned int cSeen = 0;
+    for (int i = 0; i < MH_BUCKETS; i++)
+    {
+        cSeen += rgcBuckets[i];
+        if (cSeen >= uRank)
+            return CLatencyHistogram::GetBucketValue(i);
+    }
+    return CLatencyHistogram::GetBucketValue(MH_BUCKETS - 1);
+}
+
+////////////////////////////////////////////////////////
+// CMetrics methods
+////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////
+//
+// CMetrics::RecordGesture
+//
+// Counts a gesture event and its latency.
+//
+// Parameters:
+//     bool bAccepted     : [in] false if the gesture was rejected
+//     PERFTIME ptLatency : [in] from the event to its command done, or
+//                          to the result updated if it has none
+//
+/////////////////////////////////////////////////////////
+void CMetrics::RecordGesture(bool bAccepted, PERFTIME ptLatency)
+{
+    MetricsIncrement(bAccepted ? &m_lAccepted : &m_lRejected);
+    m_histRecognition.Record(ptLatency);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CMetrics::Snapshot
+//
+// Copies the current values of all the metrics.
+//
+/////////////////////////////////////////////////////////
+void CMetrics::Snapshot(MetricsSnapshot& snapshot) const
+{
+    snapshot.ptTime = PerfNow();
+    snapshot.cAccepted = (unsigned int)m_lAccepted;
+    snapshot.cRejected = (unsigned int)m_lRejected;
+    snapshot.cGestures = snapshot.cAccepted + snapshot.cRejected;
+    m_histRecognition.Snapshot(snapshot.histRecognition);
+    m_histPaint.Snapshot(snapshot.histPaint);
+}
+
+/////////////////////////////////////////////////////////
+//
+// FormatDuration
+//
+// Prints a duration in microseconds or milliseconds, or
+// a dash if there were no values.
+//
+/////////////////////////////////////////////////////////
+static void FormatDuration(PERFTIME pt, unsigned int cValues, char* pszText, int cchText)
+{
+    if (0 == cValues)
+        snprintf(pszText, cchText, "-");
+    else if (pt < 1000000)
+        snprintf(pszText, cchText, "%.0f us", pt / 1e3);
+    else
+        snprintf(pszText, cchText, "%.1f ms", pt / 1e6);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CMetrics::Format
+//
+// Prints the metrics between two snapshots on one line,
+// for the status bar.
+//
+// Parameters:
+//     const MetricsSnapshot& current : [in] the later snapshot
+//     const MetricsSnapshot& older   : [in] the start of the window
+//     char* pszText                  : [out] the text
+//     int cchText                    : [in] the size of the pszText buffer
+//
+/////////////////////////////////////////////////////////
+void CMetrics::Format(
+        const MetricsSnapshot& current,
+        const MetricsSnapshot& older,
+        char* pszText,
+        int cchText
+        )
+{
+    HistogramSnapshot histReco = current.histRecognition;
+    HistogramSnapshot histPaint = current.histPaint;
+    histReco.Subtract(older.histRecognition);
+    histPaint.Subtract(older.histPaint);
+
+    unsigned int cGestures = current.cGestures - older.cGestures;
+    unsigned int cAccepted = current.cAccepted - older.cAccepted;
+    double dSeconds = (current.ptTime - older.ptTime) / 1e9;
+
+    char szRecoP50[16], szRecoP99[16], szPaintP50[16], szPaintP99[16];
+    FormatDuration(histReco.GetPercentile(50), histReco.cValues, szRecoP50, sizeof(szRecoP50));
+    FormatDuration(histReco.GetPercentile(99), histReco.cValues, szRecoP99, sizeof(szRecoP99));
+    FormatDuration(histPaint.GetPercentile(50), histPaint.cValues, szPaintP50, sizeof(szPaintP50));
+    FormatDuration(histPaint.GetPercentile(99), histPaint.cValues, szPaintP99, sizeof(szPaintP99));
+
+    snprintf(pszText, cchText,
+             "%.1f gestures/s   accepted %.0f%%   recognition p50 %s p99 %s   paint p50 %s p99 %s",
+             (dSeconds > 0.0) ? cGestures / dSeconds : 0.0,
+             (cGestures > 0) ? 100.0 * cAccepted / cGestures : 0.0,
+             szRecoP50, szRecoP99, szPaintP50, szPaintP99);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CMetrics::WriteLine
+//
+// Appends the metrics between two snapshots to a file as
+// one line of key=value pairs, and flushes it, so that a
+// monitoring agent tailing the file sees whole lines:
+//
+//   t=<s> gestures=<n> accepted=<n> rejected=<n> rate=<per s>
+//   reco_p50_us=<us> reco_p99_us=<us> paint_p50_us=<us> paint_p99_us=<us>
+//
+// (on one line). t is the end of the interval in seconds
+// since ptStart; the counts cover the interval only.
+//
+// Return Values (bool):
+//      true if succeeded, false otherwise
+//
+/////////////////////////////////////////////////////////
+bool CMetrics::WriteLine(
+        FILE* pFile,
+        const MetricsSnapshot& current,
+        const MetricsSnapshot& older,
+        PERFTIME ptStart
+        )
+{
+    HistogramSnapshot histReco = current.histRecognition;
+    HistogramSnapshot histPaint = current.histPaint;
+    histReco.Subtract(older.histRecognition);
+    histPaint.Subtract(older.histPaint);
+
+    unsigned int cGestures = current.cGestures - older.cGestures;
+    double dSeconds = (current.ptTime - older.ptTime) / 1e9;
+
+    fprintf(pFile, "t=%.1f gestures=%u accepted=%u rejected=%u rate=%.2f "
+            "reco_p50_us=%.1f reco_p99_us=%.1f paint_p50_us=%.1f paint_p99_us=%.1f\n",
+            (current.ptTime - ptStart) / 1e9, cGestures,
+            current.cAccepted - older.cAccepted, current.cRejected - older.cRejected,
+            (dSeconds > 0.0) ? cGestures / dSeconds : 0.0,
+            histReco.GetPercentile(50) / 1e3, histReco.GetPercentile(99) / 1e3,
+            histPaint.GetPercentile(50) / 1e3, histPaint.GetPercentile(99) / 1e3);
+
+    return (0 == fflush(pFile) && 0 == ferror(pFile));
+}
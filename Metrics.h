@@ -0,0 +1,129 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      Metrics.h
+//
+// Description:
+//      Live performance metrics: event counters and latency histograms
+//      that any thread updates with a single interlocked increment, and
+//      snapshots of them for the status bar and for the periodic dump.
+//
+//      The histograms are log-linear, in the manner of HdrHistogram:
+//      every power of two of nanoseconds is split into MH_SUB_BUCKETS
+//      linear buckets, so a percentile is exact to within 1/MH_SUB_BUCKETS
+//      (6%) of its value from 1 ns to MH_MAX_VALUE, in a fixed 2.4 KB.
+//
+//      The methods of the classes are defined in the Metrics.cpp file.
+//--------------------------------------------------------------------------
+
+#pragma once
+
+#include <stdio.h>
+
+#include "PerfTimer.h"
+
+enum {
+    MH_SUB_BUCKET_BITS = 4,
+    MH_SUB_BUCKETS = 1 << MH_SUB_BUCKET_BITS,   // the buckets per power of two
+    MH_MAX_EXPONENT = 39,                       // the largest power of two tracked
+    MH_BUCKETS = (MH_MAX_EXPONENT - MH_SUB_BUCKET_BITS + 2) * MH_SUB_BUCKETS
+};
+
+// The largest value told apart, in nanoseconds (about 18 minutes); the
+// larger values are counted in the last bucket
+#define MH_MAX_VALUE    ((1ULL << (MH_MAX_EXPONENT + 1)) - 1)
+
+// A copy of a histogram, taken without stopping the writers
+struct HistogramSnapshot
+{
+    unsigned int    rgcBuckets[MH_BUCKETS];
+    unsigned int    cValues;
+
+    void     Subtract(const HistogramSnapshot& older);
+    PERFTIME GetPercentile(double dPercentile) const;
+};
+
+/////////////////////////////////////////////////////////
+//
+// class CLatencyHistogram
+//
+// A log-linear histogram of durations in nanoseconds.
+// Record may be called from any thread at any time.
+//
+/////////////////////////////////////////////////////////
+
+class CLatencyHistogram
+{
+    volatile long   m_rglBuckets[MH_BUCKETS];
+
+public:
+
+    CLatencyHistogram() { Reset(); }
+
+    void Record(PERFTIME ptValue);
+    void Reset();
+    void Snapshot(HistogramSnapshot& snapshot) const;
+
+    // Bucket math, shared with the snapshots
+    static int      GetBucket(PERFTIME ptValue);
+    static PERFTIME GetBucketValue(int iBucket);
+};
+
+// A copy of all the metrics at one time
+struct MetricsSnapshot
+{
+    PERFTIME            ptTime;         // PerfNow when taken
+    unsigned int        cGestures;      // gesture events
+    unsigned int        cAccepted;      // recognized as an enabled gesture
+    unsigned int        cRejected;      // IDS_GESTURE_UNKNOWN
+    HistogramSnapshot   histRecognition;
+    HistogramSnapshot   histPaint;
+};
+
+/////////////////////////////////////////////////////////
+//
+// class CMetrics
+//
+// The metrics of the application: the gesture counters, the
+// recognition latency (from the gesture event to its command
+// done, or to the result updated if it runs none) and the
+// paint time of the child windows.
+//
+/////////////////////////////////////////////////////////
+
+class CMetrics
+{
+    volatile long       m_lAccepted;
+    volatile long       m_lRejected;
+    CLatencyHistogram   m_histRecognition;
+    CLatencyHistogram   m_histPaint;
+
+public:
+
+    CMetrics() : m_lAccepted(0), m_lRejected(0) {}
+
+    void RecordGesture(bool bAccepted, PERFTIME ptLatency);
+    void RecordPaint(PERFTIME ptDuration) { m_histPaint.Record(ptDuration); }
+    void Snapshot(MetricsSnapshot& snapshot) const;
+
+    // Formatting of the difference between two snapshots
+    static void Format(const MetricsSnapshot& current, const MetricsSnapshot& older,
+                       char* pszText, int cchText);
+    static bool WriteLine(FILE* pFile, const MetricsSnapshot& current,
+                          const MetricsSnapshot& older, PERFTIME ptStart);
+};
+
+// Atomically increments a counter, returns the new value
+inline long MetricsIncrement(volatile long* pl)
+{
+#ifdef _WIN32
+    return ::InterlockedIncrement(pl);
+#else
+    return __sync_add_and_fetch(pl, 1);
+#endif
+}
@@ -0,0 +1,204 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      PacketInput.cpp
+//
+// Description:
+//      The file contains the definitions of the methods of the class
+//      CPacketInput. See the file PacketInput.h for the definition of
+//      the class.
+//--------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "PacketInput.h"
+
+/////////////////////////////////////////////////////////
+//
+// CPacketInput::CPacketInput
+//
+// Constructor. Every packet is drawn at once and kept for
+// the recognition until the settings say otherwise.
+//
+/////////////////////////////////////////////////////////
+CPacketInput::CPacketInput()
+    : m_ptFrameTime(0), m_ptFrameDue(0), m_fMinMove(0),
+      m_pFrame(NULL), m_cFrame(0), m_cMaxFrame(0), m_bLastDrawn(false),
+      m_fSpacing(0), m_pReco(NULL), m_cReco(0), m_cMaxReco(0),
+      m_fCarry(0), m_cPackets(0)
+{
+    m_ptDrawn.x = m_ptDrawn.y = 0;
+    m_ptLast.x = m_ptLast.y = 0;
+}
+
+CPacketInput::~CPacketInput()
+{
+    free(m_pFrame);
+    free(m_pReco);
+}
+
+// Appends a point to an array that grows by doubling
+bool CPacketInput::Append(
+        GesturePoint** ppPoints,
+        int* pcPoints,
+        int* pcMaxPoints,
+        float x,
+        float y
+        )
+{
+    if (*pcPoints == *pcMaxPoints)
+    {
+        int cMaxPoints = (0 == *pcMaxPoints) ? 256 : 2 * *pcMaxPoints;
+        GesturePoint* pPoints =
+            (GesturePoint*)realloc(*ppPoints, cMaxPoints * sizeof(GesturePoint));
+        if (NULL == pPoints)
+            return false;
+        *ppPoints = pPoints;
+        *pcMaxPoints = cMaxPoints;
+    }
+    GesturePoint& pt = (*ppPoints)[(*pcPoints)++];
+    pt.x = x;
+    pt.y = y;
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CPacketInput::BeginStroke
+//
+// A new stroke begins; its first packet will be drawn as
+// soon as it comes.
+//
+/////////////////////////////////////////////////////////
+void CPacketInput::BeginStroke()
+{
+    m_cFrame = 0;
+    m_ptFrameDue = 0;
+    m_bLastDrawn = false;
+    m_cReco = 0;
+    m_fCarry = 0;
+    m_cPackets = 0;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CPacketInput::AddPacket
+//
+// Takes a packet of the stroke: queues it to be drawn with
+// the frame unless it's within the smallest visible step
+// of the last point queued, and puts a recognition point
+// every m_fSpacing along the segment from the last packet.
+//
+// Parameters:
+//     float x, float y  : [in] the packet position, in ink units
+//
+// Return Values (bool):
+//      true if succeeded, false if out of memory
+//
+/////////////////////////////////////////////////////////
+bool CPacketInput::AddPacket(float x, float y)
+{
+    // The render path
+    float dx = x - m_ptDrawn.x;
+    float dy = y - m_ptDrawn.y;
+    m_bLastDrawn = false;
+    if (0 == m_cPackets || dx * dx + dy * dy >= m_fMinMove * m_fMinMove)
+    {
+        if (false == Append(&m_pFrame, &m_cFrame, &m_cMaxFrame, x, y))
+            return false;
+        m_ptDrawn.x = x;
+        m_ptDrawn.y = y;
+        m_bLastDrawn = true;
+    }
+
+    // The recognition path: the first packet as is, then a point at
+    // every m_fSpacing along the path, the carry being the path
+    // since the last point
+    if (0 == m_cPackets || 0 == m_fSpacing)
+    {
+        if (false == Append(&m_pReco, &m_cReco, &m_cMaxReco, x, y))
+            return false;
+    }
+    else
+    {
+        float xFrom = m_ptLast.x;
+        float yFrom = m_ptLast.y;
+        float fSegment = sqrtf((x - xFrom) * (x - xFrom) + (y - yFrom) * (y - yFrom));
+        while (m_fCarry + fSegment >= m_fSpacing && fSegment > 0)
+        {
+            float t = (m_fSpacing - m_fCarry) / fSegment;
+            xFrom += t * (x - xFrom);
+            yFrom += t * (y - yFrom);
+            if (false == Append(&m_pReco, &m_cReco, &m_cMaxReco, xFrom, yFrom))
+                return false;
+            fSegment -= m_fSpacing - m_fCarry;
+            m_fCarry = 0;
+        }
+        m_fCarry += fSegment;
+    }
+
+    m_ptLast.x = x;
+    m_ptLast.y = y;
+    m_cPackets++;
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CPacketInput::EndStroke
+//
+// The pen is up: the last packet is queued to be drawn and
+// ends the recognition points, if it isn't there yet. The
+// frame is due at once.
+//
+// Return Values (bool):
+//      true if succeeded, false if out of memory
+//
+/////////////////////////////////////////////////////////
+bool CPacketInput::EndStroke()
+{
+    if (0 == m_cPackets)
+        return true;
+    if (false == m_bLastDrawn)
+    {
+        if (false == Append(&m_pFrame, &m_cFrame, &m_cMaxFrame, m_ptLast.x, m_ptLast.y))
+            return false;
+        m_ptDrawn = m_ptLast;
+        m_bLastDrawn = true;
+    }
+    m_ptFrameDue = 0;
+
+    if (m_fSpacing > 0 && m_cPackets > 1 && m_fCarry > 0)
+    {
+        if (false == Append(&m_pReco, &m_cReco, &m_cMaxReco, m_ptLast.x, m_ptLast.y))
+            return false;
+        m_fCarry = 0;
+    }
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CPacketInput::TakeFrame
+//
+// The points of the frame are drawn: empties the frame,
+// and makes the next one due a frame time after this one
+// was, so the frames keep to their cadence however the
+// packets fall between them. A frame drawn late, or the
+// first of a stroke, starts the cadence again.
+//
+/////////////////////////////////////////////////////////
+void CPacketInput::TakeFrame(PERFTIME ptNow)
+{
+    m_cFrame = 0;
+    if (0 == m_ptFrameDue || ptNow >= m_ptFrameDue + m_ptFrameTime)
+        m_ptFrameDue = ptNow + m_ptFrameTime;
+    else
+        m_ptFrameDue += m_ptFrameTime;
+}
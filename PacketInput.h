@@ -0,0 +1,107 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      PacketInput.h
+//
+// Description:
+//      This file contains the definition of the CPacketInput class, the
+//      stage between the digitizer and the rest of the application that
+//      makes the work of a stroke independent of the packet rate of the
+//      pen, which ranges from 60 Hz to 1 kHz and more.
+//
+//      The render path coalesces the packets of a frame: the ink is drawn
+//      once a frame, with all the packets since the last one, and a packet
+//      that moves less than the smallest visible step from the last one
+//      drawn isn't drawn at all. The first packet of a stroke is drawn at
+//      once, so the ink still starts under the pen.
+//
+//      The recognition path resamples the stroke to a fixed spacing along
+//      its path, interpolating between the packets, as it comes in: the
+//      points a stroke is recognized from (and decimated, stored and sent
+//      from) depend on its length, not on the device. The recognition
+//      points have no time: the clock only sets the frames.
+//
+//      The methods of the class are defined in the PacketInput.cpp file.
+//--------------------------------------------------------------------------
+
+#pragma once
+
+#include "PerfTimer.h"
+#include "GestureEngine.h"
+
+#define PI_DEFAULT_SPACING      50.0f       // in ink units (HIMETRIC, 0.01 mm)
+#define PI_DEFAULT_FRAME_TIME   16666667ULL // 60 frames a second, in ns
+
+/////////////////////////////////////////////////////////
+//
+// class CPacketInput
+//
+// The packets of the stroke being drawn. The points of a
+// frame and of the recognition grow with the stroke and
+// are reused, so an input isn't shared between threads.
+//
+/////////////////////////////////////////////////////////
+
+class CPacketInput
+{
+    // The render path
+    PERFTIME        m_ptFrameTime;
+    PERFTIME        m_ptFrameDue;       // when the frame coalescing is drawn
+    float           m_fMinMove;         // in ink units, 0 draws every packet
+    GesturePoint*   m_pFrame;           // the points to draw
+    int             m_cFrame;
+    int             m_cMaxFrame;
+    GesturePoint    m_ptDrawn;          // the last point queued to draw
+    bool            m_bLastDrawn;       // the last packet is m_ptDrawn
+
+    // The recognition path
+    float           m_fSpacing;         // 0 keeps every packet
+    GesturePoint*   m_pReco;
+    int             m_cReco;
+    int             m_cMaxReco;
+    GesturePoint    m_ptLast;           // the last packet
+    float           m_fCarry;           // the path from the last point to it
+    int             m_cPackets;
+
+public:
+
+    // Constructor and destructor
+    CPacketInput();
+    ~CPacketInput();
+
+    // Settings
+    void SetFrameTime(PERFTIME ptFrameTime) { m_ptFrameTime = ptFrameTime; }
+    void SetMinMove(float fMinMove) { m_fMinMove = (fMinMove > 0) ? fMinMove : 0; }
+    void SetSpacing(float fSpacing) { m_fSpacing = (fSpacing > 0) ? fSpacing : 0; }
+    float GetSpacing() const { return m_fSpacing; }
+
+    // The packets
+    void BeginStroke();
+    bool AddPacket(float x, float y);
+    bool EndStroke();
+
+    // The render path
+    bool IsFrameDue(PERFTIME ptNow) const { return m_cFrame > 0 && ptNow >= m_ptFrameDue; }
+    const GesturePoint* GetFramePoints() const { return m_pFrame; }
+    int  GetFramePointCount() const { return m_cFrame; }
+    void TakeFrame(PERFTIME ptNow);
+
+    // The recognition path
+    const GesturePoint* GetPoints() const { return m_pReco; }
+    int  GetPointCount() const { return m_cReco; }
+    int  GetPacketCount() const { return m_cPackets; }
+
+private:
+
+    static bool Append(GesturePoint** ppPoints, int* pcPoints, int* pcMaxPoints,
+                       float x, float y);
+
+    // Not copyable
+    CPacketInput(const CPacketInput&);
+    CPacketInput& operator=(const CPacketInput&);
+};
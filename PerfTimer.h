@@ -0,0 +1,61 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      PerfTimer.h
+//
+// Description:
+//      A monotonic high resolution clock shared by the recognition
+//      engine, the benchmark tools and the instrumentation code.
+//      PerfNow returns nanoseconds since an arbitrary fixed origin.
+//
+//--------------------------------------------------------------------------
+
+#pragma once
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+typedef unsigned long long PERFTIME;    // nanoseconds
+
+/////////////////////////////////////////////////////////
+//
+// PerfNow
+//
+// Returns the current value of the monotonic clock in
+// nanoseconds. On Windows the QueryPerformanceCounter
+// frequency is read once and cached.
+//
+/////////////////////////////////////////////////////////
+inline PERFTIME PerfNow()
+{
+#ifdef _WIN32
+    static LONGLONG s_llFreq = 0;
+    if (0 == s_llFreq)
+    {
+        LARGE_INTEGER li;
+        ::QueryPerformanceFrequency(&li);
+        s_llFreq = li.QuadPart;
+    }
+    LARGE_INTEGER liNow;
+    ::QueryPerformanceCounter(&liNow);
+    // Split the conversion to avoid overflowing 64 bits on long uptimes
+    LONGLONG llSec = liNow.QuadPart / s_llFreq;
+    LONGLONG llRem = liNow.QuadPart % s_llFreq;
+    return (PERFTIME)llSec * 1000000000ULL + (PERFTIME)(llRem * 1000000000LL / s_llFreq);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (PERFTIME)ts.tv_sec * 1000000000ULL + (PERFTIME)ts.tv_nsec;
+#endif
+}
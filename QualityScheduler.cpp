@@ -0,0 +1,285 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      QualityScheduler.cpp
+//
+// Description:
+//      The file contains the definitions of the methods of the classes
+//      CQualityTiers and CQualityScheduler. See the file QualityScheduler.h
+//      for the definitions of the classes.
+//--------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "QualityScheduler.h"
+
+// A useful macro to determine the number of elements in the array
+#ifndef countof
+#define countof(array)  (sizeof(array)/sizeof(array[0]))
+#endif
+
+#define QS_DEG2RAD(d)           ((d) * 3.14159265f / 180.0f)
+#define QS_CALIBRATE_POINTS     256
+#define QS_CALIBRATE_ROUNDS     5
+#define QS_WINDOW_TIME          250000000ULL    // the longest a p99 window lasts
+#define QS_IDLE_TIME            100000000ULL    // no batch for this long is idle
+#define QS_COST_SHIFT           3               // the cost is an average over ~8 batches
+
+// The tiers, best first. The rotation search of the lower ones takes
+// 4 and 1 steps against about 8, on half and a quarter of the points
+static const QualityTier gc_rgTiers[QS_NUM_TIERS] = {
+    { "full",       -1.0f,  0.0f,   1,  0  },
+    { "reduced",    10.0f,  4.0f,   1,  32 },
+    { "coarse",     6.0f,   6.0f,   2,  16 },
+    { "minimal",    0.0f,   0.0f,   4,  8  }
+};
+
+// Tiers ////////////////////////////////////////////////
+
+const QualityTier& CQualityTiers::GetTier(int iTier)
+{
+    return gc_rgTiers[iTier];
+}
+
+/////////////////////////////////////////////////////////
+//
+// CQualityTiers::Create
+//
+// Makes the engines of the tiers from an engine, which
+// needn't outlive them (the templates are copied, or
+// attached if the engine attached them), and measures
+// what a stroke costs with each.
+//
+// Return Values (bool):
+//      true if succeeded, false if out of memory
+//
+/////////////////////////////////////////////////////////
+bool CQualityTiers::Create(const CGestureEngine& engine)
+{
+    for (int i = 0; i < QS_NUM_TIERS; i++)
+    {
+        const QualityTier& tier = gc_rgTiers[i];
+        CGestureEngine& tierEngine = m_rgEngines[i];
+        if (false == tierEngine.Copy(engine))
+            return false;
+        if (tier.fAngleRange >= 0.0f)
+            tierEngine.SetAngleSearch(QS_DEG2RAD(tier.fAngleRange), QS_DEG2RAD(tier.fAnglePrecision));
+        tierEngine.SetPointStep(tier.iPointStep);
+
+        // Fewer candidates only where the engine has an index to
+        // pick them with; the tiers never match more than tier 0
+        int cCandidates = engine.GetCandidateCount();
+        if (cCandidates > 0 && tier.cMaxCandidates > 0 && tier.cMaxCandidates < cCandidates)
+            tierEngine.SetCandidateCount(tier.cMaxCandidates);
+    }
+    Calibrate();
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CQualityTiers::Calibrate
+//
+// Recognizes the built-in shapes with every tier, in
+// batches, a few times, and keeps the fastest time per
+// stroke of each: the cost a scheduler starts with.
+//
+/////////////////////////////////////////////////////////
+void CQualityTiers::Calibrate()
+{
+    int cShapes = CGestureEngine::GetBuiltinShapeCount();
+    if (cShapes > GE_MAX_BATCH)
+        cShapes = GE_MAX_BATCH;
+    GesturePoint* pPoints = (GesturePoint*)malloc(
+                                (size_t)cShapes * QS_CALIBRATE_POINTS * sizeof(GesturePoint));
+    GestureResult* pResults = (GestureResult*)malloc(
+                                (size_t)cShapes * GE_NUM_SSGESTURES * sizeof(GestureResult));
+    GestureStroke rgStrokes[GE_MAX_BATCH];
+    int rgcResults[GE_MAX_BATCH];
+    if (NULL == pPoints || NULL == pResults)
+    {
+        // Unmeasured, the tiers are taken to cost nothing: the
+        // scheduler then works from the latencies alone
+        memset(m_rgptCost, 0, sizeof(m_rgptCost));
+        free(pPoints);
+        free(pResults);
+        return;
+    }
+
+    for (int i = 0; i < cShapes; i++)
+    {
+        int iGesture;
+        rgStrokes[i].ppt = pPoints + (size_t)i * QS_CALIBRATE_POINTS;
+        rgStrokes[i].cPoints = CGestureEngine::GetBuiltinShape(
+                                    i, iGesture, pPoints + (size_t)i * QS_CALIBRATE_POINTS,
+                                    QS_CALIBRATE_POINTS);
+    }
+
+    for (int iTier = 0; iTier < QS_NUM_TIERS; iTier++)
+    {
+        PERFTIME ptBest = 0;
+        for (int r = 0; r < QS_CALIBRATE_ROUNDS; r++)
+        {
+            PERFTIME ptStart = PerfNow();
+            m_rgEngines[iTier].RecognizeBatch(rgStrokes, cShapes, pResults,
+                                              GE_NUM_SSGESTURES, rgcResults);
+            PERFTIME pt = PerfNow() - ptStart;
+            if (0 == r || pt < ptBest)
+                ptBest = pt;
+        }
+        m_rgptCost[iTier] = ptBest / cShapes;
+    }
+
+    free(pPoints);
+    free(pResults);
+}
+
+// Scheduler ////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////
+//
+// CQualityScheduler::CQualityScheduler
+//
+// Constructor. Until Create is called every batch gets
+// tier 0.
+//
+/////////////////////////////////////////////////////////
+CQualityScheduler::CQualityScheduler()
+    : m_pTiers(NULL), m_ptBudget(0), m_iBestTier(0), m_cWindow(0),
+      m_ptWindowStart(0), m_ptLastBatch(0)
+{
+    memset(m_rgptCost, 0, sizeof(m_rgptCost));
+}
+
+/////////////////////////////////////////////////////////
+//
+// CQualityScheduler::Create
+//
+// Sets the tiers to pick from and the p99 latency to keep
+// to; a budget of 0 keeps to tier 0.
+//
+/////////////////////////////////////////////////////////
+void CQualityScheduler::Create(const CQualityTiers* pTiers, PERFTIME ptBudget)
+{
+    m_pTiers = pTiers;
+    m_ptBudget = ptBudget;
+    for (int i = 0; i < QS_NUM_TIERS; i++)
+        m_rgptCost[i] = (NULL != pTiers) ? pTiers->GetCost(i) : 0;
+    m_iBestTier = 0;
+    m_cWindow = 0;
+    m_ptWindowStart = m_ptLastBatch = PerfNow();
+}
+
+/////////////////////////////////////////////////////////
+//
+// CQualityScheduler::ChooseTier
+//
+// Picks the tier of the next batch: the best one, from
+// the best allowed, at which the strokes queued would all
+// be answered within the budget. After an idle spell the
+// queue has long drained, and every tier is allowed again.
+//
+// Parameters:
+//     int cQueued        : [in] the strokes to recognize, the batch's
+//                          and the ones behind it
+//     PERFTIME ptWaited  : [in] how long the oldest of them has waited
+//
+// Return Values (int):
+//      the tier, 0 to QS_NUM_TIERS - 1
+//
+/////////////////////////////////////////////////////////
+int CQualityScheduler::ChooseTier(int cQueued, PERFTIME ptWaited)
+{
+    if (NULL == m_pTiers || 0 == m_ptBudget)
+        return 0;
+
+    if (PerfNow() - m_ptLastBatch > QS_IDLE_TIME)
+        m_iBestTier = 0;
+
+    for (int iTier = m_iBestTier; iTier < QS_NUM_TIERS - 1; iTier++)
+    {
+        if (ptWaited + cQueued * m_rgptCost[iTier] <= m_ptBudget)
+            return iTier;
+    }
+    return QS_NUM_TIERS - 1;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CQualityScheduler::RecordBatch
+//
+// Folds the time a batch took into the cost of its tier,
+// a moving average over the last batches or so, since the
+// cost per stroke depends on the size of the batches and
+// on what else the machine runs.
+//
+/////////////////////////////////////////////////////////
+void CQualityScheduler::RecordBatch(int iTier, int cStrokes, PERFTIME ptRecognize)
+{
+    m_ptLastBatch = PerfNow();
+    if (cStrokes <= 0)
+        return;
+    long long llCost = (long long)m_rgptCost[iTier];
+    long long llSample = (long long)(ptRecognize / cStrokes);
+    m_rgptCost[iTier] = (PERFTIME)(llCost + ((llSample - llCost) >> QS_COST_SHIFT));
+}
+
+// qsort comparer for the latencies
+static int ComparePerfTimes(const void* pv1, const void* pv2)
+{
+    PERFTIME pt1 = *(const PERFTIME*)pv1;
+    PERFTIME pt2 = *(const PERFTIME*)pv2;
+    return (pt1 < pt2) ? -1 : (pt1 > pt2) ? 1 : 0;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CQualityScheduler::RecordLatency
+//
+// Records the latency of a stroke, from the time its
+// request was read to the time its response was queued.
+// The best tier allowed is revised every QS_WINDOW strokes,
+// or every QS_WINDOW_TIME when fewer come in.
+//
+/////////////////////////////////////////////////////////
+void CQualityScheduler::RecordLatency(PERFTIME ptLatency)
+{
+    if (NULL == m_pTiers || 0 == m_ptBudget)
+        return;
+    m_rgptWindow[m_cWindow++] = ptLatency;
+    if (QS_WINDOW == m_cWindow || PerfNow() - m_ptWindowStart > QS_WINDOW_TIME)
+        AdjustBestTier();
+}
+
+/////////////////////////////////////////////////////////
+//
+// CQualityScheduler::AdjustBestTier
+//
+// Steps the best tier allowed down if the p99 of the
+// window is over the budget: the queue doesn't tell the
+// whole wait (other loops, other processes, the time a
+// request sat in its socket), and the lower tiers make
+// room for it. Steps it back up if the p99 is under half
+// the budget, so a tier is never left for its neighbour
+// and back on every window.
+//
+/////////////////////////////////////////////////////////
+void CQualityScheduler::AdjustBestTier()
+{
+    qsort(m_rgptWindow, m_cWindow, sizeof(PERFTIME), ComparePerfTimes);
+    PERFTIME ptP99 = m_rgptWindow[(m_cWindow * 99) / 100];
+
+    if (ptP99 > m_ptBudget && m_iBestTier < QS_NUM_TIERS - 1)
+        m_iBestTier++;
+    else if (ptP99 < m_ptBudget / 2 && m_iBestTier > 0)
+        m_iBestTier--;
+
+    m_cWindow = 0;
+    m_ptWindowStart = PerfNow();
+}
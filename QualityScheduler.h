@@ -0,0 +1,121 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      QualityScheduler.h
+//
+// Description:
+//      This file contains the definitions of the classes that trade the
+//      recognition quality for latency under load: a few quality tiers,
+//      copies of one engine that match with less effort each, and a
+//      scheduler that picks the tier of every batch so that the 99th
+//      percentile latency stays within a budget.
+//
+//      Tier 0 is the engine as it's given. The others narrow the rotation
+//      search, match fewer of the resampled points (see
+//      CGestureEngine::SetPointStep) and, with a template index, fewer
+//      candidates. The scheduler looks ahead and back: a batch gets the
+//      best tier that answers all the strokes queued within the budget
+//      at the cost measured for the tier, and the best tier it may pick
+//      goes down a step when the p99 of the latencies measured is over
+//      the budget, and back up when it's well under, so an idle service
+//      always recognizes at full quality.
+//
+//      The methods of the classes are defined in the QualityScheduler.cpp
+//      file.
+//--------------------------------------------------------------------------
+
+#pragma once
+
+#include "PerfTimer.h"
+#include "GestureEngine.h"
+
+enum {
+    QS_NUM_TIERS = 4,           // tier 0 is the full quality
+    QS_WINDOW = 256             // the latencies a p99 is taken over
+};
+
+// How an engine of a tier recognizes
+struct QualityTier
+{
+    const char*     pszName;
+    float           fAngleRange;        // degrees each way, < 0 as the engine given
+    float           fAnglePrecision;    // degrees
+    int             iPointStep;
+    int             cMaxCandidates;     // with an index, 0 as the engine given
+};
+
+/////////////////////////////////////////////////////////
+//
+// class CQualityTiers
+//
+// The engines of the tiers and what a stroke costs with
+// each, measured on the built-in shapes. Unchanged once
+// created, so the event loops of a service share them.
+//
+/////////////////////////////////////////////////////////
+
+class CQualityTiers
+{
+    CGestureEngine  m_rgEngines[QS_NUM_TIERS];
+    PERFTIME        m_rgptCost[QS_NUM_TIERS];   // per stroke, in a batch
+
+public:
+
+    bool Create(const CGestureEngine& engine);
+
+    const CGestureEngine& GetEngine(int iTier) const { return m_rgEngines[iTier]; }
+    PERFTIME GetCost(int iTier) const { return m_rgptCost[iTier]; }
+
+    static const QualityTier& GetTier(int iTier);
+    static const char* GetTierName(int iTier) { return GetTier(iTier).pszName; }
+
+private:
+
+    void Calibrate();
+};
+
+/////////////////////////////////////////////////////////
+//
+// class CQualityScheduler
+//
+// Picks the tier of the batches of one event loop, and is
+// told what they cost and how long their strokes waited.
+// Called by one thread at a time.
+//
+/////////////////////////////////////////////////////////
+
+class CQualityScheduler
+{
+    const CQualityTiers*    m_pTiers;
+    PERFTIME                m_ptBudget;         // the p99 aimed at
+    PERFTIME                m_rgptCost[QS_NUM_TIERS];   // measured, per stroke
+    int                     m_iBestTier;        // the best tier a batch may get
+    PERFTIME                m_rgptWindow[QS_WINDOW];
+    int                     m_cWindow;
+    PERFTIME                m_ptWindowStart;
+    PERFTIME                m_ptLastBatch;
+
+public:
+
+    // Constructor
+    CQualityScheduler();
+
+    void Create(const CQualityTiers* pTiers, PERFTIME ptBudget);
+
+    int  ChooseTier(int cQueued, PERFTIME ptWaited);
+    void RecordBatch(int iTier, int cStrokes, PERFTIME ptRecognize);
+    void RecordLatency(PERFTIME ptLatency);
+
+    // Data members access methods
+    int  GetBestTier() const { return m_iBestTier; }
+    PERFTIME GetBudget() const { return m_ptBudget; }
+
+private:
+
+    void AdjustBestTier();
+};
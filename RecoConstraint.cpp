@@ -0,0 +1,466 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      RecoConstraint.cpp
+//
+// Description:
+//      The file contains the definitions of the methods of the classes
+//      IRecoConstraint, CFactoid and CLatticeSearch, and the automata of
+//      the factoids. See the file RecoConstraint.h for the definitions of
+//      the classes.
+//--------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "RecoConstraint.h"
+
+// A useful macro to determine the number of elements in the array
+#ifndef countof
+#define countof(array)  (sizeof(array)/sizeof(array[0]))
+#endif
+
+// The character classes of the factoids' transitions
+enum {
+    FC_DIGIT = 0x01,
+    FC_UPPER = 0x02,
+    FC_LOWER = 0x04,
+    FC_ALPHA = FC_UPPER | FC_LOWER,
+    FC_ALNUM = FC_DIGIT | FC_ALPHA
+};
+
+// A transition of a factoid's automaton: the bytes of the classes and
+// the bytes of the string lead from one state to the other. The first
+// transition of a state that takes a byte wins.
+struct FactoidArc
+{
+    unsigned char   uFrom;
+    unsigned char   uTo;
+    unsigned char   uClasses;
+    const char*     pszChars;
+};
+
+// A factoid: the name, the transitions and the final states
+struct FactoidGrammar
+{
+    const char*         pszName;
+    const FactoidArc*   pArcs;
+    int                 cArcs;
+    unsigned int        uFinalStates;
+};
+
+#define FS(s)   (1u << (s))
+
+// One or more digits
+static const FactoidArc gc_rgDigitArcs[] = {
+    { 0, 1, FC_DIGIT, NULL }, { 1, 1, FC_DIGIT, NULL },
+};
+
+// An optional sign, digits and groups of digits after a point or a comma
+static const FactoidArc gc_rgNumberArcs[] = {
+    { 0, 1, 0, "+-" }, { 0, 2, FC_DIGIT, NULL }, { 1, 2, FC_DIGIT, NULL },
+    { 2, 2, FC_DIGIT, NULL }, { 2, 3, 0, ".," },
+    { 3, 4, FC_DIGIT, NULL }, { 4, 4, FC_DIGIT, NULL }, { 4, 3, 0, ".," },
+};
+
+// d/m/yy or dd-mm-yyyy and the like: one or two digits twice, then two
+// or four, apart by a slash, a dash or a point
+static const FactoidArc gc_rgDateArcs[] = {
+    { 0, 1, FC_DIGIT, NULL }, { 1, 2, FC_DIGIT, NULL }, { 1, 3, 0, "/-." }, { 2, 3, 0, "/-." },
+    { 3, 4, FC_DIGIT, NULL }, { 4, 5, FC_DIGIT, NULL }, { 4, 6, 0, "/-." }, { 5, 6, 0, "/-." },
+    { 6, 7, FC_DIGIT, NULL }, { 7, 8, FC_DIGIT, NULL }, { 8, 9, FC_DIGIT, NULL },
+    { 9, 10, FC_DIGIT, NULL },
+};
+
+// h:mm or hh:mm:ss, then AM or PM, with or without a space
+static const FactoidArc gc_rgTimeArcs[] = {
+    { 0, 1, FC_DIGIT, NULL }, { 1, 2, FC_DIGIT, NULL }, { 1, 3, 0, ":" }, { 2, 3, 0, ":" },
+    { 3, 4, FC_DIGIT, NULL }, { 4, 5, FC_DIGIT, NULL },
+    { 5, 6, 0, ":" }, { 6, 7, FC_DIGIT, NULL }, { 7, 8, FC_DIGIT, NULL },
+    { 5, 9, 0, " " }, { 8, 9, 0, " " },
+    { 5, 10, 0, "AaPp" }, { 8, 10, 0, "AaPp" }, { 9, 10, 0, "AaPp" }, { 10, 11, 0, "Mm" },
+};
+
+// local@host.domain
+static const FactoidArc gc_rgEmailArcs[] = {
+    { 0, 1, FC_ALNUM, "._%+-" }, { 1, 1, FC_ALNUM, "._%+-" }, { 1, 2, 0, "@" },
+    { 2, 3, FC_ALNUM, NULL }, { 3, 3, FC_ALNUM, "-" }, { 3, 4, 0, "." },
+    { 4, 5, FC_ALNUM, NULL }, { 5, 5, FC_ALNUM, "-" }, { 5, 4, 0, "." },
+};
+
+// host.domain[/path] or scheme://host.domain[/path]
+static const FactoidArc gc_rgWebArcs[] = {
+    { 0, 1, FC_ALNUM, NULL }, { 1, 1, FC_ALNUM, "-" }, { 1, 2, 0, "." }, { 1, 5, 0, ":" },
+    { 2, 3, FC_ALNUM, NULL }, { 3, 3, FC_ALNUM, "-" }, { 3, 2, 0, "." }, { 3, 4, 0, "/" },
+    { 4, 4, FC_ALNUM, "-._~/?#=&%+:@" },
+    { 5, 6, 0, "/" }, { 6, 7, 0, "/" },
+    { 7, 8, FC_ALNUM, NULL }, { 8, 8, FC_ALNUM, "-" }, { 8, 9, 0, "." },
+    { 9, 10, FC_ALNUM, NULL }, { 10, 10, FC_ALNUM, "-" }, { 10, 9, 0, "." }, { 10, 4, 0, "/" },
+};
+
+// +1 (425) 555-0100 and the like: groups of digits apart by a space, a
+// dash or a point, an optional + and area code in parentheses
+static const FactoidArc gc_rgTelephoneArcs[] = {
+    { 0, 1, 0, "+" }, { 0, 2, 0, "(" }, { 0, 3, FC_DIGIT, NULL }, { 1, 3, FC_DIGIT, NULL },
+    { 2, 4, FC_DIGIT, NULL }, { 4, 4, FC_DIGIT, NULL }, { 4, 5, 0, ")" },
+    { 5, 6, 0, " " }, { 5, 3, FC_DIGIT, NULL }, { 6, 3, FC_DIGIT, NULL },
+    { 3, 3, FC_DIGIT, NULL }, { 3, 7, 0, " -." }, { 7, 3, FC_DIGIT, NULL }, { 7, 2, 0, "(" },
+};
+
+// A US ZIP code: 5 digits, or 5 digits, a dash and 4 digits
+static const FactoidArc gc_rgPostalCodeArcs[] = {
+    { 0, 1, FC_DIGIT, NULL }, { 1, 2, FC_DIGIT, NULL }, { 2, 3, FC_DIGIT, NULL },
+    { 3, 4, FC_DIGIT, NULL }, { 4, 5, FC_DIGIT, NULL }, { 5, 6, 0, "-" },
+    { 6, 7, FC_DIGIT, NULL }, { 7, 8, FC_DIGIT, NULL }, { 8, 9, FC_DIGIT, NULL },
+    { 9, 10, FC_DIGIT, NULL },
+};
+
+// $1,234.56: a dollar sign, digits with comma groups, and no cents or two
+static const FactoidArc gc_rgCurrencyArcs[] = {
+    { 0, 1, 0, "$" }, { 1, 2, FC_DIGIT, NULL }, { 2, 2, FC_DIGIT, NULL }, { 2, 3, 0, "," },
+    { 3, 2, FC_DIGIT, NULL }, { 2, 4, 0, "." }, { 4, 5, FC_DIGIT, NULL },
+    { 5, 6, FC_DIGIT, NULL },
+};
+
+// A single capital letter, for the boxes of a guide
+static const FactoidArc gc_rgUpperCharArcs[] = {
+    { 0, 1, FC_UPPER, NULL },
+};
+
+// The factoids, indexed by the RC_FACTOID_ constants. The names are the
+// ones of the Tablet PC factoids.
+static const FactoidGrammar gc_rgFactoids[RC_NUM_FACTOIDS] = {
+    { "DIGIT", gc_rgDigitArcs, countof(gc_rgDigitArcs), FS(1) },
+    { "NUMBER", gc_rgNumberArcs, countof(gc_rgNumberArcs), FS(2) | FS(4) },
+    { "DATE", gc_rgDateArcs, countof(gc_rgDateArcs), FS(8) | FS(10) },
+    { "TIME", gc_rgTimeArcs, countof(gc_rgTimeArcs), FS(5) | FS(8) | FS(11) },
+    { "EMAIL", gc_rgEmailArcs, countof(gc_rgEmailArcs), FS(5) },
+    { "WEB", gc_rgWebArcs, countof(gc_rgWebArcs), FS(3) | FS(4) | FS(10) },
+    { "TELEPHONE", gc_rgTelephoneArcs, countof(gc_rgTelephoneArcs), FS(3) },
+    { "POSTALCODE", gc_rgPostalCodeArcs, countof(gc_rgPostalCodeArcs), FS(5) | FS(10) },
+    { "CURRENCY", gc_rgCurrencyArcs, countof(gc_rgCurrencyArcs), FS(2) | FS(6) },
+    { "UPPERCHAR", gc_rgUpperCharArcs, countof(gc_rgUpperCharArcs), FS(1) },
+};
+
+// A hypothesis of the lattice search
+struct LatticeHypothesis
+{
+    unsigned int    uState;     // the state of the constraint after the text
+    float           fScore;     // the sum of the alternates' scores
+    int             iPrev;      // the hypothesis it extends, in the previous beam
+    int             iAlternate; // the alternate of the part
+};
+
+// Orders the hypotheses by score, best first, and then by their
+// position, so that the order doesn't depend on the sort
+static int CompareHypotheses(const void* pv1, const void* pv2)
+{
+    const LatticeHypothesis* p1 = (const LatticeHypothesis*)pv1;
+    const LatticeHypothesis* p2 = (const LatticeHypothesis*)pv2;
+    if (p1->fScore != p2->fScore)
+        return (p1->fScore > p2->fScore) ? -1 : 1;
+    if (p1->iPrev != p2->iPrev)
+        return (p1->iPrev < p2->iPrev) ? -1 : 1;
+    return p1->iAlternate - p2->iAlternate;
+}
+
+////////////////////////////////////////////////////////
+// IRecoConstraint methods
+////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////
+//
+// IRecoConstraint::Walk
+//
+// Follows the bytes of a string from a state.
+//
+// Return Values (unsigned int):
+//      the state after the string, RC_DEAD if it's rejected
+//
+/////////////////////////////////////////////////////////
+unsigned int IRecoConstraint::Walk(unsigned int uState, const char* psz) const
+{
+    for (; RC_DEAD != uState && '\0' != *psz; psz++)
+    {
+        uState = Step(uState, (unsigned char)*psz);
+    }
+    return uState;
+}
+
+/////////////////////////////////////////////////////////
+//
+// IRecoConstraint::Accepts
+//
+// Return Values (bool):
+//      true if the constraint accepts the whole string
+//
+/////////////////////////////////////////////////////////
+bool IRecoConstraint::Accepts(const char* psz) const
+{
+    unsigned int uState = Walk(GetStartState(), psz);
+    return (RC_DEAD != uState && IsFinal(uState));
+}
+
+////////////////////////////////////////////////////////
+// CFactoid methods
+////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////
+//
+// CFactoid::CFactoid
+//
+// Constructor. Expands the transitions of the factoid into
+// the table of the next state by byte.
+//
+// Parameters:
+//     int iFactoid : [in] one of the RC_FACTOID_ constants
+//
+/////////////////////////////////////////////////////////
+CFactoid::CFactoid(int iFactoid) : m_uFinalStates(0), m_iFactoid(iFactoid)
+{
+    memset(m_rgNext, 0xFF, sizeof(m_rgNext));
+    if (iFactoid < 0 || iFactoid >= RC_NUM_FACTOIDS)
+        return;
+
+    const FactoidGrammar& grammar = gc_rgFactoids[iFactoid];
+    m_uFinalStates = grammar.uFinalStates;
+    for (int i = 0; i < grammar.cArcs; i++)
+    {
+        const FactoidArc& arc = grammar.pArcs[i];
+        for (int ch = 1; ch < 256; ch++)
+        {
+            bool bTaken = (NULL != arc.pszChars && NULL != strchr(arc.pszChars, ch));
+            if ((arc.uClasses & FC_DIGIT) && ch >= '0' && ch <= '9')
+                bTaken = true;
+            else if ((arc.uClasses & FC_UPPER) && ch >= 'A' && ch <= 'Z')
+                bTaken = true;
+            else if ((arc.uClasses & FC_LOWER) && ch >= 'a' && ch <= 'z')
+                bTaken = true;
+
+            // The first transition that takes the byte wins
+            if (bTaken && 0xFF == m_rgNext[arc.uFrom][ch])
+                m_rgNext[arc.uFrom][ch] = arc.uTo;
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CFactoid::Step
+//
+// Return Values (unsigned int):
+//      the state after the byte, RC_DEAD if it's rejected
+//
+/////////////////////////////////////////////////////////
+unsigned int CFactoid::Step(unsigned int uState, unsigned char ch) const
+{
+    if (uState >= RC_MAX_FACTOID_STATES)
+        return RC_DEAD;
+    unsigned char uNext = m_rgNext[uState][ch];
+    return (0xFF == uNext) ? RC_DEAD : uNext;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CFactoid::IsFinal
+//
+// Return Values (bool):
+//      true if the text of the state is a complete factoid
+//
+/////////////////////////////////////////////////////////
+bool CFactoid::IsFinal(unsigned int uState) const
+{
+    return (uState < RC_MAX_FACTOID_STATES && 0 != (m_uFinalStates & FS(uState)));
+}
+
+/////////////////////////////////////////////////////////
+//
+// CFactoid::GetFactoidName
+//
+// Return Values (const char*):
+//      the name of the factoid, NULL if there's no such factoid
+//
+/////////////////////////////////////////////////////////
+const char* CFactoid::GetFactoidName(int iFactoid)
+{
+    if (iFactoid < 0 || iFactoid >= RC_NUM_FACTOIDS)
+        return NULL;
+    return gc_rgFactoids[iFactoid].pszName;
+}
+
+////////////////////////////////////////////////////////
+// CLatticeSearch methods
+////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////
+//
+// CLatticeSearch::CLatticeSearch
+//
+// Constructor.
+//
+/////////////////////////////////////////////////////////
+CLatticeSearch::CLatticeSearch()
+    : m_pHypotheses(NULL), m_cMaxHypotheses(0), m_pCandidates(NULL), m_piPath(NULL),
+      m_cMaxSegments(0)
+{
+}
+
+/////////////////////////////////////////////////////////
+//
+// CLatticeSearch::~CLatticeSearch
+//
+// Destructor.
+//
+/////////////////////////////////////////////////////////
+CLatticeSearch::~CLatticeSearch()
+{
+    free(m_pHypotheses);
+    free(m_pCandidates);
+    free(m_piPath);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CLatticeSearch::Search
+//
+// Extends the beam of hypotheses with every alternate of
+// every part, in order, keeps the best ones the constraint
+// doesn't reject, and takes the texts of the best final
+// hypotheses. An alternate's score is its fScore, or 1/(1+k)
+// for the k-th alternate of a recognizer that has no scores.
+//
+// Parameters:
+//     const IRecoConstraint& constraint  : [in] the accepted texts
+//     const LatticeSegment* pSegments    : [in] the parts, in order
+//     int cSegments                      : [in] the number of the parts
+//     RecoAlternate* pResults            : [out] the texts, best first, with
+//                                          the mean score of their parts
+//     int cMaxResults                    : [in] the size of pResults
+//
+// Return Values (int):
+//      the number of the texts, 0 if the constraint accepts none, -1 if
+//      out of memory
+//
+/////////////////////////////////////////////////////////
+int CLatticeSearch::Search(
+        const IRecoConstraint& constraint,
+        const LatticeSegment* pSegments,
+        int cSegments,
+        RecoAlternate* pResults,
+        int cMaxResults
+        )
+{
+    if (cSegments <= 0 || cMaxResults <= 0)
+        return 0;
+
+    if (cSegments > m_cMaxSegments)
+    {
+        int cMaxHypotheses = (cSegments + 1) * RC_BEAM_WIDTH;
+        LatticeHypothesis* pHypotheses = (LatticeHypothesis*)realloc(
+                                m_pHypotheses, cMaxHypotheses * sizeof(LatticeHypothesis));
+        if (NULL == pHypotheses)
+            return -1;
+        m_pHypotheses = pHypotheses;
+        int* piPath = (int*)realloc(m_piPath, cSegments * sizeof(int));
+        if (NULL == piPath)
+            return -1;
+        m_piPath = piPath;
+        if (NULL == m_pCandidates)
+        {
+            m_pCandidates = (LatticeHypothesis*)malloc(
+                                RC_BEAM_WIDTH * BR_MAX_ALTERNATES * sizeof(LatticeHypothesis));
+            if (NULL == m_pCandidates)
+                return -1;
+        }
+        m_cMaxHypotheses = cMaxHypotheses;
+        m_cMaxSegments = cSegments;
+    }
+
+    // The start hypothesis is alone at 0, the beam of part s starts at
+    // 1 + s * RC_BEAM_WIDTH
+    LatticeHypothesis* pBeam = m_pHypotheses;
+    pBeam[0].uState = constraint.GetStartState();
+    pBeam[0].fScore = 0;
+    pBeam[0].iPrev = -1;
+    pBeam[0].iAlternate = -1;
+    int cBeam = 1;
+
+    for (int s = 0; s < cSegments; s++)
+    {
+        const LatticeSegment& segment = pSegments[s];
+        int cAlternates = (segment.cAlternates < BR_MAX_ALTERNATES)
+                              ? segment.cAlternates : BR_MAX_ALTERNATES;
+        int cCandidates = 0;
+        for (int h = 0; h < cBeam; h++)
+        {
+            unsigned int uState = constraint.Walk(pBeam[h].uState, segment.pszSeparator);
+            if (RC_DEAD == uState)
+                continue;
+            for (int k = 0; k < cAlternates; k++)
+            {
+                const RecoAlternate& alternate = segment.pAlternates[k];
+                unsigned int uNext = constraint.Walk(uState, alternate.szText);
+                if (RC_DEAD == uNext)
+                    continue;
+
+                LatticeHypothesis& candidate = m_pCandidates[cCandidates++];
+                candidate.uState = uNext;
+                candidate.fScore = pBeam[h].fScore
+                    + ((alternate.fScore >= 0) ? alternate.fScore : 1.0f / (1 + k));
+                candidate.iPrev = (int)(pBeam - m_pHypotheses) + h;
+                candidate.iAlternate = k;
+            }
+        }
+        if (0 == cCandidates)
+            return 0;
+
+        qsort(m_pCandidates, cCandidates, sizeof(LatticeHypothesis), CompareHypotheses);
+        cBeam = (cCandidates < RC_BEAM_WIDTH) ? cCandidates : RC_BEAM_WIDTH;
+        pBeam = m_pHypotheses + 1 + s * RC_BEAM_WIDTH;
+        memcpy(pBeam, m_pCandidates, cBeam * sizeof(LatticeHypothesis));
+    }
+
+    // The final hypotheses, best first, make the results; the same text
+    // from different parts is taken once
+    int cResults = 0;
+    for (int h = 0; h < cBeam && cResults < cMaxResults; h++)
+    {
+        if (false == constraint.IsFinal(pBeam[h].uState))
+            continue;
+
+        int iHypothesis = (int)(pBeam - m_pHypotheses) + h;
+        for (int s = cSegments - 1; s >= 0; s--)
+        {
+            m_piPath[s] = m_pHypotheses[iHypothesis].iAlternate;
+            iHypothesis = m_pHypotheses[iHypothesis].iPrev;
+        }
+
+        RecoAlternate& result = pResults[cResults];
+        result.szText[0] = '\0';
+        size_t cch = 0;
+        for (int s = 0; s < cSegments; s++)
+        {
+            cch += snprintf(result.szText + cch, (cch < BR_MAX_TEXT) ? BR_MAX_TEXT - cch : 0,
+                            "%s%s", pSegments[s].pszSeparator,
+                            pSegments[s].pAlternates[m_piPath[s]].szText);
+            if (cch >= BR_MAX_TEXT)
+                break;
+        }
+        result.fScore = pBeam[h].fScore / cSegments;
+
+        bool bDuplicate = false;
+        for (int i = 0; i < cResults && false == bDuplicate; i++)
+        {
+            bDuplicate = (0 == strcmp(pResults[i].szText, result.szText));
+        }
+        if (false == bDuplicate)
+            cResults++;
+    }
+    return cResults;
+}
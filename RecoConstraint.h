@@ -0,0 +1,150 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      RecoConstraint.h
+//
+// Description:
+//      The input scope of the recognition: the text the application
+//      expects, a word of a word list (WordList.h) or a factoid such as
+//      a number, a date or an e-mail address. Every constraint is a
+//      deterministic automaton over the UTF-8 bytes of the text, and a
+//      partial text is just the state it leads to, so a hypothesis of
+//      the search costs the same few bytes however big the word list.
+//
+//      CLatticeSearch puts the alternates of the parts of the ink (the
+//      cells of a guide) together into the best texts the constraint
+//      accepts, with a beam of the best hypotheses per part.
+//
+//      The methods of the classes are defined in the RecoConstraint.cpp
+//      file.
+//--------------------------------------------------------------------------
+
+#pragma once
+
+#include "BackgroundReco.h"
+
+#define RC_DEAD         0xFFFFFFFFu     // the state of a rejected text
+
+enum {
+    RC_BEAM_WIDTH = 32,         // the hypotheses kept per part of the lattice
+    RC_MAX_FACTOID_STATES = 16  // the states of a factoid's automaton
+};
+
+// The factoids, in the order of their menu items
+enum {
+    RC_FACTOID_DIGIT,
+    RC_FACTOID_NUMBER,
+    RC_FACTOID_DATE,
+    RC_FACTOID_TIME,
+    RC_FACTOID_EMAIL,
+    RC_FACTOID_WEB,
+    RC_FACTOID_TELEPHONE,
+    RC_FACTOID_POSTALCODE,
+    RC_FACTOID_CURRENCY,
+    RC_FACTOID_UPPERCHAR,
+    RC_NUM_FACTOIDS
+};
+
+/////////////////////////////////////////////////////////
+//
+// class IRecoConstraint
+//
+// A deterministic automaton over the bytes of the text. The
+// methods are const and keep no state of their own, so one
+// constraint serves any number of searches at once.
+//
+/////////////////////////////////////////////////////////
+
+class IRecoConstraint
+{
+public:
+
+    virtual ~IRecoConstraint() {}
+
+    virtual unsigned int GetStartState() const = 0;
+    // Returns the state after the byte, RC_DEAD if the byte can't
+    // follow the text of the state
+    virtual unsigned int Step(unsigned int uState, unsigned char ch) const = 0;
+    virtual bool IsFinal(unsigned int uState) const = 0;
+
+    unsigned int Walk(unsigned int uState, const char* psz) const;
+    bool Accepts(const char* psz) const;
+};
+
+/////////////////////////////////////////////////////////
+//
+// class CFactoid
+//
+// One of the built-in factoids. The automaton is a small
+// table of transitions over character classes, expanded at
+// construction into a table of the next state by byte.
+//
+/////////////////////////////////////////////////////////
+
+class CFactoid : public IRecoConstraint
+{
+    unsigned char   m_rgNext[RC_MAX_FACTOID_STATES][256];   // 0xFF: rejected
+    unsigned int    m_uFinalStates;                         // a bit per state
+    int             m_iFactoid;
+
+public:
+
+    CFactoid(int iFactoid);
+
+    virtual unsigned int GetStartState() const { return 0; }
+    virtual unsigned int Step(unsigned int uState, unsigned char ch) const;
+    virtual bool IsFinal(unsigned int uState) const;
+
+    int GetFactoid() const { return m_iFactoid; }
+    static const char* GetFactoidName(int iFactoid);
+};
+
+// A part of the lattice: the alternates of a part of the ink
+struct LatticeSegment
+{
+    const RecoAlternate*    pAlternates;    // best first
+    int                     cAlternates;
+    const char*             pszSeparator;   // goes before the part's text, "" if none
+};
+
+/////////////////////////////////////////////////////////
+//
+// class CLatticeSearch
+//
+// Finds the best texts made of an alternate of every part,
+// in order, that the constraint accepts. The search keeps the
+// RC_BEAM_WIDTH best hypotheses after every part; a
+// hypothesis is the state of the constraint, the score so far
+// and a link to the one it extends. The buffers grow with the
+// number of the parts and are reused by the next search.
+//
+/////////////////////////////////////////////////////////
+
+class CLatticeSearch
+{
+    struct LatticeHypothesis*   m_pHypotheses;  // RC_BEAM_WIDTH per part, and the start
+    int                         m_cMaxHypotheses;
+    struct LatticeHypothesis*   m_pCandidates;  // the extensions of a beam
+    int*                        m_piPath;       // an alternate per part, for a result
+    int                         m_cMaxSegments;
+
+public:
+
+    // Constructor and destructor
+    CLatticeSearch();
+    ~CLatticeSearch();
+
+    int Search(const IRecoConstraint& constraint, const LatticeSegment* pSegments,
+               int cSegments, RecoAlternate* pResults, int cMaxResults);
+
+private:
+
+    // Not copyable
+    CLatticeSearch(const CLatticeSearch&);
+    CLatticeSearch& operator=(const CLatticeSearch&);
+};
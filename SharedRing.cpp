@@ -0,0 +1,619 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      SharedRing.cpp
+//
+// Description:
+//      The file contains the definitions of the methods of the class
+//      CSharedRing. See the file SharedRing.h for the definition of the
+//      class.
+//--------------------------------------------------------------------------
+
+#ifdef __linux__
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     // memfd_create
+#endif
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include "SharedRing.h"
+#include "PerfTimer.h"
+
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define SR_MAGIC        0x47525231      // "GRR1"
+#define SR_CACHE_LINE   64
+#define SR_MIN_DATA     4096
+
+// The start of the mapping. Each side's end is on a cache line of its
+// own; the other side reads it, but only this side writes it
+struct SharedRingHeader
+{
+    unsigned int            uMagic;
+    unsigned int            cbData;
+    unsigned char           rgbPad0[SR_CACHE_LINE - 8];
+
+    // The writer's
+    volatile unsigned int   uWriteEnd;      // the bytes published, mod 2^32
+    volatile unsigned int   uPublished;     // the messages published
+    volatile unsigned int   bWriterWaiting; // for room
+    unsigned char           rgbPad1[SR_CACHE_LINE - 12];
+
+    // The reader's
+    volatile unsigned int   uReadEnd;       // the bytes released, mod 2^32
+    volatile unsigned int   uReleased;      // the Release calls
+    volatile unsigned int   bReaderWaiting; // for a message
+    unsigned char           rgbPad2[SR_CACHE_LINE - 12];
+};
+
+// A message in the ring. A record with cb < 0 pads the end of the ring
+// when the next message doesn't fit there
+struct RingRecord
+{
+    unsigned int    cbRecord;   // with the header, a multiple of SR_MESSAGE_ALIGN
+    unsigned int    uId;
+    int             cb;
+    unsigned int    uReserved;
+};
+
+static inline unsigned int LoadAcquire(volatile unsigned int* pu)
+{
+#ifdef _WIN32
+    return *pu;                 // volatile reads acquire with /volatile:ms
+#else
+    return __atomic_load_n(pu, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static inline void StoreRelease(volatile unsigned int* pu, unsigned int u)
+{
+#ifdef _WIN32
+    *pu = u;                    // volatile writes release with /volatile:ms
+#else
+    __atomic_store_n(pu, u, __ATOMIC_RELEASE);
+#endif
+}
+
+// Increments a counter, a full barrier
+static inline void Increment(volatile unsigned int* pu)
+{
+#ifdef _WIN32
+    ::InterlockedIncrement((volatile LONG*)pu);
+#else
+    __sync_add_and_fetch(pu, 1);
+#endif
+}
+
+// Clears a flag that's set; false if it wasn't
+static inline bool ClearFlag(volatile unsigned int* pb)
+{
+#ifdef _WIN32
+    return (1 == ::InterlockedCompareExchange((volatile LONG*)pb, 0, 1));
+#else
+    return __sync_bool_compare_and_swap(pb, 1, 0);
+#endif
+}
+
+static inline void FullBarrier()
+{
+#ifdef _WIN32
+    ::MemoryBarrier();
+#else
+    __sync_synchronize();
+#endif
+}
+
+// The milliseconds to a deadline, 0 if it's passed, -1 if there's none
+static int GetRemainingMs(PERFTIME ptDeadline)
+{
+    if (0 == ptDeadline)
+        return -1;
+    PERFTIME ptNow = PerfNow();
+    if (ptNow >= ptDeadline)
+        return 0;
+    return (int)((ptDeadline - ptNow + 999999) / 1000000);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CSharedRing::CSharedRing
+//
+// Constructor.
+//
+/////////////////////////////////////////////////////////
+CSharedRing::CSharedRing()
+    : m_pHeader(NULL), m_pbData(NULL), m_cbData(0), m_cbMapping(0),
+      m_uWriteEnd(0), m_uPendingEnd(0), m_uPeekEnd(0)
+{
+    m_szName[0] = '\0';
+#ifdef _WIN32
+    m_hMapping = m_hPublished = m_hReleased = NULL;
+#else
+    m_fd = -1;
+#endif
+}
+
+/////////////////////////////////////////////////////////
+//
+// CSharedRing::~CSharedRing
+//
+// Destructor.
+//
+/////////////////////////////////////////////////////////
+CSharedRing::~CSharedRing()
+{
+    Close();
+}
+
+/////////////////////////////////////////////////////////
+//
+// CSharedRing::Create
+//
+// Creates an empty ring, for this process and the one it
+// gives the ring's name to.
+//
+// Parameters:
+//      int cbData  : [in] the bytes of the ring, rounded up to a
+//                    power of 2
+//
+// Return Values (bool):
+//      true if succeeded, false if the memory couldn't be shared
+//
+/////////////////////////////////////////////////////////
+bool CSharedRing::Create(
+        int cbData
+        )
+{
+    Close();
+    if (cbData <= 0 || cbData > (1 << 30))
+        return false;
+    unsigned int cbRing = SR_MIN_DATA;
+    while (cbRing < (unsigned int)cbData)
+        cbRing *= 2;
+    size_t cbMapping = sizeof(SharedRingHeader) + cbRing;
+
+#ifdef _WIN32
+    static LONG s_lRings = 0;
+    _snprintf(m_szName, SR_MAX_NAME, "Local\\GestureRing-%lu-%ld",
+              ::GetCurrentProcessId(), ::InterlockedIncrement(&s_lRings));
+    m_szName[SR_MAX_NAME - 1] = '\0';
+    m_hMapping = ::CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                                      0, (DWORD)cbMapping, m_szName);
+    char szEvent[SR_MAX_NAME + 4];
+    _snprintf(szEvent, sizeof(szEvent), "%s-p", m_szName);
+    szEvent[sizeof(szEvent) - 1] = '\0';
+    m_hPublished = ::CreateEventA(NULL, FALSE, FALSE, szEvent);
+    _snprintf(szEvent, sizeof(szEvent), "%s-r", m_szName);
+    szEvent[sizeof(szEvent) - 1] = '\0';
+    m_hReleased = ::CreateEventA(NULL, FALSE, FALSE, szEvent);
+    if (NULL == m_hMapping || NULL == m_hPublished || NULL == m_hReleased)
+    {
+        Close();
+        return false;
+    }
+#elif defined(__linux__)
+    m_fd = memfd_create("gesture-ring", MFD_CLOEXEC);
+    if (m_fd < 0 || 0 != ftruncate(m_fd, (off_t)cbMapping))
+    {
+        Close();
+        return false;
+    }
+    snprintf(m_szName, SR_MAX_NAME, "/proc/%d/fd/%d", (int)getpid(), m_fd);
+#else
+    return false;
+#endif
+
+    if (false == Map(cbMapping))
+    {
+        Close();
+        return false;
+    }
+    // The new memory is zeroed: both ends at 0, nobody waiting
+    m_pHeader->cbData = cbRing;
+    m_cbData = cbRing;
+    StoreRelease(&m_pHeader->uMagic, SR_MAGIC);
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CSharedRing::Open
+//
+// Opens the ring another process created.
+//
+// Parameters:
+//      const char* pszName : [in] the ring's name, from GetName
+//
+// Return Values (bool):
+//      true if succeeded, false if there's no such ring
+//
+/////////////////////////////////////////////////////////
+bool CSharedRing::Open(
+        const char* pszName
+        )
+{
+    Close();
+    if (strlen(pszName) >= SR_MAX_NAME)
+        return false;
+    strcpy(m_szName, pszName);
+
+    size_t cbMapping = 0;
+#ifdef _WIN32
+    m_hMapping = ::OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, pszName);
+    char szEvent[SR_MAX_NAME + 4];
+    _snprintf(szEvent, sizeof(szEvent), "%s-p", pszName);
+    szEvent[sizeof(szEvent) - 1] = '\0';
+    m_hPublished = ::OpenEventA(EVENT_MODIFY_STATE | SYNCHRONIZE, FALSE, szEvent);
+    _snprintf(szEvent, sizeof(szEvent), "%s-r", pszName);
+    szEvent[sizeof(szEvent) - 1] = '\0';
+    m_hReleased = ::OpenEventA(EVENT_MODIFY_STATE | SYNCHRONIZE, FALSE, szEvent);
+    if (NULL == m_hMapping || NULL == m_hPublished || NULL == m_hReleased)
+    {
+        Close();
+        return false;
+    }
+#elif defined(__linux__)
+    struct stat st;
+    m_fd = open(pszName, O_RDWR | O_CLOEXEC);
+    if (m_fd < 0 || 0 != fstat(m_fd, &st) || st.st_size <= (off_t)sizeof(SharedRingHeader))
+    {
+        Close();
+        return false;
+    }
+    cbMapping = (size_t)st.st_size;
+#else
+    return false;
+#endif
+
+    if (false == Map(cbMapping))
+    {
+        Close();
+        return false;
+    }
+    unsigned int cbRing = m_pHeader->cbData;
+    if (SR_MAGIC != LoadAcquire(&m_pHeader->uMagic) || cbRing < SR_MIN_DATA ||
+        0 != (cbRing & (cbRing - 1)) || sizeof(SharedRingHeader) + cbRing > m_cbMapping)
+    {
+        Close();
+        return false;
+    }
+    m_cbData = cbRing;
+    m_uWriteEnd = m_uPendingEnd = LoadAcquire(&m_pHeader->uWriteEnd);
+    m_uPeekEnd = LoadAcquire(&m_pHeader->uReadEnd);
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CSharedRing::Close
+//
+// Unmaps the ring; it's freed when both processes have.
+//
+/////////////////////////////////////////////////////////
+void CSharedRing::Close()
+{
+#ifdef _WIN32
+    if (NULL != m_pHeader)
+        ::UnmapViewOfFile(m_pHeader);
+    if (NULL != m_hMapping)
+        ::CloseHandle(m_hMapping);
+    if (NULL != m_hPublished)
+        ::CloseHandle(m_hPublished);
+    if (NULL != m_hReleased)
+        ::CloseHandle(m_hReleased);
+    m_hMapping = m_hPublished = m_hReleased = NULL;
+#else
+    if (NULL != m_pHeader)
+        munmap(m_pHeader, m_cbMapping);
+    if (m_fd >= 0)
+        close(m_fd);
+    m_fd = -1;
+#endif
+    m_pHeader = NULL;
+    m_pbData = NULL;
+    m_cbData = 0;
+    m_cbMapping = 0;
+    m_uWriteEnd = m_uPendingEnd = m_uPeekEnd = 0;
+    m_szName[0] = '\0';
+}
+
+/////////////////////////////////////////////////////////
+//
+// CSharedRing::BeginWrite
+//
+// Reserves a message at the writer's end of the ring,
+// waiting for the reader to release room if need be. The
+// message isn't seen by the reader until EndWrite and
+// Publish.
+//
+// Parameters:
+//      unsigned int uId    : [in] the message's id, for the caller
+//      int cb              : [in] the bytes of the message, no more
+//                            than GetMaxMessageSize
+//      int iTimeoutMs      : [in] how long to wait for room; 0 not at
+//                            all, < 0 without a limit
+//
+// Return Values (void*):
+//      the message's bytes, in the ring, or NULL if there was no
+//      room in time
+//
+/////////////////////////////////////////////////////////
+void* CSharedRing::BeginWrite(
+        unsigned int uId,
+        int cb,
+        int iTimeoutMs
+        )
+{
+    if (NULL == m_pHeader || cb < 0 || cb > GetMaxMessageSize())
+        return NULL;
+
+    unsigned int cbRecord = (sizeof(RingRecord) + cb + SR_MESSAGE_ALIGN - 1) & ~(SR_MESSAGE_ALIGN - 1);
+    unsigned int uEnd = m_uWriteEnd;
+    unsigned int ib = uEnd & (m_cbData - 1);
+    unsigned int cbToEnd = m_cbData - ib;
+    unsigned int cbNeeded = cbRecord + ((cbToEnd < cbRecord) ? cbToEnd : 0);
+
+    PERFTIME ptDeadline = (iTimeoutMs > 0) ? PerfNow() + (PERFTIME)iTimeoutMs * 1000000 : 0;
+    for (;;)
+    {
+        unsigned int uReleased = LoadAcquire(&m_pHeader->uReleased);
+        if (m_cbData - (uEnd - LoadAcquire(&m_pHeader->uReadEnd)) >= cbNeeded)
+            break;
+        int iWaitMs = (0 == iTimeoutMs) ? 0 : GetRemainingMs(ptDeadline);
+        if (0 == iWaitMs)
+            return NULL;
+
+        // The reader can't make room with messages it doesn't see
+        Publish();
+
+        // Ask the reader for a wake up, then look again: either this
+        // side sees the room or the reader sees the flag
+        StoreRelease(&m_pHeader->bWriterWaiting, 1);
+        FullBarrier();
+        if (m_cbData - (uEnd - LoadAcquire(&m_pHeader->uReadEnd)) < cbNeeded)
+            Wait(&m_pHeader->uReleased, uReleased, false, iWaitMs);
+        StoreRelease(&m_pHeader->bWriterWaiting, 0);
+    }
+
+    if (cbToEnd < cbRecord)
+    {
+        RingRecord* pPad = (RingRecord*)(m_pbData + ib);
+        pPad->cbRecord = cbToEnd;
+        pPad->uId = 0;
+        pPad->cb = -1;
+        pPad->uReserved = 0;
+        uEnd += cbToEnd;
+        ib = 0;
+    }
+    RingRecord* pRecord = (RingRecord*)(m_pbData + ib);
+    pRecord->cbRecord = cbRecord;
+    pRecord->uId = uId;
+    pRecord->cb = cb;
+    pRecord->uReserved = 0;
+    m_uPendingEnd = uEnd + cbRecord;
+    return pRecord + 1;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CSharedRing::EndWrite
+//
+// Ends the message of BeginWrite. It's published with the
+// other ended messages by the next Publish.
+//
+/////////////////////////////////////////////////////////
+void CSharedRing::EndWrite()
+{
+    m_uWriteEnd = m_uPendingEnd;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CSharedRing::Publish
+//
+// Publishes the ended messages, and wakes the reader if it
+// waits for one. A writer that ends several messages at
+// once, a burst of strokes or the results of a batch,
+// publishes them together, for one wake up at most.
+//
+/////////////////////////////////////////////////////////
+void CSharedRing::Publish()
+{
+    if (NULL == m_pHeader || m_uWriteEnd == m_pHeader->uWriteEnd)
+        return;
+    StoreRelease(&m_pHeader->uWriteEnd, m_uWriteEnd);
+    Increment(&m_pHeader->uPublished);
+    if (LoadAcquire(&m_pHeader->bReaderWaiting) && ClearFlag(&m_pHeader->bReaderWaiting))
+        Wake(&m_pHeader->uPublished, true);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CSharedRing::Peek
+//
+// Gets the messages published after those already peeked,
+// in place, waiting for one if there's none. They stay in
+// the ring until Release. A malformed record stops the
+// walk after the messages before it, and the next Peek
+// fails on it, so the caller tears the ring down rather
+// than spinning on it.
+//
+// Parameters:
+//      RingMessage* pMessages  : [out] the messages, in order
+//      int cMaxMessages        : [in] the size of pMessages
+//      int iTimeoutMs          : [in] how long to wait for a message;
+//                                0 not at all, < 0 without a limit
+//
+// Return Values (int):
+//      the number of the messages, 0 if none came in time, -1 if
+//      the next record is malformed
+//
+/////////////////////////////////////////////////////////
+int CSharedRing::Peek(
+        RingMessage* pMessages,
+        int cMaxMessages,
+        int iTimeoutMs
+        )
+{
+    if (NULL == m_pHeader || cMaxMessages <= 0)
+        return 0;
+
+    unsigned int uStart = m_uPeekEnd;
+    unsigned int uEnd;
+    PERFTIME ptDeadline = (iTimeoutMs > 0) ? PerfNow() + (PERFTIME)iTimeoutMs * 1000000 : 0;
+    for (;;)
+    {
+        unsigned int uPublished = LoadAcquire(&m_pHeader->uPublished);
+        uEnd = LoadAcquire(&m_pHeader->uWriteEnd);
+        if (uEnd != uStart)
+            break;
+        int iWaitMs = (0 == iTimeoutMs) ? 0 : GetRemainingMs(ptDeadline);
+        if (0 == iWaitMs)
+            return 0;
+
+        StoreRelease(&m_pHeader->bReaderWaiting, 1);
+        FullBarrier();
+        if (LoadAcquire(&m_pHeader->uWriteEnd) == uStart)
+            Wait(&m_pHeader->uPublished, uPublished, true, iWaitMs);
+        StoreRelease(&m_pHeader->bReaderWaiting, 0);
+    }
+
+    // The records come from the other process: one that doesn't fit
+    // between here and the writer's end stops the walk
+    int cMessages = 0;
+    bool bMalformed = false;
+    unsigned int u = uStart;
+    while (u != uEnd && cMessages < cMaxMessages)
+    {
+        unsigned int ib = u & (m_cbData - 1);
+        const RingRecord* pRecord = (const RingRecord*)(m_pbData + ib);
+        unsigned int cbRecord = pRecord->cbRecord;
+        if (cbRecord < sizeof(RingRecord) || 0 != (cbRecord & (SR_MESSAGE_ALIGN - 1)) ||
+            cbRecord > m_cbData - ib || cbRecord > uEnd - u ||
+            (pRecord->cb >= 0 && (unsigned int)pRecord->cb > cbRecord - sizeof(RingRecord)))
+        {
+            bMalformed = true;
+            break;
+        }
+        if (pRecord->cb >= 0)
+        {
+            pMessages[cMessages].uId = pRecord->uId;
+            pMessages[cMessages].cb = pRecord->cb;
+            pMessages[cMessages].pv = pRecord + 1;
+            cMessages++;
+        }
+        u += cbRecord;
+    }
+    m_uPeekEnd = u;
+    return (bMalformed && 0 == cMessages) ? -1 : cMessages;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CSharedRing::Release
+//
+// Gives the room of the peeked messages back to the writer,
+// and wakes it if it waits for room. Their bytes mustn't be
+// used after.
+//
+/////////////////////////////////////////////////////////
+void CSharedRing::Release()
+{
+    if (NULL == m_pHeader || m_uPeekEnd == m_pHeader->uReadEnd)
+        return;
+    StoreRelease(&m_pHeader->uReadEnd, m_uPeekEnd);
+    Increment(&m_pHeader->uReleased);
+    if (LoadAcquire(&m_pHeader->bWriterWaiting) && ClearFlag(&m_pHeader->bWriterWaiting))
+        Wake(&m_pHeader->uReleased, false);
+}
+
+// The largest message BeginWrite takes: one that fits in the ring even
+// after the padding of its end
+int CSharedRing::GetMaxMessageSize() const
+{
+    return (0 == m_cbData) ? 0 : (int)(m_cbData / 2 - sizeof(RingRecord));
+}
+
+// Maps the memory of the ring
+bool CSharedRing::Map(size_t cbMapping)
+{
+#ifdef _WIN32
+    void* pv = ::MapViewOfFile(m_hMapping, FILE_MAP_ALL_ACCESS, 0, 0, cbMapping);
+    if (NULL == pv)
+        return false;
+    if (0 == cbMapping)
+    {
+        MEMORY_BASIC_INFORMATION mbi;
+        if (0 == ::VirtualQuery(pv, &mbi, sizeof(mbi)))
+        {
+            ::UnmapViewOfFile(pv);
+            return false;
+        }
+        cbMapping = mbi.RegionSize;
+    }
+#else
+    void* pv = mmap(NULL, cbMapping, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (MAP_FAILED == pv)
+        return false;
+#endif
+    m_pHeader = (SharedRingHeader*)pv;
+    m_pbData = (unsigned char*)pv + sizeof(SharedRingHeader);
+    m_cbMapping = cbMapping;
+    return true;
+}
+
+// Sleeps until the other side changes a sequence number from the value
+// given, or for a time, or spuriously; the caller looks again
+void CSharedRing::Wait(volatile unsigned int* puSequence, unsigned int uSequence,
+                       bool bReader, int iTimeoutMs)
+{
+#ifdef _WIN32
+    (void)puSequence;
+    (void)uSequence;
+    ::WaitForSingleObject(bReader ? m_hPublished : m_hReleased,
+                          (iTimeoutMs < 0) ? INFINITE : (DWORD)iTimeoutMs);
+#elif defined(__linux__)
+    (void)bReader;
+    struct timespec ts;
+    ts.tv_sec = (iTimeoutMs < 0) ? 0 : iTimeoutMs / 1000;
+    ts.tv_nsec = (iTimeoutMs < 0) ? 0 : (long)(iTimeoutMs % 1000) * 1000000;
+    syscall(SYS_futex, puSequence, FUTEX_WAIT, uSequence,
+            (iTimeoutMs < 0) ? NULL : &ts, NULL, 0);
+#else
+    (void)puSequence;
+    (void)uSequence;
+    (void)bReader;
+    (void)iTimeoutMs;
+#endif
+}
+
+// Wakes the other side, waiting on a sequence number
+void CSharedRing::Wake(volatile unsigned int* puSequence, bool bReader)
+{
+#ifdef _WIN32
+    (void)puSequence;
+    ::SetEvent(bReader ? m_hPublished : m_hReleased);
+#elif defined(__linux__)
+    (void)bReader;
+    syscall(SYS_futex, puSequence, FUTEX_WAKE, 1, NULL, NULL, 0);
+#else
+    (void)puSequence;
+    (void)bReader;
+#endif
+}
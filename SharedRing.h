@@ -0,0 +1,131 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      SharedRing.h
+//
+// Description:
+//      This file contains the definition of the CSharedRing class, a ring
+//      of messages in memory shared by two processes, one writing and one
+//      reading, for the strokes a capture process hands to a recognition
+//      process (and the results that come back, in a second ring) without
+//      a copy or a system call per stroke.
+//
+//      The writer reserves a message in the ring and fills it in place,
+//      the points of a stroke as GesturePoint, and publishes it, alone or
+//      with the messages it wrote since the last time; the reader gets
+//      the published messages where they are, recognizes the strokes
+//      there, as a batch, and releases them. A message is never split at
+//      the end of the ring, so its bytes are contiguous and 16 byte
+//      aligned.
+//
+//      The two sides share nothing but the ring: the writer's end and
+//      the reader's end are on cache lines of their own, each a byte
+//      count only one side writes, and a side waits, when the ring is
+//      empty or full, on a sequence number the other side increments:
+//      a futex on Linux, a named event on Windows. A side that isn't
+//      waited for makes no system call.
+//
+//      The memory is a memfd on Linux, a named file mapping on Windows.
+//      The process that creates the ring gives its name (GetName) to the
+//      other, which opens it; on Linux the name is the memfd's path in
+//      /proc.
+//
+//      The methods of the class are defined in the SharedRing.cpp file.
+//--------------------------------------------------------------------------
+
+#pragma once
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <stddef.h>
+#endif
+
+enum {
+    SR_MAX_NAME = 64,
+    SR_MESSAGE_ALIGN = 16
+};
+
+// A published message, in the ring
+struct RingMessage
+{
+    unsigned int    uId;        // as given to BeginWrite
+    int             cb;         // the bytes of the message
+    const void*     pv;         // in the ring, SR_MESSAGE_ALIGN aligned
+};
+
+struct SharedRingHeader;
+
+/////////////////////////////////////////////////////////
+//
+// class CSharedRing
+//
+// One end of a ring: a process either writes (BeginWrite,
+// EndWrite, Publish) or reads (Peek, Release) a ring, not both, and
+// from one thread.
+//
+/////////////////////////////////////////////////////////
+
+class CSharedRing
+{
+    SharedRingHeader*   m_pHeader;
+    unsigned char*      m_pbData;       // the ring, after the header
+    unsigned int        m_cbData;       // a power of 2
+    size_t              m_cbMapping;
+    char                m_szName[SR_MAX_NAME];
+
+    // The writer's messages not published, the reader's messages peeked
+    unsigned int        m_uWriteEnd;    // the writer's end after the ended messages
+    unsigned int        m_uPendingEnd;  // and after the message being written
+    unsigned int        m_uPeekEnd;     // the reader's end after the messages
+
+#ifdef _WIN32
+    HANDLE              m_hMapping;
+    HANDLE              m_hPublished;   // set when a message is published
+    HANDLE              m_hReleased;    // set when messages are released
+#else
+    int                 m_fd;
+#endif
+
+public:
+
+    // Constructor and destructor
+    CSharedRing();
+    ~CSharedRing();
+
+    bool Create(int cbData);
+    bool Open(const char* pszName);
+    void Close();
+
+    // The writer
+    void* BeginWrite(unsigned int uId, int cb, int iTimeoutMs);
+    void EndWrite();
+    void Publish();
+
+    // The reader
+    int  Peek(RingMessage* pMessages, int cMaxMessages, int iTimeoutMs);
+    void Release();
+
+    // Data members access methods
+    const char* GetName() const { return m_szName; }
+    int  GetMaxMessageSize() const;
+
+private:
+
+    bool Map(size_t cbMapping);
+    void Wait(volatile unsigned int* puSequence, unsigned int uSequence,
+              bool bReader, int iTimeoutMs);
+    void Wake(volatile unsigned int* puSequence, bool bReader);
+
+    // Not copyable
+    CSharedRing(const CSharedRing&);
+    CSharedRing& operator=(const CSharedRing&);
+};
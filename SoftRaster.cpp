@@ -0,0 +1,422 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      SoftRaster.cpp
+//
+// Description:
+//      The file contains the definitions of the methods of the class
+//      CSoftRaster. See the file SoftRaster.h for the definition of the
+//      class.
+//--------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "SoftRaster.h"
+
+// A useful macro to determine the number of elements in the array
+#ifndef countof
+#define countof(array)  (sizeof(array)/sizeof(array[0]))
+#endif
+
+// The glyphs of the printable ASCII characters, from the space on.
+// Every glyph is SR_GLYPH_WIDTH columns of 7 pixels, the low bit at the top.
+static const unsigned char gc_rgGlyphs[][SR_GLYPH_WIDTH] = {
+    { 0x00, 0x00, 0x00, 0x00, 0x00 },   // space
+    { 0x00, 0x00, 0x5F, 0x00, 0x00 },   // !
+    { 0x00, 0x07, 0x00, 0x07, 0x00 },   // "
+    { 0x14, 0x7F, 0x14, 0x7F, 0x14 },   // #
+    { 0x24, 0x2A, 0x7F, 0x2A, 0x12 },   // $
+    { 0x23, 0x13, 0x08, 0x64, 0x62 },   // %
+    { 0x36, 0x49, 0x56, 0x20, 0x50 },   // &
+    { 0x00, 0x08, 0x07, 0x03, 0x00 },   // quote
+    { 0x00, 0x1C, 0x22, 0x41, 0x00 },   // (
+    { 0x00, 0x41, 0x22, 0x1C, 0x00 },   // )
+    { 0x2A, 0x1C, 0x7F, 0x1C, 0x2A },   // *
+    { 0x08, 0x08, 0x3E, 0x08, 0x08 },   // +
+    { 0x00, 0x50, 0x30, 0x00, 0x00 },   // ,
+    { 0x08, 0x08, 0x08, 0x08, 0x08 },   // -
+    { 0x00, 0x00, 0x60, 0x60, 0x00 },   // .
+    { 0x20, 0x10, 0x08, 0x04, 0x02 },   // /
+    { 0x3E, 0x51, 0x49, 0x45, 0x3E },   // 0
+    { 0x00, 0x42, 0x7F, 0x40, 0x00 },   // 1
+    { 0x72, 0x49, 0x49, 0x49, 0x46 },   // 2
+    { 0x21, 0x41, 0x49, 0x4D, 0x33 },   // 3
+    { 0x18, 0x14, 0x12, 0x7F, 0x10 },   // 4
+    { 0x27, 0x45, 0x45, 0x45, 0x39 },   // 5
+    { 0x3C, 0x4A, 0x49, 0x49, 0x31 },   // 6
+    { 0x41, 0x21, 0x11, 0x09, 0x07 },   // 7
+    { 0x36, 0x49, 0x49, 0x49, 0x36 },   // 8
+    { 0x46, 0x49, 0x49, 0x29, 0x1E },   // 9
+    { 0x00, 0x00, 0x14, 0x00, 0x00 },   // :
+    { 0x00, 0x40, 0x34, 0x00, 0x00 },   // ;
+    { 0x00, 0x08, 0x14, 0x22, 0x41 },   // <
+    { 0x14, 0x14, 0x14, 0x14, 0x14 },   // =
+    { 0x00, 0x41, 0x22, 0x14, 0x08 },   // >
+    { 0x02, 0x01, 0x59, 0x09, 0x06 },   // ?
+    { 0x3E, 0x41, 0x5D, 0x59, 0x4E },   // @
+    { 0x7C, 0x12, 0x11, 0x12, 0x7C },   // A
+    { 0x7F, 0x49, 0x49, 0x49, 0x36 },   // B
+    { 0x3E, 0x41, 0x41, 0x41, 0x22 },   // C
+    { 0x7F, 0x41, 0x41, 0x41, 0x3E },   // D
+    { 0x7F, 0x49, 0x49, 0x49, 0x41 },   // E
+    { 0x7F, 0x09, 0x09, 0x09, 0x01 },   // F
+    { 0x3E, 0x41, 0x41, 0x51, 0x73 },   // G
+    { 0x7F, 0x08, 0x08, 0x08, 0x7F },   // H
+    { 0x00, 0x41, 0x7F, 0x41, 0x00 },   // I
+    { 0x20, 0x40, 0x41, 0x3F, 0x01 },   // J
+    { 0x7F, 0x08, 0x14, 0x22, 0x41 },   // K
+    { 0x7F, 0x40, 0x40, 0x40, 0x40 },   // L
+    { 0x7F, 0x02, 0x1C, 0x02, 0x7F },   // M
+    { 0x7F, 0x04, 0x08, 0x10, 0x7F },   // N
+    { 0x3E, 0x41, 0x41, 0x41, 0x3E },   // O
+    { 0x7F, 0x09, 0x09, 0x09, 0x06 },   // P
+    { 0x3E, 0x41, 0x51, 0x21, 0x5E },   // Q
+    { 0x7F, 0x09, 0x19, 0x29, 0x46 },   // R
+    { 0x26, 0x49, 0x49, 0x49, 0x32 },   // S
+    { 0x01, 0x01, 0x7F, 0x01, 0x01 },   // T
+    { 0x3F, 0x40, 0x40, 0x40, 0x3F },   // U
+    { 0x1F, 0x20, 0x40, 0x20, 0x1F },   // V
+    { 0x3F, 0x40, 0x38, 0x40, 0x3F },   // W
+    { 0x63, 0x14, 0x08, 0x14, 0x63 },   // X
+    { 0x03, 0x04, 0x78, 0x04, 0x03 },   // Y
+    { 0x61, 0x59, 0x49, 0x4D, 0x43 },   // Z
+    { 0x00, 0x7F, 0x41, 0x41, 0x41 },   // [
+    { 0x02, 0x04, 0x08, 0x10, 0x20 },   // backslash
+    { 0x00, 0x41, 0x41, 0x41, 0x7F },   // ]
+    { 0x04, 0x02, 0x01, 0x02, 0x04 },   // ^
+    { 0x40, 0x40, 0x40, 0x40, 0x40 },   // _
+    { 0x00, 0x03, 0x07, 0x08, 0x00 },   // `
+    { 0x20, 0x54, 0x54, 0x78, 0x40 },   // a
+    { 0x7F, 0x28, 0x44, 0x44, 0x38 },   // b
+    { 0x38, 0x44, 0x44, 0x44, 0x28 },   // c
+    { 0x38, 0x44, 0x44, 0x28, 0x7F },   // d
+    { 0x38, 0x54, 0x54, 0x54, 0x18 },   // e
+    { 0x00, 0x08, 0x7E, 0x09, 0x02 },   // f
+    { 0x0C, 0x52, 0x52, 0x52, 0x3E },   // g
+    { 0x7F, 0x08, 0x04, 0x04, 0x78 },   // h
+    { 0x00, 0x44, 0x7D, 0x40, 0x00 },   // i
+    { 0x20, 0x40, 0x44, 0x3D, 0x00 },   // j
+    { 0x7F, 0x10, 0x28, 0x44, 0x00 },   // k
+    { 0x00, 0x41, 0x7F, 0x40, 0x00 },   // l
+    { 0x7C, 0x04, 0x78, 0x04, 0x78 },   // m
+    { 0x7C, 0x08, 0x04, 0x04, 0x78 },   // n
+    { 0x38, 0x44, 0x44, 0x44, 0x38 },   // o
+    { 0x7C, 0x14, 0x14, 0x14, 0x08 },   // p
+    { 0x08, 0x14, 0x14, 0x18, 0x7C },   // q
+    { 0x7C, 0x08, 0x04, 0x04, 0x08 },   // r
+    { 0x48, 0x54, 0x54, 0x54, 0x24 },   // s
+    { 0x04, 0x04, 0x3F, 0x44, 0x24 },   // t
+    { 0x3C, 0x40, 0x40, 0x20, 0x7C },   // u
+    { 0x1C, 0x20, 0x40, 0x20, 0x1C },   // v
+    { 0x3C, 0x40, 0x30, 0x40, 0x3C },   // w
+    { 0x44, 0x28, 0x10, 0x28, 0x44 },   // x
+    { 0x0C, 0x50, 0x50, 0x50, 0x3C },   // y
+    { 0x44, 0x64, 0x54, 0x4C, 0x44 },   // z
+    { 0x00, 0x08, 0x36, 0x41, 0x00 },   // {
+    { 0x00, 0x00, 0x77, 0x00, 0x00 },   // |
+    { 0x00, 0x41, 0x36, 0x08, 0x00 },   // }
+    { 0x02, 0x01, 0x02, 0x04, 0x02 },   // ~
+};
+
+/////////////////////////////////////////////////////////
+//
+// CSoftRaster::~CSoftRaster
+//
+// Destructor.
+//
+/////////////////////////////////////////////////////////
+CSoftRaster::~CSoftRaster()
+{
+    free(m_pPixels);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CSoftRaster::Create
+//
+// Allocates the frame buffer and clears it to black.
+//
+// Parameters:
+//     int cx : [in] the width in pixels
+//     int cy : [in] the height in pixels
+//
+// Return Values (bool):
+//      true if succeeded, false otherwise
+//
+/////////////////////////////////////////////////////////
+bool CSoftRaster::Create(int cx, int cy)
+{
+    if (cx <= 0 || cy <= 0)
+        return false;
+
+    unsigned int* pPixels = (unsigned int*)calloc((size_t)cx * cy, sizeof(unsigned int));
+    if (NULL == pPixels)
+        return false;
+
+    free(m_pPixels);
+    m_pPixels = pPixels;
+    m_cx = cx;
+    m_cy = cy;
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CSoftRaster::FillRect
+//
+// Fills a rectangle with a color.
+//
+/////////////////////////////////////////////////////////
+void CSoftRaster::FillRect(const RasterRect& rc, unsigned int clr)
+{
+    int xLeft = (rc.left < 0) ? 0 : rc.left;
+    int xRight = (rc.right > m_cx) ? m_cx : rc.right;
+    int yTop = (rc.top < 0) ? 0 : rc.top;
+    int yBottom = (rc.bottom > m_cy) ? m_cy : rc.bottom;
+
+    for (int y = yTop; y < yBottom; y++)
+    {
+        unsigned int* pRow = m_pPixels + (size_t)y * m_cx;
+        for (int x = xLeft; x < xRight; x++)
+        {
+            pRow[x] = clr;
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CSoftRaster::DrawLine
+//
+// Draws a one pixel line with the Bresenham algorithm,
+// both ends included.
+//
+/////////////////////////////////////////////////////////
+void CSoftRaster::DrawLine(int x0, int y0, int x1, int y1, unsigned int clr)
+{
+    int dx = (x1 > x0) ? x1 - x0 : x0 - x1;
+    int dy = (y1 > y0) ? y0 - y1 : y1 - y0;     // negative
+    int sx = (x0 < x1) ? 1 : -1;
+    int sy = (y0 < y1) ? 1 : -1;
+    int iError = dx + dy;
+
+    for (;;)
+    {
+        if (x0 >= 0 && x0 < m_cx && y0 >= 0 && y0 < m_cy)
+            m_pPixels[(size_t)y0 * m_cx + x0] = clr;
+        if (x0 == x1 && y0 == y1)
+            break;
+        int iError2 = 2 * iError;
+        if (iError2 >= dy)
+        {
+            iError += dy;
+            x0 += sx;
+        }
+        if (iError2 <= dx)
+        {
+            iError += dx;
+            y0 += sy;
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CSoftRaster::Blit
+//
+// Copies a whole frame buffer, its top left corner at x, y.
+//
+/////////////////////////////////////////////////////////
+void CSoftRaster::Blit(const CSoftRaster& src, int x, int y)
+{
+    int xLeft = (x < 0) ? 0 : x;
+    int xRight = (x + src.m_cx > m_cx) ? m_cx : x + src.m_cx;
+    int yTop = (y < 0) ? 0 : y;
+    int yBottom = (y + src.m_cy > m_cy) ? m_cy : y + src.m_cy;
+    if (xLeft >= xRight)
+        return;
+
+    for (int yDst = yTop; yDst < yBottom; yDst++)
+    {
+        memcpy(m_pPixels + (size_t)yDst * m_cx + xLeft,
+               src.m_pPixels + (size_t)(yDst - y) * src.m_cx + (xLeft - x),
+               (xRight - xLeft) * sizeof(unsigned int));
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CSoftRaster::BlitScaled
+//
+// Copies a part of a frame buffer, every pixel as an iScale
+// by iScale square, its top left corner at x, y.
+//
+/////////////////////////////////////////////////////////
+void CSoftRaster::BlitScaled(const CSoftRaster& src, const RasterRect& rcSrc, int x, int y, int iScale)
+{
+    int cx = (rcSrc.right - rcSrc.left) * iScale;
+    int cy = (rcSrc.bottom - rcSrc.top) * iScale;
+    int xLeft = (x < 0) ? 0 : x;
+    int xRight = (x + cx > m_cx) ? m_cx : x + cx;
+    int yTop = (y < 0) ? 0 : y;
+    int yBottom = (y + cy > m_cy) ? m_cy : y + cy;
+
+    for (int yDst = yTop; yDst < yBottom; yDst++)
+    {
+        const unsigned int* pSrcRow = src.m_pPixels
+                                      + (size_t)(rcSrc.top + (yDst - y) / iScale) * src.m_cx
+                                      + rcSrc.left;
+        unsigned int* pRow = m_pPixels + (size_t)yDst * m_cx;
+        for (int xDst = xLeft; xDst < xRight; xDst++)
+        {
+            pRow[xDst] = pSrcRow[(xDst - x) / iScale];
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CSoftRaster::BlitRect
+//
+// Copies a part of a frame buffer, its top left corner at
+// x, y. The part must be inside the source.
+//
+/////////////////////////////////////////////////////////
+void CSoftRaster::BlitRect(const CSoftRaster& src, const RasterRect& rcSrc, int x, int y)
+{
+    int xLeft = (x < 0) ? 0 : x;
+    int xRight = (x + rcSrc.right - rcSrc.left > m_cx) ? m_cx : x + rcSrc.right - rcSrc.left;
+    int yTop = (y < 0) ? 0 : y;
+    int yBottom = (y + rcSrc.bottom - rcSrc.top > m_cy) ? m_cy : y + rcSrc.bottom - rcSrc.top;
+    if (xLeft >= xRight)
+        return;
+
+    for (int yDst = yTop; yDst < yBottom; yDst++)
+    {
+        memcpy(m_pPixels + (size_t)yDst * m_cx + xLeft,
+               src.m_pPixels + (size_t)(rcSrc.top + yDst - y) * src.m_cx + (rcSrc.left + xLeft - x),
+               (xRight - xLeft) * sizeof(unsigned int));
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CSoftRaster::BlitTransparent
+//
+// Copies a part of a frame buffer, its top left corner at
+// x, y, but for its SR_TRANSPARENT pixels. The part must be
+// inside the source.
+//
+/////////////////////////////////////////////////////////
+void CSoftRaster::BlitTransparent(const CSoftRaster& src, const RasterRect& rcSrc, int x, int y)
+{
+    int xLeft = (x < 0) ? 0 : x;
+    int xRight = (x + rcSrc.right - rcSrc.left > m_cx) ? m_cx : x + rcSrc.right - rcSrc.left;
+    int yTop = (y < 0) ? 0 : y;
+    int yBottom = (y + rcSrc.bottom - rcSrc.top > m_cy) ? m_cy : y + rcSrc.bottom - rcSrc.top;
+
+    for (int yDst = yTop; yDst < yBottom; yDst++)
+    {
+        const unsigned int* pSrcRow = src.m_pPixels + (size_t)(rcSrc.top + yDst - y) * src.m_cx
+                                      + (rcSrc.left - x);
+        unsigned int* pRow = m_pPixels + (size_t)yDst * m_cx;
+        for (int xDst = xLeft; xDst < xRight; xDst++)
+        {
+            if (SR_TRANSPARENT != pSrcRow[xDst])
+                pRow[xDst] = pSrcRow[xDst];
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CSoftRaster::GetTextWidth
+//
+// Returns the width of a string drawn with DrawText.
+//
+/////////////////////////////////////////////////////////
+int CSoftRaster::GetTextWidth(const char* psz, int iScale)
+{
+    int cch = 0;
+    while ('\0' != psz[cch])
+        cch++;
+    return cch * (SR_GLYPH_WIDTH + 1) * iScale;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CSoftRaster::DrawText
+//
+// Draws a string in the built-in font, every font pixel
+// as an iScale by iScale square. The characters outside
+// of the printable ASCII range are drawn as '?'.
+//
+// Parameters:
+//     int x, int y         : [in] the top left corner of the text
+//     const char* psz      : [in] the string
+//     unsigned int clr     : [in] the color of the text
+//     int iScale           : [in] the size of a font pixel, 1 or more
+//
+// Return Values (int):
+//      the width of the text drawn
+//
+/////////////////////////////////////////////////////////
+int CSoftRaster::DrawText(int x, int y, const char* psz, unsigned int clr, int iScale)
+{
+    int xStart = x;
+    for (; '\0' != *psz; psz++)
+    {
+        unsigned int uChar = (unsigned char)*psz;
+        if (uChar < 0x20 || uChar - 0x20 >= countof(gc_rgGlyphs))
+            uChar = '?';
+        const unsigned char* pGlyph = gc_rgGlyphs[uChar - 0x20];
+
+        for (int iColumn = 0; iColumn < SR_GLYPH_WIDTH; iColumn++)
+        {
+            unsigned int uBits = pGlyph[iColumn];
+            for (int iRow = 0; 0 != uBits; iRow++, uBits >>= 1)
+            {
+                if (uBits & 1)
+                {
+                    RasterRect rc = { x + iColumn * iScale, y + iRow * iScale,
+                                      x + (iColumn + 1) * iScale, y + (iRow + 1) * iScale };
+                    FillRect(rc, clr);
+                }
+            }
+        }
+        x += (SR_GLYPH_WIDTH + 1) * iScale;
+    }
+    return x - xStart;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CSoftRaster::FindPixel
+//
+// Tells if any pixel of a rectangle has the given color.
+//
+/////////////////////////////////////////////////////////
+bool CSoftRaster::FindPixel(const RasterRect& rc, unsigned int clr) const
+{
+    int xLeft = (rc.left < 0) ? 0 : rc.left;
+    int xRight = (rc.right > m_cx) ? m_cx : rc.right;
+    int yTop = (rc.top < 0) ? 0 : rc.top;
+    int yBottom = (rc.bottom > m_cy) ? m_cy : rc.bottom;
+
+    for (int y = yTop; y < yBottom; y++)
+    {
+        const unsigned int* pRow = m_pPixels + (size_t)y * m_cx;
+        for (int x = xLeft; x < xRight; x++)
+        {
+            if (clr == pRow[x])
+                return true;
+        }
+    }
+    return false;
+}
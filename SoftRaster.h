@@ -0,0 +1,83 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      SoftRaster.h
+//
+// Description:
+//      This file contains the definition of the CSoftRaster class, a
+//      small software rasterizer into a 32-bit RGB frame buffer: solid
+//      rectangles, one pixel lines and text in a built-in 5x7 font. The
+//      headless pipeline (HeadlessApp.h) draws the sample's windows with
+//      it, so that the benchmarks can measure the time to the pixels
+//      without a display, the tiled canvas (TiledCanvas.h) draws its
+//      tiles with it and copies them to the frame, and the ink layers
+//      (InkLayers.h) compose the committed and the live ink with it.
+//      The methods of the class are defined in the SoftRaster.cpp file.
+//--------------------------------------------------------------------------
+
+#pragma once
+
+#include <stddef.h>
+
+// Colors, 0x00RRGGBB
+#define SR_RGB(r, g, b)     (((unsigned int)(r) << 16) | ((unsigned int)(g) << 8) | (unsigned int)(b))
+#define SR_TRANSPARENT      0xFF000000  // no SR_RGB color; BlitTransparent skips it
+
+enum {
+    SR_GLYPH_WIDTH = 5,     // the font cell is SR_GLYPH_WIDTH + 1 pixels wide
+    SR_GLYPH_HEIGHT = 8     // the font cell height, 7 pixels and a gap
+};
+
+// A rectangle in pixels, right and bottom exclusive
+struct RasterRect
+{
+    int     left;
+    int     top;
+    int     right;
+    int     bottom;
+};
+
+/////////////////////////////////////////////////////////
+//
+// class CSoftRaster
+//
+// A frame buffer and the drawing primitives. All of them
+// clip to the buffer.
+//
+/////////////////////////////////////////////////////////
+
+class CSoftRaster
+{
+    unsigned int*   m_pPixels;
+    int             m_cx;
+    int             m_cy;
+
+public:
+
+    // Constructor and destructor
+    CSoftRaster() : m_pPixels(NULL), m_cx(0), m_cy(0) {}
+    ~CSoftRaster();
+
+    bool Create(int cx, int cy);
+
+    // Drawing
+    void FillRect(const RasterRect& rc, unsigned int clr);
+    void DrawLine(int x0, int y0, int x1, int y1, unsigned int clr);
+    void Blit(const CSoftRaster& src, int x, int y);
+    void BlitScaled(const CSoftRaster& src, const RasterRect& rcSrc, int x, int y, int iScale);
+    void BlitRect(const CSoftRaster& src, const RasterRect& rcSrc, int x, int y);
+    void BlitTransparent(const CSoftRaster& src, const RasterRect& rcSrc, int x, int y);
+    int  DrawText(int x, int y, const char* psz, unsigned int clr, int iScale);
+    static int GetTextWidth(const char* psz, int iScale);
+
+    // Data members access methods
+    int  GetWidth() const { return m_cx; }
+    int  GetHeight() const { return m_cy; }
+    unsigned int GetPixel(int x, int y) const { return m_pPixels[y * m_cx + x]; }
+    bool FindPixel(const RasterRect& rc, unsigned int clr) const;
+};
@@ -0,0 +1,199 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      StrokeDecimator.cpp
+//
+// Description:
+//      The file contains the definitions of the methods of the class
+//      CStrokeDecimator.
+//      See the file StrokeDecimator.h for the definition of the class.
+//--------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "StrokeDecimator.h"
+#include "Trace.h"
+
+/////////////////////////////////////////////////////////
+//
+// CStrokeDecimator::CStrokeDecimator
+//
+// Constructor.
+//
+// Parameters:
+//     float fTolerance : [in] the farthest a dropped point may be from
+//                        the kept polyline, in ink units; 0 keeps every
+//                        point
+//
+/////////////////////////////////////////////////////////
+CStrokeDecimator::CStrokeDecimator(float fTolerance)
+    : m_fTolerance(0), m_piStack(NULL), m_pbKeep(NULL), m_cMaxPoints(0)
+{
+    SetTolerance(fTolerance);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CStrokeDecimator::~CStrokeDecimator
+//
+// Destructor.
+//
+/////////////////////////////////////////////////////////
+CStrokeDecimator::~CStrokeDecimator()
+{
+    free(m_piStack);
+    free(m_pbKeep);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CStrokeDecimator::GetSegmentDistance
+//
+// Return Values (float):
+//      the distance from a point to the segment between two
+//      others; a segment of zero length (the ends of a closed
+//      stroke) is a point
+//
+/////////////////////////////////////////////////////////
+float CStrokeDecimator::GetSegmentDistance(
+        const GesturePoint& pt,
+        const GesturePoint& ptA,
+        const GesturePoint& ptB
+        )
+{
+    float dx = ptB.x - ptA.x;
+    float dy = ptB.y - ptA.y;
+    float fLengthSq = dx * dx + dy * dy;
+    float fT = 0;
+    if (fLengthSq > 0)
+    {
+        fT = ((pt.x - ptA.x) * dx + (pt.y - ptA.y) * dy) / fLengthSq;
+        fT = (fT < 0) ? 0 : (fT > 1) ? 1 : fT;
+    }
+    float ex = ptA.x + fT * dx - pt.x;
+    float ey = ptA.y + fT * dy - pt.y;
+    return sqrtf(ex * ex + ey * ey);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CStrokeDecimator::Decimate
+//
+// Keeps the ends of the stroke and splits a span at its
+// point farthest from the segment between its ends, for as
+// long as that point is farther than the tolerance. The
+// spans are split from an explicit stack, so a long stroke
+// can't overflow the thread's stack.
+//
+// Parameters:
+//     const GesturePoint* ppt : [in] the points of the stroke
+//     int cPoints             : [in] the number of the points
+//     GesturePoint* pptOut    : [out] the kept points, in order; room for
+//                               cPoints, may be ppt
+//
+// Return Values (int):
+//      the number of the kept points; all of them if the tolerance is 0
+//      or out of memory
+//
+/////////////////////////////////////////////////////////
+int CStrokeDecimator::Decimate(
+        const GesturePoint* ppt,
+        int cPoints,
+        GesturePoint* pptOut
+        )
+{
+    if (cPoints <= 2 || 0 == m_fTolerance)
+    {
+        if (pptOut != ppt && cPoints > 0)
+            memmove(pptOut, ppt, cPoints * sizeof(GesturePoint));
+        return (cPoints > 0) ? cPoints : 0;
+    }
+
+    TRACE_SCOPE("Decimate stroke");
+    if (cPoints > m_cMaxPoints)
+    {
+        int* piStack = (int*)realloc(m_piStack, 2 * cPoints * sizeof(int));
+        if (NULL != piStack)
+            m_piStack = piStack;
+        unsigned char* pbKeep = (unsigned char*)realloc(m_pbKeep, cPoints);
+        if (NULL != pbKeep)
+            m_pbKeep = pbKeep;
+        if (NULL == piStack || NULL == pbKeep)
+        {
+            if (pptOut != ppt)
+                memmove(pptOut, ppt, cPoints * sizeof(GesturePoint));
+            return cPoints;
+        }
+        m_cMaxPoints = cPoints;
+    }
+
+    const float fToleranceSq = m_fTolerance * m_fTolerance;
+    memset(m_pbKeep, 0, cPoints);
+    m_pbKeep[0] = m_pbKeep[cPoints - 1] = 1;
+
+    // A span on the stack has a point in between its ends, so there
+    // are never more spans than points
+    int cStack = 0;
+    m_piStack[cStack++] = 0;
+    m_piStack[cStack++] = cPoints - 1;
+    while (cStack > 0)
+    {
+        int iLast = m_piStack[--cStack];
+        int iFirst = m_piStack[--cStack];
+
+        // The distance to the segment, with the constants of the span
+        // taken out of the loop
+        const GesturePoint& ptA = ppt[iFirst];
+        float dx = ppt[iLast].x - ptA.x;
+        float dy = ppt[iLast].y - ptA.y;
+        float fLengthSq = dx * dx + dy * dy;
+        float fInvLengthSq = (fLengthSq > 0) ? 1.0f / fLengthSq : 0.0f;
+        float fMaxSq = 0;
+        int iMax = -1;
+        for (int i = iFirst + 1; i < iLast; i++)
+        {
+            float px = ppt[i].x - ptA.x;
+            float py = ppt[i].y - ptA.y;
+            float fT = (px * dx + py * dy) * fInvLengthSq;
+            fT = (fT < 0) ? 0 : (fT > 1) ? 1 : fT;
+            float ex = fT * dx - px;
+            float ey = fT * dy - py;
+            float fDistanceSq = ex * ex + ey * ey;
+            if (fDistanceSq > fMaxSq)
+            {
+                fMaxSq = fDistanceSq;
+                iMax = i;
+            }
+        }
+        if (fMaxSq <= fToleranceSq)
+            continue;
+
+        m_pbKeep[iMax] = 1;
+        if (iMax - iFirst > 1)
+        {
+            m_piStack[cStack++] = iFirst;
+            m_piStack[cStack++] = iMax;
+        }
+        if (iLast - iMax > 1)
+        {
+            m_piStack[cStack++] = iMax;
+            m_piStack[cStack++] = iLast;
+        }
+    }
+
+    // The kept points only move to lower indexes, so in place is fine
+    int cKept = 0;
+    for (int i = 0; i < cPoints; i++)
+    {
+        if (m_pbKeep[i])
+            pptOut[cKept++] = ppt[i];
+    }
+    return cKept;
+}
@@ -0,0 +1,68 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      StrokeDecimator.h
+//
+// Description:
+//      This file contains the definition of the CStrokeDecimator class,
+//      the Ramer-Douglas-Peucker simplification of a stroke. A digitizer
+//      reports a packet every millisecond or so, many more points than the
+//      shape of the stroke needs; the decimator keeps the ends and the
+//      fewest points such that no dropped point is farther than the
+//      tolerance from the polyline that's kept. The strokes are decimated
+//      when they end, before they're stored and recognized.
+//
+//      The methods of the class are defined in the StrokeDecimator.cpp
+//      file.
+//--------------------------------------------------------------------------
+
+#pragma once
+
+#include "GestureEngine.h"
+
+#define SD_DEFAULT_TOLERANCE    10.0f   // in ink units (HIMETRIC, 0.01 mm)
+
+/////////////////////////////////////////////////////////
+//
+// class CStrokeDecimator
+//
+// Decimates strokes with a fixed tolerance. The split
+// stack and the flags of the kept points grow with the
+// longest stroke and are reused, so a decimator isn't
+// shared between threads.
+//
+/////////////////////////////////////////////////////////
+
+class CStrokeDecimator
+{
+    float           m_fTolerance;   // 0 keeps every point
+    int*            m_piStack;      // the spans to split, as first, last pairs
+    unsigned char*  m_pbKeep;       // a flag per point
+    int             m_cMaxPoints;
+
+public:
+
+    // Constructor and destructor
+    CStrokeDecimator(float fTolerance = SD_DEFAULT_TOLERANCE);
+    ~CStrokeDecimator();
+
+    int  Decimate(const GesturePoint* ppt, int cPoints, GesturePoint* pptOut);
+
+    // Data members access methods
+    float GetTolerance() const { return m_fTolerance; }
+    void  SetTolerance(float fTolerance) { m_fTolerance = (fTolerance > 0) ? fTolerance : 0; }
+
+    static float GetSegmentDistance(const GesturePoint& pt, const GesturePoint& ptA,
+                                    const GesturePoint& ptB);
+
+private:
+
+    // Not copyable
+    CStrokeDecimator(const CStrokeDecimator&);
+    CStrokeDecimator& operator=(const CStrokeDecimator&);
+};
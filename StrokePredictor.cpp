@@ -0,0 +1,225 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      StrokePredictor.cpp
+//
+// Description:
+//      The file contains the definitions of the methods of the class
+//      CStrokePredictor. See the file StrokePredictor.h for the definition
+//      of the class.
+//--------------------------------------------------------------------------
+
+#include <math.h>
+
+#include "StrokePredictor.h"
+
+#define SP_PI                   3.14159265f
+#define SP_ACCEL_NOISE          4e9f    // ink units^2 / s^3, the white noise acceleration
+#define SP_PACKET_NOISE         4.0f    // ink units^2, the digitizer's
+#define SP_MIN_PACKETS          3       // before a tail is drawn
+#define SP_MIN_SPEED            2000.0f // ink units a second; slower gets no tail
+#define SP_SMOOTH_TIME          0.02f   // seconds, of the acceleration and the turn rate
+#define SP_MAX_TURN_ANGLE       (SP_PI / 8) // the most a tail turns
+
+/////////////////////////////////////////////////////////
+//
+// CStrokePredictor::CStrokePredictor
+//
+// Constructor. The tail is a frame and a half long by
+// default.
+//
+/////////////////////////////////////////////////////////
+CStrokePredictor::CStrokePredictor()
+    : m_ptLookahead(SP_DEFAULT_LOOKAHEAD), m_fMaxTail(SP_DEFAULT_MAX_TAIL),
+      m_ptLastTime(0), m_fSpeed(0), m_fHeading(0), m_fAccel(0), m_fTurn(0),
+      m_cPackets(0)
+{
+    m_ptLastPacket.x = m_ptLastPacket.y = 0;
+    for (int i = 0; i < 2; i++)
+    {
+        AxisFilter& axis = m_rgAxes[i];
+        axis.p = axis.v = 0;
+        axis.p00 = axis.p01 = axis.p11 = 0;
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CStrokePredictor::AddPacket
+//
+// Takes a packet of the stroke: moves the filters to its
+// time and corrects them with it, then smooths the change
+// of their speed and heading into the acceleration and the
+// turn rate.
+//
+// Parameters:
+//     float x, float y  : [in] the packet position, in ink units
+//     PERFTIME ptTime   : [in] when the pen was there
+//
+/////////////////////////////////////////////////////////
+void CStrokePredictor::AddPacket(float x, float y, PERFTIME ptTime)
+{
+    float rgz[2] = { x, y };
+    if (0 == m_cPackets)
+    {
+        // At rest until the packets tell otherwise, with a wide
+        // uncertainty of the velocity
+        for (int i = 0; i < 2; i++)
+        {
+            AxisFilter& axis = m_rgAxes[i];
+            axis.p = rgz[i];
+            axis.v = 0;
+            axis.p00 = SP_PACKET_NOISE;
+            axis.p01 = 0;
+            axis.p11 = 1e10f;
+        }
+        m_fSpeed = m_fHeading = m_fAccel = m_fTurn = 0;
+    }
+    else
+    {
+        float dt = (ptTime > m_ptLastTime) ? (ptTime - m_ptLastTime) / 1e9f : 0;
+        for (int i = 0; i < 2; i++)
+        {
+            AxisFilter& axis = m_rgAxes[i];
+
+            // Predict: the velocity holds, its uncertainty grows
+            // with the white noise acceleration
+            float q = SP_ACCEL_NOISE;
+            axis.p += axis.v * dt;
+            axis.p00 += dt * (2 * axis.p01 + dt * axis.p11) + q * dt * dt * dt / 3;
+            axis.p01 += dt * axis.p11 + q * dt * dt / 2;
+            axis.p11 += q * dt;
+
+            // Correct with the packet
+            float fInnovation = rgz[i] - axis.p;
+            float s = axis.p00 + SP_PACKET_NOISE;
+            float k0 = axis.p00 / s;
+            float k1 = axis.p01 / s;
+            axis.p += k0 * fInnovation;
+            axis.v += k1 * fInnovation;
+            axis.p11 -= k1 * axis.p01;
+            axis.p00 -= k0 * axis.p00;
+            axis.p01 -= k0 * axis.p01;
+        }
+
+        float fSpeed = sqrtf(m_rgAxes[0].v * m_rgAxes[0].v + m_rgAxes[1].v * m_rgAxes[1].v);
+        float fHeading = atan2f(m_rgAxes[1].v, m_rgAxes[0].v);
+        if (dt > 0 && m_cPackets > 1)
+        {
+            float fTurn = fHeading - m_fHeading;
+            if (fTurn > SP_PI)
+                fTurn -= 2 * SP_PI;
+            else if (fTurn < -SP_PI)
+                fTurn += 2 * SP_PI;
+            float fWeight = (dt < SP_SMOOTH_TIME) ? dt / SP_SMOOTH_TIME : 1.0f;
+            m_fAccel += fWeight * ((fSpeed - m_fSpeed) / dt - m_fAccel);
+            m_fTurn += fWeight * (fTurn / dt - m_fTurn);
+        }
+        m_fSpeed = fSpeed;
+        m_fHeading = fHeading;
+    }
+
+    m_ptLastPacket.x = x;
+    m_ptLastPacket.y = y;
+    m_ptLastTime = ptTime;
+    m_cPackets++;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CStrokePredictor::Extrapolate
+//
+// Walks from the last packet along the arc the pen's speed,
+// turn rate and deceleration make, for a time ahead, and
+// puts the last packet and SP_TAIL_POINTS points along the
+// arc. The pen is never taken to speed up, nor past the
+// point where it would stop, nor more than the longest
+// tail away, nor to turn more than SP_MAX_TURN_ANGLE.
+//
+// Parameters:
+//     PERFTIME ptAhead   : [in] the time ahead of the last packet
+//     GesturePoint* ppt  : [out] SP_TAIL_POINTS + 1 points
+//
+// Return Values (int):
+//      the number of the points, 0 if there's no tail
+//
+/////////////////////////////////////////////////////////
+int CStrokePredictor::Extrapolate(PERFTIME ptAhead, GesturePoint* ppt) const
+{
+    if (m_cPackets < SP_MIN_PACKETS || 0 == ptAhead || m_fSpeed < SP_MIN_SPEED)
+        return 0;
+
+    float tEnd = ptAhead / 1e9f;
+    float fAccel = (m_fAccel < 0) ? m_fAccel : 0;
+    if (fAccel < 0 && -m_fSpeed / fAccel < tEnd)
+        tEnd = -m_fSpeed / fAccel;
+    float fLength = m_fSpeed * tEnd + fAccel * tEnd * tEnd / 2;
+    if (fLength > m_fMaxTail)
+        fLength = m_fMaxTail;
+    float fTurn = m_fTurn;
+    if (fabsf(fTurn) * tEnd > SP_MAX_TURN_ANGLE)
+        fTurn = (fTurn > 0) ? SP_MAX_TURN_ANGLE / tEnd : -SP_MAX_TURN_ANGLE / tEnd;
+
+    ppt[0] = m_ptLastPacket;
+    float fWalked = 0;
+    for (int k = 1; k <= SP_TAIL_POINTS; k++)
+    {
+        float t = tEnd * k / SP_TAIL_POINTS;
+        float fTo = m_fSpeed * t + fAccel * t * t / 2;
+        if (fTo > fLength)
+            fTo = fLength;
+        float fHeading = m_fHeading + fTurn * (t - tEnd / (2 * SP_TAIL_POINTS));
+        ppt[k].x = ppt[k - 1].x + (fTo - fWalked) * cosf(fHeading);
+        ppt[k].y = ppt[k - 1].y + (fTo - fWalked) * sinf(fHeading);
+        fWalked = fTo;
+    }
+    return SP_TAIL_POINTS + 1;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CStrokePredictor::Predict
+//
+// Predicts the tail of the stroke for the lookahead.
+//
+// Parameters:
+//     GesturePoint* ppt  : [out] SP_TAIL_POINTS + 1 points, the
+//                          first is the last packet
+//
+// Return Values (int):
+//      the number of the points, 0 if there's no tail
+//
+/////////////////////////////////////////////////////////
+int CStrokePredictor::Predict(GesturePoint* ppt) const
+{
+    return Extrapolate(m_ptLookahead, ppt);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CStrokePredictor::PredictAt
+//
+// Predicts where the pen is a time after the last packet.
+//
+// Parameters:
+//     PERFTIME ptAhead   : [in] the time after the last packet
+//     GesturePoint& pt   : [out] the predicted position, the last
+//                          packet if there's no prediction
+//
+// Return Values (bool):
+//      true if predicted, false if the pen is taken to be
+//      where the last packet is
+//
+/////////////////////////////////////////////////////////
+bool CStrokePredictor::PredictAt(PERFTIME ptAhead, GesturePoint& pt) const
+{
+    GesturePoint rgpt[SP_TAIL_POINTS + 1];
+    int cPoints = Extrapolate(ptAhead, rgpt);
+    pt = (cPoints > 0) ? rgpt[cPoints - 1] : m_ptLastPacket;
+    return cPoints > 0;
+}
@@ -0,0 +1,95 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      StrokePredictor.h
+//
+// Description:
+//      This file contains the definition of the CStrokePredictor class,
+//      which predicts where the pen is from the packets of the stroke so
+//      far. The ink lags the pen tip by the time a packet takes to get to
+//      the screen, a frame or two; a short tail drawn from the last packet
+//      to the predicted tip hides some of it, and is replaced by the real
+//      ink as the packets come.
+//
+//      The pen's position and velocity are tracked by a Kalman filter per
+//      axis, with a white noise acceleration, so the digitizer's noise
+//      doesn't swing the tail the way an extrapolation of the last two
+//      packets does. The tail follows the turn rate of the stroke and, if
+//      the pen is slowing down, its deceleration, but never past where
+//      the pen would stop: it has no hooks and doesn't overshoot the end
+//      of a stroke by much. A slow pen gets no tail.
+//
+//      The methods of the class are defined in the StrokePredictor.cpp
+//      file.
+//--------------------------------------------------------------------------
+
+#pragma once
+
+#include "PerfTimer.h"
+#include "GestureEngine.h"
+
+#define SP_DEFAULT_LOOKAHEAD    25000000ULL // in ns, hides about a frame of the lag
+#define SP_DEFAULT_MAX_TAIL     500.0f      // in ink units (HIMETRIC, 0.01 mm)
+
+enum {
+    SP_TAIL_POINTS = 8          // the points of a tail, past the last packet
+};
+
+// The Kalman filter of an axis: the position, the velocity
+// in ink units a second, and their covariance
+struct AxisFilter
+{
+    float   p;
+    float   v;
+    float   p00, p01, p11;
+};
+
+/////////////////////////////////////////////////////////
+//
+// class CStrokePredictor
+//
+// Predicts the tail of the stroke being drawn. Called by
+// one thread at a time.
+//
+/////////////////////////////////////////////////////////
+
+class CStrokePredictor
+{
+    PERFTIME        m_ptLookahead;      // 0 predicts nothing
+    float           m_fMaxTail;
+    AxisFilter      m_rgAxes[2];
+    GesturePoint    m_ptLastPacket;
+    PERFTIME        m_ptLastTime;
+    float           m_fSpeed;           // of the filter, in ink units a second
+    float           m_fHeading;         // radians
+    float           m_fAccel;           // along the path, smoothed
+    float           m_fTurn;            // radians a second, smoothed
+    int             m_cPackets;
+
+public:
+
+    // Constructor
+    CStrokePredictor();
+
+    // Settings
+    void SetLookahead(PERFTIME ptLookahead) { m_ptLookahead = ptLookahead; }
+    PERFTIME GetLookahead() const { return m_ptLookahead; }
+    void SetMaxTail(float fMaxTail) { m_fMaxTail = (fMaxTail > 0) ? fMaxTail : 0; }
+
+    // The packets
+    void BeginStroke() { m_cPackets = 0; }
+    void AddPacket(float x, float y, PERFTIME ptTime);
+
+    // The tail
+    int  Predict(GesturePoint* ppt) const;
+    bool PredictAt(PERFTIME ptAhead, GesturePoint& pt) const;
+
+private:
+
+    int  Extrapolate(PERFTIME ptAhead, GesturePoint* ppt) const;
+};
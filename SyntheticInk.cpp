@@ -0,0 +1,97 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      SyntheticInk.cpp
+//
+// Description:
+//      The file contains the definitions of the methods of the class
+//      CSyntheticInk.
+//      See the file SyntheticInk.h for the definition of the class.
+//--------------------------------------------------------------------------
+
+#include <math.h>
+
+#include "SyntheticInk.h"
+
+/////////////////////////////////////////////////////////
+//
+// CSyntheticInk::NextUInt
+//
+// A 32-bit xorshift generator. It's used instead of rand()
+// to get the same strokes with every C runtime.
+//
+/////////////////////////////////////////////////////////
+unsigned int CSyntheticInk::NextUInt()
+{
+    unsigned int x = m_uSeed ? m_uSeed : 0x6D2B79F5;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    m_uSeed = x;
+    return x;
+}
+
+float CSyntheticInk::NextFloat()
+{
+    return (NextUInt() >> 8) * (1.0f / 16777216.0f);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CSyntheticInk::MakeStroke
+//
+// Generates a distorted copy of a built-in shape with a
+// random number of points, the way different pens at
+// different speeds would produce it.
+//
+// Parameters:
+//     int iShape         : [in] 0..CGestureEngine::GetBuiltinShapeCount()-1
+//     int& iGesture      : [out] the gesture the shape stands for
+//     GesturePoint* ppt  : [out] the stroke points
+//     int cMaxPoints     : [in] the size of the ppt array, >= 8
+//
+// Return Values (int):
+//      the number of points generated, 0 if iShape is invalid
+//
+/////////////////////////////////////////////////////////
+int CSyntheticInk::MakeStroke(
+        int iShape,
+        int& iGesture,
+        GesturePoint* ppt,
+        int cMaxPoints
+        )
+{
+    // Vary the sampling density between a quarter and all of the buffer
+    int cPoints = (int)NextRange(cMaxPoints / 4.0f, (float)cMaxPoints);
+    if (cPoints < 8)
+        cPoints = (cMaxPoints < 8) ? cMaxPoints : 8;
+
+    cPoints = CGestureEngine::GetBuiltinShape(iShape, iGesture, ppt, cPoints);
+    if (0 == cPoints || GE_GESTURE_TAP == iGesture)
+        return cPoints;
+
+    float fAngle = NextRange(-0.12f, 0.12f) * m_fNoise;         // up to ~7 degrees
+    float fScaleX = 1.0f + NextRange(-0.15f, 0.15f) * m_fNoise;
+    float fScaleY = 1.0f + NextRange(-0.15f, 0.15f) * m_fNoise;
+    float fSize = NextRange(0.5f, 2.0f);                         // overall size
+    float fOffsetX = NextRange(0.0f, 10000.0f);
+    float fOffsetY = NextRange(0.0f, 10000.0f);
+    float fJitter = 15.0f * m_fNoise;
+
+    float fCos = cosf(fAngle);
+    float fSin = sinf(fAngle);
+    for (int i = 0; i < cPoints; i++)
+    {
+        float x = ppt[i].x * fScaleX * fSize;
+        float y = ppt[i].y * fScaleY * fSize;
+        ppt[i].x = x * fCos - y * fSin + fOffsetX + NextRange(-fJitter, fJitter);
+        ppt[i].y = x * fSin + y * fCos + fOffsetY + NextRange(-fJitter, fJitter);
+    }
+
+    return cPoints;
+}
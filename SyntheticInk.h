@@ -0,0 +1,52 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      SyntheticInk.h
+//
+// Description:
+//      This file contains the definition of the CSyntheticInk class,
+//      a deterministic generator of pen-like strokes for the built-in
+//      gesture shapes. The console tools use it in place of a pen.
+//      The methods of the class are defined in the SyntheticInk.cpp file.
+//--------------------------------------------------------------------------
+
+#pragma once
+
+#include "GestureEngine.h"
+
+/////////////////////////////////////////////////////////
+//
+// class CSyntheticInk
+//
+// Produces distorted copies of the built-in shapes: rotated,
+// stretched, shifted and jittered. The same seed always
+// produces the same sequence of strokes on every platform.
+//
+/////////////////////////////////////////////////////////
+
+class CSyntheticInk
+{
+    unsigned int    m_uSeed;
+    float           m_fNoise;       // distortion level, 1.0 is a typical user
+
+public:
+
+    CSyntheticInk(unsigned int uSeed = 1, float fNoise = 1.0f)
+        : m_uSeed(uSeed), m_fNoise(fNoise)
+    {
+    }
+
+    // Returns a uniformly distributed number in [0, 1)
+    float NextFloat();
+    // Returns a uniformly distributed number in [fMin, fMax)
+    float NextRange(float fMin, float fMax) { return fMin + (fMax - fMin) * NextFloat(); }
+    unsigned int NextUInt();
+
+    // Generates a stroke for the given built-in shape
+    int MakeStroke(int iShape, int& iGesture, GesturePoint* ppt, int cMaxPoints);
+};
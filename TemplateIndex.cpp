@@ -0,0 +1,400 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      TemplateIndex.cpp
+//
+// Description:
+//      The file contains the definitions of the methods of the class
+//      CTemplateIndex.
+//      See the file TemplateIndex.h for the definition of the class.
+//--------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+#include "TemplateIndex.h"
+
+// Comparison of the build items by their distance to the vantage point
+struct BuildItemLess
+{
+    template <class T>
+    bool operator()(const T& a, const T& b) const { return a.fDist < b.fDist; }
+};
+
+// The state of a k nearest neighbours search. The candidates are kept
+// in a max-heap by distance, so the farthest one is replaced first.
+struct VPSearch
+{
+    const VPNode*   pNodes;
+    const float*    pfFeatures;
+    const float*    pfQuery;
+    int             cMax;
+    int             cFound;
+    float           fTau;       // distance to the farthest candidate kept
+    float           rgfDist[CTemplateIndex::mc_cMaxCandidates];
+    int             rgiItem[CTemplateIndex::mc_cMaxCandidates];
+};
+
+static void HeapSiftDown(VPSearch& s, int i)
+{
+    for (;;)
+    {
+        int iLargest = i;
+        int iLeft = 2 * i + 1;
+        int iRight = iLeft + 1;
+        if (iLeft < s.cFound && s.rgfDist[iLeft] > s.rgfDist[iLargest])
+            iLargest = iLeft;
+        if (iRight < s.cFound && s.rgfDist[iRight] > s.rgfDist[iLargest])
+            iLargest = iRight;
+        if (iLargest == i)
+            break;
+        std::swap(s.rgfDist[i], s.rgfDist[iLargest]);
+        std::swap(s.rgiItem[i], s.rgiItem[iLargest]);
+        i = iLargest;
+    }
+}
+
+static void HeapPush(VPSearch& s, float fDist, int iItem)
+{
+    if (s.cFound < s.cMax)
+    {
+        // Append and sift up
+        int i = s.cFound++;
+        s.rgfDist[i] = fDist;
+        s.rgiItem[i] = iItem;
+        while (i > 0)
+        {
+            int iParent = (i - 1) / 2;
+            if (s.rgfDist[iParent] >= s.rgfDist[i])
+                break;
+            std::swap(s.rgfDist[i], s.rgfDist[iParent]);
+            std::swap(s.rgiItem[i], s.rgiItem[iParent]);
+            i = iParent;
+        }
+    }
+    else
+    {
+        // Replace the farthest candidate
+        s.rgfDist[0] = fDist;
+        s.rgiItem[0] = iItem;
+        HeapSiftDown(s, 0);
+    }
+
+    if (s.cFound == s.cMax)
+    {
+        s.fTau = s.rgfDist[0];
+    }
+}
+
+static void SearchNode(VPSearch& s, int iNode)
+{
+    while (iNode >= 0)
+    {
+        const VPNode& node = s.pNodes[iNode];
+        float fDist = CTemplateIndex::Distance(
+                        s.pfQuery, s.pfFeatures + node.iItem * GE_NUM_FEATURES);
+        if (fDist < s.fTau)
+        {
+            HeapPush(s, fDist, node.iItem);
+        }
+
+        // Descend into the more promising subtree first, visit the other
+        // one only if the search ball still crosses the partition boundary.
+        // The second visit is a loop iteration rather than a recursive call.
+        if (fDist <= node.fRadius)
+        {
+            if (node.iInside >= 0 && fDist - s.fTau <= node.fRadius)
+                SearchNode(s, node.iInside);
+            iNode = (fDist + s.fTau > node.fRadius) ? node.iOutside : -1;
+        }
+        else
+        {
+            if (node.iOutside >= 0 && fDist + s.fTau > node.fRadius)
+                SearchNode(s, node.iOutside);
+            iNode = (fDist - s.fTau <= node.fRadius) ? node.iInside : -1;
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CTemplateIndex::CTemplateIndex
+//
+// Constructor.
+//
+// Parameters:
+//     none
+//
+/////////////////////////////////////////////////////////
+CTemplateIndex::CTemplateIndex() : m_pNodes(NULL), m_cNodes(0), m_bOwnsNodes(false)
+{
+}
+
+/////////////////////////////////////////////////////////
+//
+// CTemplateIndex::~CTemplateIndex
+//
+// Destructor.
+//
+/////////////////////////////////////////////////////////
+CTemplateIndex::~CTemplateIndex()
+{
+    Clear();
+}
+
+/////////////////////////////////////////////////////////
+//
+// CTemplateIndex::Clear
+//
+// Releases the tree (if it's owned by the object) and
+// leaves the index empty.
+//
+// Parameters:
+//     none
+//
+// Return Values (void):
+//      none
+//
+/////////////////////////////////////////////////////////
+void CTemplateIndex::Clear()
+{
+    if (m_bOwnsNodes)
+    {
+        free(m_pNodes);
+    }
+    m_pNodes = NULL;
+    m_cNodes = 0;
+    m_bOwnsNodes = false;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CTemplateIndex::Attach
+//
+// Makes the index use a preorder node array produced earlier
+// by Build (typically mapped from a template pack file).
+// The array is not copied and must outlive the index.
+//
+// Parameters:
+//     const VPNode* pNodes : [in] the node array
+//     int cNodes           : [in] the number of nodes
+//
+// Return Values (void):
+//      none
+//
+/////////////////////////////////////////////////////////
+void CTemplateIndex::Attach(const VPNode* pNodes, int cNodes)
+{
+    Clear();
+    m_pNodes = const_cast<VPNode*>(pNodes);
+    m_cNodes = cNodes;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CTemplateIndex::Copy
+//
+// Makes the index the same as another one: a copy of its
+// tree if it owns it, the same attached array if not.
+//
+// Parameters:
+//     const CTemplateIndex& index : [in] the index to copy
+//
+// Return Values (bool):
+//      true if succeeded, false if out of memory
+//
+/////////////////////////////////////////////////////////
+bool CTemplateIndex::Copy(const CTemplateIndex& index)
+{
+    if (&index == this)
+        return true;
+    Clear();
+    if (false == index.m_bOwnsNodes || 0 == index.m_cNodes)
+    {
+        Attach(index.m_pNodes, index.m_cNodes);
+        return true;
+    }
+
+    m_pNodes = (VPNode*)malloc(index.m_cNodes * sizeof(VPNode));
+    if (NULL == m_pNodes)
+        return false;
+    memcpy(m_pNodes, index.m_pNodes, index.m_cNodes * sizeof(VPNode));
+    m_cNodes = index.m_cNodes;
+    m_bOwnsNodes = true;
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CTemplateIndex::Distance
+//
+// The Euclidean distance between two feature vectors.
+//
+/////////////////////////////////////////////////////////
+float CTemplateIndex::Distance(const float* pfA, const float* pfB)
+{
+    float fSum = 0.0f;
+    for (int i = 0; i < GE_NUM_FEATURES; i++)
+    {
+        float d = pfA[i] - pfB[i];
+        fSum += d * d;
+    }
+    return sqrtf(fSum);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CTemplateIndex::Build
+//
+// Builds the tree over the given feature vectors. Building is
+// O(n log n); it's done once after the templates are loaded
+// (or offline, when the templates are baked into a pack).
+//
+// Parameters:
+//     const float* pfFeatures : [in] cItems * GE_NUM_FEATURES floats
+//     int cItems              : [in] the number of vectors
+//
+// Return Values (bool):
+//      true if succeeded, false if out of memory
+//
+/////////////////////////////////////////////////////////
+bool CTemplateIndex::Build(const float* pfFeatures, int cItems)
+{
+    Clear();
+    if (cItems <= 0)
+        return true;
+
+    BuildItem* pItems = (BuildItem*)malloc(cItems * sizeof(BuildItem));
+    m_pNodes = (VPNode*)malloc(cItems * sizeof(VPNode));
+    if (NULL == pItems || NULL == m_pNodes)
+    {
+        free(pItems);
+        free(m_pNodes);
+        m_pNodes = NULL;
+        return false;
+    }
+    m_bOwnsNodes = true;
+
+    for (int i = 0; i < cItems; i++)
+    {
+        pItems[i].iItem = i;
+        pItems[i].fDist = 0.0f;
+    }
+
+    // A fixed seed keeps the tree (and a pack built from it) reproducible
+    unsigned int uSeed = 0x9E3779B9;
+    BuildNode(pfFeatures, pItems, cItems, uSeed);
+
+    free(pItems);
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CTemplateIndex::BuildNode
+//
+// Recursive helper of Build. Picks a random vantage point,
+// splits the rest of the items by the median distance to it
+// and builds the two subtrees.
+//
+// Return Values (int):
+//      the index of the created node, or -1 for an empty range
+//
+/////////////////////////////////////////////////////////
+int CTemplateIndex::BuildNode(
+        const float* pfFeatures,
+        BuildItem* pItems,
+        int cItems,
+        unsigned int& uSeed
+        )
+{
+    if (cItems <= 0)
+        return -1;
+
+    int iNode = m_cNodes++;
+
+    // Move a random vantage point to the front of the range
+    uSeed = uSeed * 1664525 + 1013904223;
+    std::swap(pItems[0], pItems[(uSeed >> 8) % cItems]);
+
+    VPNode& node = m_pNodes[iNode];
+    node.iItem = pItems[0].iItem;
+    node.fRadius = 0.0f;
+    node.iInside = node.iOutside = -1;
+
+    if (cItems == 1)
+        return iNode;
+
+    const float* pfVantage = pfFeatures + node.iItem * GE_NUM_FEATURES;
+    for (int i = 1; i < cItems; i++)
+    {
+        pItems[i].fDist = Distance(pfVantage, pfFeatures + pItems[i].iItem * GE_NUM_FEATURES);
+    }
+
+    // Partition the rest of the range around the median distance
+    int cRest = cItems - 1;
+    int iMedian = cRest / 2;
+    std::nth_element(pItems + 1, pItems + 1 + iMedian, pItems + cItems, BuildItemLess());
+    float fRadius = pItems[1 + iMedian].fDist;
+
+    // The node array is allocated for all items up front, so the node
+    // reference stays valid while the subtrees are being built
+    node.fRadius = fRadius;
+    node.iInside = BuildNode(pfFeatures, pItems + 1, iMedian + 1, uSeed);
+    node.iOutside = BuildNode(pfFeatures, pItems + 2 + iMedian, cRest - iMedian - 1, uSeed);
+
+    return iNode;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CTemplateIndex::Query
+//
+// Finds up to cMax items with the feature vectors closest
+// to the query vector. The result is not sorted.
+//
+// Parameters:
+//     const float* pfFeatures : [in] the array passed to Build
+//     const float* pfQuery    : [in] the query feature vector
+//     int cMax                : [in] the maximum number of candidates
+//     int* piItems            : [out] the candidate item indices
+//
+// Return Values (int):
+//      the number of candidates written to piItems
+//
+/////////////////////////////////////////////////////////
+int CTemplateIndex::Query(
+        const float* pfFeatures,
+        const float* pfQuery,
+        int cMax,
+        int* piItems
+        ) const
+{
+    if (0 == m_cNodes || cMax <= 0)
+        return 0;
+    if (cMax > mc_cMaxCandidates)
+        cMax = mc_cMaxCandidates;
+
+    VPSearch s;
+    s.pNodes = m_pNodes;
+    s.pfFeatures = pfFeatures;
+    s.pfQuery = pfQuery;
+    s.cMax = cMax;
+    s.cFound = 0;
+    s.fTau = 3.4e38f;
+
+    SearchNode(s, 0);
+
+    for (int i = 0; i < s.cFound; i++)
+    {
+        piItems[i] = s.rgiItem[i];
+    }
+    return s.cFound;
+}
@@ -0,0 +1,105 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      TemplateIndex.h
+//
+// Description:
+//      This file contains the definition of the CTemplateIndex class,
+//      a vantage point tree over the coarse feature vectors of the
+//      gesture templates. The engine queries it for a short list of
+//      candidate templates and runs the full (expensive) matching on
+//      those only.
+//      The methods of the class are defined in the TemplateIndex.cpp file.
+//--------------------------------------------------------------------------
+
+#pragma once
+
+// The layout of a coarse feature vector (see CGestureEngine::ComputeFeatures)
+enum {
+    FI_ASPECT = 0,          // (w - h) / (w + h) of the bounding box
+    FI_CLOSURE = 1,         // distance between the ends / path length
+    FI_TURN_FIRST = 2,      // 5 bins of the signed turning angle histogram
+    FI_START_DX = 7,        // direction of the first eighth of the stroke
+    FI_START_DY = 8,
+    FI_END_DX = 9,          // direction of the last eighth of the stroke
+    FI_END_DY = 10,
+    FI_DIR_FIRST = 11,      // 8 bins of the segment direction histogram
+    FI_TOTAL_TURN = 19,     // total absolute turning, in 4*pi units
+    GE_NUM_TURN_BINS = 5,
+    GE_NUM_DIR_BINS = 8,
+    GE_NUM_FEATURES = 20
+};
+
+// A node of the flattened tree. The nodes are stored in preorder in one
+// array, so the whole tree can be written to and mapped from a file as is.
+struct VPNode
+{
+    int     iItem;          // the vantage point (template index)
+    float   fRadius;        // median distance from the vantage point
+    int     iInside;        // child node with distances <= fRadius, or -1
+    int     iOutside;       // child node with distances > fRadius, or -1
+};
+
+/////////////////////////////////////////////////////////
+//
+// class CTemplateIndex
+//
+// Vantage point tree over fixed-size float feature vectors
+// with the Euclidean metric. The index keeps no copy of
+// the feature vectors; the caller passes the same array
+// to both Build and Query.
+//
+/////////////////////////////////////////////////////////
+
+class CTemplateIndex
+{
+    VPNode*         m_pNodes;       // preorder array of nodes
+    int             m_cNodes;
+    bool            m_bOwnsNodes;   // false if the nodes live in a mapped file
+
+public:
+
+    // Declare the class-wide constants
+    enum {
+        mc_cMaxCandidates = 256     // upper bound of the candidate list size
+    };
+
+    // Constructor and destructor
+    CTemplateIndex();
+    ~CTemplateIndex();
+
+    // Builds the tree over cItems vectors of GE_NUM_FEATURES floats each
+    bool Build(const float* pfFeatures, int cItems);
+
+    // Uses an existing preorder node array without copying it
+    void Attach(const VPNode* pNodes, int cNodes);
+    bool Copy(const CTemplateIndex& index);
+    void Clear();
+
+    // Returns the indices of up to cMax items nearest to pfQuery
+    int  Query(const float* pfFeatures, const float* pfQuery,
+               int cMax, int* piItems) const;
+
+    const VPNode* GetNodes() const { return m_pNodes; }
+    int  GetNodeCount() const { return m_cNodes; }
+    bool IsEmpty() const { return (0 == m_cNodes); }
+
+    static float Distance(const float* pfA, const float* pfB);
+
+private:
+
+    // Temporary (distance, item) pair used while building the tree
+    struct BuildItem
+    {
+        float   fDist;
+        int     iItem;
+    };
+
+    int  BuildNode(const float* pfFeatures, BuildItem* pItems, int cItems,
+                   unsigned int& uSeed);
+};
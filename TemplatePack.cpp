@@ -0,0 +1,354 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      TemplatePack.cpp
+//
+// Description:
+//      The file contains the definitions of the methods of the class
+//      CTemplatePack.
+//      See the file TemplatePack.h for the definition of the class.
+//--------------------------------------------------------------------------
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include "TemplatePack.h"
+
+// Rounds an offset up to the section alignment
+static unsigned long long AlignUp(unsigned long long ullOffset)
+{
+    return (ullOffset + TPK_ALIGNMENT - 1) & ~(unsigned long long)(TPK_ALIGNMENT - 1);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CTemplatePack::CTemplatePack
+//
+// Constructor.
+//
+// Parameters:
+//     none
+//
+/////////////////////////////////////////////////////////
+CTemplatePack::CTemplatePack() : m_pbView(NULL), m_cbView(0)
+#ifdef _WIN32
+    , m_hFile(INVALID_HANDLE_VALUE), m_hMapping(NULL)
+#else
+    , m_fd(-1)
+#endif
+{
+}
+
+/////////////////////////////////////////////////////////
+//
+// CTemplatePack::~CTemplatePack
+//
+// Destructor.
+//
+/////////////////////////////////////////////////////////
+CTemplatePack::~CTemplatePack()
+{
+    Close();
+}
+
+/////////////////////////////////////////////////////////
+//
+// CTemplatePack::Open
+//
+// Maps a pack file into memory read-only and validates
+// its header. Only the header page is touched here; the
+// sections are paged in on first use (or are already in
+// the file cache if another process uses the same pack).
+//
+// Parameters:
+//     const char* pszFileName : [in] the pack file name
+//
+// Return Values (bool):
+//      true if the pack has been mapped and is compatible with
+//      this build of the engine, false otherwise
+//
+/////////////////////////////////////////////////////////
+bool CTemplatePack::Open(const char* pszFileName)
+{
+    Close();
+
+#ifdef _WIN32
+    m_hFile = ::CreateFileA(pszFileName, GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (INVALID_HANDLE_VALUE == m_hFile)
+        return false;
+
+    LARGE_INTEGER liSize;
+    if (FALSE == ::GetFileSizeEx(m_hFile, &liSize) || liSize.QuadPart < (LONGLONG)sizeof(TemplatePackHeader))
+    {
+        Close();
+        return false;
+    }
+    m_cbView = (unsigned long long)liSize.QuadPart;
+
+    m_hMapping = ::CreateFileMappingA(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (NULL == m_hMapping)
+    {
+        Close();
+        return false;
+    }
+    m_pbView = (const unsigned char*)::MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+#else
+    m_fd = open(pszFileName, O_RDONLY);
+    if (m_fd < 0)
+        return false;
+
+    struct stat st;
+    if (0 != fstat(m_fd, &st) || st.st_size < (off_t)sizeof(TemplatePackHeader))
+    {
+        Close();
+        return false;
+    }
+    m_cbView = (unsigned long long)st.st_size;
+
+    void* pv = mmap(NULL, (size_t)m_cbView, PROT_READ, MAP_SHARED, m_fd, 0);
+    m_pbView = (MAP_FAILED == pv) ? NULL : (const unsigned char*)pv;
+#endif
+
+    if (NULL == m_pbView || false == Validate())
+    {
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CTemplatePack::Close
+//
+// Unmaps the pack file.
+//
+// Parameters:
+//     none
+//
+// Return Values (void):
+//      none
+//
+/////////////////////////////////////////////////////////
+void CTemplatePack::Close()
+{
+#ifdef _WIN32
+    if (NULL != m_pbView)
+        ::UnmapViewOfFile(m_pbView);
+    if (NULL != m_hMapping)
+        ::CloseHandle(m_hMapping);
+    if (INVALID_HANDLE_VALUE != m_hFile)
+        ::CloseHandle(m_hFile);
+    m_hMapping = NULL;
+    m_hFile = INVALID_HANDLE_VALUE;
+#else
+    if (NULL != m_pbView)
+        munmap((void*)m_pbView, (size_t)m_cbView);
+    if (m_fd >= 0)
+        close(m_fd);
+    m_fd = -1;
+#endif
+    m_pbView = NULL;
+    m_cbView = 0;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CTemplatePack::Validate
+//
+// Checks that the mapped file is a pack of a known version,
+// produced for the same template layout, and that all the
+// sections are aligned and lie within the file.
+//
+/////////////////////////////////////////////////////////
+bool CTemplatePack::Validate() const
+{
+    const TemplatePackHeader* pHeader = GetHeader();
+
+    if (0 != memcmp(pHeader->szMagic, TPK_MAGIC, sizeof(pHeader->szMagic))
+        || TPK_VERSION != pHeader->uVersion
+        || TPK_BYTE_ORDER != pHeader->uByteOrder
+        || sizeof(TemplatePackHeader) != pHeader->cbHeader
+        || GE_NUM_POINTS != pHeader->cPointsPerTemplate
+        || GE_NUM_FEATURES != pHeader->cFeatures
+        || pHeader->uFormat >= GE_NUM_FORMATS
+        || (unsigned int)CGestureEngine::GetFormatTemplateSize(pHeader->uFormat) != pHeader->cbTemplate
+        || m_cbView != pHeader->cbFile)
+    {
+        return false;
+    }
+
+    // The node count can't exceed the template count
+    if (pHeader->cNodes > pHeader->cTemplates || pHeader->cTemplates > 0x7FFFFFFF)
+        return false;
+
+    unsigned long long rgullOffset[3] = {
+        pHeader->ullTemplatesOffset, pHeader->ullFeaturesOffset, pHeader->ullNodesOffset };
+    unsigned long long rgcbSection[3] = {
+        (unsigned long long)pHeader->cTemplates * pHeader->cbTemplate,
+        (unsigned long long)pHeader->cTemplates * GE_NUM_FEATURES * sizeof(float),
+        (unsigned long long)pHeader->cNodes * sizeof(VPNode) };
+    for (int i = 0; i < 3; i++)
+    {
+        if (0 != (rgullOffset[i] % TPK_ALIGNMENT)
+            || rgullOffset[i] < sizeof(TemplatePackHeader)
+            || rgullOffset[i] > m_cbView
+            || rgcbSection[i] > m_cbView - rgullOffset[i])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Section accessors ////////////////////////////////////
+
+const void* CTemplatePack::GetTemplates() const
+{
+    return m_pbView ? (m_pbView + GetHeader()->ullTemplatesOffset) : NULL;
+}
+
+int CTemplatePack::GetFormat() const
+{
+    return m_pbView ? (int)GetHeader()->uFormat : GE_FORMAT_FLOAT32;
+}
+
+const float* CTemplatePack::GetFeatures() const
+{
+    return m_pbView ? (const float*)(m_pbView + GetHeader()->ullFeaturesOffset) : NULL;
+}
+
+const VPNode* CTemplatePack::GetNodes() const
+{
+    return m_pbView ? (const VPNode*)(m_pbView + GetHeader()->ullNodesOffset) : NULL;
+}
+
+int CTemplatePack::GetTemplateCount() const
+{
+    return m_pbView ? (int)GetHeader()->cTemplates : 0;
+}
+
+int CTemplatePack::GetNodeCount() const
+{
+    return m_pbView ? (int)GetHeader()->cNodes : 0;
+}
+
+/////////////////////////////////////////////////////////
+//
+// WriteSection
+//
+// Helper for CTemplatePack::Write. Pads the file with zeros
+// up to the section offset and writes the section data.
+//
+/////////////////////////////////////////////////////////
+static bool WriteSection(FILE* pFile, unsigned long long ullOffset,
+                         const void* pvData, size_t cbData)
+{
+    static const unsigned char s_rgbZeros[TPK_ALIGNMENT] = { 0 };
+    long lPos = ftell(pFile);
+    if (lPos < 0 || (unsigned long long)lPos > ullOffset)
+        return false;
+
+    size_t cbPad = (size_t)(ullOffset - (unsigned long long)lPos);
+    if (cbPad > 0 && 1 != fwrite(s_rgbZeros, cbPad, 1, pFile))
+        return false;
+
+    return (0 == cbData) || (1 == fwrite(pvData, cbData, 1, pFile));
+}
+
+/////////////////////////////////////////////////////////
+//
+// CTemplatePack::Write
+//
+// Bakes the engine's templates, feature vectors and index
+// (if built) into a pack file. The file is written under a
+// temporary name and renamed when complete, so a process
+// never maps a half-written pack.
+//
+// Parameters:
+//     const CGestureEngine& engine : [in] the engine to save
+//     const char* pszFileName      : [in] the pack file name
+//
+// Return Values (bool):
+//      true if succeeded, false otherwise
+//
+/////////////////////////////////////////////////////////
+bool CTemplatePack::Write(const CGestureEngine& engine, const char* pszFileName)
+{
+    int cTemplates = engine.GetTemplateCount();
+    int cNodes = engine.GetIndex().GetNodeCount();
+
+    TemplatePackHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.szMagic, TPK_MAGIC, sizeof(header.szMagic));
+    header.uVersion = TPK_VERSION;
+    header.uByteOrder = TPK_BYTE_ORDER;
+    header.cbHeader = sizeof(TemplatePackHeader);
+    header.cPointsPerTemplate = GE_NUM_POINTS;
+    header.cFeatures = GE_NUM_FEATURES;
+    header.uFormat = engine.GetStorageFormat();
+    header.cbTemplate = engine.GetTemplateSize();
+    header.cTemplates = cTemplates;
+    header.cNodes = cNodes;
+
+    size_t cbTemplates = (size_t)cTemplates * engine.GetTemplateSize();
+    size_t cbFeatures = (size_t)cTemplates * GE_NUM_FEATURES * sizeof(float);
+    size_t cbNodes = (size_t)cNodes * sizeof(VPNode);
+    header.ullTemplatesOffset = AlignUp(sizeof(TemplatePackHeader));
+    header.ullFeaturesOffset = AlignUp(header.ullTemplatesOffset + cbTemplates);
+    header.ullNodesOffset = AlignUp(header.ullFeaturesOffset + cbFeatures);
+    header.cbFile = header.ullNodesOffset + cbNodes;
+
+    char szTempName[1024];
+    if (strlen(pszFileName) + 5 > sizeof(szTempName))
+        return false;
+    strcpy(szTempName, pszFileName);
+    strcat(szTempName, ".tmp");
+
+    FILE* pFile = fopen(szTempName, "wb");
+    if (NULL == pFile)
+        return false;
+
+    bool bOk = (1 == fwrite(&header, sizeof(header), 1, pFile))
+        && WriteSection(pFile, header.ullTemplatesOffset, engine.GetTemplateData(), cbTemplates)
+        && WriteSection(pFile, header.ullFeaturesOffset, engine.GetFeatures(), cbFeatures)
+        && WriteSection(pFile, header.ullNodesOffset, engine.GetIndex().GetNodes(), cbNodes);
+
+    if (0 != fclose(pFile))
+        bOk = false;
+
+    if (bOk)
+    {
+#ifdef _WIN32
+        bOk = (FALSE != ::MoveFileExA(szTempName, pszFileName, MOVEFILE_REPLACE_EXISTING));
+#else
+        bOk = (0 == rename(szTempName, pszFileName));
+#endif
+    }
+    if (false == bOk)
+    {
+        remove(szTempName);
+    }
+
+    return bOk;
+}
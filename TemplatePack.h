@@ -0,0 +1,100 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      TemplatePack.h
+//
+// Description:
+//      This file contains the layout of the template pack file and the
+//      definition of the CTemplatePack class, which maps a pack into
+//      memory read-only. A pack holds the normalized templates, their
+//      feature vectors and the template index exactly as CGestureEngine
+//      keeps them in memory, so the engine uses the mapped sections
+//      directly: no parsing, no copying, no allocation. Processes that
+//      map the same pack share its pages through the system file cache.
+//
+//      The packs are produced offline by the GesturePack tool.
+//      The methods of the class are defined in the TemplatePack.cpp file.
+//--------------------------------------------------------------------------
+
+#pragma once
+
+#include "GestureEngine.h"
+
+#define TPK_MAGIC           "GESTPACK"
+#define TPK_VERSION         2           // 2: templates in any GE_FORMAT_ format
+#define TPK_BYTE_ORDER      0x01020304  // reads differently on a foreign byte order
+#define TPK_ALIGNMENT       64          // the sections start on cache line boundaries
+
+// The file header. All the offsets are from the beginning of the file.
+struct TemplatePackHeader
+{
+    char                szMagic[8];         // TPK_MAGIC, not zero terminated
+    unsigned int        uVersion;           // TPK_VERSION
+    unsigned int        uByteOrder;         // TPK_BYTE_ORDER
+    unsigned int        cbHeader;           // sizeof(TemplatePackHeader)
+    unsigned int        cPointsPerTemplate; // GE_NUM_POINTS
+    unsigned int        cFeatures;          // GE_NUM_FEATURES
+    unsigned int        uFormat;            // GE_FORMAT_ constant
+    unsigned int        cbTemplate;         // the size of a template in that format
+    unsigned int        cTemplates;
+    unsigned int        cNodes;             // 0 if the pack has no index
+    unsigned int        uReserved;          // keeps the offsets 8-byte aligned everywhere
+    unsigned long long  ullTemplatesOffset; // cTemplates templates of cbTemplate bytes
+    unsigned long long  ullFeaturesOffset;  // float[cTemplates * cFeatures]
+    unsigned long long  ullNodesOffset;     // VPNode[cNodes]
+    unsigned long long  cbFile;             // the total size of the pack
+};
+
+/////////////////////////////////////////////////////////
+//
+// class CTemplatePack
+//
+// A read-only mapping of a template pack file. The engine
+// that's attached to a pack must be detached (or destroyed)
+// before the pack is closed.
+//
+/////////////////////////////////////////////////////////
+
+class CTemplatePack
+{
+    const unsigned char*        m_pbView;   // the mapped file
+    unsigned long long          m_cbView;
+#ifdef _WIN32
+    void*                       m_hFile;
+    void*                       m_hMapping;
+#else
+    int                         m_fd;
+#endif
+
+public:
+
+    // Constructor and destructor
+    CTemplatePack();
+    ~CTemplatePack();
+
+    bool Open(const char* pszFileName);
+    void Close();
+    bool IsOpen() const { return (NULL != m_pbView); }
+
+    // Access to the mapped sections
+    const TemplatePackHeader* GetHeader() const
+        { return (const TemplatePackHeader*)m_pbView; }
+    const void* GetTemplates() const;
+    int  GetFormat() const;
+    const float* GetFeatures() const;
+    const VPNode* GetNodes() const;
+    int  GetTemplateCount() const;
+    int  GetNodeCount() const;
+
+    // Writes the engine's templates and index to a new pack file
+    static bool Write(const CGestureEngine& engine, const char* pszFileName);
+
+private:
+
+    bool Validate() const;
+};
@@ -0,0 +1,726 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      TiledCanvas.cpp
+//
+// Description:
+//      The file contains the definitions of the methods of the class
+//      CTiledCanvas.
+//      See the file TiledCanvas.h for the definition of the class.
+//--------------------------------------------------------------------------
+
+#include <stdlib.h>
+
+#include "TiledCanvas.h"
+#include "Trace.h"
+
+#define TC_STROKES_PER_CHECK    64      // the strokes drawn between looks at the clock
+#define TC_KEY_BITS             30      // per tile coordinate in a key
+#define TC_KEY_MASK             ((1LL << TC_KEY_BITS) - 1)
+
+// A stroke: the x, y pairs of every level, one after the other, level
+// 0 first. A removed stroke has no points.
+struct CanvasStroke
+{
+    int*    piPoints;
+    int     rgiLevelStart[TC_NUM_LEVELS + 1];   // in pairs
+};
+
+// A tile of a level: the strokes that cross it, and its pixels if
+// it's cached
+struct CanvasTile
+{
+    long long       llKey;
+    int             iLevel;
+    int             xTile;
+    int             yTile;
+    int*            piStrokes;
+    int             cStrokes;
+    int             cMaxStrokes;
+    CSoftRaster*    pRaster;        // NULL if not cached
+    int             iCached;        // its index in m_ppCached, -1 if not cached
+    bool            bDirty;         // the pixels are out of date
+    int             iNextStroke;    // the strokes drawn of a tile drawn in parts
+    unsigned int    uLastUsed;      // the frame that last showed it
+};
+
+// Rounds a division down, also for the negative numbers
+static inline int FloorDiv(int a, int b)
+{
+    return (a >= 0) ? a / b : -((b - 1 - a) / b);
+}
+
+// The key of a tile in the hash table
+static inline long long GetTileKey(int iLevel, int xTile, int yTile)
+{
+    return ((long long)iLevel << (2 * TC_KEY_BITS))
+           | (((long long)xTile & TC_KEY_MASK) << TC_KEY_BITS)
+           | ((long long)yTile & TC_KEY_MASK);
+}
+
+// The tile coordinates back from a key, sign extended
+static inline int GetKeyX(long long llKey)
+{
+    int x = (int)((llKey >> TC_KEY_BITS) & TC_KEY_MASK);
+    return (x ^ (1 << (TC_KEY_BITS - 1))) - (1 << (TC_KEY_BITS - 1));
+}
+
+static inline int GetKeyY(long long llKey)
+{
+    int y = (int)(llKey & TC_KEY_MASK);
+    return (y ^ (1 << (TC_KEY_BITS - 1))) - (1 << (TC_KEY_BITS - 1));
+}
+
+static inline unsigned int HashTileKey(long long llKey, int cTableSize)
+{
+    unsigned long long ull = (unsigned long long)llKey * 0x9E3779B97F4A7C15ull;
+    return (unsigned int)(ull >> 32) & (cTableSize - 1);
+}
+
+// qsort comparer for the tile keys
+static int CompareKeys(const void* pv1, const void* pv2)
+{
+    long long ll1 = *(const long long*)pv1;
+    long long ll2 = *(const long long*)pv2;
+    return (ll1 < ll2) ? -1 : (ll1 > ll2) ? 1 : 0;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CTiledCanvas::CTiledCanvas
+//
+// Constructor.
+//
+// Parameters:
+//     int cMaxCachedTiles : [in] the tiles whose pixels are kept, at least
+//                           the tiles of a frame
+//
+/////////////////////////////////////////////////////////
+CTiledCanvas::CTiledCanvas(int cMaxCachedTiles)
+    : m_pStrokes(NULL), m_cStrokes(0), m_cMaxStrokes(0),
+      m_ppTiles(NULL), m_cTiles(0), m_cTableSize(0),
+      m_ppCached(NULL), m_cCached(0), m_cMaxCached(cMaxCachedTiles), m_uFrame(0),
+      m_decimator(0), m_pPoints(NULL), m_cMaxPoints(0), m_pllKeys(NULL), m_cMaxKeys(0),
+      m_cRasterized(0)
+{
+}
+
+/////////////////////////////////////////////////////////
+//
+// CTiledCanvas::~CTiledCanvas
+//
+// Destructor.
+//
+/////////////////////////////////////////////////////////
+CTiledCanvas::~CTiledCanvas()
+{
+    Clear();
+    free(m_pStrokes);
+    free(m_ppTiles);
+    free(m_ppCached);
+    free(m_pPoints);
+    free(m_pllKeys);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CTiledCanvas::AddStroke
+//
+// Adds a stroke: makes its simplified copy for every level,
+// each from the one before with a quarter of a pixel of its
+// level, so the copy of a level is within half a pixel of
+// the stroke, and adds it to the tiles it crosses, which
+// are drawn again when they're next shown.
+//
+// Parameters:
+//     const int* piPoints : [in] the x, y pairs of the points, in ink units
+//     int cPoints         : [in] the number of the points, 1 or more
+//
+// Return Values (int):
+//      the index of the stroke, -1 if out of memory
+//
+/////////////////////////////////////////////////////////
+int CTiledCanvas::AddStroke(
+        const int* piPoints,
+        int cPoints
+        )
+{
+    if (cPoints < 1)
+        return -1;
+
+    TRACE_SCOPE("Add canvas stroke");
+    if (m_cStrokes == m_cMaxStrokes)
+    {
+        int cMax = (0 == m_cMaxStrokes) ? 1024 : 2 * m_cMaxStrokes;
+        CanvasStroke* pStrokes = (CanvasStroke*)realloc(m_pStrokes, cMax * sizeof(CanvasStroke));
+        if (NULL == pStrokes)
+            return -1;
+        m_pStrokes = pStrokes;
+        m_cMaxStrokes = cMax;
+    }
+    if (cPoints > m_cMaxPoints)
+    {
+        GesturePoint* pPoints = (GesturePoint*)realloc(m_pPoints, cPoints * sizeof(GesturePoint));
+        if (NULL == pPoints)
+            return -1;
+        m_pPoints = pPoints;
+        m_cMaxPoints = cPoints;
+    }
+
+    // The levels can't have more points than the stroke
+    int* piAll = (int*)malloc((size_t)2 * cPoints * TC_NUM_LEVELS * sizeof(int));
+    if (NULL == piAll)
+        return -1;
+
+    for (int i = 0; i < cPoints; i++)
+    {
+        m_pPoints[i].x = (float)piPoints[2 * i];
+        m_pPoints[i].y = (float)piPoints[2 * i + 1];
+    }
+    CanvasStroke& stroke = m_pStrokes[m_cStrokes];
+    int cAll = 0;
+    int cLevel = cPoints;
+    for (int iLevel = 0; iLevel < TC_NUM_LEVELS; iLevel++)
+    {
+        m_decimator.SetTolerance(0.25f * GetUnitsPerPixel(iLevel));
+        cLevel = m_decimator.Decimate(m_pPoints, cLevel, m_pPoints);
+        stroke.rgiLevelStart[iLevel] = cAll;
+        for (int i = 0; i < cLevel; i++, cAll++)
+        {
+            // The kept points are points of the stroke, whole numbers
+            piAll[2 * cAll] = (int)m_pPoints[i].x;
+            piAll[2 * cAll + 1] = (int)m_pPoints[i].y;
+        }
+    }
+    stroke.rgiLevelStart[TC_NUM_LEVELS] = cAll;
+    int* piShrunk = (int*)realloc(piAll, 2 * cAll * sizeof(int));
+    stroke.piPoints = (NULL != piShrunk) ? piShrunk : piAll;
+
+    // Add it to the tiles it crosses
+    int iStroke = m_cStrokes++;
+    for (int iLevel = 0; iLevel < TC_NUM_LEVELS; iLevel++)
+    {
+        int cKeys = GetStrokeTiles(iStroke, iLevel);
+        if (cKeys < 0)
+        {
+            RemoveStroke(iStroke);
+            return -1;
+        }
+        for (int k = 0; k < cKeys; k++)
+        {
+            int xTile = GetKeyX(m_pllKeys[k]);
+            int yTile = GetKeyY(m_pllKeys[k]);
+            CanvasTile* pTile = FindTile(iLevel, xTile, yTile);
+            if (NULL == pTile)
+                pTile = AddTile(iLevel, xTile, yTile);
+            if (NULL != pTile && pTile->cStrokes == pTile->cMaxStrokes)
+            {
+                int cMax = (0 == pTile->cMaxStrokes) ? 16 : 2 * pTile->cMaxStrokes;
+                int* piStrokes = (int*)realloc(pTile->piStrokes, cMax * sizeof(int));
+                if (NULL != piStrokes)
+                {
+                    pTile->piStrokes = piStrokes;
+                    pTile->cMaxStrokes = cMax;
+                }
+            }
+            if (NULL == pTile || pTile->cStrokes == pTile->cMaxStrokes)
+            {
+                RemoveStroke(iStroke);
+                return -1;
+            }
+            pTile->piStrokes[pTile->cStrokes++] = iStroke;
+            DirtyTile(pTile);
+        }
+    }
+    return iStroke;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CTiledCanvas::RemoveStroke
+//
+// Removes a stroke from the tiles it crosses, which are
+// drawn again when they're next shown. The index of the
+// stroke isn't reused.
+//
+// Parameters:
+//     int iStroke : [in] the stroke
+//
+// Return Values (bool):
+//      true if the stroke has been removed, false if there's no
+//      such stroke
+//
+/////////////////////////////////////////////////////////
+bool CTiledCanvas::RemoveStroke(
+        int iStroke
+        )
+{
+    if (iStroke < 0 || iStroke >= m_cStrokes || NULL == m_pStrokes[iStroke].piPoints)
+        return false;
+
+    for (int iLevel = 0; iLevel < TC_NUM_LEVELS; iLevel++)
+    {
+        int cKeys = GetStrokeTiles(iStroke, iLevel);
+        for (int k = 0; k < cKeys; k++)
+        {
+            int xTile = GetKeyX(m_pllKeys[k]);
+            int yTile = GetKeyY(m_pllKeys[k]);
+            CanvasTile* pTile = FindTile(iLevel, xTile, yTile);
+            if (NULL == pTile)
+                continue;
+
+            // The order of the strokes of a tile doesn't matter, they're
+            // all drawn in the one color
+            for (int i = 0; i < pTile->cStrokes; i++)
+            {
+                if (pTile->piStrokes[i] == iStroke)
+                {
+                    pTile->piStrokes[i] = pTile->piStrokes[--pTile->cStrokes];
+                    DirtyTile(pTile);
+                    break;
+                }
+            }
+        }
+    }
+
+    free(m_pStrokes[iStroke].piPoints);
+    m_pStrokes[iStroke].piPoints = NULL;
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CTiledCanvas::Clear
+//
+// Removes all the strokes and the tiles.
+//
+/////////////////////////////////////////////////////////
+void CTiledCanvas::Clear()
+{
+    for (int i = 0; i < m_cStrokes; i++)
+    {
+        free(m_pStrokes[i].piPoints);
+    }
+    m_cStrokes = 0;
+
+    for (int i = 0; i < m_cTableSize; i++)
+    {
+        if (NULL != m_ppTiles[i])
+        {
+            free(m_ppTiles[i]->piStrokes);
+            delete m_ppTiles[i]->pRaster;
+            free(m_ppTiles[i]);
+            m_ppTiles[i] = NULL;
+        }
+    }
+    m_cTiles = 0;
+    m_cCached = 0;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CTiledCanvas::GetStrokePoints
+//
+// Return Values (const int*):
+//      the x, y pairs of the copy of a stroke for a level, NULL if
+//      the stroke has been removed
+//
+/////////////////////////////////////////////////////////
+const int* CTiledCanvas::GetStrokePoints(
+        int iStroke,
+        int iLevel,
+        int& cPoints
+        ) const
+{
+    const CanvasStroke& stroke = m_pStrokes[iStroke];
+    cPoints = 0;
+    if (NULL == stroke.piPoints)
+        return NULL;
+    cPoints = stroke.rgiLevelStart[iLevel + 1] - stroke.rgiLevelStart[iLevel];
+    return stroke.piPoints + 2 * stroke.rgiLevelStart[iLevel];
+}
+
+/////////////////////////////////////////////////////////
+//
+// CTiledCanvas::GetStrokeTiles
+//
+// Finds the tiles of a level that the copy of a stroke for
+// the level crosses: the tiles under the bounding box of
+// every segment, which for the short segments of ink are
+// about the tiles the segment crosses.
+//
+// Parameters:
+//     int iStroke : [in] the stroke
+//     int iLevel  : [in] the level
+//
+// Return Values (int):
+//      the number of the tiles, their keys sorted in m_pllKeys; -1 if
+//      out of memory
+//
+/////////////////////////////////////////////////////////
+int CTiledCanvas::GetStrokeTiles(
+        int iStroke,
+        int iLevel
+        )
+{
+    int cPoints;
+    const int* piPoints = GetStrokePoints(iStroke, iLevel, cPoints);
+    int cKeys = 0;
+    for (int i = 0; i < cPoints; i++)
+    {
+        // The segment to the next point, or the point of a single one
+        int j = (i + 1 < cPoints) ? i + 1 : i;
+        if (i > 0 && j == i)
+            break;
+        int x0 = FloorDiv(ToPixel(piPoints[2 * i], iLevel), TC_TILE_SIZE);
+        int y0 = FloorDiv(ToPixel(piPoints[2 * i + 1], iLevel), TC_TILE_SIZE);
+        int x1 = FloorDiv(ToPixel(piPoints[2 * j], iLevel), TC_TILE_SIZE);
+        int y1 = FloorDiv(ToPixel(piPoints[2 * j + 1], iLevel), TC_TILE_SIZE);
+        if (x0 > x1) { int t = x0; x0 = x1; x1 = t; }
+        if (y0 > y1) { int t = y0; y0 = y1; y1 = t; }
+
+        int cNeeded = cKeys + (x1 - x0 + 1) * (y1 - y0 + 1);
+        if (cNeeded > m_cMaxKeys)
+        {
+            int cMax = (cNeeded > 2 * m_cMaxKeys) ? cNeeded : 2 * m_cMaxKeys;
+            long long* pllKeys = (long long*)realloc(m_pllKeys, cMax * sizeof(long long));
+            if (NULL == pllKeys)
+                return -1;
+            m_pllKeys = pllKeys;
+            m_cMaxKeys = cMax;
+        }
+        for (int y = y0; y <= y1; y++)
+        {
+            for (int x = x0; x <= x1; x++)
+            {
+                // Most segments stay in the tile of the one before
+                long long llKey = GetTileKey(iLevel, x, y);
+                if (0 == cKeys || m_pllKeys[cKeys - 1] != llKey)
+                    m_pllKeys[cKeys++] = llKey;
+            }
+        }
+    }
+
+    qsort(m_pllKeys, cKeys, sizeof(long long), CompareKeys);
+    int cUnique = 0;
+    for (int k = 0; k < cKeys; k++)
+    {
+        if (0 == cUnique || m_pllKeys[cUnique - 1] != m_pllKeys[k])
+            m_pllKeys[cUnique++] = m_pllKeys[k];
+    }
+    return cUnique;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CTiledCanvas::FindTile
+//
+// Return Values (CanvasTile*):
+//      the tile, NULL if no stroke has ever crossed it
+//
+/////////////////////////////////////////////////////////
+CanvasTile* CTiledCanvas::FindTile(
+        int iLevel,
+        int xTile,
+        int yTile
+        ) const
+{
+    if (0 == m_cTableSize)
+        return NULL;
+
+    long long llKey = GetTileKey(iLevel, xTile, yTile);
+    for (unsigned int i = HashTileKey(llKey, m_cTableSize); ; i = (i + 1) & (m_cTableSize - 1))
+    {
+        CanvasTile* pTile = m_ppTiles[i];
+        if (NULL == pTile)
+            return NULL;
+        if (pTile->llKey == llKey)
+            return pTile;
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CTiledCanvas::AddTile
+//
+// Adds an empty tile. The table is kept at most half full.
+//
+// Return Values (CanvasTile*):
+//      the tile, NULL if out of memory
+//
+/////////////////////////////////////////////////////////
+CanvasTile* CTiledCanvas::AddTile(
+        int iLevel,
+        int xTile,
+        int yTile
+        )
+{
+    if (2 * (m_cTiles + 1) > m_cTableSize)
+    {
+        int cSize = (0 == m_cTableSize) ? 1024 : 2 * m_cTableSize;
+        CanvasTile** ppTiles = (CanvasTile**)calloc(cSize, sizeof(CanvasTile*));
+        if (NULL == ppTiles)
+            return NULL;
+        for (int i = 0; i < m_cTableSize; i++)
+        {
+            CanvasTile* pTile = m_ppTiles[i];
+            if (NULL == pTile)
+                continue;
+            unsigned int j = HashTileKey(pTile->llKey, cSize);
+            while (NULL != ppTiles[j])
+                j = (j + 1) & (cSize - 1);
+            ppTiles[j] = pTile;
+        }
+        free(m_ppTiles);
+        m_ppTiles = ppTiles;
+        m_cTableSize = cSize;
+    }
+
+    CanvasTile* pTile = (CanvasTile*)calloc(1, sizeof(CanvasTile));
+    if (NULL == pTile)
+        return NULL;
+    pTile->llKey = GetTileKey(iLevel, xTile, yTile);
+    pTile->iLevel = iLevel;
+    pTile->xTile = xTile;
+    pTile->yTile = yTile;
+    pTile->iCached = -1;
+
+    unsigned int i = HashTileKey(pTile->llKey, m_cTableSize);
+    while (NULL != m_ppTiles[i])
+        i = (i + 1) & (m_cTableSize - 1);
+    m_ppTiles[i] = pTile;
+    m_cTiles++;
+    return pTile;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CTiledCanvas::DirtyTile
+//
+// Marks the pixels of a tile out of date. A tile that was
+// being drawn in parts starts over, its strokes have changed.
+//
+/////////////////////////////////////////////////////////
+void CTiledCanvas::DirtyTile(CanvasTile* pTile)
+{
+    pTile->bDirty = true;
+    pTile->iNextStroke = 0;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CTiledCanvas::DrawTile
+//
+// Draws the strokes of a tile into its pixels, until the
+// deadline: a tile with more strokes than a frame can draw
+// is drawn in parts, over several frames, and goes on from
+// the stroke it stopped at. A tile that has no pixels takes
+// them from the least recently shown cached tile once the
+// cache is full; the tiles shown in the current frame keep
+// theirs.
+//
+// Parameters:
+//     CanvasTile* pTile   : [in] the tile
+//     PERFTIME ptDeadline : [in] the time to stop at
+//
+// Return Values (bool):
+//      true if the tile has been drawn, false if it's drawn in part or
+//      there are no pixels for it
+//
+/////////////////////////////////////////////////////////
+bool CTiledCanvas::DrawTile(
+        CanvasTile* pTile,
+        PERFTIME ptDeadline
+        )
+{
+    if (NULL == pTile->pRaster)
+    {
+        if (NULL == m_ppCached)
+        {
+            m_ppCached = (CanvasTile**)malloc(m_cMaxCached * sizeof(CanvasTile*));
+            if (NULL == m_ppCached)
+                return false;
+        }
+
+        if (m_cCached < m_cMaxCached)
+        {
+            CSoftRaster* pRaster = new CSoftRaster;
+            if (NULL == pRaster || false == pRaster->Create(TC_TILE_SIZE, TC_TILE_SIZE))
+            {
+                delete pRaster;
+                return false;
+            }
+            pTile->pRaster = pRaster;
+            pTile->iCached = m_cCached;
+            m_ppCached[m_cCached++] = pTile;
+        }
+        else
+        {
+            int iOldest = -1;
+            for (int i = 0; i < m_cCached; i++)
+            {
+                const CanvasTile* pCached = m_ppCached[i];
+                if (pCached->uLastUsed != m_uFrame
+                    && (iOldest < 0 || pCached->uLastUsed < m_ppCached[iOldest]->uLastUsed))
+                    iOldest = i;
+            }
+            if (iOldest < 0)
+                return false;
+
+            CanvasTile* pOldest = m_ppCached[iOldest];
+            pTile->pRaster = pOldest->pRaster;
+            pTile->iCached = iOldest;
+            pOldest->pRaster = NULL;
+            pOldest->iCached = -1;
+            pOldest->iNextStroke = 0;
+            m_ppCached[iOldest] = pTile;
+        }
+    }
+
+    TRACE_SCOPE("Draw canvas tile");
+    CSoftRaster& raster = *pTile->pRaster;
+    if (0 == pTile->iNextStroke)
+    {
+        RasterRect rc = { 0, 0, TC_TILE_SIZE, TC_TILE_SIZE };
+        raster.FillRect(rc, TC_BACKGROUND);
+    }
+
+    const int iLevel = pTile->iLevel;
+    const int xOrigin = pTile->xTile * TC_TILE_SIZE;
+    const int yOrigin = pTile->yTile * TC_TILE_SIZE;
+    for (int s = pTile->iNextStroke; s < pTile->cStrokes; s++)
+    {
+        // Look at the clock every few strokes; a stroke is a few lines
+        if (s > pTile->iNextStroke && 0 == (s - pTile->iNextStroke) % TC_STROKES_PER_CHECK
+            && PerfNow() >= ptDeadline)
+        {
+            pTile->iNextStroke = s;
+            return false;
+        }
+
+        int cPoints;
+        const int* piPoints = GetStrokePoints(pTile->piStrokes[s], iLevel, cPoints);
+        int x0 = ToPixel(piPoints[0], iLevel) - xOrigin;
+        int y0 = ToPixel(piPoints[1], iLevel) - yOrigin;
+        if (1 == cPoints)
+            raster.DrawLine(x0, y0, x0, y0, TC_INK);
+        for (int i = 1; i < cPoints; i++)
+        {
+            int x1 = ToPixel(piPoints[2 * i], iLevel) - xOrigin;
+            int y1 = ToPixel(piPoints[2 * i + 1], iLevel) - yOrigin;
+            raster.DrawLine(x0, y0, x1, y1, TC_INK);
+            x0 = x1;
+            y0 = y1;
+        }
+    }
+
+    pTile->bDirty = false;
+    pTile->iNextStroke = 0;
+    m_cRasterized++;
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CTiledCanvas::Render
+//
+// Draws a view of the canvas into a frame. The tiles that
+// are cached and up to date are copied; the others are
+// drawn, in the order they're met, until the budget is
+// spent. A tile left over is shown with its old pixels if
+// it has them and hasn't been started, or else with the
+// cached tile of the level above magnified, or else blank,
+// and is drawn by a later frame. The frame is complete
+// when nothing's left over.
+//
+// Parameters:
+//     const CanvasView& view : [in] the view
+//     CSoftRaster& frame     : [out] the frame, the size of the view
+//     PERFTIME ptBudget      : [in] the time to draw tiles in
+//
+// Return Values (int):
+//      the number of the tiles left over, 0 if the frame is complete
+//
+/////////////////////////////////////////////////////////
+int CTiledCanvas::Render(
+        const CanvasView& view,
+        CSoftRaster& frame,
+        PERFTIME ptBudget
+        )
+{
+    TRACE_SCOPE("Render canvas");
+    const PERFTIME ptDeadline = PerfNow() + ptBudget;
+    m_uFrame++;
+
+    const int iLevel = view.iLevel;
+    const int xFirst = FloorDiv(view.xPixel, TC_TILE_SIZE);
+    const int yFirst = FloorDiv(view.yPixel, TC_TILE_SIZE);
+    const int xLast = FloorDiv(view.xPixel + frame.GetWidth() - 1, TC_TILE_SIZE);
+    const int yLast = FloorDiv(view.yPixel + frame.GetHeight() - 1, TC_TILE_SIZE);
+
+    // The tiles of the frame keep their pixels through the frame
+    for (int yTile = yFirst; yTile <= yLast; yTile++)
+    {
+        for (int xTile = xFirst; xTile <= xLast; xTile++)
+        {
+            CanvasTile* pTile = FindTile(iLevel, xTile, yTile);
+            if (NULL != pTile)
+                pTile->uLastUsed = m_uFrame;
+        }
+    }
+
+    int cLeft = 0;
+    for (int yTile = yFirst; yTile <= yLast; yTile++)
+    {
+        for (int xTile = xFirst; xTile <= xLast; xTile++)
+        {
+            int x = xTile * TC_TILE_SIZE - view.xPixel;
+            int y = yTile * TC_TILE_SIZE - view.yPixel;
+            CanvasTile* pTile = FindTile(iLevel, xTile, yTile);
+            if (NULL == pTile || 0 == pTile->cStrokes)
+            {
+                RasterRect rc = { x, y, x + TC_TILE_SIZE, y + TC_TILE_SIZE };
+                frame.FillRect(rc, TC_BACKGROUND);
+                continue;
+            }
+
+            if ((NULL == pTile->pRaster || pTile->bDirty)
+                && (PerfNow() >= ptDeadline || false == DrawTile(pTile, ptDeadline)))
+            {
+                cLeft++;
+                if (NULL != pTile->pRaster && 0 == pTile->iNextStroke)
+                {
+                    frame.Blit(*pTile->pRaster, x, y);
+                    continue;
+                }
+
+                CanvasTile* pParent = (iLevel + 1 < TC_NUM_LEVELS)
+                                      ? FindTile(iLevel + 1, FloorDiv(xTile, 2), FloorDiv(yTile, 2))
+                                      : NULL;
+                if (NULL != pParent && NULL != pParent->pRaster && false == pParent->bDirty)
+                {
+                    const int cHalf = TC_TILE_SIZE / 2;
+                    RasterRect rcSrc;
+                    rcSrc.left = (xTile - 2 * FloorDiv(xTile, 2)) * cHalf;
+                    rcSrc.top = (yTile - 2 * FloorDiv(yTile, 2)) * cHalf;
+                    rcSrc.right = rcSrc.left + cHalf;
+                    rcSrc.bottom = rcSrc.top + cHalf;
+                    frame.BlitScaled(*pParent->pRaster, rcSrc, x, y, 2);
+                }
+                else
+                {
+                    RasterRect rc = { x, y, x + TC_TILE_SIZE, y + TC_TILE_SIZE };
+                    frame.FillRect(rc, TC_BACKGROUND);
+                }
+                continue;
+            }
+            frame.Blit(*pTile->pRaster, x, y);
+        }
+    }
+    return cLeft;
+}
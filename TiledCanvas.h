@@ -0,0 +1,134 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      TiledCanvas.h
+//
+// Description:
+//      This file contains the definition of the CTiledCanvas class, an
+//      unbounded ink surface drawn in tiles, for whiteboards with far
+//      more ink than a window shows:
+//
+//      - the surface is drawn at TC_NUM_LEVELS zoom levels, each twice
+//        as many ink units per pixel as the one before, and every level
+//        is cut into tiles of TC_TILE_SIZE pixels;
+//      - every stroke keeps a simplified copy per level, decimated (see
+//        StrokeDecimator.h) to a quarter of a pixel of that level at most,
+//        so a zoomed out view draws a few points per stroke;
+//      - every tile knows the strokes that cross it and caches its
+//        pixels; adding or removing a stroke dirties only the tiles it
+//        crosses;
+//      - a frame draws the visible tiles only, from the cache, and draws
+//        the missing ones within a time budget, a large one in parts over
+//        several frames; the others are shown from the cached tile of the
+//        level above, magnified, until a later frame draws them, so a
+//        frame costs about the same however much ink there is.
+//
+//      The methods of the class are defined in the TiledCanvas.cpp file.
+//--------------------------------------------------------------------------
+
+#pragma once
+
+#include "PerfTimer.h"
+#include "SoftRaster.h"
+#include "StrokeDecimator.h"
+
+#define TC_TILE_SIZE            256     // pixels, a power of 2
+#define TC_NUM_LEVELS           12
+#define TC_BASE_BITS            2       // log2 of the ink units per pixel at level 0
+#define TC_DEFAULT_CACHED_TILES 256     // 64 MB of pixels
+#define TC_BACKGROUND           SR_RGB(255, 255, 255)
+#define TC_INK                  SR_RGB(0, 0, 0)
+
+// A view of the canvas: the pixel of the level that's at the top left
+// corner of the frame
+struct CanvasView
+{
+    int     xPixel;
+    int     yPixel;
+    int     iLevel;     // 0..TC_NUM_LEVELS-1
+};
+
+struct CanvasStroke;
+struct CanvasTile;
+
+/////////////////////////////////////////////////////////
+//
+// class CTiledCanvas
+//
+// The strokes of the canvas and the tiles of every level.
+// A stroke is known by the index AddStroke returns. Not
+// shared between threads.
+//
+/////////////////////////////////////////////////////////
+
+class CTiledCanvas
+{
+    CanvasStroke*       m_pStrokes;
+    int                 m_cStrokes;         // including the removed ones
+    int                 m_cMaxStrokes;
+
+    // The tiles, an open addressing hash table on the level and the
+    // tile's coordinates
+    CanvasTile**        m_ppTiles;
+    int                 m_cTiles;
+    int                 m_cTableSize;       // a power of 2
+
+    // The tiles with pixels, at most m_cMaxCached; the least recently
+    // drawn one gives its pixels up to a new one
+    CanvasTile**        m_ppCached;
+    int                 m_cCached;
+    int                 m_cMaxCached;
+    unsigned int        m_uFrame;
+
+    // Scratch
+    CStrokeDecimator    m_decimator;
+    GesturePoint*       m_pPoints;
+    int                 m_cMaxPoints;
+    long long*          m_pllKeys;          // the tiles a stroke crosses
+    int                 m_cMaxKeys;
+
+    // Statistics
+    long long           m_cRasterized;      // tiles drawn since the canvas was made
+
+public:
+
+    // Constructor and destructor
+    CTiledCanvas(int cMaxCachedTiles = TC_DEFAULT_CACHED_TILES);
+    ~CTiledCanvas();
+
+    int  AddStroke(const int* piPoints, int cPoints);
+    bool RemoveStroke(int iStroke);
+    void Clear();
+
+    int  Render(const CanvasView& view, CSoftRaster& frame, PERFTIME ptBudget);
+
+    // Data members access methods
+    int  GetStrokeCount() const { return m_cStrokes; }
+    const int* GetStrokePoints(int iStroke, int iLevel, int& cPoints) const;
+    int  GetTileCount() const { return m_cTiles; }
+    int  GetCachedTileCount() const { return m_cCached; }
+    long long GetRasterizedCount() const { return m_cRasterized; }
+
+    static int GetUnitsPerPixel(int iLevel) { return 1 << (TC_BASE_BITS + iLevel); }
+
+    // The pixel of a level an ink coordinate is in; the shift is
+    // arithmetic, it rounds the negative coordinates down too
+    static int ToPixel(int x, int iLevel) { return x >> (TC_BASE_BITS + iLevel); }
+
+private:
+
+    int  GetStrokeTiles(int iStroke, int iLevel);
+    CanvasTile* FindTile(int iLevel, int xTile, int yTile) const;
+    CanvasTile* AddTile(int iLevel, int xTile, int yTile);
+    bool DrawTile(CanvasTile* pTile, PERFTIME ptDeadline);
+    void DirtyTile(CanvasTile* pTile);
+
+    // Not copyable
+    CTiledCanvas(const CTiledCanvas&);
+    CTiledCanvas& operator=(const CTiledCanvas&);
+};
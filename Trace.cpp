@@ -0,0 +1,233 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      Trace.cpp
+//
+// Description:
+//      The file contains the definitions of the methods of the class
+//      CTrace. See the file Trace.h for the definition of the class.
+//
+//      Each thread allocates its buffer on its first event and pushes it
+//      onto a global list with a compare-and-swap. The buffers live
+//      until the process ends, so the exporter can walk the list without
+//      coordinating with the threads.
+//--------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Trace.h"
+
+#ifdef _WIN32
+#define TRACE_THREAD_LOCAL  __declspec(thread)
+#else
+#define TRACE_THREAD_LOCAL  __thread
+#endif
+
+// A per-thread ring buffer
+struct TraceBuffer
+{
+    TraceBuffer*            pNext;          // the next buffer in the global list
+    long                    lThreadId;      // a small sequential id, for the export
+    volatile unsigned int   cWritten;       // the events ever written
+    TraceEvent              rgEvents[TRACE_BUFFER_EVENTS];
+};
+
+volatile bool CTrace::ms_bEnabled = false;
+
+static TraceBuffer* volatile gs_pBuffers = NULL;
+static volatile long gs_lLastThreadId = 0;
+static TRACE_THREAD_LOCAL TraceBuffer* ts_pBuffer = NULL;
+
+/////////////////////////////////////////////////////////
+//
+// GetThreadBuffer
+//
+// Returns the buffer of the calling thread, allocating it
+// on the first call.
+//
+// Return Values (TraceBuffer*):
+//      the buffer, NULL if out of memory
+//
+/////////////////////////////////////////////////////////
+static TraceBuffer* GetThreadBuffer()
+{
+    TraceBuffer* pBuffer = ts_pBuffer;
+    if (NULL != pBuffer)
+        return pBuffer;
+
+    pBuffer = (TraceBuffer*)malloc(sizeof(TraceBuffer));
+    if (NULL == pBuffer)
+        return NULL;
+    pBuffer->cWritten = 0;
+
+#ifdef _WIN32
+    pBuffer->lThreadId = ::InterlockedIncrement(&gs_lLastThreadId);
+    TraceBuffer* pHead;
+    do
+    {
+        pHead = gs_pBuffers;
+        pBuffer->pNext = pHead;
+    }
+    while (pHead != ::InterlockedCompareExchangePointer(
+                        (void* volatile*)&gs_pBuffers, pBuffer, pHead));
+#else
+    pBuffer->lThreadId = __sync_add_and_fetch(&gs_lLastThreadId, 1);
+    TraceBuffer* pHead;
+    do
+    {
+        pHead = gs_pBuffers;
+        pBuffer->pNext = pHead;
+    }
+    while (false == __sync_bool_compare_and_swap(&gs_pBuffers, pHead, pBuffer));
+#endif
+
+    ts_pBuffer = pBuffer;
+    return pBuffer;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CTrace::Record
+//
+// Records a completed scope into the calling thread's
+// buffer.
+//
+// Parameters:
+//     const char* pszName : [in] the name, a string literal
+//     PERFTIME ptBegin    : [in] PerfNow at the start
+//     PERFTIME ptEnd      : [in] PerfNow at the end
+//
+// Return Values (void):
+//      none
+//
+/////////////////////////////////////////////////////////
+void CTrace::Record(const char* pszName, PERFTIME ptBegin, PERFTIME ptEnd)
+{
+    AppendEvent(pszName, ptBegin, ptEnd - ptBegin);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CTrace::RecordInstant
+//
+// Records a point in time into the calling thread's buffer.
+//
+/////////////////////////////////////////////////////////
+void CTrace::RecordInstant(const char* pszName)
+{
+    AppendEvent(pszName, PerfNow(), TRACE_INSTANT_DURATION);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CTrace::AppendEvent
+//
+// Writes an event to the calling thread's buffer. The event
+// is written before the count is advanced, so the exporter
+// doesn't pick up a half written slot that wasn't in use.
+//
+/////////////////////////////////////////////////////////
+void CTrace::AppendEvent(const char* pszName, PERFTIME ptBegin, PERFTIME ptDuration)
+{
+    TraceBuffer* pBuffer = GetThreadBuffer();
+    if (NULL == pBuffer)
+        return;
+
+    unsigned int c = pBuffer->cWritten;
+    TraceEvent& ev = pBuffer->rgEvents[c % TRACE_BUFFER_EVENTS];
+    ev.pszName = pszName;
+    ev.ptBegin = ptBegin;
+    ev.ptDuration = ptDuration;
+    pBuffer->cWritten = c + 1;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CTrace::GetEventCount
+//
+// Returns the number of the events held by all the buffers.
+//
+/////////////////////////////////////////////////////////
+int CTrace::GetEventCount()
+{
+    int cEvents = 0;
+    for (TraceBuffer* pBuffer = gs_pBuffers; NULL != pBuffer; pBuffer = pBuffer->pNext)
+    {
+        unsigned int c = pBuffer->cWritten;
+        cEvents += (c < TRACE_BUFFER_EVENTS) ? (int)c : TRACE_BUFFER_EVENTS;
+    }
+    return cEvents;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CTrace::ExportChromeJson
+//
+// Writes the events of all the buffers to a file in the
+// Chrome trace event format: scopes as complete ("X")
+// events, instants as thread-scoped instant ("i") events.
+// The timestamps are in microseconds from the earliest
+// event in the buffers.
+//
+// Parameters:
+//     const char* pszFileName : [in] the JSON file name
+//
+// Return Values (bool):
+//      true if succeeded, false otherwise
+//
+/////////////////////////////////////////////////////////
+bool CTrace::ExportChromeJson(const char* pszFileName)
+{
+    FILE* pFile = fopen(pszFileName, "w");
+    if (NULL == pFile)
+        return false;
+
+    // Find the origin of the timestamps
+    PERFTIME ptOrigin = (PERFTIME)-1;
+    for (TraceBuffer* pBuffer = gs_pBuffers; NULL != pBuffer; pBuffer = pBuffer->pNext)
+    {
+        unsigned int c = pBuffer->cWritten;
+        unsigned int cKept = (c < TRACE_BUFFER_EVENTS) ? c : TRACE_BUFFER_EVENTS;
+        for (unsigned int i = c - cKept; i < c; i++)
+        {
+            const TraceEvent& ev = pBuffer->rgEvents[i % TRACE_BUFFER_EVENTS];
+            if (ev.ptBegin < ptOrigin)
+                ptOrigin = ev.ptBegin;
+        }
+    }
+
+    fprintf(pFile, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    bool bFirst = true;
+    for (TraceBuffer* pBuffer = gs_pBuffers; NULL != pBuffer; pBuffer = pBuffer->pNext)
+    {
+        unsigned int c = pBuffer->cWritten;
+        unsigned int cKept = (c < TRACE_BUFFER_EVENTS) ? c : TRACE_BUFFER_EVENTS;
+        for (unsigned int i = c - cKept; i < c; i++)
+        {
+            const TraceEvent& ev = pBuffer->rgEvents[i % TRACE_BUFFER_EVENTS];
+            double dTs = (ev.ptBegin - ptOrigin) / 1000.0;
+            if (TRACE_INSTANT_DURATION == ev.ptDuration)
+            {
+                fprintf(pFile, "%s{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,"
+                        "\"pid\":1,\"tid\":%ld}", bFirst ? "" : ",\n",
+                        ev.pszName, dTs, pBuffer->lThreadId);
+            }
+            else
+            {
+                fprintf(pFile, "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                        "\"pid\":1,\"tid\":%ld}", bFirst ? "" : ",\n",
+                        ev.pszName, dTs, ev.ptDuration / 1000.0, pBuffer->lThreadId);
+            }
+            bFirst = false;
+        }
+    }
+    fprintf(pFile, "\n]}\n");
+
+    return (0 == fclose(pFile));
+}
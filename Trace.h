@@ -0,0 +1,116 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      Trace.h
+//
+// Description:
+//      Lightweight scoped trace points. A TRACE_SCOPE records the name,
+//      the start time and the duration of the enclosing block into a ring
+//      buffer of the calling thread; TRACE_INSTANT records a point in time.
+//      Every thread writes only to its own buffer, so recording takes no
+//      lock. While tracing is disabled a trace point costs a test of a
+//      global flag; defining GESTURE_NO_TRACE compiles them out entirely.
+//
+//      CTrace::ExportChromeJson writes the buffers in the Chrome trace
+//      event format, which chrome://tracing and the Perfetto UI open.
+//
+//      The trace point names must be string literals (they're stored by
+//      pointer) without quotes or backslashes (they're written to JSON
+//      as is).
+//
+//      The methods of the class are defined in the Trace.cpp file.
+//--------------------------------------------------------------------------
+
+#pragma once
+
+#include "PerfTimer.h"
+
+// The number of events kept per thread; the oldest ones are overwritten
+#define TRACE_BUFFER_EVENTS     16384
+
+// The duration of the instant events
+#define TRACE_INSTANT_DURATION  ((PERFTIME)-1)
+
+// A recorded trace event
+struct TraceEvent
+{
+    const char*     pszName;
+    PERFTIME        ptBegin;
+    PERFTIME        ptDuration;     // TRACE_INSTANT_DURATION for an instant
+};
+
+/////////////////////////////////////////////////////////
+//
+// class CTrace
+//
+// The global trace switch, the recording into the per-thread
+// buffers and the export. Export while the traced threads are
+// idle or with tracing disabled; an event being written
+// during the export may come out torn.
+//
+/////////////////////////////////////////////////////////
+
+class CTrace
+{
+    static volatile bool    ms_bEnabled;
+
+public:
+
+    static void Enable(bool bEnable) { ms_bEnabled = bEnable; }
+    static bool IsEnabled() { return ms_bEnabled; }
+
+    static void Record(const char* pszName, PERFTIME ptBegin, PERFTIME ptEnd);
+    static void RecordInstant(const char* pszName);
+    static bool ExportChromeJson(const char* pszFileName);
+    static int  GetEventCount();
+
+private:
+
+    static void AppendEvent(const char* pszName, PERFTIME ptBegin, PERFTIME ptDuration);
+};
+
+/////////////////////////////////////////////////////////
+//
+// class CTraceScope
+//
+// Records the lifetime of the object as a trace event.
+// Use it through the TRACE_SCOPE macro.
+//
+/////////////////////////////////////////////////////////
+
+class CTraceScope
+{
+    const char*     m_pszName;
+    PERFTIME        m_ptBegin;      // 0 if tracing was disabled at the start
+
+public:
+
+    explicit CTraceScope(const char* pszName)
+        : m_pszName(pszName), m_ptBegin(CTrace::IsEnabled() ? PerfNow() : 0)
+    {
+    }
+
+    ~CTraceScope()
+    {
+        if (0 != m_ptBegin)
+        {
+            CTrace::Record(m_pszName, m_ptBegin, PerfNow());
+        }
+    }
+};
+
+#ifdef GESTURE_NO_TRACE
+#define TRACE_SCOPE(name)
+#define TRACE_INSTANT(name)
+#else
+#define TRACE_CONCAT2(a, b)     a##b
+#define TRACE_CONCAT(a, b)      TRACE_CONCAT2(a, b)
+#define TRACE_SCOPE(name)       CTraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_INSTANT(name) \
+    do { if (CTrace::IsEnabled()) CTrace::RecordInstant(name); } while (0)
+#endif
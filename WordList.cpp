@@ -0,0 +1,693 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      WordList.cpp
+//
+// Description:
+//      The file contains the definitions of the methods of the classes
+//      CWordList and CWordListBuilder.
+//      See the file WordList.h for the definitions of the classes.
+//--------------------------------------------------------------------------
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "WordList.h"
+
+#define WLD_NO_NODE     0xFFFFFFFFu     // an empty slot of the register
+
+// A node of the path of the last word, not registered yet. Its
+// edges but the last lead to registered nodes; the last one
+// leads to the next node of the path.
+struct WordListPathNode
+{
+    bool            bFinal;
+    int             cEdges;
+    unsigned char   rgLabels[256];
+    unsigned int    rgTargets[256];
+};
+
+// Rounds an offset up to the section alignment
+static unsigned long long AlignUp(unsigned long long ullOffset)
+{
+    return (ullOffset + WLD_ALIGNMENT - 1) & ~(unsigned long long)(WLD_ALIGNMENT - 1);
+}
+
+// The hash of a node: its finality and its edges
+static unsigned int HashNode(bool bFinal, const unsigned char* pbLabels,
+                             const unsigned int* puTargets, unsigned int cEdges)
+{
+    unsigned int uHash = bFinal ? 0x811C9DC5u : 0x050C5D1Fu;
+    for (unsigned int i = 0; i < cEdges; i++)
+    {
+        uHash = (uHash ^ pbLabels[i]) * 0x01000193u;
+        uHash = (uHash ^ puTargets[i]) * 0x01000193u;
+    }
+    return uHash ^ (uHash >> 15);
+}
+
+////////////////////////////////////////////////////////
+// CWordList methods
+////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////
+//
+// CWordList::CWordList
+//
+// Constructor.
+//
+// Parameters:
+//     none
+//
+/////////////////////////////////////////////////////////
+CWordList::CWordList() : m_pbView(NULL), m_cbView(0)
+#ifdef _WIN32
+    , m_hFile(INVALID_HANDLE_VALUE), m_hMapping(NULL)
+#else
+    , m_fd(-1)
+#endif
+    , m_puNodes(NULL), m_puTargets(NULL), m_pbLabels(NULL), m_cNodes(0), m_cEdges(0),
+      m_uRoot(RC_DEAD)
+{
+}
+
+/////////////////////////////////////////////////////////
+//
+// CWordList::~CWordList
+//
+// Destructor.
+//
+/////////////////////////////////////////////////////////
+CWordList::~CWordList()
+{
+    Close();
+}
+
+/////////////////////////////////////////////////////////
+//
+// CWordList::Open
+//
+// Maps a word list file into memory read-only and validates
+// its header. Only the header page is touched here; the
+// nodes are paged in as the recognition walks them.
+//
+// Parameters:
+//     const char* pszFileName : [in] the word list file name
+//
+// Return Values (bool):
+//      true if the word list has been mapped, false otherwise
+//
+/////////////////////////////////////////////////////////
+bool CWordList::Open(const char* pszFileName)
+{
+    Close();
+
+#ifdef _WIN32
+    m_hFile = ::CreateFileA(pszFileName, GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (INVALID_HANDLE_VALUE == m_hFile)
+        return false;
+
+    LARGE_INTEGER liSize;
+    if (FALSE == ::GetFileSizeEx(m_hFile, &liSize) || liSize.QuadPart < (LONGLONG)sizeof(WordListHeader))
+    {
+        Close();
+        return false;
+    }
+    m_cbView = (unsigned long long)liSize.QuadPart;
+
+    m_hMapping = ::CreateFileMappingA(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (NULL == m_hMapping)
+    {
+        Close();
+        return false;
+    }
+    m_pbView = (const unsigned char*)::MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+#else
+    m_fd = open(pszFileName, O_RDONLY);
+    if (m_fd < 0)
+        return false;
+
+    struct stat st;
+    if (0 != fstat(m_fd, &st) || st.st_size < (off_t)sizeof(WordListHeader))
+    {
+        Close();
+        return false;
+    }
+    m_cbView = (unsigned long long)st.st_size;
+
+    void* pv = mmap(NULL, (size_t)m_cbView, PROT_READ, MAP_SHARED, m_fd, 0);
+    m_pbView = (MAP_FAILED == pv) ? NULL : (const unsigned char*)pv;
+#endif
+
+    if (NULL == m_pbView || false == Validate())
+    {
+        Close();
+        return false;
+    }
+
+    const WordListHeader* pHeader = GetHeader();
+    m_puNodes = (const unsigned int*)(m_pbView + pHeader->ullNodesOffset);
+    m_puTargets = (const unsigned int*)(m_pbView + pHeader->ullTargetsOffset);
+    m_pbLabels = m_pbView + pHeader->ullLabelsOffset;
+    m_cNodes = pHeader->cNodes;
+    m_cEdges = pHeader->cEdges;
+    m_uRoot = pHeader->uRoot;
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CWordList::Close
+//
+// Unmaps the word list file.
+//
+// Parameters:
+//     none
+//
+// Return Values (void):
+//      none
+//
+/////////////////////////////////////////////////////////
+void CWordList::Close()
+{
+#ifdef _WIN32
+    if (NULL != m_pbView)
+        ::UnmapViewOfFile(m_pbView);
+    if (NULL != m_hMapping)
+        ::CloseHandle(m_hMapping);
+    if (INVALID_HANDLE_VALUE != m_hFile)
+        ::CloseHandle(m_hFile);
+    m_hMapping = NULL;
+    m_hFile = INVALID_HANDLE_VALUE;
+#else
+    if (NULL != m_pbView)
+        munmap((void*)m_pbView, (size_t)m_cbView);
+    if (m_fd >= 0)
+        close(m_fd);
+    m_fd = -1;
+#endif
+    m_pbView = NULL;
+    m_cbView = 0;
+    m_puNodes = m_puTargets = NULL;
+    m_pbLabels = NULL;
+    m_cNodes = m_cEdges = 0;
+    m_uRoot = RC_DEAD;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CWordList::Validate
+//
+// Checks that the mapped file is a word list of a known
+// version and that all the sections are aligned and lie
+// within the file. The nodes and edges themselves aren't
+// read here, which would page in the whole file: Step checks
+// every index it follows instead.
+//
+/////////////////////////////////////////////////////////
+bool CWordList::Validate() const
+{
+    const WordListHeader* pHeader = GetHeader();
+
+    if (0 != memcmp(pHeader->szMagic, WLD_MAGIC, sizeof(pHeader->szMagic))
+        || WLD_VERSION != pHeader->uVersion
+        || WLD_BYTE_ORDER != pHeader->uByteOrder
+        || sizeof(WordListHeader) != pHeader->cbHeader
+        || m_cbView != pHeader->cbFile
+        || pHeader->uRoot >= pHeader->cNodes
+        || pHeader->cNodes >= RC_DEAD
+        || pHeader->cEdges >= WLD_FINAL)
+    {
+        return false;
+    }
+
+    unsigned long long rgullOffset[3] = {
+        pHeader->ullNodesOffset, pHeader->ullTargetsOffset, pHeader->ullLabelsOffset };
+    unsigned long long rgcbSection[3] = {
+        ((unsigned long long)pHeader->cNodes + 1) * sizeof(unsigned int),
+        (unsigned long long)pHeader->cEdges * sizeof(unsigned int),
+        (unsigned long long)pHeader->cEdges };
+    for (int i = 0; i < 3; i++)
+    {
+        if (0 != (rgullOffset[i] % WLD_ALIGNMENT)
+            || rgullOffset[i] < sizeof(WordListHeader)
+            || rgullOffset[i] > m_cbView
+            || rgcbSection[i] > m_cbView - rgullOffset[i])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CWordList::Step
+//
+// Follows the edge of a byte out of a node, with a binary
+// search of the node's labels. A space ends the word of the
+// node, if it's a word, and starts the next one.
+//
+// Parameters:
+//     unsigned int uState : [in] a node
+//     unsigned char ch    : [in] the next byte of the text
+//
+// Return Values (unsigned int):
+//      the next node, RC_DEAD if no word goes on with the byte
+//
+/////////////////////////////////////////////////////////
+unsigned int CWordList::Step(unsigned int uState, unsigned char ch) const
+{
+    if (uState >= m_cNodes)
+        return RC_DEAD;
+
+    if (' ' == ch)
+        return (0 != (m_puNodes[uState] & WLD_FINAL)) ? m_uRoot : RC_DEAD;
+
+    unsigned int iLow = m_puNodes[uState] & ~WLD_FINAL;
+    unsigned int iHigh = m_puNodes[uState + 1] & ~WLD_FINAL;
+    if (iHigh > m_cEdges || iLow > iHigh)
+        return RC_DEAD;
+
+    while (iLow < iHigh)
+    {
+        unsigned int iMid = iLow + (iHigh - iLow) / 2;
+        if (m_pbLabels[iMid] < ch)
+            iLow = iMid + 1;
+        else
+            iHigh = iMid;
+    }
+    if (iLow < (m_puNodes[uState + 1] & ~WLD_FINAL) && ch == m_pbLabels[iLow])
+        return (m_puTargets[iLow] < m_cNodes) ? m_puTargets[iLow] : RC_DEAD;
+    return RC_DEAD;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CWordList::IsFinal
+//
+// Return Values (bool):
+//      true if the text of the node ends with a word
+//
+/////////////////////////////////////////////////////////
+bool CWordList::IsFinal(unsigned int uState) const
+{
+    return (uState < m_cNodes && 0 != (m_puNodes[uState] & WLD_FINAL));
+}
+
+////////////////////////////////////////////////////////
+// CWordListBuilder methods
+////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////
+//
+// CWordListBuilder::CWordListBuilder
+//
+// Constructor.
+//
+// Parameters:
+//     none
+//
+/////////////////////////////////////////////////////////
+CWordListBuilder::CWordListBuilder()
+    : m_pPath(NULL), m_cPath(0), m_puNodes(NULL), m_cNodes(0), m_cMaxNodes(0),
+      m_puTargets(NULL), m_pbLabels(NULL), m_cEdges(0), m_cMaxEdges(0),
+      m_puRegister(NULL), m_cRegisterSlots(0), m_cWords(0), m_uRoot(0),
+      m_bFinished(false), m_bFailed(false)
+{
+    m_szLast[0] = '\0';
+    m_pPath = (WordListPathNode*)malloc((WLD_MAX_WORD + 1) * sizeof(WordListPathNode));
+    if (NULL == m_pPath)
+    {
+        m_bFailed = true;
+        return;
+    }
+    m_pPath[0].bFinal = false;
+    m_pPath[0].cEdges = 0;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CWordListBuilder::~CWordListBuilder
+//
+// Destructor.
+//
+/////////////////////////////////////////////////////////
+CWordListBuilder::~CWordListBuilder()
+{
+    free(m_pPath);
+    free(m_puNodes);
+    free(m_puTargets);
+    free(m_pbLabels);
+    free(m_puRegister);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CWordListBuilder::AddWord
+//
+// Adds the next word. The nodes of the last word past the
+// prefix it shares with this one can't change any more, so
+// they're registered, and the rest of this word becomes the
+// new path. A word equal to the last one is skipped.
+//
+// Parameters:
+//     const char* pszWord : [in] the word, UTF-8, without spaces
+//
+// Return Values (bool):
+//      true if succeeded; false if the word comes before the last one
+//      in byte order, is longer than WLD_MAX_WORD bytes, has a space, or
+//      out of memory
+//
+/////////////////////////////////////////////////////////
+bool CWordListBuilder::AddWord(const char* pszWord)
+{
+    if (m_bFailed || m_bFinished)
+        return false;
+
+    size_t cch = strlen(pszWord);
+    if (0 == cch)
+        return true;
+    if (cch > WLD_MAX_WORD || NULL != strchr(pszWord, ' '))
+        return false;
+
+    // strcmp compares the bytes as unsigned char
+    int iOrder = strcmp(pszWord, m_szLast);
+    if (0 == iOrder)
+        return true;
+    if (iOrder < 0)
+        return false;
+
+    int cPrefix = 0;
+    while (cPrefix < m_cPath && m_szLast[cPrefix] == pszWord[cPrefix])
+    {
+        cPrefix++;
+    }
+
+    Minimize(cPrefix);
+    if (m_bFailed)
+        return false;
+
+    for (int i = cPrefix; i < (int)cch; i++)
+    {
+        WordListPathNode& node = m_pPath[i];
+        node.rgLabels[node.cEdges] = (unsigned char)pszWord[i];
+        node.rgTargets[node.cEdges] = WLD_NO_NODE;
+        node.cEdges++;
+        m_pPath[i + 1].bFinal = false;
+        m_pPath[i + 1].cEdges = 0;
+    }
+    m_pPath[cch].bFinal = true;
+    m_cPath = (int)cch;
+    memcpy(m_szLast, pszWord, cch + 1);
+    m_cWords++;
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CWordListBuilder::Minimize
+//
+// Registers the nodes of the path deeper than a depth, the
+// deepest first, and points their parents' last edges at
+// the registered nodes.
+//
+/////////////////////////////////////////////////////////
+void CWordListBuilder::Minimize(int cDepth)
+{
+    for (int i = m_cPath; i > cDepth && false == m_bFailed; i--)
+    {
+        unsigned int uNode = Register(m_pPath[i]);
+        WordListPathNode& parent = m_pPath[i - 1];
+        parent.rgTargets[parent.cEdges - 1] = uNode;
+    }
+    m_cPath = cDepth;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CWordListBuilder::Register
+//
+// Finds a registered node equal to a node of the path: as
+// final or not, with the same labels leading to the same
+// nodes. Registers it if there's none.
+//
+// Return Values (unsigned int):
+//      the registered node; sets m_bFailed if out of memory
+//
+/////////////////////////////////////////////////////////
+unsigned int CWordListBuilder::Register(const WordListPathNode& node)
+{
+    if (2 * (m_cNodes + 1) > m_cRegisterSlots && false == GrowRegister())
+    {
+        m_bFailed = true;
+        return 0;
+    }
+
+    const unsigned int cEdges = (unsigned int)node.cEdges;
+    const unsigned int uMask = m_cRegisterSlots - 1;
+    unsigned int iSlot = HashNode(node.bFinal, node.rgLabels, node.rgTargets, cEdges) & uMask;
+    for (; WLD_NO_NODE != m_puRegister[iSlot]; iSlot = (iSlot + 1) & uMask)
+    {
+        unsigned int uNode = m_puRegister[iSlot];
+        unsigned int iFirst = m_puNodes[uNode] & ~WLD_FINAL;
+        if (node.bFinal == (0 != (m_puNodes[uNode] & WLD_FINAL))
+            && cEdges == GetEdgeEnd(uNode) - iFirst
+            && 0 == memcmp(node.rgLabels, m_pbLabels + iFirst, cEdges)
+            && 0 == memcmp(node.rgTargets, m_puTargets + iFirst, cEdges * sizeof(unsigned int)))
+        {
+            return uNode;
+        }
+    }
+
+    // A new node, the file format keeps room for the sentinel
+    if (m_cNodes + 2 > m_cMaxNodes)
+    {
+        unsigned int cMaxNodes = m_cMaxNodes ? 2 * m_cMaxNodes : 4096;
+        unsigned int* puNodes = (unsigned int*)realloc(m_puNodes, cMaxNodes * sizeof(unsigned int));
+        if (NULL == puNodes)
+        {
+            m_bFailed = true;
+            return 0;
+        }
+        m_puNodes = puNodes;
+        m_cMaxNodes = cMaxNodes;
+    }
+    if (m_cEdges + cEdges > m_cMaxEdges)
+    {
+        unsigned int cMaxEdges = m_cMaxEdges ? 2 * m_cMaxEdges : 4096;
+        while (cMaxEdges < m_cEdges + cEdges)
+            cMaxEdges *= 2;
+        unsigned int* puTargets = (unsigned int*)realloc(m_puTargets, cMaxEdges * sizeof(unsigned int));
+        if (NULL != puTargets)
+            m_puTargets = puTargets;
+        unsigned char* pbLabels = (unsigned char*)realloc(m_pbLabels, cMaxEdges);
+        if (NULL != pbLabels)
+            m_pbLabels = pbLabels;
+        if (NULL == puTargets || NULL == pbLabels || cMaxEdges >= WLD_FINAL)
+        {
+            m_bFailed = true;
+            return 0;
+        }
+        m_cMaxEdges = cMaxEdges;
+    }
+
+    unsigned int uNode = m_cNodes++;
+    m_puNodes[uNode] = m_cEdges | (node.bFinal ? WLD_FINAL : 0);
+    if (cEdges > 0)
+    {
+        // The edge arrays are still NULL until a node has edges
+        memcpy(m_pbLabels + m_cEdges, node.rgLabels, cEdges);
+        memcpy(m_puTargets + m_cEdges, node.rgTargets, cEdges * sizeof(unsigned int));
+        m_cEdges += cEdges;
+    }
+    m_puRegister[iSlot] = uNode;
+    return uNode;
+}
+
+// The end of the edges of a registered node
+unsigned int CWordListBuilder::GetEdgeEnd(unsigned int uNode) const
+{
+    return (uNode + 1 < m_cNodes) ? (m_puNodes[uNode + 1] & ~WLD_FINAL) : m_cEdges;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CWordListBuilder::GrowRegister
+//
+// Doubles the hash table of the registered nodes and puts
+// them back in.
+//
+// Return Values (bool):
+//      true if succeeded, false if out of memory
+//
+/////////////////////////////////////////////////////////
+bool CWordListBuilder::GrowRegister()
+{
+    unsigned int cSlots = m_cRegisterSlots ? 2 * m_cRegisterSlots : 8192;
+    unsigned int* puRegister = (unsigned int*)malloc(cSlots * sizeof(unsigned int));
+    if (NULL == puRegister)
+        return false;
+    memset(puRegister, 0xFF, cSlots * sizeof(unsigned int));
+
+    const unsigned int uMask = cSlots - 1;
+    for (unsigned int uNode = 0; uNode < m_cNodes; uNode++)
+    {
+        unsigned int iFirst = m_puNodes[uNode] & ~WLD_FINAL;
+        unsigned int iSlot = HashNode(0 != (m_puNodes[uNode] & WLD_FINAL), m_pbLabels + iFirst,
+                                      m_puTargets + iFirst, GetEdgeEnd(uNode) - iFirst) & uMask;
+        while (WLD_NO_NODE != puRegister[iSlot])
+            iSlot = (iSlot + 1) & uMask;
+        puRegister[iSlot] = uNode;
+    }
+
+    free(m_puRegister);
+    m_puRegister = puRegister;
+    m_cRegisterSlots = cSlots;
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CWordListBuilder::Finish
+//
+// Registers the rest of the path and the root. No word can
+// be added afterwards.
+//
+// Return Values (bool):
+//      true if succeeded, false if out of memory
+//
+/////////////////////////////////////////////////////////
+bool CWordListBuilder::Finish()
+{
+    if (m_bFinished || m_bFailed)
+        return (false == m_bFailed);
+
+    Minimize(0);
+    if (false == m_bFailed)
+        m_uRoot = Register(m_pPath[0]);
+    if (m_bFailed)
+        return false;
+
+    // The sentinel: the end of the edges of the last node
+    m_puNodes[m_cNodes] = m_cEdges;
+    m_bFinished = true;
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// WriteSection
+//
+// Helper for CWordListBuilder::Write. Pads the file with
+// zeros up to the section offset and writes the section
+// data.
+//
+/////////////////////////////////////////////////////////
+static bool WriteSection(FILE* pFile, unsigned long long ullOffset,
+                         const void* pvData, size_t cbData)
+{
+    static const unsigned char s_rgbZeros[WLD_ALIGNMENT] = { 0 };
+    long lPos = ftell(pFile);
+    if (lPos < 0 || (unsigned long long)lPos > ullOffset)
+        return false;
+
+    size_t cbPad = (size_t)(ullOffset - (unsigned long long)lPos);
+    if (cbPad > 0 && 1 != fwrite(s_rgbZeros, cbPad, 1, pFile))
+        return false;
+
+    return (0 == cbData) || (1 == fwrite(pvData, cbData, 1, pFile));
+}
+
+/////////////////////////////////////////////////////////
+//
+// CWordListBuilder::Write
+//
+// Finishes the automaton and writes the word list file.
+// The file is written under a temporary name and renamed
+// when complete, so a process never maps a half-written
+// word list.
+//
+// Parameters:
+//     const char* pszFileName : [in] the word list file name
+//
+// Return Values (bool):
+//      true if succeeded, false otherwise
+//
+/////////////////////////////////////////////////////////
+bool CWordListBuilder::Write(const char* pszFileName)
+{
+    if (false == Finish())
+        return false;
+
+    WordListHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.szMagic, WLD_MAGIC, sizeof(header.szMagic));
+    header.uVersion = WLD_VERSION;
+    header.uByteOrder = WLD_BYTE_ORDER;
+    header.cbHeader = sizeof(WordListHeader);
+    header.cNodes = m_cNodes;
+    header.cEdges = m_cEdges;
+    header.cWords = m_cWords;
+    header.uRoot = m_uRoot;
+
+    size_t cbNodes = ((size_t)m_cNodes + 1) * sizeof(unsigned int);
+    size_t cbTargets = (size_t)m_cEdges * sizeof(unsigned int);
+    header.ullNodesOffset = AlignUp(sizeof(WordListHeader));
+    header.ullTargetsOffset = AlignUp(header.ullNodesOffset + cbNodes);
+    header.ullLabelsOffset = AlignUp(header.ullTargetsOffset + cbTargets);
+    header.cbFile = header.ullLabelsOffset + m_cEdges;
+
+    char szTempName[1024];
+    if (strlen(pszFileName) + 5 > sizeof(szTempName))
+        return false;
+    strcpy(szTempName, pszFileName);
+    strcat(szTempName, ".tmp");
+
+    FILE* pFile = fopen(szTempName, "wb");
+    if (NULL == pFile)
+        return false;
+
+    bool bOk = (1 == fwrite(&header, sizeof(header), 1, pFile))
+        && WriteSection(pFile, header.ullNodesOffset, m_puNodes, cbNodes)
+        && WriteSection(pFile, header.ullTargetsOffset, m_puTargets, cbTargets)
+        && WriteSection(pFile, header.ullLabelsOffset, m_pbLabels, m_cEdges);
+
+    if (0 != fclose(pFile))
+        bOk = false;
+
+    if (bOk)
+    {
+#ifdef _WIN32
+        bOk = (FALSE != ::MoveFileExA(szTempName, pszFileName, MOVEFILE_REPLACE_EXISTING));
+#else
+        bOk = (0 == rename(szTempName, pszFileName));
+#endif
+    }
+    if (false == bOk)
+    {
+        remove(szTempName);
+    }
+
+    return bOk;
+}
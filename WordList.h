@@ -0,0 +1,180 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      WordList.h
+//
+// Description:
+//      This file contains the layout of the word list file and the
+//      definitions of the CWordList and CWordListBuilder classes. A word
+//      list is a minimal acyclic automaton (a DAWG) of the words: the
+//      words that share a prefix share its path, and the words that share
+//      a suffix share its nodes, so a list of millions of words takes a
+//      few bytes per word. CWordList maps the file read-only and walks
+//      the automaton in place: no parsing, no copying, no allocation, and
+//      only the pages the recognition touches are ever read.
+//
+//      The lists are compiled offline by the WordPack tool.
+//      The methods of the classes are defined in the WordList.cpp file.
+//--------------------------------------------------------------------------
+
+#pragma once
+
+#include "RecoConstraint.h"
+
+#define WLD_MAGIC           "WORDDAWG"
+#define WLD_VERSION         1
+#define WLD_BYTE_ORDER      0x01020304  // reads differently on a foreign byte order
+#define WLD_ALIGNMENT       64          // the sections start on cache line boundaries
+#define WLD_FINAL           0x80000000u // a node that ends a word
+#define WLD_MAX_WORD        255         // the longest word, in bytes
+
+// The file header. All the offsets are from the beginning of the file.
+//
+// A node is the index of its first edge, with WLD_FINAL if it ends a
+// word; its edges run up to the first edge of the next node, and they're
+// sorted by label. The node array has one more entry, the number of the
+// edges. An edge is a label, the next byte of the words, and a target
+// node, in two arrays.
+struct WordListHeader
+{
+    char                szMagic[8];         // WLD_MAGIC, not zero terminated
+    unsigned int        uVersion;           // WLD_VERSION
+    unsigned int        uByteOrder;         // WLD_BYTE_ORDER
+    unsigned int        cbHeader;           // sizeof(WordListHeader)
+    unsigned int        cNodes;
+    unsigned int        cEdges;
+    unsigned int        cWords;
+    unsigned int        uRoot;              // the node of the empty prefix
+    unsigned int        uReserved;          // keeps the offsets 8-byte aligned everywhere
+    unsigned long long  ullNodesOffset;     // unsigned int[cNodes + 1]
+    unsigned long long  ullTargetsOffset;   // unsigned int[cEdges]
+    unsigned long long  ullLabelsOffset;    // unsigned char[cEdges]
+    unsigned long long  cbFile;             // the total size of the file
+};
+
+/////////////////////////////////////////////////////////
+//
+// class CWordList
+//
+// A read-only mapping of a word list file, and the word
+// list constraint: a state is a node of the automaton. A
+// space after a word starts the next word, so a text of
+// several words is accepted if every word is in the list.
+//
+/////////////////////////////////////////////////////////
+
+class CWordList : public IRecoConstraint
+{
+    const unsigned char*        m_pbView;   // the mapped file
+    unsigned long long          m_cbView;
+#ifdef _WIN32
+    void*                       m_hFile;
+    void*                       m_hMapping;
+#else
+    int                         m_fd;
+#endif
+
+    // The mapped sections
+    const unsigned int*         m_puNodes;
+    const unsigned int*         m_puTargets;
+    const unsigned char*        m_pbLabels;
+    unsigned int                m_cNodes;
+    unsigned int                m_cEdges;
+    unsigned int                m_uRoot;
+
+public:
+
+    // Constructor and destructor
+    CWordList();
+    ~CWordList();
+
+    bool Open(const char* pszFileName);
+    void Close();
+    bool IsOpen() const { return (NULL != m_pbView); }
+
+    const WordListHeader* GetHeader() const
+        { return (const WordListHeader*)m_pbView; }
+    int GetWordCount() const
+        { return m_pbView ? (int)GetHeader()->cWords : 0; }
+
+    // IRecoConstraint
+    virtual unsigned int GetStartState() const { return m_uRoot; }
+    virtual unsigned int Step(unsigned int uState, unsigned char ch) const;
+    virtual bool IsFinal(unsigned int uState) const;
+
+private:
+
+    bool Validate() const;
+
+    // Not copyable
+    CWordList(const CWordList&);
+    CWordList& operator=(const CWordList&);
+};
+
+/////////////////////////////////////////////////////////
+//
+// class CWordListBuilder
+//
+// Builds the minimal automaton of the words as they're
+// added, in one pass, without ever holding the trie: the
+// words come in byte order, and the nodes past the prefix a
+// word shares with the one before are final, so they're
+// merged with an equal node or registered as new right away.
+//
+/////////////////////////////////////////////////////////
+
+class CWordListBuilder
+{
+    struct WordListPathNode*    m_pPath;        // the nodes of the last word
+    int                         m_cPath;        // the length of the last word
+    char                        m_szLast[WLD_MAX_WORD + 1];
+
+    // The registered nodes, as in the file
+    unsigned int*               m_puNodes;
+    unsigned int                m_cNodes;
+    unsigned int                m_cMaxNodes;
+    unsigned int*               m_puTargets;
+    unsigned char*              m_pbLabels;
+    unsigned int                m_cEdges;
+    unsigned int                m_cMaxEdges;
+
+    // The hash table of the registered nodes
+    unsigned int*               m_puRegister;
+    unsigned int                m_cRegisterSlots;   // a power of 2
+
+    unsigned int                m_cWords;
+    unsigned int                m_uRoot;
+    bool                        m_bFinished;
+    bool                        m_bFailed;          // out of memory
+
+public:
+
+    // Constructor and destructor
+    CWordListBuilder();
+    ~CWordListBuilder();
+
+    bool AddWord(const char* pszWord);
+    bool Finish();
+    bool Write(const char* pszFileName);
+
+    // Data members access methods
+    unsigned int GetWordCount() const { return m_cWords; }
+    unsigned int GetNodeCount() const { return m_cNodes; }
+    unsigned int GetEdgeCount() const { return m_cEdges; }
+
+private:
+
+    void Minimize(int cDepth);
+    unsigned int Register(const WordListPathNode& node);
+    unsigned int GetEdgeEnd(unsigned int uNode) const;
+    bool GrowRegister();
+
+    // Not copyable
+    CWordListBuilder(const CWordListBuilder&);
+    CWordListBuilder& operator=(const CWordListBuilder&);
+};
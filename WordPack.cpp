@@ -0,0 +1,190 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Module:
+//      WordPack.cpp
+//
+// Description:
+//      The offline tool that compiles a word list into a word list file
+//      (see WordList.h). The recognizer maps the file at startup instead
+//      of reading and indexing the words on each launch.
+//
+//      Usage:
+//          WordPack words.txt output.wld
+//          WordPack -i input.wld [word ...]
+//
+//          words.txt is UTF-8 text, the words separated by white space,
+//          in any order; the duplicates are dropped
+//          -i  prints the header of an existing word list, checks that it
+//              can be mapped and looks up the words
+//
+//--------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "PerfTimer.h"
+#include "WordList.h"
+
+static int CompareWords(const void* pv1, const void* pv2)
+{
+    return strcmp(*(const char* const*)pv1, *(const char* const*)pv2);
+}
+
+/////////////////////////////////////////////////////////
+//
+// ReadWords
+//
+// Reads a text file and splits it into words, in place.
+//
+// Parameters:
+//     const char* pszFileName : [in] the file name
+//     char** ppText           : [out] the text, to be freed
+//     char*** pppszWords      : [out] the words in the text, to be freed
+//
+// Return Values (int):
+//      the number of the words, -1 if the file can't be read
+//
+/////////////////////////////////////////////////////////
+static int ReadWords(const char* pszFileName, char** ppText, char*** pppszWords)
+{
+    FILE* pFile = fopen(pszFileName, "rb");
+    if (NULL == pFile)
+        return -1;
+
+    char* pText = NULL;
+    size_t cbText = 0;
+    size_t cbMax = 0;
+    for (;;)
+    {
+        if (cbText + 65536 + 1 > cbMax)
+        {
+            cbMax = cbMax ? 2 * cbMax : 1 << 20;
+            char* p = (char*)realloc(pText, cbMax);
+            if (NULL == p)
+            {
+                free(pText);
+                fclose(pFile);
+                return -1;
+            }
+            pText = p;
+        }
+        size_t cbRead = fread(pText + cbText, 1, 65536, pFile);
+        cbText += cbRead;
+        if (cbRead < 65536)
+            break;
+    }
+    fclose(pFile);
+    pText[cbText] = '\0';
+
+    int cWords = 0;
+    int cMaxWords = 0;
+    char** ppszWords = NULL;
+    for (char* psz = strtok(pText, " \t\r\n"); NULL != psz; psz = strtok(NULL, " \t\r\n"))
+    {
+        if (cWords == cMaxWords)
+        {
+            cMaxWords = cMaxWords ? 2 * cMaxWords : 65536;
+            char** pp = (char**)realloc(ppszWords, cMaxWords * sizeof(char*));
+            if (NULL == pp)
+            {
+                free(ppszWords);
+                free(pText);
+                return -1;
+            }
+            ppszWords = pp;
+        }
+        ppszWords[cWords++] = psz;
+    }
+
+    *ppText = pText;
+    *pppszWords = ppszWords;
+    return cWords;
+}
+
+/////////////////////////////////////////////////////////
+//
+// PrintWordListInfo
+//
+// Maps an existing word list, prints its header and looks
+// up the words.
+//
+/////////////////////////////////////////////////////////
+static int PrintWordListInfo(const char* pszFileName, char** ppszWords, int cWords)
+{
+    CWordList wordList;
+    PERFTIME ptStart = PerfNow();
+    if (false == wordList.Open(pszFileName))
+    {
+        fprintf(stderr, "%s: not a valid word list\n", pszFileName);
+        return 1;
+    }
+    PERFTIME ptOpen = PerfNow() - ptStart;
+
+    const WordListHeader* pHeader = wordList.GetHeader();
+    printf("%s: version %u, %u words, %u nodes, %u edges, %llu bytes (%.2f bytes per word)\n",
+           pszFileName, pHeader->uVersion, pHeader->cWords, pHeader->cNodes, pHeader->cEdges,
+           pHeader->cbFile, pHeader->cWords ? (double)pHeader->cbFile / pHeader->cWords : 0.0);
+    printf("  mapped in %.1f us\n", ptOpen / 1000.0);
+
+    for (int i = 0; i < cWords; i++)
+    {
+        printf("  %s: %s\n", ppszWords[i], wordList.Accepts(ppszWords[i]) ? "yes" : "no");
+    }
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc >= 3 && 0 == strcmp(argv[1], "-i"))
+        return PrintWordListInfo(argv[2], argv + 3, argc - 3);
+
+    if (3 != argc || '-' == argv[1][0])
+    {
+        printf("usage: WordPack words.txt output.wld\n"
+               "       WordPack -i input.wld [word ...]\n");
+        return 1;
+    }
+
+    char* pText;
+    char** ppszWords;
+    PERFTIME ptStart = PerfNow();
+    int cWords = ReadWords(argv[1], &pText, &ppszWords);
+    if (cWords < 0)
+    {
+        fprintf(stderr, "%s: can't read the file\n", argv[1]);
+        return 1;
+    }
+
+    // The builder takes the words in byte order
+    qsort(ppszWords, cWords, sizeof(char*), CompareWords);
+
+    CWordListBuilder builder;
+    int cSkipped = 0;
+    for (int i = 0; i < cWords; i++)
+    {
+        if (false == builder.AddWord(ppszWords[i]))
+        {
+            fprintf(stderr, "%s: word too long, skipped\n", ppszWords[i]);
+            cSkipped++;
+        }
+    }
+    bool bOk = builder.Write(argv[2]);
+    PERFTIME ptBuild = PerfNow() - ptStart;
+    free(ppszWords);
+    free(pText);
+
+    if (false == bOk)
+    {
+        fprintf(stderr, "%s: failed to write the word list\n", argv[2]);
+        return 1;
+    }
+    printf("%d words read, %d skipped, built in %.1f ms\n", cWords, cSkipped, ptBuild / 1e6);
+
+    return PrintWordListInfo(argv[2], NULL, 0);
+}
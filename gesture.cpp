@@ -22,6 +22,21 @@
 //
 //      This application is discussed in the Getting Started guide.
 //
+//      Started with "-record <file>" on the command line, the application
+//      records its input (pen packets, stroke boundaries, gestures,
+//      commands and gesture status changes) to the file; the GestureReplay
+//      tool replays such a log without a pen.
+//
+//      Undo and Redo in the Ink menu (Ctrl+Z and Ctrl+Y) step through the
+//      history of the ink, so a clear, including the one that follows a
+//      gesture, can be taken back.
+//
+//      A gesture clears the ink by default; started with "-bindings <file>"
+//      the application reads the command of each gesture from the file
+//      (see GestureCommands.h for the format). The commands run after the
+//      gesture event returns, and the ones that a later one makes useless,
+//      like a clear after a clear, are merged.
+//
 //      (NOTE: For code simplicity, returned HRESULT is not checked
 //             on failure in the places where failures are not critical
 //             for the application or very unexpected)
@@ -45,6 +60,7 @@
 // Windows header files
 #include <windows.h>
 #include <commctrl.h>       // need it to call CreateStatusWindow
+#include <wchar.h>          // wcsncmp and wcstod, for the command line
 
 // The following definitions may be not found in the old headers installed with VC6,
 // so they're copied from the newer headers found in the Microsoft Platform SDK
@@ -82,8 +98,20 @@ CComModule _Module;
 
 // The application header files
 #include "resource.h"       // main symbols, including command ID's
+#include "Trace.h"          // defines the TRACE_SCOPE trace points
+#include "Metrics.h"        // defines CMetrics
+#include "BackgroundReco.h" // defines CBackgroundRecognizer
+#include "InkTextRecognizer.h" // defines CInkTextRecognizer
+#include "GuidedReco.h"     // defines CGuidedRecognizer and CRecoGuide
+#include "WordList.h"       // defines CWordList, and CFactoid in RecoConstraint.h
 #include "EventSinks.h"     // defines the IInkEventsImpl and IInkRecognitionEventsImpl
 #include "ChildWnds.h"      // definitions of the CInkInputWnd and CRecoOutputWnd
+#include "InputLog.h"       // defines CInputRecorder
+#include "StrokeDecimator.h" // defines CStrokeDecimator
+#include "PacketInput.h"    // defines CPacketInput
+#include "StrokePredictor.h" // defines CStrokePredictor
+#include "InkHistory.h"     // defines CInkHistory
+#include "GestureCommands.h" // defines CGestureBindings and CCommandQueue
 #include "gesture.h"        // contains the definition of CAddRecoApp
 
 // The set of the single stroke gestures known to this application
@@ -101,12 +129,57 @@ const InkApplicationGesture gc_igtSingleStrokeGestures[] = {
 // The static members of the event sink templates are initialized here
 // (defined in EventSinks.h)
 
-const _ATL_FUNC_INFO IInkCollectorEventsImpl<CAdvRecoApp>::mc_AtlFuncInfo[1] = {
-        {CC_STDCALL, VT_EMPTY, 4, {VT_UNKNOWN, VT_UNKNOWN, VT_VARIANT, VT_BOOL|VT_BYREF}}
+const _ATL_FUNC_INFO IInkCollectorEventsImpl<CAdvRecoApp>::mc_AtlFuncInfo[4] = {
+        {CC_STDCALL, VT_EMPTY, 4, {VT_UNKNOWN, VT_UNKNOWN, VT_VARIANT, VT_BOOL|VT_BYREF}},
+        {CC_STDCALL, VT_EMPTY, 3, {VT_UNKNOWN, VT_UNKNOWN, VT_BOOL|VT_BYREF}},
+        {CC_STDCALL, VT_EMPTY, 2, {VT_UNKNOWN, VT_UNKNOWN}},
+        {CC_STDCALL, VT_EMPTY, 4, {VT_UNKNOWN, VT_UNKNOWN, VT_I4, VT_VARIANT|VT_BYREF}}
 };
 
 const TCHAR gc_szAppName[] = TEXT("Advanced Recognition");
 
+/////////////////////////////////////////////////////////
+//
+// GetFileNameArg
+//
+// Copies a file name argument of the command line, quoted
+// or not, to an ANSI string buffer.
+//
+// Parameters:
+//        LPWSTR pszArg   : [in] the argument
+//        char* pszFile   : [out] the file name
+//        int cchFile     : [in] the size of the pszFile buffer
+//
+// Return Values (LPWSTR):
+//        the rest of the command line, after the argument
+//
+/////////////////////////////////////////////////////////
+static LPWSTR GetFileNameArg(
+        LPWSTR pszArg,
+        char* pszFile,
+        int cchFile
+        )
+{
+    while (L' ' == *pszArg)
+        pszArg++;
+
+    WCHAR wchEnd = L' ';
+    if (L'"' == *pszArg)
+    {
+        wchEnd = L'"';
+        pszArg++;
+    }
+    LPWSTR pszEnd = pszArg;
+    while (L'\0' != *pszEnd && wchEnd != *pszEnd)
+        pszEnd++;
+
+    int cch = ::WideCharToMultiByte(CP_ACP, 0, pszArg, (int)(pszEnd - pszArg),
+                                    pszFile, cchFile - 1, NULL, NULL);
+    pszFile[cch] = '\0';
+
+    return (L'"' == *pszEnd) ? pszEnd + 1 : pszEnd;
+}
+
 /////////////////////////////////////////////////////////
 //
 // WinMain
@@ -117,7 +190,22 @@ const TCHAR gc_szAppName[] = TEXT("Advanced Recognition");
 // Parameters:
 //        HINSTANCE hInstance,      : [in] handle to current instance
 //        HINSTANCE hPrevInstance,  : [in] handle to previous instance
-//        LPSTR lpCmdLine,          : [in] command line
+//        LPSTR lpCmdLine,          : [in] command line, "-record <file>"
+//                                    to record the input to a log file,
+//                                    "-trace <file>" to write the trace
+//                                    points to a Chrome trace file,
+//                                    "-metrics <file>" to append the live
+//                                    metrics to a file periodically,
+//                                    "-wordlist <file>" to add a compiled
+//                                    word list (see WordPack.cpp) to the
+//                                    input scopes, "-decimate <tolerance>"
+//                                    to set the decimation tolerance of
+//                                    the strokes, in ink units (0 keeps
+//                                    every point), "-predict <ms>" to set
+//                                    how far ahead of the ink the pen is
+//                                    predicted and drawn (0 doesn't),
+//                                    "-bindings <file>" to read the
+//                                    commands of the gestures from a file
 //        int nCmdShow              : [in] show state
 //
 // Return Values (int):
@@ -128,12 +216,58 @@ const TCHAR gc_szAppName[] = TEXT("Advanced Recognition");
 int APIENTRY wWinMain(
         HINSTANCE hInstance,
         HINSTANCE /*hPrevInstance*/,   // not used here
-        LPWSTR     /*lpCmdLine*/,       // not used here
+        LPWSTR     lpCmdLine,
         int       nCmdShow
         )
 {
     int iRet = 0;
 
+    // The names of the input log file and of the trace file, if requested
+    char szRecordFile[MAX_PATH] = "";
+    char szTraceFile[MAX_PATH] = "";
+    char szMetricsFile[MAX_PATH] = "";
+    char szWordListFile[MAX_PATH] = "";
+    char szBindingsFile[MAX_PATH] = "";
+    float fDecimation = SD_DEFAULT_TOLERANCE;
+    double dPredictMs = SP_DEFAULT_LOOKAHEAD / 1e6;
+    for (;;)
+    {
+        while (L' ' == *lpCmdLine)
+            lpCmdLine++;
+        if (0 == wcsncmp(lpCmdLine, L"-record ", 8) || 0 == wcsncmp(lpCmdLine, L"/record ", 8))
+        {
+            lpCmdLine = GetFileNameArg(lpCmdLine + 8, szRecordFile, countof(szRecordFile));
+        }
+        else if (0 == wcsncmp(lpCmdLine, L"-trace ", 7) || 0 == wcsncmp(lpCmdLine, L"/trace ", 7))
+        {
+            lpCmdLine = GetFileNameArg(lpCmdLine + 7, szTraceFile, countof(szTraceFile));
+        }
+        else if (0 == wcsncmp(lpCmdLine, L"-metrics ", 9) || 0 == wcsncmp(lpCmdLine, L"/metrics ", 9))
+        {
+            lpCmdLine = GetFileNameArg(lpCmdLine + 9, szMetricsFile, countof(szMetricsFile));
+        }
+        else if (0 == wcsncmp(lpCmdLine, L"-wordlist ", 10) || 0 == wcsncmp(lpCmdLine, L"/wordlist ", 10))
+        {
+            lpCmdLine = GetFileNameArg(lpCmdLine + 10, szWordListFile, countof(szWordListFile));
+        }
+        else if (0 == wcsncmp(lpCmdLine, L"-decimate ", 10) || 0 == wcsncmp(lpCmdLine, L"/decimate ", 10))
+        {
+            fDecimation = (float)wcstod(lpCmdLine + 10, &lpCmdLine);
+        }
+        else if (0 == wcsncmp(lpCmdLine, L"-predict ", 9) || 0 == wcsncmp(lpCmdLine, L"/predict ", 9))
+        {
+            dPredictMs = wcstod(lpCmdLine + 9, &lpCmdLine);
+        }
+        else if (0 == wcsncmp(lpCmdLine, L"-bindings ", 10) || 0 == wcsncmp(lpCmdLine, L"/bindings ", 10))
+        {
+            lpCmdLine = GetFileNameArg(lpCmdLine + 10, szBindingsFile, countof(szBindingsFile));
+        }
+        else
+        {
+            break;
+        }
+    }
+
     // Initialize the COM library and the application module
     if (S_OK == ::CoInitializeEx(NULL, COINIT_APARTMENTTHREADED))
     {
@@ -146,7 +280,14 @@ int APIENTRY wWinMain(
         if (TRUE == ::InitCommonControlsEx(&icc))
         {
             // Call the boilerplate function of the application
-            iRet = CAdvRecoApp::Run(nCmdShow);
+            iRet = CAdvRecoApp::Run(nCmdShow,
+                                    ('\0' != szRecordFile[0]) ? szRecordFile : NULL,
+                                    ('\0' != szTraceFile[0]) ? szTraceFile : NULL,
+                                    ('\0' != szMetricsFile[0]) ? szMetricsFile : NULL,
+                                    ('\0' != szWordListFile[0]) ? szWordListFile : NULL,
+                                    fDecimation,
+                                    (dPredictMs > 0) ? (PERFTIME)(dPredictMs * 1e6) : 0,
+                                    ('\0' != szBindingsFile[0]) ? szBindingsFile : NULL);
         }
         else
         {
@@ -172,6 +313,19 @@ int APIENTRY wWinMain(
 //
 // Parameters:
 //      int nCmdShow              : [in] show state
+//      const char* pszRecordFile : [in] the input log file, NULL not to record
+//      const char* pszTraceFile  : [in] the Chrome trace file written on exit,
+//                                  NULL not to trace
+//      const char* pszMetricsFile : [in] the file the metrics are appended to,
+//                                  NULL not to dump them
+//      const char* pszWordListFile : [in] the word list of the Wordlist input
+//                                  scope, NULL if none
+//      float fDecimation         : [in] the decimation tolerance of the
+//                                  strokes, in ink units, 0 not to decimate
+//      PERFTIME ptPredict        : [in] the lookahead of the predicted tail
+//                                  of the ink, 0 not to predict
+//      const char* pszBindingsFile : [in] the commands of the gestures, NULL
+//                                  to clear the ink with every gesture
 //
 // Return Values (int):
 //      0 : The function terminated before entering the message loop.
@@ -179,7 +333,14 @@ int APIENTRY wWinMain(
 //
 /////////////////////////////////////////////////////////
 int CAdvRecoApp::Run(
-        int nCmdShow
+        int nCmdShow,
+        const char* pszRecordFile,
+        const char* pszTraceFile,
+        const char* pszMetricsFile,
+        const char* pszWordListFile,
+        float fDecimation,
+        PERFTIME ptPredict,
+        const char* pszBindingsFile
         )
 {
 
@@ -187,6 +348,57 @@ int CAdvRecoApp::Run(
 
     int iRet;
 
+    // Start recording before the window is created, so that the initial
+    // gesture status changes get to the log too
+    if (NULL != pszRecordFile && false == theApp.m_recorder.Open(pszRecordFile))
+    {
+        ::MessageBox(NULL, TEXT("Error creating the input log file"),
+                     gc_szAppName, MB_ICONERROR | MB_OK);
+        return 0;
+    }
+
+    // Open the metrics dump; the lines are appended, so that a monitoring
+    // agent can keep one file across the runs
+    if (NULL != pszMetricsFile)
+    {
+        theApp.m_pMetricsFile = fopen(pszMetricsFile, "a");
+        if (NULL == theApp.m_pMetricsFile)
+        {
+            ::MessageBox(NULL, TEXT("Error opening the metrics file"),
+                         gc_szAppName, MB_ICONERROR | MB_OK);
+            return 0;
+        }
+    }
+
+    // Map the word list; its pages are read as the recognition needs them
+    if (NULL != pszWordListFile && false == theApp.m_wordList.Open(pszWordListFile))
+    {
+        ::MessageBox(NULL, TEXT("Error opening the word list file"),
+                     gc_szAppName, MB_ICONERROR | MB_OK);
+        return 0;
+    }
+
+    // Read the commands of the gestures
+    int iBadLine;
+    if (NULL != pszBindingsFile && false == theApp.m_bindings.Load(pszBindingsFile, &iBadLine))
+    {
+        TCHAR szMessage[64];
+        if (iBadLine > 0)
+            wsprintf(szMessage, TEXT("Error in the bindings file, line %d"), iBadLine);
+        else
+            lstrcpy(szMessage, TEXT("Error reading the bindings file"));
+        ::MessageBox(NULL, szMessage, gc_szAppName, MB_ICONERROR | MB_OK);
+        return 0;
+    }
+
+    theApp.m_decimator.SetTolerance(fDecimation);
+    theApp.m_input.SetSpacing(PI_DEFAULT_SPACING);
+    theApp.m_predictor.SetLookahead(ptPredict);
+
+    // Turn the trace points on; the trace is written in OnDestroy
+    theApp.m_pszTraceFile = pszTraceFile;
+    CTrace::Enable(NULL != pszTraceFile);
+
     // Load the icon from the resource and associate it with the window class
     WNDCLASSEX& wc = CAdvRecoApp::GetWndClassInfo().m_wc;
     wc.hIcon = wc.hIconSm = ::LoadIcon(_Module.GetResourceInstance(),
@@ -200,10 +412,14 @@ int CAdvRecoApp::Run(
         theApp.ShowWindow(nCmdShow);
         theApp.UpdateWindow();
 
-        // Run the boilerplate message loop
+        // Run the boilerplate message loop, with the Undo and Redo keys
+        HACCEL hAccel = ::LoadAccelerators(_Module.GetResourceInstance(),
+                                           MAKEINTRESOURCE(IDR_ACCEL));
         MSG msg;
         while (::GetMessage(&msg, NULL, 0, 0) > 0)
         {
+            if (NULL != hAccel && ::TranslateAccelerator(theApp.m_hWnd, hAccel, &msg))
+                continue;
             ::TranslateMessage(&msg);
             ::DispatchMessage(&msg);
         }
@@ -270,6 +486,11 @@ LRESULT CAdvRecoApp::OnCreate(
     if (FAILED(hr))
         return -1;
 
+    // The stand-in recognizer's templates, published for the workers;
+    // the gesture list enables and disables the gestures in the copies
+    m_engine.AddBuiltinTemplates();
+    m_config.Create(m_engine);
+
     // Set the recommended subset of gestures
     PresetGestures();
 
@@ -278,14 +499,87 @@ LRESULT CAdvRecoApp::OnCreate(
     if (FAILED(hr))
         return -1;
 
+    // The input window paints the committed ink from its own layer, so
+    // the InkCollector only draws the stroke being written
+    CComPtr<IInkRenderer> spIInkRenderer;
+    if (SUCCEEDED(m_spIInkCollector->get_Renderer(&spIInkRenderer))
+        && SUCCEEDED(m_spIInkCollector->put_AutoRedraw(VARIANT_FALSE)))
+    {
+        m_wndInput.SetInk(spIInkRenderer, m_spIInkDisp);
+    }
+
     hr = m_spIInkCollector->put_CollectionMode(ICM_InkAndGesture);
     if (FAILED(hr))
         return -1;
 
+    // The background recognition takes the ink from the stroke events.
+    // The input recorder and the predicted tail of the ink also need the
+    // pen down events and every packet. The packet events are costly, so
+    // they're requested only when recording or predicting. The tracing
+    // needs only the pen down events, to mark the stroke starts.
+    m_spIInkCollector->SetEventInterest(ICEI_Stroke, VARIANT_TRUE);
+    if (m_recorder.IsOpen() || m_predictor.GetLookahead() > 0)
+    {
+        m_spIInkCollector->SetEventInterest(ICEI_CursorDown, VARIANT_TRUE);
+        m_spIInkCollector->SetEventInterest(ICEI_NewPackets, VARIANT_TRUE);
+    }
+    else if (CTrace::IsEnabled())
+    {
+        m_spIInkCollector->SetEventInterest(ICEI_CursorDown, VARIANT_TRUE);
+    }
+
     hr = m_spIInkCollector->put_Enabled(VARIANT_TRUE);
     if (FAILED(hr))
         return -1;
 
+    // Start the background recognition with a worker per processor, each
+    // with the default handwriting recognizer, or with the stand-in one if
+    // there's none. The application works without it, only the result
+    // strings stay empty.
+    IStrokeRecognizer* rgpRecognizers[BR_MAX_WORKERS];
+    int cWorkers = CRecoWorkerPool::GetProcessorCount();
+    if (cWorkers > BR_MAX_WORKERS)
+    {
+        cWorkers = BR_MAX_WORKERS;
+    }
+    for (int i = 0; i < cWorkers; i++)
+    {
+        rgpRecognizers[i] = &m_rgInkRecognizers[i];
+    }
+    if (false == m_pool.Start(rgpRecognizers, cWorkers))
+    {
+        // The stand-in is stateless, the workers share it
+        for (int i = 0; i < cWorkers; i++)
+        {
+            rgpRecognizers[i] = &m_gestureRecognizer;
+        }
+        m_pool.Start(rgpRecognizers, cWorkers);
+    }
+    if (m_pool.IsStarted())
+    {
+        m_background.Start(&m_guidedRecognizer, NotifyRecoResults, m_hWnd, BR_DEBOUNCE_MS);
+    }
+
+    // The input scopes, the default one selected
+    for (int i = 0; i < RC_NUM_FACTOIDS; i++)
+    {
+        m_rgpFactoids[i] = new CFactoid(i);
+    }
+    CreateInputScopeMenu();
+
+    // Start the metrics timer, with the window of snapshots filled
+    // with the initial one
+    m_pSnapshots = (MetricsSnapshot*)malloc((mc_cMetricsWindow + 1) * sizeof(MetricsSnapshot));
+    if (NULL == m_pSnapshots)
+        return -1;
+    m_metrics.Snapshot(m_pSnapshots[0]);
+    m_ptMetricsStart = m_pSnapshots[0].ptTime;
+    for (int i = 1; i <= mc_cMetricsWindow; i++)
+    {
+        m_pSnapshots[i] = m_pSnapshots[0];
+    }
+    SetTimer(mc_iMetricsTimerId, mc_cMetricsTickMs);
+
     return 0;
 }
 
@@ -312,6 +606,19 @@ LRESULT CAdvRecoApp::OnDestroy(
         BOOL& /*bHandled*/
         )
 {
+    // Stop the background recognition, nothing is posted after it,
+    // then its workers
+    m_background.Stop();
+    m_pool.Stop();
+
+    // No job uses the input scopes any more
+    m_recoInk.SetConstraint(NULL, false);
+    for (int i = 0; i < RC_NUM_FACTOIDS; i++)
+    {
+        delete m_rgpFactoids[i];
+        m_rgpFactoids[i] = NULL;
+    }
+
     // Disable ink input and release the InkCollector object
     if (m_spIInkCollector != NULL)
     {
@@ -320,6 +627,24 @@ LRESULT CAdvRecoApp::OnDestroy(
         m_spIInkCollector.Release();
     }
 
+    // Stop the metrics
+    KillTimer(mc_iMetricsTimerId);
+    if (NULL != m_pMetricsFile)
+    {
+        fclose(m_pMetricsFile);
+        m_pMetricsFile = NULL;
+    }
+    free(m_pSnapshots);
+    m_pSnapshots = NULL;
+
+    // Flush the input log and write the trace
+    m_recorder.Close();
+    if (NULL != m_pszTraceFile)
+    {
+        CTrace::Enable(false);
+        CTrace::ExportChromeJson(m_pszTraceFile);
+    }
+
     // Post a WM_QUIT message to the application's message queue
     ::PostQuitMessage(0);
 
@@ -355,6 +680,133 @@ LRESULT CAdvRecoApp::OnSize(
     return 0;
 }
 
+/////////////////////////////////////////////////////////
+//
+// CAdvRecoApp::OnTimer
+//
+// The WM_TIMER message handler. Every tick takes a snapshot
+// of the metrics and shows the metrics of the last
+// mc_cMetricsWindow ticks in the status bar; every
+// mc_cMetricsWindow ticks it also appends them to the
+// metrics file, if there's one.
+//
+// Parameters:
+//      defined in the ATL's macro MESSAGE_HANDLER,
+//      wParam of the WM_TIMER message is the only used here.
+//
+// Return Values (LRESULT):
+//      always 0
+//
+/////////////////////////////////////////////////////////
+LRESULT CAdvRecoApp::OnTimer(
+        UINT /*uMsg*/,
+        WPARAM wParam,
+        LPARAM /*lParam*/,
+        BOOL& bHandled
+        )
+{
+    if (mc_iMetricsTimerId != wParam || NULL == m_pSnapshots)
+    {
+        bHandled = FALSE;
+        return 0;
+    }
+
+    // The snapshots are kept in a ring, the oldest one is overwritten
+    m_cTicks++;
+    const MetricsSnapshot& older = m_pSnapshots[m_cTicks % (mc_cMetricsWindow + 1)];
+    MetricsSnapshot& current = m_pSnapshots[(m_cTicks + mc_cMetricsWindow) % (mc_cMetricsWindow + 1)];
+    m_metrics.Snapshot(current);
+
+    char szText[256];
+    CMetrics::Format(current, older, szText, countof(szText));
+    ::SendMessageA(m_hwndStatusBar, SB_SETTEXTA, 0, (LPARAM)szText);
+
+    if (NULL != m_pMetricsFile && 0 == m_cTicks % mc_cMetricsWindow)
+    {
+        CMetrics::WriteLine(m_pMetricsFile, current, older, m_ptMetricsStart);
+    }
+
+    return 0;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CAdvRecoApp::OnRecoResults
+//
+// The mc_uRecoResultsMsg message handler. The background
+// recognition has results; they're shown if they're still
+// of the latest ink; otherwise newer results are on their
+// way, or the ink has been cleared.
+//
+// Parameters:
+//      defined in the ATL's macro MESSAGE_HANDLER,
+//      wParam, the generation of the results, is the only used here.
+//
+// Return Values (LRESULT):
+//      always 0
+//
+/////////////////////////////////////////////////////////
+LRESULT CAdvRecoApp::OnRecoResults(
+        UINT /*uMsg*/,
+        WPARAM wParam,
+        LPARAM /*lParam*/,
+        BOOL& /*bHandled*/
+        )
+{
+    RecoAlternate rgAlternates[CRecoOutputWnd::mc_iNumResults];
+    int cAlternates = m_background.GetResults((long)wParam, rgAlternates, countof(rgAlternates));
+    if (cAlternates < 0)
+        return 0;
+
+    TRACE_SCOPE("Update text results");
+    m_wndResults.SetResults(rgAlternates, cAlternates);
+    m_wndResults.Invalidate();
+
+    return 0;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CAdvRecoApp::OnCommands
+//
+// The mc_uCommandsMsg message handler. Runs the commands
+// the gestures have posted since the message was, in the
+// order they were posted, and records the latency of the
+// gestures, from their events to now that their commands
+// are done.
+//
+// Parameters:
+//      defined in the ATL's macro MESSAGE_HANDLER,
+//      none of them is used here
+//
+// Return Values (LRESULT):
+//      always 0
+//
+/////////////////////////////////////////////////////////
+LRESULT CAdvRecoApp::OnCommands(
+        UINT /*uMsg*/,
+        WPARAM /*wParam*/,
+        LPARAM /*lParam*/,
+        BOOL& /*bHandled*/
+        )
+{
+    TRACE_SCOPE("Run commands");
+    GestureCommand rgCommands[GCMD_MAX_QUEUED];
+    int cCommands = m_commands.Take(rgCommands, countof(rgCommands));
+    for (int i = 0; i < cCommands; i++)
+    {
+        RunCommand(rgCommands[i]);
+    }
+
+    PERFTIME ptDone = PerfNow();
+    for (int i = 0; i < m_cGesturesPending; i++)
+    {
+        m_metrics.RecordGesture(true, ptDone - m_rgptGestures[i]);
+    }
+    m_cGesturesPending = 0;
+    return 0;
+}
+
 // InkCollector event handlers ///////////////////////////
 
 /////////////////////////////////////////////////////////
@@ -367,7 +819,7 @@ LRESULT CAdvRecoApp::OnSize(
 //
 // Parameters:
 //      IInkCursor* pIInkCursor  : [in] not used here
-//      IInkStrokes* pInkStrokes : [in] the collection
+//      IInkStrokes* pInkStrokes : [in] the collection of the gesture's strokes
 //      VARIANT vGestures        : [in] safearray of IDispatch interface pointers
 //                                 of the recognized  Gesture objects
 //      VARIANT_BOOL* pbCancel   : [in,out] option to cancel the gesture,
@@ -379,7 +831,7 @@ LRESULT CAdvRecoApp::OnSize(
 /////////////////////////////////////////////////////////
 HRESULT CAdvRecoApp::OnGesture(
         IInkCursor* /*pIInkCursor*/,
-        IInkStrokes* /*pInkStrokes*/,
+        IInkStrokes* pInkStrokes,
         VARIANT vGestures,
         VARIANT_BOOL* pbCancel
         )
@@ -389,6 +841,16 @@ HRESULT CAdvRecoApp::OnGesture(
     if (0 == vGestures.parray->rgsabound->cElements)
         return E_INVALIDARG;
 
+    PERFTIME ptStart = PerfNow();
+
+    // The stroke has ended: take the predicted tail off it
+    {
+        CComPtr<IInkStrokeDisp> spIInkStroke;
+        if (NULL != pInkStrokes)
+            pInkStrokes->Item(0, &spIInkStroke);
+        m_wndInput.ErasePrediction(spIInkStroke);
+    }
+
     // The gestures in the array are supposed to be ordered by their recognition
     // confidence level. This sample picks up the top one.
     // NOTE: when in the InkAndGesture collection mode, besides the gestures expected
@@ -413,6 +875,7 @@ HRESULT CAdvRecoApp::OnGesture(
     bool bAccepted;     // will be true, if the gesture is known to this application
     if (IAG_NoGesture != idGesture)
     {
+        TRACE_SCOPE("GetGestureName");
         bAccepted = GetGestureName(idGesture, idGestureName);
     }
     else    // ignore the event (IAG_NoGesture had the highest confidence level,
@@ -422,128 +885,491 @@ HRESULT CAdvRecoApp::OnGesture(
         idGestureName = 0;
     }
 
+    // Log the end of the stroke and the gesture as the index into
+    // gc_igtSingleStrokeGestures (the string ids follow the same order)
+    RecordStrokeEnd();
+    m_recorder.Record(IE_GESTURE, bAccepted ? (int)(idGestureName - IDS_SSGESTURE_FIRST) : -1);
+
     // If the current collection mode is ICM_GestureOnly or if we accept
     // the gesture, the gesture's strokes will be removed from the ink object,
     // So, the window needs to be updated in the strokes' area.
+    bool bQueued = false;   // will be true, if the gesture's command is posted
     if (true == bAccepted)
     {
-        // Get the rectangle to update.
-        //RECT rc;
-        //m_wndInput.GetClientRect(&rc);
-
-        //m_wndInput.InvalidateRect(&rc);
+        // The InkCollector drew the gesture's strokes as they were written,
+        // and with its AutoRedraw off they stay on the window unless their
+        // pixels are painted again, whatever the command does to the ink
+        m_wndInput.EraseStrokes(pInkStrokes);
+
+        // A gesture acts on the ink written so far, with the command it's
+        // bound to (a clear, by default); the command runs after the event
+        // returns, so the collector isn't held up by a clear and a repaint
+        TRACE_SCOPE("Post command");
+        GestureCommand command = m_bindings.GetCommand((int)(idGestureName - IDS_SSGESTURE_FIRST));
+        if (GCMD_NONE != command.iKind && (int)countof(m_rgptGestures) == m_cGesturesPending)
+        {
+            // As many gestures wait as can be timed: run their commands now
+            BOOL bHandled = TRUE;
+            OnCommands(mc_uCommandsMsg, 0, 0, bHandled);
+        }
+        PostCommand(command);
+        bQueued = (GCMD_NONE != command.iKind);
+        if (bQueued)
+            m_rgptGestures[m_cGesturesPending++] = ptStart;
     }
     else // if something's failed,
          // or the gesture is either unknown or unchecked in the list
     {
         // Reject the gesture. The InkCollector will fire Stroke event(s)
-        // for the strokes, so they'll be handled in the OnStroke method.
+        // for the strokes, so they'll be handled in the OnStroke method,
+        // which adds them to the ink being recognized.
         *pbCancel = VARIANT_TRUE;
         idGestureName = IDS_GESTURE_UNKNOWN;        
     }
 
-    SendMessage(WM_COMMAND, ID_CLEAR);
-
     // Update the results window as well
-    m_wndResults.SetGestureName(idGestureName);
-    m_wndResults.Invalidate();
+    {
+        TRACE_SCOPE("Update results");
+        m_wndResults.SetGestureName(idGestureName);
+        m_wndResults.Invalidate();
+    }
+
+    // A gesture whose command is queued is recorded when it's done, by
+    // OnCommands; the others are done now
+    if (false == bQueued)
+        m_metrics.RecordGesture(bAccepted, PerfNow() - ptStart);
 
     return hr;
 }
 
-// Command handlers /////////////////////////////////////
-
 /////////////////////////////////////////////////////////
 //
-// CAdvRecoApp::OnClear
+// CAdvRecoApp::OnStroke
 //
-// This command handler is called when user clicks on "Clear"
-// in the Ink menu. It's supposed to delete the collected ink,
-// and update the child windows after that.
+// The _IInkCollectorEvents's Stroke event handler. The event
+// comes only for the strokes that haven't been taken as a
+// gesture. The stroke is drawn into the input window's
+// committed layer, added to the ink being recognized and
+// the ink is submitted to the background recognition, which
+// waits for the writing to pause before it recognizes it.
 //
 // Parameters:
-//      defined in the ATL's macro COMMAND_ID_HANDLER
-//      none of them is used here
+//      IInkCursor* pIInkCursor      : [in] not used here
+//      IInkStrokeDisp* pIInkStroke  : [in] the new stroke
+//      VARIANT_BOOL* pbCancel       : [in,out] not used here
 //
-// Return Values (LRESULT):
-//      always 0
+// Return Values (HRESULT):
+//      always S_OK
 //
 /////////////////////////////////////////////////////////
-LRESULT CAdvRecoApp::OnClear(
-        WORD /*wNotifyCode*/,
-        WORD /*wID*/,
-        HWND /*hWndCtl*/,
-        BOOL& /*bHandled*/
+HRESULT CAdvRecoApp::OnStroke(
+        IInkCursor* /*pIInkCursor*/,
+        IInkStrokeDisp* pIInkStroke,
+        VARIANT_BOOL* /*pbCancel*/
         )
 {
-    if (m_spIInkDisp != NULL)
-    {
-        // Delete all strokes from the Ink object, ignore returned value
-        m_spIInkDisp->DeleteStrokes(0);
-    }
+    RecordStrokeEnd();
 
-    // Update the child windows
-    m_wndResults.ResetResults();    // empties the strings
-    m_wndResults.Invalidate();
-    m_wndInput.Invalidate();
+    // The stroke is drawn into the input window's committed layer once,
+    // and the predicted tail is taken off it
+    m_wndInput.ErasePrediction(pIInkStroke);
+    m_wndInput.CommitStroke(pIInkStroke);
 
-    return 0;
+    if (NULL != pIInkStroke && SUCCEEDED(AddRecoStroke(pIInkStroke)))
+    {
+        m_background.Submit(m_recoInk, false);
+    }
+    return S_OK;
 }
 
-
 /////////////////////////////////////////////////////////
 //
-// CAdvRecoApp::OnExit
+// CAdvRecoApp::OnCursorDown
 //
-// This command handler is called when user clicks
-// on "Exit" in the Ink menu.
+// The _IInkCollectorEvents's CursorDown event handler.
+// A new stroke begins, and the prediction of the pen with
+// it.
 //
 // Parameters:
-//      defined in the ATL's macro COMMAND_ID_HANDLER
-//      none of them is used here
+//      IInkCursor* pIInkCursor      : [in] not used here
+//      IInkStrokeDisp* pIInkStroke  : [in] not used here
 //
-// Return Values (LRESULT):
-//      always 0
+// Return Values (HRESULT):
+//      always S_OK
 //
 /////////////////////////////////////////////////////////
-LRESULT CAdvRecoApp::OnExit(
-        WORD /*wNotifyCode*/,
-        WORD /*wID*/,
-        HWND /*hWndCtl*/,
-        BOOL& /*bHandled*/
+HRESULT CAdvRecoApp::OnCursorDown(
+        IInkCursor* /*pIInkCursor*/,
+        IInkStrokeDisp* /*pIInkStroke*/
         )
 {
-    // Close the application window
-    SendMessage(WM_CLOSE);
-    return 0;
+    TRACE_INSTANT("Pen down");
+    m_recorder.Record(IE_STROKE_BEGIN);
+    m_bStrokeOpen = true;
+    m_predictor.BeginStroke();
+    m_ptPackets = PerfNow();
+    return S_OK;
 }
 
-// Helper methods //////////////////////////////
-
 /////////////////////////////////////////////////////////
 //
-// CAdvRecoApp::OnLVColumnClick
+// CAdvRecoApp::OnNewPackets
 //
-// When user clicks on the column header in either of the gesture
-// listview controls, the CAdvRecoApp object receives a WM_NOTIFY
-// message that is mapped to this handler for the actual processing.
-// The application checks or unchecks all the items in the control
-// the notification came from.
+// The _IInkCollectorEvents's NewPackets event handler.
+// Logs the X and Y properties of the new packets, which
+// are the first two properties of every packet, gives them
+// to the predictor and draws the predicted tail of the ink.
+// The packets carry no time: the ones of an event are
+// spread evenly since the last event.
 //
 // Parameters:
-//      defined in the ATL's macro NOTIFY_HANDLER
+//      IInkCursor* pIInkCursor      : [in] not used here
+//      IInkStrokeDisp* pIInkStroke  : [in] the stroke being written
+//      long lPacketCount            : [in] the number of the new packets
+//      VARIANT* pvPacketData        : [in] safearray of the packet properties
 //
-// Return Values (LRESULT):
-//      always 0
+// Return Values (HRESULT):
+//      S_OK if succeeded, E_INVALIDARG otherwise
 //
 /////////////////////////////////////////////////////////
-LRESULT CAdvRecoApp::OnLVColumnClick(
-        int idCtrl,
-        LPNMHDR /*pnmh*/,
-        BOOL& bHandled
+HRESULT CAdvRecoApp::OnNewPackets(
+        IInkCursor* /*pIInkCursor*/,
+        IInkStrokeDisp* pIInkStroke,
+        long lPacketCount,
+        VARIANT* pvPacketData
         )
 {
-    if (mc_iSSGestLVId == idCtrl)
+    if (NULL == pvPacketData || (VT_ARRAY | VT_I4) != pvPacketData->vt
+        || NULL == pvPacketData->parray || lPacketCount <= 0)
+        return E_INVALIDARG;
+
+    long cValues = (long)pvPacketData->parray->rgsabound->cElements;
+    long cProperties = cValues / lPacketCount;
+    if (cProperties < 2)
+        return E_INVALIDARG;
+
+    PERFTIME ptNow = PerfNow();
+    bool bPredict = m_predictor.GetLookahead() > 0;
+    long* plData;
+    if (SUCCEEDED(::SafeArrayAccessData(pvPacketData->parray, (void HUGEP**)&plData)))
+    {
+        for (long i = 0; i < lPacketCount; i++)
+        {
+            long x = plData[i * cProperties];
+            long y = plData[i * cProperties + 1];
+            m_recorder.Record(IE_PACKET, x, y);
+            if (bPredict)
+            {
+                m_predictor.AddPacket((float)x, (float)y,
+                                      m_ptPackets + (ptNow - m_ptPackets) * (i + 1) / lPacketCount);
+            }
+        }
+        ::SafeArrayUnaccessData(pvPacketData->parray);
+    }
+    m_ptPackets = ptNow;
+
+    if (bPredict)
+    {
+        GesturePoint rgptTail[SP_TAIL_POINTS + 1];
+        int cTail = m_predictor.Predict(rgptTail);
+        m_wndInput.DrawPrediction(pIInkStroke, rgptTail, cTail);
+    }
+
+    return S_OK;
+}
+
+// Command handlers /////////////////////////////////////
+
+/////////////////////////////////////////////////////////
+//
+// CAdvRecoApp::OnRecognize
+//
+// This command handler is called when user clicks on
+// "Recognize" in the Ink menu. The ink is recognized right
+// away, without waiting for more strokes; the results come
+// as usual, with the mc_uRecoResultsMsg message.
+//
+// Parameters:
+//      defined in the ATL's macro COMMAND_ID_HANDLER
+//      none of them is used here
+//
+// Return Values (LRESULT):
+//      always 0
+//
+/////////////////////////////////////////////////////////
+LRESULT CAdvRecoApp::OnRecognize(
+        WORD /*wNotifyCode*/,
+        WORD /*wID*/,
+        HWND /*hWndCtl*/,
+        BOOL& /*bHandled*/
+        )
+{
+    m_recorder.Record(IE_COMMAND, ID_RECOGNIZE);
+
+    if (m_recoInk.GetStrokeCount() > 0)
+    {
+        m_background.Submit(m_recoInk, true);
+    }
+    return 0;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CAdvRecoApp::OnGuide
+//
+// This command handler is called when user selects one of
+// the items of the Guide menu. It shows the guide in the
+// input window and splits the ink written so far by the
+// cells of the new guide, then recognizes it again.
+//
+// Parameters:
+//      defined in the ATL's macro COMMAND_RANGE_HANDLER,
+//      wID, the command ID of the menu item, is the only used here.
+//
+// Return Values (LRESULT):
+//      always 0
+//
+/////////////////////////////////////////////////////////
+LRESULT CAdvRecoApp::OnGuide(
+        WORD /*wNotifyCode*/,
+        WORD wID,
+        HWND /*hWndCtl*/,
+        BOOL& /*bHandled*/
+        )
+{
+    m_recorder.Record(IE_COMMAND, wID);
+
+    m_wGuide = wID;
+    ApplyGuide();
+
+    // Update the menu
+    ::CheckMenuRadioItem(GetMenu(), ID_GUIDE_NONE, ID_GUIDE_BOXES, wID, MF_BYCOMMAND);
+
+    if (m_recoInk.GetStrokeCount() > 0)
+    {
+        m_background.Submit(m_recoInk, true);
+    }
+    return 0;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CAdvRecoApp::OnCoerce
+//
+// This command handler is called when user clicks on
+// "Coerce to InputScope" in the Inputscope menu. When it's
+// checked, only the text the input scope accepts is shown;
+// otherwise that text comes first. The ink is recognized
+// again.
+//
+// Parameters:
+//      defined in the ATL's macro COMMAND_ID_HANDLER
+//      none of them is used here
+//
+// Return Values (LRESULT):
+//      always 0
+//
+/////////////////////////////////////////////////////////
+LRESULT CAdvRecoApp::OnCoerce(
+        WORD /*wNotifyCode*/,
+        WORD /*wID*/,
+        HWND /*hWndCtl*/,
+        BOOL& /*bHandled*/
+        )
+{
+    m_recorder.Record(IE_COMMAND, ID_INPUTSCOPE_COERCE);
+
+    m_bCoerce = !m_bCoerce;
+    ::CheckMenuItem(GetMenu(), ID_INPUTSCOPE_COERCE,
+                    MF_BYCOMMAND | (m_bCoerce ? MF_CHECKED : MF_UNCHECKED));
+    ApplyInputScope();
+
+    if (m_recoInk.GetStrokeCount() > 0)
+    {
+        m_background.Submit(m_recoInk, true);
+    }
+    return 0;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CAdvRecoApp::OnInputScope
+//
+// This command handler is called when user selects one of
+// the input scopes of the Inputscope menu: the default, a
+// factoid or the word list. The ink is recognized again in
+// the new scope.
+//
+// Parameters:
+//      defined in the ATL's macro COMMAND_RANGE_HANDLER,
+//      wID, the command ID of the menu item, is the only used here.
+//
+// Return Values (LRESULT):
+//      always 0
+//
+/////////////////////////////////////////////////////////
+LRESULT CAdvRecoApp::OnInputScope(
+        WORD /*wNotifyCode*/,
+        WORD wID,
+        HWND /*hWndCtl*/,
+        BOOL& /*bHandled*/
+        )
+{
+    if (wID > mc_iWordListScope || (mc_iWordListScope == wID && false == m_wordList.IsOpen()))
+        return 0;
+
+    m_recorder.Record(IE_COMMAND, wID);
+
+    m_wInputScope = wID;
+    ::CheckMenuRadioItem(GetMenu(), ID_INPUTSCOPE_FIRST, mc_iWordListScope, wID, MF_BYCOMMAND);
+    ApplyInputScope();
+
+    if (m_recoInk.GetStrokeCount() > 0)
+    {
+        m_background.Submit(m_recoInk, true);
+    }
+    return 0;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CAdvRecoApp::OnClear
+//
+// This command handler is called when user clicks on "Clear"
+// in the Ink menu. It's supposed to delete the collected ink,
+// and update the child windows after that.
+//
+// Parameters:
+//      defined in the ATL's macro COMMAND_ID_HANDLER
+//      none of them is used here
+//
+// Return Values (LRESULT):
+//      always 0
+//
+/////////////////////////////////////////////////////////
+LRESULT CAdvRecoApp::OnClear(
+        WORD /*wNotifyCode*/,
+        WORD /*wID*/,
+        HWND /*hWndCtl*/,
+        BOOL& /*bHandled*/
+        )
+{
+    m_recorder.Record(IE_COMMAND, ID_CLEAR);
+
+    if (m_spIInkDisp != NULL)
+    {
+        // Delete all strokes from the Ink object, ignore returned value
+        m_spIInkDisp->DeleteStrokes(0);
+    }
+
+    // The cleared ink stays in the history, for Undo
+    m_history.Clear();
+
+    // Forget the ink being recognized; the results of a recognition
+    // that's still running won't be delivered
+    m_recoInk.Clear();
+    m_background.Cancel();
+
+    // Update the child windows
+    m_wndResults.ResetResults();    // empties the strings
+    m_wndResults.Invalidate();
+    m_wndInput.ResetCommitted();
+
+    return 0;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CAdvRecoApp::OnUndo
+//
+// This command handler is called when user clicks on "Undo"
+// or "Redo" in the Ink menu, or presses Ctrl+Z or Ctrl+Y.
+// The version of the ink before or after the current one
+// becomes current, and the ink is rebuilt from it.
+//
+// Parameters:
+//      defined in the ATL's macro COMMAND_RANGE_HANDLER
+//      WORD wID        : [in] ID_UNDO or ID_REDO
+//      other parameters are not used here
+//
+// Return Values (LRESULT):
+//      always 0
+//
+/////////////////////////////////////////////////////////
+LRESULT CAdvRecoApp::OnUndo(
+        WORD /*wNotifyCode*/,
+        WORD wID,
+        HWND /*hWndCtl*/,
+        BOOL& /*bHandled*/
+        )
+{
+    m_recorder.Record(IE_COMMAND, wID);
+
+    bool bChanged = (ID_UNDO == wID) ? m_history.Undo() : m_history.Redo();
+    if (bChanged)
+    {
+        TRACE_SCOPE("Apply history");
+        ApplyHistory();
+    }
+    return 0;
+}
+
+
+/////////////////////////////////////////////////////////
+//
+// CAdvRecoApp::OnExit
+//
+// This command handler is called when user clicks
+// on "Exit" in the Ink menu.
+//
+// Parameters:
+//      defined in the ATL's macro COMMAND_ID_HANDLER
+//      none of them is used here
+//
+// Return Values (LRESULT):
+//      always 0
+//
+/////////////////////////////////////////////////////////
+LRESULT CAdvRecoApp::OnExit(
+        WORD /*wNotifyCode*/,
+        WORD /*wID*/,
+        HWND /*hWndCtl*/,
+        BOOL& /*bHandled*/
+        )
+{
+    m_recorder.Record(IE_COMMAND, ID_EXIT);
+
+    // Close the application window
+    SendMessage(WM_CLOSE);
+    return 0;
+}
+
+// Helper methods //////////////////////////////
+
+/////////////////////////////////////////////////////////
+//
+// CAdvRecoApp::OnLVColumnClick
+//
+// When user clicks on the column header in either of the gesture
+// listview controls, the CAdvRecoApp object receives a WM_NOTIFY
+// message that is mapped to this handler for the actual processing.
+// The application checks or unchecks all the items in the control
+// the notification came from.
+//
+// Parameters:
+//      defined in the ATL's macro NOTIFY_HANDLER
+//
+// Return Values (LRESULT):
+//      always 0
+//
+/////////////////////////////////////////////////////////
+LRESULT CAdvRecoApp::OnLVColumnClick(
+        int idCtrl,
+        LPNMHDR /*pnmh*/,
+        BOOL& bHandled
+        )
+{
+    if (mc_iSSGestLVId == idCtrl)
     {
         m_bAllSSGestures = !m_bAllSSGestures;
         ListView_SetCheckState(m_hwndSSGestLV, -1, m_bAllSSGestures);
@@ -564,7 +1390,9 @@ LRESULT CAdvRecoApp::OnLVColumnClick(
 // listview controls, the state of the item is changing and the CAdvRecoApp
 // object receives a WM_NOTIFY message that is mapped to this handler
 // for the actual processing.
-// The application set or reset the gesture status in the InkCollector.
+// The application set or reset the gesture status in the InkCollector,
+// and in the configuration of the stand-in recognizer, which publishes
+// the change to the workers without stopping them.
 //
 // Parameters:
 //      defined in the ATL's macro NOTIFY_HANDLER
@@ -604,6 +1432,8 @@ LRESULT CAdvRecoApp::OnLVItemChanging(
         {
             // Allow the change in the control's item state
             lRet = FALSE;
+            m_recorder.Record(IE_GESTURE_STATUS, pnmv->iItem, bChecked ? 1 : 0);
+            m_config.SetGestureEnabled(pnmv->iItem, TRUE == bChecked);
         }
     }
     else
@@ -652,6 +1482,16 @@ bool CAdvRecoApp::CreateChildWindows()
     if (NULL == m_hwndSSGestLV)
         return false;
 
+    // Create the status bar for the live metrics
+    m_hwndStatusBar = ::CreateStatusWindow(WS_CHILD | WS_VISIBLE | SBARS_SIZEGRIP,
+                                           TEXT(""), m_hWnd, mc_iStatusBarId);
+    if (NULL == m_hwndStatusBar)
+        return false;
+
+    // Let the child windows report their paint times
+    m_wndInput.SetMetrics(&m_metrics);
+    m_wndResults.SetMetrics(&m_metrics);
+
     //
     ListView_SetExtendedListViewStyleEx(m_hwndSSGestLV, LVS_EX_CHECKBOXES, LVS_EX_CHECKBOXES);
 
@@ -712,6 +1552,19 @@ void CAdvRecoApp::UpdateLayout()
     RECT rect;
     GetClientRect(&rect);
 
+    // the status bar sizes itself at the bottom of the client area
+    if (::IsWindow(m_hwndStatusBar))
+    {
+        ::SendMessage(m_hwndStatusBar, WM_SIZE, 0, 0);
+        RECT rcStatus;
+        ::GetWindowRect(m_hwndStatusBar, &rcStatus);
+        rect.bottom -= rcStatus.bottom - rcStatus.top;
+        if (rect.bottom < rect.top)
+        {
+            rect.bottom = rect.top;
+        }
+    }
+
     // update the size and position of the gesture listviews
     if (::IsWindow(m_hwndSSGestLV))
     {
@@ -750,13 +1603,79 @@ void CAdvRecoApp::UpdateLayout()
         rect.bottom -= cyResultsWnd;
     }
 
-    // update the size and position of the ink input window
+    // update the size and position of the ink input window,
+    // and the number of the cells of its guide
     if (::IsWindow(m_wndInput.m_hWnd))
     {
         ::SetWindowPos(m_wndInput.m_hWnd, NULL,
                        rect.left, rect.top,
                        rect.right - rect.left, rect.bottom - rect.top,
                        SWP_NOZORDER | SWP_NOACTIVATE | SWP_SHOWWINDOW);
+        if (ID_GUIDE_NONE != m_wGuide)
+        {
+            ApplyGuide();
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CAdvRecoApp::PostCommand
+//
+// Posts a command to the queue, and the mc_uCommandsMsg
+// message that runs it if the queue was empty; otherwise
+// the message is on its way. If the queue is full, the
+// commands in it are run first.
+//
+// Parameters:
+//      const GestureCommand& command : [in] the command
+//
+/////////////////////////////////////////////////////////
+void CAdvRecoApp::PostCommand(
+        const GestureCommand& command
+        )
+{
+    bool bWasEmpty = m_commands.IsEmpty();
+    if (false == m_commands.Post(command))
+    {
+        BOOL bHandled = TRUE;
+        OnCommands(mc_uCommandsMsg, 0, 0, bHandled);
+        m_commands.Post(command);
+    }
+    if (bWasEmpty && false == m_commands.IsEmpty())
+    {
+        ::PostMessage(m_hWnd, mc_uCommandsMsg, 0, 0);
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CAdvRecoApp::RunCommand
+//
+// Runs a command of a gesture as the menu command that
+// does the same, so it's recorded and undone the same.
+//
+// Parameters:
+//      const GestureCommand& command : [in] the command
+//
+/////////////////////////////////////////////////////////
+void CAdvRecoApp::RunCommand(
+        const GestureCommand& command
+        )
+{
+    WORD wID = 0;
+    switch (command.iKind)
+    {
+        case GCMD_CLEAR:        wID = ID_CLEAR; break;
+        case GCMD_UNDO:         wID = ID_UNDO; break;
+        case GCMD_REDO:         wID = ID_REDO; break;
+        case GCMD_RECOGNIZE:    wID = ID_RECOGNIZE; break;
+        case GCMD_GUIDE:        wID = (WORD)(ID_GUIDE_NONE + command.iParam); break;
+        case GCMD_USER:         wID = (WORD)command.iParam; break;
+    }
+    if (0 != wID)
+    {
+        SendMessage(WM_COMMAND, wID);
     }
 }
 
@@ -819,3 +1738,354 @@ void CAdvRecoApp::PresetGestures()
         ListView_SetCheckState(m_hwndSSGestLV, i, TRUE);
     }
 }
+
+/////////////////////////////////////////////////////////
+//
+// CAdvRecoApp::RecordStrokeEnd
+//
+// Logs the end of the current stroke. A stroke ends with
+// either the Gesture or the Stroke event, and a rejected
+// gesture fires both, so only the first one is logged.
+//
+// Parameters:
+//      none
+//
+// Return Values (void):
+//      none
+//
+/////////////////////////////////////////////////////////
+void CAdvRecoApp::RecordStrokeEnd()
+{
+    if (m_bStrokeOpen)
+    {
+        m_recorder.Record(IE_STROKE_END);
+        m_bStrokeOpen = false;
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// CAdvRecoApp::AddRecoStroke
+//
+// Appends the points of a stroke, in ink space, to the ink
+// for the background recognition. The stroke is resampled
+// to a fixed spacing and decimated first: the digitizer
+// reports far more points than the shape needs, as many
+// more as its packet rate is higher, and the fewer points
+// are kept in the ink and resampled by the recognizers, at
+// the same cost for every pen. The ink object and the
+// input log keep every packet. The stroke, both its points
+// and the decimated ones, makes a new version of the ink in
+// the undo history.
+//
+// Parameters:
+//      IInkStrokeDisp* pIInkStroke  : [in] the stroke
+//
+// Return Values (HRESULT):
+//      S_OK if succeeded, an error code otherwise
+//
+/////////////////////////////////////////////////////////
+HRESULT CAdvRecoApp::AddRecoStroke(
+        IInkStrokeDisp* pIInkStroke
+        )
+{
+    // The points come as a safearray of x, y pairs
+    CComVariant vPoints;
+    HRESULT hr = pIInkStroke->GetPoints(0, ISC_AllElements, &vPoints);
+    if (FAILED(hr))
+        return hr;
+    if ((VT_ARRAY | VT_I4) != vPoints.vt || NULL == vPoints.parray)
+        return E_UNEXPECTED;
+
+    long cPoints = (long)vPoints.parray->rgsabound->cElements / 2;
+    if (0 == cPoints)
+        return E_UNEXPECTED;
+
+    int* piInkPoints = (int*)malloc(2 * cPoints * sizeof(int));
+    if (NULL == piInkPoints)
+        return E_OUTOFMEMORY;
+
+    long* plData;
+    hr = ::SafeArrayAccessData(vPoints.parray, (void HUGEP**)&plData);
+    if (SUCCEEDED(hr))
+    {
+        bool bAdded = true;
+        m_input.BeginStroke();
+        for (long i = 0; i < cPoints; i++)
+        {
+            piInkPoints[2 * i] = (int)plData[2 * i];
+            piInkPoints[2 * i + 1] = (int)plData[2 * i + 1];
+            if (bAdded)
+                bAdded = m_input.AddPacket((float)plData[2 * i], (float)plData[2 * i + 1]);
+        }
+        ::SafeArrayUnaccessData(vPoints.parray);
+
+        // A slow pen's stroke may have more points than packets
+        GesturePoint* ppt = NULL;
+        if (bAdded && m_input.EndStroke())
+            ppt = (GesturePoint*)malloc(m_input.GetPointCount() * sizeof(GesturePoint));
+        if (NULL == ppt)
+        {
+            free(piInkPoints);
+            return E_OUTOFMEMORY;
+        }
+
+        // The error of the kept polyline is bounded by the tolerance
+        int cKept = m_decimator.Decimate(m_input.GetPoints(), m_input.GetPointCount(), ppt);
+
+        // The history keeps its own reference to the stroke
+        HistoryStroke* pStroke = HistoryStroke::Create(piInkPoints, cPoints, ppt, cKept);
+        if (NULL == pStroke || false == m_history.Append(pStroke))
+            hr = E_OUTOFMEMORY;
+        HistoryStroke::Release(pStroke);
+
+        // The guide tells the cell from the stroke alone
+        if (false == m_recoInk.AddStroke(ppt, cKept, m_guide.GetStrokeCell(ppt, cKept)))
+            hr = E_OUTOFMEMORY;
+        free(ppt);
+    }
+
+    free(piInkPoints);
+    return hr;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CAdvRecoApp::ApplyHistory
+//
+// Rebuilds the ink from the current version of the undo
+// history: the strokes of the ink object are made again
+// from their points, and the ink for the recognition from
+// the decimated points, in the cells of the current guide.
+// The ink is recognized again, or the results are emptied
+// if there's no ink.
+//
+// Parameters:
+//      none
+//
+// Return Values (HRESULT):
+//      S_OK if succeeded, an error code otherwise
+//
+/////////////////////////////////////////////////////////
+HRESULT CAdvRecoApp::ApplyHistory()
+{
+    // A snapshot, which stays whole whatever happens to the history
+    CStrokeVector ink(m_history.GetCurrent());
+
+    HRESULT hr = S_OK;
+    if (m_spIInkDisp != NULL)
+    {
+        m_spIInkDisp->DeleteStrokes(0);
+
+        // The packets are the x, y pairs of the default packet description
+        for (int i = 0; i < ink.GetStrokeCount() && SUCCEEDED(hr); i++)
+        {
+            const HistoryStroke* pStroke = ink.GetStroke(i);
+            SAFEARRAY* psa = ::SafeArrayCreateVector(VT_I4, 0, 2 * pStroke->cInkPoints);
+            if (NULL == psa)
+            {
+                hr = E_OUTOFMEMORY;
+                break;
+            }
+
+            long* plData;
+            hr = ::SafeArrayAccessData(psa, (void HUGEP**)&plData);
+            if (SUCCEEDED(hr))
+            {
+                const int* piInkPoints = pStroke->GetInkPoints();
+                for (int j = 0; j < 2 * pStroke->cInkPoints; j++)
+                {
+                    plData[j] = piInkPoints[j];
+                }
+                ::SafeArrayUnaccessData(psa);
+
+                CComVariant vPackets;
+                vPackets.vt = VT_ARRAY | VT_I4;
+                vPackets.parray = psa;      // freed with the variant
+                psa = NULL;
+                CComVariant vDescription;
+                CComPtr<IInkStrokeDisp> spIInkStroke;
+                hr = m_spIInkDisp->CreateStroke(vPackets, vDescription, &spIInkStroke);
+            }
+            if (NULL != psa)
+                ::SafeArrayDestroy(psa);
+        }
+    }
+
+    m_recoInk.Clear();
+    for (int i = 0; i < ink.GetStrokeCount(); i++)
+    {
+        const HistoryStroke* pStroke = ink.GetStroke(i);
+        const GesturePoint* ppt = pStroke->GetPoints();
+        if (false == m_recoInk.AddStroke(ppt, pStroke->cPoints,
+                                         m_guide.GetStrokeCell(ppt, pStroke->cPoints)))
+            hr = E_OUTOFMEMORY;
+    }
+
+    if (m_recoInk.GetStrokeCount() > 0)
+    {
+        m_background.Submit(m_recoInk, true);
+    }
+    else
+    {
+        m_background.Cancel();
+        m_wndResults.ResetResults();
+    }
+    m_wndResults.Invalidate();
+    m_wndInput.ResetCommitted();
+
+    return hr;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CAdvRecoApp::CreateInputScopeMenu
+//
+// Appends the input scopes to the Inputscope menu: the
+// default one, the factoids, and the word list if there's
+// one, and checks the default.
+//
+// Parameters:
+//      none
+//
+// Return Values (void):
+//      none
+//
+/////////////////////////////////////////////////////////
+void CAdvRecoApp::CreateInputScopeMenu()
+{
+    HMENU hMenu = ::GetSubMenu(GetMenu(), mc_iInputScopeMenu);
+    if (NULL == hMenu)
+        return;
+
+    ::AppendMenuA(hMenu, MF_STRING, ID_INPUTSCOPE_FIRST, "Default");
+    for (int i = 0; i < RC_NUM_FACTOIDS; i++)
+    {
+        ::AppendMenuA(hMenu, MF_STRING, mc_iFactoidScopeFirst + i, CFactoid::GetFactoidName(i));
+    }
+    if (m_wordList.IsOpen())
+    {
+        ::AppendMenuA(hMenu, MF_STRING, mc_iWordListScope, "Wordlist");
+    }
+    ::CheckMenuRadioItem(hMenu, ID_INPUTSCOPE_FIRST, mc_iWordListScope, m_wInputScope,
+                         MF_BYCOMMAND);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CAdvRecoApp::ApplyInputScope
+//
+// Sets the selected input scope on the ink. The jobs take
+// it with their copy of the ink, so the scope of a running
+// job doesn't change under it.
+//
+// Parameters:
+//      none
+//
+// Return Values (void):
+//      none
+//
+/////////////////////////////////////////////////////////
+void CAdvRecoApp::ApplyInputScope()
+{
+    const IRecoConstraint* pConstraint = NULL;
+    if (mc_iWordListScope == m_wInputScope)
+    {
+        pConstraint = &m_wordList;
+    }
+    else if (m_wInputScope >= mc_iFactoidScopeFirst)
+    {
+        pConstraint = m_rgpFactoids[m_wInputScope - mc_iFactoidScopeFirst];
+    }
+    m_recoInk.SetConstraint(pConstraint, m_bCoerce);
+}
+
+/////////////////////////////////////////////////////////
+//
+// CAdvRecoApp::ApplyGuide
+//
+// Fills the input window with rows of the guide selected in
+// the Guide menu, lines or boxes, and sets the same guide in
+// ink space for the segmentation of the ink. The strokes of
+// the ink are moved to the cells of the new guide.
+//
+/////////////////////////////////////////////////////////
+void CAdvRecoApp::ApplyGuide()
+{
+    RECT rc;
+    m_wndInput.GetClientRect(&rc);
+
+    _InkRecoGuide irg;
+    irg.cRows = 0;
+    irg.cColumns = 0;
+    irg.midline = -1;
+    if (ID_GUIDE_NONE != m_wGuide)
+    {
+        irg.cRows = (rc.bottom > mc_iGuideRowHeight) ? rc.bottom / mc_iGuideRowHeight : 1;
+    }
+    if (ID_GUIDE_BOXES == m_wGuide)
+    {
+        irg.cColumns = (rc.right > mc_iGuideColWidth) ? rc.right / mc_iGuideColWidth : 1;
+    }
+
+    // A line is as wide as the window, a box is a cell
+    int cxWritingBox = (0 == irg.cColumns) ? rc.right : mc_iGuideColWidth;
+    ::SetRect(&irg.rectWritingBox, 0, 0, cxWritingBox, mc_iGuideRowHeight);
+    irg.rectDrawnBox = irg.rectWritingBox;
+    ::InflateRect(&irg.rectDrawnBox, -mc_cxBoxMargin, -mc_cyBoxMargin);
+    m_wndInput.SetGuide(irg);
+
+    // The same guide in ink space
+    m_guide.Reset();
+    if (irg.cRows > 0)
+    {
+        CComPtr<IInkRenderer> spIInkRenderer;
+        HDC hdc = m_wndInput.GetDC();
+        long x0 = 0, y0 = 0;
+        long x1 = cxWritingBox, y1 = mc_iGuideRowHeight;
+        if (NULL != hdc
+            && SUCCEEDED(m_spIInkCollector->get_Renderer(&spIInkRenderer))
+            && SUCCEEDED(spIInkRenderer->PixelToInkSpace((LONG_PTR)hdc, &x0, &y0))
+            && SUCCEEDED(spIInkRenderer->PixelToInkSpace((LONG_PTR)hdc, &x1, &y1)))
+        {
+            m_guide.Set((float)x0, (float)y0, (float)(x1 - x0), (float)(y1 - y0),
+                        irg.cRows, irg.cColumns);
+        }
+        if (NULL != hdc)
+        {
+            m_wndInput.ReleaseDC(hdc);
+        }
+    }
+
+    // Move the ink written so far to the new cells
+    for (int i = 0; i < m_recoInk.GetStrokeCount(); i++)
+    {
+        int cPoints;
+        const GesturePoint* ppt = m_recoInk.GetStroke(i, cPoints);
+        m_recoInk.SetStrokeCell(i, m_guide.GetStrokeCell(ppt, cPoints));
+    }
+    m_recoInk.SetCellColumns(m_guide.GetCellColumns());
+}
+
+/////////////////////////////////////////////////////////
+//
+// CAdvRecoApp::NotifyRecoResults
+//
+// Called by the background recognition on its worker thread
+// when the results are ready. It posts the generation of the
+// results to the application window, so the results are
+// taken on the window's thread and the worker never waits
+// for it.
+//
+// Parameters:
+//      void* pvContext   : [in] the application window
+//      long lGeneration  : [in] the generation of the results
+//
+/////////////////////////////////////////////////////////
+void CAdvRecoApp::NotifyRecoResults(
+        void* pvContext,
+        long lGeneration
+        )
+{
+    ::PostMessage((HWND)pvContext, mc_uRecoResultsMsg, (WPARAM)lGeneration, 0);
+}
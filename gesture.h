@@ -32,7 +32,29 @@ public:
         mc_iInputWndId = 1, 
         mc_iOutputWndId = 2, 
         mc_iSSGestLVId = 4,
-        // recognition guide box data
+        mc_iStatusBarId = 5,
+        // the metrics timer: the status bar is refreshed every tick and
+        // shows the last mc_cMetricsWindow ticks, which is also the
+        // interval of the metrics dump
+        mc_iMetricsTimerId = 1,
+        mc_cMetricsTickMs = 1000,
+        mc_cMetricsWindow = 10,
+        // the message the background recognizer posts when its results
+        // are ready, wParam is the generation of the results
+        mc_uRecoResultsMsg = WM_APP + 1,
+        // the message that runs the commands the gestures posted, posted
+        // when the first of them is
+        mc_uCommandsMsg = WM_APP + 2,
+        // recognition guide box data, in pixels
+        mc_iGuideColWidth = 100,
+        mc_iGuideRowHeight = 100,
+        mc_cxBoxMargin = 4,
+        mc_cyBoxMargin = 4,
+        // the Inputscope menu: the position of the submenu, and the
+        // commands after ID_INPUTSCOPE_FIRST, the default scope
+        mc_iInputScopeMenu = 2,
+        mc_iFactoidScopeFirst = ID_INPUTSCOPE_FIRST + 1,
+        mc_iWordListScope = mc_iFactoidScopeFirst + RC_NUM_FACTOIDS,
         // the width of the gesture list views 
         mc_cxGestLVWidth = 160, 
         // the number of the gesture names in the string table
@@ -47,17 +69,94 @@ public:
     CInkInputWnd    m_wndInput;
     CRecoOutputWnd  m_wndResults;
     HWND            m_hwndSSGestLV;     // single stroke gestures list view
+    HWND            m_hwndStatusBar;    // shows the live metrics
 
     // Helper data members
     bool            m_bAllSSGestures;
 
+    // Input recording (see InputLog.h), enabled with the -record option
+    CInputRecorder  m_recorder;
+    bool            m_bStrokeOpen;      // a stroke has begun and not ended yet
+
+    // Tracing (see Trace.h), enabled with the -trace option
+    const char*     m_pszTraceFile;     // written on exit, NULL if not tracing
+
+    // Live metrics (see Metrics.h), dumped to a file with the -metrics option
+    CMetrics         m_metrics;
+    MetricsSnapshot* m_pSnapshots;      // the last mc_cMetricsWindow + 1 ticks
+    int              m_cTicks;
+    PERFTIME         m_ptMetricsStart;
+    FILE*            m_pMetricsFile;    // NULL if not dumping
+
+    // Background handwriting recognition (see BackgroundReco.h) of the
+    // ink that's not taken as gestures. The ink is split by the cells of
+    // the guide (see GuidedReco.h), and the cells are recognized in
+    // parallel, a recognizer per worker. The stand-in recognizer is used
+    // if there's no handwriting recognizer on the system.
+    CGestureEngine          m_engine;       // the stand-in's templates
+    CGestureConfig          m_config;       // and the copies it recognizes with
+    CInkTextRecognizer      m_rgInkRecognizers[BR_MAX_WORKERS];
+    CGestureTextRecognizer  m_gestureRecognizer;
+    CRecoWorkerPool         m_pool;
+    CGuidedRecognizer       m_guidedRecognizer;
+    CBackgroundRecognizer   m_background;
+    CRecoInk                m_recoInk;      // the strokes of the ink, for the recognizer
+    CRecoGuide              m_guide;        // the guide in ink space
+    WORD                    m_wGuide;       // ID_GUIDE_NONE, ID_GUIDE_LINES or ID_GUIDE_BOXES
+
+    // The input scope of the recognition (see RecoConstraint.h): one of
+    // the factoids or the word list of the -wordlist option
+    CFactoid*               m_rgpFactoids[RC_NUM_FACTOIDS];
+    CWordList               m_wordList;
+    WORD                    m_wInputScope;  // a command of the Inputscope menu
+    bool                    m_bCoerce;      // only the text the scope accepts
+
+    // The decimation of the strokes before they're stored in m_recoInk
+    // (see StrokeDecimator.h), set with the -decimate option
+    CStrokeDecimator        m_decimator;
+
+    // The resampling of the strokes to a fixed spacing before they're
+    // decimated (see PacketInput.h), so the work of a stroke doesn't
+    // depend on the packet rate of the pen
+    CPacketInput            m_input;
+
+    // The prediction of the pen's position from the packets of the
+    // stroke being written (see StrokePredictor.h), drawn as a tail
+    // ahead of the ink; the lookahead is set with the -predict option
+    CStrokePredictor        m_predictor;
+    PERFTIME                m_ptPackets;    // when the last packets came
+
+    // The undo history of the ink (see InkHistory.h): every stroke and
+    // every clear makes a version, Undo and Redo move between them
+    CInkHistory             m_history;
+
+    // The commands of the gestures (see GestureCommands.h), bound with
+    // the -bindings option; OnGesture posts them to the queue and they
+    // run after it returns, from the mc_uCommandsMsg message
+    CGestureBindings        m_bindings;
+    CCommandQueue           m_commands;
+
+    // The gesture events whose commands haven't run yet, for the
+    // latency metric, which ends when a gesture's command is done
+    PERFTIME                m_rgptGestures[GCMD_MAX_QUEUED];
+    int                     m_cGesturesPending;
+
     // Static method that creates an object of the class
-    static int Run(int nCmdShow);
+    static int Run(int nCmdShow, const char* pszRecordFile, const char* pszTraceFile,
+                   const char* pszMetricsFile, const char* pszWordListFile,
+                   float fDecimation, PERFTIME ptPredict,
+                   const char* pszBindingsFile);
 
     // Constructor
     CAdvRecoApp() :
-        m_hwndSSGestLV(NULL), m_bAllSSGestures(true)
+        m_hwndSSGestLV(NULL), m_hwndStatusBar(NULL), m_bAllSSGestures(true),
+        m_bStrokeOpen(false), m_pszTraceFile(NULL), m_pSnapshots(NULL), m_cTicks(0),
+        m_ptMetricsStart(0), m_pMetricsFile(NULL), m_gestureRecognizer(m_config),
+        m_guidedRecognizer(m_pool, &m_config), m_wGuide(ID_GUIDE_NONE),
+        m_wInputScope(ID_INPUTSCOPE_FIRST), m_bCoerce(false), m_ptPackets(0),
+        m_cGesturesPending(0)
     {
+        memset(m_rgpFactoids, 0, sizeof(m_rgpFactoids));
     }
 
     // Helper methods
@@ -65,6 +164,15 @@ public:
     void    UpdateLayout();
     bool    GetGestureName(InkApplicationGesture idGesture, UINT& idGestureName);
     void    PresetGestures();
+    void    RecordStrokeEnd();
+    HRESULT AddRecoStroke(IInkStrokeDisp* pIInkStroke);
+    HRESULT ApplyHistory();
+    void    ApplyGuide();
+    void    CreateInputScopeMenu();
+    void    ApplyInputScope();
+    static void NotifyRecoResults(void* pvContext, long lGeneration);
+    void    PostCommand(const GestureCommand& command);
+    void    RunCommand(const GestureCommand& command);
     
 
 // Declare the class objects' window class with NULL background.
@@ -77,7 +185,15 @@ BEGIN_MSG_MAP(CAdvRecoApp)
     MESSAGE_HANDLER(WM_CREATE, OnCreate)
     MESSAGE_HANDLER(WM_DESTROY, OnDestroy)
     MESSAGE_HANDLER(WM_SIZE, OnSize)
+    MESSAGE_HANDLER(WM_TIMER, OnTimer)
+    MESSAGE_HANDLER(mc_uRecoResultsMsg, OnRecoResults)
+    MESSAGE_HANDLER(mc_uCommandsMsg, OnCommands)
+    COMMAND_ID_HANDLER(ID_RECOGNIZE, OnRecognize)
+    COMMAND_RANGE_HANDLER(ID_GUIDE_NONE, ID_GUIDE_BOXES, OnGuide)
+    COMMAND_ID_HANDLER(ID_INPUTSCOPE_COERCE, OnCoerce)
+    COMMAND_RANGE_HANDLER(ID_INPUTSCOPE_FIRST, ID_INPUTSCOPE_LAST, OnInputScope)
     COMMAND_ID_HANDLER(ID_CLEAR, OnClear)
+    COMMAND_RANGE_HANDLER(ID_UNDO, ID_REDO, OnUndo)
     COMMAND_ID_HANDLER(ID_EXIT, OnExit)
     NOTIFY_HANDLER(mc_iSSGestLVId, LVN_COLUMNCLICK, OnLVColumnClick)
     NOTIFY_HANDLER(mc_iSSGestLVId, LVN_ITEMCHANGING, OnLVItemChanging)
@@ -89,15 +205,28 @@ public:
     LRESULT OnCreate(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
     LRESULT OnDestroy(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
     LRESULT OnSize(UINT, WPARAM, LPARAM, BOOL& bHandled);
+    LRESULT OnTimer(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
+    LRESULT OnRecoResults(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
+    LRESULT OnCommands(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
     LRESULT OnLVColumnClick(int idCtrl, LPNMHDR pnmh, BOOL& bHandled);
     LRESULT OnLVItemChanging(int idCtrl, LPNMHDR pnmh, BOOL& bHandled);
     
     // Command handlers
+    LRESULT OnRecognize(WORD wNotifyCode, WORD wID, HWND hWndCtl, BOOL& bHandled);
+    LRESULT OnGuide(WORD wNotifyCode, WORD wID, HWND hWndCtl, BOOL& bHandled);
+    LRESULT OnCoerce(WORD wNotifyCode, WORD wID, HWND hWndCtl, BOOL& bHandled);
+    LRESULT OnInputScope(WORD wNotifyCode, WORD wID, HWND hWndCtl, BOOL& bHandled);
     LRESULT OnClear(WORD wNotifyCode, WORD wID, HWND hWndCtl, BOOL& bHandled);
+    LRESULT OnUndo(WORD wNotifyCode, WORD wID, HWND hWndCtl, BOOL& bHandled);
     LRESULT OnExit(WORD wNotifyCode, WORD wID, HWND hWndCtl, BOOL& bHandled);
 
-    // Ink collector event handler
+    // Ink collector event handlers
     HRESULT OnGesture(IInkCursor* pIInkCursor, IInkStrokes* pIInkStrokes, 
                       VARIANT vGestures, VARIANT_BOOL* pbCancel);
+    HRESULT OnStroke(IInkCursor* pIInkCursor, IInkStrokeDisp* pIInkStroke, 
+                     VARIANT_BOOL* pbCancel);
+    HRESULT OnCursorDown(IInkCursor* pIInkCursor, IInkStrokeDisp* pIInkStroke);
+    HRESULT OnNewPackets(IInkCursor* pIInkCursor, IInkStrokeDisp* pIInkStroke, 
+                         long lPacketCount, VARIANT* pvPacketData);
 };
 
@@ -56,6 +56,7 @@
 #define IDS_STRING205                   205
 #define IDS_STRING206                   206
 #define IDS_STRING207                   207
+#define IDR_ACCEL                       104
 #define ID_RECOGNIZER_DEFAULT           40000
 #define ID_RECOGNIZER_FIRST             40001
 #define ID_RECOGNIZER_LAST              40099
@@ -71,13 +72,15 @@
 #define ID_MODE_INK_AND_GESTURES        40307
 #define ID_MODE_GESTURES                40308
 #define ID_EXIT                         40309
+#define ID_UNDO                         40310
+#define ID_REDO                         40311
 
 // Next default values for new objects
 // 
 #ifdef APSTUDIO_INVOKED
 #ifndef APSTUDIO_READONLY_SYMBOLS
-#define _APS_NEXT_RESOURCE_VALUE        104
-#define _APS_NEXT_COMMAND_VALUE         40310
+#define _APS_NEXT_RESOURCE_VALUE        105
+#define _APS_NEXT_COMMAND_VALUE         40312
 #define _APS_NEXT_CONTROL_VALUE         1000
 #define _APS_NEXT_SYMED_VALUE           101
 #endif